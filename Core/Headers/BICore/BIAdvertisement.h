@@ -0,0 +1,114 @@
+//
+//  BIAdvertisement.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_ADVERTISEMENT_H
+#define BICORE_ADVERTISEMENT_H
+
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  Decoding of beacon advertisements. The decoders read the raw bytes of an advertising packet in place, never
+ *  allocate and fill a BIAdvertisement, so that continuous scans can be processed at hundreds of packets per second.
+ *  Everything else about a packet (e.g. an advertisementData dictionary) only needs to be built for the packets an
+ *  app actually looks at.
+ *
+ *  Recognized are iBeacon (Apple manufacturer data) and the Eddystone UID, URL, TLM and EID frames (service data of
+ *  the Eddystone service 0xFEAA). All decoders are safe to call with arbitrary bytes.
+ */
+
+typedef enum {
+    BIAdvertisementTypeUnknown = 0,
+    BIAdvertisementTypeIBeacon = 1,
+    BIAdvertisementTypeEddystoneUID = 2,
+    BIAdvertisementTypeEddystoneURL = 3,
+    BIAdvertisementTypeEddystoneTLM = 4,
+    BIAdvertisementTypeEddystoneEID = 5
+} BIAdvertisementType;
+
+/**
+ *  A decoded advertisement. Only the fields of its type are set.
+ */
+typedef struct {
+    BIAdvertisementType type;
+
+    /**
+     *  iBeacon: the RSSI at 1 m (the beacon's measured power). Eddystone UID, URL and EID: the TX power at 0 m.
+     */
+    int8_t measuredPower;
+
+    /**
+     *  iBeacon.
+     */
+    BIBeaconKey key;
+
+    /**
+     *  Eddystone UID.
+     */
+    uint8_t namespaceID[10];
+    uint8_t instanceID[6];
+
+    /**
+     *  Eddystone URL: the URL scheme prefix code and the encoded rest of the URL. URL points into the decoded bytes
+     *  and is only valid as long as they are. Use BIAdvertisementCopyURL() to expand it.
+     */
+    uint8_t URLScheme;
+    const uint8_t *URL;
+    size_t URLLength;
+
+    /**
+     *  Eddystone TLM (unencrypted): battery voltage in mV (0 if not supported), beacon temperature in °C (NaN if not
+     *  supported), advertising PDUs sent and time since power-on in seconds, both since the last reboot.
+     */
+    uint8_t TLMVersion;
+    uint16_t batteryVoltage;
+    double temperature;
+    uint32_t advertisementCount;
+    double uptime;
+
+    /**
+     *  Eddystone EID.
+     */
+    uint8_t ephemeralID[8];
+} BIAdvertisement;
+
+/**
+ *  Decodes manufacturer specific data (the value of CBAdvertisementDataManufacturerDataKey): the 16-bit company
+ *  identifier followed by the manufacturer's bytes.
+ *
+ *  @return true if the data is an iBeacon advertisement. advertisement is only changed on success.
+ */
+bool BIAdvertisementDecodeManufacturerData(const uint8_t *data, size_t length, BIAdvertisement *advertisement);
+
+/**
+ *  Decodes the service data of a 16-bit service UUID (a value of CBAdvertisementDataServiceDataKey).
+ *
+ *  @return true if the data is an Eddystone frame. advertisement is only changed on success.
+ */
+bool BIAdvertisementDecodeServiceData(uint16_t serviceUUID, const uint8_t *data, size_t length,
+                                      BIAdvertisement *advertisement);
+
+/**
+ *  Decodes a raw advertising or scan response payload (a sequence of AD structures, as delivered by HCI on Linux or
+ *  Android). The first iBeacon or Eddystone structure is decoded; truncated structures end the payload.
+ *
+ *  @return true if the payload contains an iBeacon advertisement or an Eddystone frame. advertisement is only changed
+ *  on success.
+ */
+bool BIAdvertisementDecodePayload(const uint8_t *payload, size_t length, BIAdvertisement *advertisement);
+
+/**
+ *  Expands the URL of an Eddystone URL advertisement into buffer, NUL-terminated and truncated to capacity.
+ *
+ *  @return The length of the complete URL, not counting the terminating NUL.
+ */
+size_t BIAdvertisementCopyURL(const BIAdvertisement *advertisement, char *buffer, size_t capacity);
+
+BI_EXTERN_C_END
+
+#endif
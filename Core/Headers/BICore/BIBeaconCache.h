@@ -0,0 +1,173 @@
+//
+//  BIBeaconCache.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_BEACON_CACHE_H
+#define BICORE_BEACON_CACHE_H
+
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The beacon cache keeps what the SDK knows about beacons across launches: the last smoothed signal, the calibrated
+ *  measured power and the metadata read over GATT. Seeding a smoothing engine with the cached signals (see
+ *  BISmoothingEngineRestoreSample()) lets the filters and the nearest beacon settle right after a launch instead of
+ *  starting from scratch.
+ *
+ *  The cache is a journal file that is mapped into memory. Opening it only maps the file; the records are read the
+ *  first time the cache is accessed. Updates are collected in memory and appended to the journal as one write by
+ *  BIBeaconCacheFlush(), so an update costs O(1) and a flush O(updated beacons), however many beacons the cache holds.
+ *  (An update whose signal is older than the signals of other beacons costs O(those beacons), as it is sorted into the
+ *  eviction order; signals reported in the order they were seen always cost O(1).)
+ *  Once the journal holds maximumJournalRecords records, a flush compacts it instead: the current beacons are written
+ *  to a new file that atomically replaces the journal.
+ *
+ *  Every record carries a checksum. A record that was cut off or damaged, e.g. because the app was terminated while
+ *  writing, ends the journal; the records before it are kept and the rest is overwritten by the next flush. A file
+ *  with a different version is treated as empty and replaced on the next flush.
+ *
+ *  Records are stored in the byte order of the device; a cache file is not meant to be moved to another device. The
+ *  cache is not thread-safe.
+ */
+typedef struct BIBeaconCache *BIBeaconCacheRef;
+
+/**
+ *  The fields a BICachedBeacon holds.
+ */
+typedef enum {
+    BICachedBeaconFieldSignal = 1 << 0,
+    BICachedBeaconFieldMeasuredPower = 1 << 1,
+    BICachedBeaconFieldName = 1 << 2,
+    BICachedBeaconFieldFirmwareVersion = 1 << 3,
+    BICachedBeaconFieldBatteryLevel = 1 << 4
+} BICachedBeaconField;
+
+typedef struct {
+    BIBeaconKey key;
+
+    /**
+     *  BICachedBeaconField mask of the fields that are set.
+     */
+    uint32_t fields;
+
+    /**
+     *  Signal: the last smoothed signal of the beacon and when it was measured.
+     */
+    double lastSeen;
+    int32_t RSSI;
+    int32_t proximity;
+    double accuracy;
+
+    /**
+     *  Measured power: the calibrated RSSI at 1 m.
+     */
+    int8_t measuredPower;
+
+    /**
+     *  Name and firmware version: NUL-terminated UTF-8 strings.
+     */
+    char name[32];
+    char firmwareVersion[16];
+
+    /**
+     *  Battery level: in percent.
+     */
+    uint8_t batteryLevel;
+} BICachedBeacon;
+
+typedef struct {
+    /**
+     *  Maximum number of beacons the cache holds. When a new beacon does not fit, the least recently seen beacon is
+     *  removed.
+     */
+    uint32_t maximumBeacons;
+
+    /**
+     *  Number of records after which the journal is compacted. Values below maximumBeacons are raised to it.
+     */
+    uint32_t maximumJournalRecords;
+} BIBeaconCacheConfiguration;
+
+typedef struct {
+    /**
+     *  Records read from the journal, and records discarded because they were cut off or damaged.
+     */
+    uint64_t recordsLoaded;
+    uint64_t recordsDiscarded;
+
+    uint64_t recordsAppended;
+    uint64_t compactions;
+
+    /**
+     *  Flushes that failed because the journal could not be written.
+     */
+    uint64_t failedFlushes;
+} BIBeaconCacheStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: up to 1024 beacons and a journal of up to 8192 records (832 KiB).
+ */
+BIBeaconCacheConfiguration BIBeaconCacheConfigurationMakeDefault(void);
+
+/**
+ *  Opens the cache stored at path, creating it if it does not exist.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *
+ *  @return The cache, or NULL if the file cannot be opened or created.
+ */
+BIBeaconCacheRef BIBeaconCacheOpen(const char *path, const BIBeaconCacheConfiguration *configuration);
+
+/**
+ *  Flushes the cache and closes it.
+ */
+void BIBeaconCacheClose(BIBeaconCacheRef cache);
+
+/**
+ *  Retrieves a beacon.
+ *
+ *  @return false if the cache does not hold the beacon.
+ */
+bool BIBeaconCacheLookup(BIBeaconCacheRef cache, const BIBeaconKey *key, BICachedBeacon *beacon);
+
+/**
+ *  Sets the fields of beacon->key that are in beacon->fields and keeps the others, adding the beacon if necessary.
+ */
+void BIBeaconCacheUpdate(BIBeaconCacheRef cache, const BICachedBeacon *beacon);
+
+/**
+ *  Removes a beacon.
+ *
+ *  @return false if the cache does not hold the beacon.
+ */
+bool BIBeaconCacheRemove(BIBeaconCacheRef cache, const BIBeaconKey *key);
+
+/**
+ *  Appends the updates and removals since the previous flush to the journal, or compacts it. Call it after a batch of
+ *  updates, e.g. every few seconds while ranging and when the app moves to the background.
+ *
+ *  @return false if the journal could not be written. The updates are kept and written by the next flush.
+ */
+bool BIBeaconCacheFlush(BIBeaconCacheRef cache);
+
+/**
+ *  Returns the number of beacons in the cache.
+ */
+size_t BIBeaconCacheGetCount(BIBeaconCacheRef cache);
+
+/**
+ *  Copies up to capacity beacons into beacons, in no particular order.
+ *
+ *  @return The number of beacons copied.
+ */
+size_t BIBeaconCacheCopyBeacons(BIBeaconCacheRef cache, BICachedBeacon *beacons, size_t capacity);
+
+BIBeaconCacheStatistics BIBeaconCacheGetStatistics(BIBeaconCacheRef cache);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,277 @@
+//
+//  BIBeaconProvisioner.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_BEACON_PROVISIONER_H
+#define BICORE_BEACON_PROVISIONER_H
+
+#include "BICoreTypes.h"
+#include "BIGATTJobQueue.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The beacon provisioner writes a target configuration (proximity UUID, major, minor, TX power level and advertising
+ *  interval) to many beacons, e.g. when a site is rolled out or renumbered.
+ *
+ *  For each device it connects, discovers the required services and characteristics, authenticates by writing the
+ *  passkey, writes all settings at once, reads them back to verify them and optionally reboots the beacon so that it
+ *  advertises the new configuration. Like the GATT job queue it processes up to maximumConnections devices
+ *  concurrently, retries failed attempts after retryDelay seconds until maximumAttempts attempts have been made and
+ *  times out connecting and whole attempts. A rejected passkey or a missing characteristic finish a device right away,
+ *  since retrying would not help; a failed verification is retried.
+ *
+ *  Progress can be saved with BIBeaconProvisionerCopyProgress() at any time, e.g. when the app goes to the background,
+ *  and passed to BIBeaconProvisionerStart() to resume: devices that have already been provisioned with the same target
+ *  configuration are skipped.
+ *
+ *  The provisioner does no I/O itself. It issues operations through a BIGATTTransport, which must implement
+ *  writeValue, and is told about their completion through the BIBeaconProvisionerDid... functions. The same rules as
+ *  for BIGATTJobQueueRef apply: time only advances with the timestamps passed in, the provisioner is not thread-safe,
+ *  and handlers must not call back into it.
+ */
+typedef struct BIBeaconProvisioner *BIBeaconProvisionerRef;
+
+/**
+ *  The characteristics of the beacon firmware. Set them from the BIBeacon...CharacteristicUUID constants in BITypes.h
+ *  and the UUIDs of their services with BIGATTUUIDSetString().
+ */
+typedef struct {
+    BIGATTCharacteristicPath passkey;
+    BIGATTCharacteristicPath proximityUUID;
+    BIGATTCharacteristicPath major;
+    BIGATTCharacteristicPath minor;
+    BIGATTCharacteristicPath TXPowerLevel;
+    BIGATTCharacteristicPath advertisingInterval;
+    BIGATTCharacteristicPath reboot;
+} BIBeaconCharacteristics;
+
+typedef enum {
+    BIBeaconSettingProximityUUID = 1 << 0,
+    BIBeaconSettingMajor = 1 << 1,
+    BIBeaconSettingMinor = 1 << 2,
+    BIBeaconSettingTXPowerLevel = 1 << 3,
+    BIBeaconSettingAdvertisingInterval = 1 << 4
+} BIBeaconSetting;
+
+/**
+ *  The configuration to write to one device. Only the settings in the settings mask are written.
+ *
+ *  The proximity UUID is written as its 16 bytes, major, minor and the advertising interval as 16-bit integers with the
+ *  least significant byte first, and the TX power level as a single byte.
+ */
+typedef struct {
+    uint32_t deviceID;
+
+    /**
+     *  A combination of BIBeaconSetting values.
+     */
+    uint32_t settings;
+    BIBeaconKey key;
+
+    /**
+     *  0 == -23 dBm, 1 == -6 dBm, 2 == 0 dBm.
+     */
+    uint8_t TXPowerLevel;
+
+    /**
+     *  In steps of 0.625 ms, e.g. 160 == 100 ms, 1600 == 1 s.
+     */
+    uint16_t advertisingInterval;
+} BIBeaconProvisioningTarget;
+
+typedef enum {
+    BIProvisioningStatusPending = 0,
+    BIProvisioningStatusProvisioned = 1,
+
+    /**
+     *  Skipped because the progress passed to BIBeaconProvisionerStart() says it has already been provisioned.
+     */
+    BIProvisioningStatusAlreadyProvisioned = 2,
+    BIProvisioningStatusAuthenticationFailed = 3,
+
+    /**
+     *  The device lacks a service or characteristic that is needed for its target configuration.
+     */
+    BIProvisioningStatusNotSupported = 4,
+    BIProvisioningStatusVerificationFailed = 5,
+
+    /**
+     *  All attempts failed (could not connect, timed out, disconnected or a write failed). See error.
+     */
+    BIProvisioningStatusFailed = 6,
+    BIProvisioningStatusCancelled = 7
+} BIProvisioningStatus;
+
+typedef struct {
+    uint32_t deviceID;
+    BIProvisioningStatus status;
+
+    /**
+     *  The reason of the last failed attempt, BIGATTStatusSuccess if there was none.
+     */
+    BIGATTStatus error;
+    uint32_t attempts;
+    double startedAt;
+    double finishedAt;
+
+    /**
+     *  true if the reboot was acknowledged or the device disconnected while rebooting.
+     */
+    bool rebooted;
+} BIBeaconProvisioningResult;
+
+/**
+ *  Handlers, both of which may be NULL. deviceFinished is called once per device, jobFinished once all devices are
+ *  finished.
+ */
+typedef struct {
+    void (*deviceFinished)(const BIBeaconProvisioningResult *result, void *context);
+    void (*jobFinished)(void *context);
+} BIBeaconProvisionerHandlers;
+
+typedef struct {
+    /**
+     *  Number of devices that are connected (or being connected to) at the same time.
+     */
+    uint32_t maximumConnections;
+
+    /**
+     *  Number of connection attempts per device.
+     */
+    uint32_t maximumAttempts;
+
+    /**
+     *  Times (in seconds) after which connecting to a device and a whole attempt time out.
+     */
+    double connectTimeout;
+    double deviceTimeout;
+
+    /**
+     *  Time (in seconds) between a failed attempt and the next one.
+     */
+    double retryDelay;
+
+    /**
+     *  Whether to reboot devices after their configuration has been verified.
+     */
+    bool reboot;
+} BIBeaconProvisionerConfiguration;
+
+typedef struct {
+    uint64_t devicesProvisioned;
+    uint64_t devicesSkipped;
+    uint64_t devicesFailed;
+    uint64_t connectionAttempts;
+    uint64_t timeouts;
+    uint64_t disconnections;
+    uint64_t valuesWritten;
+    uint64_t verificationFailures;
+} BIBeaconProvisionerStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: 4 connections, 3 attempts per device, timeouts of 5 seconds
+ *  (connecting) and 20 seconds (attempt), a retry delay of 2 seconds, and rebooting after verification.
+ */
+BIBeaconProvisionerConfiguration BIBeaconProvisionerConfigurationMakeDefault(void);
+
+/**
+ *  Creates a provisioner.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param characteristics The characteristics of the beacon firmware. Copied.
+ *  @param transport Performs the operations. Copied. writeValue must not be NULL.
+ *  @param handlers Receive the results.
+ *  @param context Passed to the transport functions and handlers.
+ */
+BIBeaconProvisionerRef BIBeaconProvisionerCreate(const BIBeaconProvisionerConfiguration *configuration,
+                                                 const BIBeaconCharacteristics *characteristics,
+                                                 const BIGATTTransport *transport, BIBeaconProvisionerHandlers handlers,
+                                                 void *context);
+
+/**
+ *  Destroys a provisioner. Devices that are still connected are not disconnected.
+ */
+void BIBeaconProvisionerDestroy(BIBeaconProvisionerRef provisioner);
+
+/**
+ *  Starts provisioning devices in the given order. The results of the previous job are discarded.
+ *
+ *  @param passkey The passkey to authenticate with. Pass a length of 0 for beacons without access control.
+ *  @param progress Progress saved with BIBeaconProvisionerCopyProgress(), or NULL to provision all devices.
+ *
+ *  @return false if the previous job has not finished yet or progress is not valid.
+ */
+bool BIBeaconProvisionerStart(BIBeaconProvisionerRef provisioner, double timestamp,
+                              const BIBeaconProvisioningTarget *targets, size_t targetCount, const uint8_t *passkey,
+                              size_t passkeyLength, const uint8_t *progress, size_t progressLength);
+
+/**
+ *  Disconnects all devices and finishes the job; unfinished devices get the status BIProvisioningStatusCancelled.
+ */
+void BIBeaconProvisionerCancel(BIBeaconProvisionerRef provisioner, double timestamp);
+
+/**
+ *  Handles timeouts and retries that are due at timestamp.
+ */
+void BIBeaconProvisionerAdvance(BIBeaconProvisionerRef provisioner, double timestamp);
+
+void BIBeaconProvisionerDidConnect(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                   BIGATTStatus status);
+
+/**
+ *  Reports that a device disconnected without having been asked to. Beacons disconnect when they reboot.
+ */
+void BIBeaconProvisionerDidDisconnect(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp);
+
+/**
+ *  Reports the result of a service discovery. services lists the requested services the device has.
+ */
+void BIBeaconProvisionerDidDiscoverServices(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                            BIGATTStatus status, const BIGATTUUID *services, size_t serviceCount);
+
+/**
+ *  Reports the result of a characteristic discovery. characteristics lists the requested characteristics the service
+ *  has.
+ */
+void BIBeaconProvisionerDidDiscoverCharacteristics(BIBeaconProvisionerRef provisioner, uint32_t deviceID,
+                                                   double timestamp, const BIGATTUUID *service, BIGATTStatus status,
+                                                   const BIGATTUUID *characteristics, size_t characteristicCount);
+
+void BIBeaconProvisionerDidWriteValue(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                      const BIGATTCharacteristicPath *path, BIGATTStatus status);
+
+void BIBeaconProvisionerDidReadValue(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                     const BIGATTCharacteristicPath *path, BIGATTStatus status, const uint8_t *value,
+                                     size_t length);
+
+bool BIBeaconProvisionerIsFinished(BIBeaconProvisionerRef provisioner);
+
+/**
+ *  Returns the number of devices of the current job.
+ */
+size_t BIBeaconProvisionerGetDeviceCount(BIBeaconProvisionerRef provisioner);
+
+/**
+ *  Returns the result of the device at index (in the order passed to BIBeaconProvisionerStart()).
+ */
+BIBeaconProvisioningResult BIBeaconProvisionerGetDeviceResult(BIBeaconProvisionerRef provisioner, size_t deviceIndex);
+
+/**
+ *  Saves which devices have been provisioned with which configuration, including the devices skipped because of the
+ *  progress the job was started with. The format is portable, so progress can be stored and resumed on another
+ *  device.
+ *
+ *  @return The number of bytes the progress takes. Nothing is written if that is more than capacity, so pass a
+ *  capacity of 0 to determine the size.
+ */
+size_t BIBeaconProvisionerCopyProgress(BIBeaconProvisionerRef provisioner, uint8_t *buffer, size_t capacity);
+
+BIBeaconProvisionerStatistics BIBeaconProvisionerGetStatistics(BIBeaconProvisionerRef provisioner);
+
+BI_EXTERN_C_END
+
+#endif
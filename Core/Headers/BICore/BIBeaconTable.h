@@ -0,0 +1,93 @@
+//
+//  BIBeaconTable.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_BEACON_TABLE_H
+#define BICORE_BEACON_TABLE_H
+
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The beacon table interns beacon identities. It maps the packed proximityUUID/major/minor of a beacon to a small
+ *  integer handle that stays the same for as long as the beacon is known. The rest of the core refers to beacons by
+ *  handle, so an app can look up a beacon by its identity without building beaconIdentifier strings.
+ *
+ *  Handles are dense (0 ..< maximumCount) and can be used directly as array indexes. When a beacon has not been seen
+ *  for idleTimeout seconds it is evicted and its handle may later be reused for a different beacon. Every reuse
+ *  increments the handle's generation, so holders of per-handle state can detect it with BIBeaconTableGetGeneration().
+ *  If the table is full when a new beacon is interned, the least recently seen beacon is evicted, in constant time.
+ *
+ *  The table is not thread-safe.
+ */
+typedef struct BIBeaconTable *BIBeaconTableRef;
+
+typedef uint32_t BIBeaconHandle;
+
+#define BIBeaconHandleInvalid ((BIBeaconHandle)UINT32_MAX)
+
+typedef struct {
+    /**
+     *  Maximum number of beacons the table holds at the same time.
+     */
+    uint32_t maximumCount;
+
+    /**
+     *  Beacons that have not been seen for this many seconds are evicted. Pass 0 to only evict when the table is full.
+     */
+    double idleTimeout;
+} BIBeaconTableConfiguration;
+
+BIBeaconTableConfiguration BIBeaconTableConfigurationMakeDefault(void);
+
+/**
+ *  Creates a beacon table.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ */
+BIBeaconTableRef BIBeaconTableCreate(const BIBeaconTableConfiguration *configuration);
+
+void BIBeaconTableDestroy(BIBeaconTableRef table);
+
+/**
+ *  Returns the handle for a beacon, adding the beacon to the table if necessary, and records timestamp as the time
+ *  the beacon was last seen.
+ */
+BIBeaconHandle BIBeaconTableIntern(BIBeaconTableRef table, const BIBeaconKey *key, double timestamp);
+
+/**
+ *  Returns the handle for a beacon, or BIBeaconHandleInvalid if the table does not contain it.
+ */
+BIBeaconHandle BIBeaconTableLookup(BIBeaconTableRef table, const BIBeaconKey *key);
+
+/**
+ *  Retrieves the key of a beacon.
+ *
+ *  @return false if handle does not refer to a beacon.
+ */
+bool BIBeaconTableGetKey(BIBeaconTableRef table, BIBeaconHandle handle, BIBeaconKey *key);
+
+/**
+ *  Returns the generation of a handle. The generation changes whenever the handle is assigned to a new beacon.
+ */
+uint32_t BIBeaconTableGetGeneration(BIBeaconTableRef table, BIBeaconHandle handle);
+
+/**
+ *  Returns the number of beacons in the table.
+ */
+size_t BIBeaconTableGetCount(BIBeaconTableRef table);
+
+/**
+ *  Evicts all beacons that have not been seen for idleTimeout seconds before now.
+ *
+ *  @return The number of evicted beacons.
+ */
+size_t BIBeaconTableEvictIdle(BIBeaconTableRef table, double now);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,34 @@
+//
+//  BICore.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+/**
+ *  The portable core of the BEACONinside SDK. Plain C interface, usable from Objective-C and C++ on any platform.
+ */
+
+#include "BICoreTypes.h"
+#include "BIBeaconTable.h"
+#include "BIDistanceEstimation.h"
+#include "BISmoothingEngine.h"
+#include "BINearestBeaconTracker.h"
+#include "BIRangingPipeline.h"
+#include "BIRegionMonitor.h"
+#include "BIRegionMultiplexer.h"
+#include "BIGATTJobQueue.h"
+#include "BIBeaconProvisioner.h"
+#include "BIAdvertisement.h"
+#include "BIDeviceScanner.h"
+#include "BIBeaconCache.h"
+#include "BIMetrics.h"
+#include "BIDutyCycle.h"
+#include "BISpatialIndex.h"
+#include "BIPositionEngine.h"
+#include "BIFusionEngine.h"
+#include "BIZoneEngine.h"
+#include "BIUpload.h"
+#include "BIUploadQueue.h"
+#include "BIIngestion.h"
+#include "BITrace.h"
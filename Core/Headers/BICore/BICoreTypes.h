@@ -0,0 +1,109 @@
+//
+//  BICoreTypes.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_TYPES_H
+#define BICORE_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#define BI_EXTERN_C_BEGIN extern "C" {
+#define BI_EXTERN_C_END }
+#else
+#define BI_EXTERN_C_BEGIN
+#define BI_EXTERN_C_END
+#endif
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  Distances (in meters) below which a beacon is classified as immediate or near, respectively.
+ */
+#define BIProximityImmediateThreshold 0.5
+#define BIProximityNearThreshold 3.0
+
+/**
+ *  Proximity classes. The raw values match CLProximity so that values can be passed through from Core Location
+ *  without conversion.
+ */
+typedef enum {
+    BIProximityUnknown = 0,
+    BIProximityImmediate = 1,
+    BIProximityNear = 2,
+    BIProximityFar = 3
+} BIProximity;
+
+/**
+ *  Identifies a beacon by its proximityUUID, major and minor value. The UUID is stored as its 16 raw bytes in the
+ *  order returned by -[NSUUID getUUIDBytes:].
+ */
+typedef struct {
+    uint8_t proximityUUID[16];
+    uint16_t major;
+    uint16_t minor;
+} BIBeaconKey;
+
+/**
+ *  A single signal of a beacon. The plain C counterpart of BIBeaconSignal.
+ *
+ *  timestamp is expressed in seconds since an arbitrary reference date (the SDK uses
+ *  -[NSDate timeIntervalSinceReferenceDate]). A RSSI value of 0 and a negative accuracy mean that the value could
+ *  not be determined, just like in CLBeacon.
+ */
+typedef struct {
+    double timestamp;
+    int32_t RSSI;
+    int32_t proximity;
+    double accuracy;
+    bool inRange;
+} BISignal;
+
+/**
+ *  One beacon as reported in a single ranging callback of CLLocationManager.
+ */
+typedef struct {
+    BIBeaconKey key;
+    int32_t RSSI;
+    int32_t proximity;
+    double accuracy;
+} BIBeaconSample;
+
+/**
+ *  Parses a UUID string of the form "F0018B9B-7509-4C31-A905-1A27D39C003C" (case-insensitive) into key->proximityUUID.
+ *
+ *  @return true on success, false if the string is not a valid UUID. key is left unchanged on failure.
+ */
+bool BIBeaconKeySetUUIDString(BIBeaconKey *key, const char *UUIDString);
+
+/**
+ *  Writes the canonical upper-case string representation of key->proximityUUID into buffer, which must have room for
+ *  at least 37 bytes (36 characters plus the terminating NUL).
+ */
+void BIBeaconKeyGetUUIDString(const BIBeaconKey *key, char *buffer);
+
+/**
+ *  Returns true if both keys refer to the same beacon.
+ */
+bool BIBeaconKeyEqual(const BIBeaconKey *key1, const BIBeaconKey *key2);
+
+/**
+ *  Maps a distance estimate in meters to a proximity class. Negative values (unknown accuracy) map to
+ *  BIProximityUnknown.
+ */
+BIProximity BIProximityForAccuracy(double accuracy);
+
+/**
+ *  Returns a signal that represents a beacon that was not in range at the specified time. The C counterpart of
+ *  +[BIBeaconSignal notInRangeSignalWithTimestamp:].
+ */
+BISignal BISignalMakeNotInRange(double timestamp);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,173 @@
+//
+//  BIDeviceScanner.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_DEVICE_SCANNER_H
+#define BICORE_DEVICE_SCANNER_H
+
+#include "BIAdvertisement.h"
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The device scanner aggregates the packets of a continuous Bluetooth Low Energy scan per device and reports the
+ *  changes as one batched delta per deliveryInterval, instead of one callback per advertising packet.
+ *
+ *  For every device it keeps the last RSSI, the packet count and the times it was first and last seen over its whole
+ *  lifetime, and minimum, maximum and mean RSSI and the packet count since the previous delta. A delta lists the devices
+ *  seen for the first time (added), the known devices seen again (updated) and the devices not seen for timeToLive
+ *  seconds (lost), which are then forgotten. If the scanner is full, the least recently seen device is lost to make
+ *  room.
+ *
+ *  Deltas are delivered from BIDeviceScannerReportPacket() and BIDeviceScannerAdvance() once deliveryInterval has
+ *  passed since the previous delta, and only if something changed; call BIDeviceScannerAdvance() periodically so that
+ *  devices are lost when no packets arrive at all. The scanner is not thread-safe, and the handler must not call back
+ *  into it.
+ */
+typedef struct BIDeviceScanner *BIDeviceScannerRef;
+
+/**
+ *  Identifies a device: the 16 bytes returned by -[NSUUID getUUIDBytes:] for CBPeripheral.identifier, or on Linux the
+ *  Bluetooth device address in the first 6 bytes, followed by zeros.
+ */
+typedef struct {
+    uint8_t bytes[16];
+} BIPeripheralIdentifier;
+
+/**
+ *  RSSI value with which Core Bluetooth reports packets whose RSSI is not available. Such packets are counted but do
+ *  not contribute to the RSSI values.
+ */
+#define BIScannerRSSIUnavailable 127
+
+typedef struct {
+    BIPeripheralIdentifier identifier;
+    double firstSeen;
+    double lastSeen;
+    uint64_t packetCount;
+
+    /**
+     *  BIScannerRSSIUnavailable if no packet had an RSSI.
+     */
+    int32_t lastRSSI;
+
+    /**
+     *  Packets and their RSSI since the previous delta. The RSSI values are BIScannerRSSIUnavailable if none of these
+     *  packets had an RSSI.
+     */
+    uint32_t intervalPacketCount;
+    int32_t minimumRSSI;
+    int32_t maximumRSSI;
+    double meanRSSI;
+
+    /**
+     *  The last advertisement passed to BIDeviceScannerReportPacket() for the device, with a type of
+     *  BIAdvertisementTypeUnknown if there was none. An Eddystone URL points into the scanner and is only valid during
+     *  the handler call; it is NULL for devices lost because the scanner was full.
+     */
+    BIAdvertisement advertisement;
+} BIScannedDevice;
+
+/**
+ *  The changes since the previous delta. lost holds the last state of each lost device. The arrays are only valid
+ *  during the handler call.
+ */
+typedef struct {
+    double timestamp;
+    const BIScannedDevice *added;
+    size_t addedCount;
+    const BIScannedDevice *updated;
+    size_t updatedCount;
+    const BIScannedDevice *lost;
+    size_t lostCount;
+} BIDeviceScanDelta;
+
+typedef void (*BIDeviceScanHandler)(const BIDeviceScanDelta *delta, void *context);
+
+typedef struct {
+    /**
+     *  Minimum time (in seconds) between two deltas.
+     */
+    double deliveryInterval;
+
+    /**
+     *  Devices that have not been seen for this many seconds are lost.
+     */
+    double timeToLive;
+
+    /**
+     *  Maximum number of devices the scanner keeps track of at the same time.
+     */
+    uint32_t maximumDevices;
+} BIDeviceScannerConfiguration;
+
+typedef struct {
+    uint64_t packets;
+    uint64_t deltas;
+    uint64_t devicesAdded;
+    uint64_t devicesLost;
+
+    /**
+     *  Devices lost because the scanner was full.
+     */
+    uint64_t devicesEvicted;
+} BIDeviceScannerStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: a delta per second at most, devices lost after 10 seconds, and
+ *  at most 1024 devices.
+ */
+BIDeviceScannerConfiguration BIDeviceScannerConfigurationMakeDefault(void);
+
+/**
+ *  Creates a device scanner.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param handler Receives the deltas.
+ *  @param context Passed to the handler.
+ */
+BIDeviceScannerRef BIDeviceScannerCreate(const BIDeviceScannerConfiguration *configuration, BIDeviceScanHandler handler,
+                                         void *context);
+
+void BIDeviceScannerDestroy(BIDeviceScannerRef scanner);
+
+/**
+ *  Reports an advertising packet.
+ *
+ *  @param advertisement The packet decoded with BIAdvertisement.h, or NULL. Copied.
+ */
+void BIDeviceScannerReportPacket(BIDeviceScannerRef scanner, const BIPeripheralIdentifier *identifier, double timestamp,
+                                 int32_t RSSI, const BIAdvertisement *advertisement);
+
+/**
+ *  Delivers a delta if deliveryInterval has passed since the previous one and something changed.
+ */
+void BIDeviceScannerAdvance(BIDeviceScannerRef scanner, double timestamp);
+
+/**
+ *  Delivers a delta right away if something changed, e.g. when the scan is stopped.
+ */
+void BIDeviceScannerFlush(BIDeviceScannerRef scanner, double timestamp);
+
+/**
+ *  Returns the number of devices the scanner currently keeps track of.
+ */
+size_t BIDeviceScannerGetDeviceCount(BIDeviceScannerRef scanner);
+
+/**
+ *  Copies up to capacity devices the scanner keeps track of into devices, in no particular order. Eddystone URLs are
+ *  not copied (URL is NULL).
+ *
+ *  @return The number of devices copied.
+ */
+size_t BIDeviceScannerCopyDevices(BIDeviceScannerRef scanner, BIScannedDevice *devices, size_t capacity);
+
+BIDeviceScannerStatistics BIDeviceScannerGetStatistics(BIDeviceScannerRef scanner);
+
+BI_EXTERN_C_END
+
+#endif
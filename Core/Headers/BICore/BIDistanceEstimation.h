@@ -0,0 +1,95 @@
+//
+//  BIDistanceEstimation.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_DISTANCE_ESTIMATION_H
+#define BICORE_DISTANCE_ESTIMATION_H
+
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  Estimates distance, accuracy and proximity for all beacons of a tick in one pass, from the RSSI and the calibrated
+ *  TX power of each beacon (the value of BIBeaconTxPowerLevelCharacteristicUUID).
+ *
+ *  The expected RSSI at 1 m (the "measured power") is txPower + referenceLoss. From it,
+ *
+ *  - distance follows the log-distance path loss model: 10^((measuredPower - RSSI) / (10 * pathLossExponent)),
+ *  - accuracy follows the curve fitted to Core Location's accuracy values: with ratio = RSSI / measuredPower, it is
+ *    ratio^10 for ratio < 1 and accuracyScale * ratio^accuracyExponent + accuracyOffset otherwise,
+ *  - proximity is derived from accuracy like everywhere else in the SDK (BIProximityForAccuracy()).
+ *
+ *  Beacons with an unknown RSSI (0 or positive) or a measured power of 0 dBm or more get a distance and accuracy of
+ *  -1 and BIProximityUnknown.
+ *
+ *  The batch is processed with SSE2, AVX2 or NEON where available, and with a scalar loop otherwise. All kernels
+ *  evaluate the same sequence of IEEE-754 operations (including their own exp2/log2 approximations, which are accurate
+ *  to a few ulp), so their results are bit-identical on every platform.
+ */
+
+typedef struct {
+    /**
+     *  Difference (in dB) between the RSSI at 1 m and the calibrated TX power. Typical BLE antennas lose about 41 dB over
+     *  the first meter. Pass 0 if the TX power values already are measured powers at 1 m (as advertised by iBeacons).
+     */
+    double referenceLoss;
+
+    /**
+     *  Path loss exponent of the environment. 2 in free space, higher in cluttered indoor spaces.
+     */
+    double pathLossExponent;
+
+    double accuracyScale;
+    double accuracyExponent;
+    double accuracyOffset;
+} BIDistanceModel;
+
+typedef enum {
+    /**
+     *  The fastest kernel the CPU supports.
+     */
+    BIDistanceKernelAutomatic = 0,
+    BIDistanceKernelScalar = 1,
+    BIDistanceKernelSSE2 = 2,
+    BIDistanceKernelAVX2 = 3,
+    BIDistanceKernelNEON = 4
+} BIDistanceKernel;
+
+BIDistanceModel BIDistanceModelMakeDefault(void);
+
+/**
+ *  Estimates distance, accuracy and proximity for count beacons.
+ *
+ *  @param model The model to use. Pass NULL to use the default model.
+ *  @param RSSI The RSSI of each beacon.
+ *  @param txPower The calibrated TX power of each beacon.
+ *  @param distances Receives the distances in meters. May be NULL.
+ *  @param accuracies Receives the accuracies in meters. May be NULL.
+ *  @param proximities Receives BIProximity values. May be NULL.
+ */
+void BIEstimateDistances(const BIDistanceModel *model, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                         double *distances, double *accuracies, int32_t *proximities);
+
+/**
+ *  Same as BIEstimateDistances(), but with a specific kernel.
+ *
+ *  @return false if the kernel is not available on this CPU or in this build (nothing is written then).
+ */
+bool BIEstimateDistancesWithKernel(BIDistanceKernel kernel, const BIDistanceModel *model, const int32_t *RSSI,
+                                   const int32_t *txPower, size_t count, double *distances, double *accuracies,
+                                   int32_t *proximities);
+
+bool BIDistanceKernelIsAvailable(BIDistanceKernel kernel);
+
+/**
+ *  Returns the kernel BIDistanceKernelAutomatic resolves to.
+ */
+BIDistanceKernel BIDistanceKernelGetAutomatic(void);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,170 @@
+//
+//  BIDutyCycle.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_DUTY_CYCLE_H
+#define BICORE_DUTY_CYCLE_H
+
+#include "BICoreTypes.h"
+#include "BIRangingPipeline.h"
+#include "BITrace.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The duty cycle decides when an app ranges, so that devices that spend long stretches in one place do not
+ *  keep the radio on at the full ranging rate.
+ *
+ *  Ranging runs continuously (one callback per second) after a region entry and whenever the ranged beacons change.
+ *  While the nearest beacon and the smoothed signals are stable, the interval grows by rampFactor after every
+ *  stableTicks stable ranging ticks, up to maximumInterval; once it exceeds windowDuration, ranging runs in windows of
+ *  windowDuration seconds that start every interval seconds. A tick in which the nearest beacon of a region changes, a
+ *  beacon that was not in range at the last significant tick comes into range, or a smoothed RSSI moved by
+ *  RSSIThreshold dB or more since the last significant tick, and any region entry, returns to continuous ranging.
+ *  Without active regions, or while Bluetooth is not powered on, ranging is paused.
+ *
+ *  On top of that, radioBudget bounds the fraction of time ranging is on: radio time is paid from a budget that fills at
+ *  radioBudget seconds per second and holds at most radioBudget * budgetPeriod seconds, so that bursts of continuous
+ *  ranging are allowed as long as the average stays within the budget. When the budget runs out, ranging stops and the
+ *  next window starts once the budget can pay for it.
+ *
+ *  The duty cycle has no clock and no threads of its own: it only sees the timestamps it is passed, so a recorded trace
+ *  replayed through it produces the same decisions as on the device. The caller calls BIDutyCycleAdvance() when its
+ *  timer for BIDutyCycleState.nextChange fires and after every report, and starts or stops ranging as the returned
+ *  state says.
+ */
+typedef struct BIDutyCycle *BIDutyCycleRef;
+
+typedef enum {
+    /**
+     *  No active regions or Bluetooth off: ranging is stopped.
+     */
+    BIDutyCycleModePaused = 0,
+
+    /**
+     *  Ranging runs all the time.
+     */
+    BIDutyCycleModeContinuous = 1,
+
+    /**
+     *  Ranging runs in windows of windowDuration seconds every interval seconds (or when the radio budget allows).
+     */
+    BIDutyCycleModeWindowed = 2
+} BIDutyCycleMode;
+
+typedef struct {
+    BIDutyCycleMode mode;
+
+    /**
+     *  Whether ranging should be on now.
+     */
+    bool ranging;
+
+    /**
+     *  The current time between the starts of two ranging windows, in seconds. Ranging is continuous while the interval
+     *  does not exceed windowDuration.
+     */
+    double interval;
+
+    /**
+     *  The time at which ranging should next start or stop if nothing is reported before, or INFINITY.
+     */
+    double nextChange;
+} BIDutyCycleState;
+
+typedef struct {
+    /**
+     *  The ranging interval of continuous ranging and the upper bound of the interval between windows, in seconds.
+     */
+    double minimumInterval;
+    double maximumInterval;
+
+    /**
+     *  Time (in seconds) ranging stays on per window. Must allow for at least one ranging callback.
+     */
+    double windowDuration;
+
+    /**
+     *  Number of consecutive stable ticks after which the interval grows, and the factor it grows by.
+     */
+    uint32_t stableTicks;
+    double rampFactor;
+
+    /**
+     *  Change of a beacon's smoothed RSSI (in dB) since the last significant tick that counts as significant. The first
+     *  ticks of a window smooth over few samples, so this must be well above the noise of a single sample.
+     */
+    int32_t RSSIThreshold;
+
+    /**
+     *  Maximum long-term fraction of time ranging may be on, between 0 and 1 (1 disables the budget), and the time (in
+     *  seconds) over which the budget may be spent in a burst.
+     */
+    double radioBudget;
+    double budgetPeriod;
+} BIDutyCycleConfiguration;
+
+typedef struct {
+    /**
+     *  Seconds with ranging on, with ranging paused, and with ranging off because the radio budget was exhausted.
+     */
+    double rangingTime;
+    double pausedTime;
+    double budgetLimitedTime;
+
+    uint64_t windows;
+    uint64_t rampUps;
+    uint64_t rampDowns;
+    uint64_t significantTicks;
+    uint64_t stableTicks;
+} BIDutyCycleStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: continuous ranging at 1 second, windows of 2 seconds up to every
+ *  30 seconds, the interval doubling after 5 stable ticks, a threshold of 8 dB and no radio budget (1.0, over 10
+ *  minutes).
+ */
+BIDutyCycleConfiguration BIDutyCycleConfigurationMakeDefault(void);
+
+/**
+ *  Creates a duty cycle. It starts paused until BIDutyCycleSetActiveRegionCount() reports active regions.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param timestamp The current time. The radio budget starts full.
+ */
+BIDutyCycleRef BIDutyCycleCreate(const BIDutyCycleConfiguration *configuration, double timestamp);
+
+void BIDutyCycleDestroy(BIDutyCycleRef dutyCycle);
+
+/**
+ *  Reports the number of regions that are ranged, e.g. the regions the device is inside. Going from none to some
+ *  starts continuous ranging.
+ */
+void BIDutyCycleSetActiveRegionCount(BIDutyCycleRef dutyCycle, double timestamp, uint32_t count);
+
+void BIDutyCycleSetBluetoothState(BIDutyCycleRef dutyCycle, double timestamp, BIBluetoothState state);
+
+/**
+ *  Reports a monitoring event. Entries (and inside states of regions) start continuous ranging.
+ */
+void BIDutyCycleReportRegionEvent(BIDutyCycleRef dutyCycle, double timestamp, BIRegionEvent event);
+
+/**
+ *  Reports a ranging batch (see BIRangingPipeline.h) and classifies its tick as stable or significant.
+ */
+void BIDutyCycleReportBatch(BIDutyCycleRef dutyCycle, const BIRangingBatch *batch);
+
+/**
+ *  Moves the duty cycle to timestamp, which must not be earlier than any timestamp passed before, and returns whether
+ *  ranging should be on.
+ */
+BIDutyCycleState BIDutyCycleAdvance(BIDutyCycleRef dutyCycle, double timestamp);
+
+BIDutyCycleStatistics BIDutyCycleGetStatistics(BIDutyCycleRef dutyCycle);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,216 @@
+//
+//  BIFusionEngine.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_FUSION_ENGINE_H
+#define BICORE_FUSION_ENGINE_H
+
+#include "BICoreTypes.h"
+#include "BIDistanceEstimation.h"
+#include "BIPositionEngine.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The fusion engine combines the signals several receivers (e.g. the phones and tablets of a checkout area) report for
+ *  the same beacons into one estimate per beacon. It is meant to run in a local aggregator process that receives the
+ *  signals of the receivers over the network.
+ *
+ *  Every receiver has its own RSSI calibration offset, which is added to its RSSI values, and its own clock offset,
+ *  which is added to its timestamps to bring them to the aggregator's clock. A fusion tick averages the calibrated
+ *  RSSI of each beacon per receiver over the signals of the last window seconds, and then over the receivers that
+ *  heard the beacon. The fused signal's accuracy and proximity follow from the fused RSSI and the beacon's TX power
+ *  (see BIDistanceEstimation.h). If at least three receivers with a known location on the same floor heard the beacon,
+ *  their distances are trilaterated into a position of the beacon.
+ *
+ *  Signals are submitted into a lock-free single-producer ring per receiver, so that the threads that receive the
+ *  signals of different receivers never wait for each other or for a fusion tick. Signals that do not fit into a full
+ *  ring are dropped and counted. Everything else (fusion ticks, calibration, statistics) must happen on one thread.
+ */
+typedef struct BIFusionEngine *BIFusionEngineRef;
+
+typedef struct {
+    /**
+     *  Added to every RSSI the receiver reports, in dB, e.g. to make up for a weaker antenna.
+     */
+    double RSSIOffset;
+
+    /**
+     *  Added to every timestamp the receiver reports, in seconds, to bring it to the aggregator's clock.
+     */
+    double clockOffset;
+
+    /**
+     *  Location of the receiver, in the coordinates of BIBeaconLocation. Receivers without a location are not used to
+     *  trilaterate beacons.
+     */
+    bool located;
+    double x;
+    double y;
+    int32_t floor;
+} BIFusionReceiver;
+
+/**
+ *  The calibrated TX power of a beacon whose TX power differs from configuration.txPower.
+ */
+typedef struct {
+    BIBeaconKey key;
+    int32_t txPower;
+} BIFusionBeacon;
+
+/**
+ *  A signal as reported by a receiver. Signals that are not in range or have an unknown RSSI are ignored.
+ */
+typedef struct {
+    BIBeaconKey key;
+    BISignal signal;
+} BIFusionSignal;
+
+typedef struct {
+    BIBeaconKey key;
+
+    /**
+     *  The fused signal: the timestamp of the tick, the fused RSSI (rounded) and the accuracy and proximity derived from
+     *  it.
+     */
+    BISignal signal;
+
+    /**
+     *  The fused RSSI before rounding.
+     */
+    double meanRSSI;
+
+    /**
+     *  Number of receivers that heard the beacon in the window, and number of their signals.
+     */
+    uint32_t receiverCount;
+    uint32_t signalCount;
+
+    /**
+     *  The receiver with the strongest calibrated RSSI, and that RSSI.
+     */
+    uint32_t nearestReceiver;
+    double nearestRSSI;
+
+    /**
+     *  The trilaterated position of the beacon. Not valid unless at least three located receivers on the same floor
+     *  heard it.
+     */
+    BIPositionEstimate position;
+} BIFusedBeacon;
+
+/**
+ *  The result of a fusion tick. The beacons are sorted by fused RSSI (strongest first) and stay valid until the next
+ *  tick or until the engine is destroyed.
+ */
+typedef struct {
+    double timestamp;
+    const BIFusedBeacon *beacons;
+    size_t beaconCount;
+} BIFusionResult;
+
+typedef struct {
+    /**
+     *  Length of the window of a fusion tick, in seconds.
+     */
+    double window;
+
+    /**
+     *  Capacity of the ring of each receiver, in signals. Rounded up to a power of two. Must hold the signals a
+     *  receiver reports between two fusion ticks.
+     */
+    uint32_t ringCapacity;
+
+    BIDistanceModel distanceModel;
+
+    /**
+     *  Calibrated TX power of the beacons that are not passed to BIFusionEngineCreate().
+     */
+    int32_t txPower;
+
+    /**
+     *  Range errors, maximum range and iterations of the trilateration, as in BIPositionEngineConfiguration.
+     */
+    double rangeError;
+    double minimumRangeError;
+    double maximumRange;
+    uint32_t maximumIterations;
+    double convergenceThreshold;
+} BIFusionEngineConfiguration;
+
+typedef struct {
+    /**
+     *  Signals accepted into the rings, and signals dropped because a ring was full.
+     */
+    uint64_t signals;
+    uint64_t droppedSignals;
+
+    /**
+     *  Signals that were ignored (not in range, unknown RSSI or unknown receiver), and signals that were older than the
+     *  window when their ring was drained.
+     */
+    uint64_t ignoredSignals;
+    uint64_t lateSignals;
+
+    uint64_t ticks;
+
+    /**
+     *  Number of beacons the engine knows: those passed to BIFusionEngineCreate() and those with signals in the window
+     *  of the last tick. Other beacons are forgotten, so that the engine does not grow with every beacon ever heard.
+     */
+    uint64_t beacons;
+} BIFusionStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: a window of 2 seconds, rings of 4096 signals, the default distance
+ *  model, a TX power of -18 dBm (a measured power of -59 dBm), and the range errors, maximum range and iterations of
+ *  BIPositionEngineConfigurationMakeDefault().
+ */
+BIFusionEngineConfiguration BIFusionEngineConfigurationMakeDefault(void);
+
+/**
+ *  Creates a fusion engine.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param receivers The receivers. A receiver is identified by its index in this array.
+ *  @param beacons Beacons with their own TX power, or NULL.
+ */
+BIFusionEngineRef BIFusionEngineCreate(const BIFusionEngineConfiguration *configuration,
+                                       const BIFusionReceiver *receivers, size_t receiverCount,
+                                       const BIFusionBeacon *beacons, size_t beaconCount);
+
+void BIFusionEngineDestroy(BIFusionEngineRef engine);
+
+/**
+ *  Submits signals of a receiver. Lock-free and safe to call concurrently with everything else, as long as the signals
+ *  of each receiver are submitted by one thread at a time. Signals do not have to be submitted in the order of their
+ *  timestamps.
+ *
+ *  @return The number of signals taken, including the ignored ones. The remaining signals were dropped because the
+ *          receiver's ring was full.
+ */
+size_t BIFusionEngineSubmit(BIFusionEngineRef engine, uint32_t receiver, const BIFusionSignal *signals, size_t count);
+
+/**
+ *  Runs a fusion tick over the signals with an aligned timestamp in (timestamp - window, timestamp]. Signals with a
+ *  later timestamp are kept for later ticks.
+ *
+ *  @param timestamp The time of the tick on the aggregator's clock. Must not be earlier than the previous tick.
+ */
+BIFusionResult BIFusionEngineFuse(BIFusionEngineRef engine, double timestamp);
+
+/**
+ *  Changes the calibration of a receiver. Applies to the signals drained by the following ticks, including those
+ *  already submitted.
+ */
+void BIFusionEngineSetReceiverCalibration(BIFusionEngineRef engine, uint32_t receiver, double RSSIOffset,
+                                          double clockOffset);
+
+BIFusionStatistics BIFusionEngineGetStatistics(BIFusionEngineRef engine);
+
+BI_EXTERN_C_END
+
+#endif
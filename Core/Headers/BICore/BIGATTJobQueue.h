@@ -0,0 +1,247 @@
+//
+//  BIGATTJobQueue.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_GATT_JOB_QUEUE_H
+#define BICORE_GATT_JOB_QUEUE_H
+
+#include "BICoreTypes.h"
+#include "BIMetrics.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The GATT job queue reads a set of characteristics from many Bluetooth Low Energy devices, e.g. battery level,
+ *  firmware revision and TX power of every beacon of a site.
+ *
+ *  For each device it connects, discovers all required services with one request, discovers the characteristics of
+ *  all services at once, issues all reads at once and disconnects. Up to maximumConnections devices are processed
+ *  concurrently, so connecting to the next device overlaps with discovery and reads on the others. An attempt fails
+ *  if connecting takes longer than connectTimeout, the whole attempt takes longer than deviceTimeout, discovery fails
+ *  or the device disconnects; failed devices are retried after retryDelay seconds until maximumAttempts attempts have
+ *  been made. A characteristic that is missing or cannot be read does not fail the device; its value gets a status of
+ *  its own.
+ *
+ *  The queue does no I/O itself. It issues operations through a BIGATTTransport the app implements (e.g. on top of
+ *  Core Bluetooth) and is told about their completion through the BIGATTJobQueueDid... functions. Time only advances
+ *  with the timestamps passed in, so call BIGATTJobQueueAdvance() periodically (e.g. every 100 ms) for timeouts and
+ *  retries to happen.
+ *
+ *  The queue is not thread-safe. Transport functions and handlers are called synchronously; transport functions must
+ *  not report completions before they return, and handlers must not call back into the queue.
+ */
+typedef struct BIGATTJobQueue *BIGATTJobQueueRef;
+
+/**
+ *  A 128-bit Bluetooth UUID, most significant byte first.
+ */
+typedef struct {
+    uint8_t bytes[16];
+} BIGATTUUID;
+
+/**
+ *  Returns the 128-bit form of a 16-bit UUID assigned by the Bluetooth SIG (e.g. 0x180F for the battery service).
+ */
+BIGATTUUID BIGATTUUIDMakeShort(uint16_t shortUUID);
+
+/**
+ *  Parses a UUID string, either a 16-bit UUID of 4 hex digits ("2A19") or a full UUID
+ *  ("F0018B9B-7509-4C31-A905-1A27D39C003C"), like +[CBUUID UUIDWithString:].
+ *
+ *  @return true on success, false if the string is not a valid UUID. uuid is left unchanged on failure.
+ */
+bool BIGATTUUIDSetString(BIGATTUUID *uuid, const char *string);
+
+bool BIGATTUUIDEqual(const BIGATTUUID *uuid1, const BIGATTUUID *uuid2);
+
+/**
+ *  A characteristic to read, identified by its service and characteristic UUIDs.
+ */
+typedef struct {
+    BIGATTUUID service;
+    BIGATTUUID characteristic;
+} BIGATTCharacteristicPath;
+
+typedef enum {
+    BIGATTStatusSuccess = 0,
+    BIGATTStatusError = 1,
+    BIGATTStatusNotFound = 2,
+    BIGATTStatusTimedOut = 3,
+    BIGATTStatusDisconnected = 4,
+    BIGATTStatusCancelled = 5,
+    BIGATTStatusPending = 6
+} BIGATTStatus;
+
+/**
+ *  Operations the queue issues. Devices are identified by the IDs passed to BIGATTJobQueueStart(). Every operation
+ *  except disconnect must eventually be completed by the matching BIGATTJobQueueDid... function, unless the device is
+ *  disconnected in the meantime.
+ *
+ *  writeValue is only used by the beacon provisioner (BIBeaconProvisioner.h) and may be NULL for a job queue. value is
+ *  only valid during the call.
+ */
+typedef struct {
+    void (*connect)(uint32_t deviceID, void *context);
+    void (*disconnect)(uint32_t deviceID, void *context);
+    void (*discoverServices)(uint32_t deviceID, const BIGATTUUID *services, size_t serviceCount, void *context);
+    void (*discoverCharacteristics)(uint32_t deviceID, const BIGATTUUID *service, const BIGATTUUID *characteristics,
+                                    size_t characteristicCount, void *context);
+    void (*readValue)(uint32_t deviceID, const BIGATTCharacteristicPath *path, void *context);
+    void (*writeValue)(uint32_t deviceID, const BIGATTCharacteristicPath *path, const uint8_t *value, size_t length,
+                       void *context);
+} BIGATTTransport;
+
+typedef struct {
+    uint32_t deviceID;
+
+    /**
+     *  BIGATTStatusSuccess if all characteristics have a final status, otherwise the reason of the last failed attempt,
+     *  or BIGATTStatusPending if the device has not been finished yet.
+     */
+    BIGATTStatus status;
+    uint32_t attempts;
+    double startedAt;
+    double finishedAt;
+    size_t valuesRead;
+} BIGATTDeviceResult;
+
+/**
+ *  Handlers, both of which may be NULL. deviceFinished is called once per device when it succeeds or runs out of
+ *  attempts, jobFinished once all devices are finished.
+ */
+typedef struct {
+    void (*deviceFinished)(const BIGATTDeviceResult *result, void *context);
+    void (*jobFinished)(void *context);
+} BIGATTJobHandlers;
+
+typedef struct {
+    /**
+     *  Number of devices that are connected (or being connected to) at the same time.
+     */
+    uint32_t maximumConnections;
+
+    /**
+     *  Number of connection attempts per device.
+     */
+    uint32_t maximumAttempts;
+
+    /**
+     *  Times (in seconds) after which connecting to a device and a whole attempt time out.
+     */
+    double connectTimeout;
+    double deviceTimeout;
+
+    /**
+     *  Time (in seconds) between a failed attempt and the next one.
+     */
+    double retryDelay;
+
+    /**
+     *  Receives the connection and device latencies and the attempt, timeout and failure counters (see BIMetrics.h),
+     *  or NULL.
+     */
+    BIMetricsRef metrics;
+} BIGATTJobConfiguration;
+
+typedef struct {
+    uint64_t devicesSucceeded;
+    uint64_t devicesFailed;
+    uint64_t connectionAttempts;
+    uint64_t timeouts;
+    uint64_t disconnections;
+    uint64_t valuesRead;
+} BIGATTJobStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: 4 connections, 3 attempts per device, timeouts of 5 seconds
+ *  (connecting) and 15 seconds (attempt), and a retry delay of 2 seconds.
+ */
+BIGATTJobConfiguration BIGATTJobConfigurationMakeDefault(void);
+
+/**
+ *  Creates a job queue.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param transport Performs the operations. Copied.
+ *  @param handlers Receive the results.
+ *  @param context Passed to the transport functions and handlers.
+ */
+BIGATTJobQueueRef BIGATTJobQueueCreate(const BIGATTJobConfiguration *configuration, const BIGATTTransport *transport,
+                                       BIGATTJobHandlers handlers, void *context);
+
+/**
+ *  Destroys a queue. Devices that are still connected are not disconnected.
+ */
+void BIGATTJobQueueDestroy(BIGATTJobQueueRef queue);
+
+/**
+ *  Starts reading characteristics from devices. Devices are started in the given order. The results of the previous
+ *  job are discarded.
+ *
+ *  @return false if the previous job has not finished yet.
+ */
+bool BIGATTJobQueueStart(BIGATTJobQueueRef queue, double timestamp, const uint32_t *deviceIDs, size_t deviceCount,
+                         const BIGATTCharacteristicPath *characteristics, size_t characteristicCount);
+
+/**
+ *  Disconnects all devices and finishes the job; unfinished devices get the status BIGATTStatusCancelled.
+ */
+void BIGATTJobQueueCancel(BIGATTJobQueueRef queue, double timestamp);
+
+/**
+ *  Handles timeouts and retries that are due at timestamp.
+ */
+void BIGATTJobQueueAdvance(BIGATTJobQueueRef queue, double timestamp);
+
+void BIGATTJobQueueDidConnect(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp, BIGATTStatus status);
+
+/**
+ *  Reports that a device disconnected without having been asked to.
+ */
+void BIGATTJobQueueDidDisconnect(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp);
+
+/**
+ *  Reports the result of a service discovery. services lists the requested services the device has.
+ */
+void BIGATTJobQueueDidDiscoverServices(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp, BIGATTStatus status,
+                                       const BIGATTUUID *services, size_t serviceCount);
+
+/**
+ *  Reports the result of a characteristic discovery. characteristics lists the requested characteristics the service
+ *  has.
+ */
+void BIGATTJobQueueDidDiscoverCharacteristics(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp,
+                                              const BIGATTUUID *service, BIGATTStatus status,
+                                              const BIGATTUUID *characteristics, size_t characteristicCount);
+
+void BIGATTJobQueueDidReadValue(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp,
+                                const BIGATTCharacteristicPath *path, BIGATTStatus status, const uint8_t *value,
+                                size_t length);
+
+bool BIGATTJobQueueIsFinished(BIGATTJobQueueRef queue);
+
+/**
+ *  Returns the number of devices of the current job.
+ */
+size_t BIGATTJobQueueGetDeviceCount(BIGATTJobQueueRef queue);
+
+/**
+ *  Returns the result of the device at index (in the order passed to BIGATTJobQueueStart()).
+ */
+BIGATTDeviceResult BIGATTJobQueueGetDeviceResult(BIGATTJobQueueRef queue, size_t deviceIndex);
+
+/**
+ *  Returns the status of a characteristic of a device and, if it was read, its value. value stays valid until the
+ *  next job is started or the queue is destroyed; values read later in the job do not move it.
+ */
+BIGATTStatus BIGATTJobQueueGetValue(BIGATTJobQueueRef queue, size_t deviceIndex, size_t characteristicIndex,
+                                    const uint8_t **value, size_t *length);
+
+BIGATTJobStatistics BIGATTJobQueueGetStatistics(BIGATTJobQueueRef queue);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,190 @@
+//
+//  BIIngestion.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_INGESTION_H
+#define BICORE_INGESTION_H
+
+#include "BICoreTypes.h"
+#include "BIUpload.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The ingestion aggregator turns the uploads of many devices (see BIUpload.h) into footfall and dwell statistics per
+ *  beacon and per zone. It is meant for backends and builds on any platform with a C++17 compiler.
+ *
+ *  A visit is a run of sightings of the same beacon (or of any beacon of the same zone) by the same device, with at
+ *  most visitGap seconds between two sightings. Footfall is the number of visits; the dwell time of a visit is the time
+ *  from its first to its last sighting.
+ *
+ *  Devices are spread over threadCount shards by their ID, and each shard is processed by its own thread, so the
+ *  statistics do not depend on the number of threads. The uploads of a device passed in one call are processed in the
+ *  order of their sequence numbers; uploads whose sequence number was already seen for the device are skipped, so
+ *  uploads can be retried safely. Per device, the aggregator tells apart the last sequenceWindow sequence numbers up
+ *  to the highest one it has seen; older ones count as seen. Sightings that are older than the previous sighting of the
+ *  same beacon or zone by the same device (e.g. from an upload that arrives late) only count as sightings. Region event
+ *  uploads are accepted but carry no sightings; they only count as uploads.
+ *
+ *  Devices stay known until they are expired with BIIngestionAggregatorExpireDevices(). A device that uploads again
+ *  after it expired counts as a new device, and its retried uploads are no longer recognized, so deviceTimeout should
+ *  be longer than a device keeps retrying an upload.
+ *
+ *  The aggregator is not thread-safe.
+ */
+typedef struct BIIngestionAggregator *BIIngestionAggregatorRef;
+
+/**
+ *  Places a beacon in a zone. A beacon may belong to several zones.
+ */
+typedef struct {
+    BIBeaconKey key;
+    uint32_t zoneID;
+} BIIngestionZoneMember;
+
+typedef struct {
+    /**
+     *  Number of shards and threads. Pass 0 to use one per core.
+     */
+    uint32_t threadCount;
+
+    /**
+     *  Maximum time (in seconds) between two sightings of the same visit.
+     */
+    double visitGap;
+
+    /**
+     *  Sightings with a weaker (or unknown) RSSI are ignored. Pass 0 to count all sightings.
+     */
+    int32_t minimumRSSI;
+
+    /**
+     *  Number of sequence numbers up to a device's highest one that are told apart. An upload that lags further behind
+     *  is skipped as a duplicate. Rounded up to a multiple of 64; each device takes sequenceWindow / 8 bytes for it.
+     *  Region event uploads are sent before older sighting uploads, so this should cover the uploads a device can
+     *  queue while it is offline.
+     */
+    uint32_t sequenceWindow;
+
+    /**
+     *  Time (in seconds) after the end of its newest upload after which BIIngestionAggregatorExpireDevices() forgets
+     *  a device.
+     */
+    double deviceTimeout;
+} BIIngestionConfiguration;
+
+/**
+ *  An upload passed to the aggregator. The bytes are not copied.
+ */
+typedef struct {
+    const uint8_t *bytes;
+    size_t length;
+} BIUploadBuffer;
+
+typedef struct {
+    uint64_t sightings;
+    uint64_t visits;
+
+    /**
+     *  Number of distinct devices that visited.
+     */
+    uint64_t devices;
+
+    /**
+     *  Total dwell time of all visits, in seconds.
+     */
+    double dwellTime;
+} BIIngestionTotals;
+
+typedef struct {
+    BIBeaconKey key;
+    BIIngestionTotals totals;
+} BIIngestionBeaconStatistics;
+
+typedef struct {
+    uint32_t zoneID;
+    BIIngestionTotals totals;
+} BIIngestionZoneStatistics;
+
+typedef struct {
+    uint64_t uploads;
+
+    /**
+     *  Uploads that were malformed, and uploads that were skipped because their sequence number was already seen or
+     *  is older than the sequence window.
+     */
+    uint64_t rejectedUploads;
+    uint64_t duplicateUploads;
+
+    /**
+     *  Sightings of the accepted uploads, including the ignored ones.
+     */
+    uint64_t sightings;
+
+    /**
+     *  Devices the aggregator started to track, and devices it forgot because they were idle.
+     */
+    uint64_t devices;
+    uint64_t expiredDevices;
+} BIIngestionStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: one thread per core, a visit gap of 60 seconds, all sightings
+ *  counted, a sequence window of 4096 and a device timeout of 7 days.
+ */
+BIIngestionConfiguration BIIngestionConfigurationMakeDefault(void);
+
+/**
+ *  Creates an aggregator.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param zones The zones of the beacons, or NULL. Beacons without a zone only count in the beacon statistics.
+ */
+BIIngestionAggregatorRef BIIngestionAggregatorCreate(const BIIngestionConfiguration *configuration,
+                                                     const BIIngestionZoneMember *zones, size_t zoneMemberCount);
+
+void BIIngestionAggregatorDestroy(BIIngestionAggregatorRef aggregator);
+
+/**
+ *  Decodes and aggregates uploads and returns when all of them are processed. Malformed uploads are skipped as a
+ *  whole.
+ *
+ *  @return The number of uploads that were aggregated.
+ */
+size_t BIIngestionAggregatorAddUploads(BIIngestionAggregatorRef aggregator, const BIUploadBuffer *uploads,
+                                       size_t count);
+
+/**
+ *  Copies the statistics of the beacons in zones and of every other beacon of an aggregated upload, sorted by UUID,
+ *  major and minor.
+ *
+ *  @return The number of beacons. If it is larger than capacity, only the first capacity beacons were copied.
+ */
+size_t BIIngestionAggregatorCopyBeacons(BIIngestionAggregatorRef aggregator, BIIngestionBeaconStatistics *beacons,
+                                        size_t capacity);
+
+/**
+ *  Copies the statistics of every zone, in the order the zones first appear in the zone members.
+ *
+ *  @return The number of zones. If it is larger than capacity, only the first capacity zones were copied.
+ */
+size_t BIIngestionAggregatorCopyZones(BIIngestionAggregatorRef aggregator, BIIngestionZoneStatistics *zones,
+                                      size_t capacity);
+
+/**
+ *  Forgets the devices whose newest upload ended more than deviceTimeout seconds before now, with their sequence
+ *  numbers and last sightings. Their visits stay counted. Takes time linear in the number of devices; call it e.g.
+ *  once an hour.
+ *
+ *  @return The number of devices that were forgotten.
+ */
+size_t BIIngestionAggregatorExpireDevices(BIIngestionAggregatorRef aggregator, double now);
+
+BIIngestionStatistics BIIngestionAggregatorGetStatistics(BIIngestionAggregatorRef aggregator);
+
+BI_EXTERN_C_END
+
+#endif
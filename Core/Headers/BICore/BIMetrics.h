@@ -0,0 +1,230 @@
+//
+//  BIMetrics.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_METRICS_H
+#define BICORE_METRICS_H
+
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  Metrics collect latency histograms and counters from the ranging pipeline, region monitors and GATT job queues
+ *  they are passed to (see the metrics field of their configurations), so that late callbacks can be attributed to
+ *  Core Location, the SDK or the app's handlers.
+ *
+ *  Histograms are log-linear like HdrHistogram: values below 64 are counted exactly, larger values in 32 buckets per
+ *  power of two, so that percentiles are reported with a relative error of at most 1/32 (3%). Values up to 2^48 are
+ *  tracked; larger values are counted as 2^48 - 1. Recording a value or incrementing a counter is a few relaxed atomic
+ *  operations and never blocks or allocates, so metrics may be recorded from any thread. The ranging pipeline adds its
+ *  latencies and tick counters in batches of up to 16 ticks, when it goes idle and before the dumps it triggers, so a
+ *  snapshot taken in between may not include its latest ticks yet.
+ *
+ *  Snapshots and dumps are cumulative since the metrics were created or reset. Dumps are passed to the dump handler
+ *  every dumpInterval seconds by BIMetricsDumpIfDue(), which the ranging pipeline calls after every tick, either as
+ *  JSON or in a compact binary format:
+ *
+ *  - the 4 bytes "BIM" and a version byte (1),
+ *  - the number of counters, then every counter,
+ *  - the number of histograms, then per histogram the sum, minimum and maximum of its values, the number of non-empty
+ *    buckets and, for every non-empty bucket, the difference of its index to the previous non-empty bucket's index (or
+ *    to -1) and its count.
+ *
+ *  All integers are LEB128 varints. A binary dump takes a few hundred bytes and can be merged into other metrics with
+ *  BIMetricsMergeBinary(), e.g. to aggregate the dumps of many devices.
+ */
+typedef struct BIMetrics *BIMetricsRef;
+
+/**
+ *  Latency histograms are in nanoseconds.
+ */
+typedef enum {
+    /**
+     *  From the first ranging report of a tick to the start of its processing: coalescing with the other regions and
+     *  waiting for the worker thread.
+     */
+    BIMetricsHistogramQueueing = 0,
+
+    /**
+     *  Processing the tick in the regions' smoothing engines.
+     */
+    BIMetricsHistogramSmoothing = 1,
+
+    /**
+     *  Updating the nearest beacon trackers.
+     */
+    BIMetricsHistogramNearestBeacon = 2,
+
+    /**
+     *  From handing the batch to the delivery queue to the start of the handler.
+     */
+    BIMetricsHistogramDispatch = 3,
+
+    /**
+     *  Running the batch handler.
+     */
+    BIMetricsHistogramHandler = 4,
+
+    /**
+     *  From the first ranging report of a tick to the return of the batch handler.
+     */
+    BIMetricsHistogramEndToEnd = 5,
+
+    /**
+     *  Beacons reported in a tick, over all regions (a count, not a latency).
+     */
+    BIMetricsHistogramBeaconsPerTick = 6,
+
+    /**
+     *  From starting a connection attempt to the connection, and from the first attempt to finishing a device, in the
+     *  time of the timestamps passed to the GATT job queue.
+     */
+    BIMetricsHistogramGATTConnect = 7,
+    BIMetricsHistogramGATTDevice = 8,
+
+    /**
+     *  Building the batch of a tick's ranged beacons after the nearest beacon trackers were updated. Ticks whose batch
+     *  is dropped do not record it.
+     */
+    BIMetricsHistogramBatchAssembly = 9,
+
+    BIMetricsHistogramCount = 10
+} BIMetricsHistogram;
+
+typedef enum {
+    BIMetricsCounterTicks = 0,
+    BIMetricsCounterSamples = 1,
+
+    /**
+     *  Ticks that were completed by the coalescing timeout because a region did not report.
+     */
+    BIMetricsCounterLateTicks = 2,
+
+    /**
+     *  Batches that were dropped because the delivery queue fell behind.
+     */
+    BIMetricsCounterDroppedBatches = 3,
+
+    /**
+     *  Region events reported to region monitors, and enter and exit transitions they delivered.
+     */
+    BIMetricsCounterRegionEvents = 4,
+    BIMetricsCounterRegionTransitions = 5,
+
+    /**
+     *  Connection attempts and timed out attempts of GATT job queues, and devices that finished with an error other
+     *  than being cancelled.
+     */
+    BIMetricsCounterGATTAttempts = 6,
+    BIMetricsCounterGATTTimeouts = 7,
+    BIMetricsCounterGATTFailures = 8,
+
+    BIMetricsCounterCount = 9
+} BIMetricsCounter;
+
+typedef enum {
+    BIMetricsDumpFormatJSON = 0,
+    BIMetricsDumpFormatBinary = 1
+} BIMetricsDumpFormat;
+
+/**
+ *  Receives a dump. The bytes are only valid during the call; JSON dumps are not NUL-terminated.
+ */
+typedef void (*BIMetricsDumpHandler)(const uint8_t *bytes, size_t length, void *context);
+
+typedef struct {
+    /**
+     *  Time (in seconds) between two dumps. Pass 0 to only dump on BIMetricsDump().
+     */
+    double dumpInterval;
+
+    BIMetricsDumpFormat dumpFormat;
+} BIMetricsConfiguration;
+
+typedef struct {
+    uint64_t count;
+    uint64_t minimum;
+    uint64_t maximum;
+    double mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+} BIHistogramSnapshot;
+
+typedef struct {
+    uint64_t counters[BIMetricsCounterCount];
+    BIHistogramSnapshot histograms[BIMetricsHistogramCount];
+} BIMetricsSnapshot;
+
+/**
+ *  Returns the configuration the SDK uses by default: a JSON dump every 60 seconds.
+ */
+BIMetricsConfiguration BIMetricsConfigurationMakeDefault(void);
+
+/**
+ *  Creates metrics.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param handler Receives the dumps. May be NULL.
+ *  @param context Passed to handler.
+ */
+BIMetricsRef BIMetricsCreate(const BIMetricsConfiguration *configuration, BIMetricsDumpHandler handler, void *context);
+
+/**
+ *  Destroys the metrics. Everything they were passed to must have been destroyed before.
+ */
+void BIMetricsDestroy(BIMetricsRef metrics);
+
+/**
+ *  Records a value, e.g. the time the app's own handlers take.
+ */
+void BIMetricsRecord(BIMetricsRef metrics, BIMetricsHistogram histogram, uint64_t value);
+
+void BIMetricsIncrement(BIMetricsRef metrics, BIMetricsCounter counter, uint64_t delta);
+
+/**
+ *  Retrieves the current counters and histogram summaries. Values recorded concurrently may or may not be included.
+ */
+void BIMetricsGetSnapshot(BIMetricsRef metrics, BIMetricsSnapshot *snapshot);
+
+/**
+ *  Returns the value below which percentile percent (0-100) of the recorded values of a histogram lie, or 0 if the
+ *  histogram is empty.
+ */
+uint64_t BIMetricsGetValueAtPercentile(BIMetricsRef metrics, BIMetricsHistogram histogram, double percentile);
+
+/**
+ *  Clears all histograms and counters.
+ */
+void BIMetricsReset(BIMetricsRef metrics);
+
+/**
+ *  Passes a dump to the dump handler if dumpInterval seconds have passed since the previous one. The first call starts
+ *  the first interval.
+ *
+ *  @return true if a dump was made.
+ */
+bool BIMetricsDumpIfDue(BIMetricsRef metrics, double timestamp);
+
+/**
+ *  Writes a dump into buffer.
+ *
+ *  @return The length of the complete dump. If it is larger than capacity, only the first capacity bytes were written.
+ */
+size_t BIMetricsDump(BIMetricsRef metrics, BIMetricsDumpFormat format, uint8_t *buffer, size_t capacity);
+
+/**
+ *  Adds the counters and histograms of a binary dump to metrics.
+ *
+ *  @return false if the dump is malformed. Nothing is added in that case.
+ */
+bool BIMetricsMergeBinary(BIMetricsRef metrics, const uint8_t *bytes, size_t length);
+
+BI_EXTERN_C_END
+
+#endif
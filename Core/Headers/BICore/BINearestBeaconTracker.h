@@ -0,0 +1,117 @@
+//
+//  BINearestBeaconTracker.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_NEAREST_BEACON_TRACKER_H
+#define BICORE_NEAREST_BEACON_TRACKER_H
+
+#include "BIBeaconTable.h"
+#include "BICoreTypes.h"
+#include "BISpatialIndex.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The nearest beacon tracker decides which beacon of a region BINearestBeaconUpdateHandler reports.
+ *
+ *  The tracker keeps the beacons that are in range in a heap ordered by smoothed RSSI (strongest first), then by
+ *  smoothed accuracy (smallest first). Feeding it a beacon whose ranking did not change costs O(1); a changed or new
+ *  beacon costs O(log n). Nothing is rescanned per tick.
+ *
+ *  The strongest beacon only replaces the current nearest beacon when
+ *
+ *  - its smoothed RSSI exceeds the current nearest beacon's by at least hysteresisMargin dB, and
+ *  - the current nearest beacon has been the nearest beacon for at least minimumDwellTime seconds.
+ *
+ *  If the current nearest beacon goes out of range (or is removed), the strongest beacon takes over immediately. With
+ *  a margin and dwell time of 0 the tracker always reports the strongest beacon.
+ *
+ *  Beacons can be given their location on the venue map. While the current nearest beacon is in range, a located
+ *  beacon on another floor or more than maximumJump meters away from it cannot replace it, as the device cannot have
+ *  moved there within a tick; the strongest beacon that can takes its place as the challenger. Beacons without a
+ *  location are always candidates.
+ *
+ *  The tracker is not thread-safe.
+ */
+typedef struct BINearestBeaconTracker *BINearestBeaconTrackerRef;
+
+typedef struct {
+    /**
+     *  RSSI difference (in dB) by which another beacon must be stronger than the current nearest beacon to replace it.
+     */
+    double hysteresisMargin;
+
+    /**
+     *  Time (in seconds) a beacon stays the nearest beacon at least, unless it goes out of range.
+     */
+    double minimumDwellTime;
+
+    /**
+     *  Distance (in meters) from the current nearest beacon beyond which a located beacon cannot replace it. 0 disables
+     *  the check, including the one for the floor.
+     */
+    double maximumJump;
+} BINearestBeaconTrackerConfiguration;
+
+/**
+ *  Returns the configuration the SDK uses by default: a margin of 3 dB, a dwell time of 3 seconds and a maximum jump
+ *  of 20 m.
+ */
+BINearestBeaconTrackerConfiguration BINearestBeaconTrackerConfigurationMakeDefault(void);
+
+/**
+ *  Creates a tracker.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ */
+BINearestBeaconTrackerRef BINearestBeaconTrackerCreate(const BINearestBeaconTrackerConfiguration *configuration);
+
+void BINearestBeaconTrackerDestroy(BINearestBeaconTrackerRef tracker);
+
+/**
+ *  Sets the current smoothed signal of a beacon. A signal that is not in range removes the beacon.
+ */
+void BINearestBeaconTrackerUpdate(BINearestBeaconTrackerRef tracker, BIBeaconHandle handle, const BISignal *smoothedSignal);
+
+/**
+ *  Removes a beacon, e.g. because its handle got evicted from the beacon table.
+ */
+void BINearestBeaconTrackerRemove(BINearestBeaconTrackerRef tracker, BIBeaconHandle handle);
+
+/**
+ *  Sets the location of a beacon on the venue map, or forgets it if location is NULL. The location is forgotten when
+ *  the beacon is removed or goes out of range.
+ */
+void BINearestBeaconTrackerSetLocation(BINearestBeaconTrackerRef tracker, BIBeaconHandle handle,
+                                       const BIBeaconLocation *location);
+
+/**
+ *  Applies the hysteresis rules after the updates of a tick.
+ *
+ *  @return true if the nearest beacon changed.
+ */
+bool BINearestBeaconTrackerEvaluate(BINearestBeaconTrackerRef tracker, double timestamp);
+
+/**
+ *  Returns the nearest beacon as of the last evaluation, or BIBeaconHandleInvalid if no beacon is in range.
+ */
+BIBeaconHandle BINearestBeaconTrackerGetNearest(BINearestBeaconTrackerRef tracker);
+
+/**
+ *  Copies the handles of the k strongest beacons, strongest first, in O(k log k). Does not apply hysteresis.
+ *
+ *  @return The number of handles copied.
+ */
+size_t BINearestBeaconTrackerCopyStrongest(BINearestBeaconTrackerRef tracker, BIBeaconHandle *handles, size_t k);
+
+/**
+ *  Returns the number of beacons in range.
+ */
+size_t BINearestBeaconTrackerGetCount(BINearestBeaconTrackerRef tracker);
+
+BI_EXTERN_C_END
+
+#endif
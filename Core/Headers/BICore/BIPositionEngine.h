@@ -0,0 +1,174 @@
+//
+//  BIPositionEngine.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_POSITION_ENGINE_H
+#define BICORE_POSITION_ENGINE_H
+
+#include "BICoreTypes.h"
+#include "BIRangingPipeline.h"
+#include "BISpatialIndex.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The position engine turns the smoothed distances of a ranging tick into an x/y position on a floor map.
+ *
+ *  Each tick is solved on its own by weighted least-squares trilateration: Gauss-Newton iterations minimize the sum of
+ *  the squared differences between the distances to the mapped beacons and their smoothed accuracies, each weighted by
+ *  the inverse variance of the distance (distances get less reliable the longer they are, see rangeError). The fix
+ *  needs at least three mapped beacons in range that are not all on one line.
+ *
+ *  A particle filter then tracks the position over time: particles move by a random walk at walking speed between
+ *  ticks, and are weighted by the likelihood of the raw distances reported in the tick (the filter does its own
+ *  smoothing over time, and smoothed distances would make it lag behind a walking user twice). It starts from the first
+ *  fix, keeps producing positions on ticks with fewer than three beacons, and starts over from the fix when no particle
+ *  explains the distances any more.
+ *
+ *  Beacons may be on several floors. A tick is placed on the floor whose beacons are nearest (weighted as in the fix),
+ *  and beacons on other floors are ignored. Once the filter has a position, beacons that cannot be heard from it,
+ *  i.e. that are farther away than maximumRange plus three times the uncertainty and the distance walked since, are
+ *  ignored too; if that would be most of the beacons of the tick, the filter is lost and starts over instead.
+ *
+ *  Both estimates come with a covariance. All buffers are allocated when the engine is created; a tick allocates
+ *  nothing. The particle filter draws from its own seeded generator, so replaying the same ticks gives the same
+ *  positions.
+ *
+ *  The engine is not thread-safe.
+ */
+typedef struct BIPositionEngine *BIPositionEngineRef;
+
+typedef struct {
+    /**
+     *  false if there was not enough information for an estimate; the other fields are undefined then.
+     */
+    bool valid;
+
+    double x;
+    double y;
+    int32_t floor;
+
+    /**
+     *  Covariance of x and y, in square meters.
+     */
+    double covarianceXX;
+    double covarianceXY;
+    double covarianceYY;
+
+    /**
+     *  Root of the summed variances of x and y (the distance root mean square error), in meters.
+     */
+    double uncertainty;
+
+    /**
+     *  Number of mapped beacons whose distances went into the estimate.
+     */
+    uint32_t beaconCount;
+} BIPositionEstimate;
+
+typedef struct {
+    double timestamp;
+
+    /**
+     *  The trilateration of this tick alone.
+     */
+    BIPositionEstimate fix;
+
+    /**
+     *  The particle filter's estimate after this tick.
+     */
+    BIPositionEstimate filtered;
+
+    /**
+     *  Number of Gauss-Newton iterations the fix took.
+     */
+    uint32_t iterations;
+} BIPosition;
+
+typedef struct {
+    /**
+     *  Standard deviation of a distance as a fraction of the distance, and the lower bound of the standard deviation in
+     *  meters.
+     */
+    double rangeError;
+    double minimumRangeError;
+
+    /**
+     *  Beacons farther away than this (in meters) are ignored.
+     */
+    double maximumRange;
+
+    /**
+     *  Gauss-Newton stops after this many iterations, or once a step is shorter than convergenceThreshold meters.
+     */
+    uint32_t maximumIterations;
+    double convergenceThreshold;
+
+    /**
+     *  Number of particles. 0 disables the particle filter.
+     */
+    uint32_t particleCount;
+
+    /**
+     *  Standard deviation of the distance (in meters) the device moves per second, used to spread the particles between
+     *  ticks.
+     */
+    double walkingSpeed;
+
+    /**
+     *  Seed of the particle filter's random number generator.
+     */
+    uint64_t seed;
+} BIPositionEngineConfiguration;
+
+/**
+ *  Returns the configuration the SDK uses by default: distances within 30 m with an error of 50% (at least 0.5 m), at
+ *  most 10 iterations to 1 cm, and 500 particles at a walking speed of 1.4 m/s.
+ */
+BIPositionEngineConfiguration BIPositionEngineConfigurationMakeDefault(void);
+
+/**
+ *  Creates a position engine for a floor map.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param beacons The beacons of the map. A beacon that appears more than once keeps its last location.
+ */
+BIPositionEngineRef BIPositionEngineCreate(const BIPositionEngineConfiguration *configuration,
+                                           const BIBeaconLocation *beacons, size_t beaconCount);
+
+/**
+ *  Creates a position engine that uses a spatial index shared with other users, e.g. ranging pipelines. The index is
+ *  not copied and must outlive the engine.
+ */
+BIPositionEngineRef BIPositionEngineCreateWithSpatialIndex(const BIPositionEngineConfiguration *configuration,
+                                                           BISpatialIndexRef index);
+
+void BIPositionEngineDestroy(BIPositionEngineRef engine);
+
+/**
+ *  Solves one ranging tick. Beacons that are not on the map, not in range or farther away than maximumRange are
+ *  ignored. The accuracies of the smoothed signals are the distances of the fix, those of the raw signals the distances
+ *  of the particle filter.
+ *
+ *  @param timestamp The time of the tick. Must not be earlier than the previous tick.
+ */
+BIPosition BIPositionEngineUpdate(BIPositionEngineRef engine, double timestamp, const BIRangedBeacon *beacons,
+                                  size_t beaconCount);
+
+/**
+ *  Solves a ranging batch, using the beacons of all its regions. A beacon that is ranged in several regions is used
+ *  once.
+ */
+BIPosition BIPositionEngineUpdateWithBatch(BIPositionEngineRef engine, const BIRangingBatch *batch);
+
+/**
+ *  Forgets the particle filter's state, e.g. after the device left the mapped area. The next tick starts from its fix.
+ */
+void BIPositionEngineReset(BIPositionEngineRef engine);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,200 @@
+//
+//  BIRangingPipeline.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_RANGING_PIPELINE_H
+#define BICORE_RANGING_PIPELINE_H
+
+#include "BIBeaconTable.h"
+#include "BICoreTypes.h"
+#include "BIMetrics.h"
+#include "BINearestBeaconTracker.h"
+#include "BISmoothingEngine.h"
+#include "BISpatialIndex.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The ranging pipeline moves the per-tick work of ranging off the thread that receives the ranging callbacks (e.g.
+ *  those of CLLocationManager).
+ *
+ *  Ranging reports of all regions are handed to the pipeline with BIRangingPipelineSubmit(), which only copies the
+ *  samples. A private worker thread runs smoothing and nearest-beacon selection and coalesces the reports of all regions
+ *  that belong to the same ranging tick into a single BIRangingBatch. The batch is delivered to a handler on the queue
+ *  the caller supplies.
+ *
+ *  A tick is complete when every region added to the pipeline has reported, when a region reports a second time, or
+ *  when coalescingTimeout seconds have passed since the first report of the tick, whichever happens first.
+ *
+ *  BIRangingPipelineSubmit(), BIRangingPipelineAddRegion(), BIRangingPipelineRemoveRegion() and
+ *  BIRangingPipelineFlush() must be called from one thread at a time, typically the one that receives the ranging
+ *  callbacks.
+ */
+typedef struct BIRangingPipeline *BIRangingPipelineRef;
+
+typedef void (*BIWorkFunction)(void *context);
+
+/**
+ *  Schedules work(context) asynchronously on queue. Has the same signature as dispatch_async_f(), so a GCD queue can
+ *  be used by passing dispatch_async_f and the dispatch_queue_t.
+ */
+typedef void (*BIDispatchFunction)(void *queue, void *context, BIWorkFunction work);
+
+typedef struct {
+    BIDispatchFunction dispatch;
+    void *queue;
+} BIDeliveryQueue;
+
+/**
+ *  One beacon in a region's ranging result.
+ */
+typedef struct {
+    BIBeaconHandle handle;
+    BIBeaconKey key;
+    BISignal smoothedSignal;
+    BISignal rawSignal;
+} BIRangedBeacon;
+
+/**
+ *  The result of one region in a ranging tick.
+ */
+typedef struct {
+    uint32_t regionID;
+
+    /**
+     *  All beacons the region's smoothing engine tracks: the beacons in range sorted by smoothed RSSI (strongest first),
+     *  followed by the beacons that are currently not in range. This is the list passed to
+     *  BIContinuousRangingUpdateHandler.
+     */
+    const BIRangedBeacon *beacons;
+    size_t beaconCount;
+
+    /**
+     *  The beacon nearest to the device as decided by the region's nearest beacon tracker (see
+     *  BINearestBeaconTracker.h), or NULL if no beacon is in range. Points into beacons.
+     */
+    const BIRangedBeacon *nearestBeacon;
+
+    /**
+     *  true if the nearest beacon differs from the one in the previous delivered batch (this is when BINearestBeaconUpdateHandler fires).
+     */
+    bool nearestBeaconChanged;
+} BIRegionRangingResult;
+
+/**
+ *  All region results of one ranging tick. Only valid for the duration of the handler call.
+ */
+typedef struct {
+    uint64_t sequenceNumber;
+    double timestamp;
+    const BIRegionRangingResult *regions;
+    size_t regionCount;
+} BIRangingBatch;
+
+typedef void (*BIRangingBatchHandler)(const BIRangingBatch *batch, void *context);
+
+typedef struct {
+    /**
+     *  The smoothing configuration of regions added with BIRangingPipelineAddRegion().
+     */
+    BISmoothingConfiguration smoothing;
+    BIBeaconTableConfiguration beaconTable;
+    BINearestBeaconTrackerConfiguration nearestBeacon;
+
+    /**
+     *  Maximum time (in seconds) the pipeline waits for the remaining regions of a tick after the first report.
+     */
+    double coalescingTimeout;
+
+    /**
+     *  Number of batches that may wait for delivery at the same time. If the delivery queue falls further behind, batches
+     *  are dropped (the next delivered batch carries the complete current state).
+     */
+    uint32_t maximumPendingDeliveries;
+
+    /**
+     *  Processes ticks and calls the handler on the submitting thread instead of using a worker thread and the delivery
+     *  queue. Useful for deterministic replays.
+     */
+    bool synchronous;
+
+    /**
+     *  Receives the stage latencies, tick counters and dumps of the pipeline (see BIMetrics.h), or NULL. They are added
+     *  in batches of 16 ticks, and all of them once the pipeline is destroyed.
+     */
+    BIMetricsRef metrics;
+
+    /**
+     *  The venue map, or NULL. The nearest beacon trackers learn the locations of the beacons from it and ignore
+     *  physically impossible changes of the nearest beacon (see BINearestBeaconTracker.h). The index is not copied and
+     *  must outlive the pipeline.
+     */
+    BISpatialIndexRef spatialIndex;
+} BIRangingPipelineConfiguration;
+
+typedef struct {
+    uint64_t ticksProcessed;
+    uint64_t batchesDelivered;
+    uint64_t batchesDropped;
+} BIRangingPipelineStatistics;
+
+BIRangingPipelineConfiguration BIRangingPipelineConfigurationMakeDefault(void);
+
+/**
+ *  Creates a ranging pipeline.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param deliveryQueue The queue on which handler gets called. Ignored in synchronous mode.
+ *  @param handler The function that receives the batches.
+ *  @param context Passed to handler.
+ */
+BIRangingPipelineRef BIRangingPipelineCreate(const BIRangingPipelineConfiguration *configuration, BIDeliveryQueue deliveryQueue,
+                                             BIRangingBatchHandler handler, void *context);
+
+/**
+ *  Stops the worker thread and destroys the pipeline. Batches that are still waiting on the delivery queue are
+ *  discarded. If the handler is running on another thread, this function waits for it to return. It is safe to call
+ *  this function from within the handler, except in synchronous mode.
+ */
+void BIRangingPipelineDestroy(BIRangingPipelineRef pipeline);
+
+/**
+ *  Adds a region that uses the pipeline's smoothing configuration and returns its ID.
+ */
+uint32_t BIRangingPipelineAddRegion(BIRangingPipelineRef pipeline);
+
+/**
+ *  Adds a region with its own smoothing configuration (e.g. a different filter) and returns its ID. Pass NULL to use
+ *  the pipeline's smoothing configuration.
+ */
+uint32_t BIRangingPipelineAddRegionWithSmoothing(BIRangingPipelineRef pipeline, const BISmoothingConfiguration *smoothing);
+
+/**
+ *  Removes a region. Its smoothing state is discarded.
+ */
+void BIRangingPipelineRemoveRegion(BIRangingPipelineRef pipeline, uint32_t regionID);
+
+/**
+ *  Submits the beacons CLLocationManager reported for a region in one ranging callback. The samples are copied.
+ */
+void BIRangingPipelineSubmit(BIRangingPipelineRef pipeline, uint32_t regionID, double timestamp, const BIBeaconSample *samples,
+                             size_t count);
+
+/**
+ *  Completes the current tick without waiting for the remaining regions.
+ */
+void BIRangingPipelineFlush(BIRangingPipelineRef pipeline);
+
+/**
+ *  Blocks until all submitted ticks have been processed (not necessarily delivered). No-op in synchronous mode.
+ */
+void BIRangingPipelineWaitUntilIdle(BIRangingPipelineRef pipeline);
+
+BIRangingPipelineStatistics BIRangingPipelineGetStatistics(BIRangingPipelineRef pipeline);
+
+BI_EXTERN_C_END
+
+#endif
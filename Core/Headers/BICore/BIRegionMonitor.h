@@ -0,0 +1,192 @@
+//
+//  BIRegionMonitor.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_REGION_MONITOR_H
+#define BICORE_REGION_MONITOR_H
+
+#include "BICoreTypes.h"
+#include "BIMetrics.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The region monitor turns the erratic enter/exit notifications of region monitoring into one deduplicated stream of
+ *  region transitions.
+ *
+ *  Region monitoring reports exits several seconds to minutes late, sometimes reports an exit and an enter within
+ *  seconds while the device does not move, and repeats enters and exits. The monitor keeps an explicit state per region
+ *  (unknown, inside or outside) and combines two kinds of evidence:
+ *
+ *  - monitoring evidence: didEnterRegion/didExitRegion events and determined states,
+ *  - ranging evidence: the number of the region's beacons in range after each ranging tick.
+ *
+ *  Entering: an enter event or an inside state confirms an entry immediately, because Core Location only reports them
+ *  after several detections. Ranging alone confirms an entry after enterConfidence consecutive ranging reports with
+ *  beacons in range (no more than exitGracePeriod seconds apart).
+ *
+ *  Exiting: an exit event, an outside state or a ranging report without beacons starts the exit grace period. Any
+ *  evidence of being inside during the grace period cancels the exit. Otherwise the exit is reported exitGracePeriod
+ *  seconds after the first negative evidence.
+ *
+ *  Dwell: a reported state is kept for at least minimumDwell seconds. Transitions that become due earlier are
+ *  postponed until then, and dropped if contrary evidence arrives in the meantime.
+ *
+ *  All regions share a single timer wheel, so evaluating thousands of regions costs time proportional to the number of
+ *  regions with a pending transition, not to the number of regions. Time only advances with the timestamps passed to the
+ *  monitor, so replays are deterministic.
+ *
+ *  The monitor is not thread-safe. The transition handler is called synchronously from the reporting functions and
+ *  BIRegionMonitorAdvance(); it must not call back into the monitor.
+ */
+typedef struct BIRegionMonitor *BIRegionMonitorRef;
+
+/**
+ *  Region monitoring events. The raw values of the state events are the CLRegionState values plus 2.
+ */
+typedef enum {
+    BIRegionEventEnter = 0,
+    BIRegionEventExit = 1,
+    BIRegionEventStateUnknown = 2,
+    BIRegionEventStateInside = 3,
+    BIRegionEventStateOutside = 4
+} BIRegionEvent;
+
+/**
+ *  Region states. The raw values match CLRegionState.
+ */
+typedef enum {
+    BIRegionStateUnknown = 0,
+    BIRegionStateInside = 1,
+    BIRegionStateOutside = 2
+} BIRegionState;
+
+typedef enum {
+    BIRegionTransitionEnter = 0,
+    BIRegionTransitionExit = 1
+} BIRegionTransition;
+
+typedef void (*BIRegionTransitionHandler)(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context);
+
+typedef struct {
+    /**
+     *  Number of consecutive ranging reports with beacons in range that confirm an entry without monitoring evidence.
+     */
+    uint32_t enterConfidence;
+
+    /**
+     *  Time (in seconds) after the first evidence of having left a region until the exit is reported.
+     */
+    double exitGracePeriod;
+
+    /**
+     *  Minimum time (in seconds) between two reported transitions of a region.
+     */
+    double minimumDwell;
+
+    /**
+     *  Granularity (in seconds) and number of slots of the timer wheel. Transitions are reported when the first call
+     *  after their due time arrives, so the resolution only affects efficiency, not timing.
+     */
+    double timerResolution;
+    uint32_t timerSlots;
+
+    /**
+     *  Counts the reported region events and delivered transitions (see BIMetrics.h), or NULL.
+     */
+    BIMetricsRef metrics;
+} BIRegionMonitorConfiguration;
+
+/**
+ *  Counters of reported and suppressed transitions.
+ */
+typedef struct {
+    uint64_t enters;
+    uint64_t exits;
+
+    /**
+     *  Enter events and inside states for a region that already is inside.
+     */
+    uint64_t duplicateEnters;
+
+    /**
+     *  Exit events and outside states for a region that already is outside or exiting.
+     */
+    uint64_t duplicateExits;
+
+    /**
+     *  Entries that were due but dropped because the region was left again during the minimum dwell time.
+     */
+    uint64_t suppressedEnters;
+
+    /**
+     *  Exits that were cancelled by evidence of being inside during the exit grace period or minimum dwell time.
+     */
+    uint64_t suppressedExits;
+} BIRegionMonitorStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: an enter confidence of 3 ranging reports, an exit grace period of
+ *  30 seconds, a minimum dwell of 10 seconds and a timer wheel of 512 slots of 0.5 seconds.
+ */
+BIRegionMonitorConfiguration BIRegionMonitorConfigurationMakeDefault(void);
+
+/**
+ *  Creates a region monitor.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param handler Receives the deduplicated transitions.
+ *  @param context Passed to handler.
+ */
+BIRegionMonitorRef BIRegionMonitorCreate(const BIRegionMonitorConfiguration *configuration, BIRegionTransitionHandler handler,
+                                         void *context);
+
+void BIRegionMonitorDestroy(BIRegionMonitorRef monitor);
+
+/**
+ *  Adds a region in the unknown state and returns its ID.
+ */
+uint32_t BIRegionMonitorAddRegion(BIRegionMonitorRef monitor);
+
+/**
+ *  Removes a region. Pending transitions are discarded.
+ */
+void BIRegionMonitorRemoveRegion(BIRegionMonitorRef monitor, uint32_t regionID);
+
+/**
+ *  Reports a region monitoring event. timestamp must not be smaller than the timestamp of the previous call.
+ */
+void BIRegionMonitorReportEvent(BIRegionMonitorRef monitor, uint32_t regionID, double timestamp, BIRegionEvent event);
+
+/**
+ *  Reports the number of the region's beacons in range after a ranging tick.
+ */
+void BIRegionMonitorReportRanging(BIRegionMonitorRef monitor, uint32_t regionID, double timestamp, size_t beaconsInRange);
+
+/**
+ *  Reports all transitions that are due at timestamp. Call it periodically (e.g. once per second) so that exits are
+ *  reported on time even if no more evidence arrives.
+ */
+void BIRegionMonitorAdvance(BIRegionMonitorRef monitor, double timestamp);
+
+/**
+ *  Returns the reported state of a region (pending transitions are not taken into account).
+ */
+BIRegionState BIRegionMonitorGetState(BIRegionMonitorRef monitor, uint32_t regionID);
+
+/**
+ *  Returns the counters of one region, or of all regions (including removed ones) if regionID is 0.
+ */
+BIRegionMonitorStatistics BIRegionMonitorGetStatistics(BIRegionMonitorRef monitor, uint32_t regionID);
+
+/**
+ *  Returns the number of regions with a pending transition.
+ */
+size_t BIRegionMonitorGetPendingCount(BIRegionMonitorRef monitor);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,198 @@
+//
+//  BIRegionMultiplexer.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_REGION_MULTIPLEXER_H
+#define BICORE_REGION_MULTIPLEXER_H
+
+#include "BICoreTypes.h"
+#include "BIRegionMonitor.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The region multiplexer monitors an unlimited number of logical beacon regions with the 20 physical regions Core
+ *  Location lets an app register.
+ *
+ *  Physical regions come in two kinds:
+ *
+ *  - wildcard regions, which only specify a proximity UUID. While the device is inside one, ranging it reveals every
+ *    beacon with that UUID, and the multiplexer demultiplexes the ranged beacons into the logical regions that match
+ *    their major and minor values.
+ *  - specific regions, which are registered for one logical region each so that the system reports its enters and
+ *    exits even when the app is not running.
+ *
+ *  BIRegionMultiplexerEvaluate() decides which physical regions should be registered. Up to wildcardRegions slots go
+ *  to the UUIDs of the logical regions, the remaining slots to the logical regions with the highest score:
+ *
+ *      score = priority + proximity + activity
+ *
+ *  where proximity is the strongest RSSI at which one of the region's beacons was ranged, mapped from -100...-40 dB to
+ *  0...1 and halved every proximityHalfLife seconds since then, and activity is 1 when the region was entered or left
+ *  and halves every activityHalfLife seconds. To keep the registrations from churning, a registered region is only
+ *  replaced by a region whose score is at least swapMargin higher, and never before it has been registered for
+ *  minimumRegistration seconds.
+ *
+ *  Events of physical regions and ranged beacons come in through BIRegionMultiplexerReportEvent() and
+ *  BIRegionMultiplexerReportRanging() and go out as raw enter and exit events of logical regions, which can be fed into
+ *  a BIRegionMonitor for debouncing.
+ *
+ *  The multiplexer is not thread-safe and never reads a clock. Handlers are called synchronously and must not call
+ *  back into the multiplexer.
+ */
+typedef struct BIRegionMultiplexer *BIRegionMultiplexerRef;
+
+/**
+ *  How much of a beacon key a region definition specifies, like the three initializers of CLBeaconRegion.
+ */
+typedef enum {
+    BIBeaconRegionScopeUUID = 0,
+    BIBeaconRegionScopeMajor = 1,
+    BIBeaconRegionScopeMinor = 2
+} BIBeaconRegionScope;
+
+/**
+ *  A beacon region: key.major is ignored for BIBeaconRegionScopeUUID, key.minor unless the scope is
+ *  BIBeaconRegionScopeMinor.
+ */
+typedef struct {
+    BIBeaconKey key;
+    BIBeaconRegionScope scope;
+} BIBeaconRegionDefinition;
+
+/**
+ *  A region to register with Core Location. logicalRegionID is 0 for wildcard regions.
+ */
+typedef struct {
+    uint32_t physicalRegionID;
+    uint32_t logicalRegionID;
+    BIBeaconRegionDefinition definition;
+} BIPhysicalRegion;
+
+/**
+ *  Called by BIRegionMultiplexerEvaluate() for every physical region to stop (monitor false) or start monitoring
+ *  (monitor true). All regions to stop are reported before the regions to start.
+ */
+typedef void (*BIPhysicalRegionHandler)(const BIPhysicalRegion *region, bool monitor, void *context);
+
+/**
+ *  Receives the enter and exit events (BIRegionEventEnter or BIRegionEventExit) of logical regions.
+ */
+typedef void (*BILogicalRegionEventHandler)(uint32_t logicalRegionID, BIRegionEvent event, double timestamp, void *context);
+
+typedef struct {
+    /**
+     *  Number of physical regions the multiplexer registers at most.
+     */
+    uint32_t maximumRegions;
+
+    /**
+     *  Number of the physical regions that may be wildcard regions.
+     */
+    uint32_t wildcardRegions;
+
+    /**
+     *  Half-lives (in seconds) of the proximity and activity terms of the score.
+     */
+    double proximityHalfLife;
+    double activityHalfLife;
+
+    /**
+     *  Score advantage a logical region needs to replace a registered one.
+     */
+    double swapMargin;
+
+    /**
+     *  Time (in seconds) a specific region stays registered at least.
+     */
+    double minimumRegistration;
+
+    /**
+     *  Time (in seconds) without ranging any of its beacons after which a logical region that was entered by ranging
+     *  is left, as long as its UUID is being ranged.
+     */
+    double rangingExitTimeout;
+} BIRegionMultiplexerConfiguration;
+
+typedef struct {
+    uint64_t registrations;
+    uint64_t unregistrations;
+    uint64_t enters;
+    uint64_t exits;
+
+    /**
+     *  Ranged beacons that matched at least one logical region.
+     */
+    uint64_t demultiplexedBeacons;
+} BIRegionMultiplexerStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: 20 regions of which 1 may be a wildcard region, half-lives of 120
+ *  seconds (proximity) and 600 seconds (activity), a swap margin of 0.1, a minimum registration of 30 seconds and a
+ *  ranging exit timeout of 30 seconds.
+ */
+BIRegionMultiplexerConfiguration BIRegionMultiplexerConfigurationMakeDefault(void);
+
+/**
+ *  Creates a multiplexer.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param physicalRegionHandler Receives the registration changes.
+ *  @param eventHandler Receives the events of logical regions.
+ *  @param context Passed to both handlers.
+ */
+BIRegionMultiplexerRef BIRegionMultiplexerCreate(const BIRegionMultiplexerConfiguration *configuration,
+                                                 BIPhysicalRegionHandler physicalRegionHandler,
+                                                 BILogicalRegionEventHandler eventHandler, void *context);
+
+void BIRegionMultiplexerDestroy(BIRegionMultiplexerRef multiplexer);
+
+/**
+ *  Adds a logical region and returns its ID. priority is added to the region's score, whose other terms are at most 1
+ *  each, so a priority above 2 + swapMargin keeps a region of otherwise equal priority registered.
+ */
+uint32_t BIRegionMultiplexerAddRegion(BIRegionMultiplexerRef multiplexer, const BIBeaconRegionDefinition *definition,
+                                      double priority);
+
+/**
+ *  Removes a logical region. Its physical region, if any, is unregistered by the next evaluation.
+ */
+void BIRegionMultiplexerRemoveRegion(BIRegionMultiplexerRef multiplexer, uint32_t logicalRegionID);
+
+/**
+ *  Reports a monitoring event of a physical region.
+ */
+void BIRegionMultiplexerReportEvent(BIRegionMultiplexerRef multiplexer, uint32_t physicalRegionID, double timestamp,
+                                    BIRegionEvent event);
+
+/**
+ *  Reports the beacons of one ranging tick of the registered wildcard regions.
+ */
+void BIRegionMultiplexerReportRanging(BIRegionMultiplexerRef multiplexer, double timestamp, const BIBeaconSample *samples,
+                                      size_t count);
+
+/**
+ *  Recomputes which physical regions should be registered and reports the changes.
+ *
+ *  @return The number of changes.
+ */
+size_t BIRegionMultiplexerEvaluate(BIRegionMultiplexerRef multiplexer, double timestamp);
+
+/**
+ *  Returns whether a logical region is inside as far as the multiplexer knows.
+ */
+bool BIRegionMultiplexerIsInside(BIRegionMultiplexerRef multiplexer, uint32_t logicalRegionID);
+
+/**
+ *  Returns the physical region registered for a logical region, or 0 if there is none.
+ */
+uint32_t BIRegionMultiplexerGetPhysicalRegion(BIRegionMultiplexerRef multiplexer, uint32_t logicalRegionID);
+
+BIRegionMultiplexerStatistics BIRegionMultiplexerGetStatistics(BIRegionMultiplexerRef multiplexer);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,212 @@
+//
+//  BISmoothingEngine.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_SMOOTHING_ENGINE_H
+#define BICORE_SMOOTHING_ENGINE_H
+
+#include "BIBeaconTable.h"
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The smoothing engine turns raw ranging data, such as the beacons reported by CLLocationManager, into smoothed
+ *  signals. With the default filter it follows the smoothing of BIBeacon in the prebuilt SDK (smoothedSignal,
+ *  smoothedRSSI, smoothedProximity, smoothedAccuracy), which bi-replay checks against device recordings. The prebuilt
+ *  SDK does not use the engine; it is part of the standalone core library.
+ *
+ *  The engine is fed once per ranging callback with all beacons reported for the region. Beacons the engine has seen
+ *  before but that are missing from a tick receive a not-in-range signal, just like BIBeacon does.
+ *  Because of that, you should use one engine per ranged region. Engines for different regions can share one beacon
+ *  table so that a beacon has the same handle in all of them.
+ *
+ *  How raw signals are smoothed depends on the configured filter (see BISmoothingFilter). All filters ignore raw
+ *  signals with an unknown RSSI (0) and unknown accuracies (negative values), derive the smoothed proximity from the
+ *  smoothed accuracy, and consider a beacon in range as long as it has reported a usable raw signal within the last
+ *  windowDuration seconds (and the last windowSize raw signals).
+ *
+ *  Signal histories are kept in fixed-capacity ring buffers (historyCapacity signals per beacon). Once a beacon is
+ *  known, processing a tick does not allocate memory. Signal objects are only materialized when you copy a history
+ *  with BISmoothingEngineCopySmoothedSignals() or BISmoothingEngineCopyRawSignals(). Histories store RSSIs in the
+ *  range -32768 ... 32767 and proximities in the range -128 ... 127; values outside are clamped to the nearest bound.
+ *
+ *  The engine is not thread-safe. Calls for one engine must be serialized by the caller.
+ */
+typedef struct BISmoothingEngine *BISmoothingEngineRef;
+
+/**
+ *  Filters that turn raw signals into smoothed signals. Every filter costs O(1) amortized per raw signal.
+ *
+ *  RSSI and accuracy are filtered independently. The EWMA and Kalman filters process the accuracy on a logarithmic
+ *  scale (20 * log10(accuracy)), on which it moves like the RSSI, so that the same parameters fit both.
+ */
+typedef enum {
+    /**
+     *  The average of the usable raw signals in the window. This is the SDK's original behaviour and the default.
+     */
+    BISmoothingFilterWindowAverage = 0,
+
+    /**
+     *  An exponentially weighted moving average with a half-life of halfLife seconds. Reacts faster than the window
+     *  average for short half-lives and is smoother for long ones. Irregular tick intervals are taken into account.
+     */
+    BISmoothingFilterEWMA = 1,
+
+    /**
+     *  A Kalman filter with a constant-velocity model (the signal and its rate of change). Follows steady approaches
+     *  and departures with little lag while suppressing measurement noise. Tuned with processNoise and
+     *  measurementNoise.
+     */
+    BISmoothingFilterKalman = 2,
+
+    /**
+     *  The median of the usable raw signals in the window. Ignores isolated outliers (e.g. reflections) completely.
+     */
+    BISmoothingFilterMedian = 3
+} BISmoothingFilter;
+
+typedef struct {
+    BISmoothingFilter filter;
+
+    /**
+     *  Maximum number of raw signals that make up a smoothed signal (window average and median).
+     */
+    uint32_t windowSize;
+
+    /**
+     *  Raw signals older than this (in seconds, relative to the current tick) do not contribute to a smoothed signal.
+     */
+    double windowDuration;
+
+    /**
+     *  Number of raw and smoothed signals the engine keeps for each beacon.
+     */
+    uint32_t historyCapacity;
+
+    /**
+     *  Time (in seconds) after which a raw signal contributes half as much to an EWMA-smoothed signal.
+     */
+    double halfLife;
+
+    /**
+     *  Kalman filter: spectral density of the random acceleration of the signal, in dB^2/s^3. Larger values follow
+     *  movements faster but let more noise through.
+     */
+    double processNoise;
+
+    /**
+     *  Kalman filter: variance of a raw signal around the true signal, in dB^2.
+     */
+    double measurementNoise;
+} BISmoothingConfiguration;
+
+/**
+ *  Returns the configuration the SDK uses by default.
+ */
+BISmoothingConfiguration BISmoothingConfigurationMakeDefault(void);
+
+/**
+ *  Creates a new smoothing engine with a private beacon table that uses the default table configuration.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *
+ *  @return The new engine. Must be destroyed with BISmoothingEngineDestroy().
+ */
+BISmoothingEngineRef BISmoothingEngineCreate(const BISmoothingConfiguration *configuration);
+
+/**
+ *  Creates a new smoothing engine that interns beacons in the specified table.
+ *
+ *  The engine stops tracking a beacon as soon as the table evicts it. Evicting idle beacons is then up to the owner
+ *  of the table (see BIBeaconTableEvictIdle()); an engine with a private table does it by itself.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param table The beacon table. Must outlive the engine. Pass NULL to use a private table.
+ */
+BISmoothingEngineRef BISmoothingEngineCreateWithBeaconTable(const BISmoothingConfiguration *configuration, BIBeaconTableRef table);
+
+void BISmoothingEngineDestroy(BISmoothingEngineRef engine);
+
+/**
+ *  Processes one ranging callback.
+ *
+ *  @param engine The engine.
+ *  @param timestamp The time of the callback in seconds. Must not be smaller than the timestamp of the previous tick.
+ *  @param samples All beacons reported in the callback. If a beacon appears more than once, the last sample wins.
+ *  @param count The number of elements in samples.
+ */
+void BISmoothingEngineProcessTick(BISmoothingEngineRef engine, double timestamp, const BIBeaconSample *samples, size_t count);
+
+/**
+ *  Starts tracking a beacon with a sample from a previous session, e.g. the last smoothed signal kept by a
+ *  BIBeaconCache, as if it had been ranged at timestamp. The filters start from this sample instead of from the first
+ *  raw signal of the new session. Only beacons the engine does not track yet can be restored.
+ *
+ *  @param timestamp Must not be smaller than the timestamp of the previous tick; usually the time the engine is created.
+ *
+ *  @return The handle of the beacon, or BIBeaconHandleInvalid if the engine already tracks it.
+ */
+BIBeaconHandle BISmoothingEngineRestoreSample(BISmoothingEngineRef engine, double timestamp, const BIBeaconSample *sample);
+
+/**
+ *  Returns the number of beacons the engine currently tracks: all beacons it has seen that have not been evicted
+ *  from its beacon table.
+ */
+size_t BISmoothingEngineGetBeaconCount(BISmoothingEngineRef engine);
+
+/**
+ *  Retrieves the key of the beacon at the specified index. Indexes are assigned in the order beacons are first seen.
+ *
+ *  @return false if index is out of bounds.
+ */
+bool BISmoothingEngineGetBeaconKeyAtIndex(BISmoothingEngineRef engine, size_t index, BIBeaconKey *key);
+
+/**
+ *  Returns the beacon table handle of the beacon at the specified index, or BIBeaconHandleInvalid if index is out of
+ *  bounds.
+ */
+BIBeaconHandle BISmoothingEngineGetBeaconHandleAtIndex(BISmoothingEngineRef engine, size_t index);
+
+/**
+ *  Retrieves the most recent smoothed or raw signal of a beacon.
+ *
+ *  @return false if the engine has not seen the beacon or has not processed a tick for it yet.
+ */
+bool BISmoothingEngineGetSmoothedSignal(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *signal);
+bool BISmoothingEngineGetSmoothedSignalForHandle(BISmoothingEngineRef engine, BIBeaconHandle handle, BISignal *signal);
+bool BISmoothingEngineGetRawSignal(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *signal);
+
+/**
+ *  Copies the smoothed or raw signal history of a beacon, oldest signal first.
+ *
+ *  @param buffer The destination. May be NULL if capacity is 0.
+ *  @param capacity The number of signals buffer can hold. If the history is longer, the most recent signals are copied.
+ *
+ *  @return The number of signals copied, or the length of the history if capacity is 0.
+ */
+size_t BISmoothingEngineCopySmoothedSignals(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *buffer, size_t capacity);
+size_t BISmoothingEngineCopyRawSignals(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *buffer, size_t capacity);
+
+/**
+ *  Copies the handles of the beacons whose smoothed signal changed in the last tick (RSSI, accuracy or whether the
+ *  beacon is in range), or of the beacons the engine stopped tracking in the last tick. A dropped handle may be
+ *  tracked again for a different beacon in the same tick; it is then reported in both lists.
+ *
+ *  Consumers that derive state from smoothed signals, such as BINearestBeaconTracker, only need to look at these
+ *  beacons after a tick.
+ *
+ *  @param handles The destination. May be NULL if capacity is 0.
+ *  @param capacity The number of handles the destination can hold.
+ *
+ *  @return The number of handles copied, or the total number of handles if capacity is 0.
+ */
+size_t BISmoothingEngineCopyChangedHandles(BISmoothingEngineRef engine, BIBeaconHandle *handles, size_t capacity);
+size_t BISmoothingEngineCopyDroppedHandles(BISmoothingEngineRef engine, BIBeaconHandle *handles, size_t capacity);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,104 @@
+//
+//  BISpatialIndex.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_SPATIAL_INDEX_H
+#define BICORE_SPATIAL_INDEX_H
+
+#include "BICoreTypes.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The spatial index answers "which beacons are near this point" for a venue map with thousands of beacons on many
+ *  floors, without scanning all of them.
+ *
+ *  Every floor gets a uniform grid over the bounding box of its beacons. The beacons are stored sorted by floor and
+ *  cell in flat arrays, so a cell is a contiguous range and a query only touches the cells around the point. Beacons
+ *  are also found by their identity through an open-addressing table.
+ *
+ *  The index is immutable once created. Queries do not allocate and may run on several threads at the same time.
+ */
+typedef struct BISpatialIndex *BISpatialIndexRef;
+
+/**
+ *  A beacon on a venue map. Coordinates are in meters in the map's coordinate system, which all floors share.
+ */
+typedef struct {
+    BIBeaconKey key;
+    double x;
+    double y;
+    int32_t floor;
+} BIBeaconLocation;
+
+typedef struct {
+    BIBeaconLocation location;
+
+    /**
+     *  Distance (in meters) from the query point.
+     */
+    double distance;
+} BISpatialMatch;
+
+typedef struct {
+    /**
+     *  Edge length (in meters) of the grid cells. 0 chooses it per floor so that a cell holds about two beacons. Cells
+     *  are made larger where needed to keep the grid of a floor within four cells per beacon.
+     */
+    double cellSize;
+} BISpatialIndexConfiguration;
+
+/**
+ *  Returns the configuration the SDK uses by default: cell sizes chosen per floor.
+ */
+BISpatialIndexConfiguration BISpatialIndexConfigurationMakeDefault(void);
+
+/**
+ *  Creates an index of beacons.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param beacons The beacons to index. A beacon that appears more than once keeps its last location.
+ */
+BISpatialIndexRef BISpatialIndexCreate(const BISpatialIndexConfiguration *configuration, const BIBeaconLocation *beacons,
+                                       size_t beaconCount);
+
+void BISpatialIndexDestroy(BISpatialIndexRef index);
+
+size_t BISpatialIndexGetCount(BISpatialIndexRef index);
+
+/**
+ *  Returns the bytes the index occupies.
+ */
+size_t BISpatialIndexGetStorageSize(BISpatialIndexRef index);
+
+/**
+ *  Looks up the location of a beacon.
+ *
+ *  @return false if the beacon is not in the index.
+ */
+bool BISpatialIndexGetLocation(BISpatialIndexRef index, const BIBeaconKey *key, BIBeaconLocation *location);
+
+/**
+ *  Finds the k beacons on a floor nearest to a point, nearest first.
+ *
+ *  @param matches Receives up to k matches.
+ *  @return The number of matches, less than k if the floor has fewer beacons.
+ */
+size_t BISpatialIndexFindNearest(BISpatialIndexRef index, int32_t floor, double x, double y, size_t k,
+                                 BISpatialMatch *matches);
+
+/**
+ *  Finds the beacons on a floor within radius meters of a point, in no particular order.
+ *
+ *  @param matches Receives up to capacity matches. May be NULL if capacity is 0.
+ *  @return The number of beacons within the radius, which may exceed capacity.
+ */
+size_t BISpatialIndexFindWithinRadius(BISpatialIndexRef index, int32_t floor, double x, double y, double radius,
+                                      BISpatialMatch *matches, size_t capacity);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,288 @@
+//
+//  BITrace.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_TRACE_H
+#define BICORE_TRACE_H
+
+#include "BICoreTypes.h"
+#include "BIRangingPipeline.h"
+#include "BIRegionMonitor.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  Binary traces capture what an app ranging with the core saw on a device: the raw beacons of every ranging callback,
+ *  region enter/exit events and Bluetooth state changes. A trace can be replayed on any platform through the same
+ *  smoothing and nearest-beacon logic, which makes field reports such as enter/exit storms reproducible.
+ *
+ *  A trace file starts with the 8 bytes "BITRACE" and a version byte (1), followed by records. Every record starts with
+ *  its type (one byte) and the time since the previous record in microseconds as a zigzag-encoded varint (the first
+ *  record carries the absolute time). Integers are LEB128 varints; signed integers are zigzag-encoded first.
+ *
+ *  - Beacon definition: 16 UUID bytes, major, minor. Beacons are numbered in the order they are defined, starting at 0.
+ *  - Beacon reset: no fields. Forgets all beacon definitions; the numbering starts again at 0.
+ *  - Region definition: region ID, length of the identifier, identifier (UTF-8).
+ *  - Ranging: region ID, number of beacons, then per beacon its number, RSSI + 64, proximity and accuracy in
+ *    millimeters.
+ *  - Region event: region ID, BIRegionEvent.
+ *  - Bluetooth state: BIBluetoothState.
+ *  - Gap: number of records the recorder had to drop before this record.
+ *
+ *  A ranging record takes about 6 bytes per beacon, compared to about 85 bytes in a CSV trace. Accuracies are rounded
+ *  to millimeters.
+ */
+
+typedef enum {
+    BITraceRecordBeaconDefinition = 1,
+    BITraceRecordRegionDefinition = 2,
+    BITraceRecordRanging = 3,
+    BITraceRecordRegionEvent = 4,
+    BITraceRecordBluetoothState = 5,
+    BITraceRecordGap = 6,
+    BITraceRecordBeaconReset = 7
+} BITraceRecordType;
+
+/**
+ *  Bluetooth states. The raw values match CBCentralManagerState.
+ */
+typedef enum {
+    BIBluetoothStateUnknown = 0,
+    BIBluetoothStateResetting = 1,
+    BIBluetoothStateUnsupported = 2,
+    BIBluetoothStateUnauthorized = 3,
+    BIBluetoothStatePoweredOff = 4,
+    BIBluetoothStatePoweredOn = 5
+} BIBluetoothState;
+
+/**
+ *  A decoded record. Only the fields that belong to the record's type are set. Pointers are valid until the next
+ *  record is read.
+ */
+typedef struct {
+    BITraceRecordType type;
+    double timestamp;
+    uint32_t regionID;
+
+    /**
+     *  Ranging records: the reported beacons.
+     */
+    const BIBeaconSample *samples;
+    size_t sampleCount;
+
+    /**
+     *  Region definitions: the NUL-terminated identifier of the region.
+     */
+    const char *regionIdentifier;
+
+    /**
+     *  Beacon definitions: the defined beacon.
+     */
+    BIBeaconKey beaconKey;
+
+    BIRegionEvent regionEvent;
+    BIBluetoothState bluetoothState;
+
+    /**
+     *  Gap records: the number of records that are missing from the trace at this point.
+     */
+    uint64_t droppedRecords;
+} BITraceRecord;
+
+// MARK: - Recording
+
+/**
+ *  The trace recorder appends records to a trace file from a background thread.
+ *
+ *  The recording functions only encode the record into an in-memory chunk and return; they never wait for the file
+ *  system. A writer thread writes chunks when they are full and at least every flushInterval seconds. Memory is bounded
+ *  by maximumChunks * chunkSize bytes: if the writer falls that far behind, records are dropped (and counted in a gap
+ *  record) instead of blocking the caller. Once maximumBeacons beacons have been defined, the recorder resets the beacon
+ *  numbering before the next record, so that neither the recorder nor a reader keeps more definitions than that (plus
+ *  the beacons of one ranging record) however many beacons a long trace sees.
+ *
+ *  The recording functions may be called from any thread. Records appear in the trace in the order of the calls.
+ */
+typedef struct BITraceRecorder *BITraceRecorderRef;
+
+typedef struct {
+    /**
+     *  Size of the chunks records are collected in, in bytes. A record larger than a chunk gets a chunk of its own.
+     */
+    uint32_t chunkSize;
+
+    /**
+     *  Maximum number of chunks waiting to be written, including the chunk that is being filled.
+     */
+    uint32_t maximumChunks;
+
+    /**
+     *  Maximum time (in seconds) a record stays in memory before it is written.
+     */
+    double flushInterval;
+
+    /**
+     *  Number of beacon definitions after which the beacon numbering is reset. Beacons that are seen again after a
+     *  reset are defined again.
+     */
+    uint32_t maximumBeacons;
+} BITraceRecorderConfiguration;
+
+typedef struct {
+    uint64_t recordsWritten;
+    uint64_t recordsDropped;
+    uint64_t bytesWritten;
+} BITraceRecorderStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: 16 chunks of 64 KiB, a flush interval of 5 seconds and a beacon
+ *  numbering reset every 4096 beacons.
+ */
+BITraceRecorderConfiguration BITraceRecorderConfigurationMakeDefault(void);
+
+/**
+ *  Creates a recorder that writes a new trace to path. An existing file is replaced.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *
+ *  @return The recorder, or NULL if the file cannot be created.
+ */
+BITraceRecorderRef BITraceRecorderCreate(const char *path, const BITraceRecorderConfiguration *configuration);
+
+/**
+ *  Writes all pending records, closes the file and destroys the recorder.
+ */
+void BITraceRecorderDestroy(BITraceRecorderRef recorder);
+
+/**
+ *  Records the identifier of a region. Optional; it only makes replays easier to read.
+ */
+void BITraceRecorderRecordRegionDefinition(BITraceRecorderRef recorder, uint32_t regionID, double timestamp,
+                                           const char *identifier);
+
+/**
+ *  Records the beacons CLLocationManager reported for a region in one ranging callback. Beacons that are new to the
+ *  trace are defined on the fly.
+ */
+void BITraceRecorderRecordRanging(BITraceRecorderRef recorder, uint32_t regionID, double timestamp,
+                                  const BIBeaconSample *samples, size_t count);
+
+void BITraceRecorderRecordRegionEvent(BITraceRecorderRef recorder, uint32_t regionID, double timestamp,
+                                      BIRegionEvent event);
+
+void BITraceRecorderRecordBluetoothState(BITraceRecorderRef recorder, double timestamp, BIBluetoothState state);
+
+/**
+ *  Blocks until all records recorded so far have been written to the file.
+ */
+void BITraceRecorderFlush(BITraceRecorderRef recorder);
+
+BITraceRecorderStatistics BITraceRecorderGetStatistics(BITraceRecorderRef recorder);
+
+// MARK: - Reading
+
+/**
+ *  Reads the records of a trace file in order. Beacon numbers are resolved, so ranging records carry complete
+ *  BIBeaconSamples.
+ */
+typedef struct BITraceReader *BITraceReaderRef;
+
+/**
+ *  Opens a trace file.
+ *
+ *  @return The reader, or NULL if the file cannot be opened or is not a trace.
+ */
+BITraceReaderRef BITraceReaderCreate(const char *path);
+
+void BITraceReaderDestroy(BITraceReaderRef reader);
+
+/**
+ *  Reads the next record.
+ *
+ *  @return false at the end of the trace or if the trace is malformed (see BITraceReaderGetError()).
+ */
+bool BITraceReaderNext(BITraceReaderRef reader, BITraceRecord *record);
+
+/**
+ *  Returns a description of the error that stopped the reader, or NULL if it reached the end of the trace. A trace
+ *  whose last record is cut off (e.g. because the app was terminated while writing) reports "truncated record"; all
+ *  records before it have been read.
+ */
+const char *BITraceReaderGetError(BITraceReaderRef reader);
+
+// MARK: - Replaying
+
+/**
+ *  The trace replayer feeds the ranging records of a trace into a synchronous ranging pipeline (one pipeline region
+ *  per trace region), so that smoothing and nearest-beacon selection run exactly like on the device. Recorded region
+ *  events, together with the number of beacons in range after each ranging tick, drive a region monitor (see
+ *  BIRegionMonitor.h), which turns them into deduplicated region transitions. Nothing waits for the recorded time to
+ *  pass, and the same trace and configuration always produce the same sequence of callbacks.
+ *
+ *  Batches and transitions carry the trace's region IDs.
+ */
+typedef struct BITraceReplayer *BITraceReplayerRef;
+
+typedef struct {
+    BIRangingPipelineConfiguration pipeline;
+    BIRegionMonitorConfiguration regionMonitor;
+} BITraceReplayConfiguration;
+
+/**
+ *  All handlers may be NULL.
+ */
+typedef struct {
+    BIRangingBatchHandler rangingBatch;
+    BIRegionTransitionHandler regionTransition;
+
+    /**
+     *  Called for region definitions, region events, Bluetooth state changes and gaps.
+     */
+    void (*record)(const BITraceRecord *record, void *context);
+} BITraceReplayHandlers;
+
+typedef struct {
+    uint64_t records;
+    uint64_t rangingRecords;
+    uint64_t samples;
+    uint64_t regionEvents;
+    uint64_t bluetoothStateChanges;
+    uint64_t droppedRecords;
+    uint64_t batchesDelivered;
+    BIRegionMonitorStatistics regionTransitions;
+    double firstTimestamp;
+    double lastTimestamp;
+} BITraceReplayStatistics;
+
+BITraceReplayConfiguration BITraceReplayConfigurationMakeDefault(void);
+
+/**
+ *  Creates a replayer for a trace file.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration. The replayer always runs
+ *  the pipeline synchronously.
+ *
+ *  @return The replayer, or NULL if the file cannot be opened or is not a trace.
+ */
+BITraceReplayerRef BITraceReplayerCreate(const char *path, const BITraceReplayConfiguration *configuration,
+                                         BITraceReplayHandlers handlers, void *context);
+
+void BITraceReplayerDestroy(BITraceReplayerRef replayer);
+
+/**
+ *  Replays the whole trace.
+ *
+ *  @return false if the trace is malformed. The records before the error have been replayed.
+ */
+bool BITraceReplayerRun(BITraceReplayerRef replayer);
+
+const char *BITraceReplayerGetError(BITraceReplayerRef replayer);
+
+BITraceReplayStatistics BITraceReplayerGetStatistics(BITraceReplayerRef replayer);
+
+BI_EXTERN_C_END
+
+#endif
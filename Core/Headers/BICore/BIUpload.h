@@ -0,0 +1,257 @@
+//
+//  BIUpload.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_UPLOAD_H
+#define BICORE_UPLOAD_H
+
+#include "BICoreTypes.h"
+#include "BIRangingPipeline.h"
+#include "BIRegionMonitor.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  Uploads carry the beacon sightings of one device to a backend in a compact columnar format. The upload encoder
+ *  collects sightings on the device and cuts them into uploads; the upload reader decodes them on any platform (see
+ *  BIIngestion.h for the server-side aggregation).
+ *
+ *  An upload holds a sequence of ticks (the beacons seen at one time) and starts with the 7 bytes "BISIGHT" and a
+ *  version byte (1), followed by the 16 bytes of the device ID and these LEB128 varints: the sequence number, the time
+ *  of the first tick in milliseconds (zigzag-encoded), the numbers of ticks, sightings, UUIDs and beacons, and the
+ *  lengths in bytes of the four varint columns. The columns follow in this order:
+ *
+ *  - UUIDs: 16 bytes each, in ascending order.
+ *  - Beacons (varints): per beacon its UUID index, the difference of its major to the previous beacon's major and of
+ *    its minor to the previous beacon's minor (both zigzag-encoded). Beacons are sorted by UUID, major and minor.
+ *  - Ticks (varints): per tick the milliseconds since the previous tick (or the first tick) and its number of sightings.
+ *  - Sighting beacons (varints): per sighting the index of its beacon; within a tick the indexes ascend and all but the
+ *    first are stored as the difference to the previous index minus one.
+ *  - RSSIs: one byte per sighting, the negated RSSI (0 if unknown, -255 and below are stored as 255).
+ *  - Proximities: two bits per sighting, four sightings per byte starting at the low bits.
+ *  - Accuracies (varints): per sighting the accuracy in centimeters plus one (up to 100 km), or 0 if unknown.
+ *
+ *  The upload ends with the FNV-1a hash of all preceding bytes (4 bytes, little-endian). A sighting takes about 4 bytes,
+ *  compared to about 150 bytes as JSON built from beaconIdentifierDictionaryRepresentation. Timestamps are rounded to
+ *  milliseconds and accuracies to centimeters.
+ *
+ *  Region events travel in uploads of their own, which start with "BIEVENT" and a version byte (1), followed by the
+ *  device ID and these varints: the sequence number, the time of the first event in milliseconds (zigzag-encoded) and
+ *  the number of events. Per event follow the milliseconds since the previous (or the first) event, the region ID and
+ *  the BIRegionEvent. They end with a checksum like sighting uploads. Both kinds share the sequence numbers of a device.
+ */
+
+typedef enum {
+    BIUploadKindNone = 0,
+    BIUploadKindSightings = 1,
+    BIUploadKindRegionEvents = 2
+} BIUploadKind;
+
+/**
+ *  Returns the kind of an upload by its first bytes, or BIUploadKindNone if it is neither kind. The rest of the upload
+ *  is not verified.
+ */
+BIUploadKind BIUploadGetKind(const uint8_t *bytes, size_t length);
+
+/**
+ *  Receives a finished upload. The bytes are only valid during the call.
+ */
+typedef void (*BIUploadHandler)(const uint8_t *bytes, size_t length, void *context);
+
+// MARK: - Encoding
+
+/**
+ *  The upload encoder collects the beacons of ranging ticks and passes an upload to its handler whenever enough
+ *  sightings have accumulated. Sightings of the same beacon with the same timestamp (e.g. from overlapping regions) are
+ *  merged, keeping the stronger RSSI. Region events are collected separately and passed as region event uploads, which
+ *  are finished sooner.
+ *
+ *  The encoder is not thread-safe. The handler is called synchronously from the adding functions,
+ *  BIUploadEncoderAdvance() and BIUploadEncoderFlush().
+ */
+typedef struct BIUploadEncoder *BIUploadEncoderRef;
+
+typedef struct {
+    /**
+     *  An upload is finished at the start of the next tick once it holds at least maximumSightings sightings or its
+     *  first tick is at least maximumAge seconds old.
+     */
+    uint32_t maximumSightings;
+    double maximumAge;
+
+    /**
+     *  A region event upload is finished once its first event is at least maximumEventDelay seconds old.
+     */
+    double maximumEventDelay;
+} BIUploadEncoderConfiguration;
+
+typedef struct {
+    /**
+     *  Uploads of both kinds.
+     */
+    uint64_t uploads;
+    uint64_t ticks;
+    uint64_t sightings;
+    uint64_t regionEvents;
+    uint64_t bytes;
+} BIUploadEncoderStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: uploads of 4096 sightings or 5 minutes, and region events after
+ *  10 seconds.
+ */
+BIUploadEncoderConfiguration BIUploadEncoderConfigurationMakeDefault(void);
+
+/**
+ *  Creates an upload encoder.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param deviceID The 16 bytes that identify the device, e.g. -[UIDevice identifierForVendor].
+ *  @param sequenceNumber The sequence number of the first upload; every upload increments it. Persist it across
+ *  launches so that the backend can tell retried uploads from new ones.
+ *  @param handler Receives the uploads.
+ *  @param context Passed to handler.
+ */
+BIUploadEncoderRef BIUploadEncoderCreate(const BIUploadEncoderConfiguration *configuration, const uint8_t deviceID[16],
+                                         uint64_t sequenceNumber, BIUploadHandler handler, void *context);
+
+/**
+ *  Destroys the encoder. Sightings that have not been passed to the handler are discarded; call
+ *  BIUploadEncoderFlush() first to keep them.
+ */
+void BIUploadEncoderDestroy(BIUploadEncoderRef encoder);
+
+/**
+ *  Adds the beacons of one ranging callback. Beacons with the same timestamp belong to the same tick. A timestamp
+ *  earlier than the previous one finishes the current upload first.
+ */
+void BIUploadEncoderAddSamples(BIUploadEncoderRef encoder, double timestamp, const BIBeaconSample *samples,
+                               size_t count);
+
+/**
+ *  Adds the raw signals of the beacons that are in range in any region of a ranging batch.
+ */
+void BIUploadEncoderAddBatch(BIUploadEncoderRef encoder, const BIRangingBatch *batch);
+
+/**
+ *  Adds a region event, e.g. from the events handler of a region monitor. A timestamp earlier than the previous event's
+ *  finishes the current region event upload first.
+ */
+void BIUploadEncoderAddRegionEvent(BIUploadEncoderRef encoder, uint32_t regionID, double timestamp,
+                                   BIRegionEvent event);
+
+/**
+ *  Finishes the uploads that are due at timestamp. Ranging ticks do this as well; call it periodically (e.g. every few
+ *  seconds) so that uploads are also finished while no beacons are ranged.
+ */
+void BIUploadEncoderAdvance(BIUploadEncoderRef encoder, double timestamp);
+
+/**
+ *  Passes the region events and the sightings collected so far to the handler, as up to two uploads.
+ *
+ *  @return false if there were neither region events nor sightings.
+ */
+bool BIUploadEncoderFlush(BIUploadEncoderRef encoder);
+
+/**
+ *  Returns the sequence number the next upload will carry.
+ */
+uint64_t BIUploadEncoderGetSequenceNumber(BIUploadEncoderRef encoder);
+
+BIUploadEncoderStatistics BIUploadEncoderGetStatistics(BIUploadEncoderRef encoder);
+
+// MARK: - Reading
+
+/**
+ *  The upload reader decodes an upload in place: the columns are read straight from the bytes it was given, which must
+ *  stay valid while the reader uses them. Only the beacon list is decoded up front. A reader can open one upload after
+ *  the other, so that many uploads can be decoded without allocating memory for each of them.
+ */
+typedef struct BIUploadReader *BIUploadReaderRef;
+
+typedef struct {
+    BIUploadKind kind;
+    uint8_t deviceID[16];
+    uint64_t sequenceNumber;
+
+    /**
+     *  Times of the first and last tick or region event.
+     */
+    double startTime;
+    double endTime;
+
+    /**
+     *  Region event uploads have no ticks, sightings and beacons, sighting uploads no region events.
+     */
+    uint32_t tickCount;
+    uint32_t sightingCount;
+    uint32_t beaconCount;
+    uint32_t regionEventCount;
+} BIUploadInfo;
+
+typedef struct {
+    double timestamp;
+
+    /**
+     *  Index of the beacon in the upload's beacon list (see BIUploadReaderGetBeacons()).
+     */
+    uint32_t beacon;
+
+    int32_t RSSI;
+    int32_t proximity;
+    double accuracy;
+} BIUploadSighting;
+
+typedef struct {
+    double timestamp;
+    uint32_t regionID;
+    BIRegionEvent event;
+} BIUploadRegionEvent;
+
+/**
+ *  Creates a reader. It reads nothing until an upload is opened.
+ */
+BIUploadReaderRef BIUploadReaderCreate(void);
+
+void BIUploadReaderDestroy(BIUploadReaderRef reader);
+
+/**
+ *  Starts reading an upload of either kind. The header, the checksum, the beacon list and the ticks are verified; the
+ *  other columns are verified while they are read. Region events are decoded and verified right away.
+ *
+ *  @return false if the bytes are not a well-formed upload (see BIUploadReaderGetError()). The reader then reads no
+ *  sightings.
+ */
+bool BIUploadReaderOpen(BIUploadReaderRef reader, const uint8_t *bytes, size_t length);
+
+BIUploadInfo BIUploadReaderGetInfo(BIUploadReaderRef reader);
+
+/**
+ *  Returns the beacons of the upload, sorted by UUID, major and minor.
+ */
+const BIBeaconKey *BIUploadReaderGetBeacons(BIUploadReaderRef reader, size_t *count);
+
+/**
+ *  Returns the region events of the upload in the order they were added.
+ */
+const BIUploadRegionEvent *BIUploadReaderGetRegionEvents(BIUploadReaderRef reader, size_t *count);
+
+/**
+ *  Reads the next sightings, tick by tick and in the order of the beacon list within a tick.
+ *
+ *  @return The number of sightings read into sightings, 0 at the end of the upload or if it is malformed (see
+ *  BIUploadReaderGetError()).
+ */
+size_t BIUploadReaderRead(BIUploadReaderRef reader, BIUploadSighting *sightings, size_t capacity);
+
+/**
+ *  Returns a description of the error that stopped the reader, or NULL if the open upload is well-formed so far.
+ */
+const char *BIUploadReaderGetError(BIUploadReaderRef reader);
+
+BI_EXTERN_C_END
+
+#endif
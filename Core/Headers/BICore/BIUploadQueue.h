@@ -0,0 +1,188 @@
+//
+//  BIUploadQueue.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_UPLOAD_QUEUE_H
+#define BICORE_UPLOAD_QUEUE_H
+
+#include "BICoreTypes.h"
+#include "BIUpload.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The upload queue delivers the sightings and region events of a device to a backend, also when the device is offline
+ *  for a while. Ranging batches and region events go into an upload encoder (see BIUpload.h), which batches them into
+ *  compact uploads; every finished upload is appended to a log of segment files in a directory of its own and stays
+ *  there until the backend has accepted it.
+ *
+ *  Uploads are sent one at a time: region event uploads first, then sighting uploads, each oldest first. The queue does
+ *  no networking itself. It passes each upload to a send function (on iOS, e.g. a POST with NSURLSession) and is
+ *  told the outcome through BIUploadQueueDidSend(). After a failed request the queue waits before the next one:
+ *  initialBackoff seconds after the first failure, twice as long after every further one up to maximumBackoff, each
+ *  shortened by a random amount of up to half so that devices do not retry in lockstep. A request that succeeds resets
+ *  the backoff. Nothing is sent while the backend is unreachable (see BIUploadQueueSetReachable()).
+ *
+ *  The log holds at most maximumLogSize bytes. When an upload does not fit, the oldest segments are evicted: their
+ *  sighting uploads that have not been sent are dropped, and their region event uploads are moved to the newest segment
+ *  as long as other segments hold sighting uploads that can be dropped instead. Region event uploads are only dropped to
+ *  make room for newer region events; an upload that does not fit otherwise is dropped.
+ *
+ *  The outcome of each request is recorded in the log, so the queue picks up where it left off when it is opened
+ *  again. Appends are not synced to disk; an upload that was cut off (e.g. because the device lost power) ends its
+ *  segment. An upload whose outcome was not recorded is sent again, and the backend skips it by its sequence number
+ *  (see BIIngestion.h). The log also keeps the sequence number, which continues across launches.
+ *
+ *  Segments are written in the byte order of the device. Time only advances with the timestamps passed in. The queue is
+ *  not thread-safe; the send function is called synchronously and must not report the outcome before it returns.
+ */
+typedef struct BIUploadQueue *BIUploadQueueRef;
+
+/**
+ *  Sends an upload to the backend. The bytes are only valid during the call.
+ */
+typedef void (*BIUploadSendFunction)(const uint8_t *bytes, size_t length, void *context);
+
+typedef enum {
+    /**
+     *  The backend accepted the upload (e.g. HTTP status 2xx).
+     */
+    BIUploadResultAccepted = 0,
+
+    /**
+     *  The request failed and is retried after the backoff (e.g. no connection, a timeout or HTTP status 5xx or 429).
+     */
+    BIUploadResultFailed = 1,
+
+    /**
+     *  The backend will never accept the upload (e.g. any other HTTP status 4xx). It is dropped.
+     */
+    BIUploadResultRejected = 2
+} BIUploadResult;
+
+typedef struct {
+    /**
+     *  Batching of the sightings and region events.
+     */
+    BIUploadEncoderConfiguration encoder;
+
+    /**
+     *  Maximum size (in bytes) of all segments, and the size after which a new segment is started. maximumLogSize is
+     *  raised to at least twice segmentSize.
+     */
+    uint32_t maximumLogSize;
+    uint32_t segmentSize;
+
+    /**
+     *  Backoff (in seconds) after the first failed request, and maximum backoff.
+     */
+    double initialBackoff;
+    double maximumBackoff;
+} BIUploadQueueConfiguration;
+
+typedef struct {
+    /**
+     *  Uploads appended to the log, and uploads found in the log when it was opened that still had to be sent.
+     */
+    uint64_t appendedUploads;
+    uint64_t appendedBytes;
+    uint64_t recoveredUploads;
+
+    /**
+     *  Uploads the backend accepted or rejected.
+     */
+    uint64_t acceptedUploads;
+    uint64_t acceptedBytes;
+    uint64_t rejectedUploads;
+
+    uint64_t requests;
+    uint64_t failedRequests;
+
+    /**
+     *  Uploads dropped because the log was full.
+     */
+    uint64_t droppedSightingUploads;
+    uint64_t droppedRegionEventUploads;
+
+    /**
+     *  Reads and writes of the log that failed. An upload that cannot be written or read back is dropped.
+     */
+    uint64_t failedIO;
+
+    /**
+     *  Uploads waiting to be sent (including one that is being sent), and the size of all segments in bytes.
+     */
+    uint64_t pendingUploads;
+    uint64_t logSize;
+} BIUploadQueueStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: the default upload encoder configuration, a log of up to 4 MiB
+ *  in segments of 256 KiB, and a backoff of 5 seconds up to 10 minutes.
+ */
+BIUploadQueueConfiguration BIUploadQueueConfigurationMakeDefault(void);
+
+/**
+ *  Opens the queue stored in directory, creating the directory if it does not exist, and reads back the uploads that
+ *  still have to be sent. The directory must not be used for anything else.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param deviceID The 16 bytes that identify the device in the uploads.
+ *  @param send Sends the uploads.
+ *  @param context Passed to send.
+ *
+ *  @return The queue, or NULL if the directory cannot be created or read.
+ */
+BIUploadQueueRef BIUploadQueueOpen(const char *directory, const BIUploadQueueConfiguration *configuration,
+                                   const uint8_t deviceID[16], BIUploadSendFunction send, void *context);
+
+/**
+ *  Appends the sightings and region events that are not in an upload yet to the log and closes it. The outcome of a
+ *  request that is still being sent is not recorded.
+ */
+void BIUploadQueueClose(BIUploadQueueRef queue);
+
+/**
+ *  Adds the raw signals of the beacons that are in range in any region of a ranging batch (see
+ *  BIUploadEncoderAddBatch()).
+ */
+void BIUploadQueueAddBatch(BIUploadQueueRef queue, const BIRangingBatch *batch);
+
+/**
+ *  Adds a region event (see BIUploadEncoderAddRegionEvent()).
+ */
+void BIUploadQueueAddRegionEvent(BIUploadQueueRef queue, uint32_t regionID, double timestamp, BIRegionEvent event);
+
+/**
+ *  Finishes the uploads that are due and sends the next upload once the backoff has passed. Call it periodically,
+ *  e.g. every few seconds.
+ */
+void BIUploadQueueAdvance(BIUploadQueueRef queue, double timestamp);
+
+/**
+ *  Appends the sightings and region events that are not in an upload yet to the log, e.g. when the app moves to the
+ *  background.
+ *
+ *  @return false if there were neither sightings nor region events.
+ */
+bool BIUploadQueueFlush(BIUploadQueueRef queue);
+
+/**
+ *  Tells the queue whether the backend can be reached, e.g. from a network path monitor. Queues start out reachable.
+ *  Becoming reachable ends the backoff and sends the next upload right away.
+ */
+void BIUploadQueueSetReachable(BIUploadQueueRef queue, bool reachable, double timestamp);
+
+/**
+ *  Reports the outcome of the request the send function was last called for.
+ */
+void BIUploadQueueDidSend(BIUploadQueueRef queue, double timestamp, BIUploadResult result);
+
+BIUploadQueueStatistics BIUploadQueueGetStatistics(BIUploadQueueRef queue);
+
+BI_EXTERN_C_END
+
+#endif
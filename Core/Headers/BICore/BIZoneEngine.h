@@ -0,0 +1,173 @@
+//
+//  BIZoneEngine.h
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#ifndef BICORE_ZONE_ENGINE_H
+#define BICORE_ZONE_ENGINE_H
+
+#include "BICoreTypes.h"
+#include "BIRangingPipeline.h"
+
+BI_EXTERN_C_BEGIN
+
+/**
+ *  The zone engine tells when the device enters and leaves zones that are defined by rules over beacons, e.g. "beacon
+ *  1:2 is near for 5 seconds, and 1:3 is not stronger than -65 dBm".
+ *
+ *  A zone is a tree of nodes: beacon conditions (in range, a minimum RSSI, a maximum proximity, held for a dwell time)
+ *  combined by all, any, not and at-least-n nodes. When the engine is created, every tree is compiled into a postfix
+ *  program in one flat instruction array, and the conditions are indexed by beacon. A ranging tick only re-checks the
+ *  conditions of the beacons whose signals changed, and only runs the programs of the zones with a condition whose
+ *  value changed. Dwell times of conditions and zones share one timer wheel.
+ *
+ *  A zone is entered once its rule has held for enterDwellTime seconds, and left once it has not held for
+ *  exitDwellTime seconds. Time only advances with the timestamps passed to the engine, so replays are deterministic.
+ *
+ *  The engine is not thread-safe. The transition handler is called synchronously from the update functions and
+ *  BIZoneEngineAdvance(); it must not call back into the engine.
+ */
+typedef struct BIZoneEngine *BIZoneEngineRef;
+
+typedef enum {
+    /**
+     *  Holds while the beacon is in range and meets the thresholds of the node, and has done so for dwellTime seconds.
+     */
+    BIZoneNodeBeacon = 0,
+
+    /**
+     *  Hold if all, any or at least threshold of the childCount child nodes hold.
+     */
+    BIZoneNodeAll = 1,
+    BIZoneNodeAny = 2,
+    BIZoneNodeAtLeast = 3,
+
+    /**
+     *  Holds if its single child node does not hold.
+     */
+    BIZoneNodeNot = 4
+} BIZoneNodeType;
+
+typedef struct {
+    BIZoneNodeType type;
+
+    /**
+     *  Beacon nodes: the beacon and its thresholds. A minimumRSSI of 0 and a maximumProximity of BIProximityUnknown
+     *  accept any value; otherwise an unknown RSSI or proximity fails the threshold.
+     */
+    BIBeaconKey key;
+    int32_t minimumRSSI;
+    BIProximity maximumProximity;
+    double dwellTime;
+
+    /**
+     *  Other nodes: the number of child nodes, and for at-least nodes the number of them that must hold.
+     */
+    uint32_t childCount;
+    uint32_t threshold;
+} BIZoneNode;
+
+/**
+ *  A zone. The nodes are stored in prefix order: every node that is not a beacon node is followed by its child
+ *  subtrees, e.g. { all(2), beacon A, not(1), beacon B } is "A and not B".
+ */
+typedef struct {
+    /**
+     *  Identifies the zone in transitions. Must be unique among the zones of an engine.
+     */
+    uint32_t zoneID;
+
+    const BIZoneNode *nodes;
+    size_t nodeCount;
+
+    double enterDwellTime;
+    double exitDwellTime;
+} BIZoneDefinition;
+
+typedef enum {
+    BIZoneTransitionEnter = 0,
+    BIZoneTransitionExit = 1
+} BIZoneTransition;
+
+typedef void (*BIZoneTransitionHandler)(uint32_t zoneID, BIZoneTransition transition, double timestamp, void *context);
+
+typedef struct {
+    /**
+     *  Granularity (in seconds) and number of slots of the timer wheel. Transitions are reported when the first call
+     *  after their due time arrives, so the resolution only affects efficiency, not timing.
+     */
+    double timerResolution;
+    uint32_t timerSlots;
+} BIZoneEngineConfiguration;
+
+typedef struct {
+    uint64_t ticks;
+
+    /**
+     *  Beacon conditions whose value changed, and zone programs run because of them.
+     */
+    uint64_t conditionChanges;
+    uint64_t zoneEvaluations;
+
+    uint64_t enters;
+    uint64_t exits;
+} BIZoneEngineStatistics;
+
+/**
+ *  Returns the configuration the SDK uses by default: a timer wheel of 512 slots of 0.25 seconds.
+ */
+BIZoneEngineConfiguration BIZoneEngineConfigurationMakeDefault(void);
+
+/**
+ *  Returns true if the nodes of a zone form exactly one well-formed tree (not nodes with one child, all and any nodes
+ *  with at least one, at-least thresholds between 1 and the number of children, nesting at most 64 levels deep) and
+ *  its dwell times are not negative.
+ */
+bool BIZoneDefinitionIsValid(const BIZoneDefinition *zone);
+
+/**
+ *  Compiles zones into an engine. All zones start outside. The first update or BIZoneEngineAdvance() evaluates every
+ *  zone, so a zone whose rule holds while no beacon is in range (e.g. one rooted in a not node) is entered
+ *  enterDwellTime seconds after that call. The definitions are copied.
+ *
+ *  @param configuration The configuration to use. Pass NULL to use the default configuration.
+ *  @param handler Receives the transitions.
+ *  @param context Passed to handler.
+ *  @return The engine, or NULL if a definition is not valid or two zones have the same ID.
+ */
+BIZoneEngineRef BIZoneEngineCreate(const BIZoneEngineConfiguration *configuration, const BIZoneDefinition *zones,
+                                   size_t zoneCount, BIZoneTransitionHandler handler, void *context);
+
+void BIZoneEngineDestroy(BIZoneEngineRef engine);
+
+/**
+ *  Processes one ranging tick. The smoothed signals count; beacons that do not appear are out of range.
+ *
+ *  @param timestamp The time of the tick. Must not be earlier than the previous call.
+ */
+void BIZoneEngineUpdate(BIZoneEngineRef engine, double timestamp, const BIRangedBeacon *beacons, size_t beaconCount);
+
+/**
+ *  Processes a ranging batch, using the beacons of all its regions. A beacon that is ranged in several regions counts
+ *  in range if it is in range in any of them.
+ */
+void BIZoneEngineUpdateWithBatch(BIZoneEngineRef engine, const BIRangingBatch *batch);
+
+/**
+ *  Reports all transitions that are due at timestamp. Call it periodically (e.g. once per second) so that dwell times
+ *  end on time even if no ranging ticks arrive.
+ */
+void BIZoneEngineAdvance(BIZoneEngineRef engine, double timestamp);
+
+/**
+ *  Returns true if the device is in the zone (transitions that are not due yet are not taken into account).
+ */
+bool BIZoneEngineIsInside(BIZoneEngineRef engine, uint32_t zoneID);
+
+BIZoneEngineStatistics BIZoneEngineGetStatistics(BIZoneEngineRef engine);
+
+BI_EXTERN_C_END
+
+#endif
@@ -0,0 +1,184 @@
+//
+//  AdvertisementDecoder.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIAdvertisement.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// iBeacon: company identifier 0x004C (little-endian), type 0x02, length 0x15, UUID, major, minor, measured power.
+const uint8_t iBeaconPrefix[4] = {0x4C, 0x00, 0x02, 0x15};
+const size_t iBeaconLength = 25;
+
+const uint16_t eddystoneService = 0xFEAA;
+
+enum : uint8_t {
+    EddystoneUID = 0x00,
+    EddystoneURL = 0x10,
+    EddystoneTLM = 0x20,
+    EddystoneEID = 0x30
+};
+
+// AD types.
+const uint8_t manufacturerData = 0xFF;
+const uint8_t serviceData16 = 0x16;
+
+const char *const URLSchemes[] = {"http://www.", "https://www.", "http://", "https://"};
+const char *const URLExpansions[] = {".com/", ".org/", ".edu/", ".net/", ".info/", ".biz/", ".gov/",
+                                     ".com",  ".org",  ".edu",  ".net",  ".info",  ".biz",  ".gov"};
+
+inline uint16_t loadBigEndian16(const uint8_t *bytes)
+{
+    return uint16_t(bytes[0] << 8 | bytes[1]);
+}
+
+inline uint32_t loadBigEndian32(const uint8_t *bytes)
+{
+    return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 | uint32_t(bytes[2]) << 8 | uint32_t(bytes[3]);
+}
+
+bool decodeEddystone(const uint8_t *data, size_t length, BIAdvertisement *advertisement)
+{
+    if (length < 2) {
+        return false;
+    }
+    switch (data[0]) {
+    case EddystoneUID:
+        // Two reserved bytes at the end are optional.
+        if (length < 18 || length > 20) {
+            return false;
+        }
+        advertisement->type = BIAdvertisementTypeEddystoneUID;
+        advertisement->measuredPower = int8_t(data[1]);
+        std::memcpy(advertisement->namespaceID, data + 2, sizeof(advertisement->namespaceID));
+        std::memcpy(advertisement->instanceID, data + 12, sizeof(advertisement->instanceID));
+        return true;
+    case EddystoneURL:
+        if (length < 3 || length > 20 || data[2] >= sizeof(URLSchemes) / sizeof(URLSchemes[0])) {
+            return false;
+        }
+        advertisement->type = BIAdvertisementTypeEddystoneURL;
+        advertisement->measuredPower = int8_t(data[1]);
+        advertisement->URLScheme = data[2];
+        advertisement->URL = data + 3;
+        advertisement->URLLength = length - 3;
+        return true;
+    case EddystoneTLM: {
+        // Only version 0 is unencrypted.
+        if (length != 14 || data[1] != 0) {
+            return false;
+        }
+        advertisement->type = BIAdvertisementTypeEddystoneTLM;
+        advertisement->TLMVersion = data[1];
+        advertisement->batteryVoltage = loadBigEndian16(data + 2);
+        uint16_t temperature = loadBigEndian16(data + 4); // signed 8.8 fixed point, 0x8000 if not supported
+        advertisement->temperature = temperature == 0x8000 ? NAN : double(int16_t(temperature)) / 256.0;
+        advertisement->advertisementCount = loadBigEndian32(data + 6);
+        advertisement->uptime = double(loadBigEndian32(data + 10)) / 10.0;
+        return true;
+    }
+    case EddystoneEID:
+        if (length != 10) {
+            return false;
+        }
+        advertisement->type = BIAdvertisementTypeEddystoneEID;
+        advertisement->measuredPower = int8_t(data[1]);
+        std::memcpy(advertisement->ephemeralID, data + 2, sizeof(advertisement->ephemeralID));
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+bool BIAdvertisementDecodeManufacturerData(const uint8_t *data, size_t length, BIAdvertisement *advertisement)
+{
+    if (length < iBeaconLength || std::memcmp(data, iBeaconPrefix, sizeof(iBeaconPrefix)) != 0) {
+        return false;
+    }
+    advertisement->type = BIAdvertisementTypeIBeacon;
+    std::memcpy(advertisement->key.proximityUUID, data + 4, sizeof(advertisement->key.proximityUUID));
+    advertisement->key.major = loadBigEndian16(data + 20);
+    advertisement->key.minor = loadBigEndian16(data + 22);
+    advertisement->measuredPower = int8_t(data[24]);
+    return true;
+}
+
+bool BIAdvertisementDecodeServiceData(uint16_t serviceUUID, const uint8_t *data, size_t length,
+                                      BIAdvertisement *advertisement)
+{
+    return serviceUUID == eddystoneService && decodeEddystone(data, length, advertisement);
+}
+
+bool BIAdvertisementDecodePayload(const uint8_t *payload, size_t length, BIAdvertisement *advertisement)
+{
+    // Each AD structure is a length byte followed by the AD type and length - 1 bytes of data.
+    size_t offset = 0;
+    while (offset < length) {
+        size_t structureLength = payload[offset];
+        if (structureLength == 0 || structureLength > length - offset - 1) {
+            return false;
+        }
+        const uint8_t *data = payload + offset + 2;
+        size_t dataLength = structureLength - 1;
+        switch (payload[offset + 1]) {
+        case manufacturerData:
+            if (BIAdvertisementDecodeManufacturerData(data, dataLength, advertisement)) {
+                return true;
+            }
+            break;
+        case serviceData16:
+            if (dataLength >= 2 &&
+                BIAdvertisementDecodeServiceData(uint16_t(data[0] | data[1] << 8), data + 2, dataLength - 2,
+                                                 advertisement)) {
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+        offset += 1 + structureLength;
+    }
+    return false;
+}
+
+size_t BIAdvertisementCopyURL(const BIAdvertisement *advertisement, char *buffer, size_t capacity)
+{
+    if (advertisement->type != BIAdvertisementTypeEddystoneURL ||
+        advertisement->URLScheme >= sizeof(URLSchemes) / sizeof(URLSchemes[0])) {
+        if (capacity > 0) {
+            buffer[0] = '\0';
+        }
+        return 0;
+    }
+    size_t length = 0;
+    auto append = [&](const char *string, size_t count) {
+        for (size_t i = 0; i < count; i++, length++) {
+            if (length + 1 < capacity) {
+                buffer[length] = string[i];
+            }
+        }
+    };
+    const char *scheme = URLSchemes[advertisement->URLScheme];
+    append(scheme, std::strlen(scheme));
+    for (size_t i = 0; i < advertisement->URLLength; i++) {
+        uint8_t byte = advertisement->URL[i];
+        if (byte < sizeof(URLExpansions) / sizeof(URLExpansions[0])) {
+            append(URLExpansions[byte], std::strlen(URLExpansions[byte]));
+        } else if (byte > 0x20 && byte < 0x7F) {
+            // Reserved codes (0x0E to 0x20, 0x7F and above) are skipped.
+            append(reinterpret_cast<const char *>(&byte), 1);
+        }
+    }
+    if (capacity > 0) {
+        buffer[length < capacity ? length : capacity - 1] = '\0';
+    }
+    return length;
+}
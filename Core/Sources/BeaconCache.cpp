@@ -0,0 +1,510 @@
+//
+//  BeaconCache.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "BeaconCache.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bi {
+
+static_assert(sizeof(BeaconCache::Header) == 16, "unexpected header layout");
+static_assert(sizeof(BeaconCache::Record) == 104 && offsetof(BeaconCache::Record, lastSeen) == 40,
+              "unexpected record layout");
+
+namespace {
+
+const char magic[8] = {'B', 'I', 'C', 'A', 'C', 'H', 'E', '\0'};
+const uint32_t version = 1;
+const uint64_t headerSize = sizeof(BeaconCache::Header);
+const uint64_t recordSize = sizeof(BeaconCache::Record);
+const uint32_t allFields = BICachedBeaconFieldSignal | BICachedBeaconFieldMeasuredPower | BICachedBeaconFieldName |
+                           BICachedBeaconFieldFirmwareVersion | BICachedBeaconFieldBatteryLevel;
+
+uint32_t checksum(const BeaconCache::Record &record)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = sizeof(record.checksum); i < sizeof(record); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+template <size_t Size>
+void copyString(char (&destination)[Size], const char (&source)[Size])
+{
+    std::memcpy(destination, source, Size);
+    destination[Size - 1] = '\0';
+}
+
+BeaconCache::Header makeHeader()
+{
+    BeaconCache::Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.recordSize = uint32_t(recordSize);
+    return header;
+}
+
+bool writeAll(int file, const void *bytes, size_t count, uint64_t offset)
+{
+    const uint8_t *position = static_cast<const uint8_t *>(bytes);
+    while (count > 0) {
+        ssize_t written = pwrite(file, position, count, off_t(offset));
+        if (written < 0) {
+            return false;
+        }
+        position += written;
+        count -= size_t(written);
+        offset += uint64_t(written);
+    }
+    return true;
+}
+
+BICachedBeacon beaconForRecord(const BeaconCache::Record &record)
+{
+    BICachedBeacon beacon;
+    beacon.key = record.key;
+    beacon.fields = record.fields;
+    beacon.lastSeen = record.lastSeen;
+    beacon.RSSI = record.RSSI;
+    beacon.proximity = record.proximity;
+    beacon.accuracy = record.accuracy;
+    beacon.measuredPower = record.measuredPower;
+    copyString(beacon.name, record.name);
+    copyString(beacon.firmwareVersion, record.firmwareVersion);
+    beacon.batteryLevel = record.batteryLevel;
+    return beacon;
+}
+
+} // namespace
+
+std::unique_ptr<BeaconCache> BeaconCache::open(const char *path, const BIBeaconCacheConfiguration &configuration)
+{
+    int file = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (file < 0) {
+        return nullptr;
+    }
+    std::unique_ptr<BeaconCache> cache(new BeaconCache(file, path, configuration));
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        return nullptr;
+    }
+    uint64_t fileSize = uint64_t(status.st_size);
+    if (fileSize == 0) {
+        Header header = makeHeader();
+        if (!writeAll(file, &header, sizeof(header), 0)) {
+            return nullptr;
+        }
+        fileSize = headerSize;
+    }
+    if (!cache->map(fileSize)) {
+        return nullptr;
+    }
+    return cache;
+}
+
+BeaconCache::BeaconCache(int file, const std::string &path, const BIBeaconCacheConfiguration &configuration)
+    : _configuration(configuration), _path(path), _file(file)
+{
+    _configuration.maximumBeacons = std::max<uint32_t>(_configuration.maximumBeacons, 1);
+    _configuration.maximumJournalRecords =
+        std::max(_configuration.maximumJournalRecords, _configuration.maximumBeacons);
+}
+
+BeaconCache::~BeaconCache()
+{
+    if (_mapping != nullptr) {
+        flush();
+    }
+    unmap();
+    close(_file);
+}
+
+// Pages past the end of the file are never read; they are only reserved for the records flushes will append.
+size_t BeaconCache::mappingSize(uint64_t fileSize) const
+{
+    return size_t(std::max(fileSize, headerSize + recordSize * _configuration.maximumJournalRecords));
+}
+
+bool BeaconCache::map(uint64_t fileSize)
+{
+    size_t size = mappingSize(fileSize);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, _file, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    _mapping = static_cast<const uint8_t *>(mapping);
+    _mappingSize = size;
+    _fileSize = fileSize;
+    return true;
+}
+
+void BeaconCache::unmap()
+{
+    if (_mapping != nullptr) {
+        munmap(const_cast<uint8_t *>(_mapping), _mappingSize);
+        _mapping = nullptr;
+    }
+}
+
+void BeaconCache::load()
+{
+    if (_loaded) {
+        return;
+    }
+    _loaded = true;
+
+    Header header;
+    std::memcpy(&header, _mapping, std::min<uint64_t>(sizeof(header), _fileSize));
+    if (_fileSize < headerSize || std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version ||
+        header.recordSize != recordSize) {
+        _rewrite = true;
+        return;
+    }
+
+    uint64_t offset = headerSize;
+    for (; offset + recordSize <= _fileSize; offset += recordSize) {
+        Record record;
+        std::memcpy(&record, _mapping + offset, sizeof(record));
+        if (record.checksum != checksum(record)) {
+            break;
+        }
+        _statistics.recordsLoaded++;
+        auto entry = _index.find(record.key);
+        if (entry != _index.end()) {
+            unlink(entry->second);
+            if (record.fields == 0) {
+                _index.erase(entry);
+                continue;
+            }
+        } else if (record.fields == 0) {
+            continue;
+        } else {
+            entry = _index.emplace(record.key, Entry{record.key, 0, None, 0.0, nullptr, nullptr}).first;
+        }
+        entry->second.offset = offset;
+        entry->second.lastSeen = record.lastSeen;
+        link(entry->second);
+    }
+    _journalEnd = offset;
+    _statistics.recordsDiscarded += (_fileSize - offset + recordSize - 1) / recordSize;
+
+    while (_index.size() > _configuration.maximumBeacons) {
+        evictLeastRecentlySeen();
+    }
+}
+
+BeaconCache::Record BeaconCache::record(const Entry &entry) const
+{
+    if (entry.pending != None) {
+        return _pending[entry.pending];
+    }
+    Record record;
+    std::memcpy(&record, _mapping + entry.offset, sizeof(record));
+    return record;
+}
+
+void BeaconCache::append(const Record &record, Entry *entry)
+{
+    // A beacon that is updated several times between two flushes only gets one record.
+    if (entry != nullptr && entry->pending != None) {
+        _pending[entry->pending] = record;
+        return;
+    }
+    if (entry != nullptr) {
+        entry->pending = uint32_t(_pending.size());
+    }
+    _pending.push_back(record);
+}
+
+bool BeaconCache::lookup(const BIBeaconKey &key, BICachedBeacon &beacon)
+{
+    load();
+    auto entry = _index.find(key);
+    if (entry == _index.end()) {
+        return false;
+    }
+    beacon = beaconForRecord(record(entry->second));
+    return true;
+}
+
+void BeaconCache::update(const BICachedBeacon &beacon)
+{
+    uint32_t fields = beacon.fields & allFields;
+    if (fields == 0) {
+        return;
+    }
+    load();
+    auto entry = _index.find(beacon.key);
+    Record merged = {};
+    if (entry == _index.end()) {
+        if (_index.size() >= _configuration.maximumBeacons) {
+            evictLeastRecentlySeen();
+        }
+        entry = _index.emplace(beacon.key, Entry{beacon.key, 0, None, 0.0, nullptr, nullptr}).first;
+        link(entry->second);
+        merged.key = beacon.key;
+    } else {
+        merged = record(entry->second);
+    }
+    merged.fields |= fields;
+    if (fields & BICachedBeaconFieldSignal) {
+        merged.lastSeen = beacon.lastSeen;
+        merged.RSSI = beacon.RSSI;
+        merged.proximity = beacon.proximity;
+        merged.accuracy = beacon.accuracy;
+        unlink(entry->second);
+        entry->second.lastSeen = beacon.lastSeen;
+        link(entry->second);
+    }
+    if (fields & BICachedBeaconFieldMeasuredPower) {
+        merged.measuredPower = beacon.measuredPower;
+    }
+    if (fields & BICachedBeaconFieldName) {
+        copyString(merged.name, beacon.name);
+    }
+    if (fields & BICachedBeaconFieldFirmwareVersion) {
+        copyString(merged.firmwareVersion, beacon.firmwareVersion);
+    }
+    if (fields & BICachedBeaconFieldBatteryLevel) {
+        merged.batteryLevel = beacon.batteryLevel;
+    }
+    merged.checksum = checksum(merged);
+    append(merged, &entry->second);
+}
+
+bool BeaconCache::remove(const BIBeaconKey &key)
+{
+    load();
+    auto entry = _index.find(key);
+    if (entry == _index.end()) {
+        return false;
+    }
+    if (entry->second.pending != None) {
+        // The pending record must not be written after the removal; a record of 0 fields removes the beacon anyway.
+        _pending[entry->second.pending].fields = 0;
+        _pending[entry->second.pending].checksum = checksum(_pending[entry->second.pending]);
+    } else {
+        Record removal = {};
+        removal.key = key;
+        removal.checksum = checksum(removal);
+        append(removal, nullptr);
+    }
+    unlink(entry->second);
+    _index.erase(entry);
+    return true;
+}
+
+// Signals are usually reported in the order they were seen, so a beacon with a signal goes to the newest end of the
+// list after comparing with the newest entry, and a beacon without one (lastSeen 0) to the oldest end. Only a signal
+// older than others walks the list.
+void BeaconCache::link(Entry &entry)
+{
+    Entry *older = _newest;
+    if (_oldest != nullptr && entry.lastSeen <= _oldest->lastSeen) {
+        older = nullptr;
+    } else {
+        while (older != nullptr && older->lastSeen > entry.lastSeen) {
+            older = older->older;
+        }
+    }
+    entry.older = older;
+    entry.newer = older != nullptr ? older->newer : _oldest;
+    (entry.older != nullptr ? entry.older->newer : _oldest) = &entry;
+    (entry.newer != nullptr ? entry.newer->older : _newest) = &entry;
+}
+
+void BeaconCache::unlink(Entry &entry)
+{
+    (entry.older != nullptr ? entry.older->newer : _oldest) = entry.newer;
+    (entry.newer != nullptr ? entry.newer->older : _newest) = entry.older;
+    entry.older = nullptr;
+    entry.newer = nullptr;
+}
+
+void BeaconCache::evictLeastRecentlySeen()
+{
+    remove(_oldest->key);
+}
+
+bool BeaconCache::flush()
+{
+    if (!_loaded || (_pending.empty() && !_rewrite)) {
+        return true;
+    }
+    uint64_t journalRecords = (_journalEnd - headerSize) / recordSize;
+    if (_rewrite || journalRecords + _pending.size() > _configuration.maximumJournalRecords) {
+        return compact();
+    }
+
+    if (!writeAll(_file, _pending.data(), _pending.size() * recordSize, _journalEnd)) {
+        _statistics.failedFlushes++;
+        return false;
+    }
+    for (size_t i = 0; i < _pending.size(); i++) {
+        auto entry = _index.find(_pending[i].key);
+        if (entry != _index.end() && entry->second.pending == i) {
+            entry->second.offset = _journalEnd + i * recordSize;
+            entry->second.pending = None;
+        }
+    }
+    _journalEnd += _pending.size() * recordSize;
+    if (_journalEnd < _fileSize) {
+        // Records discarded by the load are still behind the new ones. If they cannot be cut off, they would hide the
+        // records appended after them from the next load, so the next flush replaces the file instead.
+        _rewrite = ftruncate(_file, off_t(_journalEnd)) != 0;
+    }
+    _fileSize = _rewrite ? _fileSize : _journalEnd;
+    _statistics.recordsAppended += _pending.size();
+    _pending.clear();
+    return true;
+}
+
+bool BeaconCache::compact()
+{
+    std::vector<uint8_t> bytes(headerSize + recordSize * _index.size());
+    Header header = makeHeader();
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    uint64_t offset = headerSize;
+    for (auto &entry : _index) {
+        Record current = record(entry.second);
+        std::memcpy(bytes.data() + offset, &current, sizeof(current));
+        offset += recordSize;
+    }
+
+    // The new file is mapped before it replaces the old one. Until then every entry that is not pending points into the
+    // old mapping, so a compaction that fails on the way leaves the cache working from the old file.
+    std::string temporaryPath = _path + ".tmp";
+    int file = ::open(temporaryPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        _statistics.failedFlushes++;
+        return false;
+    }
+    size_t size = mappingSize(bytes.size());
+    void *mapping = MAP_FAILED;
+    if (!writeAll(file, bytes.data(), bytes.size(), 0) || fsync(file) != 0 ||
+        (mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0)) == MAP_FAILED ||
+        std::rename(temporaryPath.c_str(), _path.c_str()) != 0) {
+        if (mapping != MAP_FAILED) {
+            munmap(mapping, size);
+        }
+        close(file);
+        ::unlink(temporaryPath.c_str());
+        _statistics.failedFlushes++;
+        return false;
+    }
+
+    unmap();
+    close(_file);
+    _file = file;
+    _mapping = static_cast<const uint8_t *>(mapping);
+    _mappingSize = size;
+    _fileSize = bytes.size();
+    offset = headerSize;
+    for (auto &entry : _index) {
+        entry.second.offset = offset;
+        entry.second.pending = None;
+        offset += recordSize;
+    }
+    _journalEnd = bytes.size();
+    _rewrite = false;
+    _statistics.recordsAppended += _index.size();
+    _statistics.compactions++;
+    _pending.clear();
+    return true;
+}
+
+size_t BeaconCache::count()
+{
+    load();
+    return _index.size();
+}
+
+size_t BeaconCache::copyBeacons(BICachedBeacon *beacons, size_t capacity)
+{
+    load();
+    size_t count = 0;
+    for (const auto &entry : _index) {
+        if (count == capacity) {
+            break;
+        }
+        beacons[count++] = beaconForRecord(record(entry.second));
+    }
+    return count;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIBeaconCache {
+    std::unique_ptr<bi::BeaconCache> cache;
+};
+
+BIBeaconCacheConfiguration BIBeaconCacheConfigurationMakeDefault(void)
+{
+    BIBeaconCacheConfiguration configuration;
+    configuration.maximumBeacons = 1024;
+    configuration.maximumJournalRecords = 8192;
+    return configuration;
+}
+
+BIBeaconCacheRef BIBeaconCacheOpen(const char *path, const BIBeaconCacheConfiguration *configuration)
+{
+    std::unique_ptr<bi::BeaconCache> cache =
+        bi::BeaconCache::open(path, configuration ? *configuration : BIBeaconCacheConfigurationMakeDefault());
+    return cache ? new BIBeaconCache{std::move(cache)} : nullptr;
+}
+
+void BIBeaconCacheClose(BIBeaconCacheRef cache)
+{
+    delete cache;
+}
+
+bool BIBeaconCacheLookup(BIBeaconCacheRef cache, const BIBeaconKey *key, BICachedBeacon *beacon)
+{
+    return cache->cache->lookup(*key, *beacon);
+}
+
+void BIBeaconCacheUpdate(BIBeaconCacheRef cache, const BICachedBeacon *beacon)
+{
+    cache->cache->update(*beacon);
+}
+
+bool BIBeaconCacheRemove(BIBeaconCacheRef cache, const BIBeaconKey *key)
+{
+    return cache->cache->remove(*key);
+}
+
+bool BIBeaconCacheFlush(BIBeaconCacheRef cache)
+{
+    return cache->cache->flush();
+}
+
+size_t BIBeaconCacheGetCount(BIBeaconCacheRef cache)
+{
+    return cache->cache->count();
+}
+
+size_t BIBeaconCacheCopyBeacons(BIBeaconCacheRef cache, BICachedBeacon *beacons, size_t capacity)
+{
+    return cache->cache->copyBeacons(beacons, capacity);
+}
+
+BIBeaconCacheStatistics BIBeaconCacheGetStatistics(BIBeaconCacheRef cache)
+{
+    return cache->cache->statistics();
+}
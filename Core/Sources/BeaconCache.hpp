@@ -0,0 +1,109 @@
+//
+//  BeaconCache.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIBeaconCache.h>
+
+#include "BeaconKey.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// The journal is a header followed by fixed-size records, each a complete snapshot of one beacon (or a removal), so
+// the last record of a beacon is all there is to know about it. The file is mapped read-only with room for
+// maximumJournalRecords records past its end, and records are appended with pwrite(), which the mapping sees without
+// being remapped. The index maps each beacon to its last record, either in the mapping or among the pending records.
+// Its entries are also linked into a list ordered by the time the beacon was last seen, whose oldest end is evicted
+// when the cache is full; the entries of an unordered_map do not move, so the list can point at them.
+class BeaconCache {
+public:
+    // Returns nullptr if the file cannot be opened or mapped.
+    static std::unique_ptr<BeaconCache> open(const char *path, const BIBeaconCacheConfiguration &configuration);
+    ~BeaconCache();
+
+    BeaconCache(const BeaconCache &) = delete;
+    BeaconCache &operator=(const BeaconCache &) = delete;
+
+    bool lookup(const BIBeaconKey &key, BICachedBeacon &beacon);
+    void update(const BICachedBeacon &beacon);
+    bool remove(const BIBeaconKey &key);
+    bool flush();
+
+    size_t count();
+    size_t copyBeacons(BICachedBeacon *beacons, size_t capacity);
+    const BIBeaconCacheStatistics &statistics() const { return _statistics; }
+
+    // On-disk layout, in the byte order of the device.
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+    };
+
+    struct Record {
+        uint32_t checksum; // FNV-1a over the rest of the record
+        uint32_t fields;   // 0 if the beacon was removed
+        BIBeaconKey key;
+        int8_t measuredPower;
+        uint8_t batteryLevel;
+        uint16_t reserved;
+        int32_t RSSI;
+        int32_t proximity;
+        double lastSeen;
+        double accuracy;
+        char name[32];
+        char firmwareVersion[16];
+    };
+
+private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Entry {
+        BIBeaconKey key;
+        uint64_t offset; // of the last record in the file, unless pending
+        uint32_t pending;
+        double lastSeen;
+        Entry *older;
+        Entry *newer;
+    };
+
+    BeaconCache(int file, const std::string &path, const BIBeaconCacheConfiguration &configuration);
+
+    size_t mappingSize(uint64_t fileSize) const;
+    bool map(uint64_t fileSize);
+    void unmap();
+    void load();
+    Record record(const Entry &entry) const;
+    void append(const Record &record, Entry *entry);
+    void link(Entry &entry);
+    void unlink(Entry &entry);
+    void evictLeastRecentlySeen();
+    bool compact();
+
+    BIBeaconCacheConfiguration _configuration;
+    std::string _path;
+    int _file;
+    const uint8_t *_mapping = nullptr;
+    size_t _mappingSize = 0;
+    uint64_t _fileSize = 0;
+    uint64_t _journalEnd = 0; // end of the last valid record
+    bool _loaded = false;
+    bool _rewrite = false; // the file has to be replaced, e.g. because it has a different version
+
+    std::unordered_map<BIBeaconKey, Entry, BeaconKeyHash> _index;
+    Entry *_oldest = nullptr;
+    Entry *_newest = nullptr;
+    std::vector<Record> _pending;
+    BIBeaconCacheStatistics _statistics = {};
+};
+
+} // namespace bi
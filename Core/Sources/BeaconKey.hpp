@@ -0,0 +1,60 @@
+//
+//  BeaconKey.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BICoreTypes.h>
+
+#include <cstdint>
+#include <cstring>
+
+// BIBeaconKey lives in the global namespace, so its operators have to as well.
+inline bool operator==(const BIBeaconKey &lhs, const BIBeaconKey &rhs)
+{
+    return lhs.major == rhs.major && lhs.minor == rhs.minor &&
+           std::memcmp(lhs.proximityUUID, rhs.proximityUUID, sizeof(lhs.proximityUUID)) == 0;
+}
+
+inline bool operator!=(const BIBeaconKey &lhs, const BIBeaconKey &rhs)
+{
+    return !(lhs == rhs);
+}
+
+namespace bi {
+
+// 64-bit mix of the packed key (UUID halves, major and minor). Good enough for open addressing as well as for the
+// standard library containers.
+inline uint64_t hashBeaconKey(const BIBeaconKey &key)
+{
+    uint64_t high;
+    uint64_t low;
+    std::memcpy(&high, key.proximityUUID, sizeof(high));
+    std::memcpy(&low, key.proximityUUID + sizeof(high), sizeof(low));
+    uint64_t h = high ^ (low * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t(key.major) << 16 | key.minor) * 0xC2B2AE3D27D4EB4FULL);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+struct BeaconKeyHash {
+    size_t operator()(const BIBeaconKey &key) const { return size_t(hashBeaconKey(key)); }
+};
+
+// Orders keys by UUID bytes, major and minor.
+inline bool beaconKeyLess(const BIBeaconKey &lhs, const BIBeaconKey &rhs)
+{
+    int order = std::memcmp(lhs.proximityUUID, rhs.proximityUUID, sizeof(lhs.proximityUUID));
+    if (order != 0) {
+        return order < 0;
+    }
+    return lhs.major != rhs.major ? lhs.major < rhs.major : lhs.minor < rhs.minor;
+}
+
+} // namespace bi
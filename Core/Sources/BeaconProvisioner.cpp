@@ -0,0 +1,715 @@
+//
+//  BeaconProvisioner.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "BeaconProvisioner.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bi {
+
+namespace {
+
+// Progress: magic, record count, then per provisioned device its ID and the fingerprint of its configuration, all
+// little-endian and sorted by device ID.
+const uint8_t progressMagic[4] = {'B', 'I', 'P', 1};
+const size_t progressHeaderSize = 8;
+const size_t progressRecordSize = 12;
+
+const uint8_t rebootValue = 0x01;
+
+void storeLittleEndian(uint8_t *buffer, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = uint8_t(value >> (8 * i));
+    }
+}
+
+uint64_t loadLittleEndian(const uint8_t *buffer, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value |= uint64_t(buffer[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+BeaconProvisioner::BeaconProvisioner(const BIBeaconProvisionerConfiguration &configuration,
+                                     const BIBeaconCharacteristics &characteristics, const BIGATTTransport &transport,
+                                     BIBeaconProvisionerHandlers handlers, void *context)
+    : _configuration(configuration)
+    , _transport(transport)
+    , _handlers(handlers)
+    , _context(context)
+    , _scheduler({configuration.maximumConnections, configuration.maximumAttempts, configuration.connectTimeout,
+                  configuration.deviceTimeout, configuration.retryDelay})
+{
+    _paths[Passkey] = characteristics.passkey;
+    _paths[ProximityUUID] = characteristics.proximityUUID;
+    _paths[Major] = characteristics.major;
+    _paths[Minor] = characteristics.minor;
+    _paths[TXPowerLevel] = characteristics.TXPowerLevel;
+    _paths[AdvertisingInterval] = characteristics.advertisingInterval;
+    _paths[Reboot] = characteristics.reboot;
+    for (uint32_t step = 0; step < StepCount; step++) {
+        uint32_t service = serviceIndex(_paths[step].service);
+        if (service == _services.size()) {
+            _services.push_back(_paths[step].service);
+        }
+        _serviceIndexes[step] = service;
+    }
+}
+
+uint32_t BeaconProvisioner::settingSteps(uint32_t settings)
+{
+    const uint32_t all = BIBeaconSettingProximityUUID | BIBeaconSettingMajor | BIBeaconSettingMinor |
+                         BIBeaconSettingTXPowerLevel | BIBeaconSettingAdvertisingInterval;
+    return (settings & all) << 1;
+}
+
+size_t BeaconProvisioner::encode(uint32_t index, uint32_t step, uint8_t *buffer) const
+{
+    const BIBeaconProvisioningTarget &target = _targets[index];
+    switch (step) {
+    case ProximityUUID:
+        std::memcpy(buffer, target.key.proximityUUID, sizeof(target.key.proximityUUID));
+        return sizeof(target.key.proximityUUID);
+    case Major:
+        storeLittleEndian(buffer, target.key.major, 2);
+        return 2;
+    case Minor:
+        storeLittleEndian(buffer, target.key.minor, 2);
+        return 2;
+    case TXPowerLevel:
+        buffer[0] = target.TXPowerLevel;
+        return 1;
+    case AdvertisingInterval:
+        storeLittleEndian(buffer, target.advertisingInterval, 2);
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+uint64_t BeaconProvisioner::fingerprint(uint32_t index) const
+{
+    // FNV-1a over the settings mask and the encoded values.
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](const uint8_t *bytes, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+        }
+    };
+    uint32_t steps = settingSteps(_targets[index].settings);
+    uint8_t buffer[16];
+    storeLittleEndian(buffer, steps, 4);
+    add(buffer, 4);
+    for (uint32_t step = 0; step < StepCount; step++) {
+        if (steps & bit(step)) {
+            add(buffer, encode(index, step, buffer));
+        }
+    }
+    return hash;
+}
+
+uint32_t BeaconProvisioner::wantedSteps(uint32_t index) const
+{
+    return _devices[index].required | (_configuration.reboot ? bit(Reboot) : 0);
+}
+
+uint32_t BeaconProvisioner::step(const BIGATTCharacteristicPath &path) const
+{
+    for (uint32_t step = 0; step < StepCount; step++) {
+        if (BIGATTUUIDEqual(&_paths[step].service, &path.service) &&
+            BIGATTUUIDEqual(&_paths[step].characteristic, &path.characteristic)) {
+            return step;
+        }
+    }
+    return StepCount;
+}
+
+uint32_t BeaconProvisioner::serviceIndex(const BIGATTUUID &service) const
+{
+    for (uint32_t i = 0; i < _services.size(); i++) {
+        if (BIGATTUUIDEqual(&_services[i], &service)) {
+            return i;
+        }
+    }
+    return uint32_t(_services.size());
+}
+
+bool BeaconProvisioner::start(double timestamp, const BIBeaconProvisioningTarget *targets, size_t targetCount,
+                              const uint8_t *passkey, size_t passkeyLength, const uint8_t *progress,
+                              size_t progressLength)
+{
+    if (!isFinished()) {
+        return false;
+    }
+
+    std::unordered_map<uint32_t, uint64_t> provisioned;
+    if (progress != nullptr) {
+        if (progressLength < progressHeaderSize || std::memcmp(progress, progressMagic, sizeof(progressMagic)) != 0) {
+            return false;
+        }
+        uint64_t count = loadLittleEndian(progress + 4, 4);
+        if (progressLength != progressHeaderSize + count * progressRecordSize) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t *record = progress + progressHeaderSize + i * progressRecordSize;
+            provisioned[uint32_t(loadLittleEndian(record, 4))] = loadLittleEndian(record + 4, 8);
+        }
+    }
+
+    _targets.assign(targets, targets + targetCount);
+    _passkey.assign(passkey, passkey + passkeyLength);
+    _devices.assign(targetCount, Device());
+    _scheduler.reset(targetCount);
+    _progress = std::move(provisioned);
+    for (uint32_t i = 0; i < targetCount; i++) {
+        Device &device = _devices[i];
+        device.result.deviceID = targets[i].deviceID;
+        device.result.status = BIProvisioningStatusPending;
+        device.fingerprint = fingerprint(i);
+        device.required = settingSteps(targets[i].settings) | (_passkey.empty() ? 0 : bit(Passkey));
+        _scheduler.setDeviceID(i, targets[i].deviceID);
+    }
+    _statistics = BIBeaconProvisionerStatistics();
+    if (targetCount == 0) {
+        if (_handlers.jobFinished != nullptr) {
+            _handlers.jobFinished(_context);
+        }
+        return true;
+    }
+    for (uint32_t i = 0; i < targetCount; i++) {
+        auto it = _progress.find(_devices[i].result.deviceID);
+        if (it != _progress.end() && it->second == _devices[i].fingerprint) {
+            _devices[i].result.startedAt = timestamp;
+            finish(i, timestamp, BIProvisioningStatusAlreadyProvisioned);
+        } else {
+            _scheduler.enqueue(i);
+        }
+    }
+    advance(timestamp);
+    return true;
+}
+
+void BeaconProvisioner::cancel(double timestamp)
+{
+    _scheduler.cancel([this, timestamp](uint32_t index, bool active) {
+        if (active) {
+            _transport.disconnect(_devices[index].result.deviceID, _context);
+            _devices[index].pending = 0;
+        }
+        finish(index, timestamp, BIProvisioningStatusCancelled);
+    });
+}
+
+void BeaconProvisioner::advance(double timestamp)
+{
+    fireTimers(timestamp);
+    pump(timestamp);
+}
+
+void BeaconProvisioner::fireTimers(double timestamp)
+{
+    _scheduler.advance(timestamp, [this](uint32_t index, double deadline) { expire(index, deadline); });
+}
+
+BeaconProvisioner::Device *BeaconProvisioner::activeDevice(uint32_t deviceID, uint32_t &index)
+{
+    if (!_scheduler.find(deviceID, index) || !_scheduler.isActive(index)) {
+        return nullptr;
+    }
+    return &_devices[index];
+}
+
+void BeaconProvisioner::pump(double timestamp)
+{
+    _scheduler.pump(timestamp, [this](uint32_t index, double started) { startAttempt(index, started); });
+}
+
+void BeaconProvisioner::startAttempt(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    if (device.result.attempts == 0) {
+        device.result.startedAt = timestamp;
+    }
+    device.result.attempts = _scheduler.attempts(index);
+    device.state = State::Connecting;
+    device.found = 0;
+    device.pending = 0;
+    _statistics.connectionAttempts++;
+    _transport.connect(device.result.deviceID, _context);
+}
+
+void BeaconProvisioner::authenticate(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    if (!(device.required & bit(Passkey))) {
+        write(index, timestamp);
+        return;
+    }
+    device.state = State::Authenticating;
+    device.pending = bit(Passkey);
+    _transport.writeValue(device.result.deviceID, &_paths[Passkey], _passkey.data(), _passkey.size(), _context);
+}
+
+void BeaconProvisioner::write(uint32_t index, double timestamp)
+{
+    // All settings at once; the transport queues them on the connection.
+    Device &device = _devices[index];
+    uint32_t steps = device.required & ~bit(Passkey);
+    if (steps == 0) {
+        verify(index, timestamp);
+        return;
+    }
+    device.state = State::Writing;
+    device.pending = steps;
+    uint8_t buffer[16];
+    for (uint32_t step = 0; step < StepCount; step++) {
+        if (steps & bit(step)) {
+            _transport.writeValue(device.result.deviceID, &_paths[step], buffer, encode(index, step, buffer), _context);
+        }
+    }
+}
+
+void BeaconProvisioner::verify(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    uint32_t steps = device.required & ~bit(Passkey);
+    if (steps == 0) {
+        reboot(index, timestamp);
+        return;
+    }
+    device.state = State::Verifying;
+    device.pending = steps;
+    for (uint32_t step = 0; step < StepCount; step++) {
+        if (steps & bit(step)) {
+            _transport.readValue(device.result.deviceID, &_paths[step], _context);
+        }
+    }
+}
+
+void BeaconProvisioner::reboot(uint32_t index, double timestamp)
+{
+    // The configuration is verified at this point, so the device counts as provisioned however the reboot goes.
+    Device &device = _devices[index];
+    if (!(device.found & bit(Reboot))) {
+        release(index, true);
+        finish(index, timestamp, BIProvisioningStatusProvisioned);
+        return;
+    }
+    device.state = State::Rebooting;
+    device.pending = bit(Reboot);
+    _transport.writeValue(device.result.deviceID, &_paths[Reboot], &rebootValue, 1, _context);
+}
+
+void BeaconProvisioner::expire(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    if (device.state == State::Rebooting) {
+        release(index, true);
+        finish(index, timestamp, BIProvisioningStatusProvisioned);
+        return;
+    }
+    _statistics.timeouts++;
+    fail(index, timestamp, BIProvisioningStatusFailed, BIGATTStatusTimedOut, true);
+}
+
+void BeaconProvisioner::release(uint32_t index, bool disconnect)
+{
+    Device &device = _devices[index];
+    if (disconnect) {
+        _transport.disconnect(device.result.deviceID, _context);
+    }
+    _scheduler.release(index);
+    device.pending = 0;
+}
+
+void BeaconProvisioner::fail(uint32_t index, double timestamp, BIProvisioningStatus status, BIGATTStatus error,
+                             bool disconnect)
+{
+    Device &device = _devices[index];
+    release(index, disconnect);
+    device.result.error = error;
+    if (!_scheduler.retry(index, timestamp)) {
+        finish(index, timestamp, status);
+    }
+}
+
+void BeaconProvisioner::finish(uint32_t index, double timestamp, BIProvisioningStatus status)
+{
+    Device &device = _devices[index];
+    _scheduler.finish(index);
+    device.result.status = status;
+    device.result.finishedAt = timestamp;
+    if (status == BIProvisioningStatusProvisioned) {
+        _statistics.devicesProvisioned++;
+        _progress[device.result.deviceID] = device.fingerprint;
+    } else if (status == BIProvisioningStatusAlreadyProvisioned) {
+        _statistics.devicesSkipped++;
+    } else {
+        _statistics.devicesFailed++;
+    }
+    if (_handlers.deviceFinished != nullptr) {
+        _handlers.deviceFinished(&device.result, _context);
+    }
+    if (_scheduler.isFinished() && _handlers.jobFinished != nullptr) {
+        _handlers.jobFinished(_context);
+    }
+}
+
+void BeaconProvisioner::didConnect(uint32_t deviceID, double timestamp, BIGATTStatus status)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    if (device != nullptr && device->state == State::Connecting) {
+        if (status != BIGATTStatusSuccess) {
+            fail(index, timestamp, BIProvisioningStatusFailed, status, false);
+        } else {
+            device->state = State::DiscoveringServices;
+            _scheduler.connected(index);
+            uint32_t wanted = wantedSteps(index);
+            uint32_t services = 0;
+            for (uint32_t step = 0; step < StepCount; step++) {
+                if (wanted & bit(step)) {
+                    services |= bit(_serviceIndexes[step]);
+                }
+            }
+            _scratch.clear();
+            for (uint32_t service = 0; service < _services.size(); service++) {
+                if (services & bit(service)) {
+                    _scratch.push_back(_services[service]);
+                }
+            }
+            _transport.discoverServices(deviceID, _scratch.data(), _scratch.size(), _context);
+        }
+    }
+    pump(timestamp);
+}
+
+void BeaconProvisioner::didDisconnect(uint32_t deviceID, double timestamp)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    if (device != nullptr) {
+        if (device->state == State::Rebooting) {
+            device->result.rebooted = true;
+            release(index, false);
+            finish(index, timestamp, BIProvisioningStatusProvisioned);
+        } else {
+            _statistics.disconnections++;
+            fail(index, timestamp, BIProvisioningStatusFailed, BIGATTStatusDisconnected, false);
+        }
+    }
+    pump(timestamp);
+}
+
+void BeaconProvisioner::didDiscoverServices(uint32_t deviceID, double timestamp, BIGATTStatus status,
+                                            const BIGATTUUID *services, size_t serviceCount)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    if (device != nullptr && device->state == State::DiscoveringServices) {
+        if (status != BIGATTStatusSuccess) {
+            fail(index, timestamp, BIProvisioningStatusFailed, status, true);
+        } else {
+            // A missing service only matters if it has a required characteristic; the reboot is optional.
+            uint32_t wanted = wantedSteps(index);
+            uint32_t present = 0;
+            bool supported = true;
+            for (uint32_t step = 0; step < StepCount; step++) {
+                if (!(wanted & bit(step))) {
+                    continue;
+                }
+                const BIGATTUUID &service = _services[_serviceIndexes[step]];
+                if (std::any_of(services, services + serviceCount,
+                                [&](const BIGATTUUID &uuid) { return BIGATTUUIDEqual(&uuid, &service); })) {
+                    present |= bit(_serviceIndexes[step]);
+                } else if (device->required & bit(step)) {
+                    supported = false;
+                }
+            }
+            if (!supported) {
+                release(index, true);
+                finish(index, timestamp, BIProvisioningStatusNotSupported);
+            } else if (present == 0) {
+                authenticate(index, timestamp);
+            } else {
+                device->state = State::DiscoveringCharacteristics;
+                device->pending = present;
+                for (uint32_t service = 0; service < _services.size(); service++) {
+                    if (!(present & bit(service))) {
+                        continue;
+                    }
+                    _scratch.clear();
+                    for (uint32_t step = 0; step < StepCount; step++) {
+                        if ((wanted & bit(step)) && _serviceIndexes[step] == service) {
+                            _scratch.push_back(_paths[step].characteristic);
+                        }
+                    }
+                    _transport.discoverCharacteristics(deviceID, &_services[service], _scratch.data(), _scratch.size(),
+                                                       _context);
+                }
+            }
+        }
+    }
+    pump(timestamp);
+}
+
+void BeaconProvisioner::didDiscoverCharacteristics(uint32_t deviceID, double timestamp, const BIGATTUUID &service,
+                                                   BIGATTStatus status, const BIGATTUUID *characteristics,
+                                                   size_t characteristicCount)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    uint32_t serviceIndex = this->serviceIndex(service);
+    if (device != nullptr && device->state == State::DiscoveringCharacteristics && serviceIndex < _services.size() &&
+        (device->pending & bit(serviceIndex))) {
+        if (status != BIGATTStatusSuccess) {
+            fail(index, timestamp, BIProvisioningStatusFailed, status, true);
+        } else {
+            uint32_t wanted = wantedSteps(index);
+            for (uint32_t step = 0; step < StepCount; step++) {
+                if ((wanted & bit(step)) && _serviceIndexes[step] == serviceIndex &&
+                    std::any_of(characteristics, characteristics + characteristicCount, [&](const BIGATTUUID &uuid) {
+                        return BIGATTUUIDEqual(&uuid, &_paths[step].characteristic);
+                    })) {
+                    device->found |= bit(step);
+                }
+            }
+            device->pending &= ~bit(serviceIndex);
+            if (device->pending == 0) {
+                if ((device->found & device->required) != device->required) {
+                    release(index, true);
+                    finish(index, timestamp, BIProvisioningStatusNotSupported);
+                } else {
+                    authenticate(index, timestamp);
+                }
+            }
+        }
+    }
+    pump(timestamp);
+}
+
+void BeaconProvisioner::didWriteValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath &path,
+                                      BIGATTStatus status)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    uint32_t step = this->step(path);
+    if (device != nullptr && step < StepCount && (device->pending & bit(step))) {
+        if (device->state == State::Authenticating) {
+            if (status != BIGATTStatusSuccess) {
+                device->result.error = status;
+                release(index, true);
+                finish(index, timestamp, BIProvisioningStatusAuthenticationFailed);
+            } else {
+                write(index, timestamp);
+            }
+        } else if (device->state == State::Writing) {
+            if (status != BIGATTStatusSuccess) {
+                fail(index, timestamp, BIProvisioningStatusFailed, status, true);
+            } else {
+                _statistics.valuesWritten++;
+                device->pending &= ~bit(step);
+                if (device->pending == 0) {
+                    verify(index, timestamp);
+                }
+            }
+        } else if (device->state == State::Rebooting) {
+            device->result.rebooted = status == BIGATTStatusSuccess;
+            release(index, true);
+            finish(index, timestamp, BIProvisioningStatusProvisioned);
+        }
+    }
+    pump(timestamp);
+}
+
+void BeaconProvisioner::didReadValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath &path,
+                                     BIGATTStatus status, const uint8_t *value, size_t length)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    uint32_t step = this->step(path);
+    if (device != nullptr && device->state == State::Verifying && step < StepCount && (device->pending & bit(step))) {
+        uint8_t expected[16];
+        size_t expectedLength = encode(index, step, expected);
+        if (status != BIGATTStatusSuccess) {
+            fail(index, timestamp, BIProvisioningStatusFailed, status, true);
+        } else if (length != expectedLength || std::memcmp(value, expected, length) != 0) {
+            _statistics.verificationFailures++;
+            fail(index, timestamp, BIProvisioningStatusVerificationFailed, BIGATTStatusError, true);
+        } else {
+            device->pending &= ~bit(step);
+            if (device->pending == 0) {
+                reboot(index, timestamp);
+            }
+        }
+    }
+    pump(timestamp);
+}
+
+BIBeaconProvisioningResult BeaconProvisioner::result(size_t deviceIndex) const
+{
+    if (deviceIndex >= _devices.size()) {
+        return BIBeaconProvisioningResult();
+    }
+    return _devices[deviceIndex].result;
+}
+
+size_t BeaconProvisioner::copyProgress(uint8_t *buffer, size_t capacity) const
+{
+    size_t size = progressHeaderSize + _progress.size() * progressRecordSize;
+    if (buffer == nullptr || capacity < size) {
+        return size;
+    }
+    std::vector<std::pair<uint32_t, uint64_t>> records(_progress.begin(), _progress.end());
+    std::sort(records.begin(), records.end());
+    std::memcpy(buffer, progressMagic, sizeof(progressMagic));
+    storeLittleEndian(buffer + 4, records.size(), 4);
+    uint8_t *record = buffer + progressHeaderSize;
+    for (const auto &entry : records) {
+        storeLittleEndian(record, entry.first, 4);
+        storeLittleEndian(record + 4, entry.second, 8);
+        record += progressRecordSize;
+    }
+    return size;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIBeaconProvisioner {
+    BIBeaconProvisioner(const BIBeaconProvisionerConfiguration &configuration,
+                        const BIBeaconCharacteristics &characteristics, const BIGATTTransport &transport,
+                        BIBeaconProvisionerHandlers handlers, void *context)
+        : provisioner(configuration, characteristics, transport, handlers, context)
+    {
+    }
+    bi::BeaconProvisioner provisioner;
+};
+
+BIBeaconProvisionerConfiguration BIBeaconProvisionerConfigurationMakeDefault(void)
+{
+    BIBeaconProvisionerConfiguration configuration;
+    configuration.maximumConnections = 4;
+    configuration.maximumAttempts = 3;
+    configuration.connectTimeout = 5.0;
+    configuration.deviceTimeout = 20.0;
+    configuration.retryDelay = 2.0;
+    configuration.reboot = true;
+    return configuration;
+}
+
+BIBeaconProvisionerRef BIBeaconProvisionerCreate(const BIBeaconProvisionerConfiguration *configuration,
+                                                 const BIBeaconCharacteristics *characteristics,
+                                                 const BIGATTTransport *transport, BIBeaconProvisionerHandlers handlers,
+                                                 void *context)
+{
+    if (characteristics == nullptr || transport == nullptr || transport->writeValue == nullptr) {
+        return nullptr;
+    }
+    return new BIBeaconProvisioner(configuration ? *configuration : BIBeaconProvisionerConfigurationMakeDefault(),
+                                   *characteristics, *transport, handlers, context);
+}
+
+void BIBeaconProvisionerDestroy(BIBeaconProvisionerRef provisioner)
+{
+    delete provisioner;
+}
+
+bool BIBeaconProvisionerStart(BIBeaconProvisionerRef provisioner, double timestamp,
+                              const BIBeaconProvisioningTarget *targets, size_t targetCount, const uint8_t *passkey,
+                              size_t passkeyLength, const uint8_t *progress, size_t progressLength)
+{
+    return provisioner->provisioner.start(timestamp, targets, targetCount, passkey, passkeyLength, progress,
+                                          progressLength);
+}
+
+void BIBeaconProvisionerCancel(BIBeaconProvisionerRef provisioner, double timestamp)
+{
+    provisioner->provisioner.cancel(timestamp);
+}
+
+void BIBeaconProvisionerAdvance(BIBeaconProvisionerRef provisioner, double timestamp)
+{
+    provisioner->provisioner.advance(timestamp);
+}
+
+void BIBeaconProvisionerDidConnect(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                   BIGATTStatus status)
+{
+    provisioner->provisioner.didConnect(deviceID, timestamp, status);
+}
+
+void BIBeaconProvisionerDidDisconnect(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp)
+{
+    provisioner->provisioner.didDisconnect(deviceID, timestamp);
+}
+
+void BIBeaconProvisionerDidDiscoverServices(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                            BIGATTStatus status, const BIGATTUUID *services, size_t serviceCount)
+{
+    provisioner->provisioner.didDiscoverServices(deviceID, timestamp, status, services, serviceCount);
+}
+
+void BIBeaconProvisionerDidDiscoverCharacteristics(BIBeaconProvisionerRef provisioner, uint32_t deviceID,
+                                                   double timestamp, const BIGATTUUID *service, BIGATTStatus status,
+                                                   const BIGATTUUID *characteristics, size_t characteristicCount)
+{
+    provisioner->provisioner.didDiscoverCharacteristics(deviceID, timestamp, *service, status, characteristics,
+                                                        characteristicCount);
+}
+
+void BIBeaconProvisionerDidWriteValue(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                      const BIGATTCharacteristicPath *path, BIGATTStatus status)
+{
+    provisioner->provisioner.didWriteValue(deviceID, timestamp, *path, status);
+}
+
+void BIBeaconProvisionerDidReadValue(BIBeaconProvisionerRef provisioner, uint32_t deviceID, double timestamp,
+                                     const BIGATTCharacteristicPath *path, BIGATTStatus status, const uint8_t *value,
+                                     size_t length)
+{
+    provisioner->provisioner.didReadValue(deviceID, timestamp, *path, status, value, length);
+}
+
+bool BIBeaconProvisionerIsFinished(BIBeaconProvisionerRef provisioner)
+{
+    return provisioner->provisioner.isFinished();
+}
+
+size_t BIBeaconProvisionerGetDeviceCount(BIBeaconProvisionerRef provisioner)
+{
+    return provisioner->provisioner.deviceCount();
+}
+
+BIBeaconProvisioningResult BIBeaconProvisionerGetDeviceResult(BIBeaconProvisionerRef provisioner, size_t deviceIndex)
+{
+    return provisioner->provisioner.result(deviceIndex);
+}
+
+size_t BIBeaconProvisionerCopyProgress(BIBeaconProvisionerRef provisioner, uint8_t *buffer, size_t capacity)
+{
+    return provisioner->provisioner.copyProgress(buffer, capacity);
+}
+
+BIBeaconProvisionerStatistics BIBeaconProvisionerGetStatistics(BIBeaconProvisionerRef provisioner)
+{
+    return provisioner->provisioner.statistics();
+}
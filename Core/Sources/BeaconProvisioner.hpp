@@ -0,0 +1,123 @@
+//
+//  BeaconProvisioner.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIBeaconProvisioner.h>
+
+#include "GATTScheduler.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Scheduled by a GATTScheduler like GATTJobQueue; devices are kept in the order of the job. Each attempt walks a device
+// through discovery, authentication, writing, verification and reboot. The characteristics an attempt deals with are
+// the steps below, tracked per device as bit masks; while characteristics are discovered, pending holds services
+// instead.
+class BeaconProvisioner {
+public:
+    BeaconProvisioner(const BIBeaconProvisionerConfiguration &configuration,
+                      const BIBeaconCharacteristics &characteristics, const BIGATTTransport &transport,
+                      BIBeaconProvisionerHandlers handlers, void *context);
+
+    bool start(double timestamp, const BIBeaconProvisioningTarget *targets, size_t targetCount, const uint8_t *passkey,
+               size_t passkeyLength, const uint8_t *progress, size_t progressLength);
+    void cancel(double timestamp);
+    void advance(double timestamp);
+
+    void didConnect(uint32_t deviceID, double timestamp, BIGATTStatus status);
+    void didDisconnect(uint32_t deviceID, double timestamp);
+    void didDiscoverServices(uint32_t deviceID, double timestamp, BIGATTStatus status, const BIGATTUUID *services,
+                             size_t serviceCount);
+    void didDiscoverCharacteristics(uint32_t deviceID, double timestamp, const BIGATTUUID &service, BIGATTStatus status,
+                                    const BIGATTUUID *characteristics, size_t characteristicCount);
+    void didWriteValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath &path, BIGATTStatus status);
+    void didReadValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath &path, BIGATTStatus status,
+                      const uint8_t *value, size_t length);
+
+    bool isFinished() const { return _scheduler.isFinished(); }
+    size_t deviceCount() const { return _devices.size(); }
+    BIBeaconProvisioningResult result(size_t deviceIndex) const;
+    size_t copyProgress(uint8_t *buffer, size_t capacity) const;
+    const BIBeaconProvisionerStatistics &statistics() const { return _statistics; }
+
+private:
+    // Step n + 1 writes the setting 1 << n.
+    enum Step : uint32_t {
+        Passkey,
+        ProximityUUID,
+        Major,
+        Minor,
+        TXPowerLevel,
+        AdvertisingInterval,
+        Reboot,
+        StepCount
+    };
+
+    // Of the current attempt.
+    enum class State : uint8_t {
+        Connecting,
+        DiscoveringServices,
+        DiscoveringCharacteristics,
+        Authenticating,
+        Writing,
+        Verifying,
+        Rebooting
+    };
+
+    struct Device {
+        BIBeaconProvisioningResult result = {};
+        State state = State::Connecting;
+        uint64_t fingerprint = 0;
+        uint32_t required = 0; // steps without which the device cannot be provisioned
+        uint32_t found = 0;    // steps whose characteristics were discovered in the current attempt
+        uint32_t pending = 0;  // services or steps the current attempt waits for
+    };
+
+    static uint32_t bit(uint32_t step) { return 1u << step; }
+    static uint32_t settingSteps(uint32_t settings);
+    size_t encode(uint32_t index, uint32_t step, uint8_t *buffer) const;
+    uint64_t fingerprint(uint32_t index) const;
+    uint32_t wantedSteps(uint32_t index) const;
+    uint32_t step(const BIGATTCharacteristicPath &path) const;
+    uint32_t serviceIndex(const BIGATTUUID &service) const;
+
+    // The device with an attempt in progress, or nullptr.
+    Device *activeDevice(uint32_t deviceID, uint32_t &index);
+    void fireTimers(double timestamp);
+    void pump(double timestamp);
+    void startAttempt(uint32_t index, double timestamp);
+    void authenticate(uint32_t index, double timestamp);
+    void write(uint32_t index, double timestamp);
+    void verify(uint32_t index, double timestamp);
+    void reboot(uint32_t index, double timestamp);
+    void fail(uint32_t index, double timestamp, BIProvisioningStatus status, BIGATTStatus error, bool disconnect);
+    void release(uint32_t index, bool disconnect);
+    void finish(uint32_t index, double timestamp, BIProvisioningStatus status);
+    void expire(uint32_t index, double timestamp);
+
+    BIBeaconProvisionerConfiguration _configuration;
+    BIGATTTransport _transport;
+    BIBeaconProvisionerHandlers _handlers;
+    void *_context;
+
+    BIGATTCharacteristicPath _paths[StepCount];
+    std::vector<BIGATTUUID> _services; // distinct services of _paths
+    uint32_t _serviceIndexes[StepCount];
+
+    std::vector<BIBeaconProvisioningTarget> _targets;
+    std::vector<uint8_t> _passkey;
+    std::vector<Device> _devices;
+    std::unordered_map<uint32_t, uint64_t> _progress; // fingerprints of provisioned devices by ID
+    GATTScheduler _scheduler;
+    std::vector<BIGATTUUID> _scratch;
+    BIBeaconProvisionerStatistics _statistics = {};
+};
+
+} // namespace bi
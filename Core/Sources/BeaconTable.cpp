@@ -0,0 +1,225 @@
+//
+//  BeaconTable.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "BeaconTable.hpp"
+
+#include <algorithm>
+
+namespace bi {
+
+BeaconTable::BeaconTable(const BIBeaconTableConfiguration &configuration)
+    : _configuration(configuration)
+{
+    _configuration.maximumCount = std::max<uint32_t>(_configuration.maximumCount, 1);
+    _configuration.maximumCount = std::min<uint32_t>(_configuration.maximumCount, UINT32_MAX / 4);
+
+    uint32_t slotCount = 16;
+    while (slotCount < 2 * _configuration.maximumCount) {
+        slotCount *= 2;
+    }
+    _slots.assign(slotCount, Slot{0, 0});
+    _mask = slotCount - 1;
+}
+
+size_t BeaconTable::findSlot(const BIBeaconKey &key, uint32_t hash) const
+{
+    size_t index = hash & _mask;
+    while (true) {
+        const Slot &slot = _slots[index];
+        if (slot.handlePlusOne == 0) {
+            return index;
+        }
+        if (slot.hash == hash && _entries[slot.handlePlusOne - 1].key == key) {
+            return index;
+        }
+        index = (index + 1) & _mask;
+    }
+}
+
+BIBeaconHandle BeaconTable::lookup(const BIBeaconKey &key) const
+{
+    const Slot &slot = _slots[findSlot(key, uint32_t(hashBeaconKey(key)))];
+    return slot.handlePlusOne - 1; // BIBeaconHandleInvalid for an empty slot
+}
+
+BIBeaconHandle BeaconTable::intern(const BIBeaconKey &key, double timestamp)
+{
+    uint32_t hash = uint32_t(hashBeaconKey(key));
+    size_t index = findSlot(key, hash);
+    if (_slots[index].handlePlusOne != 0) {
+        BIBeaconHandle handle = _slots[index].handlePlusOne - 1;
+        if (timestamp > _entries[handle].lastSeen) {
+            _entries[handle].lastSeen = timestamp;
+            if (handle != _newest) {
+                unlink(handle);
+                link(handle);
+            }
+        }
+        return handle;
+    }
+
+    if (_count >= _configuration.maximumCount) {
+        remove(_oldest);
+        // Removing may have shifted the probe sequence.
+        index = findSlot(key, hash);
+    }
+
+    BIBeaconHandle handle;
+    if (!_freeHandles.empty()) {
+        handle = _freeHandles.back();
+        _freeHandles.pop_back();
+    } else {
+        handle = BIBeaconHandle(_entries.size());
+        _entries.push_back(Entry{key, timestamp, 0, false, BIBeaconHandleInvalid, BIBeaconHandleInvalid});
+    }
+    Entry &entry = _entries[handle];
+    entry.key = key;
+    entry.lastSeen = timestamp;
+    entry.generation++;
+    entry.used = true;
+    link(handle);
+
+    _slots[index] = Slot{hash, handle + 1};
+    _count++;
+    return handle;
+}
+
+void BeaconTable::remove(BIBeaconHandle handle)
+{
+    if (!contains(handle)) {
+        return;
+    }
+
+    const BIBeaconKey &key = _entries[handle].key;
+    size_t hole = findSlot(key, uint32_t(hashBeaconKey(key)));
+
+    // Backward-shift deletion: move later members of the probe sequence into the hole unless their home slot lies
+    // cyclically between the hole and their current position.
+    size_t index = hole;
+    while (true) {
+        index = (index + 1) & _mask;
+        const Slot &slot = _slots[index];
+        if (slot.handlePlusOne == 0) {
+            break;
+        }
+        size_t home = slot.hash & _mask;
+        bool homeBetweenHoleAndIndex = (hole <= index) ? (hole < home && home <= index) : (hole < home || home <= index);
+        if (!homeBetweenHoleAndIndex) {
+            _slots[hole] = slot;
+            hole = index;
+        }
+    }
+    _slots[hole] = Slot{0, 0};
+
+    unlink(handle);
+    _entries[handle].used = false;
+    _freeHandles.push_back(handle);
+    _count--;
+}
+
+// Beacons are usually interned in the order they are seen, so an entry goes to the newest end of the list after one
+// comparison. Only a timestamp older than others walks the list.
+void BeaconTable::link(BIBeaconHandle handle)
+{
+    Entry &entry = _entries[handle];
+    BIBeaconHandle older = _newest;
+    while (older != BIBeaconHandleInvalid && _entries[older].lastSeen > entry.lastSeen) {
+        older = _entries[older].older;
+    }
+    entry.older = older;
+    entry.newer = older != BIBeaconHandleInvalid ? _entries[older].newer : _oldest;
+    (entry.older != BIBeaconHandleInvalid ? _entries[entry.older].newer : _oldest) = handle;
+    (entry.newer != BIBeaconHandleInvalid ? _entries[entry.newer].older : _newest) = handle;
+}
+
+void BeaconTable::unlink(BIBeaconHandle handle)
+{
+    Entry &entry = _entries[handle];
+    (entry.older != BIBeaconHandleInvalid ? _entries[entry.older].newer : _oldest) = entry.newer;
+    (entry.newer != BIBeaconHandleInvalid ? _entries[entry.newer].older : _newest) = entry.older;
+    entry.older = BIBeaconHandleInvalid;
+    entry.newer = BIBeaconHandleInvalid;
+}
+
+size_t BeaconTable::evictIdle(double now)
+{
+    if (_configuration.idleTimeout <= 0.0) {
+        return 0;
+    }
+    size_t evicted = 0;
+    while (_oldest != BIBeaconHandleInvalid && now - _entries[_oldest].lastSeen > _configuration.idleTimeout) {
+        remove(_oldest);
+        evicted++;
+    }
+    return evicted;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIBeaconTable {
+    explicit BIBeaconTable(const BIBeaconTableConfiguration &configuration) : table(configuration) {}
+    bi::BeaconTable table;
+};
+
+bi::BeaconTable *bi::unwrapBeaconTable(BIBeaconTableRef table)
+{
+    return &table->table;
+}
+
+BIBeaconTableConfiguration BIBeaconTableConfigurationMakeDefault(void)
+{
+    BIBeaconTableConfiguration configuration;
+    configuration.maximumCount = 4096;
+    configuration.idleTimeout = 15.0 * 60.0;
+    return configuration;
+}
+
+BIBeaconTableRef BIBeaconTableCreate(const BIBeaconTableConfiguration *configuration)
+{
+    return new BIBeaconTable(configuration ? *configuration : BIBeaconTableConfigurationMakeDefault());
+}
+
+void BIBeaconTableDestroy(BIBeaconTableRef table)
+{
+    delete table;
+}
+
+BIBeaconHandle BIBeaconTableIntern(BIBeaconTableRef table, const BIBeaconKey *key, double timestamp)
+{
+    return table->table.intern(*key, timestamp);
+}
+
+BIBeaconHandle BIBeaconTableLookup(BIBeaconTableRef table, const BIBeaconKey *key)
+{
+    return table->table.lookup(*key);
+}
+
+bool BIBeaconTableGetKey(BIBeaconTableRef table, BIBeaconHandle handle, BIBeaconKey *key)
+{
+    if (!table->table.contains(handle)) {
+        return false;
+    }
+    *key = table->table.key(handle);
+    return true;
+}
+
+uint32_t BIBeaconTableGetGeneration(BIBeaconTableRef table, BIBeaconHandle handle)
+{
+    return table->table.generation(handle);
+}
+
+size_t BIBeaconTableGetCount(BIBeaconTableRef table)
+{
+    return table->table.count();
+}
+
+size_t BIBeaconTableEvictIdle(BIBeaconTableRef table, double now)
+{
+    return table->table.evictIdle(now);
+}
@@ -0,0 +1,85 @@
+//
+//  BeaconTable.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIBeaconTable.h>
+
+#include "BeaconKey.hpp"
+
+#include <vector>
+
+namespace bi {
+
+// Open-addressing hash table from beacon keys to dense handles.
+//
+// The slot array only stores the handle and the low 32 bits of the key's hash, so a probe sequence touches a few
+// adjacent 8-byte slots and only dereferences an entry when the hash fragments match. Linear probing with
+// backward-shift deletion keeps probe sequences short without tombstones. The slot array is sized for maximumCount
+// at a load factor of at most 0.5 and never rehashes.
+//
+// The entries in use are also linked into a list ordered by lastSeen, through the handles of their neighbours, so that
+// evicting the least recently seen beacon when the table is full and evicting idle beacons take constant time per
+// evicted beacon.
+class BeaconTable {
+public:
+    explicit BeaconTable(const BIBeaconTableConfiguration &configuration);
+
+    BIBeaconHandle intern(const BIBeaconKey &key, double timestamp);
+    BIBeaconHandle lookup(const BIBeaconKey &key) const;
+
+    bool contains(BIBeaconHandle handle) const { return handle < _entries.size() && _entries[handle].used; }
+    bool isCurrent(BIBeaconHandle handle, uint32_t generation) const
+    {
+        return contains(handle) && _entries[handle].generation == generation;
+    }
+    const BIBeaconKey &key(BIBeaconHandle handle) const { return _entries[handle].key; }
+    uint32_t generation(BIBeaconHandle handle) const { return handle < _entries.size() ? _entries[handle].generation : 0; }
+    double lastSeen(BIBeaconHandle handle) const { return _entries[handle].lastSeen; }
+
+    size_t count() const { return _count; }
+    // Upper bound (exclusive) of the handles handed out so far.
+    size_t handleLimit() const { return _entries.size(); }
+    const BIBeaconTableConfiguration &configuration() const { return _configuration; }
+
+    size_t evictIdle(double now);
+    void remove(BIBeaconHandle handle);
+
+private:
+    struct Entry {
+        BIBeaconKey key;
+        double lastSeen;
+        uint32_t generation;
+        bool used;
+        // Neighbours in the recency list, BIBeaconHandleInvalid at its ends.
+        BIBeaconHandle older;
+        BIBeaconHandle newer;
+    };
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t handlePlusOne; // 0 marks an empty slot
+    };
+
+    size_t findSlot(const BIBeaconKey &key, uint32_t hash) const;
+    void link(BIBeaconHandle handle);
+    void unlink(BIBeaconHandle handle);
+
+    BIBeaconTableConfiguration _configuration;
+    std::vector<Entry> _entries;
+    std::vector<BIBeaconHandle> _freeHandles;
+    std::vector<Slot> _slots;
+    uint32_t _mask;
+    size_t _count = 0;
+    BIBeaconHandle _oldest = BIBeaconHandleInvalid;
+    BIBeaconHandle _newest = BIBeaconHandleInvalid;
+};
+
+// Returns the table behind a BIBeaconTableRef, for other parts of the core that accept a shared table.
+BeaconTable *unwrapBeaconTable(BIBeaconTableRef table);
+
+} // namespace bi
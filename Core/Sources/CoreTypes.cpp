@@ -0,0 +1,104 @@
+//
+//  CoreTypes.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BICoreTypes.h>
+
+#include "BeaconKey.hpp"
+
+namespace {
+
+int hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+bool BIBeaconKeySetUUIDString(BIBeaconKey *key, const char *UUIDString)
+{
+    if (key == nullptr || UUIDString == nullptr) {
+        return false;
+    }
+
+    uint8_t bytes[16];
+    size_t byteIndex = 0;
+    for (size_t i = 0; i < 36; i++) {
+        bool expectsDash = (i == 8 || i == 13 || i == 18 || i == 23);
+        if (expectsDash) {
+            if (UUIDString[i] != '-') {
+                return false;
+            }
+            continue;
+        }
+        int high = hexDigitValue(UUIDString[i]);
+        int low = (high < 0) ? -1 : hexDigitValue(UUIDString[i + 1]);
+        if (low < 0) {
+            return false;
+        }
+        bytes[byteIndex++] = uint8_t(high << 4 | low);
+        i++;
+    }
+    if (UUIDString[36] != '\0') {
+        return false;
+    }
+
+    std::memcpy(key->proximityUUID, bytes, sizeof(bytes));
+    return true;
+}
+
+void BIBeaconKeyGetUUIDString(const BIBeaconKey *key, char *buffer)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char *out = buffer;
+    for (size_t i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            *out++ = '-';
+        }
+        *out++ = digits[key->proximityUUID[i] >> 4];
+        *out++ = digits[key->proximityUUID[i] & 0x0F];
+    }
+    *out = '\0';
+}
+
+bool BIBeaconKeyEqual(const BIBeaconKey *key1, const BIBeaconKey *key2)
+{
+    return *key1 == *key2;
+}
+
+BIProximity BIProximityForAccuracy(double accuracy)
+{
+    if (accuracy < 0.0) {
+        return BIProximityUnknown;
+    }
+    if (accuracy < BIProximityImmediateThreshold) {
+        return BIProximityImmediate;
+    }
+    if (accuracy < BIProximityNearThreshold) {
+        return BIProximityNear;
+    }
+    return BIProximityFar;
+}
+
+BISignal BISignalMakeNotInRange(double timestamp)
+{
+    BISignal signal;
+    signal.timestamp = timestamp;
+    signal.RSSI = 0;
+    signal.proximity = BIProximityUnknown;
+    signal.accuracy = -1.0;
+    signal.inRange = false;
+    return signal;
+}
@@ -0,0 +1,279 @@
+//
+//  DeviceScanner.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "DeviceScanner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace bi {
+
+namespace {
+
+BIBeaconTableConfiguration tableConfiguration(const BIDeviceScannerConfiguration &configuration)
+{
+    // Devices are only removed by the scanner itself, or by the table when it is full.
+    BIBeaconTableConfiguration table;
+    table.maximumCount = std::max<uint32_t>(configuration.maximumDevices, 1);
+    table.idleTimeout = 0.0;
+    return table;
+}
+
+} // namespace
+
+DeviceScanner::DeviceScanner(const BIDeviceScannerConfiguration &configuration, BIDeviceScanHandler handler,
+                             void *context)
+    : _configuration(configuration)
+    , _handler(handler)
+    , _context(context)
+    , _table(tableConfiguration(configuration))
+    , _devices(std::max<uint32_t>(configuration.maximumDevices, 1))
+    , _expiry(0.1, 256)
+    , _nextDelivery(-HUGE_VAL)
+{
+}
+
+void DeviceScanner::resetInterval(Device &device)
+{
+    device.device.intervalPacketCount = 0;
+    device.device.minimumRSSI = BIScannerRSSIUnavailable;
+    device.device.maximumRSSI = BIScannerRSSIUnavailable;
+    device.device.meanRSSI = BIScannerRSSIUnavailable;
+    device.intervalRSSISum = 0;
+    device.intervalRSSICount = 0;
+}
+
+void DeviceScanner::reportPacket(const BIPeripheralIdentifier &identifier, double timestamp, int32_t RSSI,
+                                 const BIAdvertisement *advertisement)
+{
+    BIBeaconKey key = {};
+    std::memcpy(key.proximityUUID, identifier.bytes, sizeof(key.proximityUUID));
+    BIBeaconHandle handle = _table.intern(key, timestamp);
+    if (handle == BIBeaconHandleInvalid) {
+        return;
+    }
+    _statistics.packets++;
+
+    Device &device = _devices[handle];
+    uint32_t generation = _table.generation(handle);
+    if (!device.live || device.generation != generation) {
+        if (device.live) {
+            // The table was full and gave the least recently seen device's handle to this one.
+            _statistics.devicesEvicted++;
+            _statistics.devicesLost++;
+            if (!device.added) {
+                // Its URL storage is about to be reused.
+                appendDevice(_lost, device);
+                _lost.back().advertisement.URL = nullptr;
+                _lost.back().advertisement.URLLength = 0;
+            }
+        }
+        bool listed = device.dirty;
+        device = Device();
+        device.dirty = listed;
+        device.live = true;
+        device.generation = generation;
+        device.added = true;
+        device.device.identifier = identifier;
+        device.device.firstSeen = timestamp;
+        device.device.lastSeen = timestamp;
+        device.device.lastRSSI = BIScannerRSSIUnavailable;
+        device.device.advertisement.type = BIAdvertisementTypeUnknown;
+        resetInterval(device);
+        _expiry.schedule(handle, timestamp + _configuration.timeToLive);
+        _statistics.devicesAdded++;
+    }
+
+    BIScannedDevice &aggregate = device.device;
+    aggregate.lastSeen = std::max(aggregate.lastSeen, timestamp);
+    aggregate.packetCount++;
+    aggregate.intervalPacketCount++;
+    if (RSSI != BIScannerRSSIUnavailable) {
+        aggregate.lastRSSI = RSSI;
+        if (device.intervalRSSICount == 0) {
+            aggregate.minimumRSSI = RSSI;
+            aggregate.maximumRSSI = RSSI;
+        } else {
+            aggregate.minimumRSSI = std::min(aggregate.minimumRSSI, RSSI);
+            aggregate.maximumRSSI = std::max(aggregate.maximumRSSI, RSSI);
+        }
+        device.intervalRSSISum += RSSI;
+        device.intervalRSSICount++;
+    }
+    if (advertisement != nullptr) {
+        aggregate.advertisement = *advertisement;
+        if (advertisement->type == BIAdvertisementTypeEddystoneURL) {
+            size_t length = std::min(advertisement->URLLength, sizeof(device.URL));
+            std::memcpy(device.URL, advertisement->URL, length);
+            aggregate.advertisement.URL = device.URL;
+            aggregate.advertisement.URLLength = length;
+        }
+    }
+    if (!device.dirty) {
+        device.dirty = true;
+        _dirty.push_back(handle);
+    }
+
+    advance(timestamp);
+}
+
+void DeviceScanner::appendDevice(std::vector<BIScannedDevice> &devices, Device &device)
+{
+    devices.push_back(device.device);
+    if (device.intervalRSSICount > 0) {
+        devices.back().meanRSSI = double(device.intervalRSSISum) / double(device.intervalRSSICount);
+    }
+}
+
+void DeviceScanner::advance(double timestamp)
+{
+    if (timestamp >= _nextDelivery) {
+        deliver(timestamp);
+    }
+}
+
+void DeviceScanner::flush(double timestamp)
+{
+    deliver(timestamp);
+}
+
+void DeviceScanner::deliver(double timestamp)
+{
+    // Expiry timers are not moved by packets; a timer that fires for a device seen since is pushed back instead.
+    _expiry.advance(timestamp, [this, timestamp](uint32_t handle, double) {
+        Device &device = _devices[handle];
+        double deadline = device.device.lastSeen + _configuration.timeToLive;
+        if (deadline > timestamp) {
+            _expiry.schedule(handle, deadline);
+            return;
+        }
+        if (!device.added) {
+            appendDevice(_lost, device);
+        }
+        device.live = false;
+        _table.remove(handle);
+        _statistics.devicesLost++;
+    });
+
+    for (BIBeaconHandle handle : _dirty) {
+        Device &device = _devices[handle];
+        device.dirty = false;
+        if (!device.live) {
+            continue;
+        }
+        appendDevice(device.added ? _added : _updated, device);
+        device.added = false;
+        resetInterval(device);
+    }
+    _dirty.clear();
+
+    if (_added.empty() && _updated.empty() && _lost.empty()) {
+        return;
+    }
+    BIDeviceScanDelta delta;
+    delta.timestamp = timestamp;
+    delta.added = _added.data();
+    delta.addedCount = _added.size();
+    delta.updated = _updated.data();
+    delta.updatedCount = _updated.size();
+    delta.lost = _lost.data();
+    delta.lostCount = _lost.size();
+    _statistics.deltas++;
+    _nextDelivery = timestamp + _configuration.deliveryInterval;
+    if (_handler != nullptr) {
+        _handler(&delta, _context);
+    }
+    _added.clear();
+    _updated.clear();
+    _lost.clear();
+}
+
+size_t DeviceScanner::copyDevices(BIScannedDevice *devices, size_t capacity) const
+{
+    size_t count = 0;
+    for (const Device &device : _devices) {
+        if (count == capacity) {
+            break;
+        }
+        if (!device.live) {
+            continue;
+        }
+        BIScannedDevice &copy = devices[count++];
+        copy = device.device;
+        if (device.intervalRSSICount > 0) {
+            copy.meanRSSI = double(device.intervalRSSISum) / double(device.intervalRSSICount);
+        }
+        copy.advertisement.URL = nullptr;
+        copy.advertisement.URLLength = 0;
+    }
+    return count;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIDeviceScanner {
+    BIDeviceScanner(const BIDeviceScannerConfiguration &configuration, BIDeviceScanHandler handler, void *context)
+        : scanner(configuration, handler, context)
+    {
+    }
+    bi::DeviceScanner scanner;
+};
+
+BIDeviceScannerConfiguration BIDeviceScannerConfigurationMakeDefault(void)
+{
+    BIDeviceScannerConfiguration configuration;
+    configuration.deliveryInterval = 1.0;
+    configuration.timeToLive = 10.0;
+    configuration.maximumDevices = 1024;
+    return configuration;
+}
+
+BIDeviceScannerRef BIDeviceScannerCreate(const BIDeviceScannerConfiguration *configuration, BIDeviceScanHandler handler,
+                                         void *context)
+{
+    return new BIDeviceScanner(configuration ? *configuration : BIDeviceScannerConfigurationMakeDefault(), handler,
+                               context);
+}
+
+void BIDeviceScannerDestroy(BIDeviceScannerRef scanner)
+{
+    delete scanner;
+}
+
+void BIDeviceScannerReportPacket(BIDeviceScannerRef scanner, const BIPeripheralIdentifier *identifier, double timestamp,
+                                 int32_t RSSI, const BIAdvertisement *advertisement)
+{
+    scanner->scanner.reportPacket(*identifier, timestamp, RSSI, advertisement);
+}
+
+void BIDeviceScannerAdvance(BIDeviceScannerRef scanner, double timestamp)
+{
+    scanner->scanner.advance(timestamp);
+}
+
+void BIDeviceScannerFlush(BIDeviceScannerRef scanner, double timestamp)
+{
+    scanner->scanner.flush(timestamp);
+}
+
+size_t BIDeviceScannerGetDeviceCount(BIDeviceScannerRef scanner)
+{
+    return scanner->scanner.deviceCount();
+}
+
+size_t BIDeviceScannerCopyDevices(BIDeviceScannerRef scanner, BIScannedDevice *devices, size_t capacity)
+{
+    return scanner->scanner.copyDevices(devices, capacity);
+}
+
+BIDeviceScannerStatistics BIDeviceScannerGetStatistics(BIDeviceScannerRef scanner)
+{
+    return scanner->scanner.statistics();
+}
@@ -0,0 +1,70 @@
+//
+//  DeviceScanner.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIDeviceScanner.h>
+
+#include "BeaconTable.hpp"
+#include "TimerWheel.hpp"
+
+#include <vector>
+
+namespace bi {
+
+// Peripheral identifiers are interned in a BeaconTable (as the proximity UUID of a key with major and minor 0), whose
+// dense handles index the per-device aggregates and double as timer IDs. A packet only updates its device and marks
+// it dirty. Delivering a delta first advances the expiry timers, which are scheduled once per device and only pushed
+// back to lastSeen + timeToLive when they fire, so that packets never touch the wheel; then it walks the dirty devices
+// and resets their interval aggregates. A handle whose generation changed under a live device was taken over by the
+// table because it was full.
+class DeviceScanner {
+public:
+    DeviceScanner(const BIDeviceScannerConfiguration &configuration, BIDeviceScanHandler handler, void *context);
+
+    void reportPacket(const BIPeripheralIdentifier &identifier, double timestamp, int32_t RSSI,
+                      const BIAdvertisement *advertisement);
+    void advance(double timestamp);
+    void flush(double timestamp);
+
+    size_t deviceCount() const { return _table.count(); }
+    size_t copyDevices(BIScannedDevice *devices, size_t capacity) const;
+    const BIDeviceScannerStatistics &statistics() const { return _statistics; }
+
+private:
+    struct Device {
+        BIScannedDevice device;
+        int64_t intervalRSSISum;
+        uint32_t intervalRSSICount;
+        uint32_t generation;
+        bool live;
+        bool dirty;
+        bool added; // not delivered yet
+        uint8_t URL[17];
+    };
+
+    void resetInterval(Device &device);
+    void appendDevice(std::vector<BIScannedDevice> &devices, Device &device);
+    void deliver(double timestamp);
+
+    BIDeviceScannerConfiguration _configuration;
+    BIDeviceScanHandler _handler;
+    void *_context;
+
+    BeaconTable _table;
+    std::vector<Device> _devices; // by handle
+    std::vector<BIBeaconHandle> _dirty;
+    TimerWheel _expiry;
+    double _nextDelivery;
+
+    std::vector<BIScannedDevice> _added;
+    std::vector<BIScannedDevice> _updated;
+    std::vector<BIScannedDevice> _lost;
+    BIDeviceScannerStatistics _statistics = {};
+};
+
+} // namespace bi
@@ -0,0 +1,266 @@
+//
+//  DistanceKernel.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "DistanceKernel.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace bi {
+
+using namespace distance_kernel;
+
+DistanceKernelConstants makeDistanceKernelConstants(const BIDistanceModel &model)
+{
+    DistanceKernelConstants constants;
+    constants.referenceLoss = model.referenceLoss;
+    constants.distanceFactor = 3.3219280948873622 / (10.0 * model.pathLossExponent);
+    constants.accuracyScale = model.accuracyScale;
+    constants.accuracyExponent = model.accuracyExponent;
+    constants.accuracyOffset = model.accuracyOffset;
+    return constants;
+}
+
+void estimateDistancesScalar(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                             double *distances, double *accuracies, int32_t *proximities)
+{
+    estimateBatch<ScalarOps>(constants, RSSI, txPower, count, distances, accuracies, proximities);
+}
+
+#if defined(__SSE2__)
+
+namespace {
+
+struct SSE2Ops {
+    typedef __m128d Vector;
+    typedef __m128d Mask;
+    static const size_t width = 2;
+
+    static __m128d set(double value) { return _mm_set1_pd(value); }
+    static __m128d loadInt32(const int32_t *values)
+    {
+        return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(values)));
+    }
+    static void store(double *destination, __m128d value) { _mm_storeu_pd(destination, value); }
+    static void storeInt32(int32_t *destination, __m128d value)
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(destination), _mm_cvttpd_epi32(value));
+    }
+
+    static __m128d add(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+    static __m128d sub(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+    static __m128d mul(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+    static __m128d div(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+    static __m128d min(__m128d a, __m128d b) { return _mm_min_pd(a, b); }
+    static __m128d max(__m128d a, __m128d b) { return _mm_max_pd(a, b); }
+
+    static __m128d less(__m128d a, __m128d b) { return _mm_cmplt_pd(a, b); }
+    static __m128d greater(__m128d a, __m128d b) { return _mm_cmpgt_pd(a, b); }
+    static __m128d greaterEqual(__m128d a, __m128d b) { return _mm_cmpge_pd(a, b); }
+    static __m128d orMask(__m128d a, __m128d b) { return _mm_or_pd(a, b); }
+    static __m128d select(__m128d mask, __m128d a, __m128d b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+
+    static __m128d andOr(__m128d x, uint64_t andMask, uint64_t orMask)
+    {
+        __m128i bits = _mm_and_si128(_mm_castpd_si128(x), _mm_set1_epi64x(int64_t(andMask)));
+        return _mm_castsi128_pd(_mm_or_si128(bits, _mm_set1_epi64x(int64_t(orMask))));
+    }
+    static __m128d shiftRightOr(__m128d x, uint64_t orMask)
+    {
+        __m128i bits = _mm_srli_epi64(_mm_castpd_si128(x), 52);
+        return _mm_castsi128_pd(_mm_or_si128(bits, _mm_set1_epi64x(int64_t(orMask))));
+    }
+    static __m128d addShiftLeft(__m128d x, int64_t addend)
+    {
+        __m128i bits = _mm_add_epi64(_mm_castpd_si128(x), _mm_set1_epi64x(addend));
+        return _mm_castsi128_pd(_mm_slli_epi64(bits, 52));
+    }
+};
+
+} // namespace
+
+bool estimateDistancesSSE2(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                           double *distances, double *accuracies, int32_t *proximities)
+{
+    estimateBatch<SSE2Ops>(constants, RSSI, txPower, count, distances, accuracies, proximities);
+    return true;
+}
+
+#else
+
+bool estimateDistancesSSE2(const DistanceKernelConstants &, const int32_t *, const int32_t *, size_t, double *, double *, int32_t *)
+{
+    return false;
+}
+
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+
+namespace {
+
+struct NEONOps {
+    typedef float64x2_t Vector;
+    typedef uint64x2_t Mask;
+    static const size_t width = 2;
+
+    static float64x2_t set(double value) { return vdupq_n_f64(value); }
+    static float64x2_t loadInt32(const int32_t *values) { return vcvtq_f64_s64(vmovl_s32(vld1_s32(values))); }
+    static void store(double *destination, float64x2_t value) { vst1q_f64(destination, value); }
+    static void storeInt32(int32_t *destination, float64x2_t value) { vst1_s32(destination, vmovn_s64(vcvtq_s64_f64(value))); }
+
+    static float64x2_t add(float64x2_t a, float64x2_t b) { return vaddq_f64(a, b); }
+    static float64x2_t sub(float64x2_t a, float64x2_t b) { return vsubq_f64(a, b); }
+    static float64x2_t mul(float64x2_t a, float64x2_t b) { return vmulq_f64(a, b); }
+    static float64x2_t div(float64x2_t a, float64x2_t b) { return vdivq_f64(a, b); }
+    // Written as compare and select to match ScalarOps and minpd/maxpd exactly.
+    static float64x2_t min(float64x2_t a, float64x2_t b) { return vbslq_f64(vcltq_f64(a, b), a, b); }
+    static float64x2_t max(float64x2_t a, float64x2_t b) { return vbslq_f64(vcgtq_f64(a, b), a, b); }
+
+    static uint64x2_t less(float64x2_t a, float64x2_t b) { return vcltq_f64(a, b); }
+    static uint64x2_t greater(float64x2_t a, float64x2_t b) { return vcgtq_f64(a, b); }
+    static uint64x2_t greaterEqual(float64x2_t a, float64x2_t b) { return vcgeq_f64(a, b); }
+    static uint64x2_t orMask(uint64x2_t a, uint64x2_t b) { return vorrq_u64(a, b); }
+    static float64x2_t select(uint64x2_t mask, float64x2_t a, float64x2_t b) { return vbslq_f64(mask, a, b); }
+
+    static float64x2_t andOr(float64x2_t x, uint64_t andMask, uint64_t orMask)
+    {
+        uint64x2_t bits = vandq_u64(vreinterpretq_u64_f64(x), vdupq_n_u64(andMask));
+        return vreinterpretq_f64_u64(vorrq_u64(bits, vdupq_n_u64(orMask)));
+    }
+    static float64x2_t shiftRightOr(float64x2_t x, uint64_t orMask)
+    {
+        uint64x2_t bits = vshrq_n_u64(vreinterpretq_u64_f64(x), 52);
+        return vreinterpretq_f64_u64(vorrq_u64(bits, vdupq_n_u64(orMask)));
+    }
+    static float64x2_t addShiftLeft(float64x2_t x, int64_t addend)
+    {
+        uint64x2_t bits = vaddq_u64(vreinterpretq_u64_f64(x), vdupq_n_u64(uint64_t(addend)));
+        return vreinterpretq_f64_u64(vshlq_n_u64(bits, 52));
+    }
+};
+
+} // namespace
+
+bool estimateDistancesNEON(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                           double *distances, double *accuracies, int32_t *proximities)
+{
+    estimateBatch<NEONOps>(constants, RSSI, txPower, count, distances, accuracies, proximities);
+    return true;
+}
+
+#else
+
+bool estimateDistancesNEON(const DistanceKernelConstants &, const int32_t *, const int32_t *, size_t, double *, double *, int32_t *)
+{
+    return false;
+}
+
+#endif
+
+static bool CPUSupportsAVX2()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+static bool kernelIsAvailable(BIDistanceKernel kernel)
+{
+    // Probe the compiled-in kernels with an empty batch.
+    DistanceKernelConstants constants = {};
+    switch (kernel) {
+    case BIDistanceKernelAutomatic:
+    case BIDistanceKernelScalar:
+        return true;
+    case BIDistanceKernelSSE2:
+        return estimateDistancesSSE2(constants, nullptr, nullptr, 0, nullptr, nullptr, nullptr);
+    case BIDistanceKernelAVX2:
+        return CPUSupportsAVX2() && estimateDistancesAVX2(constants, nullptr, nullptr, 0, nullptr, nullptr, nullptr);
+    case BIDistanceKernelNEON:
+        return estimateDistancesNEON(constants, nullptr, nullptr, 0, nullptr, nullptr, nullptr);
+    }
+    return false;
+}
+
+static BIDistanceKernel automaticKernel()
+{
+    static const BIDistanceKernel kernel = [] {
+        const BIDistanceKernel preferred[] = {BIDistanceKernelAVX2, BIDistanceKernelNEON, BIDistanceKernelSSE2};
+        for (BIDistanceKernel candidate : preferred) {
+            if (kernelIsAvailable(candidate)) {
+                return candidate;
+            }
+        }
+        return BIDistanceKernelScalar;
+    }();
+    return kernel;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+BIDistanceModel BIDistanceModelMakeDefault(void)
+{
+    BIDistanceModel model;
+    model.referenceLoss = -41.0;
+    model.pathLossExponent = 2.0;
+    model.accuracyScale = 0.89976;
+    model.accuracyExponent = 7.7095;
+    model.accuracyOffset = 0.111;
+    return model;
+}
+
+void BIEstimateDistances(const BIDistanceModel *model, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                         double *distances, double *accuracies, int32_t *proximities)
+{
+    BIEstimateDistancesWithKernel(BIDistanceKernelAutomatic, model, RSSI, txPower, count, distances, accuracies, proximities);
+}
+
+bool BIEstimateDistancesWithKernel(BIDistanceKernel kernel, const BIDistanceModel *model, const int32_t *RSSI,
+                                   const int32_t *txPower, size_t count, double *distances, double *accuracies,
+                                   int32_t *proximities)
+{
+    if (!bi::kernelIsAvailable(kernel)) {
+        return false;
+    }
+    if (kernel == BIDistanceKernelAutomatic) {
+        kernel = bi::automaticKernel();
+    }
+    bi::DistanceKernelConstants constants = bi::makeDistanceKernelConstants(model ? *model : BIDistanceModelMakeDefault());
+    switch (kernel) {
+    case BIDistanceKernelSSE2:
+        return bi::estimateDistancesSSE2(constants, RSSI, txPower, count, distances, accuracies, proximities);
+    case BIDistanceKernelAVX2:
+        return bi::estimateDistancesAVX2(constants, RSSI, txPower, count, distances, accuracies, proximities);
+    case BIDistanceKernelNEON:
+        return bi::estimateDistancesNEON(constants, RSSI, txPower, count, distances, accuracies, proximities);
+    case BIDistanceKernelAutomatic:
+    case BIDistanceKernelScalar:
+        break;
+    }
+    bi::estimateDistancesScalar(constants, RSSI, txPower, count, distances, accuracies, proximities);
+    return true;
+}
+
+bool BIDistanceKernelIsAvailable(BIDistanceKernel kernel)
+{
+    return bi::kernelIsAvailable(kernel);
+}
+
+BIDistanceKernel BIDistanceKernelGetAutomatic(void)
+{
+    return bi::automaticKernel();
+}
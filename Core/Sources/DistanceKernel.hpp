@@ -0,0 +1,236 @@
+//
+//  DistanceKernel.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// The distance estimation kernel, written once against a small set of vector operations. Every instruction set
+// provides an Ops type (Vector, Mask, width and the operations below); ScalarOps is the one-lane version. Because all
+// kernels evaluate exactly the same operations in the same order, and each operation is a correctly rounded IEEE-754
+// operation (or exact bit manipulation), the results are bit-identical across kernels. Compile this code with
+// -ffp-contract=off so that the compiler does not fuse multiplications and additions in some paths only.
+
+#pragma once
+
+#include <BICore/BIDistanceEstimation.h>
+
+#include <cstring>
+
+namespace bi {
+
+struct DistanceKernelConstants {
+    double referenceLoss;
+    double distanceFactor; // log2(10) / (10 * pathLossExponent)
+    double accuracyScale;
+    double accuracyExponent;
+    double accuracyOffset;
+};
+
+DistanceKernelConstants makeDistanceKernelConstants(const BIDistanceModel &model);
+
+// The kernels for the individual instruction sets. The SIMD variants return false if they are not compiled in.
+void estimateDistancesScalar(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                             double *distances, double *accuracies, int32_t *proximities);
+bool estimateDistancesSSE2(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                           double *distances, double *accuracies, int32_t *proximities);
+bool estimateDistancesAVX2(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                           double *distances, double *accuracies, int32_t *proximities);
+bool estimateDistancesNEON(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                           double *distances, double *accuracies, int32_t *proximities);
+
+namespace distance_kernel {
+
+// Internal linkage on purpose: DistanceKernelAVX2.cpp is compiled with -mavx2, and its copies of these inline functions
+// must not be picked by the linker for the other translation units, which run on CPUs without AVX2.
+namespace {
+
+const uint64_t mantissaMask = 0x000FFFFFFFFFFFFFULL;
+const uint64_t oneBits = 0x3FF0000000000000ULL;         // 1.0
+const uint64_t twoPow52Bits = 0x4330000000000000ULL;    // 2^52
+const uint64_t roundingMagicBits = 0x4338000000000000ULL; // 1.5 * 2^52
+const double twoPow52 = 4503599627370496.0;
+const double roundingMagic = 6755399441055744.0;
+const double sqrt2 = 1.4142135623730951;
+constexpr double ln2 = 0.69314718055994531;
+
+// log2(m) = 2 / ln(2) * atanh(s) with s = (m - 1) / (m + 1), as an odd series in s: coefficient i is 2 / ((2i + 1) ln 2).
+const int log2Terms = 11;
+constexpr double log2Coefficient(int i) { return 2.0 / (double(2 * i + 1) * ln2); }
+
+// 2^f = e^(f ln 2) for |f| <= 0.5 as a Taylor series: coefficient n is ln(2)^n / n!.
+const int exp2Terms = 13;
+constexpr double exp2Coefficient(int n) { return (n == 0) ? 1.0 : exp2Coefficient(n - 1) * ln2 / double(n); }
+
+template <typename Ops>
+inline typename Ops::Vector log2(typename Ops::Vector x)
+{
+    using V = typename Ops::Vector;
+    // x = m * 2^e with m in [1, 2), then moved to [sqrt(2)/2, sqrt(2)) so that |s| <= 0.172.
+    V exponent = Ops::sub(Ops::sub(Ops::shiftRightOr(x, twoPow52Bits), Ops::set(twoPow52)), Ops::set(1023.0));
+    V mantissa = Ops::andOr(x, mantissaMask, oneBits);
+    typename Ops::Mask large = Ops::greater(mantissa, Ops::set(sqrt2));
+    mantissa = Ops::select(large, Ops::mul(mantissa, Ops::set(0.5)), mantissa);
+    exponent = Ops::select(large, Ops::add(exponent, Ops::set(1.0)), exponent);
+
+    V s = Ops::div(Ops::sub(mantissa, Ops::set(1.0)), Ops::add(mantissa, Ops::set(1.0)));
+    V z = Ops::mul(s, s);
+    V polynomial = Ops::set(log2Coefficient(log2Terms - 1));
+    for (int i = log2Terms - 2; i >= 0; i--) {
+        polynomial = Ops::add(Ops::mul(polynomial, z), Ops::set(log2Coefficient(i)));
+    }
+    return Ops::add(exponent, Ops::mul(s, polynomial));
+}
+
+template <typename Ops>
+inline typename Ops::Vector exp2(typename Ops::Vector y)
+{
+    using V = typename Ops::Vector;
+    y = Ops::max(Ops::min(y, Ops::set(1023.0)), Ops::set(-1022.0));
+    // Adding 1.5 * 2^52 rounds to the nearest integer k and leaves k in the low bits of the mantissa.
+    V shifted = Ops::add(y, Ops::set(roundingMagic));
+    V k = Ops::sub(shifted, Ops::set(roundingMagic));
+    V f = Ops::sub(y, k);
+
+    V polynomial = Ops::set(exp2Coefficient(exp2Terms - 1));
+    for (int n = exp2Terms - 2; n >= 0; n--) {
+        polynomial = Ops::add(Ops::mul(polynomial, f), Ops::set(exp2Coefficient(n)));
+    }
+    // 2^k has the biased exponent k + 1023 and an empty mantissa.
+    V scale = Ops::addShiftLeft(shifted, int64_t(1023) - int64_t(roundingMagicBits));
+    return Ops::mul(polynomial, scale);
+}
+
+template <typename Ops>
+inline void estimate(const DistanceKernelConstants &constants, typename Ops::Vector RSSI, typename Ops::Vector txPower,
+                     typename Ops::Vector &distance, typename Ops::Vector &accuracy, typename Ops::Vector &proximity)
+{
+    using V = typename Ops::Vector;
+    using M = typename Ops::Mask;
+    V zero = Ops::set(0.0);
+    V one = Ops::set(1.0);
+    V unknownValue = Ops::set(-1.0);
+
+    V measuredPower = Ops::add(txPower, Ops::set(constants.referenceLoss));
+    M unknown = Ops::orMask(Ops::greaterEqual(RSSI, zero), Ops::greaterEqual(measuredPower, zero));
+    // Keep unknown lanes away from log2(<= 0).
+    V ratio = Ops::select(unknown, one, Ops::div(RSSI, measuredPower));
+
+    distance = exp2<Ops>(Ops::mul(Ops::sub(measuredPower, RSSI), Ops::set(constants.distanceFactor)));
+
+    // Both branches of the accuracy curve are powers of the ratio, so one exp2 serves both.
+    M close = Ops::less(ratio, one);
+    V power = exp2<Ops>(Ops::mul(log2<Ops>(ratio), Ops::select(close, Ops::set(10.0), Ops::set(constants.accuracyExponent))));
+    V fittedAccuracy = Ops::add(Ops::mul(Ops::set(constants.accuracyScale), power), Ops::set(constants.accuracyOffset));
+    accuracy = Ops::select(close, power, fittedAccuracy);
+
+    proximity = Ops::set(double(BIProximityFar));
+    proximity = Ops::select(Ops::less(accuracy, Ops::set(BIProximityNearThreshold)), Ops::set(double(BIProximityNear)), proximity);
+    proximity = Ops::select(Ops::less(accuracy, Ops::set(BIProximityImmediateThreshold)), Ops::set(double(BIProximityImmediate)),
+                            proximity);
+
+    distance = Ops::select(unknown, unknownValue, distance);
+    accuracy = Ops::select(unknown, unknownValue, accuracy);
+    proximity = Ops::select(unknown, Ops::set(double(BIProximityUnknown)), proximity);
+}
+
+struct ScalarOps {
+    typedef double Vector;
+    typedef bool Mask;
+    static const size_t width = 1;
+
+    static uint64_t bits(double value)
+    {
+        uint64_t result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+    static double fromBits(uint64_t value)
+    {
+        double result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+
+    static double set(double value) { return value; }
+    static double loadInt32(const int32_t *values) { return double(values[0]); }
+    static void store(double *destination, double value) { destination[0] = value; }
+    static void storeInt32(int32_t *destination, double value) { destination[0] = int32_t(value); }
+
+    static double add(double a, double b) { return a + b; }
+    static double sub(double a, double b) { return a - b; }
+    static double mul(double a, double b) { return a * b; }
+    static double div(double a, double b) { return a / b; }
+    // Same operand order and result as minpd/maxpd for non-NaN inputs.
+    static double min(double a, double b) { return a < b ? a : b; }
+    static double max(double a, double b) { return a > b ? a : b; }
+
+    static bool less(double a, double b) { return a < b; }
+    static bool greater(double a, double b) { return a > b; }
+    static bool greaterEqual(double a, double b) { return a >= b; }
+    static bool orMask(bool a, bool b) { return a || b; }
+    static double select(bool mask, double a, double b) { return mask ? a : b; }
+
+    static double andOr(double x, uint64_t andMask, uint64_t orMask) { return fromBits((bits(x) & andMask) | orMask); }
+    static double shiftRightOr(double x, uint64_t orMask) { return fromBits((bits(x) >> 52) | orMask); }
+    static double addShiftLeft(double x, int64_t addend) { return fromBits((bits(x) + uint64_t(addend)) << 52); }
+};
+
+// Runs the kernel over a batch: full vectors with Ops, the remainder with ScalarOps.
+template <typename Ops>
+inline void estimateBatch(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                          double *distances, double *accuracies, int32_t *proximities)
+{
+    size_t i = 0;
+    // Two independent vectors per iteration: the exp2/log2 polynomials are long dependency chains, and interleaving two
+    // of them keeps the floating point units busy.
+    for (; i + 2 * Ops::width <= count; i += 2 * Ops::width) {
+        typename Ops::Vector distance[2], accuracy[2], proximity[2];
+        estimate<Ops>(constants, Ops::loadInt32(RSSI + i), Ops::loadInt32(txPower + i), distance[0], accuracy[0], proximity[0]);
+        estimate<Ops>(constants, Ops::loadInt32(RSSI + i + Ops::width), Ops::loadInt32(txPower + i + Ops::width), distance[1],
+                      accuracy[1], proximity[1]);
+        for (size_t j = 0; j < 2; j++) {
+            size_t offset = i + j * Ops::width;
+            if (distances) {
+                Ops::store(distances + offset, distance[j]);
+            }
+            if (accuracies) {
+                Ops::store(accuracies + offset, accuracy[j]);
+            }
+            if (proximities) {
+                Ops::storeInt32(proximities + offset, proximity[j]);
+            }
+        }
+    }
+    for (; i + Ops::width <= count; i += Ops::width) {
+        typename Ops::Vector distance, accuracy, proximity;
+        estimate<Ops>(constants, Ops::loadInt32(RSSI + i), Ops::loadInt32(txPower + i), distance, accuracy, proximity);
+        if (distances) {
+            Ops::store(distances + i, distance);
+        }
+        if (accuracies) {
+            Ops::store(accuracies + i, accuracy);
+        }
+        if (proximities) {
+            Ops::storeInt32(proximities + i, proximity);
+        }
+    }
+    for (; i < count; i++) {
+        double distance, accuracy, proximity;
+        estimate<ScalarOps>(constants, ScalarOps::loadInt32(RSSI + i), ScalarOps::loadInt32(txPower + i), distance, accuracy,
+                            proximity);
+        if (distances) {
+            distances[i] = distance;
+        }
+        if (accuracies) {
+            accuracies[i] = accuracy;
+        }
+        if (proximities) {
+            proximities[i] = int32_t(proximity);
+        }
+    }
+}
+
+} // namespace
+} // namespace distance_kernel
+} // namespace bi
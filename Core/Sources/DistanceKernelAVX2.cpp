@@ -0,0 +1,92 @@
+//
+//  DistanceKernelAVX2.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Built with -mavx2 on x86 (see CMakeLists.txt). The kernel is only called after checking the CPU at runtime, so the
+// rest of the library does not depend on AVX2. FMA is deliberately not enabled: fused operations would round
+// differently from the other kernels.
+
+#include "DistanceKernel.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace bi {
+
+#if defined(__AVX2__)
+
+namespace {
+
+struct AVX2Ops {
+    typedef __m256d Vector;
+    typedef __m256d Mask;
+    static const size_t width = 4;
+
+    static __m256d set(double value) { return _mm256_set1_pd(value); }
+    static __m256d loadInt32(const int32_t *values)
+    {
+        return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(values)));
+    }
+    static void store(double *destination, __m256d value) { _mm256_storeu_pd(destination, value); }
+    static void storeInt32(int32_t *destination, __m256d value)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination), _mm256_cvttpd_epi32(value));
+    }
+
+    static __m256d add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+    static __m256d sub(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+    static __m256d mul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+    static __m256d div(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+    static __m256d min(__m256d a, __m256d b) { return _mm256_min_pd(a, b); }
+    static __m256d max(__m256d a, __m256d b) { return _mm256_max_pd(a, b); }
+
+    static __m256d less(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static __m256d greater(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static __m256d greaterEqual(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static __m256d orMask(__m256d a, __m256d b) { return _mm256_or_pd(a, b); }
+    static __m256d select(__m256d mask, __m256d a, __m256d b) { return _mm256_blendv_pd(b, a, mask); }
+
+    static __m256d andOr(__m256d x, uint64_t andMask, uint64_t orMask)
+    {
+        __m256i bits = _mm256_and_si256(_mm256_castpd_si256(x), _mm256_set1_epi64x(int64_t(andMask)));
+        return _mm256_castsi256_pd(_mm256_or_si256(bits, _mm256_set1_epi64x(int64_t(orMask))));
+    }
+    static __m256d shiftRightOr(__m256d x, uint64_t orMask)
+    {
+        __m256i bits = _mm256_srli_epi64(_mm256_castpd_si256(x), 52);
+        return _mm256_castsi256_pd(_mm256_or_si256(bits, _mm256_set1_epi64x(int64_t(orMask))));
+    }
+    static __m256d addShiftLeft(__m256d x, int64_t addend)
+    {
+        __m256i bits = _mm256_add_epi64(_mm256_castpd_si256(x), _mm256_set1_epi64x(addend));
+        return _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52));
+    }
+};
+
+} // namespace
+
+bool estimateDistancesAVX2(const DistanceKernelConstants &constants, const int32_t *RSSI, const int32_t *txPower, size_t count,
+                           double *distances, double *accuracies, int32_t *proximities)
+{
+    distance_kernel::estimateBatch<AVX2Ops>(constants, RSSI, txPower, count, distances, accuracies, proximities);
+    // GCC leaves out the vzeroupper on the path through the scalar tail once the last 256-bit register has been
+    // overwritten by 128-bit instructions, but the CPU still considers the upper halves dirty and slows down every SSE
+    // instruction of the caller until they are cleared.
+    _mm256_zeroupper();
+    return true;
+}
+
+#else
+
+bool estimateDistancesAVX2(const DistanceKernelConstants &, const int32_t *, const int32_t *, size_t, double *, double *, int32_t *)
+{
+    return false;
+}
+
+#endif
+
+} // namespace bi
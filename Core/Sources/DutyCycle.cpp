@@ -0,0 +1,297 @@
+//
+//  DutyCycle.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "DutyCycle.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace bi {
+
+DutyCycle::DutyCycle(const BIDutyCycleConfiguration &configuration, double timestamp)
+    : _configuration(configuration), _now(timestamp)
+{
+    _configuration.minimumInterval = std::max(_configuration.minimumInterval, 0.0);
+    _configuration.maximumInterval = std::max(_configuration.maximumInterval, _configuration.minimumInterval);
+    _configuration.windowDuration = std::max(_configuration.windowDuration, 0.0);
+    _configuration.rampFactor = std::max(_configuration.rampFactor, 1.0);
+    _configuration.radioBudget = std::min(std::max(_configuration.radioBudget, 0.0), 1.0);
+    _budgetCapacity = _configuration.radioBudget * std::max(_configuration.budgetPeriod, 0.0);
+    _budget = _budgetCapacity;
+    _interval = _configuration.minimumInterval;
+}
+
+void DutyCycle::account(double timestamp)
+{
+    double elapsed = timestamp - _now;
+    if (elapsed <= 0.0) {
+        return;
+    }
+    _now = timestamp;
+    if (_ranging) {
+        _statistics.rangingTime += elapsed;
+        _budget -= elapsed * (1.0 - _configuration.radioBudget);
+    } else {
+        if (paused()) {
+            _statistics.pausedTime += elapsed;
+        } else if (_budgetLimited) {
+            _statistics.budgetLimitedTime += elapsed;
+        }
+        _budget += elapsed * _configuration.radioBudget;
+    }
+    _budget = std::min(std::max(_budget, 0.0), _budgetCapacity);
+}
+
+void DutyCycle::update()
+{
+    if (paused()) {
+        _ranging = false;
+        _budgetLimited = false;
+        return;
+    }
+    // Budget comparisons allow for the rounding of the times the caller computed from nextChange.
+    const double epsilon = 1e-9;
+    if (_ranging && budgeted() && _budget <= epsilon) {
+        _ranging = false;
+        _budgetLimited = true;
+        _nextWindow = std::max(_nextWindow, _now);
+    } else if (_ranging && _now >= _windowEnd) {
+        _ranging = false;
+    }
+    if (!_ranging && _now >= _nextWindow) {
+        if (budgeted() && _budget + epsilon < windowCost()) {
+            _budgetLimited = true;
+            return;
+        }
+        // After the budget ran out, continuous ranging goes on in windows until the budget has recovered.
+        bool limited = _budgetLimited;
+        _ranging = true;
+        _budgetLimited = false;
+        _windowStart = _now;
+        _windowEnd = continuous() && !limited ? INFINITY : _now + _configuration.windowDuration;
+        _nextWindow = _now + std::max(_interval, _configuration.windowDuration);
+        _statistics.windows++;
+    }
+}
+
+BIDutyCycleState DutyCycle::state() const
+{
+    BIDutyCycleState state;
+    state.mode = paused() ? BIDutyCycleModePaused : continuous() ? BIDutyCycleModeContinuous : BIDutyCycleModeWindowed;
+    state.ranging = _ranging;
+    state.interval = _interval;
+    state.nextChange = INFINITY;
+    if (paused()) {
+        return state;
+    }
+    if (_ranging) {
+        state.nextChange = _windowEnd;
+        if (budgeted()) {
+            state.nextChange = std::min(state.nextChange, _now + _budget / (1.0 - _configuration.radioBudget));
+        }
+    } else {
+        state.nextChange = std::max(_nextWindow, _now);
+        if (budgeted() && _budget < windowCost()) {
+            double refill = _configuration.radioBudget > 0.0 ? (windowCost() - _budget) / _configuration.radioBudget : INFINITY;
+            state.nextChange = std::max(state.nextChange, _now + refill);
+        }
+    }
+    return state;
+}
+
+void DutyCycle::resume()
+{
+    _interval = _configuration.minimumInterval;
+    _stableCount = 0;
+    _nextWindow = _now;
+    _baseline.clear();
+}
+
+void DutyCycle::rampUp()
+{
+    _stableCount = 0;
+    if (_interval > _configuration.minimumInterval) {
+        _statistics.rampUps++;
+    }
+    _interval = _configuration.minimumInterval;
+    if (_ranging) {
+        if (!_budgetLimited) {
+            _windowEnd = INFINITY;
+        }
+    } else {
+        _nextWindow = _now;
+    }
+}
+
+void DutyCycle::rampDown()
+{
+    double interval = std::min(_interval * _configuration.rampFactor, _configuration.maximumInterval);
+    if (interval <= _interval) {
+        return;
+    }
+    bool wasContinuous = continuous();
+    _interval = interval;
+    _statistics.rampDowns++;
+    if (continuous()) {
+        return;
+    }
+    if (wasContinuous && _ranging) {
+        // Ranging has been on since the window started; the window ends with this tick.
+        _windowEnd = _now;
+        _nextWindow = _now + _interval - _configuration.windowDuration;
+    } else {
+        _nextWindow = _windowStart + _interval;
+    }
+}
+
+void DutyCycle::setActiveRegionCount(double timestamp, uint32_t count)
+{
+    account(timestamp);
+    bool wasPaused = paused();
+    _activeRegionCount = count;
+    if (wasPaused && !paused()) {
+        resume();
+    }
+    update();
+}
+
+void DutyCycle::setBluetoothState(double timestamp, BIBluetoothState state)
+{
+    account(timestamp);
+    bool wasPaused = paused();
+    // The state is unknown until CoreBluetooth has started up; ranging is not held back for that.
+    _bluetoothOn = (state == BIBluetoothStatePoweredOn || state == BIBluetoothStateUnknown);
+    if (wasPaused && !paused()) {
+        resume();
+    }
+    update();
+}
+
+void DutyCycle::reportRegionEvent(double timestamp, BIRegionEvent event)
+{
+    account(timestamp);
+    if ((event == BIRegionEventEnter || event == BIRegionEventStateInside) && !paused()) {
+        rampUp();
+    }
+    update();
+}
+
+void DutyCycle::reportBatch(const BIRangingBatch &batch)
+{
+    account(batch.timestamp);
+    // Beacons are compared with the signals of the last significant tick rather than the previous tick: the first ticks
+    // of a window smooth over few samples, so beacons briefly drop out of range and RSSIs jump without the device having
+    // moved. Beacons that go out of range only matter if they were the nearest one.
+    bool significant = false;
+    for (size_t r = 0; r < batch.regionCount && !significant; r++) {
+        const BIRegionRangingResult &region = batch.regions[r];
+        significant = region.nearestBeaconChanged;
+        for (size_t i = 0; i < region.beaconCount && !significant; i++) {
+            const BISignal &signal = region.beacons[i].smoothedSignal;
+            if (!signal.inRange) {
+                continue;
+            }
+            auto baseline = _baseline.find(region.beacons[i].key);
+            significant = baseline == _baseline.end() ||
+                          std::abs(signal.RSSI - baseline->second) >= _configuration.RSSIThreshold;
+        }
+    }
+
+    if (significant) {
+        // Rebuilt rather than updated, so that a beacon that left range since counts as new when it comes back, and
+        // the baseline holds no more beacons than a tick does.
+        _baseline.clear();
+        for (size_t r = 0; r < batch.regionCount; r++) {
+            const BIRegionRangingResult &region = batch.regions[r];
+            for (size_t i = 0; i < region.beaconCount; i++) {
+                if (region.beacons[i].smoothedSignal.inRange) {
+                    _baseline[region.beacons[i].key] = region.beacons[i].smoothedSignal.RSSI;
+                }
+            }
+        }
+        _statistics.significantTicks++;
+        rampUp();
+    } else {
+        _statistics.stableTicks++;
+        if (++_stableCount >= std::max<uint32_t>(_configuration.stableTicks, 1)) {
+            _stableCount = 0;
+            rampDown();
+        }
+    }
+    update();
+}
+
+BIDutyCycleState DutyCycle::advance(double timestamp)
+{
+    account(timestamp);
+    update();
+    return state();
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIDutyCycle {
+    BIDutyCycle(const BIDutyCycleConfiguration &configuration, double timestamp) : dutyCycle(configuration, timestamp) {}
+    bi::DutyCycle dutyCycle;
+};
+
+BIDutyCycleConfiguration BIDutyCycleConfigurationMakeDefault(void)
+{
+    BIDutyCycleConfiguration configuration;
+    configuration.minimumInterval = 1.0;
+    configuration.maximumInterval = 30.0;
+    configuration.windowDuration = 2.0;
+    configuration.stableTicks = 5;
+    configuration.rampFactor = 2.0;
+    configuration.RSSIThreshold = 8;
+    configuration.radioBudget = 1.0;
+    configuration.budgetPeriod = 600.0;
+    return configuration;
+}
+
+BIDutyCycleRef BIDutyCycleCreate(const BIDutyCycleConfiguration *configuration, double timestamp)
+{
+    return new BIDutyCycle(configuration ? *configuration : BIDutyCycleConfigurationMakeDefault(), timestamp);
+}
+
+void BIDutyCycleDestroy(BIDutyCycleRef dutyCycle)
+{
+    delete dutyCycle;
+}
+
+void BIDutyCycleSetActiveRegionCount(BIDutyCycleRef dutyCycle, double timestamp, uint32_t count)
+{
+    dutyCycle->dutyCycle.setActiveRegionCount(timestamp, count);
+}
+
+void BIDutyCycleSetBluetoothState(BIDutyCycleRef dutyCycle, double timestamp, BIBluetoothState state)
+{
+    dutyCycle->dutyCycle.setBluetoothState(timestamp, state);
+}
+
+void BIDutyCycleReportRegionEvent(BIDutyCycleRef dutyCycle, double timestamp, BIRegionEvent event)
+{
+    dutyCycle->dutyCycle.reportRegionEvent(timestamp, event);
+}
+
+void BIDutyCycleReportBatch(BIDutyCycleRef dutyCycle, const BIRangingBatch *batch)
+{
+    dutyCycle->dutyCycle.reportBatch(*batch);
+}
+
+BIDutyCycleState BIDutyCycleAdvance(BIDutyCycleRef dutyCycle, double timestamp)
+{
+    return dutyCycle->dutyCycle.advance(timestamp);
+}
+
+BIDutyCycleStatistics BIDutyCycleGetStatistics(BIDutyCycleRef dutyCycle)
+{
+    return dutyCycle->dutyCycle.statistics();
+}
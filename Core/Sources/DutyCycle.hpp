@@ -0,0 +1,67 @@
+//
+//  DutyCycle.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIDutyCycle.h>
+
+#include "BeaconKey.hpp"
+
+#include <unordered_map>
+
+namespace bi {
+
+// Ranging alternates between windows and gaps: a window starts at _nextWindow (if the budget can pay for it) and ends at
+// _windowEnd, which is infinite in continuous mode. Time only moves in account(), which books the time since the last
+// call against the current decision; update() then takes the decisions that are due at the new time.
+class DutyCycle {
+public:
+    DutyCycle(const BIDutyCycleConfiguration &configuration, double timestamp);
+
+    void setActiveRegionCount(double timestamp, uint32_t count);
+    void setBluetoothState(double timestamp, BIBluetoothState state);
+    void reportRegionEvent(double timestamp, BIRegionEvent event);
+    void reportBatch(const BIRangingBatch &batch);
+    BIDutyCycleState advance(double timestamp);
+
+    BIDutyCycleState state() const;
+    const BIDutyCycleStatistics &statistics() const { return _statistics; }
+
+private:
+    bool paused() const { return _activeRegionCount == 0 || !_bluetoothOn; }
+    bool continuous() const { return _interval <= _configuration.windowDuration; }
+    bool budgeted() const { return _configuration.radioBudget < 1.0; }
+    // Net budget a whole window costs.
+    double windowCost() const { return _configuration.windowDuration * (1.0 - _configuration.radioBudget); }
+
+    void account(double timestamp);
+    void update();
+    void resume();
+    void rampUp();
+    void rampDown();
+
+    BIDutyCycleConfiguration _configuration;
+    double _now;
+    double _budget;
+    double _budgetCapacity;
+
+    uint32_t _activeRegionCount = 0;
+    bool _bluetoothOn = true;
+    bool _ranging = false;
+    bool _budgetLimited = false;
+    double _interval;
+    double _windowStart = 0.0;
+    double _windowEnd = 0.0;
+    double _nextWindow = 0.0;
+    uint32_t _stableCount = 0;
+
+    // Smoothed RSSI of every beacon in range at the last significant tick.
+    std::unordered_map<BIBeaconKey, int32_t, BeaconKeyHash> _baseline;
+    BIDutyCycleStatistics _statistics = {};
+};
+
+} // namespace bi
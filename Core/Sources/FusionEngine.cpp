@@ -0,0 +1,378 @@
+//
+//  FusionEngine.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "FusionEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bi {
+
+FusionEngine::FusionEngine(const BIFusionEngineConfiguration &configuration, const BIFusionReceiver *receivers,
+                           size_t receiverCount, const BIFusionBeacon *beacons, size_t beaconCount)
+    : _configuration(configuration), _receivers(receivers, receivers + receiverCount)
+{
+    _configuration.maximumIterations = std::max<uint32_t>(_configuration.maximumIterations, 1);
+    _configuration.minimumRangeError = std::max(_configuration.minimumRangeError, 1e-3);
+    uint32_t capacity = 2;
+    while (capacity < _configuration.ringCapacity && capacity < (uint32_t(1) << 31)) {
+        capacity <<= 1;
+    }
+    _configuration.ringCapacity = capacity;
+    for (size_t i = 0; i < receiverCount; i++) {
+        _rings.emplace_back(new Ring(capacity));
+    }
+    _receiverSums.assign(receiverCount, 0.0);
+    _receiverCounts.assign(receiverCount, 0);
+    for (size_t i = 0; i < beaconCount; i++) {
+        Beacon &beacon = _beacons[intern(beacons[i].key)];
+        beacon.txPower = beacons[i].txPower;
+        beacon.configured = true;
+    }
+}
+
+// MARK: - Ingest
+
+size_t FusionEngine::submit(uint32_t receiver, const BIFusionSignal *signals, size_t count)
+{
+    if (receiver >= _rings.size()) {
+        _unknownReceiverSignals.fetch_add(count, std::memory_order_relaxed);
+        return count;
+    }
+    Ring &ring = *_rings[receiver];
+    uint64_t capacity = ring.mask + 1;
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    uint64_t ignored = 0;
+    size_t taken = 0;
+    for (; taken < count; taken++) {
+        const BIFusionSignal &signal = signals[taken];
+        if (!signal.signal.inRange || signal.signal.RSSI >= 0) {
+            ignored++;
+            continue;
+        }
+        if (head - ring.cachedTail == capacity) {
+            ring.cachedTail = ring.tail.load(std::memory_order_acquire);
+            if (head - ring.cachedTail == capacity) {
+                break;
+            }
+        }
+        Entry &entry = ring.entries[head & ring.mask];
+        entry.timestamp = signal.signal.timestamp;
+        entry.key = signal.key;
+        entry.RSSI = signal.signal.RSSI;
+        head++;
+    }
+    ring.head.store(head, std::memory_order_release);
+
+    ring.accepted.fetch_add(taken - ignored, std::memory_order_relaxed);
+    if (ignored > 0) {
+        ring.ignored.fetch_add(ignored, std::memory_order_relaxed);
+    }
+    if (taken < count) {
+        ring.dropped.fetch_add(count - taken, std::memory_order_relaxed);
+    }
+    return taken;
+}
+
+uint32_t FusionEngine::intern(const BIBeaconKey &key)
+{
+    auto inserted = _beaconIndexes.emplace(key, uint32_t(_beacons.size()));
+    if (!inserted.second) {
+        return inserted.first->second;
+    }
+    if (_freeBeacons.empty()) {
+        _beacons.push_back({key, _configuration.txPower, 0, false});
+        _beaconEnds.push_back(0);
+        return inserted.first->second;
+    }
+    uint32_t index = _freeBeacons.back();
+    _freeBeacons.pop_back();
+    _beacons[index] = {key, _configuration.txPower, 0, false};
+    inserted.first->second = index;
+    return index;
+}
+
+// A beacon that was not passed to the constructor is forgotten once its last sample has left the window, and its
+// index is reused.
+void FusionEngine::release(uint32_t beacon)
+{
+    Beacon &released = _beacons[beacon];
+    if (--released.samples == 0 && !released.configured) {
+        _beaconIndexes.erase(released.key);
+        _freeBeacons.push_back(beacon);
+    }
+}
+
+void FusionEngine::drain(uint32_t receiver, double windowStart)
+{
+    Ring &ring = *_rings[receiver];
+    const BIFusionReceiver &calibration = _receivers[receiver];
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+        const Entry &entry = ring.entries[tail & ring.mask];
+        double timestamp = entry.timestamp + calibration.clockOffset;
+        if (!(timestamp > windowStart)) {
+            _lateSignals++;
+            continue;
+        }
+        uint32_t beacon = intern(entry.key);
+        _beacons[beacon].samples++;
+        _samples.push_back({timestamp, double(entry.RSSI) + calibration.RSSIOffset, beacon, receiver});
+    }
+    ring.tail.store(tail, std::memory_order_release);
+}
+
+void FusionEngine::setCalibration(uint32_t receiver, double RSSIOffset, double clockOffset)
+{
+    if (receiver < _receivers.size()) {
+        _receivers[receiver].RSSIOffset = RSSIOffset;
+        _receivers[receiver].clockOffset = clockOffset;
+    }
+}
+
+// MARK: - Fusion
+
+BIFusionResult FusionEngine::fuse(double timestamp)
+{
+    _ticks++;
+    double windowStart = timestamp - _configuration.window;
+    for (uint32_t receiver = 0; receiver < _rings.size(); receiver++) {
+        drain(receiver, windowStart);
+    }
+    size_t kept = 0;
+    for (const Sample &sample : _samples) {
+        if (sample.timestamp > windowStart) {
+            _samples[kept++] = sample;
+        } else {
+            release(sample.beacon);
+        }
+    }
+    _samples.resize(kept);
+
+    // Counting sort of the samples up to the tick by beacon, over the beacons that have such samples only (in the order
+    // of their index). _beaconEnds holds the starts until the samples are placed, and is all zeros between ticks.
+    for (const Sample &sample : _samples) {
+        if (sample.timestamp <= timestamp && _beaconEnds[sample.beacon]++ == 0) {
+            _activeBeacons.push_back(sample.beacon);
+        }
+    }
+    std::sort(_activeBeacons.begin(), _activeBeacons.end());
+    uint32_t offset = 0;
+    for (uint32_t beacon : _activeBeacons) {
+        uint32_t count = _beaconEnds[beacon];
+        _beaconEnds[beacon] = offset;
+        offset += count;
+    }
+    _order.resize(offset);
+    for (uint32_t i = 0; i < _samples.size(); i++) {
+        if (_samples[i].timestamp <= timestamp) {
+            _order[_beaconEnds[_samples[i].beacon]++] = i;
+        }
+    }
+
+    // Per beacon, the mean calibrated RSSI of each receiver; the fused RSSI is the mean over the receivers, so that a
+    // receiver that reports more often does not outweigh the others. Receivers are visited in the order of their index,
+    // which keeps the sums independent of the order in which the rings were drained.
+    _fused.clear();
+    _links.clear();
+    _linkEnds.clear();
+    _RSSIs.clear();
+    _txPowers.clear();
+    uint32_t begin = 0;
+    for (uint32_t beacon : _activeBeacons) {
+        uint32_t end = _beaconEnds[beacon];
+        _beaconEnds[beacon] = 0;
+        for (uint32_t i = begin; i < end; i++) {
+            const Sample &sample = _samples[_order[i]];
+            if (_receiverCounts[sample.receiver]++ == 0) {
+                _touchedReceivers.push_back(sample.receiver);
+            }
+            _receiverSums[sample.receiver] += sample.RSSI;
+        }
+        std::sort(_touchedReceivers.begin(), _touchedReceivers.end());
+
+        BIFusedBeacon fused = {};
+        fused.key = _beacons[beacon].key;
+        fused.signalCount = end - begin;
+        fused.receiverCount = uint32_t(_touchedReceivers.size());
+        fused.nearestRSSI = -INFINITY;
+        double sum = 0.0;
+        for (uint32_t receiver : _touchedReceivers) {
+            double mean = _receiverSums[receiver] / double(_receiverCounts[receiver]);
+            _links.push_back({receiver, mean});
+            sum += mean;
+            if (mean > fused.nearestRSSI) {
+                fused.nearestRSSI = mean;
+                fused.nearestReceiver = receiver;
+            }
+            _receiverSums[receiver] = 0.0;
+            _receiverCounts[receiver] = 0;
+        }
+        _touchedReceivers.clear();
+        fused.meanRSSI = sum / double(fused.receiverCount);
+        _linkEnds.push_back(uint32_t(_links.size()));
+        _fused.push_back(fused);
+        _RSSIs.push_back(int32_t(std::lround(fused.meanRSSI)));
+        _txPowers.push_back(_beacons[beacon].txPower);
+        begin = end;
+    }
+    _activeBeacons.clear();
+
+    size_t count = _fused.size();
+    _accuracies.resize(count);
+    _proximities.resize(count);
+    BIEstimateDistances(&_configuration.distanceModel, _RSSIs.data(), _txPowers.data(), count, nullptr,
+                        _accuracies.data(), _proximities.data());
+    for (size_t i = 0; i < count; i++) {
+        BISignal &signal = _fused[i].signal;
+        signal.timestamp = timestamp;
+        signal.RSSI = _RSSIs[i];
+        signal.proximity = _proximities[i];
+        signal.accuracy = _accuracies[i];
+        signal.inRange = true;
+    }
+
+    // Distances from every located receiver, in one batch. Links of receivers without a location get an unknown RSSI,
+    // which the estimation skips.
+    _linkRSSIs.resize(_links.size());
+    _linkTxPowers.resize(_links.size());
+    for (size_t i = 0, link = 0; i < count; i++) {
+        for (; link < _linkEnds[i]; link++) {
+            bool located = _receivers[_links[link].receiver].located;
+            _linkRSSIs[link] = located ? int32_t(std::lround(_links[link].RSSI)) : 0;
+            _linkTxPowers[link] = _txPowers[i];
+        }
+    }
+    _distances.resize(_links.size());
+    BIEstimateDistances(&_configuration.distanceModel, _linkRSSIs.data(), _linkTxPowers.data(), _links.size(),
+                        _distances.data(), nullptr, nullptr);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t first = i > 0 ? _linkEnds[i - 1] : 0;
+        locate(_fused[i], _links.data() + first, _distances.data() + first, _linkEnds[i] - first);
+    }
+
+    std::stable_sort(_fused.begin(), _fused.end(),
+                     [](const BIFusedBeacon &a, const BIFusedBeacon &b) { return a.meanRSSI > b.meanRSSI; });
+    BIFusionResult result;
+    result.timestamp = timestamp;
+    result.beacons = _fused.data();
+    result.beaconCount = _fused.size();
+    return result;
+}
+
+// The beacon is on the floor of the located receiver that hears it best; receivers on other floors hear it through
+// the ceiling and are left out.
+void FusionEngine::locate(BIFusedBeacon &fused, const Link *links, const double *distances, size_t count)
+{
+    fused.position.valid = false;
+    const Link *nearest = nullptr;
+    for (size_t i = 0; i < count; i++) {
+        if (_receivers[links[i].receiver].located && (nearest == nullptr || links[i].RSSI > nearest->RSSI)) {
+            nearest = &links[i];
+        }
+    }
+    if (nearest == nullptr) {
+        return;
+    }
+    int32_t floor = _receivers[nearest->receiver].floor;
+    _observations.clear();
+    for (size_t i = 0; i < count; i++) {
+        const BIFusionReceiver &receiver = _receivers[links[i].receiver];
+        double distance = distances[i];
+        if (!receiver.located || receiver.floor != floor || !(distance > 0.0) ||
+            distance > _configuration.maximumRange) {
+            continue;
+        }
+        double error = std::max(_configuration.rangeError * distance, _configuration.minimumRangeError);
+        _observations.push_back({receiver.x, receiver.y, distance, 1.0 / (error * error), links[i].receiver, floor});
+    }
+    uint32_t iterations = 0;
+    fused.position = trilaterate(_observations.data(), _observations.size(), _configuration.maximumIterations,
+                                 _configuration.convergenceThreshold, iterations);
+    if (fused.position.valid) {
+        fused.position.floor = floor;
+    }
+}
+
+BIFusionStatistics FusionEngine::statistics() const
+{
+    BIFusionStatistics statistics = {};
+    statistics.ignoredSignals = _unknownReceiverSignals.load(std::memory_order_relaxed);
+    for (const std::unique_ptr<Ring> &ring : _rings) {
+        statistics.signals += ring->accepted.load(std::memory_order_relaxed);
+        statistics.droppedSignals += ring->dropped.load(std::memory_order_relaxed);
+        statistics.ignoredSignals += ring->ignored.load(std::memory_order_relaxed);
+    }
+    statistics.lateSignals = _lateSignals;
+    statistics.ticks = _ticks;
+    statistics.beacons = _beaconIndexes.size();
+    return statistics;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIFusionEngine {
+    BIFusionEngine(const BIFusionEngineConfiguration &configuration, const BIFusionReceiver *receivers,
+                   size_t receiverCount, const BIFusionBeacon *beacons, size_t beaconCount)
+        : engine(configuration, receivers, receiverCount, beacons, beaconCount)
+    {
+    }
+    bi::FusionEngine engine;
+};
+
+BIFusionEngineConfiguration BIFusionEngineConfigurationMakeDefault(void)
+{
+    BIPositionEngineConfiguration position = BIPositionEngineConfigurationMakeDefault();
+    BIFusionEngineConfiguration configuration;
+    configuration.window = 2.0;
+    configuration.ringCapacity = 4096;
+    configuration.distanceModel = BIDistanceModelMakeDefault();
+    configuration.txPower = -18;
+    configuration.rangeError = position.rangeError;
+    configuration.minimumRangeError = position.minimumRangeError;
+    configuration.maximumRange = position.maximumRange;
+    configuration.maximumIterations = position.maximumIterations;
+    configuration.convergenceThreshold = position.convergenceThreshold;
+    return configuration;
+}
+
+BIFusionEngineRef BIFusionEngineCreate(const BIFusionEngineConfiguration *configuration,
+                                       const BIFusionReceiver *receivers, size_t receiverCount,
+                                       const BIFusionBeacon *beacons, size_t beaconCount)
+{
+    return new BIFusionEngine(configuration ? *configuration : BIFusionEngineConfigurationMakeDefault(), receivers,
+                              receiverCount, beacons, beaconCount);
+}
+
+void BIFusionEngineDestroy(BIFusionEngineRef engine)
+{
+    delete engine;
+}
+
+size_t BIFusionEngineSubmit(BIFusionEngineRef engine, uint32_t receiver, const BIFusionSignal *signals, size_t count)
+{
+    return engine->engine.submit(receiver, signals, count);
+}
+
+BIFusionResult BIFusionEngineFuse(BIFusionEngineRef engine, double timestamp)
+{
+    return engine->engine.fuse(timestamp);
+}
+
+void BIFusionEngineSetReceiverCalibration(BIFusionEngineRef engine, uint32_t receiver, double RSSIOffset,
+                                          double clockOffset)
+{
+    engine->engine.setCalibration(receiver, RSSIOffset, clockOffset);
+}
+
+BIFusionStatistics BIFusionEngineGetStatistics(BIFusionEngineRef engine)
+{
+    return engine->engine.statistics();
+}
@@ -0,0 +1,121 @@
+//
+//  FusionEngine.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIFusionEngine.h>
+
+#include "BeaconKey.hpp"
+#include "Trilateration.hpp"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Each receiver has a single-producer single-consumer ring: the producer publishes a batch with one release store of
+// its head, the fusion thread drains with one release store of the tail. Heads and tails live on their own cache lines,
+// and the producer only reloads the tail when the ring looks full, so that producers and the fusion thread do not
+// bounce cache lines per signal. Calibration, time alignment and interning happen when a ring is drained, on the fusion
+// thread. A tick groups the samples of the window by beacon with a counting sort and averages them per receiver in a
+// scratch array indexed by receiver, so that it never hashes and its cost grows with the number of samples only.
+// Beacons heard by the receivers are forgotten once their samples have left the window, so that the beacon arrays only
+// grow with the beacons heard within one window.
+class FusionEngine {
+public:
+    FusionEngine(const BIFusionEngineConfiguration &configuration, const BIFusionReceiver *receivers,
+                 size_t receiverCount, const BIFusionBeacon *beacons, size_t beaconCount);
+
+    size_t submit(uint32_t receiver, const BIFusionSignal *signals, size_t count);
+    BIFusionResult fuse(double timestamp);
+    void setCalibration(uint32_t receiver, double RSSIOffset, double clockOffset);
+    BIFusionStatistics statistics() const;
+
+private:
+    struct Entry {
+        double timestamp;
+        BIBeaconKey key;
+        int32_t RSSI;
+    };
+
+    struct Ring {
+        explicit Ring(uint32_t capacity) : entries(new Entry[capacity]), mask(capacity - 1) {}
+
+        std::unique_ptr<Entry[]> entries;
+        uint64_t mask;
+
+        // Written by the producer.
+        alignas(64) std::atomic<uint64_t> head{0};
+        uint64_t cachedTail = 0;
+        std::atomic<uint64_t> accepted{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> ignored{0};
+
+        // Written by the fusion thread.
+        alignas(64) std::atomic<uint64_t> tail{0};
+    };
+
+    struct Sample {
+        double timestamp; // aligned
+        double RSSI;      // calibrated
+        uint32_t beacon;
+        uint32_t receiver;
+    };
+
+    struct Beacon {
+        BIBeaconKey key;
+        int32_t txPower;
+        uint32_t samples; // in _samples
+        bool configured;  // passed to the constructor, and never released
+    };
+
+    struct Link {
+        uint32_t receiver;
+        double RSSI; // mean
+    };
+
+    void drain(uint32_t receiver, double windowStart);
+    uint32_t intern(const BIBeaconKey &key);
+    void release(uint32_t beacon);
+    void locate(BIFusedBeacon &fused, const Link *links, const double *distances, size_t count);
+
+    BIFusionEngineConfiguration _configuration;
+    std::vector<BIFusionReceiver> _receivers;
+    std::vector<std::unique_ptr<Ring>> _rings;
+    std::atomic<uint64_t> _unknownReceiverSignals{0};
+
+    std::unordered_map<BIBeaconKey, uint32_t, BeaconKeyHash> _beaconIndexes;
+    std::vector<Beacon> _beacons;
+    std::vector<uint32_t> _freeBeacons;
+
+    std::vector<Sample> _samples;
+    uint64_t _lateSignals = 0;
+    uint64_t _ticks = 0;
+
+    // Scratch of a tick.
+    std::vector<uint32_t> _beaconEnds;    // per beacon, one past its last sample in _order
+    std::vector<uint32_t> _activeBeacons; // beacons with samples up to the tick
+    std::vector<uint32_t> _order;      // indexes into _samples, grouped by beacon
+    std::vector<double> _receiverSums;
+    std::vector<uint32_t> _receiverCounts;
+    std::vector<uint32_t> _touchedReceivers;
+    std::vector<Link> _links;
+    std::vector<uint32_t> _linkEnds; // per fused beacon, one past its last link
+    std::vector<int32_t> _RSSIs;
+    std::vector<int32_t> _txPowers;
+    std::vector<int32_t> _linkRSSIs;
+    std::vector<int32_t> _linkTxPowers;
+    std::vector<double> _distances;
+    std::vector<double> _accuracies;
+    std::vector<int32_t> _proximities;
+    std::vector<RangeObservation> _observations;
+    std::vector<BIFusedBeacon> _fused;
+};
+
+} // namespace bi
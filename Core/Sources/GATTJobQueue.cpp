@@ -0,0 +1,550 @@
+//
+//  GATTJobQueue.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "GATTJobQueue.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bi {
+
+GATTJobQueue::GATTJobQueue(const BIGATTJobConfiguration &configuration, const BIGATTTransport &transport,
+                           BIGATTJobHandlers handlers, void *context)
+    : _metrics(unwrapMetrics(configuration.metrics))
+    , _transport(transport)
+    , _handlers(handlers)
+    , _context(context)
+    , _scheduler({configuration.maximumConnections, configuration.maximumAttempts, configuration.connectTimeout,
+                  configuration.deviceTimeout, configuration.retryDelay})
+{
+}
+
+bool GATTJobQueue::start(double timestamp, const uint32_t *deviceIDs, size_t deviceCount,
+                         const BIGATTCharacteristicPath *characteristics, size_t characteristicCount)
+{
+    if (!isFinished()) {
+        return false;
+    }
+
+    _characteristics.assign(characteristics, characteristics + characteristicCount);
+    _services.clear();
+    _characteristicIndexes.clear();
+    for (size_t i = 0; i < characteristicCount; i++) {
+        size_t service = serviceIndex(characteristics[i].service);
+        if (service == _services.size()) {
+            _services.push_back(characteristics[i].service);
+            _characteristicIndexes.emplace_back();
+        }
+        _characteristicIndexes[service].push_back(i);
+    }
+
+    _devices.assign(deviceCount, Device());
+    _scheduler.reset(deviceCount);
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        _devices[i].result.deviceID = deviceIDs[i];
+        _devices[i].result.status = BIGATTStatusPending;
+        _scheduler.setDeviceID(i, deviceIDs[i]);
+        _scheduler.enqueue(i);
+    }
+    _values.assign(deviceCount * characteristicCount, Value());
+    _chunks.clear();
+    _chunkPosition = nullptr;
+    _chunkFree = 0;
+    _statistics = BIGATTJobStatistics();
+    if (deviceCount == 0) {
+        if (_handlers.jobFinished != nullptr) {
+            _handlers.jobFinished(_context);
+        }
+        return true;
+    }
+    advance(timestamp);
+    return true;
+}
+
+void GATTJobQueue::cancel(double timestamp)
+{
+    _scheduler.cancel([this, timestamp](uint32_t index, bool active) {
+        if (active) {
+            _transport.disconnect(_devices[index].result.deviceID, _context);
+        }
+        finish(index, timestamp, BIGATTStatusCancelled);
+    });
+}
+
+void GATTJobQueue::advance(double timestamp)
+{
+    fireTimers(timestamp);
+    pump(timestamp);
+}
+
+void GATTJobQueue::fireTimers(double timestamp)
+{
+    _scheduler.advance(timestamp, [this](uint32_t index, double deadline) { expire(index, deadline); });
+}
+
+GATTJobQueue::Device *GATTJobQueue::activeDevice(uint32_t deviceID, uint32_t &index)
+{
+    if (!_scheduler.find(deviceID, index) || !_scheduler.isActive(index)) {
+        return nullptr;
+    }
+    return &_devices[index];
+}
+
+// Values are small (a few bytes to a few hundred), so most chunks hold many of them; a longer value gets a chunk of
+// its own.
+const uint8_t *GATTJobQueue::storeBytes(const uint8_t *bytes, size_t length)
+{
+    const size_t chunkSize = 4096;
+    if (_chunks.empty() || length > _chunkFree) {
+        size_t size = std::max(length, chunkSize);
+        _chunks.emplace_back(new uint8_t[size]);
+        _chunkPosition = _chunks.back().get();
+        _chunkFree = size;
+    }
+    uint8_t *destination = _chunkPosition;
+    std::memcpy(destination, bytes, length);
+    _chunkPosition += length;
+    _chunkFree -= length;
+    return destination;
+}
+
+GATTJobQueue::Value &GATTJobQueue::valueAt(uint32_t deviceIndex, size_t characteristicIndex)
+{
+    return _values[deviceIndex * _characteristics.size() + characteristicIndex];
+}
+
+size_t GATTJobQueue::serviceIndex(const BIGATTUUID &service) const
+{
+    for (size_t i = 0; i < _services.size(); i++) {
+        if (BIGATTUUIDEqual(&_services[i], &service)) {
+            return i;
+        }
+    }
+    return _services.size();
+}
+
+void GATTJobQueue::pump(double timestamp)
+{
+    _scheduler.pump(timestamp, [this](uint32_t index, double started) { startAttempt(index, started); });
+}
+
+void GATTJobQueue::startAttempt(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    if (device.result.attempts == 0) {
+        device.result.startedAt = timestamp;
+    }
+    device.result.attempts = _scheduler.attempts(index);
+    device.state = State::Connecting;
+    device.outstanding = 0;
+    _statistics.connectionAttempts++;
+    if (_metrics != nullptr) {
+        _metrics->increment(BIMetricsCounterGATTAttempts);
+    }
+    _transport.connect(device.result.deviceID, _context);
+}
+
+void GATTJobQueue::expire(uint32_t index, double timestamp)
+{
+    _statistics.timeouts++;
+    if (_metrics != nullptr) {
+        _metrics->increment(BIMetricsCounterGATTTimeouts);
+    }
+    fail(index, timestamp, BIGATTStatusTimedOut, true);
+}
+
+void GATTJobQueue::fail(uint32_t index, double timestamp, BIGATTStatus status, bool disconnect)
+{
+    Device &device = _devices[index];
+    if (disconnect) {
+        _transport.disconnect(device.result.deviceID, _context);
+    }
+    _scheduler.release(index);
+    for (size_t i = 0; i < _characteristics.size(); i++) {
+        valueAt(index, i).phase = Phase::Idle;
+    }
+    device.result.status = status;
+    if (!_scheduler.retry(index, timestamp)) {
+        finish(index, timestamp, status);
+    }
+}
+
+void GATTJobQueue::finish(uint32_t index, double timestamp, BIGATTStatus status)
+{
+    Device &device = _devices[index];
+    _scheduler.finish(index);
+    device.result.status = status;
+    device.result.finishedAt = timestamp;
+    if (_metrics != nullptr && device.result.attempts > 0) {
+        _metrics->recordSeconds(BIMetricsHistogramGATTDevice, timestamp - device.result.startedAt);
+    }
+    if (_metrics != nullptr && status != BIGATTStatusSuccess && status != BIGATTStatusCancelled) {
+        _metrics->increment(BIMetricsCounterGATTFailures);
+    }
+    if (status == BIGATTStatusSuccess) {
+        _statistics.devicesSucceeded++;
+    } else {
+        _statistics.devicesFailed++;
+        for (size_t i = 0; i < _characteristics.size(); i++) {
+            Value &value = valueAt(index, i);
+            if (value.status == BIGATTStatusPending) {
+                value.status = status;
+            }
+        }
+    }
+    if (_handlers.deviceFinished != nullptr) {
+        _handlers.deviceFinished(&device.result, _context);
+    }
+    if (_scheduler.isFinished() && _handlers.jobFinished != nullptr) {
+        _handlers.jobFinished(_context);
+    }
+}
+
+void GATTJobQueue::completeIfDone(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    if (device.outstanding > 0) {
+        return;
+    }
+    _transport.disconnect(device.result.deviceID, _context);
+    _scheduler.release(index);
+    finish(index, timestamp, BIGATTStatusSuccess);
+}
+
+void GATTJobQueue::didConnect(uint32_t deviceID, double timestamp, BIGATTStatus status)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    if (device != nullptr && device->state == State::Connecting) {
+        if (status != BIGATTStatusSuccess) {
+            fail(index, timestamp, status, false);
+        } else {
+            if (_metrics != nullptr) {
+                _metrics->recordSeconds(BIMetricsHistogramGATTConnect, timestamp - _scheduler.attemptStartedAt(index));
+            }
+            // Only the services with characteristics that are still missing.
+            device->state = State::DiscoveringServices;
+            _scheduler.connected(index);
+            _scratch.clear();
+            for (size_t service = 0; service < _services.size(); service++) {
+                for (size_t i : _characteristicIndexes[service]) {
+                    if (valueAt(index, i).status == BIGATTStatusPending) {
+                        _scratch.push_back(_services[service]);
+                        break;
+                    }
+                }
+            }
+            _transport.discoverServices(deviceID, _scratch.data(), _scratch.size(), _context);
+        }
+    }
+    pump(timestamp);
+}
+
+void GATTJobQueue::didDisconnect(uint32_t deviceID, double timestamp)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    if (device != nullptr) {
+        _statistics.disconnections++;
+        fail(index, timestamp, BIGATTStatusDisconnected, false);
+    }
+    pump(timestamp);
+}
+
+void GATTJobQueue::didDiscoverServices(uint32_t deviceID, double timestamp, BIGATTStatus status,
+                                       const BIGATTUUID *services, size_t serviceCount)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    if (device != nullptr && device->state == State::DiscoveringServices) {
+        if (status != BIGATTStatusSuccess) {
+            fail(index, timestamp, status, true);
+        } else {
+            device->state = State::Connected;
+            for (size_t service = 0; service < _services.size(); service++) {
+                bool found = std::any_of(services, services + serviceCount,
+                                         [&](const BIGATTUUID &uuid) { return BIGATTUUIDEqual(&uuid, &_services[service]); });
+                _scratch.clear();
+                for (size_t i : _characteristicIndexes[service]) {
+                    Value &value = valueAt(index, i);
+                    if (value.status != BIGATTStatusPending) {
+                        continue;
+                    }
+                    if (found) {
+                        value.phase = Phase::Discovering;
+                        _scratch.push_back(_characteristics[i].characteristic);
+                    } else {
+                        value.status = BIGATTStatusNotFound;
+                    }
+                }
+                if (!_scratch.empty()) {
+                    device->outstanding++;
+                    _transport.discoverCharacteristics(deviceID, &_services[service], _scratch.data(), _scratch.size(),
+                                                       _context);
+                }
+            }
+            completeIfDone(index, timestamp);
+        }
+    }
+    pump(timestamp);
+}
+
+void GATTJobQueue::didDiscoverCharacteristics(uint32_t deviceID, double timestamp, const BIGATTUUID &service,
+                                              BIGATTStatus status, const BIGATTUUID *characteristics,
+                                              size_t characteristicCount)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    size_t serviceIndex = this->serviceIndex(service);
+    if (device != nullptr && device->state == State::Connected && serviceIndex < _services.size()) {
+        if (status != BIGATTStatusSuccess) {
+            fail(index, timestamp, status, true);
+        } else {
+            // Reads of this service start right away, while other services are still being discovered.
+            bool requested = false;
+            for (size_t i : _characteristicIndexes[serviceIndex]) {
+                Value &value = valueAt(index, i);
+                if (value.phase != Phase::Discovering) {
+                    continue;
+                }
+                requested = true;
+                bool found = std::any_of(characteristics, characteristics + characteristicCount, [&](const BIGATTUUID &uuid) {
+                    return BIGATTUUIDEqual(&uuid, &_characteristics[i].characteristic);
+                });
+                if (found) {
+                    value.phase = Phase::Reading;
+                    device->outstanding++;
+                    _transport.readValue(deviceID, &_characteristics[i], _context);
+                } else {
+                    value.status = BIGATTStatusNotFound;
+                    value.phase = Phase::Idle;
+                }
+            }
+            if (requested) {
+                device->outstanding--;
+                completeIfDone(index, timestamp);
+            }
+        }
+    }
+    pump(timestamp);
+}
+
+void GATTJobQueue::didReadValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath &path,
+                                BIGATTStatus status, const uint8_t *bytes, size_t length)
+{
+    fireTimers(timestamp);
+    uint32_t index = 0;
+    Device *device = activeDevice(deviceID, index);
+    if (device != nullptr && device->state == State::Connected) {
+        for (size_t i = 0; i < _characteristics.size(); i++) {
+            Value &value = valueAt(index, i);
+            if (value.phase != Phase::Reading ||
+                !BIGATTUUIDEqual(&_characteristics[i].service, &path.service) ||
+                !BIGATTUUIDEqual(&_characteristics[i].characteristic, &path.characteristic)) {
+                continue;
+            }
+            value.phase = Phase::Idle;
+            value.status = (status == BIGATTStatusSuccess) ? BIGATTStatusSuccess : BIGATTStatusError;
+            if (status == BIGATTStatusSuccess) {
+                value.bytes = storeBytes(bytes, length);
+                value.length = uint32_t(length);
+                device->result.valuesRead++;
+                _statistics.valuesRead++;
+            }
+            device->outstanding--;
+            completeIfDone(index, timestamp);
+            break;
+        }
+    }
+    pump(timestamp);
+}
+
+BIGATTDeviceResult GATTJobQueue::result(size_t deviceIndex) const
+{
+    if (deviceIndex >= _devices.size()) {
+        return BIGATTDeviceResult();
+    }
+    return _devices[deviceIndex].result;
+}
+
+BIGATTStatus GATTJobQueue::value(size_t deviceIndex, size_t characteristicIndex, const uint8_t **value,
+                                 size_t *length) const
+{
+    if (deviceIndex >= _devices.size() || characteristicIndex >= _characteristics.size()) {
+        return BIGATTStatusNotFound;
+    }
+    const Value &stored = _values[deviceIndex * _characteristics.size() + characteristicIndex];
+    if (value != nullptr) {
+        *value = stored.status == BIGATTStatusSuccess ? stored.bytes : nullptr;
+    }
+    if (length != nullptr) {
+        *length = stored.status == BIGATTStatusSuccess ? stored.length : 0;
+    }
+    return stored.status;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIGATTJobQueue {
+    BIGATTJobQueue(const BIGATTJobConfiguration &configuration, const BIGATTTransport &transport,
+                   BIGATTJobHandlers handlers, void *context)
+        : queue(configuration, transport, handlers, context)
+    {
+    }
+    bi::GATTJobQueue queue;
+};
+
+BIGATTUUID BIGATTUUIDMakeShort(uint16_t shortUUID)
+{
+    // 0000xxxx-0000-1000-8000-00805F9B34FB
+    BIGATTUUID uuid = {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x80, 0x5F, 0x9B, 0x34, 0xFB}};
+    uuid.bytes[2] = uint8_t(shortUUID >> 8);
+    uuid.bytes[3] = uint8_t(shortUUID & 0xFF);
+    return uuid;
+}
+
+bool BIGATTUUIDSetString(BIGATTUUID *uuid, const char *string)
+{
+    if (uuid == nullptr || string == nullptr) {
+        return false;
+    }
+    if (std::strlen(string) == 4) {
+        uint16_t shortUUID = 0;
+        for (size_t i = 0; i < 4; i++) {
+            char c = string[i];
+            int digit = -1;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                return false;
+            }
+            shortUUID = uint16_t(shortUUID << 4 | digit);
+        }
+        *uuid = BIGATTUUIDMakeShort(shortUUID);
+        return true;
+    }
+    BIBeaconKey key;
+    if (!BIBeaconKeySetUUIDString(&key, string)) {
+        return false;
+    }
+    std::memcpy(uuid->bytes, key.proximityUUID, sizeof(uuid->bytes));
+    return true;
+}
+
+bool BIGATTUUIDEqual(const BIGATTUUID *uuid1, const BIGATTUUID *uuid2)
+{
+    return std::memcmp(uuid1->bytes, uuid2->bytes, sizeof(uuid1->bytes)) == 0;
+}
+
+BIGATTJobConfiguration BIGATTJobConfigurationMakeDefault(void)
+{
+    BIGATTJobConfiguration configuration;
+    configuration.maximumConnections = 4;
+    configuration.maximumAttempts = 3;
+    configuration.connectTimeout = 5.0;
+    configuration.deviceTimeout = 15.0;
+    configuration.retryDelay = 2.0;
+    configuration.metrics = nullptr;
+    return configuration;
+}
+
+BIGATTJobQueueRef BIGATTJobQueueCreate(const BIGATTJobConfiguration *configuration, const BIGATTTransport *transport,
+                                       BIGATTJobHandlers handlers, void *context)
+{
+    if (transport == nullptr) {
+        return nullptr;
+    }
+    return new BIGATTJobQueue(configuration ? *configuration : BIGATTJobConfigurationMakeDefault(), *transport, handlers,
+                              context);
+}
+
+void BIGATTJobQueueDestroy(BIGATTJobQueueRef queue)
+{
+    delete queue;
+}
+
+bool BIGATTJobQueueStart(BIGATTJobQueueRef queue, double timestamp, const uint32_t *deviceIDs, size_t deviceCount,
+                         const BIGATTCharacteristicPath *characteristics, size_t characteristicCount)
+{
+    return queue->queue.start(timestamp, deviceIDs, deviceCount, characteristics, characteristicCount);
+}
+
+void BIGATTJobQueueCancel(BIGATTJobQueueRef queue, double timestamp)
+{
+    queue->queue.cancel(timestamp);
+}
+
+void BIGATTJobQueueAdvance(BIGATTJobQueueRef queue, double timestamp)
+{
+    queue->queue.advance(timestamp);
+}
+
+void BIGATTJobQueueDidConnect(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp, BIGATTStatus status)
+{
+    queue->queue.didConnect(deviceID, timestamp, status);
+}
+
+void BIGATTJobQueueDidDisconnect(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp)
+{
+    queue->queue.didDisconnect(deviceID, timestamp);
+}
+
+void BIGATTJobQueueDidDiscoverServices(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp, BIGATTStatus status,
+                                       const BIGATTUUID *services, size_t serviceCount)
+{
+    queue->queue.didDiscoverServices(deviceID, timestamp, status, services, serviceCount);
+}
+
+void BIGATTJobQueueDidDiscoverCharacteristics(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp,
+                                              const BIGATTUUID *service, BIGATTStatus status,
+                                              const BIGATTUUID *characteristics, size_t characteristicCount)
+{
+    queue->queue.didDiscoverCharacteristics(deviceID, timestamp, *service, status, characteristics, characteristicCount);
+}
+
+void BIGATTJobQueueDidReadValue(BIGATTJobQueueRef queue, uint32_t deviceID, double timestamp,
+                                const BIGATTCharacteristicPath *path, BIGATTStatus status, const uint8_t *value,
+                                size_t length)
+{
+    queue->queue.didReadValue(deviceID, timestamp, *path, status, value, length);
+}
+
+bool BIGATTJobQueueIsFinished(BIGATTJobQueueRef queue)
+{
+    return queue->queue.isFinished();
+}
+
+size_t BIGATTJobQueueGetDeviceCount(BIGATTJobQueueRef queue)
+{
+    return queue->queue.deviceCount();
+}
+
+BIGATTDeviceResult BIGATTJobQueueGetDeviceResult(BIGATTJobQueueRef queue, size_t deviceIndex)
+{
+    return queue->queue.result(deviceIndex);
+}
+
+BIGATTStatus BIGATTJobQueueGetValue(BIGATTJobQueueRef queue, size_t deviceIndex, size_t characteristicIndex,
+                                    const uint8_t **value, size_t *length)
+{
+    return queue->queue.value(deviceIndex, characteristicIndex, value, length);
+}
+
+BIGATTJobStatistics BIGATTJobQueueGetStatistics(BIGATTJobQueueRef queue)
+{
+    return queue->queue.statistics();
+}
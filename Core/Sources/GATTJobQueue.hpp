@@ -0,0 +1,104 @@
+//
+//  GATTJobQueue.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIGATTJobQueue.h>
+
+#include "GATTScheduler.hpp"
+#include "Metrics.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace bi {
+
+// Connections, timeouts and retries are left to a GATTScheduler; devices are kept in the order of the job. Values are
+// stored per device and characteristic; a retry only discovers and reads what is still missing. The bytes of the values
+// are copied into chunks that are neither moved nor freed until the next job starts, so the pointers handed out stay
+// valid.
+class GATTJobQueue {
+public:
+    GATTJobQueue(const BIGATTJobConfiguration &configuration, const BIGATTTransport &transport, BIGATTJobHandlers handlers,
+                 void *context);
+
+    bool start(double timestamp, const uint32_t *deviceIDs, size_t deviceCount,
+               const BIGATTCharacteristicPath *characteristics, size_t characteristicCount);
+    void cancel(double timestamp);
+    void advance(double timestamp);
+
+    void didConnect(uint32_t deviceID, double timestamp, BIGATTStatus status);
+    void didDisconnect(uint32_t deviceID, double timestamp);
+    void didDiscoverServices(uint32_t deviceID, double timestamp, BIGATTStatus status, const BIGATTUUID *services,
+                             size_t serviceCount);
+    void didDiscoverCharacteristics(uint32_t deviceID, double timestamp, const BIGATTUUID &service, BIGATTStatus status,
+                                    const BIGATTUUID *characteristics, size_t characteristicCount);
+    void didReadValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath &path, BIGATTStatus status,
+                      const uint8_t *value, size_t length);
+
+    bool isFinished() const { return _scheduler.isFinished(); }
+    size_t deviceCount() const { return _devices.size(); }
+    BIGATTDeviceResult result(size_t deviceIndex) const;
+    BIGATTStatus value(size_t deviceIndex, size_t characteristicIndex, const uint8_t **value, size_t *length) const;
+    const BIGATTJobStatistics &statistics() const { return _statistics; }
+
+private:
+    // Of the current attempt.
+    enum class State : uint8_t {
+        Connecting,
+        DiscoveringServices,
+        Connected // discovering characteristics and reading
+    };
+
+    struct Device {
+        BIGATTDeviceResult result = {};
+        State state = State::Connecting;
+        uint32_t outstanding = 0; // characteristic discoveries and reads of the current attempt
+    };
+
+    // What the current attempt does about a value that is still pending.
+    enum class Phase : uint8_t { Idle, Discovering, Reading };
+
+    struct Value {
+        BIGATTStatus status = BIGATTStatusPending;
+        Phase phase = Phase::Idle;
+        const uint8_t *bytes = nullptr;
+        uint32_t length = 0;
+    };
+
+    // The device with an attempt in progress, or nullptr.
+    Device *activeDevice(uint32_t deviceID, uint32_t &index);
+    Value &valueAt(uint32_t deviceIndex, size_t characteristicIndex);
+    const uint8_t *storeBytes(const uint8_t *bytes, size_t length);
+    size_t serviceIndex(const BIGATTUUID &service) const;
+    void fireTimers(double timestamp);
+    void pump(double timestamp);
+    void startAttempt(uint32_t index, double timestamp);
+    void completeIfDone(uint32_t index, double timestamp);
+    void fail(uint32_t index, double timestamp, BIGATTStatus status, bool disconnect);
+    void finish(uint32_t index, double timestamp, BIGATTStatus status);
+    void expire(uint32_t index, double timestamp);
+
+    Metrics *_metrics;
+    BIGATTTransport _transport;
+    BIGATTJobHandlers _handlers;
+    void *_context;
+
+    std::vector<BIGATTCharacteristicPath> _characteristics;
+    std::vector<BIGATTUUID> _services;                       // distinct services of _characteristics
+    std::vector<std::vector<size_t>> _characteristicIndexes; // per service
+    std::vector<Device> _devices;
+    std::vector<Value> _values; // per device and characteristic
+    std::vector<std::unique_ptr<uint8_t[]>> _chunks;
+    uint8_t *_chunkPosition = nullptr; // first free byte of the last chunk
+    size_t _chunkFree = 0;
+    GATTScheduler _scheduler;
+    std::vector<BIGATTUUID> _scratch;
+    BIGATTJobStatistics _statistics = {};
+};
+
+} // namespace bi
@@ -0,0 +1,76 @@
+//
+//  GATTScheduler.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "GATTScheduler.hpp"
+
+namespace bi {
+
+GATTScheduler::GATTScheduler(const Configuration &configuration) : _configuration(configuration), _timers(0.1, 256)
+{
+    _configuration.maximumConnections = std::max<uint32_t>(_configuration.maximumConnections, 1);
+    _configuration.maximumAttempts = std::max<uint32_t>(_configuration.maximumAttempts, 1);
+}
+
+void GATTScheduler::reset(size_t deviceCount)
+{
+    _devices.assign(deviceCount, Device());
+    _indexesByID.clear();
+    _ready.clear();
+    _active = 0;
+    _unfinished = deviceCount;
+}
+
+bool GATTScheduler::find(uint32_t deviceID, uint32_t &index) const
+{
+    auto it = _indexesByID.find(deviceID);
+    if (it == _indexesByID.end()) {
+        return false;
+    }
+    index = it->second;
+    return true;
+}
+
+void GATTScheduler::startAttempt(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    device.state = State::Active;
+    device.attempts++;
+    device.attemptStartedAt = timestamp;
+    _active++;
+    _timers.schedule(index, timestamp + std::min(_configuration.connectTimeout, _configuration.deviceTimeout));
+}
+
+void GATTScheduler::connected(uint32_t index)
+{
+    _timers.schedule(index, _devices[index].attemptStartedAt + _configuration.deviceTimeout);
+}
+
+void GATTScheduler::release(uint32_t index)
+{
+    _devices[index].state = State::Released;
+    _active--;
+    _timers.cancel(index);
+}
+
+bool GATTScheduler::retry(uint32_t index, double timestamp)
+{
+    Device &device = _devices[index];
+    if (device.attempts >= _configuration.maximumAttempts) {
+        return false;
+    }
+    device.state = State::Waiting;
+    _timers.schedule(index, timestamp + _configuration.retryDelay);
+    return true;
+}
+
+void GATTScheduler::finish(uint32_t index)
+{
+    _devices[index].state = State::Finished;
+    _unfinished--;
+}
+
+} // namespace bi
@@ -0,0 +1,131 @@
+//
+//  GATTScheduler.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include "TimerWheel.hpp"
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// The connection scheduling of GATTJobQueue and BeaconProvisioner: which devices of a job are connected at a time, when
+// their attempts time out and when failed attempts are retried. The owner does everything that happens on a
+// connection; it starts attempts when pump() asks it to, ends them with release() followed by retry() or finish(), and
+// learns about attempts that run out of time from advance().
+//
+// Devices are kept in the order of the job, and a device's index doubles as its timer ID: the wheel holds the deadline
+// of the current attempt or, between attempts, the time of the retry. An attempt first gets connectTimeout (bounded by
+// deviceTimeout) to connect, then deviceTimeout from its start once connected() is called.
+class GATTScheduler {
+public:
+    struct Configuration {
+        uint32_t maximumConnections;
+        uint32_t maximumAttempts;
+        double connectTimeout;
+        double deviceTimeout;
+        double retryDelay;
+    };
+
+    explicit GATTScheduler(const Configuration &configuration);
+
+    // Starts a job of deviceCount devices, none of them queued yet.
+    void reset(size_t deviceCount);
+    void setDeviceID(uint32_t index, uint32_t deviceID) { _indexesByID[deviceID] = index; }
+    void enqueue(uint32_t index) { _ready.push_back(index); }
+
+    // Whether deviceID is in the job, and its index.
+    bool find(uint32_t deviceID, uint32_t &index) const;
+    bool isActive(uint32_t index) const { return _devices[index].state == State::Active; }
+    bool isFinished() const { return _unfinished == 0; }
+    uint32_t attempts(uint32_t index) const { return _devices[index].attempts; }
+    double attemptStartedAt(uint32_t index) const { return _devices[index].attemptStartedAt; }
+
+    // Starts attempts of queued devices while connections are free; start(index, timestamp) connects to the device.
+    template <typename Start>
+    void pump(double timestamp, Start start)
+    {
+        while (_active < _configuration.maximumConnections && !_ready.empty()) {
+            uint32_t index = _ready.front();
+            _ready.pop_front();
+            startAttempt(index, timestamp);
+            start(index, timestamp);
+        }
+    }
+
+    // Queues the devices whose retry delay has passed, and calls expire(index, deadline) for every attempt that ran
+    // out of time. expire() must end the attempt.
+    template <typename Expire>
+    void advance(double timestamp, Expire expire)
+    {
+        _timers.advance(timestamp, [this, &expire](uint32_t index, double deadline) {
+            if (_devices[index].state == State::Waiting) {
+                _devices[index].state = State::Queued;
+                _ready.push_back(index);
+            } else {
+                expire(index, deadline);
+            }
+        });
+    }
+
+    // Gives the attempt of a connected device deviceTimeout from its start.
+    void connected(uint32_t index);
+
+    // Ends the attempt of a device and frees its connection. The owner then calls retry() or finish().
+    void release(uint32_t index);
+    // Schedules another attempt after the retry delay, unless the device has no attempts left.
+    bool retry(uint32_t index, double timestamp);
+    void finish(uint32_t index);
+
+    // Unqueues all devices, and calls cancel(index, active) for every unfinished one, whose attempt (if active) has
+    // already been released. cancel() must finish the device.
+    template <typename Cancel>
+    void cancel(Cancel cancel)
+    {
+        _ready.clear();
+        for (uint32_t index = 0; index < _devices.size(); index++) {
+            State state = _devices[index].state;
+            if (state == State::Finished) {
+                continue;
+            }
+            if (state == State::Active) {
+                release(index);
+            }
+            _timers.cancel(index);
+            cancel(index, state == State::Active);
+        }
+    }
+
+private:
+    enum class State : uint8_t {
+        Queued,
+        Waiting, // for a retry
+        Active,
+        Released, // until the owner decides between retry() and finish()
+        Finished
+    };
+
+    struct Device {
+        State state = State::Queued;
+        uint32_t attempts = 0;
+        double attemptStartedAt = 0.0;
+    };
+
+    void startAttempt(uint32_t index, double timestamp);
+
+    Configuration _configuration;
+    std::vector<Device> _devices;
+    std::unordered_map<uint32_t, uint32_t> _indexesByID;
+    std::deque<uint32_t> _ready;
+    uint32_t _active = 0;
+    size_t _unfinished = 0;
+    TimerWheel _timers;
+};
+
+} // namespace bi
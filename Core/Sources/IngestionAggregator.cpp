@@ -0,0 +1,399 @@
+//
+//  IngestionAggregator.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "IngestionAggregator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace bi {
+
+bool IngestionAggregator::DeviceID::operator==(const DeviceID &other) const
+{
+    return std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+}
+
+size_t IngestionAggregator::DeviceIDHash::operator()(const DeviceID &device) const
+{
+    uint64_t high;
+    uint64_t low;
+    std::memcpy(&high, device.bytes, sizeof(high));
+    std::memcpy(&low, device.bytes + sizeof(high), sizeof(low));
+    uint64_t h = high ^ (low * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return size_t(h);
+}
+
+IngestionAggregator::IngestionAggregator(const BIIngestionConfiguration &configuration,
+                                         const BIIngestionZoneMember *members, size_t count)
+    : _configuration(configuration)
+    , _visitGap(int64_t(std::llround(configuration.visitGap * 1e3)))
+    , _deviceTimeout(int64_t(std::llround(configuration.deviceTimeout * 1e3)))
+    , _sequenceWindow((std::max<uint64_t>(configuration.sequenceWindow, 1) + 63) / 64 * 64)
+{
+    // Number the member beacons and zones in the order they appear, then group the zones by beacon.
+    std::unordered_map<uint32_t, uint32_t> zoneIndexes;
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (size_t i = 0; i < count; i++) {
+        auto beacon = _beaconIndexes.emplace(members[i].key, uint32_t(_beacons.size()));
+        if (beacon.second) {
+            _beacons.push_back(members[i].key);
+        }
+        auto zone = zoneIndexes.emplace(members[i].zoneID, uint32_t(_zoneIDs.size()));
+        if (zone.second) {
+            _zoneIDs.push_back(members[i].zoneID);
+        }
+        pairs.emplace_back(beacon.first->second, zone.first->second);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    _zoneEnds.assign(_beacons.size(), 0);
+    for (const std::pair<uint32_t, uint32_t> &pair : pairs) {
+        _zones.push_back(pair.second);
+        _zoneEnds[pair.first] = uint32_t(_zones.size());
+    }
+    for (size_t beacon = 1; beacon < _zoneEnds.size(); beacon++) {
+        _zoneEnds[beacon] = std::max(_zoneEnds[beacon], _zoneEnds[beacon - 1]);
+    }
+
+    uint32_t shardCount = configuration.threadCount;
+    if (shardCount == 0) {
+        shardCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (uint32_t i = 0; i < shardCount; i++) {
+        _shards.push_back(std::unique_ptr<Shard>(new Shard));
+        _shards.back()->zones.assign(_zoneIDs.size(), Totals{});
+    }
+}
+
+size_t IngestionAggregator::add(const BIUploadBuffer *uploads, size_t count)
+{
+    uint64_t accepted = statistics().uploads;
+    for (const std::unique_ptr<Shard> &shard : _shards) {
+        shard->work.clear();
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        Work work;
+        work.upload = i;
+        if (!UploadReader::peek(uploads[i].bytes, uploads[i].length, work.device.bytes, work.sequenceNumber)) {
+            _shards[0]->statistics.rejectedUploads++;
+            continue;
+        }
+        _shards[DeviceIDHash()(work.device) % _shards.size()]->work.push_back(work);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < _shards.size(); i++) {
+        if (!_shards[i]->work.empty()) {
+            threads.emplace_back(&IngestionAggregator::process, this, std::ref(*_shards[i]), uploads);
+        }
+    }
+    process(*_shards[0], uploads);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    return size_t(statistics().uploads - accepted);
+}
+
+void IngestionAggregator::process(Shard &shard, const BIUploadBuffer *uploads)
+{
+    std::stable_sort(shard.work.begin(), shard.work.end(), [](const Work &lhs, const Work &rhs) {
+        int order = std::memcmp(lhs.device.bytes, rhs.device.bytes, sizeof(lhs.device.bytes));
+        return order != 0 ? order < 0 : lhs.sequenceNumber < rhs.sequenceNumber;
+    });
+    for (const Work &work : shard.work) {
+        if (aggregate(shard, work, uploads[work.upload])) {
+            shard.statistics.uploads++;
+        }
+    }
+}
+
+bool IngestionAggregator::aggregate(Shard &shard, const Work &work, const BIUploadBuffer &upload)
+{
+    auto device = shard.devices.find(work.device);
+    if (device != shard.devices.end() && hasSeen(device->second, work.sequenceNumber)) {
+        shard.statistics.duplicateUploads++;
+        return false;
+    }
+
+    // Decode the whole upload before counting anything, so that a malformed upload leaves no trace.
+    if (!shard.reader.open(upload.bytes, upload.length)) {
+        shard.statistics.rejectedUploads++;
+        return false;
+    }
+    size_t sightingCount = shard.reader.info().sightingCount;
+    shard.sightings.resize(sightingCount);
+    size_t read = 0;
+    while (read < sightingCount) {
+        size_t count = shard.reader.read(&shard.sightings[read], sightingCount - read);
+        if (count == 0) {
+            break;
+        }
+        read += count;
+    }
+    if (read != sightingCount || shard.reader.error() != nullptr) {
+        shard.statistics.rejectedUploads++;
+        return false;
+    }
+
+    if (device == shard.devices.end()) {
+        device = shard.devices.emplace(work.device, Device()).first;
+        shard.statistics.devices++;
+    }
+    markSeen(device->second, work.sequenceNumber);
+    device->second.lastUpload = std::max(device->second.lastUpload, upload::milliseconds(shard.reader.info().endTime));
+    shard.statistics.sightings += sightingCount;
+
+    resolveBeacons(shard);
+    std::unordered_map<uint64_t, int64_t> &lastSightings = device->second.lastSightings;
+    shard.targets.clear();
+    shard.targetEnds.clear();
+    for (uint32_t beacon : shard.beaconIndexes) {
+        shard.targets.push_back({&lastSightings.emplace(beacon, Never).first->second, &shard.beacons[beacon]});
+        if (beacon < _zoneEnds.size()) {
+            for (uint32_t i = beacon > 0 ? _zoneEnds[beacon - 1] : 0; i < _zoneEnds[beacon]; i++) {
+                uint32_t zone = _zones[i];
+                shard.targets.push_back(
+                    {&lastSightings.emplace(zoneKeyOffset + zone, Never).first->second, &shard.zones[zone]});
+            }
+        }
+        shard.targetEnds.push_back(uint32_t(shard.targets.size()));
+    }
+
+    for (const BIUploadSighting &sighting : shard.sightings) {
+        if (_configuration.minimumRSSI != 0 &&
+            (sighting.RSSI == 0 || sighting.RSSI < _configuration.minimumRSSI)) {
+            continue;
+        }
+        int64_t time = upload::milliseconds(sighting.timestamp);
+        uint32_t first = sighting.beacon > 0 ? shard.targetEnds[sighting.beacon - 1] : 0;
+        for (uint32_t i = first; i < shard.targetEnds[sighting.beacon]; i++) {
+            visit(shard.targets[i], time);
+        }
+    }
+    return true;
+}
+
+// Maps the beacons of the upload in the shard's reader to global indexes, and makes room for their totals.
+void IngestionAggregator::resolveBeacons(Shard &shard)
+{
+    const std::vector<BIBeaconKey> &beacons = shard.reader.beacons();
+    shard.beaconIndexes.resize(beacons.size());
+    size_t beaconCount;
+    {
+        std::lock_guard<std::mutex> lock(_beaconsMutex);
+        for (size_t i = 0; i < beacons.size(); i++) {
+            auto inserted = _beaconIndexes.emplace(beacons[i], uint32_t(_beacons.size()));
+            if (inserted.second) {
+                _beacons.push_back(beacons[i]);
+            }
+            shard.beaconIndexes[i] = inserted.first->second;
+        }
+        beaconCount = _beacons.size();
+    }
+    if (shard.beacons.size() < beaconCount) {
+        shard.beacons.resize(beaconCount, Totals{});
+    }
+}
+
+void IngestionAggregator::visit(const Target &target, int64_t time) const
+{
+    Totals &totals = *target.totals;
+    int64_t &lastSighting = *target.lastSighting;
+    totals.sightings++;
+    if (lastSighting == Never) {
+        totals.devices++;
+        totals.visits++;
+    } else if (time < lastSighting) {
+        return;
+    } else if (time - lastSighting > _visitGap) {
+        totals.visits++;
+    } else {
+        totals.dwellTime += uint64_t(time - lastSighting);
+    }
+    lastSighting = time;
+}
+
+bool IngestionAggregator::hasSeen(const Device &device, uint64_t sequenceNumber) const
+{
+    if (device.seenSequenceNumbers.empty() || sequenceNumber >= device.nextSequenceNumber) {
+        return false;
+    }
+    if (device.nextSequenceNumber - sequenceNumber > _sequenceWindow) {
+        return true;
+    }
+    uint64_t bit = sequenceNumber % _sequenceWindow;
+    return (device.seenSequenceNumbers[bit / 64] >> (bit % 64)) & 1;
+}
+
+// Only called for sequence numbers hasSeen() returned false for.
+void IngestionAggregator::markSeen(Device &device, uint64_t sequenceNumber) const
+{
+    std::vector<uint64_t> &seen = device.seenSequenceNumbers;
+    if (seen.empty()) {
+        seen.assign(size_t(_sequenceWindow / 64), 0);
+    }
+    if (sequenceNumber >= device.nextSequenceNumber) {
+        // Numbers that leave the window share their bits with the new numbers up to sequenceNumber, none of which
+        // has been seen.
+        if (sequenceNumber - device.nextSequenceNumber >= _sequenceWindow) {
+            std::fill(seen.begin(), seen.end(), 0);
+        } else {
+            for (uint64_t number = device.nextSequenceNumber; number < sequenceNumber; number++) {
+                uint64_t bit = number % _sequenceWindow;
+                seen[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+            }
+        }
+        device.nextSequenceNumber = sequenceNumber + 1;
+    }
+    uint64_t bit = sequenceNumber % _sequenceWindow;
+    seen[bit / 64] |= uint64_t(1) << (bit % 64);
+}
+
+size_t IngestionAggregator::expireDevices(double now)
+{
+    int64_t limit = upload::milliseconds(now) - _deviceTimeout;
+    size_t expired = 0;
+    for (const std::unique_ptr<Shard> &shard : _shards) {
+        for (auto device = shard->devices.begin(); device != shard->devices.end();) {
+            if (device->second.lastUpload < limit) {
+                device = shard->devices.erase(device);
+                shard->statistics.expiredDevices++;
+                expired++;
+            } else {
+                ++device;
+            }
+        }
+    }
+    return expired;
+}
+
+size_t IngestionAggregator::copyBeacons(BIIngestionBeaconStatistics *beacons, size_t capacity) const
+{
+    std::vector<uint32_t> order(_beacons.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [this](uint32_t lhs, uint32_t rhs) { return beaconKeyLess(_beacons[lhs], _beacons[rhs]); });
+    for (size_t i = 0; i < std::min(capacity, order.size()); i++) {
+        Totals sum = {};
+        for (const std::unique_ptr<Shard> &shard : _shards) {
+            if (order[i] < shard->beacons.size()) {
+                const Totals &totals = shard->beacons[order[i]];
+                sum.sightings += totals.sightings;
+                sum.visits += totals.visits;
+                sum.devices += totals.devices;
+                sum.dwellTime += totals.dwellTime;
+            }
+        }
+        beacons[i].key = _beacons[order[i]];
+        beacons[i].totals = {sum.sightings, sum.visits, sum.devices, double(sum.dwellTime) / 1e3};
+    }
+    return order.size();
+}
+
+size_t IngestionAggregator::copyZones(BIIngestionZoneStatistics *zones, size_t capacity) const
+{
+    for (size_t i = 0; i < std::min(capacity, _zoneIDs.size()); i++) {
+        Totals sum = {};
+        for (const std::unique_ptr<Shard> &shard : _shards) {
+            const Totals &totals = shard->zones[i];
+            sum.sightings += totals.sightings;
+            sum.visits += totals.visits;
+            sum.devices += totals.devices;
+            sum.dwellTime += totals.dwellTime;
+        }
+        zones[i].zoneID = _zoneIDs[i];
+        zones[i].totals = {sum.sightings, sum.visits, sum.devices, double(sum.dwellTime) / 1e3};
+    }
+    return _zoneIDs.size();
+}
+
+BIIngestionStatistics IngestionAggregator::statistics() const
+{
+    BIIngestionStatistics sum = {};
+    for (const std::unique_ptr<Shard> &shard : _shards) {
+        sum.uploads += shard->statistics.uploads;
+        sum.rejectedUploads += shard->statistics.rejectedUploads;
+        sum.duplicateUploads += shard->statistics.duplicateUploads;
+        sum.sightings += shard->statistics.sightings;
+        sum.devices += shard->statistics.devices;
+        sum.expiredDevices += shard->statistics.expiredDevices;
+    }
+    return sum;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIIngestionAggregator {
+    BIIngestionAggregator(const BIIngestionConfiguration &configuration, const BIIngestionZoneMember *members,
+                          size_t count)
+        : aggregator(configuration, members, count)
+    {
+    }
+    bi::IngestionAggregator aggregator;
+};
+
+BIIngestionConfiguration BIIngestionConfigurationMakeDefault(void)
+{
+    BIIngestionConfiguration configuration;
+    configuration.threadCount = 0;
+    configuration.visitGap = 60.0;
+    configuration.minimumRSSI = 0;
+    configuration.sequenceWindow = 4096;
+    configuration.deviceTimeout = 7.0 * 24.0 * 60.0 * 60.0;
+    return configuration;
+}
+
+BIIngestionAggregatorRef BIIngestionAggregatorCreate(const BIIngestionConfiguration *configuration,
+                                                     const BIIngestionZoneMember *zones, size_t zoneMemberCount)
+{
+    return new BIIngestionAggregator(configuration ? *configuration : BIIngestionConfigurationMakeDefault(), zones,
+                                     zoneMemberCount);
+}
+
+void BIIngestionAggregatorDestroy(BIIngestionAggregatorRef aggregator)
+{
+    delete aggregator;
+}
+
+size_t BIIngestionAggregatorAddUploads(BIIngestionAggregatorRef aggregator, const BIUploadBuffer *uploads,
+                                       size_t count)
+{
+    return aggregator->aggregator.add(uploads, count);
+}
+
+size_t BIIngestionAggregatorCopyBeacons(BIIngestionAggregatorRef aggregator, BIIngestionBeaconStatistics *beacons,
+                                        size_t capacity)
+{
+    return aggregator->aggregator.copyBeacons(beacons, capacity);
+}
+
+size_t BIIngestionAggregatorCopyZones(BIIngestionAggregatorRef aggregator, BIIngestionZoneStatistics *zones,
+                                      size_t capacity)
+{
+    return aggregator->aggregator.copyZones(zones, capacity);
+}
+
+size_t BIIngestionAggregatorExpireDevices(BIIngestionAggregatorRef aggregator, double now)
+{
+    return aggregator->aggregator.expireDevices(now);
+}
+
+BIIngestionStatistics BIIngestionAggregatorGetStatistics(BIIngestionAggregatorRef aggregator)
+{
+    return aggregator->aggregator.statistics();
+}
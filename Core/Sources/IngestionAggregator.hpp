@@ -0,0 +1,118 @@
+//
+//  IngestionAggregator.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIIngestion.h>
+
+#include "BeaconKey.hpp"
+#include "UploadReader.hpp"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Beacons are numbered globally (the zone members first) under a mutex, once per upload; everything per sighting is
+// private to the shard that owns the device. Before an upload is aggregated, each of its beacons is resolved to the
+// counters it feeds (its own and those of its zones), each paired with the device's last sighting of it, so that a
+// sighting costs no lookups. Times and dwell times are kept in whole milliseconds, the resolution of the uploads, so
+// that the totals do not depend on how the devices are spread over the shards.
+//
+// The sequence numbers a device has used are kept as the highest one plus a bitmap of the sequenceWindow numbers up to
+// it, indexed by sequence number modulo the window, so that a device takes the same memory however long it uploads.
+class IngestionAggregator {
+public:
+    IngestionAggregator(const BIIngestionConfiguration &configuration, const BIIngestionZoneMember *members,
+                        size_t count);
+
+    size_t add(const BIUploadBuffer *uploads, size_t count);
+    size_t copyBeacons(BIIngestionBeaconStatistics *beacons, size_t capacity) const;
+    size_t copyZones(BIIngestionZoneStatistics *zones, size_t capacity) const;
+    size_t expireDevices(double now);
+    BIIngestionStatistics statistics() const;
+
+private:
+    static constexpr int64_t Never = INT64_MIN;
+
+    struct DeviceID {
+        uint8_t bytes[upload::deviceIDSize];
+
+        bool operator==(const DeviceID &other) const;
+    };
+
+    struct DeviceIDHash {
+        size_t operator()(const DeviceID &device) const;
+    };
+
+    struct Totals {
+        uint64_t sightings;
+        uint64_t visits;
+        uint64_t devices;
+        uint64_t dwellTime; // in milliseconds
+    };
+
+    struct Device {
+        uint64_t nextSequenceNumber = 0;           // one past the highest sequence number seen
+        std::vector<uint64_t> seenSequenceNumbers; // _sequenceWindow bits
+        int64_t lastUpload = Never;                // end of the newest upload, in milliseconds
+        std::unordered_map<uint64_t, int64_t> lastSightings; // by beacon index, or zone index + zoneKeyOffset
+    };
+
+    struct Target {
+        int64_t *lastSighting;
+        Totals *totals;
+    };
+
+    struct Work {
+        uint32_t upload;
+        DeviceID device;
+        uint64_t sequenceNumber;
+    };
+
+    struct Shard {
+        std::unordered_map<DeviceID, Device, DeviceIDHash> devices;
+        std::vector<Totals> beacons;
+        std::vector<Totals> zones;
+        BIIngestionStatistics statistics = {};
+
+        std::vector<Work> work;
+        UploadReader reader;
+        std::vector<BIUploadSighting> sightings;
+        std::vector<uint32_t> beaconIndexes;
+        std::vector<uint32_t> targetEnds; // per beacon of the upload, one past its last target
+        std::vector<Target> targets;
+    };
+
+    static const uint64_t zoneKeyOffset = uint64_t(1) << 32;
+
+    void process(Shard &shard, const BIUploadBuffer *uploads);
+    bool aggregate(Shard &shard, const Work &work, const BIUploadBuffer &upload);
+    void resolveBeacons(Shard &shard);
+    void visit(const Target &target, int64_t time) const;
+    bool hasSeen(const Device &device, uint64_t sequenceNumber) const;
+    void markSeen(Device &device, uint64_t sequenceNumber) const;
+
+    BIIngestionConfiguration _configuration;
+    int64_t _visitGap;      // in milliseconds
+    int64_t _deviceTimeout; // in milliseconds
+    uint64_t _sequenceWindow;
+
+    std::vector<uint32_t> _zoneIDs;
+    std::vector<uint32_t> _zoneEnds; // per beacon in a zone, one past its last entry in _zones
+    std::vector<uint32_t> _zones;    // zone indexes
+
+    std::mutex _beaconsMutex;
+    std::unordered_map<BIBeaconKey, uint32_t, BeaconKeyHash> _beaconIndexes;
+    std::vector<BIBeaconKey> _beacons;
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+} // namespace bi
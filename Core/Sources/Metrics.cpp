@@ -0,0 +1,541 @@
+//
+//  Metrics.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "Metrics.hpp"
+
+#include "TraceFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace bi {
+
+namespace {
+
+const uint8_t magic[4] = {'B', 'I', 'M', 1};
+
+const char *const histogramNames[BIMetricsHistogramCount] = {
+    "queueing", "smoothing", "nearestBeacon", "dispatch", "handler", "endToEnd", "beaconsPerTick", "GATTConnect",
+    "GATTDevice", "batchAssembly",
+};
+
+const char *const counterNames[BIMetricsCounterCount] = {
+    "ticks",        "samples",      "lateTicks",    "droppedBatches", "regionEvents", "regionTransitions",
+    "GATTAttempts", "GATTTimeouts", "GATTFailures",
+};
+
+int leadingZeros(uint64_t value)
+{
+#if defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    int zeros = 0;
+    for (uint64_t bit = uint64_t(1) << 63; (value & bit) == 0; bit >>= 1) {
+        zeros++;
+    }
+    return zeros;
+#endif
+}
+
+// The JSON dump is written by hand rather than with snprintf(), which would make it the most expensive part of a tick
+// that dumps, and into a buffer sized for the longest possible dump, so that appending does not check the capacity.
+const size_t maximumJSONCounterLength = 64;
+const size_t maximumJSONHistogramLength = 320;
+const size_t maximumJSONLength =
+    32 + maximumJSONCounterLength * BIMetricsCounterCount + maximumJSONHistogramLength * BIMetricsHistogramCount;
+
+struct JSONWriter {
+    char *cursor;
+
+    void appendString(const char *string)
+    {
+        size_t length = std::strlen(string);
+        std::memcpy(cursor, string, length);
+        cursor += length;
+    }
+
+    void appendUnsigned(uint64_t value)
+    {
+        char digits[20];
+        char *first = digits + sizeof(digits);
+        do {
+            *--first = char('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        size_t length = size_t(digits + sizeof(digits) - first);
+        std::memcpy(cursor, first, length);
+        cursor += length;
+    }
+
+    void appendField(const char *name, uint64_t value)
+    {
+        appendString(name);
+        appendUnsigned(value);
+    }
+};
+
+bool readVarint(const uint8_t *&position, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (position == end) {
+            return false;
+        }
+        uint8_t byte = *position++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// MARK: - Histogram
+
+uint32_t Histogram::bucketIndex(uint64_t value)
+{
+    if (value < 2 * subBucketCount) {
+        return uint32_t(value);
+    }
+    uint32_t shift = uint32_t(63 - leadingZeros(value)) - subBucketBits;
+    return shift * subBucketCount + uint32_t(value >> shift);
+}
+
+uint64_t Histogram::bucketLowerBound(uint32_t index)
+{
+    if (index < 2 * subBucketCount) {
+        return index;
+    }
+    uint32_t shift = index / subBucketCount - 1;
+    return uint64_t(index - shift * subBucketCount) << shift;
+}
+
+uint64_t Histogram::bucketUpperBound(uint32_t index)
+{
+    if (index < 2 * subBucketCount) {
+        return index;
+    }
+    uint32_t shift = index / subBucketCount - 1;
+    return bucketLowerBound(index) + (uint64_t(1) << shift) - 1;
+}
+
+void Histogram::record(const uint64_t *values, size_t count)
+{
+    // Latencies of one stage mostly fall into a few buckets, so the values are sorted by bucket in chunks and every run
+    // of equal buckets takes a single atomic add.
+    const size_t chunkSize = 32;
+    uint32_t indexes[chunkSize];
+    uint64_t sum = 0;
+    uint64_t minimum = UINT64_MAX;
+    uint64_t maximum = 0;
+    for (size_t first = 0; first < count; first += chunkSize) {
+        size_t length = std::min(count - first, chunkSize);
+        for (size_t i = 0; i < length; i++) {
+            uint64_t value = values[first + i] < maximumValue ? values[first + i] : maximumValue;
+            indexes[i] = bucketIndex(value);
+            sum += value;
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }
+        std::sort(indexes, indexes + length);
+        for (size_t i = 0; i < length;) {
+            size_t end = i + 1;
+            while (end < length && indexes[end] == indexes[i]) {
+                end++;
+            }
+            add(indexes[i], end - i);
+            i = end;
+        }
+    }
+    if (count > 0) {
+        addSummary(sum, minimum, maximum);
+    }
+}
+
+void Histogram::reset()
+{
+    for (auto &bucket : _buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    _sum.store(0, std::memory_order_relaxed);
+    _minimum.store(UINT64_MAX, std::memory_order_relaxed);
+    _maximum.store(0, std::memory_order_relaxed);
+}
+
+void Histogram::addSummary(uint64_t sum, uint64_t minimum, uint64_t maximum)
+{
+    _sum.fetch_add(sum, std::memory_order_relaxed);
+    uint64_t current = _minimum.load(std::memory_order_relaxed);
+    while (minimum < current && !_minimum.compare_exchange_weak(current, minimum, std::memory_order_relaxed)) {
+    }
+    current = _maximum.load(std::memory_order_relaxed);
+    while (maximum > current && !_maximum.compare_exchange_weak(current, maximum, std::memory_order_relaxed)) {
+    }
+}
+
+void Histogram::valuesAtPercentiles(const double *percentiles, uint64_t *values, size_t count, uint64_t &total) const
+{
+    // Only the buckets between the minimum and the maximum can be non-empty, which spares most of the scan.
+    uint64_t minimum = this->minimum();
+    uint64_t maximum = this->maximum();
+    uint32_t first = minimum <= maximum ? bucketIndex(minimum) : 0;
+    uint32_t last = minimum <= maximum ? bucketIndex(maximum) : 0;
+    total = 0;
+    for (uint32_t index = first; index <= last; index++) {
+        total += this->count(index);
+    }
+    std::fill(values, values + count, 0);
+    if (total == 0) {
+        return;
+    }
+
+    // The smallest value that at least percentile percent of the values do not exceed. Percentiles are ascending, and
+    // buckets may receive values during the scan, so the remaining percentiles fall back to the maximum.
+    auto rankOf = [&](size_t next) {
+        double fraction = std::min(std::max(percentiles[next], 0.0), 100.0) / 100.0;
+        return std::max<uint64_t>(uint64_t(std::ceil(fraction * double(total))), 1);
+    };
+    size_t next = 0;
+    uint64_t rank = rankOf(0);
+    uint64_t seen = 0;
+    for (uint32_t index = first; index <= last && next < count; index++) {
+        seen += this->count(index);
+        while (seen >= rank) {
+            values[next++] = std::min(std::max(bucketUpperBound(index), minimum), maximum);
+            if (next == count) {
+                break;
+            }
+            rank = rankOf(next);
+        }
+    }
+    std::fill(values + next, values + count, maximum);
+}
+
+uint64_t Histogram::valueAtPercentile(double percentile) const
+{
+    uint64_t value = 0;
+    uint64_t total = 0;
+    valuesAtPercentiles(&percentile, &value, 1, total);
+    return value;
+}
+
+BIHistogramSnapshot Histogram::snapshot() const
+{
+    const double percentiles[4] = {50.0, 90.0, 99.0, 99.9};
+    uint64_t values[4];
+    BIHistogramSnapshot snapshot;
+    valuesAtPercentiles(percentiles, values, 4, snapshot.count);
+    snapshot.minimum = snapshot.count > 0 ? minimum() : 0;
+    snapshot.maximum = maximum();
+    snapshot.mean = snapshot.count > 0 ? double(sum()) / double(snapshot.count) : 0.0;
+    snapshot.p50 = values[0];
+    snapshot.p90 = values[1];
+    snapshot.p99 = values[2];
+    snapshot.p999 = values[3];
+    return snapshot;
+}
+
+// MARK: - Metrics
+
+Metrics::Metrics(const BIMetricsConfiguration &configuration, BIMetricsDumpHandler handler, void *context)
+    : _configuration(configuration), _handler(handler), _context(context), _nextDump(NAN)
+{
+    for (auto &counter : _counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+BIMetricsSnapshot Metrics::snapshot() const
+{
+    BIMetricsSnapshot snapshot;
+    for (uint32_t i = 0; i < BIMetricsCounterCount; i++) {
+        snapshot.counters[i] = _counters[i].load(std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < BIMetricsHistogramCount; i++) {
+        snapshot.histograms[i] = _histograms[i].snapshot();
+    }
+    return snapshot;
+}
+
+void Metrics::reset()
+{
+    for (auto &counter : _counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto &histogram : _histograms) {
+        histogram.reset();
+    }
+}
+
+bool Metrics::dumpIfDue(double timestamp)
+{
+    if (_configuration.dumpInterval <= 0.0 || _handler == nullptr) {
+        return false;
+    }
+    double next = _nextDump.load(std::memory_order_relaxed);
+    if (!std::isnan(next) && timestamp < next) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_dumpMutex);
+    next = _nextDump.load(std::memory_order_relaxed);
+    if (std::isnan(next) || timestamp < next) {
+        if (std::isnan(next)) {
+            _nextDump.store(timestamp + _configuration.dumpInterval, std::memory_order_relaxed);
+        }
+        return false;
+    }
+    _nextDump.store(std::max(next + _configuration.dumpInterval, timestamp), std::memory_order_relaxed);
+    dump(_configuration.dumpFormat, _dumpBytes);
+    _handler(_dumpBytes.data(), _dumpBytes.size(), _context);
+    return true;
+}
+
+void Metrics::dump(BIMetricsDumpFormat format, std::vector<uint8_t> &bytes) const
+{
+    bytes.clear();
+    if (format == BIMetricsDumpFormatBinary) {
+        dumpBinary(bytes);
+    } else {
+        dumpJSON(bytes);
+    }
+}
+
+void Metrics::dumpJSON(std::vector<uint8_t> &bytes) const
+{
+    BIMetricsSnapshot snapshot = this->snapshot();
+    bytes.resize(maximumJSONLength);
+    JSONWriter writer{reinterpret_cast<char *>(bytes.data())};
+    writer.appendString("{\"counters\":{");
+    for (uint32_t i = 0; i < BIMetricsCounterCount; i++) {
+        writer.appendString(i > 0 ? ",\"" : "\"");
+        writer.appendString(counterNames[i]);
+        writer.appendField("\":", snapshot.counters[i]);
+    }
+    writer.appendString("},\"histograms\":{");
+    for (uint32_t i = 0; i < BIMetricsHistogramCount; i++) {
+        const BIHistogramSnapshot &histogram = snapshot.histograms[i];
+        uint64_t tenths = uint64_t(std::llround(histogram.mean * 10.0));
+        writer.appendString(i > 0 ? ",\"" : "\"");
+        writer.appendString(histogramNames[i]);
+        writer.appendString(i == BIMetricsHistogramBeaconsPerTick ? "\":{\"unit\":\"beacons\"" : "\":{\"unit\":\"ns\"");
+        writer.appendField(",\"count\":", histogram.count);
+        writer.appendField(",\"min\":", histogram.minimum);
+        writer.appendField(",\"mean\":", tenths / 10);
+        writer.appendField(".", tenths % 10);
+        writer.appendField(",\"p50\":", histogram.p50);
+        writer.appendField(",\"p90\":", histogram.p90);
+        writer.appendField(",\"p99\":", histogram.p99);
+        writer.appendField(",\"p999\":", histogram.p999);
+        writer.appendField(",\"max\":", histogram.maximum);
+        writer.appendString("}");
+    }
+    writer.appendString("}}");
+    bytes.resize(size_t(writer.cursor - reinterpret_cast<char *>(bytes.data())));
+}
+
+void Metrics::dumpBinary(std::vector<uint8_t> &bytes) const
+{
+    bytes.insert(bytes.end(), magic, magic + sizeof(magic));
+    trace::appendVarint(bytes, BIMetricsCounterCount);
+    for (const auto &counter : _counters) {
+        trace::appendVarint(bytes, counter.load(std::memory_order_relaxed));
+    }
+    trace::appendVarint(bytes, BIMetricsHistogramCount);
+    std::vector<uint32_t> nonEmpty;
+    for (const Histogram &histogram : _histograms) {
+        nonEmpty.clear();
+        uint32_t last = histogram.minimum() <= histogram.maximum() ? Histogram::bucketIndex(histogram.maximum()) : 0;
+        for (uint32_t index = 0; index <= last; index++) {
+            if (histogram.count(index) > 0) {
+                nonEmpty.push_back(index);
+            }
+        }
+        trace::appendVarint(bytes, histogram.sum());
+        trace::appendVarint(bytes, nonEmpty.empty() ? 0 : histogram.minimum());
+        trace::appendVarint(bytes, histogram.maximum());
+        trace::appendVarint(bytes, nonEmpty.size());
+        int64_t previous = -1;
+        for (uint32_t index : nonEmpty) {
+            trace::appendVarint(bytes, uint64_t(int64_t(index) - previous));
+            trace::appendVarint(bytes, histogram.count(index));
+            previous = index;
+        }
+    }
+}
+
+bool Metrics::mergeBinary(const uint8_t *bytes, size_t length)
+{
+    // Decoded completely before anything is added, so that a malformed dump leaves the metrics unchanged.
+    struct Bucket {
+        uint32_t histogram;
+        uint32_t index;
+        uint64_t count;
+    };
+    const uint8_t *position = bytes;
+    const uint8_t *end = bytes + length;
+    if (length < sizeof(magic) || std::memcmp(bytes, magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    position += sizeof(magic);
+
+    uint64_t counterCount = 0;
+    if (!readVarint(position, end, counterCount) || counterCount > BIMetricsCounterCount) {
+        return false;
+    }
+    uint64_t counters[BIMetricsCounterCount] = {};
+    for (uint64_t i = 0; i < counterCount; i++) {
+        if (!readVarint(position, end, counters[i])) {
+            return false;
+        }
+    }
+
+    uint64_t histogramCount = 0;
+    if (!readVarint(position, end, histogramCount) || histogramCount > BIMetricsHistogramCount) {
+        return false;
+    }
+    uint64_t summaries[BIMetricsHistogramCount][4] = {}; // sum, minimum, maximum, buckets
+    std::vector<Bucket> buckets;
+    for (uint32_t histogram = 0; histogram < histogramCount; histogram++) {
+        uint64_t &bucketCount = summaries[histogram][3];
+        if (!readVarint(position, end, summaries[histogram][0]) || !readVarint(position, end, summaries[histogram][1]) ||
+            !readVarint(position, end, summaries[histogram][2]) || !readVarint(position, end, bucketCount) ||
+            bucketCount > Histogram::bucketCount) {
+            return false;
+        }
+        int64_t index = -1;
+        for (uint64_t i = 0; i < bucketCount; i++) {
+            uint64_t delta = 0;
+            uint64_t count = 0;
+            if (!readVarint(position, end, delta) || !readVarint(position, end, count) || delta == 0 ||
+                delta > Histogram::bucketCount || index + int64_t(delta) >= int64_t(Histogram::bucketCount)) {
+                return false;
+            }
+            index += int64_t(delta);
+            buckets.push_back(Bucket{histogram, uint32_t(index), count});
+        }
+    }
+    if (position != end) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < counterCount; i++) {
+        increment(BIMetricsCounter(i), counters[i]);
+    }
+    for (const Bucket &bucket : buckets) {
+        _histograms[bucket.histogram].add(bucket.index, bucket.count);
+    }
+    for (uint32_t histogram = 0; histogram < histogramCount; histogram++) {
+        if (summaries[histogram][3] > 0) {
+            _histograms[histogram].addSummary(summaries[histogram][0], summaries[histogram][1], summaries[histogram][2]);
+        }
+    }
+    return true;
+}
+
+// MARK: - MetricsBatch
+
+void MetricsBatch::flush()
+{
+    for (uint32_t i = 0; i < BIMetricsHistogramCount; i++) {
+        _metrics->record(BIMetricsHistogram(i), _values[i], _counts[i]);
+        _counts[i] = 0;
+    }
+    for (uint32_t i = 0; i < BIMetricsCounterCount; i++) {
+        if (_counters[i] > 0) {
+            _metrics->increment(BIMetricsCounter(i), _counters[i]);
+            _counters[i] = 0;
+        }
+    }
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIMetrics {
+    BIMetrics(const BIMetricsConfiguration &configuration, BIMetricsDumpHandler handler, void *context)
+        : metrics(configuration, handler, context)
+    {
+    }
+    bi::Metrics metrics;
+};
+
+bi::Metrics *bi::unwrapMetrics(BIMetricsRef metrics)
+{
+    return metrics != nullptr ? &metrics->metrics : nullptr;
+}
+
+BIMetricsConfiguration BIMetricsConfigurationMakeDefault(void)
+{
+    BIMetricsConfiguration configuration;
+    configuration.dumpInterval = 60.0;
+    configuration.dumpFormat = BIMetricsDumpFormatJSON;
+    return configuration;
+}
+
+BIMetricsRef BIMetricsCreate(const BIMetricsConfiguration *configuration, BIMetricsDumpHandler handler, void *context)
+{
+    return new BIMetrics(configuration ? *configuration : BIMetricsConfigurationMakeDefault(), handler, context);
+}
+
+void BIMetricsDestroy(BIMetricsRef metrics)
+{
+    delete metrics;
+}
+
+void BIMetricsRecord(BIMetricsRef metrics, BIMetricsHistogram histogram, uint64_t value)
+{
+    if (unsigned(histogram) < BIMetricsHistogramCount) {
+        metrics->metrics.record(histogram, value);
+    }
+}
+
+void BIMetricsIncrement(BIMetricsRef metrics, BIMetricsCounter counter, uint64_t delta)
+{
+    if (unsigned(counter) < BIMetricsCounterCount) {
+        metrics->metrics.increment(counter, delta);
+    }
+}
+
+void BIMetricsGetSnapshot(BIMetricsRef metrics, BIMetricsSnapshot *snapshot)
+{
+    *snapshot = metrics->metrics.snapshot();
+}
+
+uint64_t BIMetricsGetValueAtPercentile(BIMetricsRef metrics, BIMetricsHistogram histogram, double percentile)
+{
+    return unsigned(histogram) < BIMetricsHistogramCount ? metrics->metrics.valueAtPercentile(histogram, percentile) : 0;
+}
+
+void BIMetricsReset(BIMetricsRef metrics)
+{
+    metrics->metrics.reset();
+}
+
+bool BIMetricsDumpIfDue(BIMetricsRef metrics, double timestamp)
+{
+    return metrics->metrics.dumpIfDue(timestamp);
+}
+
+size_t BIMetricsDump(BIMetricsRef metrics, BIMetricsDumpFormat format, uint8_t *buffer, size_t capacity)
+{
+    std::vector<uint8_t> bytes;
+    metrics->metrics.dump(format, bytes);
+    if (capacity > 0) {
+        std::memcpy(buffer, bytes.data(), std::min(capacity, bytes.size()));
+    }
+    return bytes.size();
+}
+
+bool BIMetricsMergeBinary(BIMetricsRef metrics, const uint8_t *bytes, size_t length)
+{
+    return metrics->metrics.mergeBinary(bytes, length);
+}
@@ -0,0 +1,183 @@
+//
+//  Metrics.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIMetrics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace bi {
+
+// Log-linear histogram in the style of HdrHistogram. Bucket i < 64 holds the value i; above that, every power of two
+// [2^m, 2^(m+1)) is split into 32 buckets of width 2^(m-5). All fields are relaxed atomics: concurrent recorders never
+// wait for each other, and readers see each bucket's count at some point during the read.
+class Histogram {
+public:
+    static constexpr uint32_t subBucketBits = 5;
+    static constexpr uint32_t subBucketCount = 1u << subBucketBits;
+    static constexpr uint32_t magnitudeLimit = 48;
+    static constexpr uint64_t maximumValue = (uint64_t(1) << magnitudeLimit) - 1;
+    static constexpr uint32_t bucketCount = (magnitudeLimit - subBucketBits + 1) * subBucketCount;
+
+    Histogram() { reset(); }
+
+    static uint32_t bucketIndex(uint64_t value);
+    static uint64_t bucketLowerBound(uint32_t index);
+    static uint64_t bucketUpperBound(uint32_t index);
+
+    void record(uint64_t value)
+    {
+        value = value < maximumValue ? value : maximumValue;
+        _buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t minimum = _minimum.load(std::memory_order_relaxed);
+        while (value < minimum && !_minimum.compare_exchange_weak(minimum, value, std::memory_order_relaxed)) {
+        }
+        uint64_t maximum = _maximum.load(std::memory_order_relaxed);
+        while (value > maximum && !_maximum.compare_exchange_weak(maximum, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Records count values with one atomic add per value for its bucket, but only one for all of their sum, minimum
+    // and maximum.
+    void record(const uint64_t *values, size_t count);
+
+    void reset();
+    BIHistogramSnapshot snapshot() const;
+    uint64_t valueAtPercentile(double percentile) const;
+
+    // Adds recorded values in bulk, for merging dumps.
+    void add(uint32_t index, uint64_t count) { _buckets[index].fetch_add(count, std::memory_order_relaxed); }
+    void addSummary(uint64_t sum, uint64_t minimum, uint64_t maximum);
+
+    uint64_t count(uint32_t index) const { return _buckets[index].load(std::memory_order_relaxed); }
+    uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+    uint64_t minimum() const { return _minimum.load(std::memory_order_relaxed); }
+    uint64_t maximum() const { return _maximum.load(std::memory_order_relaxed); }
+
+private:
+    // percentiles must be ascending. Sets total to the number of recorded values.
+    void valuesAtPercentiles(const double *percentiles, uint64_t *values, size_t count, uint64_t &total) const;
+
+    std::atomic<uint64_t> _buckets[bucketCount];
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _minimum;
+    std::atomic<uint64_t> _maximum;
+};
+
+class Metrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Metrics(const BIMetricsConfiguration &configuration, BIMetricsDumpHandler handler, void *context);
+
+    Metrics(const Metrics &) = delete;
+    Metrics &operator=(const Metrics &) = delete;
+
+    void record(BIMetricsHistogram histogram, uint64_t value) { _histograms[histogram].record(value); }
+    void record(BIMetricsHistogram histogram, Clock::duration duration)
+    {
+        _histograms[histogram].record(nanoseconds(duration));
+    }
+    void record(BIMetricsHistogram histogram, const uint64_t *values, size_t count)
+    {
+        _histograms[histogram].record(values, count);
+    }
+    // For durations between two of the timestamps (in seconds) the SDK is passed.
+    void recordSeconds(BIMetricsHistogram histogram, double seconds)
+    {
+        _histograms[histogram].record(seconds > 0.0 ? uint64_t(std::min(seconds * 1e9, double(Histogram::maximumValue))) : 0);
+    }
+    void increment(BIMetricsCounter counter, uint64_t delta = 1)
+    {
+        _counters[counter].fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    BIMetricsSnapshot snapshot() const;
+    uint64_t valueAtPercentile(BIMetricsHistogram histogram, double percentile) const
+    {
+        return _histograms[histogram].valueAtPercentile(percentile);
+    }
+    void reset();
+
+    // Whether dumpIfDue(timestamp) has anything to do (dump or start the first interval), without taking the lock.
+    bool dumpDue(double timestamp) const
+    {
+        double next = _nextDump.load(std::memory_order_relaxed);
+        return _configuration.dumpInterval > 0.0 && _handler != nullptr && !(timestamp < next);
+    }
+    bool dumpIfDue(double timestamp);
+    void dump(BIMetricsDumpFormat format, std::vector<uint8_t> &bytes) const;
+    bool mergeBinary(const uint8_t *bytes, size_t length);
+
+    static uint64_t nanoseconds(Clock::duration duration)
+    {
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        return nanoseconds > 0 ? uint64_t(nanoseconds) : 0;
+    }
+
+private:
+    void dumpJSON(std::vector<uint8_t> &bytes) const;
+    void dumpBinary(std::vector<uint8_t> &bytes) const;
+
+    BIMetricsConfiguration _configuration;
+    BIMetricsDumpHandler _handler;
+    void *_context;
+
+    Histogram _histograms[BIMetricsHistogramCount];
+    std::atomic<uint64_t> _counters[BIMetricsCounterCount];
+
+    // NaN until the first call of dumpIfDue(), which starts the first interval.
+    std::atomic<double> _nextDump;
+    std::mutex _dumpMutex;
+    std::vector<uint8_t> _dumpBytes; // guarded by _dumpMutex
+};
+
+// Values recorded by a single thread, added to a Metrics in bulk when one histogram has collected valuesPerHistogram of
+// them or on flush(). Recording a value then costs a plain store, and the shared atomics are updated once per batch for
+// the sums, minimums, maximums and counters, rather than once per value. Snapshots and dumps do not see the values
+// until they are flushed, so owners flush before a dump they trigger and before they let go of the metrics.
+class MetricsBatch {
+public:
+    static constexpr uint32_t valuesPerHistogram = 16;
+
+    explicit MetricsBatch(Metrics *metrics) : _metrics(metrics) {}
+
+    MetricsBatch(const MetricsBatch &) = delete;
+    MetricsBatch &operator=(const MetricsBatch &) = delete;
+
+    void record(BIMetricsHistogram histogram, uint64_t value)
+    {
+        _values[histogram][_counts[histogram]++] = value;
+        if (_counts[histogram] == valuesPerHistogram) {
+            flush();
+        }
+    }
+    void record(BIMetricsHistogram histogram, Metrics::Clock::duration duration)
+    {
+        record(histogram, Metrics::nanoseconds(duration));
+    }
+    void increment(BIMetricsCounter counter, uint64_t delta = 1) { _counters[counter] += delta; }
+
+    void flush();
+
+private:
+    Metrics *_metrics;
+    uint64_t _values[BIMetricsHistogramCount][valuesPerHistogram];
+    uint32_t _counts[BIMetricsHistogramCount] = {};
+    uint64_t _counters[BIMetricsCounterCount] = {};
+};
+
+// Returns the metrics behind a BIMetricsRef, or nullptr for NULL, for the parts of the core that record metrics.
+Metrics *unwrapMetrics(BIMetricsRef metrics);
+
+} // namespace bi
@@ -0,0 +1,303 @@
+//
+//  NearestBeaconTracker.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "NearestBeaconTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bi {
+
+NearestBeaconTracker::NearestBeaconTracker(const BINearestBeaconTrackerConfiguration &configuration)
+    : _configuration(configuration)
+{
+}
+
+void NearestBeaconTracker::place(uint32_t index, const Node &node)
+{
+    _heap[index] = node;
+    _positions[node.handle] = index;
+}
+
+void NearestBeaconTracker::siftUp(uint32_t index)
+{
+    Node node = _heap[index];
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!ranksBefore(node, _heap[parent])) {
+            break;
+        }
+        place(index, _heap[parent]);
+        index = parent;
+    }
+    place(index, node);
+}
+
+void NearestBeaconTracker::siftDown(uint32_t index)
+{
+    Node node = _heap[index];
+    uint32_t size = uint32_t(_heap.size());
+    while (true) {
+        uint32_t child = 2 * index + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && ranksBefore(_heap[child + 1], _heap[child])) {
+            child++;
+        }
+        if (!ranksBefore(_heap[child], node)) {
+            break;
+        }
+        place(index, _heap[child]);
+        index = child;
+    }
+    place(index, node);
+}
+
+void NearestBeaconTracker::update(BIBeaconHandle handle, const BISignal &smoothedSignal)
+{
+    if (!smoothedSignal.inRange) {
+        remove(handle);
+        return;
+    }
+
+    Node node;
+    node.RSSI = smoothedSignal.RSSI;
+    node.handle = handle;
+    node.accuracy = (smoothedSignal.accuracy >= 0.0) ? smoothedSignal.accuracy : HUGE_VAL;
+
+    if (handle >= _positions.size()) {
+        _positions.resize(size_t(handle) + 1, Absent);
+    }
+    uint32_t index = _positions[handle];
+    if (index == Absent) {
+        _heap.push_back(node);
+        siftUp(uint32_t(_heap.size() - 1));
+        return;
+    }
+
+    Node &current = _heap[index];
+    if (current.RSSI == node.RSSI && current.accuracy == node.accuracy) {
+        return;
+    }
+    bool movesUp = ranksBefore(node, current);
+    current = node;
+    if (movesUp) {
+        siftUp(index);
+    } else {
+        siftDown(index);
+    }
+}
+
+void NearestBeaconTracker::remove(BIBeaconHandle handle)
+{
+    if (handle < _locations.size()) {
+        _locations[handle].known = false;
+    }
+    if (!contains(handle)) {
+        return;
+    }
+    uint32_t index = _positions[handle];
+    _positions[handle] = Absent;
+    Node last = _heap.back();
+    _heap.pop_back();
+    if (index < _heap.size()) {
+        bool movesUp = ranksBefore(last, _heap[index]);
+        place(index, last);
+        if (movesUp) {
+            siftUp(index);
+        } else {
+            siftDown(index);
+        }
+    }
+
+    if (handle == _nearest) {
+        _nearest = BIBeaconHandleInvalid;
+        _nearestRemoved = true;
+    }
+}
+
+void NearestBeaconTracker::setLocation(BIBeaconHandle handle, const BIBeaconLocation *location)
+{
+    if (handle >= _locations.size()) {
+        if (location == nullptr) {
+            return;
+        }
+        _locations.resize(size_t(handle) + 1, Location{false, 0, 0.0, 0.0});
+    }
+    _locations[handle] = location != nullptr ? Location{true, location->floor, location->x, location->y}
+                                             : Location{false, 0, 0.0, 0.0};
+}
+
+void NearestBeaconTracker::clear()
+{
+    for (const Node &node : _heap) {
+        _positions[node.handle] = Absent;
+        if (node.handle < _locations.size()) {
+            _locations[node.handle].known = false;
+        }
+    }
+    _heap.clear();
+    if (_nearest != BIBeaconHandleInvalid) {
+        _nearest = BIBeaconHandleInvalid;
+        _nearestRemoved = true;
+    }
+}
+
+// Whether the device can have moved from the current nearest beacon to the beacon within a tick.
+bool NearestBeaconTracker::isReachable(BIBeaconHandle handle) const
+{
+    if (_nearest >= _locations.size() || handle >= _locations.size()) {
+        return true;
+    }
+    const Location &from = _locations[_nearest];
+    const Location &to = _locations[handle];
+    if (!from.known || !to.known) {
+        return true;
+    }
+    return from.floor == to.floor && std::hypot(to.x - from.x, to.y - from.y) <= _configuration.maximumJump;
+}
+
+// Best-first walk over the heap as in copyStrongest(), stopping at the first reachable beacon. The current nearest
+// beacon is reachable from itself, so the walk never passes it.
+BIBeaconHandle NearestBeaconTracker::strongestReachable() const
+{
+    if (_heap.empty() || isReachable(_heap[0].handle)) {
+        return strongest();
+    }
+    auto ranksAfter = [this](uint32_t lhs, uint32_t rhs) { return ranksBefore(_heap[rhs], _heap[lhs]); };
+    _frontier.clear();
+    _frontier.push_back(0);
+    while (!_frontier.empty()) {
+        std::pop_heap(_frontier.begin(), _frontier.end(), ranksAfter);
+        uint32_t index = _frontier.back();
+        _frontier.pop_back();
+        if (isReachable(_heap[index].handle)) {
+            return _heap[index].handle;
+        }
+        for (uint32_t child = 2 * index + 1; child <= 2 * index + 2 && child < _heap.size(); child++) {
+            _frontier.push_back(child);
+            std::push_heap(_frontier.begin(), _frontier.end(), ranksAfter);
+        }
+    }
+    return _nearest;
+}
+
+bool NearestBeaconTracker::evaluate(double timestamp)
+{
+    bool checksJumps = _nearest != BIBeaconHandleInvalid && _configuration.maximumJump > 0.0;
+    BIBeaconHandle candidate = checksJumps ? strongestReachable() : strongest();
+    bool nearestRemoved = _nearestRemoved;
+    _nearestRemoved = false;
+    if (candidate == _nearest) {
+        return nearestRemoved;
+    }
+
+    if (_nearest != BIBeaconHandleInvalid) {
+        const Node &current = _heap[_positions[_nearest]];
+        const Node &challenger = _heap[_positions[candidate]];
+        bool dwelled = (timestamp - _nearestSince >= _configuration.minimumDwellTime);
+        bool clearlyStronger = (double(challenger.RSSI) - double(current.RSSI) >= _configuration.hysteresisMargin);
+        if (!dwelled || !clearlyStronger) {
+            return false;
+        }
+    }
+
+    _nearest = candidate;
+    _nearestSince = timestamp;
+    return true;
+}
+
+size_t NearestBeaconTracker::copyStrongest(BIBeaconHandle *handles, size_t k) const
+{
+    if (k == 0 || _heap.empty()) {
+        return 0;
+    }
+
+    // Best-first walk over the heap: the next strongest beacon is always a child of one already emitted, so the
+    // frontier never holds more than k + 1 entries.
+    auto ranksAfter = [this](uint32_t lhs, uint32_t rhs) { return ranksBefore(_heap[rhs], _heap[lhs]); };
+    _frontier.clear();
+    _frontier.push_back(0);
+    size_t copied = 0;
+    while (copied < k && !_frontier.empty()) {
+        std::pop_heap(_frontier.begin(), _frontier.end(), ranksAfter);
+        uint32_t index = _frontier.back();
+        _frontier.pop_back();
+        handles[copied++] = _heap[index].handle;
+
+        for (uint32_t child = 2 * index + 1; child <= 2 * index + 2 && child < _heap.size(); child++) {
+            _frontier.push_back(child);
+            std::push_heap(_frontier.begin(), _frontier.end(), ranksAfter);
+        }
+    }
+    return copied;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BINearestBeaconTracker {
+    explicit BINearestBeaconTracker(const BINearestBeaconTrackerConfiguration &configuration) : tracker(configuration) {}
+    bi::NearestBeaconTracker tracker;
+};
+
+BINearestBeaconTrackerConfiguration BINearestBeaconTrackerConfigurationMakeDefault(void)
+{
+    BINearestBeaconTrackerConfiguration configuration;
+    configuration.hysteresisMargin = 3.0;
+    configuration.minimumDwellTime = 3.0;
+    configuration.maximumJump = 20.0;
+    return configuration;
+}
+
+BINearestBeaconTrackerRef BINearestBeaconTrackerCreate(const BINearestBeaconTrackerConfiguration *configuration)
+{
+    return new BINearestBeaconTracker(configuration ? *configuration : BINearestBeaconTrackerConfigurationMakeDefault());
+}
+
+void BINearestBeaconTrackerDestroy(BINearestBeaconTrackerRef tracker)
+{
+    delete tracker;
+}
+
+void BINearestBeaconTrackerUpdate(BINearestBeaconTrackerRef tracker, BIBeaconHandle handle, const BISignal *smoothedSignal)
+{
+    tracker->tracker.update(handle, *smoothedSignal);
+}
+
+void BINearestBeaconTrackerRemove(BINearestBeaconTrackerRef tracker, BIBeaconHandle handle)
+{
+    tracker->tracker.remove(handle);
+}
+
+void BINearestBeaconTrackerSetLocation(BINearestBeaconTrackerRef tracker, BIBeaconHandle handle,
+                                       const BIBeaconLocation *location)
+{
+    tracker->tracker.setLocation(handle, location);
+}
+
+bool BINearestBeaconTrackerEvaluate(BINearestBeaconTrackerRef tracker, double timestamp)
+{
+    return tracker->tracker.evaluate(timestamp);
+}
+
+BIBeaconHandle BINearestBeaconTrackerGetNearest(BINearestBeaconTrackerRef tracker)
+{
+    return tracker->tracker.nearest();
+}
+
+size_t BINearestBeaconTrackerCopyStrongest(BINearestBeaconTrackerRef tracker, BIBeaconHandle *handles, size_t k)
+{
+    return tracker->tracker.copyStrongest(handles, k);
+}
+
+size_t BINearestBeaconTrackerGetCount(BINearestBeaconTrackerRef tracker)
+{
+    return tracker->tracker.count();
+}
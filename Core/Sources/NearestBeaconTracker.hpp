@@ -0,0 +1,80 @@
+//
+//  NearestBeaconTracker.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BINearestBeaconTracker.h>
+
+#include <vector>
+
+namespace bi {
+
+// Indexed binary heap of the beacons in range plus the hysteresis state. _positions maps a handle to its heap index,
+// so that a beacon can be moved or removed without searching for it. _locations holds the map locations by handle.
+class NearestBeaconTracker {
+public:
+    explicit NearestBeaconTracker(const BINearestBeaconTrackerConfiguration &configuration);
+
+    void update(BIBeaconHandle handle, const BISignal &smoothedSignal);
+    void remove(BIBeaconHandle handle);
+    void setLocation(BIBeaconHandle handle, const BIBeaconLocation *location);
+    void clear();
+    bool evaluate(double timestamp);
+
+    BIBeaconHandle nearest() const { return _nearest; }
+    BIBeaconHandle strongest() const { return _heap.empty() ? BIBeaconHandleInvalid : _heap[0].handle; }
+    size_t copyStrongest(BIBeaconHandle *handles, size_t k) const;
+    size_t count() const { return _heap.size(); }
+    bool contains(BIBeaconHandle handle) const { return handle < _positions.size() && _positions[handle] != Absent; }
+
+    const BINearestBeaconTrackerConfiguration &configuration() const { return _configuration; }
+
+private:
+    static constexpr uint32_t Absent = UINT32_MAX;
+
+    struct Node {
+        int32_t RSSI;
+        BIBeaconHandle handle;
+        double accuracy; // unknown accuracies are stored as infinity
+    };
+
+    struct Location {
+        bool known;
+        int32_t floor;
+        double x;
+        double y;
+    };
+
+    static bool ranksBefore(const Node &lhs, const Node &rhs)
+    {
+        if (lhs.RSSI != rhs.RSSI) {
+            return lhs.RSSI > rhs.RSSI;
+        }
+        if (lhs.accuracy != rhs.accuracy) {
+            return lhs.accuracy < rhs.accuracy;
+        }
+        return lhs.handle < rhs.handle;
+    }
+
+    void place(uint32_t index, const Node &node);
+    void siftUp(uint32_t index);
+    void siftDown(uint32_t index);
+    bool isReachable(BIBeaconHandle handle) const;
+    BIBeaconHandle strongestReachable() const;
+
+    BINearestBeaconTrackerConfiguration _configuration;
+    std::vector<Node> _heap;
+    std::vector<uint32_t> _positions;
+    std::vector<Location> _locations;
+    mutable std::vector<uint32_t> _frontier; // scratch space for copyStrongest() and strongestReachable()
+
+    BIBeaconHandle _nearest = BIBeaconHandleInvalid;
+    double _nearestSince = 0.0;
+    bool _nearestRemoved = false;
+};
+
+} // namespace bi
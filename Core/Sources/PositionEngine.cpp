@@ -0,0 +1,385 @@
+//
+//  PositionEngine.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "PositionEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bi {
+
+namespace {
+
+BIPositionEstimate invalidEstimate()
+{
+    BIPositionEstimate estimate = {};
+    estimate.valid = false;
+    return estimate;
+}
+
+} // namespace
+
+PositionEngine::PositionEngine(const BIPositionEngineConfiguration &configuration, const BIBeaconLocation *beacons,
+                               size_t count)
+    : _ownedMap(new SpatialIndex(BISpatialIndexConfigurationMakeDefault(), beacons, count))
+    , _map(_ownedMap.get())
+    , _configuration(configuration)
+    , _randomState(configuration.seed)
+{
+    allocate();
+}
+
+PositionEngine::PositionEngine(const BIPositionEngineConfiguration &configuration, const SpatialIndex *map)
+    : _map(map), _configuration(configuration), _randomState(configuration.seed)
+{
+    allocate();
+}
+
+void PositionEngine::allocate()
+{
+    _configuration.maximumIterations = std::max<uint32_t>(_configuration.maximumIterations, 1);
+    _configuration.minimumRangeError = std::max(_configuration.minimumRangeError, 1e-3);
+    _observedTick.assign(_map->count(), 0);
+    _reachableTick.assign(_map->count(), 0);
+    _smoothed.resize(_map->count());
+    _raw.resize(_map->count());
+    _particleX.resize(_configuration.particleCount);
+    _particleY.resize(_configuration.particleCount);
+    _weights.resize(_configuration.particleCount);
+    _logLikelihoods.resize(_configuration.particleCount);
+    _resampledX.resize(_configuration.particleCount);
+    _resampledY.resize(_configuration.particleCount);
+}
+
+double PositionEngine::uniform()
+{
+    uint64_t z = (_randomState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return double(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double PositionEngine::normal()
+{
+    double u1 = std::max(uniform(), 1e-300);
+    double u2 = uniform();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+}
+
+void PositionEngine::beginTick()
+{
+    _tick++;
+    _smoothedCount = 0;
+    _rawCount = 0;
+}
+
+bool PositionEngine::makeObservation(uint32_t index, const BISignal &signal, Observation &observation) const
+{
+    if (!signal.inRange || !(signal.accuracy > 0.0) || signal.accuracy > _configuration.maximumRange) {
+        return false;
+    }
+    const BIBeaconLocation &location = _map->location(index);
+    double error = std::max(_configuration.rangeError * signal.accuracy, _configuration.minimumRangeError);
+    observation = {location.x, location.y, signal.accuracy, 1.0 / (error * error), index, location.floor};
+    return true;
+}
+
+void PositionEngine::observe(const BIRangedBeacon &beacon)
+{
+    uint32_t index = _map->indexOf(beacon.key);
+    if (index == SpatialIndex::Absent || _observedTick[index] == _tick) {
+        return;
+    }
+    _observedTick[index] = _tick;
+    _smoothedCount += makeObservation(index, beacon.smoothedSignal, _smoothed[_smoothedCount]) ? 1 : 0;
+    _rawCount += makeObservation(index, beacon.rawSignal, _raw[_rawCount]) ? 1 : 0;
+}
+
+// The device is on the floor whose beacons carry the most weight in the smoothed distances, which are dominated by
+// the nearest beacons; beacons heard through the ceiling are dropped. A change of floor restarts the particle filter.
+void PositionEngine::selectFloor()
+{
+    int32_t bestFloor = _floor;
+    double bestWeight = 0.0;
+    for (size_t i = 0; i < _smoothedCount; i++) {
+        double weight = 0.0;
+        for (size_t j = 0; j < _smoothedCount; j++) {
+            weight += _smoothed[j].floor == _smoothed[i].floor ? _smoothed[j].weight : 0.0;
+        }
+        if (weight > bestWeight) {
+            bestWeight = weight;
+            bestFloor = _smoothed[i].floor;
+        }
+    }
+    if (bestFloor != _floor) {
+        _floor = bestFloor;
+        _particlesValid = false;
+    }
+    auto onOtherFloor = [this](const Observation &observation) { return observation.floor != _floor; };
+    _smoothedCount = size_t(std::remove_if(_smoothed.begin(), _smoothed.begin() + std::ptrdiff_t(_smoothedCount), onOtherFloor) -
+                            _smoothed.begin());
+    _rawCount = size_t(std::remove_if(_raw.begin(), _raw.begin() + std::ptrdiff_t(_rawCount), onOtherFloor) - _raw.begin());
+}
+
+// Beacons farther from the last position than the device can have walked plus the ranging range cannot have been heard
+// (e.g. a beacon whose identity is reused elsewhere in the venue). If most of the tick's beacons are out of reach, it is
+// the position that is wrong: the particle filter starts over and nothing is dropped.
+void PositionEngine::dropUnreachable(double timestamp)
+{
+    if (!_particlesValid || _smoothedCount == 0) {
+        return;
+    }
+    double elapsed = std::max(timestamp - _lastTimestamp, 0.0);
+    double reach = _configuration.maximumRange + 3.0 * (_lastEstimate.uncertainty + _configuration.walkingSpeed * elapsed);
+    _map->visitWithinRadius(_floor, _lastEstimate.x, _lastEstimate.y, reach,
+                            [this](uint32_t index, double) { _reachableTick[index] = _tick; });
+    auto unreachable = [this](const Observation &observation) { return _reachableTick[observation.index] != _tick; };
+    size_t reachable = _smoothedCount - size_t(std::count_if(_smoothed.begin(), _smoothed.begin() + std::ptrdiff_t(_smoothedCount), unreachable));
+    if (2 * reachable < _smoothedCount) {
+        _particlesValid = false;
+        return;
+    }
+    _smoothedCount = size_t(std::remove_if(_smoothed.begin(), _smoothed.begin() + std::ptrdiff_t(_smoothedCount), unreachable) -
+                            _smoothed.begin());
+    _rawCount = size_t(std::remove_if(_raw.begin(), _raw.begin() + std::ptrdiff_t(_rawCount), unreachable) - _raw.begin());
+}
+
+BIPosition PositionEngine::finishTick(double timestamp)
+{
+    selectFloor();
+    dropUnreachable(timestamp);
+    BIPosition position;
+    position.timestamp = timestamp;
+    position.iterations = 0;
+    position.fix = solve(position.iterations);
+    position.filtered = filter(timestamp, position.fix);
+    if (position.filtered.valid) {
+        _lastEstimate = position.filtered;
+    }
+    return position;
+}
+
+BIPosition PositionEngine::update(double timestamp, const BIRangedBeacon *beacons, size_t count)
+{
+    beginTick();
+    for (size_t i = 0; i < count; i++) {
+        observe(beacons[i]);
+    }
+    return finishTick(timestamp);
+}
+
+BIPosition PositionEngine::update(const BIRangingBatch &batch)
+{
+    beginTick();
+    for (size_t r = 0; r < batch.regionCount; r++) {
+        for (size_t i = 0; i < batch.regions[r].beaconCount; i++) {
+            observe(batch.regions[r].beacons[i]);
+        }
+    }
+    return finishTick(batch.timestamp);
+}
+
+BIPositionEstimate PositionEngine::solve(uint32_t &iterations) const
+{
+    BIPositionEstimate estimate = trilaterate(_smoothed.data(), _smoothedCount, _configuration.maximumIterations,
+                                              _configuration.convergenceThreshold, iterations);
+    if (estimate.valid) {
+        estimate.floor = _floor;
+    }
+    return estimate;
+}
+
+void PositionEngine::scatterParticles(const BIPositionEstimate &around)
+{
+    // Cholesky factor of the fix's covariance.
+    double a = std::sqrt(std::max(around.covarianceXX, 1e-6));
+    double b = around.covarianceXY / a;
+    double c = std::sqrt(std::max(around.covarianceYY - b * b, 1e-6));
+    size_t count = _particleX.size();
+    for (size_t i = 0; i < count; i++) {
+        double u = normal();
+        double v = normal();
+        _particleX[i] = around.x + a * u;
+        _particleY[i] = around.y + b * u + c * v;
+        _weights[i] = 1.0 / double(count);
+    }
+    _particlesValid = true;
+}
+
+// Systematic resampling: one uniform offset, then count evenly spaced points through the cumulative weights.
+void PositionEngine::resample()
+{
+    size_t count = _particleX.size();
+    double step = 1.0 / double(count);
+    double point = uniform() * step;
+    double cumulative = _weights[0];
+    size_t source = 0;
+    for (size_t i = 0; i < count; i++) {
+        while (point > cumulative && source + 1 < count) {
+            cumulative += _weights[++source];
+        }
+        _resampledX[i] = _particleX[source];
+        _resampledY[i] = _particleY[source];
+        point += step;
+    }
+    _particleX.swap(_resampledX);
+    _particleY.swap(_resampledY);
+    std::fill(_weights.begin(), _weights.end(), step);
+}
+
+BIPositionEstimate PositionEngine::filter(double timestamp, const BIPositionEstimate &fix)
+{
+    size_t count = _particleX.size();
+    if (count == 0) {
+        return invalidEstimate();
+    }
+    if (!_particlesValid) {
+        if (!fix.valid) {
+            return invalidEstimate();
+        }
+        scatterParticles(fix);
+        _lastTimestamp = timestamp;
+    }
+
+    double elapsed = std::max(timestamp - _lastTimestamp, 0.0);
+    _lastTimestamp = timestamp;
+    if (elapsed > 0.0) {
+        double spread = _configuration.walkingSpeed * elapsed;
+        for (size_t i = 0; i < count; i++) {
+            _particleX[i] += spread * normal();
+            _particleY[i] += spread * normal();
+        }
+    }
+
+    if (_rawCount > 0) {
+        // Weights are multiplied by exp(logLikelihood - best), so that the best particle's factor is 1 and nothing
+        // underflows as long as one particle explains the distances.
+        double best = -INFINITY;
+        for (size_t i = 0; i < count; i++) {
+            _logLikelihoods[i] = -0.5 * rangeCost(_raw.data(), _rawCount, _particleX[i], _particleY[i]);
+            best = std::max(best, _logLikelihoods[i]);
+        }
+        // When even the best particle is more than three standard deviations off per beacon on average, the filter has
+        // lost the device (e.g. it jumped floors or was reset elsewhere): start over from the fix.
+        if (fix.valid && best < -4.5 * double(_rawCount)) {
+            scatterParticles(fix);
+            for (size_t i = 0; i < count; i++) {
+                _logLikelihoods[i] = -0.5 * rangeCost(_raw.data(), _rawCount, _particleX[i], _particleY[i]);
+                best = std::max(best, _logLikelihoods[i]);
+            }
+        }
+        double sum = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            _weights[i] *= std::exp(_logLikelihoods[i] - best);
+            sum += _weights[i];
+        }
+        if (!(sum > 0.0)) {
+            std::fill(_weights.begin(), _weights.end(), 1.0 / double(count));
+        } else {
+            double squares = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                _weights[i] /= sum;
+                squares += _weights[i] * _weights[i];
+            }
+            // Resample when the effective number of particles drops below half of them.
+            if (squares * double(count) > 2.0) {
+                resample();
+            }
+        }
+    }
+
+    double x = 0.0;
+    double y = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        x += _weights[i] * _particleX[i];
+        y += _weights[i] * _particleY[i];
+    }
+    double xx = 0.0;
+    double xy = 0.0;
+    double yy = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double dx = _particleX[i] - x;
+        double dy = _particleY[i] - y;
+        xx += _weights[i] * dx * dx;
+        xy += _weights[i] * dx * dy;
+        yy += _weights[i] * dy * dy;
+    }
+    BIPositionEstimate estimate;
+    estimate.valid = true;
+    estimate.x = x;
+    estimate.y = y;
+    estimate.floor = _floor;
+    estimate.beaconCount = uint32_t(_rawCount);
+    setPositionCovariance(estimate, xx, xy, yy);
+    return estimate;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIPositionEngine {
+    BIPositionEngine(const BIPositionEngineConfiguration &configuration, const BIBeaconLocation *beacons, size_t count)
+        : engine(configuration, beacons, count)
+    {
+    }
+    BIPositionEngine(const BIPositionEngineConfiguration &configuration, const bi::SpatialIndex *map)
+        : engine(configuration, map)
+    {
+    }
+    bi::PositionEngine engine;
+};
+
+BIPositionEngineConfiguration BIPositionEngineConfigurationMakeDefault(void)
+{
+    BIPositionEngineConfiguration configuration;
+    configuration.rangeError = 0.5;
+    configuration.minimumRangeError = 0.5;
+    configuration.maximumRange = 30.0;
+    configuration.maximumIterations = 10;
+    configuration.convergenceThreshold = 0.01;
+    configuration.particleCount = 500;
+    configuration.walkingSpeed = 1.4;
+    configuration.seed = 0x5EED;
+    return configuration;
+}
+
+BIPositionEngineRef BIPositionEngineCreate(const BIPositionEngineConfiguration *configuration,
+                                           const BIBeaconLocation *beacons, size_t beaconCount)
+{
+    return new BIPositionEngine(configuration ? *configuration : BIPositionEngineConfigurationMakeDefault(), beacons,
+                                beaconCount);
+}
+
+BIPositionEngineRef BIPositionEngineCreateWithSpatialIndex(const BIPositionEngineConfiguration *configuration,
+                                                           BISpatialIndexRef index)
+{
+    return new BIPositionEngine(configuration ? *configuration : BIPositionEngineConfigurationMakeDefault(),
+                                bi::unwrapSpatialIndex(index));
+}
+
+void BIPositionEngineDestroy(BIPositionEngineRef engine)
+{
+    delete engine;
+}
+
+BIPosition BIPositionEngineUpdate(BIPositionEngineRef engine, double timestamp, const BIRangedBeacon *beacons,
+                                  size_t beaconCount)
+{
+    return engine->engine.update(timestamp, beacons, beaconCount);
+}
+
+BIPosition BIPositionEngineUpdateWithBatch(BIPositionEngineRef engine, const BIRangingBatch *batch)
+{
+    return engine->engine.update(*batch);
+}
+
+void BIPositionEngineReset(BIPositionEngineRef engine)
+{
+    engine->engine.reset();
+}
@@ -0,0 +1,79 @@
+//
+//  PositionEngine.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIPositionEngine.h>
+
+#include "SpatialIndex.hpp"
+#include "Trilateration.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace bi {
+
+// The fix trilaterates the smoothed distances; the particle filter weighs the raw distances of the tick, since it does
+// its own smoothing over time and smoothed distances would make it lag twice. Every vector is sized for the whole map
+// (observations) or all particles when the engine is created, so update() never allocates. Particles are kept as parallel arrays; resampling writes into the second set and swaps.
+class PositionEngine {
+public:
+    PositionEngine(const BIPositionEngineConfiguration &configuration, const BIBeaconLocation *beacons, size_t count);
+    // Uses a map that is shared with other users and must outlive the engine.
+    PositionEngine(const BIPositionEngineConfiguration &configuration, const SpatialIndex *map);
+
+    BIPosition update(double timestamp, const BIRangedBeacon *beacons, size_t count);
+    BIPosition update(const BIRangingBatch &batch);
+    void reset() { _particlesValid = false; }
+
+private:
+    typedef RangeObservation Observation; // index is in the map
+
+    void allocate();
+
+    void beginTick();
+    void observe(const BIRangedBeacon &beacon);
+    bool makeObservation(uint32_t index, const BISignal &signal, Observation &observation) const;
+    void selectFloor();
+    void dropUnreachable(double timestamp);
+    BIPosition finishTick(double timestamp);
+
+    BIPositionEstimate solve(uint32_t &iterations) const;
+    BIPositionEstimate filter(double timestamp, const BIPositionEstimate &fix);
+    void scatterParticles(const BIPositionEstimate &around);
+    void resample();
+
+    double uniform();
+    double normal();
+
+    std::unique_ptr<SpatialIndex> _ownedMap;
+    const SpatialIndex *_map;
+    BIPositionEngineConfiguration _configuration;
+    // Tick in which each mapped beacon was last observed (so that beacons ranged in several regions count once) and
+    // last found within reach of the previous position.
+    std::vector<uint64_t> _observedTick;
+    std::vector<uint64_t> _reachableTick;
+    uint64_t _tick = 0;
+    std::vector<Observation> _smoothed;
+    size_t _smoothedCount = 0;
+    std::vector<Observation> _raw;
+    size_t _rawCount = 0;
+
+    int32_t _floor = 0;
+    bool _particlesValid = false;
+    double _lastTimestamp = 0.0;
+    BIPositionEstimate _lastEstimate = {};
+    std::vector<double> _particleX;
+    std::vector<double> _particleY;
+    std::vector<double> _weights;
+    std::vector<double> _logLikelihoods;
+    std::vector<double> _resampledX;
+    std::vector<double> _resampledY;
+    uint64_t _randomState;
+};
+
+} // namespace bi
@@ -0,0 +1,550 @@
+//
+//  RangingPipeline.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "RangingPipeline.hpp"
+
+#include <algorithm>
+
+namespace bi {
+
+struct RangingPipeline::Batch {
+    BIRangingBatch batch;
+    std::vector<BIRangedBeacon> beacons;
+    std::vector<BIRegionRangingResult> regions;
+    // When the tick's first report arrived and when the batch was handed to the delivery queue, for the metrics.
+    Clock::time_point opened;
+    Clock::time_point ready;
+    // Set while the batch waits on the delivery queue, so that the delivery state outlives the pipeline if necessary.
+    std::shared_ptr<DeliveryState> retainedState;
+};
+
+// Everything a pending delivery needs. Shared between the pipeline and the batches on the delivery queue, so that
+// destroying the pipeline does not invalidate them.
+struct RangingPipeline::DeliveryState {
+    explicit DeliveryState(Metrics *metrics) : metrics(metrics), metricsBatch(metrics) {}
+
+    BIRangingBatchHandler handler;
+    void *context;
+    Metrics *metrics;
+    MetricsBatch metricsBatch; // guarded by handlerMutex
+
+    // Held while the handler runs. Recursive, so that the handler may destroy the pipeline.
+    std::recursive_mutex handlerMutex;
+    bool cancelled = false;
+
+    std::mutex poolMutex;
+    std::vector<std::unique_ptr<Batch>> batches;
+    std::vector<Batch *> freeBatches;
+
+    std::atomic<uint64_t> delivered{0};
+
+    // Calls the handler with handlerMutex held. Batches delivered synchronously start right when they are ready.
+    void deliver(const Batch &batch, bool queued)
+    {
+        if (metrics == nullptr) {
+            handler(&batch.batch, context);
+            delivered++;
+            return;
+        }
+        Clock::time_point started = queued ? Clock::now() : batch.ready;
+        handler(&batch.batch, context);
+        delivered++;
+        Clock::time_point finished = Clock::now();
+        metricsBatch.record(BIMetricsHistogramDispatch, started - batch.ready);
+        metricsBatch.record(BIMetricsHistogramHandler, finished - started);
+        metricsBatch.record(BIMetricsHistogramEndToEnd, finished - batch.opened);
+    }
+
+    Batch *acquireBatch()
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (freeBatches.empty()) {
+            return nullptr;
+        }
+        Batch *batch = freeBatches.back();
+        freeBatches.pop_back();
+        return batch;
+    }
+
+    void releaseBatch(Batch *batch)
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        freeBatches.push_back(batch);
+    }
+};
+
+RangingPipeline::RangingPipeline(const BIRangingPipelineConfiguration &configuration, BIDeliveryQueue deliveryQueue,
+                                 BIRangingBatchHandler handler, void *context)
+    : _configuration(configuration)
+    , _metrics(unwrapMetrics(configuration.metrics))
+    , _spatialIndex(unwrapSpatialIndex(configuration.spatialIndex))
+    , _deliveryQueue(deliveryQueue)
+    , _delivery(std::make_shared<DeliveryState>(_metrics))
+    , _beaconTable(configuration.beaconTable)
+    , _metricsBatch(_metrics)
+{
+    _delivery->handler = handler;
+    _delivery->context = context;
+    uint32_t batchCount = _configuration.synchronous ? 1 : std::max<uint32_t>(_configuration.maximumPendingDeliveries, 1);
+    for (uint32_t i = 0; i < batchCount; i++) {
+        _delivery->batches.emplace_back(new Batch());
+        _delivery->freeBatches.push_back(_delivery->batches.back().get());
+    }
+
+    _openTick = makeTickLocked();
+    if (!_configuration.synchronous) {
+        _worker = std::thread(&RangingPipeline::runWorker, this);
+    }
+}
+
+RangingPipeline::~RangingPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _workAvailable.notify_all();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(_delivery->handlerMutex);
+    _delivery->cancelled = true;
+    if (_metrics != nullptr) {
+        _metricsBatch.flush();
+        _delivery->metricsBatch.flush();
+    }
+}
+
+std::unique_ptr<RangingPipeline::Tick> RangingPipeline::makeTickLocked()
+{
+    std::unique_ptr<Tick> tick;
+    if (_freeTicks.empty()) {
+        tick.reset(new Tick());
+    } else {
+        tick = std::move(_freeTicks.back());
+        _freeTicks.pop_back();
+        tick->reports.clear();
+        tick->samples.clear();
+        tick->addedRegions.clear();
+        tick->removedRegions.clear();
+    }
+    tick->serial = _nextTickSerial++;
+    return tick;
+}
+
+void RangingPipeline::closeOpenTickLocked()
+{
+    if (_openTick->empty()) {
+        return;
+    }
+    _closedTicks.push_back(std::move(_openTick));
+    _openTick = makeTickLocked();
+    _regionsReportedInOpenTick = 0;
+    _workAvailable.notify_one();
+}
+
+uint32_t RangingPipeline::addRegion(const BISmoothingConfiguration &smoothing)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t regionID = _nextRegionID++;
+    _lastReportedTickByRegion[regionID] = 0;
+    // The worker creates the region's engine before it processes the region's first report.
+    _openTick->addedRegions.emplace_back(regionID, smoothing);
+    return regionID;
+}
+
+void RangingPipeline::removeRegion(uint32_t regionID)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _lastReportedTickByRegion.find(regionID);
+    if (it == _lastReportedTickByRegion.end()) {
+        return;
+    }
+    if (it->second == _openTick->serial) {
+        _regionsReportedInOpenTick--;
+    }
+    _lastReportedTickByRegion.erase(it);
+    _openTick->removedRegions.push_back(regionID);
+
+    // The open tick may now be complete.
+    if (_regionsReportedInOpenTick > 0 && _regionsReportedInOpenTick == _lastReportedTickByRegion.size()) {
+        closeOpenTickLocked();
+    }
+    if (_configuration.synchronous) {
+        processClosedTicks(lock);
+    }
+}
+
+void RangingPipeline::submit(uint32_t regionID, double timestamp, const BIBeaconSample *samples, size_t count)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto region = _lastReportedTickByRegion.find(regionID);
+    if (region == _lastReportedTickByRegion.end()) {
+        return;
+    }
+
+    if (region->second == _openTick->serial) {
+        // Second report of this region: it belongs to the next tick.
+        closeOpenTickLocked();
+    }
+    if (_openTick->reports.empty()) {
+        _openTick->opened = Clock::now();
+    }
+
+    Tick &tick = *_openTick;
+    tick.reports.push_back(Report{regionID, timestamp, tick.samples.size(), count});
+    tick.samples.insert(tick.samples.end(), samples, samples + count);
+    region->second = tick.serial;
+    _regionsReportedInOpenTick++;
+
+    bool isComplete = (_regionsReportedInOpenTick == _lastReportedTickByRegion.size());
+    if (isComplete) {
+        closeOpenTickLocked();
+    } else if (_regionsReportedInOpenTick == 1 && !_configuration.synchronous) {
+        // Let the worker start the coalescing timeout.
+        _workAvailable.notify_one();
+    }
+
+    if (_configuration.synchronous) {
+        processClosedTicks(lock);
+    }
+}
+
+void RangingPipeline::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    closeOpenTickLocked();
+    if (_configuration.synchronous) {
+        processClosedTicks(lock);
+    }
+}
+
+void RangingPipeline::processClosedTicks(std::unique_lock<std::mutex> &lock)
+{
+    while (!_closedTicks.empty()) {
+        std::unique_ptr<Tick> tick = std::move(_closedTicks.front());
+        _closedTicks.pop_front();
+        _processing = true;
+        lock.unlock();
+        processTick(*tick);
+        lock.lock();
+        _freeTicks.push_back(std::move(tick));
+        _processing = false;
+    }
+    _idle.notify_all();
+}
+
+void RangingPipeline::waitUntilIdle()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this] { return _closedTicks.empty() && !_processing; });
+}
+
+BIRangingPipelineStatistics RangingPipeline::statistics() const
+{
+    BIRangingPipelineStatistics statistics;
+    statistics.ticksProcessed = _ticksProcessed.load();
+    statistics.batchesDelivered = _delivery->delivered.load();
+    statistics.batchesDropped = _batchesDropped.load();
+    return statistics;
+}
+
+void RangingPipeline::runWorker()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping) {
+        if (!_closedTicks.empty()) {
+            processClosedTicks(lock);
+            continue;
+        }
+
+        if (!_openTick->reports.empty()) {
+            uint64_t serial = _openTick->serial;
+            auto deadline = _openTick->opened + std::chrono::duration_cast<Clock::duration>(
+                                                    std::chrono::duration<double>(_configuration.coalescingTimeout));
+            if (_workAvailable.wait_until(lock, deadline) == std::cv_status::timeout && _openTick->serial == serial) {
+                closeOpenTickLocked();
+                if (_metrics != nullptr) {
+                    _metrics->increment(BIMetricsCounterLateTicks);
+                }
+            }
+            continue;
+        }
+
+        if (_metrics != nullptr) {
+            flushMetricsBatches();
+        }
+        _workAvailable.wait(lock);
+    }
+}
+
+void RangingPipeline::processTick(const Tick &tick)
+{
+    // Stage boundaries are only taken with metrics, and once per tick rather than per region: reading the clock costs
+    // about as much as smoothing a few beacons.
+    Clock::time_point started = _metrics != nullptr ? Clock::now() : Clock::time_point();
+
+    double timestamp = 0.0;
+    _reportedRegions.clear();
+    for (const auto &addedRegion : tick.addedRegions) {
+        RegionState &region = _regions[addedRegion.first];
+        region.engine.reset(new SmoothingEngine(addedRegion.second, &_beaconTable));
+        region.nearestBeacon.reset(new NearestBeaconTracker(_configuration.nearestBeacon));
+    }
+    for (const Report &report : tick.reports) {
+        _regions[report.regionID].engine->processTick(report.timestamp, tick.samples.data() + report.firstSample,
+                                                      report.sampleCount);
+        _reportedRegions.push_back(report.regionID);
+        timestamp = std::max(timestamp, report.timestamp);
+    }
+    Clock::time_point smoothed = _metrics != nullptr ? Clock::now() : Clock::time_point();
+
+    // Every region reports at most once per tick, so its engine's changes are still those of its report.
+    for (const Report &report : tick.reports) {
+        RegionState &region = _regions[report.regionID];
+        const SmoothingEngine &engine = *region.engine;
+        NearestBeaconTracker &nearestBeacon = *region.nearestBeacon;
+        for (BIBeaconHandle handle : engine.droppedHandles()) {
+            nearestBeacon.remove(handle);
+        }
+        for (BIBeaconHandle handle : engine.changedHandles()) {
+            bool entersRange = _spatialIndex != nullptr && !nearestBeacon.contains(handle);
+            nearestBeacon.update(handle, engine.smoothedSignals().last(handle));
+            if (entersRange && nearestBeacon.contains(handle)) {
+                uint32_t index = _spatialIndex->indexOf(_beaconTable.key(handle));
+                if (index != SpatialIndex::Absent) {
+                    nearestBeacon.setLocation(handle, &_spatialIndex->location(index));
+                }
+            }
+        }
+        nearestBeacon.evaluate(report.timestamp);
+    }
+    Clock::time_point selected = _metrics != nullptr ? Clock::now() : Clock::time_point();
+    for (uint32_t regionID : tick.removedRegions) {
+        _regions.erase(regionID);
+        _reportedRegions.erase(std::remove(_reportedRegions.begin(), _reportedRegions.end(), regionID), _reportedRegions.end());
+    }
+
+    if (timestamp >= _nextEviction && _beaconTable.configuration().idleTimeout > 0.0) {
+        _beaconTable.evictIdle(timestamp);
+        _nextEviction = timestamp + _beaconTable.configuration().idleTimeout / 4.0;
+    }
+    _ticksProcessed++;
+
+    if (_reportedRegions.empty()) {
+        // The reports of regions removed in the same tick were still smoothed.
+        if (_metrics != nullptr && !tick.reports.empty()) {
+            recordTick(tick, started, smoothed, selected, timestamp);
+        }
+        return;
+    }
+
+    Batch *batch = _delivery->acquireBatch();
+    if (batch == nullptr) {
+        _batchesDropped++;
+        if (_metrics != nullptr) {
+            _metrics->increment(BIMetricsCounterDroppedBatches);
+            recordTick(tick, started, smoothed, selected, timestamp);
+        }
+        return;
+    }
+    fillBatch(*batch, tick, timestamp);
+    if (_metrics != nullptr) {
+        batch->opened = tick.opened;
+        batch->ready = Clock::now();
+        _metricsBatch.record(BIMetricsHistogramBatchAssembly, batch->ready - selected);
+        recordTick(tick, started, smoothed, selected, timestamp);
+    }
+
+    if (_configuration.synchronous) {
+        {
+            std::lock_guard<std::recursive_mutex> lock(_delivery->handlerMutex);
+            _delivery->deliver(*batch, false);
+        }
+        _delivery->releaseBatch(batch);
+        return;
+    }
+
+    batch->retainedState = _delivery;
+    _deliveryQueue.dispatch(_deliveryQueue.queue, batch, &RangingPipeline::performDelivery);
+}
+
+void RangingPipeline::recordTick(const Tick &tick, Clock::time_point started, Clock::time_point smoothed,
+                                 Clock::time_point selected, double timestamp)
+{
+    _metricsBatch.record(BIMetricsHistogramQueueing, started - tick.opened);
+    _metricsBatch.record(BIMetricsHistogramSmoothing, smoothed - started);
+    _metricsBatch.record(BIMetricsHistogramNearestBeacon, selected - smoothed);
+    _metricsBatch.record(BIMetricsHistogramBeaconsPerTick, uint64_t(tick.samples.size()));
+    _metricsBatch.increment(BIMetricsCounterTicks);
+    _metricsBatch.increment(BIMetricsCounterSamples, tick.samples.size());
+    if (_metrics->dumpDue(timestamp)) {
+        flushMetricsBatches();
+        _metrics->dumpIfDue(timestamp);
+    }
+}
+
+void RangingPipeline::flushMetricsBatches()
+{
+    _metricsBatch.flush();
+    // Never waits for a running handler: its batch is flushed when it fills up or the pipeline is destroyed instead.
+    if (_delivery->handlerMutex.try_lock()) {
+        _delivery->metricsBatch.flush();
+        _delivery->handlerMutex.unlock();
+    }
+}
+
+void RangingPipeline::fillBatch(Batch &batch, const Tick &, double timestamp)
+{
+    batch.beacons.clear();
+    batch.regions.clear();
+
+    for (uint32_t regionID : _reportedRegions) {
+        RegionState &region = _regions[regionID];
+        const SmoothingEngine &engine = *region.engine;
+
+        size_t first = batch.beacons.size();
+        for (size_t i = 0; i < engine.beaconCount(); i++) {
+            BIBeaconHandle handle = engine.handleAtIndex(i);
+            BIRangedBeacon beacon;
+            beacon.handle = handle;
+            beacon.key = _beaconTable.key(handle);
+            beacon.smoothedSignal = engine.smoothedSignals().last(handle);
+            beacon.rawSignal = engine.rawSignals().last(handle);
+            batch.beacons.push_back(beacon);
+        }
+        std::sort(batch.beacons.begin() + std::ptrdiff_t(first), batch.beacons.end(), [](const BIRangedBeacon &lhs, const BIRangedBeacon &rhs) {
+            if (lhs.smoothedSignal.inRange != rhs.smoothedSignal.inRange) {
+                return lhs.smoothedSignal.inRange;
+            }
+            if (lhs.smoothedSignal.RSSI != rhs.smoothedSignal.RSSI) {
+                return lhs.smoothedSignal.RSSI > rhs.smoothedSignal.RSSI;
+            }
+            return lhs.handle < rhs.handle;
+        });
+
+        BIBeaconHandle nearest = region.nearestBeacon->nearest();
+        uint32_t nearestGeneration = _beaconTable.generation(nearest);
+        BIRegionRangingResult result;
+        result.regionID = regionID;
+        // Pointers are filled in below, once batch.beacons has stopped growing.
+        result.beacons = nullptr;
+        result.beaconCount = batch.beacons.size() - first;
+        result.nearestBeacon = nullptr;
+        result.nearestBeaconChanged = (nearest != region.reportedNearest || nearestGeneration != region.reportedNearestGeneration);
+        region.reportedNearest = nearest;
+        region.reportedNearestGeneration = nearestGeneration;
+        batch.regions.push_back(result);
+    }
+
+    size_t offset = 0;
+    for (BIRegionRangingResult &result : batch.regions) {
+        result.beacons = batch.beacons.data() + offset;
+        RegionState &region = _regions[result.regionID];
+        for (size_t i = 0; i < result.beaconCount; i++) {
+            if (result.beacons[i].handle == region.reportedNearest) {
+                result.nearestBeacon = &result.beacons[i];
+            }
+        }
+        offset += result.beaconCount;
+    }
+
+    batch.batch.sequenceNumber = ++_batchSequenceNumber;
+    batch.batch.timestamp = timestamp;
+    batch.batch.regions = batch.regions.data();
+    batch.batch.regionCount = batch.regions.size();
+}
+
+void RangingPipeline::performDelivery(void *context)
+{
+    Batch *batch = static_cast<Batch *>(context);
+    std::shared_ptr<DeliveryState> state = std::move(batch->retainedState);
+    {
+        std::lock_guard<std::recursive_mutex> lock(state->handlerMutex);
+        if (!state->cancelled) {
+            state->deliver(*batch, true);
+        }
+    }
+    state->releaseBatch(batch);
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIRangingPipeline {
+    BIRangingPipeline(const BIRangingPipelineConfiguration &configuration, BIDeliveryQueue deliveryQueue,
+                      BIRangingBatchHandler handler, void *context)
+        : configuration(configuration), pipeline(configuration, deliveryQueue, handler, context)
+    {
+    }
+    BIRangingPipelineConfiguration configuration;
+    bi::RangingPipeline pipeline;
+};
+
+BIRangingPipelineConfiguration BIRangingPipelineConfigurationMakeDefault(void)
+{
+    BIRangingPipelineConfiguration configuration;
+    configuration.smoothing = BISmoothingConfigurationMakeDefault();
+    configuration.beaconTable = BIBeaconTableConfigurationMakeDefault();
+    configuration.nearestBeacon = BINearestBeaconTrackerConfigurationMakeDefault();
+    configuration.coalescingTimeout = 0.5;
+    configuration.maximumPendingDeliveries = 4;
+    configuration.synchronous = false;
+    configuration.metrics = nullptr;
+    configuration.spatialIndex = nullptr;
+    return configuration;
+}
+
+BIRangingPipelineRef BIRangingPipelineCreate(const BIRangingPipelineConfiguration *configuration, BIDeliveryQueue deliveryQueue,
+                                             BIRangingBatchHandler handler, void *context)
+{
+    return new BIRangingPipeline(configuration ? *configuration : BIRangingPipelineConfigurationMakeDefault(), deliveryQueue,
+                                 handler, context);
+}
+
+void BIRangingPipelineDestroy(BIRangingPipelineRef pipeline)
+{
+    delete pipeline;
+}
+
+uint32_t BIRangingPipelineAddRegion(BIRangingPipelineRef pipeline)
+{
+    return BIRangingPipelineAddRegionWithSmoothing(pipeline, nullptr);
+}
+
+uint32_t BIRangingPipelineAddRegionWithSmoothing(BIRangingPipelineRef pipeline, const BISmoothingConfiguration *smoothing)
+{
+    return pipeline->pipeline.addRegion(smoothing ? *smoothing : pipeline->configuration.smoothing);
+}
+
+void BIRangingPipelineRemoveRegion(BIRangingPipelineRef pipeline, uint32_t regionID)
+{
+    pipeline->pipeline.removeRegion(regionID);
+}
+
+void BIRangingPipelineSubmit(BIRangingPipelineRef pipeline, uint32_t regionID, double timestamp, const BIBeaconSample *samples,
+                             size_t count)
+{
+    pipeline->pipeline.submit(regionID, timestamp, samples, count);
+}
+
+void BIRangingPipelineFlush(BIRangingPipelineRef pipeline)
+{
+    pipeline->pipeline.flush();
+}
+
+void BIRangingPipelineWaitUntilIdle(BIRangingPipelineRef pipeline)
+{
+    pipeline->pipeline.waitUntilIdle();
+}
+
+BIRangingPipelineStatistics BIRangingPipelineGetStatistics(BIRangingPipelineRef pipeline)
+{
+    return pipeline->pipeline.statistics();
+}
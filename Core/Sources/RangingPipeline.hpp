@@ -0,0 +1,124 @@
+//
+//  RangingPipeline.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIRangingPipeline.h>
+
+#include "BeaconTable.hpp"
+#include "Metrics.hpp"
+#include "NearestBeaconTracker.hpp"
+#include "SmoothingEngine.hpp"
+#include "SpatialIndex.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bi {
+
+class RangingPipeline {
+public:
+    RangingPipeline(const BIRangingPipelineConfiguration &configuration, BIDeliveryQueue deliveryQueue,
+                    BIRangingBatchHandler handler, void *context);
+    ~RangingPipeline();
+
+    RangingPipeline(const RangingPipeline &) = delete;
+    RangingPipeline &operator=(const RangingPipeline &) = delete;
+
+    uint32_t addRegion(const BISmoothingConfiguration &smoothing);
+    void removeRegion(uint32_t regionID);
+    void submit(uint32_t regionID, double timestamp, const BIBeaconSample *samples, size_t count);
+    void flush();
+    void waitUntilIdle();
+    BIRangingPipelineStatistics statistics() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Report {
+        uint32_t regionID;
+        double timestamp;
+        size_t firstSample;
+        size_t sampleCount;
+    };
+
+    // Reports of all regions for one ranging tick. Ticks are recycled, so their vectors stop allocating once warm.
+    struct Tick {
+        uint64_t serial = 0;
+        Clock::time_point opened;
+        std::vector<Report> reports;
+        std::vector<BIBeaconSample> samples;
+        std::vector<std::pair<uint32_t, BISmoothingConfiguration>> addedRegions;
+        std::vector<uint32_t> removedRegions;
+
+        bool empty() const { return reports.empty() && addedRegions.empty() && removedRegions.empty(); }
+    };
+
+    struct RegionState {
+        std::unique_ptr<SmoothingEngine> engine;
+        std::unique_ptr<NearestBeaconTracker> nearestBeacon;
+        BIBeaconHandle reportedNearest = BIBeaconHandleInvalid;
+        uint32_t reportedNearestGeneration = 0;
+    };
+
+    struct Batch;
+    struct DeliveryState;
+
+    static void performDelivery(void *context);
+
+    void closeOpenTickLocked();
+    std::unique_ptr<Tick> makeTickLocked();
+    void runWorker();
+    void processClosedTicks(std::unique_lock<std::mutex> &lock);
+    void processTick(const Tick &tick);
+    void recordTick(const Tick &tick, Clock::time_point started, Clock::time_point smoothed, Clock::time_point selected,
+                    double timestamp);
+    void fillBatch(Batch &batch, const Tick &tick, double timestamp);
+    void flushMetricsBatches();
+
+    BIRangingPipelineConfiguration _configuration;
+    Metrics *_metrics;
+    const SpatialIndex *_spatialIndex; // not owned
+    BIDeliveryQueue _deliveryQueue;
+    std::shared_ptr<DeliveryState> _delivery;
+
+    // Submission side, guarded by _mutex.
+    mutable std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::condition_variable _idle;
+    std::unique_ptr<Tick> _openTick;
+    std::deque<std::unique_ptr<Tick>> _closedTicks;
+    std::vector<std::unique_ptr<Tick>> _freeTicks;
+    std::unordered_map<uint32_t, uint64_t> _lastReportedTickByRegion; // active regions
+    size_t _regionsReportedInOpenTick = 0;
+    uint32_t _nextRegionID = 1;
+    uint64_t _nextTickSerial = 1;
+    bool _processing = false;
+    bool _stopping = false;
+
+    // Worker side. Only touched by the worker thread (or the submitting thread in synchronous mode).
+    BeaconTable _beaconTable;
+    std::unordered_map<uint32_t, RegionState> _regions;
+    std::vector<uint32_t> _reportedRegions;
+    double _nextEviction = 0.0;
+    uint64_t _batchSequenceNumber = 0;
+    MetricsBatch _metricsBatch; // the stages up to the delivery
+
+    std::atomic<uint64_t> _ticksProcessed{0};
+    std::atomic<uint64_t> _batchesDropped{0};
+    std::thread _worker;
+};
+
+} // namespace bi
@@ -0,0 +1,285 @@
+//
+//  RegionMonitor.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "RegionMonitor.hpp"
+
+#include <algorithm>
+
+namespace bi {
+
+RegionMonitor::RegionMonitor(const BIRegionMonitorConfiguration &configuration, BIRegionTransitionHandler handler, void *context)
+    : _configuration(configuration)
+    , _metrics(unwrapMetrics(configuration.metrics))
+    , _handler(handler)
+    , _context(context)
+    , _timers(configuration.timerResolution, configuration.timerSlots)
+{
+}
+
+uint32_t RegionMonitor::addRegion()
+{
+    uint32_t slot;
+    if (_freeSlots.empty()) {
+        slot = uint32_t(_regions.size());
+        _regions.emplace_back();
+    } else {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+        _regions[slot] = Region();
+    }
+    uint32_t regionID = _nextID++;
+    _regions[slot].id = regionID;
+    _slotsByID[regionID] = slot;
+    return regionID;
+}
+
+void RegionMonitor::removeRegion(uint32_t regionID)
+{
+    auto it = _slotsByID.find(regionID);
+    if (it == _slotsByID.end()) {
+        return;
+    }
+    _timers.cancel(it->second);
+    _regions[it->second].id = 0;
+    _freeSlots.push_back(it->second);
+    _slotsByID.erase(it);
+}
+
+void RegionMonitor::count(Region &region, uint64_t BIRegionMonitorStatistics::*counter)
+{
+    region.statistics.*counter += 1;
+    _totals.*counter += 1;
+}
+
+void RegionMonitor::reportEvent(uint32_t regionID, double timestamp, BIRegionEvent event)
+{
+    advance(timestamp);
+    if (_metrics != nullptr) {
+        _metrics->increment(BIMetricsCounterRegionEvents);
+    }
+    auto it = _slotsByID.find(regionID);
+    if (it == _slotsByID.end()) {
+        return;
+    }
+    Region &region = _regions[it->second];
+    switch (event) {
+    case BIRegionEventEnter:
+    case BIRegionEventStateInside:
+        if (region.state == BIRegionStateInside && region.pending == Pending::None) {
+            count(region, &BIRegionMonitorStatistics::duplicateEnters);
+            return;
+        }
+        inside(it->second, timestamp, true);
+        return;
+    case BIRegionEventExit:
+    case BIRegionEventStateOutside:
+        outside(it->second, timestamp, true);
+        return;
+    case BIRegionEventStateUnknown:
+        return;
+    }
+}
+
+void RegionMonitor::reportRanging(uint32_t regionID, double timestamp, size_t beaconsInRange)
+{
+    advance(timestamp);
+    auto it = _slotsByID.find(regionID);
+    if (it == _slotsByID.end()) {
+        return;
+    }
+    Region &region = _regions[it->second];
+    if (beaconsInRange == 0) {
+        outside(it->second, timestamp, false);
+        return;
+    }
+    if (region.streak > 0 && timestamp - region.lastRangedInside > _configuration.exitGracePeriod) {
+        region.streak = 0;
+    }
+    region.streak++;
+    region.lastRangedInside = timestamp;
+    inside(it->second, timestamp, region.streak >= _configuration.enterConfidence);
+}
+
+double RegionMonitor::earliestTransition(const Region &region, double timestamp) const
+{
+    if (!region.hasTransitioned) {
+        return timestamp;
+    }
+    return std::max(timestamp, region.lastTransition + _configuration.minimumDwell);
+}
+
+void RegionMonitor::inside(uint32_t slot, double timestamp, bool confirmed)
+{
+    Region &region = _regions[slot];
+    if (region.state == BIRegionStateInside) {
+        if (region.pending == Pending::Exit) {
+            _timers.cancel(slot);
+            region.pending = Pending::None;
+            count(region, &BIRegionMonitorStatistics::suppressedExits);
+        }
+        return;
+    }
+    if (region.pending == Pending::Enter || !confirmed) {
+        return;
+    }
+
+    region.pending = Pending::Enter;
+    double due = earliestTransition(region, timestamp);
+    if (due <= timestamp) {
+        fire(slot, timestamp);
+    } else {
+        _timers.schedule(slot, due);
+    }
+}
+
+void RegionMonitor::outside(uint32_t slot, double timestamp, bool fromMonitoring)
+{
+    Region &region = _regions[slot];
+    region.streak = 0;
+    if (region.state == BIRegionStateInside) {
+        if (region.pending == Pending::Exit) {
+            if (fromMonitoring) {
+                count(region, &BIRegionMonitorStatistics::duplicateExits);
+            }
+            return;
+        }
+        region.pending = Pending::Exit;
+        _timers.schedule(slot, earliestTransition(region, timestamp + _configuration.exitGracePeriod));
+        return;
+    }
+
+    if (region.pending == Pending::Enter) {
+        _timers.cancel(slot);
+        region.pending = Pending::None;
+        count(region, &BIRegionMonitorStatistics::suppressedEnters);
+    } else if (fromMonitoring && region.state == BIRegionStateOutside) {
+        count(region, &BIRegionMonitorStatistics::duplicateExits);
+    }
+    // Leaving the unknown state towards outside is not a transition anybody waits for.
+    region.state = BIRegionStateOutside;
+}
+
+void RegionMonitor::fire(uint32_t slot, double timestamp)
+{
+    Region &region = _regions[slot];
+    BIRegionTransition transition;
+    if (region.pending == Pending::Enter) {
+        region.state = BIRegionStateInside;
+        transition = BIRegionTransitionEnter;
+        count(region, &BIRegionMonitorStatistics::enters);
+    } else if (region.pending == Pending::Exit) {
+        region.state = BIRegionStateOutside;
+        transition = BIRegionTransitionExit;
+        count(region, &BIRegionMonitorStatistics::exits);
+    } else {
+        return;
+    }
+    region.pending = Pending::None;
+    region.lastTransition = timestamp;
+    region.hasTransitioned = true;
+    if (_metrics != nullptr) {
+        _metrics->increment(BIMetricsCounterRegionTransitions);
+    }
+    if (_handler != nullptr) {
+        _handler(region.id, transition, timestamp, _context);
+    }
+}
+
+void RegionMonitor::advance(double timestamp)
+{
+    _timers.advance(timestamp, [this](uint32_t slot, double deadline) { fire(slot, deadline); });
+}
+
+BIRegionState RegionMonitor::state(uint32_t regionID) const
+{
+    auto it = _slotsByID.find(regionID);
+    return it == _slotsByID.end() ? BIRegionStateUnknown : _regions[it->second].state;
+}
+
+BIRegionMonitorStatistics RegionMonitor::statistics(uint32_t regionID) const
+{
+    if (regionID == 0) {
+        return _totals;
+    }
+    auto it = _slotsByID.find(regionID);
+    return it == _slotsByID.end() ? BIRegionMonitorStatistics() : _regions[it->second].statistics;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIRegionMonitor {
+    BIRegionMonitor(const BIRegionMonitorConfiguration &configuration, BIRegionTransitionHandler handler, void *context)
+        : monitor(configuration, handler, context)
+    {
+    }
+    bi::RegionMonitor monitor;
+};
+
+BIRegionMonitorConfiguration BIRegionMonitorConfigurationMakeDefault(void)
+{
+    BIRegionMonitorConfiguration configuration;
+    configuration.enterConfidence = 3;
+    configuration.exitGracePeriod = 30.0;
+    configuration.minimumDwell = 10.0;
+    configuration.timerResolution = 0.5;
+    configuration.timerSlots = 512;
+    configuration.metrics = nullptr;
+    return configuration;
+}
+
+BIRegionMonitorRef BIRegionMonitorCreate(const BIRegionMonitorConfiguration *configuration, BIRegionTransitionHandler handler,
+                                         void *context)
+{
+    return new BIRegionMonitor(configuration ? *configuration : BIRegionMonitorConfigurationMakeDefault(), handler, context);
+}
+
+void BIRegionMonitorDestroy(BIRegionMonitorRef monitor)
+{
+    delete monitor;
+}
+
+uint32_t BIRegionMonitorAddRegion(BIRegionMonitorRef monitor)
+{
+    return monitor->monitor.addRegion();
+}
+
+void BIRegionMonitorRemoveRegion(BIRegionMonitorRef monitor, uint32_t regionID)
+{
+    monitor->monitor.removeRegion(regionID);
+}
+
+void BIRegionMonitorReportEvent(BIRegionMonitorRef monitor, uint32_t regionID, double timestamp, BIRegionEvent event)
+{
+    monitor->monitor.reportEvent(regionID, timestamp, event);
+}
+
+void BIRegionMonitorReportRanging(BIRegionMonitorRef monitor, uint32_t regionID, double timestamp, size_t beaconsInRange)
+{
+    monitor->monitor.reportRanging(regionID, timestamp, beaconsInRange);
+}
+
+void BIRegionMonitorAdvance(BIRegionMonitorRef monitor, double timestamp)
+{
+    monitor->monitor.advance(timestamp);
+}
+
+BIRegionState BIRegionMonitorGetState(BIRegionMonitorRef monitor, uint32_t regionID)
+{
+    return monitor->monitor.state(regionID);
+}
+
+BIRegionMonitorStatistics BIRegionMonitorGetStatistics(BIRegionMonitorRef monitor, uint32_t regionID)
+{
+    return monitor->monitor.statistics(regionID);
+}
+
+size_t BIRegionMonitorGetPendingCount(BIRegionMonitorRef monitor)
+{
+    return monitor->monitor.pendingCount();
+}
@@ -0,0 +1,69 @@
+//
+//  RegionMonitor.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIRegionMonitor.h>
+
+#include "Metrics.hpp"
+#include "TimerWheel.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Regions live in a dense vector; a region's slot index doubles as its timer ID in the wheel. Each region has at most
+// one pending transition (an enter waiting for the minimum dwell, or an exit waiting for the grace period).
+class RegionMonitor {
+public:
+    RegionMonitor(const BIRegionMonitorConfiguration &configuration, BIRegionTransitionHandler handler, void *context);
+
+    uint32_t addRegion();
+    void removeRegion(uint32_t regionID);
+    void reportEvent(uint32_t regionID, double timestamp, BIRegionEvent event);
+    void reportRanging(uint32_t regionID, double timestamp, size_t beaconsInRange);
+    void advance(double timestamp);
+
+    BIRegionState state(uint32_t regionID) const;
+    BIRegionMonitorStatistics statistics(uint32_t regionID) const;
+    size_t pendingCount() const { return _timers.count(); }
+
+private:
+    enum class Pending : uint8_t { None, Enter, Exit };
+
+    struct Region {
+        uint32_t id = 0; // 0 for unused slots
+        BIRegionState state = BIRegionStateUnknown;
+        Pending pending = Pending::None;
+        uint32_t streak = 0; // consecutive ranging reports with beacons in range
+        double lastRangedInside = 0.0;
+        double lastTransition = 0.0;
+        bool hasTransitioned = false;
+        BIRegionMonitorStatistics statistics = {};
+    };
+
+    void count(Region &region, uint64_t BIRegionMonitorStatistics::*counter);
+    void inside(uint32_t slot, double timestamp, bool confirmed);
+    void outside(uint32_t slot, double timestamp, bool fromMonitoring);
+    void fire(uint32_t slot, double timestamp);
+    double earliestTransition(const Region &region, double timestamp) const;
+
+    BIRegionMonitorConfiguration _configuration;
+    Metrics *_metrics;
+    BIRegionTransitionHandler _handler;
+    void *_context;
+
+    std::vector<Region> _regions;
+    std::vector<uint32_t> _freeSlots;
+    std::unordered_map<uint32_t, uint32_t> _slotsByID;
+    uint32_t _nextID = 1;
+    TimerWheel _timers;
+    BIRegionMonitorStatistics _totals = {};
+};
+
+} // namespace bi
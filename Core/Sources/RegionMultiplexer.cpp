@@ -0,0 +1,451 @@
+//
+//  RegionMultiplexer.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "RegionMultiplexer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bi {
+
+namespace {
+
+// Weight of something that happened elapsed seconds ago.
+double decay(double elapsed, double halfLife)
+{
+    if (elapsed <= 0.0) {
+        return 1.0;
+    }
+    return halfLife > 0.0 ? std::exp2(-elapsed / halfLife) : 0.0;
+}
+
+bool sameUUID(const BIBeaconKey &lhs, const BIBeaconKey &rhs)
+{
+    return std::memcmp(lhs.proximityUUID, rhs.proximityUUID, sizeof(lhs.proximityUUID)) == 0;
+}
+
+} // namespace
+
+RegionMultiplexer::RegionMultiplexer(const BIRegionMultiplexerConfiguration &configuration,
+                                     BIPhysicalRegionHandler physicalRegionHandler, BILogicalRegionEventHandler eventHandler,
+                                     void *context)
+    : _configuration(configuration)
+    , _physicalRegionHandler(physicalRegionHandler)
+    , _eventHandler(eventHandler)
+    , _context(context)
+{
+}
+
+BIBeaconKey RegionMultiplexer::indexKey(const BIBeaconKey &key, BIBeaconRegionScope scope)
+{
+    BIBeaconKey result = key;
+    if (scope != BIBeaconRegionScopeMinor) {
+        result.minor = 0;
+    }
+    if (scope == BIBeaconRegionScopeUUID) {
+        result.major = 0;
+    }
+    return result;
+}
+
+uint32_t RegionMultiplexer::addRegion(const BIBeaconRegionDefinition &definition, double priority)
+{
+    uint32_t slot;
+    if (_freeSlots.empty()) {
+        slot = uint32_t(_regions.size());
+        _regions.emplace_back();
+    } else {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+        _regions[slot] = Region();
+    }
+    Region &region = _regions[slot];
+    region.id = _nextID++;
+    region.definition = definition;
+    region.definition.key = indexKey(definition.key, definition.scope);
+    region.priority = priority;
+    _slotsByID[region.id] = slot;
+    _index[definition.scope][region.definition.key].push_back(slot);
+    return region.id;
+}
+
+void RegionMultiplexer::removeRegion(uint32_t logicalRegionID)
+{
+    auto it = _slotsByID.find(logicalRegionID);
+    if (it == _slotsByID.end()) {
+        return;
+    }
+    uint32_t slot = it->second;
+    Region &region = _regions[slot];
+    auto entry = _index[region.definition.scope].find(region.definition.key);
+    std::vector<uint32_t> &slots = entry->second;
+    slots.erase(std::find(slots.begin(), slots.end(), slot));
+    if (slots.empty()) {
+        _index[region.definition.scope].erase(entry);
+    }
+    auto inside = std::find(_insideSlots.begin(), _insideSlots.end(), slot);
+    if (inside != _insideSlots.end()) {
+        *inside = _insideSlots.back();
+        _insideSlots.pop_back();
+    }
+    region.id = 0;
+    _freeSlots.push_back(slot);
+    _slotsByID.erase(it);
+}
+
+void RegionMultiplexer::setInside(uint32_t slot, double timestamp, bool inside)
+{
+    Region &region = _regions[slot];
+    if (region.inside == inside) {
+        return;
+    }
+    region.inside = inside;
+    region.activeAt = timestamp;
+    if (inside) {
+        _insideSlots.push_back(slot);
+        _statistics.enters++;
+    } else {
+        auto it = std::find(_insideSlots.begin(), _insideSlots.end(), slot);
+        *it = _insideSlots.back();
+        _insideSlots.pop_back();
+        _statistics.exits++;
+    }
+    if (_eventHandler != nullptr) {
+        _eventHandler(region.id, inside ? BIRegionEventEnter : BIRegionEventExit, timestamp, _context);
+    }
+}
+
+const RegionMultiplexer::Registration *RegionMultiplexer::registration(uint32_t physicalRegionID) const
+{
+    for (const Registration &registration : _registrations) {
+        if (registration.region.physicalRegionID == physicalRegionID) {
+            return &registration;
+        }
+    }
+    return nullptr;
+}
+
+bool RegionMultiplexer::isRangedByWildcard(const BIBeaconKey &key) const
+{
+    for (const Registration &registration : _registrations) {
+        if (registration.region.logicalRegionID == 0 && sameUUID(registration.region.definition.key, key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RegionMultiplexer::reportEvent(uint32_t physicalRegionID, double timestamp, BIRegionEvent event)
+{
+    const Registration *registration = this->registration(physicalRegionID);
+    if (registration == nullptr) {
+        return; // stopped monitoring in the meantime
+    }
+    bool inside = (event == BIRegionEventEnter || event == BIRegionEventStateInside);
+    if (!inside && event != BIRegionEventExit && event != BIRegionEventStateOutside) {
+        return;
+    }
+
+    if (registration->region.logicalRegionID != 0) {
+        auto it = _slotsByID.find(registration->region.logicalRegionID);
+        if (it != _slotsByID.end()) {
+            setInside(it->second, timestamp, inside);
+        }
+        return;
+    }
+
+    // A wildcard region stands for the logical regions with just its UUID. Entering it says nothing about the other
+    // regions with that UUID (ranging will tell), but leaving it means none of their beacons is in range any more.
+    BIBeaconKey key = registration->region.definition.key;
+    if (inside) {
+        auto it = _index[BIBeaconRegionScopeUUID].find(key);
+        if (it != _index[BIBeaconRegionScopeUUID].end()) {
+            for (uint32_t slot : it->second) {
+                setInside(slot, timestamp, true);
+            }
+        }
+        return;
+    }
+    for (size_t i = _insideSlots.size(); i-- > 0;) {
+        if (sameUUID(_regions[_insideSlots[i]].definition.key, key)) {
+            setInside(_insideSlots[i], timestamp, false);
+        }
+    }
+}
+
+void RegionMultiplexer::reportRanging(double timestamp, const BIBeaconSample *samples, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const BIBeaconSample &sample = samples[i];
+        if (sample.RSSI == 0) {
+            continue; // CLBeacon reports RSSI 0 for beacons that were just lost
+        }
+        bool matched = false;
+        for (int scope = BIBeaconRegionScopeUUID; scope <= BIBeaconRegionScopeMinor; scope++) {
+            auto it = _index[scope].find(indexKey(sample.key, BIBeaconRegionScope(scope)));
+            if (it == _index[scope].end()) {
+                continue;
+            }
+            matched = true;
+            for (uint32_t slot : it->second) {
+                Region &region = _regions[slot];
+                if (region.rangedAt != timestamp || sample.RSSI > region.rangedRSSI) {
+                    region.rangedRSSI = sample.RSSI;
+                }
+                region.rangedAt = timestamp;
+                setInside(slot, timestamp, true);
+            }
+        }
+        _statistics.demultiplexedBeacons += matched ? 1 : 0;
+    }
+
+    // Regions without a specific physical region learn about exits from ranging only.
+    for (size_t i = _insideSlots.size(); i-- > 0;) {
+        const Region &region = _regions[_insideSlots[i]];
+        if (region.physicalRegionID == 0 && isRangedByWildcard(region.definition.key) &&
+            timestamp - std::max(region.rangedAt, region.activeAt) > _configuration.rangingExitTimeout) {
+            setInside(_insideSlots[i], timestamp, false);
+        }
+    }
+}
+
+double RegionMultiplexer::score(const Region &region, double timestamp) const
+{
+    double proximity = std::min(std::max((double(region.rangedRSSI) + 100.0) / 60.0, 0.0), 1.0);
+    return region.priority + proximity * decay(timestamp - region.rangedAt, _configuration.proximityHalfLife) +
+           decay(timestamp - region.activeAt, _configuration.activityHalfLife);
+}
+
+double RegionMultiplexer::candidateScore(double score, const Registration *registration, double timestamp) const
+{
+    if (registration == nullptr) {
+        return score;
+    }
+    if (timestamp - registration->registeredAt < _configuration.minimumRegistration) {
+        return HUGE_VAL;
+    }
+    return score + _configuration.swapMargin;
+}
+
+void RegionMultiplexer::select(std::vector<Candidate> &candidates, size_t count)
+{
+    count = std::min(count, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                      [](const Candidate &lhs, const Candidate &rhs) {
+                          return lhs.score != rhs.score ? lhs.score > rhs.score : lhs.slot < rhs.slot;
+                      });
+    candidates.resize(count);
+}
+
+size_t RegionMultiplexer::evaluate(double timestamp)
+{
+    // One wildcard candidate per UUID, as good as the best of its logical regions.
+    _wildcards.clear();
+    for (uint32_t slot = 0; slot < _regions.size(); slot++) {
+        const Region &region = _regions[slot];
+        if (region.id == 0) {
+            continue;
+        }
+        double regionScore = score(region, timestamp);
+        auto it = std::find_if(_wildcards.begin(), _wildcards.end(), [&](const Candidate &candidate) {
+            return sameUUID(candidate.definition.key, region.definition.key);
+        });
+        if (it == _wildcards.end()) {
+            Candidate candidate;
+            candidate.score = regionScore;
+            candidate.slot = slot;
+            candidate.definition.key = indexKey(region.definition.key, BIBeaconRegionScopeUUID);
+            candidate.definition.scope = BIBeaconRegionScopeUUID;
+            _wildcards.push_back(candidate);
+        } else {
+            it->score = std::max(it->score, regionScore);
+        }
+    }
+    for (Candidate &candidate : _wildcards) {
+        const Registration *registered = nullptr;
+        for (const Registration &registration : _registrations) {
+            if (registration.region.logicalRegionID == 0 && sameUUID(registration.region.definition.key, candidate.definition.key)) {
+                registered = &registration;
+            }
+        }
+        candidate.score = candidateScore(candidate.score, registered, timestamp);
+    }
+    uint32_t wildcardCount = std::min(_configuration.wildcardRegions, _configuration.maximumRegions);
+    select(_wildcards, wildcardCount);
+
+    // Logical regions with just a UUID are served by their wildcard region if it gets registered.
+    _candidates.clear();
+    for (uint32_t slot = 0; slot < _regions.size(); slot++) {
+        const Region &region = _regions[slot];
+        if (region.id == 0) {
+            continue;
+        }
+        if (region.definition.scope == BIBeaconRegionScopeUUID &&
+            std::any_of(_wildcards.begin(), _wildcards.end(), [&](const Candidate &candidate) {
+                return sameUUID(candidate.definition.key, region.definition.key);
+            })) {
+            continue;
+        }
+        Candidate candidate;
+        candidate.score = candidateScore(score(region, timestamp), registration(region.physicalRegionID), timestamp);
+        candidate.slot = slot;
+        candidate.definition = region.definition;
+        _candidates.push_back(candidate);
+    }
+    select(_candidates, _configuration.maximumRegions - _wildcards.size());
+
+    // Stop monitoring first, so that the number of registered regions never exceeds the limit.
+    size_t changes = 0;
+    for (size_t i = _registrations.size(); i-- > 0;) {
+        const BIPhysicalRegion &region = _registrations[i].region;
+        bool keep;
+        if (region.logicalRegionID == 0) {
+            keep = std::any_of(_wildcards.begin(), _wildcards.end(), [&](const Candidate &candidate) {
+                return sameUUID(candidate.definition.key, region.definition.key);
+            });
+        } else {
+            keep = std::any_of(_candidates.begin(), _candidates.end(), [&](const Candidate &candidate) {
+                return _regions[candidate.slot].physicalRegionID == region.physicalRegionID;
+            });
+            auto it = _slotsByID.find(region.logicalRegionID);
+            if (!keep && it != _slotsByID.end()) {
+                _regions[it->second].physicalRegionID = 0;
+            }
+        }
+        if (keep) {
+            continue;
+        }
+        BIPhysicalRegion stopped = region;
+        _registrations.erase(_registrations.begin() + i);
+        _statistics.unregistrations++;
+        changes++;
+        if (_physicalRegionHandler != nullptr) {
+            _physicalRegionHandler(&stopped, false, _context);
+        }
+    }
+
+    auto start = [&](uint32_t logicalRegionID, const BIBeaconRegionDefinition &definition) {
+        Registration registration;
+        registration.region.physicalRegionID = _nextPhysicalID++;
+        registration.region.logicalRegionID = logicalRegionID;
+        registration.region.definition = definition;
+        registration.registeredAt = timestamp;
+        _registrations.push_back(registration);
+        _statistics.registrations++;
+        changes++;
+        if (_physicalRegionHandler != nullptr) {
+            _physicalRegionHandler(&registration.region, true, _context);
+        }
+        return registration.region.physicalRegionID;
+    };
+    for (const Candidate &candidate : _wildcards) {
+        if (!isRangedByWildcard(candidate.definition.key)) {
+            start(0, candidate.definition);
+        }
+    }
+    for (const Candidate &candidate : _candidates) {
+        Region &region = _regions[candidate.slot];
+        if (region.physicalRegionID == 0) {
+            region.physicalRegionID = start(region.id, region.definition);
+        }
+    }
+    return changes;
+}
+
+bool RegionMultiplexer::isInside(uint32_t logicalRegionID) const
+{
+    auto it = _slotsByID.find(logicalRegionID);
+    return it != _slotsByID.end() && _regions[it->second].inside;
+}
+
+uint32_t RegionMultiplexer::physicalRegion(uint32_t logicalRegionID) const
+{
+    auto it = _slotsByID.find(logicalRegionID);
+    return it == _slotsByID.end() ? 0 : _regions[it->second].physicalRegionID;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIRegionMultiplexer {
+    BIRegionMultiplexer(const BIRegionMultiplexerConfiguration &configuration, BIPhysicalRegionHandler physicalRegionHandler,
+                        BILogicalRegionEventHandler eventHandler, void *context)
+        : multiplexer(configuration, physicalRegionHandler, eventHandler, context)
+    {
+    }
+    bi::RegionMultiplexer multiplexer;
+};
+
+BIRegionMultiplexerConfiguration BIRegionMultiplexerConfigurationMakeDefault(void)
+{
+    BIRegionMultiplexerConfiguration configuration;
+    configuration.maximumRegions = 20;
+    configuration.wildcardRegions = 1;
+    configuration.proximityHalfLife = 120.0;
+    configuration.activityHalfLife = 600.0;
+    configuration.swapMargin = 0.1;
+    configuration.minimumRegistration = 30.0;
+    configuration.rangingExitTimeout = 30.0;
+    return configuration;
+}
+
+BIRegionMultiplexerRef BIRegionMultiplexerCreate(const BIRegionMultiplexerConfiguration *configuration,
+                                                 BIPhysicalRegionHandler physicalRegionHandler,
+                                                 BILogicalRegionEventHandler eventHandler, void *context)
+{
+    return new BIRegionMultiplexer(configuration ? *configuration : BIRegionMultiplexerConfigurationMakeDefault(),
+                                   physicalRegionHandler, eventHandler, context);
+}
+
+void BIRegionMultiplexerDestroy(BIRegionMultiplexerRef multiplexer)
+{
+    delete multiplexer;
+}
+
+uint32_t BIRegionMultiplexerAddRegion(BIRegionMultiplexerRef multiplexer, const BIBeaconRegionDefinition *definition,
+                                      double priority)
+{
+    return multiplexer->multiplexer.addRegion(*definition, priority);
+}
+
+void BIRegionMultiplexerRemoveRegion(BIRegionMultiplexerRef multiplexer, uint32_t logicalRegionID)
+{
+    multiplexer->multiplexer.removeRegion(logicalRegionID);
+}
+
+void BIRegionMultiplexerReportEvent(BIRegionMultiplexerRef multiplexer, uint32_t physicalRegionID, double timestamp,
+                                    BIRegionEvent event)
+{
+    multiplexer->multiplexer.reportEvent(physicalRegionID, timestamp, event);
+}
+
+void BIRegionMultiplexerReportRanging(BIRegionMultiplexerRef multiplexer, double timestamp, const BIBeaconSample *samples,
+                                      size_t count)
+{
+    multiplexer->multiplexer.reportRanging(timestamp, samples, count);
+}
+
+size_t BIRegionMultiplexerEvaluate(BIRegionMultiplexerRef multiplexer, double timestamp)
+{
+    return multiplexer->multiplexer.evaluate(timestamp);
+}
+
+bool BIRegionMultiplexerIsInside(BIRegionMultiplexerRef multiplexer, uint32_t logicalRegionID)
+{
+    return multiplexer->multiplexer.isInside(logicalRegionID);
+}
+
+uint32_t BIRegionMultiplexerGetPhysicalRegion(BIRegionMultiplexerRef multiplexer, uint32_t logicalRegionID)
+{
+    return multiplexer->multiplexer.physicalRegion(logicalRegionID);
+}
+
+BIRegionMultiplexerStatistics BIRegionMultiplexerGetStatistics(BIRegionMultiplexerRef multiplexer)
+{
+    return multiplexer->multiplexer.statistics();
+}
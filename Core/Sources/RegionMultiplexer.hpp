@@ -0,0 +1,91 @@
+//
+//  RegionMultiplexer.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIRegionMultiplexer.h>
+
+#include "BeaconKey.hpp"
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Logical regions live in a dense vector with a free list, like in RegionMonitor. Ranged beacons are demultiplexed
+// through one index per scope, keyed by the beacon key with the unspecified fields zeroed, so a sample costs three hash
+// lookups no matter how many logical regions there are. The registered physical regions are few (20 at most) and kept
+// in a plain vector.
+class RegionMultiplexer {
+public:
+    RegionMultiplexer(const BIRegionMultiplexerConfiguration &configuration, BIPhysicalRegionHandler physicalRegionHandler,
+                      BILogicalRegionEventHandler eventHandler, void *context);
+
+    uint32_t addRegion(const BIBeaconRegionDefinition &definition, double priority);
+    void removeRegion(uint32_t logicalRegionID);
+    void reportEvent(uint32_t physicalRegionID, double timestamp, BIRegionEvent event);
+    void reportRanging(double timestamp, const BIBeaconSample *samples, size_t count);
+    size_t evaluate(double timestamp);
+
+    bool isInside(uint32_t logicalRegionID) const;
+    uint32_t physicalRegion(uint32_t logicalRegionID) const;
+    const BIRegionMultiplexerStatistics &statistics() const { return _statistics; }
+
+private:
+    struct Region {
+        uint32_t id = 0; // 0 for unused slots
+        BIBeaconRegionDefinition definition;
+        double priority = 0.0;
+        bool inside = false;
+        double rangedAt = -HUGE_VAL;
+        int32_t rangedRSSI = 0; // strongest RSSI of the last tick that ranged one of the region's beacons
+        double activeAt = -HUGE_VAL;
+        uint32_t physicalRegionID = 0;
+    };
+
+    struct Registration {
+        BIPhysicalRegion region;
+        double registeredAt;
+    };
+
+    // A candidate for a physical region: a logical region slot, or a UUID (logicalRegionID 0) for wildcards.
+    struct Candidate {
+        double score;
+        uint32_t slot;
+        BIBeaconRegionDefinition definition;
+    };
+
+    static BIBeaconKey indexKey(const BIBeaconKey &key, BIBeaconRegionScope scope);
+    double score(const Region &region, double timestamp) const;
+    void setInside(uint32_t slot, double timestamp, bool inside);
+    bool isRangedByWildcard(const BIBeaconKey &key) const;
+    const Registration *registration(uint32_t physicalRegionID) const;
+    double candidateScore(double score, const Registration *registration, double timestamp) const;
+    void select(std::vector<Candidate> &candidates, size_t count);
+
+    BIRegionMultiplexerConfiguration _configuration;
+    BIPhysicalRegionHandler _physicalRegionHandler;
+    BILogicalRegionEventHandler _eventHandler;
+    void *_context;
+
+    std::vector<Region> _regions;
+    std::vector<uint32_t> _freeSlots;
+    std::unordered_map<uint32_t, uint32_t> _slotsByID;
+    std::unordered_map<BIBeaconKey, std::vector<uint32_t>, BeaconKeyHash> _index[3]; // by BIBeaconRegionScope
+    std::vector<uint32_t> _insideSlots;
+    uint32_t _nextID = 1;
+
+    std::vector<Registration> _registrations;
+    uint32_t _nextPhysicalID = 1;
+
+    std::vector<Candidate> _candidates; // scratch space for evaluate()
+    std::vector<Candidate> _wildcards;
+    BIRegionMultiplexerStatistics _statistics = {};
+};
+
+} // namespace bi
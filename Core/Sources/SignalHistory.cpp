@@ -0,0 +1,98 @@
+//
+//  SignalHistory.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "SignalHistory.hpp"
+
+#include <algorithm>
+
+namespace bi {
+
+SignalHistoryStore::SignalHistoryStore(uint32_t capacity)
+    : _capacity(std::max<uint32_t>(capacity, 1))
+{
+}
+
+uint32_t SignalHistoryStore::addSeries()
+{
+    uint32_t series = seriesCount();
+    if (series == _reservedSeries) {
+        _reservedSeries = std::max<uint32_t>(16, _reservedSeries * 2);
+        size_t slots = size_t(_reservedSeries) * _capacity;
+        _timestamps.resize(slots);
+        _RSSI.resize(slots);
+        _proximities.resize(slots);
+        _accuracies.resize(slots);
+        _inRange.resize((slots + 63) / 64);
+        _heads.reserve(_reservedSeries);
+        _counts.reserve(_reservedSeries);
+    }
+    _heads.push_back(0);
+    _counts.push_back(0);
+    return series;
+}
+
+void SignalHistoryStore::store(size_t slot, const BISignal &signal)
+{
+    _timestamps[slot] = signal.timestamp;
+    _RSSI[slot] = int16_t(std::min(std::max(signal.RSSI, minimumRSSI), maximumRSSI));
+    _proximities[slot] = int8_t(std::min(std::max(signal.proximity, minimumProximity), maximumProximity));
+    _accuracies[slot] = signal.accuracy;
+    uint64_t bit = uint64_t(1) << (slot & 63);
+    if (signal.inRange) {
+        _inRange[slot >> 6] |= bit;
+    } else {
+        _inRange[slot >> 6] &= ~bit;
+    }
+}
+
+BISignal SignalHistoryStore::signalAtSlot(size_t slot) const
+{
+    BISignal signal;
+    signal.timestamp = _timestamps[slot];
+    signal.RSSI = _RSSI[slot];
+    signal.proximity = _proximities[slot];
+    signal.accuracy = _accuracies[slot];
+    signal.inRange = testInRange(slot);
+    return signal;
+}
+
+void SignalHistoryStore::append(uint32_t series, const BISignal &signal)
+{
+    uint32_t head = _heads[series];
+    store(size_t(series) * _capacity + head, signal);
+    _heads[series] = (head + 1 == _capacity) ? 0 : head + 1;
+    if (_counts[series] < _capacity) {
+        _counts[series]++;
+    }
+}
+
+void SignalHistoryStore::replaceLast(uint32_t series, const BISignal &signal)
+{
+    store(slotFromNewest(series, 0), signal);
+}
+
+size_t SignalHistoryStore::copy(uint32_t series, BISignal *buffer, size_t capacity) const
+{
+    uint32_t count = _counts[series];
+    if (capacity == 0) {
+        return count;
+    }
+    uint32_t copied = uint32_t(std::min<size_t>(capacity, count));
+    for (uint32_t i = 0; i < copied; i++) {
+        buffer[i] = fromNewest(series, copied - 1 - i);
+    }
+    return copied;
+}
+
+size_t SignalHistoryStore::storageSize() const
+{
+    return _timestamps.capacity() * sizeof(double) + _RSSI.capacity() * sizeof(int16_t) +
+           _proximities.capacity() * sizeof(int8_t) + _accuracies.capacity() * sizeof(double) +
+           _inRange.capacity() * sizeof(uint64_t) + (_heads.capacity() + _counts.capacity()) * sizeof(uint32_t);
+}
+
+} // namespace bi
@@ -0,0 +1,91 @@
+//
+//  SignalHistory.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BICoreTypes.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace bi {
+
+// Fixed-capacity signal histories for many beacons, stored as a struct of arrays. Each beacon owns one series: a ring
+// buffer of `capacity` slots inside flat per-field arrays (timestamp, RSSI, proximity, accuracy and an in-range
+// bitset). Storage only grows when a series is added; appending to a series never allocates.
+//
+// RSSIs are stored in 16 bits and proximities in 8 bits. Values outside minimumRSSI ... maximumRSSI and
+// minimumProximity ... maximumProximity are clamped to the nearest bound when they are stored, so a signal read back
+// may differ from the one appended only in those fields and only for values no beacon reports.
+class SignalHistoryStore {
+public:
+    static constexpr int32_t minimumRSSI = INT16_MIN;
+    static constexpr int32_t maximumRSSI = INT16_MAX;
+    static constexpr int32_t minimumProximity = INT8_MIN;
+    static constexpr int32_t maximumProximity = INT8_MAX;
+
+    explicit SignalHistoryStore(uint32_t capacity);
+
+    uint32_t capacity() const { return _capacity; }
+    uint32_t seriesCount() const { return uint32_t(_counts.size()); }
+
+    // Adds an empty series and returns its index.
+    uint32_t addSeries();
+
+    // Empties a series without releasing its storage, so that it can be reused for another beacon.
+    void clearSeries(uint32_t series) { _heads[series] = 0; _counts[series] = 0; }
+
+    void append(uint32_t series, const BISignal &signal);
+
+    // Overwrites the most recent signal of a non-empty series.
+    void replaceLast(uint32_t series, const BISignal &signal);
+
+    uint32_t size(uint32_t series) const { return _counts[series]; }
+    bool empty(uint32_t series) const { return _counts[series] == 0; }
+
+    // Index 0 is the most recent signal.
+    BISignal fromNewest(uint32_t series, uint32_t index) const { return signalAtSlot(slotFromNewest(series, index)); }
+    BISignal last(uint32_t series) const { return fromNewest(series, 0); }
+
+    double timestampFromNewest(uint32_t series, uint32_t index) const { return _timestamps[slotFromNewest(series, index)]; }
+    int32_t RSSIFromNewest(uint32_t series, uint32_t index) const { return _RSSI[slotFromNewest(series, index)]; }
+    double accuracyFromNewest(uint32_t series, uint32_t index) const { return _accuracies[slotFromNewest(series, index)]; }
+    bool inRangeFromNewest(uint32_t series, uint32_t index) const { return testInRange(slotFromNewest(series, index)); }
+
+    // Copies up to `capacity` of the most recent signals, oldest first. Returns the number of signals copied, or the
+    // length of the series if capacity is 0.
+    size_t copy(uint32_t series, BISignal *buffer, size_t capacity) const;
+
+    // Bytes of signal storage currently reserved.
+    size_t storageSize() const;
+
+private:
+    size_t slotFromNewest(uint32_t series, uint32_t index) const
+    {
+        uint32_t position = _heads[series] + _capacity - 1 - index;
+        if (position >= _capacity) {
+            position -= _capacity;
+        }
+        return size_t(series) * _capacity + position;
+    }
+
+    bool testInRange(size_t slot) const { return (_inRange[slot >> 6] >> (slot & 63)) & 1; }
+    void store(size_t slot, const BISignal &signal);
+    BISignal signalAtSlot(size_t slot) const;
+
+    uint32_t _capacity;
+    uint32_t _reservedSeries = 0;
+    std::vector<double> _timestamps;
+    std::vector<int16_t> _RSSI;
+    std::vector<int8_t> _proximities;
+    std::vector<double> _accuracies;
+    std::vector<uint64_t> _inRange;
+    std::vector<uint32_t> _heads;
+    std::vector<uint32_t> _counts;
+};
+
+} // namespace bi
@@ -0,0 +1,275 @@
+//
+//  SmoothingEngine.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "SmoothingEngine.hpp"
+
+#include <algorithm>
+
+namespace bi {
+
+static bool smoothedSignalChanged(const BISignal &previous, const BISignal &current)
+{
+    if (previous.inRange != current.inRange) {
+        return true;
+    }
+    return current.inRange && (previous.RSSI != current.RSSI || previous.accuracy != current.accuracy);
+}
+
+SmoothingEngine::SmoothingEngine(const BISmoothingConfiguration &configuration, BeaconTable *table)
+    : _configuration(configuration)
+    , _table(table)
+    , _rawSignals(configuration.historyCapacity)
+    , _smoothedSignals(configuration.historyCapacity)
+{
+    _configuration.windowSize = std::max<uint32_t>(_configuration.windowSize, 1);
+    _configuration.historyCapacity = _rawSignals.capacity();
+    _filter = makeSmoothingFilter(_configuration);
+    if (_table == nullptr) {
+        _ownedTable.reset(new BeaconTable(BIBeaconTableConfigurationMakeDefault()));
+        _table = _ownedTable.get();
+    }
+}
+
+BIBeaconHandle SmoothingEngine::handleForKey(const BIBeaconKey &key) const
+{
+    BIBeaconHandle handle = _table->lookup(key);
+    return tracks(handle) ? handle : BIBeaconHandleInvalid;
+}
+
+SmoothingEngine::Beacon &SmoothingEngine::beginTracking(BIBeaconHandle handle)
+{
+    if (handle >= _beacons.size()) {
+        _beacons.resize(_table->handleLimit());
+    }
+    while (_rawSignals.seriesCount() <= handle) {
+        _rawSignals.addSeries();
+        _smoothedSignals.addSeries();
+        _filter->addSeries();
+    }
+
+    Beacon &beacon = _beacons[handle];
+    uint32_t generation = _table->generation(handle);
+    if (!beacon.tracked || beacon.generation != generation) {
+        // New beacon, or the handle was reused after the previous beacon got evicted.
+        if (!beacon.tracked) {
+            _trackedHandles.push_back(handle);
+        } else {
+            _droppedHandles.push_back(handle);
+        }
+        _rawSignals.clearSeries(handle);
+        _smoothedSignals.clearSeries(handle);
+        _filter->clearSeries(handle);
+        beacon.generation = generation;
+        beacon.lastSeenTick = 0;
+        beacon.tracked = true;
+    }
+    return beacon;
+}
+
+void SmoothingEngine::dropStaleBeacons()
+{
+    size_t kept = 0;
+    for (BIBeaconHandle handle : _trackedHandles) {
+        if (_table->isCurrent(handle, _beacons[handle].generation)) {
+            _trackedHandles[kept++] = handle;
+        } else {
+            _beacons[handle].tracked = false;
+            _droppedHandles.push_back(handle);
+        }
+    }
+    _trackedHandles.resize(kept);
+}
+
+void SmoothingEngine::processTick(double timestamp, const BIBeaconSample *samples, size_t count)
+{
+    _tick++;
+    _changedHandles.clear();
+    _droppedHandles.clear();
+
+    if (_ownedTable && timestamp >= _nextEviction) {
+        _table->evictIdle(timestamp);
+        _nextEviction = timestamp + _table->configuration().idleTimeout / 4.0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const BIBeaconSample &sample = samples[i];
+        BIBeaconHandle handle = _table->intern(sample.key, timestamp);
+        Beacon &beacon = beginTracking(handle);
+
+        BISignal signal;
+        signal.timestamp = timestamp;
+        signal.RSSI = sample.RSSI;
+        signal.proximity = sample.proximity;
+        signal.accuracy = sample.accuracy;
+        signal.inRange = true;
+
+        if (beacon.lastSeenTick == _tick) {
+            _rawSignals.replaceLast(handle, signal);
+        } else {
+            _rawSignals.append(handle, signal);
+            beacon.lastSeenTick = _tick;
+        }
+    }
+
+    // Interning may have evicted beacons from a full table, and a shared table may have evicted them at any time.
+    dropStaleBeacons();
+
+    for (BIBeaconHandle handle : _trackedHandles) {
+        if (_beacons[handle].lastSeenTick != _tick) {
+            _rawSignals.append(handle, BISignalMakeNotInRange(timestamp));
+        }
+        BISignal smoothed = _filter->update(_rawSignals, handle, timestamp);
+        if (_smoothedSignals.empty(handle) || smoothedSignalChanged(_smoothedSignals.last(handle), smoothed)) {
+            _changedHandles.push_back(handle);
+        }
+        _smoothedSignals.append(handle, smoothed);
+    }
+}
+
+BIBeaconHandle SmoothingEngine::restoreSample(double timestamp, const BIBeaconSample &sample)
+{
+    if (handleForKey(sample.key) != BIBeaconHandleInvalid) {
+        return BIBeaconHandleInvalid;
+    }
+    BIBeaconHandle handle = _table->intern(sample.key, timestamp);
+    beginTracking(handle);
+
+    // The sample counts as a raw signal of a tick of its own, which only this beacon took part in. lastSeenTick stays
+    // as it is, so the next tick appends the beacon's signal after it.
+    BISignal signal;
+    signal.timestamp = timestamp;
+    signal.RSSI = sample.RSSI;
+    signal.proximity = sample.proximity;
+    signal.accuracy = sample.accuracy;
+    signal.inRange = true;
+    _rawSignals.append(handle, signal);
+    _smoothedSignals.append(handle, _filter->update(_rawSignals, handle, timestamp));
+    return handle;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BISmoothingEngine {
+    BISmoothingEngine(const BISmoothingConfiguration &configuration, bi::BeaconTable *table) : engine(configuration, table) {}
+    bi::SmoothingEngine engine;
+};
+
+BISmoothingConfiguration BISmoothingConfigurationMakeDefault(void)
+{
+    BISmoothingConfiguration configuration;
+    configuration.filter = BISmoothingFilterWindowAverage;
+    configuration.windowSize = 5;
+    configuration.windowDuration = 5.0;
+    configuration.historyCapacity = 60;
+    configuration.halfLife = 2.0;
+    configuration.processNoise = 0.05;
+    configuration.measurementNoise = 25.0;
+    return configuration;
+}
+
+BISmoothingEngineRef BISmoothingEngineCreate(const BISmoothingConfiguration *configuration)
+{
+    return BISmoothingEngineCreateWithBeaconTable(configuration, nullptr);
+}
+
+BISmoothingEngineRef BISmoothingEngineCreateWithBeaconTable(const BISmoothingConfiguration *configuration, BIBeaconTableRef table)
+{
+    return new BISmoothingEngine(configuration ? *configuration : BISmoothingConfigurationMakeDefault(),
+                                 table ? bi::unwrapBeaconTable(table) : nullptr);
+}
+
+void BISmoothingEngineDestroy(BISmoothingEngineRef engine)
+{
+    delete engine;
+}
+
+void BISmoothingEngineProcessTick(BISmoothingEngineRef engine, double timestamp, const BIBeaconSample *samples, size_t count)
+{
+    engine->engine.processTick(timestamp, samples, count);
+}
+
+BIBeaconHandle BISmoothingEngineRestoreSample(BISmoothingEngineRef engine, double timestamp, const BIBeaconSample *sample)
+{
+    return engine->engine.restoreSample(timestamp, *sample);
+}
+
+size_t BISmoothingEngineGetBeaconCount(BISmoothingEngineRef engine)
+{
+    return engine->engine.beaconCount();
+}
+
+bool BISmoothingEngineGetBeaconKeyAtIndex(BISmoothingEngineRef engine, size_t index, BIBeaconKey *key)
+{
+    if (index >= engine->engine.beaconCount()) {
+        return false;
+    }
+    *key = engine->engine.beaconTable().key(engine->engine.handleAtIndex(index));
+    return true;
+}
+
+BIBeaconHandle BISmoothingEngineGetBeaconHandleAtIndex(BISmoothingEngineRef engine, size_t index)
+{
+    return (index < engine->engine.beaconCount()) ? engine->engine.handleAtIndex(index) : BIBeaconHandleInvalid;
+}
+
+bool BISmoothingEngineGetSmoothedSignalForHandle(BISmoothingEngineRef engine, BIBeaconHandle handle, BISignal *signal)
+{
+    if (!engine->engine.tracks(handle) || engine->engine.smoothedSignals().empty(handle)) {
+        return false;
+    }
+    *signal = engine->engine.smoothedSignals().last(handle);
+    return true;
+}
+
+bool BISmoothingEngineGetSmoothedSignal(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *signal)
+{
+    return BISmoothingEngineGetSmoothedSignalForHandle(engine, engine->engine.handleForKey(*key), signal);
+}
+
+bool BISmoothingEngineGetRawSignal(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *signal)
+{
+    BIBeaconHandle handle = engine->engine.handleForKey(*key);
+    if (handle == BIBeaconHandleInvalid || engine->engine.rawSignals().empty(handle)) {
+        return false;
+    }
+    *signal = engine->engine.rawSignals().last(handle);
+    return true;
+}
+
+size_t BISmoothingEngineCopySmoothedSignals(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *buffer, size_t capacity)
+{
+    BIBeaconHandle handle = engine->engine.handleForKey(*key);
+    return (handle != BIBeaconHandleInvalid) ? engine->engine.smoothedSignals().copy(handle, buffer, capacity) : 0;
+}
+
+size_t BISmoothingEngineCopyRawSignals(BISmoothingEngineRef engine, const BIBeaconKey *key, BISignal *buffer, size_t capacity)
+{
+    BIBeaconHandle handle = engine->engine.handleForKey(*key);
+    return (handle != BIBeaconHandleInvalid) ? engine->engine.rawSignals().copy(handle, buffer, capacity) : 0;
+}
+
+static size_t copyHandles(const std::vector<BIBeaconHandle> &source, BIBeaconHandle *handles, size_t capacity)
+{
+    if (capacity == 0) {
+        return source.size();
+    }
+    size_t count = std::min(capacity, source.size());
+    std::copy(source.begin(), source.begin() + std::ptrdiff_t(count), handles);
+    return count;
+}
+
+size_t BISmoothingEngineCopyChangedHandles(BISmoothingEngineRef engine, BIBeaconHandle *handles, size_t capacity)
+{
+    return copyHandles(engine->engine.changedHandles(), handles, capacity);
+}
+
+size_t BISmoothingEngineCopyDroppedHandles(BISmoothingEngineRef engine, BIBeaconHandle *handles, size_t capacity)
+{
+    return copyHandles(engine->engine.droppedHandles(), handles, capacity);
+}
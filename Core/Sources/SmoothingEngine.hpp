@@ -0,0 +1,75 @@
+//
+//  SmoothingEngine.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BISmoothingEngine.h>
+
+#include "BeaconTable.hpp"
+#include "SignalHistory.hpp"
+#include "SmoothingFilter.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace bi {
+
+class SmoothingEngine {
+public:
+    // Uses `table` for beacon identities if given (it must outlive the engine), otherwise a private table.
+    explicit SmoothingEngine(const BISmoothingConfiguration &configuration, BeaconTable *table = nullptr);
+
+    void processTick(double timestamp, const BIBeaconSample *samples, size_t count);
+    BIBeaconHandle restoreSample(double timestamp, const BIBeaconSample &sample);
+
+    const BISmoothingConfiguration &configuration() const { return _configuration; }
+    const BeaconTable &beaconTable() const { return *_table; }
+
+    // Beacons tracked by this engine, in the order they were first seen.
+    size_t beaconCount() const { return _trackedHandles.size(); }
+    BIBeaconHandle handleAtIndex(size_t index) const { return _trackedHandles[index]; }
+
+    bool tracks(BIBeaconHandle handle) const
+    {
+        return handle < _beacons.size() && _beacons[handle].tracked && _table->isCurrent(handle, _beacons[handle].generation);
+    }
+    BIBeaconHandle handleForKey(const BIBeaconKey &key) const;
+
+    // Handles whose smoothed signal changed in the last tick.
+    const std::vector<BIBeaconHandle> &changedHandles() const { return _changedHandles; }
+    // Handles that stopped being tracked in the last tick, or that now belong to a different beacon.
+    const std::vector<BIBeaconHandle> &droppedHandles() const { return _droppedHandles; }
+
+    // Raw and smoothed histories use the beacon handle as series index.
+    const SignalHistoryStore &rawSignals() const { return _rawSignals; }
+    const SignalHistoryStore &smoothedSignals() const { return _smoothedSignals; }
+
+private:
+    struct Beacon {
+        uint32_t generation = 0;
+        uint64_t lastSeenTick = 0;
+        bool tracked = false;
+    };
+
+    Beacon &beginTracking(BIBeaconHandle handle);
+    void dropStaleBeacons();
+
+    BISmoothingConfiguration _configuration;
+    std::unique_ptr<BeaconTable> _ownedTable;
+    BeaconTable *_table;
+    std::vector<Beacon> _beacons;
+    std::vector<BIBeaconHandle> _trackedHandles;
+    std::vector<BIBeaconHandle> _changedHandles;
+    std::vector<BIBeaconHandle> _droppedHandles;
+    SignalHistoryStore _rawSignals;
+    SignalHistoryStore _smoothedSignals;
+    std::unique_ptr<SmoothingFilter> _filter;
+    uint64_t _tick = 0;
+    double _nextEviction = 0.0;
+};
+
+} // namespace bi
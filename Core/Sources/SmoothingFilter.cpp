@@ -0,0 +1,413 @@
+//
+//  SmoothingFilter.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "SmoothingFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace bi {
+
+// Rounds sum / count half away from zero, like lround(), using integer arithmetic only.
+static int32_t roundedQuotient(int64_t sum, int64_t count)
+{
+    int64_t doubled = 2 * sum;
+    return int32_t(doubled >= 0 ? (doubled + count) / (2 * count) : -((-doubled + count) / (2 * count)));
+}
+
+// Converts a filtered RSSI back to a reported value. 0 means "unknown" in a signal, so it is never produced.
+static int32_t reportedRSSI(double RSSI)
+{
+    return int32_t(std::min(std::lround(RSSI), -1L));
+}
+
+// Accuracies are filtered in decibels, where they move like the RSSI. The lower bound keeps log10 finite.
+static double accuracyToDecibels(double accuracy)
+{
+    return 20.0 * std::log10(std::max(accuracy, 0.001));
+}
+
+static double decibelsToAccuracy(double decibels)
+{
+    return std::pow(10.0, decibels / 20.0);
+}
+
+static BISignal makeSignal(double timestamp, int32_t RSSI, double accuracy)
+{
+    BISignal signal;
+    signal.timestamp = timestamp;
+    signal.inRange = true;
+    signal.RSSI = RSSI;
+    signal.accuracy = accuracy;
+    signal.proximity = BIProximityForAccuracy(accuracy);
+    return signal;
+}
+
+BISignal smoothSignal(const SignalHistoryStore &raw, uint32_t series, double timestamp, const BISmoothingConfiguration &configuration)
+{
+    // Newest first, so that the summation order (and therefore the floating point result) does not depend on how
+    // much history is kept beyond the window.
+    int64_t sumRSSI = 0;
+    uint32_t countRSSI = 0;
+    double sumAccuracy = 0.0;
+    uint32_t countAccuracy = 0;
+    uint32_t available = std::min(raw.size(series), configuration.windowSize);
+    for (uint32_t i = 0; i < available; i++) {
+        if (timestamp - raw.timestampFromNewest(series, i) > configuration.windowDuration) {
+            break;
+        }
+        int32_t RSSI = raw.RSSIFromNewest(series, i);
+        if (!raw.inRangeFromNewest(series, i) || RSSI == 0) {
+            continue;
+        }
+        sumRSSI += RSSI;
+        countRSSI++;
+        double accuracy = raw.accuracyFromNewest(series, i);
+        if (accuracy >= 0.0) {
+            sumAccuracy += accuracy;
+            countAccuracy++;
+        }
+    }
+
+    if (countRSSI == 0) {
+        return BISignalMakeNotInRange(timestamp);
+    }
+    return makeSignal(timestamp, roundedQuotient(sumRSSI, countRSSI), (countAccuracy > 0) ? sumAccuracy / countAccuracy : -1.0);
+}
+
+namespace {
+
+class WindowAverageFilter : public SmoothingFilter {
+public:
+    explicit WindowAverageFilter(const BISmoothingConfiguration &configuration) : _configuration(configuration) {}
+
+    void addSeries() override {}
+    void clearSeries(uint32_t) override {}
+
+    BISignal update(const SignalHistoryStore &raw, uint32_t series, double timestamp) override
+    {
+        return smoothSignal(raw, series, timestamp, _configuration);
+    }
+
+private:
+    BISmoothingConfiguration _configuration;
+};
+
+// Shared by the recursive filters, which keep no window: whether a beacon is still in range follows the same rule as
+// for the window-based filters.
+struct Presence {
+    double lastUsable = 0.0;
+    uint32_t ticksSinceUsable = UINT32_MAX;
+
+    bool inRange(double timestamp, const BISmoothingConfiguration &configuration) const
+    {
+        return ticksSinceUsable < configuration.windowSize && timestamp - lastUsable <= configuration.windowDuration;
+    }
+};
+
+class EWMAFilter : public SmoothingFilter {
+public:
+    explicit EWMAFilter(const BISmoothingConfiguration &configuration) : _configuration(configuration) {}
+
+    void addSeries() override { _states.emplace_back(); }
+    void clearSeries(uint32_t series) override { _states[series] = State(); }
+
+    BISignal update(const SignalHistoryStore &raw, uint32_t series, double timestamp) override
+    {
+        State &state = _states[series];
+        BISignal sample = raw.last(series);
+        if (state.presence.ticksSinceUsable != UINT32_MAX) {
+            state.presence.ticksSinceUsable++;
+        }
+
+        if (sample.inRange && sample.RSSI != 0) {
+            bool restart = !state.presence.inRange(timestamp, _configuration);
+            if (restart) {
+                state.RSSI = sample.RSSI;
+                state.hasAccuracy = false;
+            } else {
+                state.RSSI += weight(timestamp - state.lastRSSIUpdate) * (sample.RSSI - state.RSSI);
+            }
+            state.lastRSSIUpdate = timestamp;
+
+            if (sample.accuracy >= 0.0) {
+                double accuracy = accuracyToDecibels(sample.accuracy);
+                if (state.hasAccuracy) {
+                    state.accuracy += weight(timestamp - state.lastAccuracyUpdate) * (accuracy - state.accuracy);
+                } else {
+                    state.accuracy = accuracy;
+                    state.hasAccuracy = true;
+                }
+                state.lastAccuracyUpdate = timestamp;
+            }
+            state.presence.lastUsable = timestamp;
+            state.presence.ticksSinceUsable = 0;
+        }
+
+        if (!state.presence.inRange(timestamp, _configuration)) {
+            return BISignalMakeNotInRange(timestamp);
+        }
+        return makeSignal(timestamp, reportedRSSI(state.RSSI), state.hasAccuracy ? decibelsToAccuracy(state.accuracy) : -1.0);
+    }
+
+private:
+    struct State {
+        double RSSI = 0.0;
+        double accuracy = 0.0;
+        double lastRSSIUpdate = 0.0;
+        double lastAccuracyUpdate = 0.0;
+        bool hasAccuracy = false;
+        Presence presence;
+    };
+
+    double weight(double elapsed) const
+    {
+        if (_configuration.halfLife <= 0.0) {
+            return 1.0;
+        }
+        return 1.0 - std::exp2(-std::max(elapsed, 0.0) / _configuration.halfLife);
+    }
+
+    BISmoothingConfiguration _configuration;
+    std::vector<State> _states;
+};
+
+class KalmanFilter : public SmoothingFilter {
+public:
+    explicit KalmanFilter(const BISmoothingConfiguration &configuration) : _configuration(configuration)
+    {
+        _configuration.processNoise = std::max(_configuration.processNoise, 0.0);
+        _configuration.measurementNoise = std::max(_configuration.measurementNoise, 1e-6);
+    }
+
+    void addSeries() override { _states.emplace_back(); }
+    void clearSeries(uint32_t series) override { _states[series] = State(); }
+
+    BISignal update(const SignalHistoryStore &raw, uint32_t series, double timestamp) override
+    {
+        State &state = _states[series];
+        BISignal sample = raw.last(series);
+        if (state.presence.ticksSinceUsable != UINT32_MAX) {
+            state.presence.ticksSinceUsable++;
+        }
+
+        if (sample.inRange && sample.RSSI != 0) {
+            bool restart = !state.presence.inRange(timestamp, _configuration);
+            if (restart) {
+                state.accuracy.initialized = false;
+            }
+            correct(state.RSSI, double(sample.RSSI), timestamp, restart);
+            if (sample.accuracy >= 0.0) {
+                correct(state.accuracy, accuracyToDecibels(sample.accuracy), timestamp, !state.accuracy.initialized);
+            }
+            state.presence.lastUsable = timestamp;
+            state.presence.ticksSinceUsable = 0;
+        }
+
+        if (!state.presence.inRange(timestamp, _configuration)) {
+            return BISignalMakeNotInRange(timestamp);
+        }
+        // Report the estimate as of the last measurement; extrapolating over gaps would amplify the velocity estimate.
+        return makeSignal(timestamp, reportedRSSI(state.RSSI.value),
+                          state.accuracy.initialized ? decibelsToAccuracy(state.accuracy.value) : -1.0);
+    }
+
+private:
+    // Position/velocity state of one quantity and its covariance matrix [[p00, p01], [p01, p11]].
+    struct Channel {
+        double value = 0.0;
+        double velocity = 0.0;
+        double p00 = 0.0;
+        double p01 = 0.0;
+        double p11 = 0.0;
+        double lastUpdate = 0.0;
+        bool initialized = false;
+    };
+
+    struct State {
+        Channel RSSI;
+        Channel accuracy;
+        Presence presence;
+    };
+
+    // Variance of the initial velocity estimate, in (dB/s)^2.
+    static constexpr double initialVelocityVariance = 4.0;
+
+    void correct(Channel &channel, double measurement, double timestamp, bool restart) const
+    {
+        double R = _configuration.measurementNoise;
+        if (restart || !channel.initialized) {
+            channel.value = measurement;
+            channel.velocity = 0.0;
+            channel.p00 = R;
+            channel.p01 = 0.0;
+            channel.p11 = initialVelocityVariance;
+            channel.lastUpdate = timestamp;
+            channel.initialized = true;
+            return;
+        }
+
+        // Predict.
+        double dt = std::max(timestamp - channel.lastUpdate, 0.0);
+        double q = _configuration.processNoise;
+        channel.value += channel.velocity * dt;
+        channel.p00 += dt * (2.0 * channel.p01 + dt * channel.p11) + q * dt * dt * dt / 3.0;
+        channel.p01 += dt * channel.p11 + q * dt * dt / 2.0;
+        channel.p11 += q * dt;
+
+        // Correct.
+        double S = channel.p00 + R;
+        double k0 = channel.p00 / S;
+        double k1 = channel.p01 / S;
+        double innovation = measurement - channel.value;
+        channel.value += k0 * innovation;
+        channel.velocity += k1 * innovation;
+        channel.p11 -= k1 * channel.p01;
+        channel.p01 *= 1.0 - k0;
+        channel.p00 *= 1.0 - k0;
+        channel.lastUpdate = timestamp;
+    }
+
+    BISmoothingConfiguration _configuration;
+    std::vector<State> _states;
+};
+
+// Keeps the raw signals of the window twice per series: in arrival order (a ring, to know which value leaves the
+// window) and sorted (to read the median). Each raw signal is inserted and removed once, and both operations move at
+// most windowSize elements of a contiguous block, so the cost per signal is bounded by the window size and does not
+// depend on the number of beacons.
+class MedianFilter : public SmoothingFilter {
+public:
+    explicit MedianFilter(const BISmoothingConfiguration &configuration)
+        : _configuration(configuration), _window(std::max<uint32_t>(configuration.windowSize, 1))
+    {
+    }
+
+    void addSeries() override
+    {
+        _timestamps.resize(_timestamps.size() + _window);
+        _RSSI.resize(_RSSI.size() + _window);
+        _accuracies.resize(_accuracies.size() + _window);
+        _sortedRSSI.resize(_sortedRSSI.size() + _window);
+        _sortedAccuracies.resize(_sortedAccuracies.size() + _window);
+        _states.emplace_back();
+    }
+
+    void clearSeries(uint32_t series) override { _states[series] = State(); }
+
+    BISignal update(const SignalHistoryStore &raw, uint32_t series, double timestamp) override
+    {
+        State &state = _states[series];
+        size_t base = size_t(series) * _window;
+        if (state.covered == _window) {
+            removeOldest(state, base);
+        }
+
+        BISignal sample = raw.last(series);
+        int32_t RSSI = sample.inRange ? sample.RSSI : 0;
+        double accuracy = (RSSI != 0) ? sample.accuracy : -1.0;
+        size_t slot = base + (state.oldest + state.covered) % _window;
+        _timestamps[slot] = sample.timestamp;
+        _RSSI[slot] = RSSI;
+        _accuracies[slot] = accuracy;
+        state.covered++;
+        if (RSSI != 0) {
+            insertSorted(&_sortedRSSI[base], state.RSSICount, RSSI);
+            if (accuracy >= 0.0) {
+                insertSorted(&_sortedAccuracies[base], state.accuracyCount, accuracy);
+            }
+        }
+
+        while (state.covered > 0 && timestamp - _timestamps[base + state.oldest] > _configuration.windowDuration) {
+            removeOldest(state, base);
+        }
+
+        if (state.RSSICount == 0) {
+            return BISignalMakeNotInRange(timestamp);
+        }
+        const int32_t *sortedRSSI = &_sortedRSSI[base];
+        uint32_t middle = state.RSSICount / 2;
+        int32_t medianRSSI = (state.RSSICount % 2 == 1) ? sortedRSSI[middle]
+                                                       : roundedQuotient(int64_t(sortedRSSI[middle - 1]) + sortedRSSI[middle], 2);
+
+        double medianAccuracy = -1.0;
+        if (state.accuracyCount > 0) {
+            const double *sortedAccuracies = &_sortedAccuracies[base];
+            middle = state.accuracyCount / 2;
+            medianAccuracy = (state.accuracyCount % 2 == 1) ? sortedAccuracies[middle]
+                                                            : 0.5 * (sortedAccuracies[middle - 1] + sortedAccuracies[middle]);
+        }
+        return makeSignal(timestamp, medianRSSI, medianAccuracy);
+    }
+
+private:
+    struct State {
+        uint32_t oldest = 0; // ring index of the oldest raw signal in the window
+        uint32_t covered = 0;
+        uint32_t RSSICount = 0;
+        uint32_t accuracyCount = 0;
+    };
+
+    template <typename Value>
+    static void insertSorted(Value *sorted, uint32_t &count, Value value)
+    {
+        Value *position = std::upper_bound(sorted, sorted + count, value);
+        std::copy_backward(position, sorted + count, sorted + count + 1);
+        *position = value;
+        count++;
+    }
+
+    template <typename Value>
+    static void removeSorted(Value *sorted, uint32_t &count, Value value)
+    {
+        Value *position = std::lower_bound(sorted, sorted + count, value);
+        std::copy(position + 1, sorted + count, position);
+        count--;
+    }
+
+    void removeOldest(State &state, size_t base)
+    {
+        size_t slot = base + state.oldest;
+        if (_RSSI[slot] != 0) {
+            removeSorted(&_sortedRSSI[base], state.RSSICount, _RSSI[slot]);
+            if (_accuracies[slot] >= 0.0) {
+                removeSorted(&_sortedAccuracies[base], state.accuracyCount, _accuracies[slot]);
+            }
+        }
+        state.oldest = (state.oldest + 1) % _window;
+        state.covered--;
+    }
+
+    BISmoothingConfiguration _configuration;
+    uint32_t _window;
+    std::vector<double> _timestamps;
+    std::vector<int32_t> _RSSI;
+    std::vector<double> _accuracies;
+    std::vector<int32_t> _sortedRSSI;
+    std::vector<double> _sortedAccuracies;
+    std::vector<State> _states;
+};
+
+} // namespace
+
+std::unique_ptr<SmoothingFilter> makeSmoothingFilter(const BISmoothingConfiguration &configuration)
+{
+    switch (configuration.filter) {
+    case BISmoothingFilterEWMA:
+        return std::unique_ptr<SmoothingFilter>(new EWMAFilter(configuration));
+    case BISmoothingFilterKalman:
+        return std::unique_ptr<SmoothingFilter>(new KalmanFilter(configuration));
+    case BISmoothingFilterMedian:
+        return std::unique_ptr<SmoothingFilter>(new MedianFilter(configuration));
+    case BISmoothingFilterWindowAverage:
+        break;
+    }
+    return std::unique_ptr<SmoothingFilter>(new WindowAverageFilter(configuration));
+}
+
+} // namespace bi
@@ -0,0 +1,38 @@
+//
+//  SmoothingFilter.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BISmoothingEngine.h>
+
+#include "SignalHistory.hpp"
+
+#include <memory>
+
+namespace bi {
+
+// Computes the smoothed signal at `timestamp` from a raw history series. This is the reference smoothing behaviour
+// (BISmoothingFilterWindowAverage) documented in BISmoothingEngine.h.
+BISignal smoothSignal(const SignalHistoryStore &raw, uint32_t series, double timestamp, const BISmoothingConfiguration &configuration);
+
+// A filter keeps per-beacon state in series parallel to the engine's raw history, indexed by beacon handle.
+class SmoothingFilter {
+public:
+    virtual ~SmoothingFilter() = default;
+
+    // Called whenever the engine adds a history series, and when a series is reused for another beacon.
+    virtual void addSeries() = 0;
+    virtual void clearSeries(uint32_t series) = 0;
+
+    // Returns the smoothed signal of a series once the raw signal of the tick at `timestamp` has been appended. Called
+    // exactly once per tick for every series the engine tracks.
+    virtual BISignal update(const SignalHistoryStore &raw, uint32_t series, double timestamp) = 0;
+};
+
+std::unique_ptr<SmoothingFilter> makeSmoothingFilter(const BISmoothingConfiguration &configuration);
+
+} // namespace bi
@@ -0,0 +1,301 @@
+//
+//  SpatialIndex.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "SpatialIndex.hpp"
+
+#include <map>
+#include <unordered_map>
+
+namespace bi {
+
+SpatialIndex::SpatialIndex(const BISpatialIndexConfiguration &configuration, const BIBeaconLocation *beacons, size_t count)
+{
+    // Later duplicates replace earlier ones.
+    std::vector<BIBeaconLocation> unique;
+    unique.reserve(count);
+    {
+        std::unordered_map<BIBeaconKey, size_t, BeaconKeyHash> positions;
+        positions.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            auto inserted = positions.emplace(beacons[i].key, unique.size());
+            if (inserted.second) {
+                unique.push_back(beacons[i]);
+            } else {
+                unique[inserted.first->second] = beacons[i];
+            }
+        }
+    }
+
+    // Bounding box and beacon count of every floor.
+    struct Extent {
+        double minX = INFINITY;
+        double minY = INFINITY;
+        double maxX = -INFINITY;
+        double maxY = -INFINITY;
+        size_t count = 0;
+    };
+    std::map<int32_t, Extent> extents;
+    for (const BIBeaconLocation &beacon : unique) {
+        Extent &extent = extents[beacon.floor];
+        extent.minX = std::min(extent.minX, beacon.x);
+        extent.minY = std::min(extent.minY, beacon.y);
+        extent.maxX = std::max(extent.maxX, beacon.x);
+        extent.maxY = std::max(extent.maxY, beacon.y);
+        extent.count++;
+    }
+
+    uint32_t cellCount = 0;
+    for (const auto &entry : extents) {
+        const Extent &extent = entry.second;
+        double width = extent.maxX - extent.minX;
+        double height = extent.maxY - extent.minY;
+        double cellSize = configuration.cellSize > 0.0
+                              ? configuration.cellSize
+                              : std::sqrt(2.0 * std::max(width, 1.0) * std::max(height, 1.0) / double(extent.count));
+        double maximumCells = 4.0 * double(extent.count) + 16.0;
+        while ((std::floor(width / cellSize) + 1.0) * (std::floor(height / cellSize) + 1.0) > maximumCells) {
+            cellSize *= 1.25;
+        }
+        Floor floor;
+        floor.number = entry.first;
+        floor.columns = uint32_t(width / cellSize) + 1;
+        floor.rows = uint32_t(height / cellSize) + 1;
+        floor.firstCell = cellCount;
+        floor.minX = extent.minX;
+        floor.minY = extent.minY;
+        floor.cellSize = cellSize;
+        _floors.push_back(floor);
+        cellCount += floor.columns * floor.rows;
+    }
+
+    // Counting sort by cell; cells are numbered floor by floor, row by row.
+    std::vector<uint32_t> cells(unique.size());
+    _cellStarts.assign(size_t(cellCount) + 1, 0);
+    for (size_t i = 0; i < unique.size(); i++) {
+        const Floor &floor = *findFloor(unique[i].floor);
+        cells[i] = floor.firstCell + floor.row(unique[i].y) * floor.columns + floor.column(unique[i].x);
+        _cellStarts[cells[i] + 1]++;
+    }
+    for (size_t c = 0; c < cellCount; c++) {
+        _cellStarts[c + 1] += _cellStarts[c];
+    }
+    std::vector<uint32_t> next(_cellStarts.begin(), _cellStarts.end() - 1);
+    _locations.resize(unique.size());
+    _x.resize(unique.size());
+    _y.resize(unique.size());
+    for (size_t i = 0; i < unique.size(); i++) {
+        uint32_t index = next[cells[i]]++;
+        _locations[index] = unique[i];
+        _x[index] = unique[i].x;
+        _y[index] = unique[i].y;
+    }
+
+    size_t slotCount = 2;
+    while (slotCount < 2 * _locations.size()) {
+        slotCount *= 2;
+    }
+    _slots.assign(slotCount, Slot{0, 0});
+    _mask = uint32_t(slotCount - 1);
+    for (uint32_t index = 0; index < _locations.size(); index++) {
+        uint32_t hash = uint32_t(hashBeaconKey(_locations[index].key));
+        size_t slot = hash & _mask;
+        while (_slots[slot].indexPlusOne != 0) {
+            slot = (slot + 1) & _mask;
+        }
+        _slots[slot] = Slot{hash, index + 1};
+    }
+}
+
+size_t SpatialIndex::storageSize() const
+{
+    return _floors.capacity() * sizeof(Floor) + _cellStarts.capacity() * sizeof(uint32_t) +
+           (_x.capacity() + _y.capacity()) * sizeof(double) + _locations.capacity() * sizeof(BIBeaconLocation) +
+           _slots.capacity() * sizeof(Slot);
+}
+
+uint32_t SpatialIndex::indexOf(const BIBeaconKey &key) const
+{
+    uint32_t hash = uint32_t(hashBeaconKey(key));
+    for (size_t slot = hash & _mask; _slots[slot].indexPlusOne != 0; slot = (slot + 1) & _mask) {
+        if (_slots[slot].hash == hash && _locations[_slots[slot].indexPlusOne - 1].key == key) {
+            return _slots[slot].indexPlusOne - 1;
+        }
+    }
+    return Absent;
+}
+
+const SpatialIndex::Floor *SpatialIndex::findFloor(int32_t number) const
+{
+    auto it = std::lower_bound(_floors.begin(), _floors.end(), number,
+                               [](const Floor &floor, int32_t value) { return floor.number < value; });
+    return it != _floors.end() && it->number == number ? &*it : nullptr;
+}
+
+// Scans rings of cells around the cell nearest to the point. Everything outside the block of rings scanned so far is
+// at least as far away as the nearest edge of the block (edges on the border of the grid do not count), so the search
+// stops once the k-th match is closer than that.
+size_t SpatialIndex::nearest(int32_t floor, double x, double y, size_t k, BISpatialMatch *matches) const
+{
+    const Floor *grid = findFloor(floor);
+    if (grid == nullptr || k == 0) {
+        return 0;
+    }
+    // Matches hold squared distances until the search ends.
+    size_t found = 0;
+    auto consider = [&](uint32_t index) {
+        double dx = _x[index] - x;
+        double dy = _y[index] - y;
+        double distance = dx * dx + dy * dy;
+        if (found == k && distance >= matches[k - 1].distance) {
+            return;
+        }
+        size_t position = found < k ? found++ : k - 1;
+        while (position > 0 && matches[position - 1].distance > distance) {
+            matches[position] = matches[position - 1];
+            position--;
+        }
+        matches[position].location = _locations[index];
+        matches[position].distance = distance;
+    };
+
+    // The point projected onto the grid; distances to cells are measured from there, which never overestimates them.
+    double maxX = grid->minX + grid->cellSize * grid->columns;
+    double maxY = grid->minY + grid->cellSize * grid->rows;
+    double px = std::min(std::max(x, grid->minX), maxX);
+    double py = std::min(std::max(y, grid->minY), maxY);
+    int64_t centerColumn = grid->column(x);
+    int64_t centerRow = grid->row(y);
+    int64_t columns = grid->columns;
+    int64_t rows = grid->rows;
+    for (int64_t ring = 0;; ring++) {
+        int64_t firstColumn = centerColumn - ring;
+        int64_t lastColumn = centerColumn + ring;
+        int64_t firstRow = centerRow - ring;
+        int64_t lastRow = centerRow + ring;
+        if (firstColumn < 0 && firstRow < 0 && lastColumn >= columns && lastRow >= rows) {
+            break;
+        }
+        auto scan = [&](int64_t row, int64_t column) {
+            uint32_t cell = grid->firstCell + uint32_t(row * columns + column);
+            for (uint32_t i = _cellStarts[cell]; i < _cellStarts[cell + 1]; i++) {
+                consider(i);
+            }
+        };
+        for (int64_t row = std::max<int64_t>(firstRow, 0); row <= std::min(lastRow, rows - 1); row++) {
+            if (row == firstRow || row == lastRow) {
+                for (int64_t column = std::max<int64_t>(firstColumn, 0); column <= std::min(lastColumn, columns - 1); column++) {
+                    scan(row, column);
+                }
+                continue;
+            }
+            if (firstColumn >= 0) {
+                scan(row, firstColumn);
+            }
+            if (lastColumn < columns) {
+                scan(row, lastColumn);
+            }
+        }
+        if (found == k) {
+            double bound = INFINITY;
+            if (firstColumn > 0) {
+                bound = std::min(bound, px - (grid->minX + grid->cellSize * double(firstColumn)));
+            }
+            if (lastColumn < columns - 1) {
+                bound = std::min(bound, grid->minX + grid->cellSize * double(lastColumn + 1) - px);
+            }
+            if (firstRow > 0) {
+                bound = std::min(bound, py - (grid->minY + grid->cellSize * double(firstRow)));
+            }
+            if (lastRow < rows - 1) {
+                bound = std::min(bound, grid->minY + grid->cellSize * double(lastRow + 1) - py);
+            }
+            if (matches[k - 1].distance <= bound * bound) {
+                break;
+            }
+        }
+    }
+    for (size_t i = 0; i < found; i++) {
+        matches[i].distance = std::sqrt(matches[i].distance);
+    }
+    return found;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BISpatialIndex {
+    BISpatialIndex(const BISpatialIndexConfiguration &configuration, const BIBeaconLocation *beacons, size_t count)
+        : index(configuration, beacons, count)
+    {
+    }
+    bi::SpatialIndex index;
+};
+
+const bi::SpatialIndex *bi::unwrapSpatialIndex(BISpatialIndexRef index)
+{
+    return index != nullptr ? &index->index : nullptr;
+}
+
+BISpatialIndexConfiguration BISpatialIndexConfigurationMakeDefault(void)
+{
+    BISpatialIndexConfiguration configuration;
+    configuration.cellSize = 0.0;
+    return configuration;
+}
+
+BISpatialIndexRef BISpatialIndexCreate(const BISpatialIndexConfiguration *configuration, const BIBeaconLocation *beacons,
+                                       size_t beaconCount)
+{
+    return new BISpatialIndex(configuration ? *configuration : BISpatialIndexConfigurationMakeDefault(), beacons,
+                              beaconCount);
+}
+
+void BISpatialIndexDestroy(BISpatialIndexRef index)
+{
+    delete index;
+}
+
+size_t BISpatialIndexGetCount(BISpatialIndexRef index)
+{
+    return index->index.count();
+}
+
+size_t BISpatialIndexGetStorageSize(BISpatialIndexRef index)
+{
+    return index->index.storageSize();
+}
+
+bool BISpatialIndexGetLocation(BISpatialIndexRef index, const BIBeaconKey *key, BIBeaconLocation *location)
+{
+    uint32_t position = index->index.indexOf(*key);
+    if (position == bi::SpatialIndex::Absent) {
+        return false;
+    }
+    *location = index->index.location(position);
+    return true;
+}
+
+size_t BISpatialIndexFindNearest(BISpatialIndexRef index, int32_t floor, double x, double y, size_t k,
+                                 BISpatialMatch *matches)
+{
+    return index->index.nearest(floor, x, y, k, matches);
+}
+
+size_t BISpatialIndexFindWithinRadius(BISpatialIndexRef index, int32_t floor, double x, double y, double radius,
+                                      BISpatialMatch *matches, size_t capacity)
+{
+    size_t found = 0;
+    index->index.visitWithinRadius(floor, x, y, radius, [&](uint32_t position, double distance) {
+        if (found < capacity) {
+            matches[found].location = index->index.location(position);
+            matches[found].distance = distance;
+        }
+        found++;
+    });
+    return found;
+}
@@ -0,0 +1,106 @@
+//
+//  SpatialIndex.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BISpatialIndex.h>
+
+#include "BeaconKey.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace bi {
+
+// Per-floor uniform grids over beacons sorted by (floor, cell). _cellStarts holds the first beacon of every cell of
+// every floor, floors one after another, plus one end marker, so the beacons of a cell are
+// [_cellStarts[c], _cellStarts[c + 1]). Coordinates are copied into _x and _y so that scanning a cell only touches
+// 16 bytes per beacon. Identities are found through the same slot layout as BeaconTable (hash fragment plus index).
+class SpatialIndex {
+public:
+    static constexpr uint32_t Absent = UINT32_MAX;
+
+    SpatialIndex(const BISpatialIndexConfiguration &configuration, const BIBeaconLocation *beacons, size_t count);
+
+    size_t count() const { return _locations.size(); }
+    size_t storageSize() const;
+
+    // Beacons are numbered in index order; indexOf() returns Absent for unknown beacons.
+    uint32_t indexOf(const BIBeaconKey &key) const;
+    const BIBeaconLocation &location(uint32_t index) const { return _locations[index]; }
+
+    size_t nearest(int32_t floor, double x, double y, size_t k, BISpatialMatch *matches) const;
+
+    // Calls visit(index, distance) for every beacon on the floor within radius of (x, y).
+    template <typename Visitor>
+    void visitWithinRadius(int32_t floor, double x, double y, double radius, Visitor visit) const
+    {
+        const Floor *grid = findFloor(floor);
+        if (grid == nullptr || !(radius >= 0.0)) {
+            return;
+        }
+        uint32_t firstColumn = grid->column(x - radius);
+        uint32_t lastColumn = grid->column(x + radius);
+        uint32_t firstRow = grid->row(y - radius);
+        uint32_t lastRow = grid->row(y + radius);
+        double radiusSquared = radius * radius;
+        for (uint32_t row = firstRow; row <= lastRow; row++) {
+            uint32_t cell = grid->firstCell + row * grid->columns;
+            for (uint32_t i = _cellStarts[cell + firstColumn]; i < _cellStarts[cell + lastColumn + 1]; i++) {
+                double dx = _x[i] - x;
+                double dy = _y[i] - y;
+                double distanceSquared = dx * dx + dy * dy;
+                if (distanceSquared <= radiusSquared) {
+                    visit(i, std::sqrt(distanceSquared));
+                }
+            }
+        }
+    }
+
+private:
+    struct Floor {
+        int32_t number;
+        uint32_t columns;
+        uint32_t rows;
+        uint32_t firstCell;
+        double minX;
+        double minY;
+        double cellSize;
+
+        uint32_t column(double x) const { return clampCell((x - minX) / cellSize, columns); }
+        uint32_t row(double y) const { return clampCell((y - minY) / cellSize, rows); }
+
+        static uint32_t clampCell(double position, uint32_t limit)
+        {
+            if (!(position > 0.0)) {
+                return 0; // also NaN
+            }
+            return position >= double(limit - 1) ? limit - 1 : uint32_t(position);
+        }
+    };
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t indexPlusOne; // 0 marks an empty slot
+    };
+
+    const Floor *findFloor(int32_t number) const;
+
+    std::vector<Floor> _floors; // sorted by number
+    std::vector<uint32_t> _cellStarts;
+    std::vector<double> _x;
+    std::vector<double> _y;
+    std::vector<BIBeaconLocation> _locations;
+    std::vector<Slot> _slots;
+    uint32_t _mask = 0;
+};
+
+// Returns the index behind a BISpatialIndexRef (or nullptr), for other parts of the core that accept a shared index.
+const SpatialIndex *unwrapSpatialIndex(BISpatialIndexRef index);
+
+} // namespace bi
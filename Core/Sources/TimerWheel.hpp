@@ -0,0 +1,136 @@
+//
+//  TimerWheel.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace bi {
+
+// A hashed timing wheel for many timers with at most one deadline each. Timers are identified by small dense integers
+// (e.g. slot indexes) and kept in intrusive doubly linked lists, one per wheel slot, so that scheduling, rescheduling
+// and cancelling cost O(1) and advancing costs O(elapsed slots + timers in them). Deadlines further away than the span
+// of the wheel wrap around and are skipped until their round comes.
+//
+// Time is whatever the caller passes in (seconds); the wheel never reads a clock, so replays are deterministic.
+class TimerWheel {
+public:
+    // slotCount is rounded up to a power of two.
+    TimerWheel(double resolution, uint32_t slotCount)
+        : _resolution(resolution > 0.0 ? resolution : 1.0)
+    {
+        uint32_t count = 1;
+        while (count < slotCount) {
+            count <<= 1;
+        }
+        _heads.assign(count, None);
+        _mask = count - 1;
+    }
+
+    void schedule(uint32_t timer, double deadline)
+    {
+        if (timer >= _deadlines.size()) {
+            _deadlines.resize(timer + 1, 0.0);
+            _next.resize(timer + 1, None);
+            _previous.resize(timer + 1, None);
+            _slots.resize(timer + 1, None);
+        }
+        cancel(timer);
+        // Deadlines in the past go into the current slot, which the next advance() visits first.
+        int64_t tick = std::max(tickForTime(deadline), _currentTick);
+        uint32_t slot = uint32_t(tick) & _mask;
+        _deadlines[timer] = deadline;
+        _slots[timer] = slot;
+        _previous[timer] = None;
+        _next[timer] = _heads[slot];
+        if (_heads[slot] != None) {
+            _previous[_heads[slot]] = timer;
+        }
+        _heads[slot] = timer;
+        _count++;
+    }
+
+    void cancel(uint32_t timer)
+    {
+        if (!isScheduled(timer)) {
+            return;
+        }
+        uint32_t slot = _slots[timer];
+        if (_previous[timer] != None) {
+            _next[_previous[timer]] = _next[timer];
+        } else {
+            _heads[slot] = _next[timer];
+        }
+        if (_next[timer] != None) {
+            _previous[_next[timer]] = _previous[timer];
+        }
+        _slots[timer] = None;
+        _count--;
+    }
+
+    bool isScheduled(uint32_t timer) const { return timer < _slots.size() && _slots[timer] != None; }
+    double deadline(uint32_t timer) const { return _deadlines[timer]; }
+    size_t count() const { return _count; }
+
+    // Calls fire(timer, deadline) for every timer whose deadline is not later than now, in deadline order (ties in
+    // timer order). The callback may schedule and cancel timers; timers it schedules at or before now fire as well.
+    template <typename Fire>
+    void advance(double now, Fire fire)
+    {
+        int64_t nowTick = std::max(tickForTime(now), _currentTick);
+        while (true) {
+            _due.clear();
+            // A full turn visits every slot; more would only visit them again.
+            int64_t last = std::min(nowTick, _currentTick + int64_t(_mask));
+            for (int64_t tick = _currentTick; tick <= last; tick++) {
+                for (uint32_t timer = _heads[uint32_t(tick) & _mask]; timer != None; timer = _next[timer]) {
+                    if (_deadlines[timer] <= now) {
+                        _due.emplace_back(_deadlines[timer], timer);
+                    }
+                }
+            }
+            _currentTick = nowTick;
+            if (_due.empty()) {
+                return;
+            }
+
+            std::sort(_due.begin(), _due.end());
+            for (const auto &due : _due) {
+                cancel(due.second);
+            }
+            for (const auto &due : _due) {
+                fire(due.second, due.first);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    int64_t tickForTime(double time) const { return int64_t(std::floor(time / _resolution)); }
+
+    double _resolution;
+    uint32_t _mask;
+    int64_t _currentTick = INT64_MIN / 2;
+    size_t _count = 0;
+
+    std::vector<uint32_t> _heads; // first timer per slot
+
+    // Per timer.
+    std::vector<double> _deadlines;
+    std::vector<uint32_t> _next;
+    std::vector<uint32_t> _previous;
+    std::vector<uint32_t> _slots; // None if not scheduled
+
+    std::vector<std::pair<double, uint32_t>> _due; // scratch space for advance()
+};
+
+} // namespace bi
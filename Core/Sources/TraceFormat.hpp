@@ -0,0 +1,89 @@
+//
+//  TraceFormat.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Building blocks of the binary trace format described in BITrace.h.
+
+#pragma once
+
+#include <BICore/BITrace.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace bi {
+namespace trace {
+
+const char magic[8] = {'B', 'I', 'T', 'R', 'A', 'C', 'E', 1};
+
+// Longest varint encoding of a 64-bit value.
+const size_t maximumVarintSize = 10;
+
+inline uint64_t zigzag(int64_t value)
+{
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value)
+{
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+inline void appendVarint(std::vector<uint8_t> &buffer, uint64_t value)
+{
+    while (value >= 0x80) {
+        buffer.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    buffer.push_back(uint8_t(value));
+}
+
+inline void appendSignedVarint(std::vector<uint8_t> &buffer, int64_t value)
+{
+    appendVarint(buffer, zigzag(value));
+}
+
+// RSSIs are stored relative to -64 dBm, so that every valid RSSI (-128 to -1) takes a single byte.
+const int64_t RSSIOffset = -64;
+
+// Timestamps are stored as whole microseconds. Timestamps more than about 31000 years from the reference date (or NaN)
+// are clamped, so that the difference of two timestamps always fits into 64 bits.
+const int64_t maximumMicroseconds = 1000000000000000000;
+
+inline int64_t microseconds(double timestamp)
+{
+    const double limit = double(maximumMicroseconds);
+    double value = timestamp * 1e6;
+    if (!(value > -limit)) {
+        return -maximumMicroseconds;
+    }
+    return value < limit ? int64_t(std::llround(value)) : maximumMicroseconds;
+}
+
+inline double seconds(int64_t microseconds)
+{
+    return double(microseconds) / 1e6;
+}
+
+// Accuracies beyond 1000 km (or NaN) cannot come from a beacon and are clamped.
+inline int64_t millimeters(double accuracy)
+{
+    const double limit = 1e9;
+    double value = accuracy * 1e3;
+    if (!(value > -limit)) {
+        return -int64_t(limit);
+    }
+    return int64_t(std::llround(value < limit ? value : limit));
+}
+
+inline double meters(int64_t millimeters)
+{
+    return double(millimeters) / 1e3;
+}
+
+} // namespace trace
+} // namespace bi
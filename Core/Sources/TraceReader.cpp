@@ -0,0 +1,246 @@
+//
+//  TraceReader.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "TraceReader.hpp"
+
+#include "TraceFormat.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bi {
+
+// Sanity limits, so that a corrupt length field fails the read instead of allocating gigabytes.
+static const uint64_t maximumSampleCount = 1 << 20;
+static const uint64_t maximumIdentifierLength = 4096;
+
+std::unique_ptr<TraceReader> TraceReader::open(const char *path)
+{
+    FILE *file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+    std::unique_ptr<TraceReader> reader(new TraceReader(file));
+    char header[sizeof(trace::magic)];
+    if (!reader->readBytes(header, sizeof(header)) || std::memcmp(header, trace::magic, sizeof(header)) != 0) {
+        return nullptr;
+    }
+    return reader;
+}
+
+TraceReader::TraceReader(FILE *file)
+    : _file(file)
+    , _buffer(64 * 1024)
+{
+}
+
+TraceReader::~TraceReader()
+{
+    std::fclose(_file);
+}
+
+bool TraceReader::refill()
+{
+    _position = 0;
+    _end = std::fread(_buffer.data(), 1, _buffer.size(), _file);
+    return _end > 0;
+}
+
+bool TraceReader::readVarint(uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        if (!readByte(byte)) {
+            return false;
+        }
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceReader::readSignedVarint(int64_t &value)
+{
+    uint64_t encoded;
+    if (!readVarint(encoded)) {
+        return false;
+    }
+    value = trace::unzigzag(encoded);
+    return true;
+}
+
+bool TraceReader::readBytes(void *destination, size_t count)
+{
+    uint8_t *bytes = static_cast<uint8_t *>(destination);
+    while (count > 0) {
+        if (_position == _end && !refill()) {
+            return false;
+        }
+        size_t available = std::min(count, _end - _position);
+        std::memcpy(bytes, _buffer.data() + _position, available);
+        _position += available;
+        bytes += available;
+        count -= available;
+    }
+    return true;
+}
+
+bool TraceReader::fail(const char *message)
+{
+    _error = message;
+    _finished = true;
+    return false;
+}
+
+bool TraceReader::next(BITraceRecord &record)
+{
+    if (_finished) {
+        return false;
+    }
+
+    uint8_t type;
+    if (!readByte(type)) {
+        _finished = true;
+        return false;
+    }
+
+    std::memset(&record, 0, sizeof(record));
+    record.type = BITraceRecordType(type);
+    int64_t delta;
+    if (!readSignedVarint(delta)) {
+        return fail("truncated record");
+    }
+    // Keeps the sum in range, so that a corrupt delta fails the read instead of overflowing.
+    if ((delta > 0 && _microseconds > trace::maximumMicroseconds - delta) ||
+        (delta < 0 && _microseconds < -trace::maximumMicroseconds - delta)) {
+        return fail("timestamp out of range");
+    }
+    _microseconds += delta;
+    record.timestamp = trace::seconds(_microseconds);
+
+    uint64_t value;
+    uint64_t count;
+    switch (type) {
+    case BITraceRecordBeaconDefinition: {
+        uint64_t major;
+        uint64_t minor;
+        if (!readBytes(record.beaconKey.proximityUUID, sizeof(record.beaconKey.proximityUUID)) || !readVarint(major) ||
+            !readVarint(minor)) {
+            return fail("truncated record");
+        }
+        record.beaconKey.major = uint16_t(major);
+        record.beaconKey.minor = uint16_t(minor);
+        _beacons.push_back(record.beaconKey);
+        return true;
+    }
+
+    case BITraceRecordBeaconReset:
+        _beacons.clear();
+        return true;
+
+    case BITraceRecordRegionDefinition:
+        if (!readVarint(value) || !readVarint(count)) {
+            return fail("truncated record");
+        }
+        if (count > maximumIdentifierLength) {
+            return fail("region identifier too long");
+        }
+        _identifier.resize(size_t(count));
+        if (!readBytes(&_identifier[0], _identifier.size())) {
+            return fail("truncated record");
+        }
+        record.regionID = uint32_t(value);
+        record.regionIdentifier = _identifier.c_str();
+        return true;
+
+    case BITraceRecordRanging:
+        if (!readVarint(value) || !readVarint(count)) {
+            return fail("truncated record");
+        }
+        if (count > maximumSampleCount) {
+            return fail("too many beacons in ranging record");
+        }
+        record.regionID = uint32_t(value);
+        _samples.resize(size_t(count));
+        for (BIBeaconSample &sample : _samples) {
+            uint64_t number;
+            int64_t RSSI;
+            int64_t proximity;
+            int64_t accuracy;
+            if (!readVarint(number) || !readSignedVarint(RSSI) || !readSignedVarint(proximity) || !readSignedVarint(accuracy)) {
+                return fail("truncated record");
+            }
+            if (number >= _beacons.size()) {
+                return fail("undefined beacon");
+            }
+            sample.key = _beacons[size_t(number)];
+            sample.RSSI = int32_t(RSSI + trace::RSSIOffset);
+            sample.proximity = int32_t(proximity);
+            sample.accuracy = trace::meters(accuracy);
+        }
+        record.samples = _samples.data();
+        record.sampleCount = _samples.size();
+        return true;
+
+    case BITraceRecordRegionEvent:
+        if (!readVarint(value) || !readVarint(count)) {
+            return fail("truncated record");
+        }
+        record.regionID = uint32_t(value);
+        record.regionEvent = BIRegionEvent(count);
+        return true;
+
+    case BITraceRecordBluetoothState:
+        if (!readVarint(value)) {
+            return fail("truncated record");
+        }
+        record.bluetoothState = BIBluetoothState(value);
+        return true;
+
+    case BITraceRecordGap:
+        if (!readVarint(record.droppedRecords)) {
+            return fail("truncated record");
+        }
+        return true;
+    }
+    return fail("unknown record type");
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BITraceReader {
+    std::unique_ptr<bi::TraceReader> reader;
+};
+
+BITraceReaderRef BITraceReaderCreate(const char *path)
+{
+    std::unique_ptr<bi::TraceReader> reader = bi::TraceReader::open(path);
+    if (reader == nullptr) {
+        return nullptr;
+    }
+    return new BITraceReader{std::move(reader)};
+}
+
+void BITraceReaderDestroy(BITraceReaderRef reader)
+{
+    delete reader;
+}
+
+bool BITraceReaderNext(BITraceReaderRef reader, BITraceRecord *record)
+{
+    return reader->reader->next(*record);
+}
+
+const char *BITraceReaderGetError(BITraceReaderRef reader)
+{
+    return reader->reader->error();
+}
@@ -0,0 +1,62 @@
+//
+//  TraceReader.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BITrace.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bi {
+
+// Decodes a trace file through a fixed-size read buffer, so memory use does not depend on the length of the trace.
+class TraceReader {
+public:
+    // Returns nullptr if the file cannot be opened or does not start with the trace header.
+    static std::unique_ptr<TraceReader> open(const char *path);
+    ~TraceReader();
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    bool next(BITraceRecord &record);
+    const char *error() const { return _error.empty() ? nullptr : _error.c_str(); }
+
+private:
+    explicit TraceReader(FILE *file);
+
+    bool refill();
+    bool readByte(uint8_t &byte)
+    {
+        if (_position == _end && !refill()) {
+            return false;
+        }
+        byte = _buffer[_position++];
+        return true;
+    }
+    bool readVarint(uint64_t &value);
+    bool readSignedVarint(int64_t &value);
+    bool readBytes(void *destination, size_t count);
+    bool fail(const char *message);
+
+    FILE *_file;
+    std::vector<uint8_t> _buffer;
+    size_t _position = 0;
+    size_t _end = 0;
+
+    int64_t _microseconds = 0;
+    std::vector<BIBeaconKey> _beacons;
+    std::vector<BIBeaconSample> _samples;
+    std::string _identifier;
+    std::string _error;
+    bool _finished = false;
+};
+
+} // namespace bi
@@ -0,0 +1,322 @@
+//
+//  TraceRecorder.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "TraceRecorder.hpp"
+
+#include "TraceFormat.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bi {
+
+std::unique_ptr<TraceRecorder> TraceRecorder::create(const char *path, const BITraceRecorderConfiguration &configuration)
+{
+    FILE *file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+    return std::unique_ptr<TraceRecorder>(new TraceRecorder(file, configuration));
+}
+
+TraceRecorder::TraceRecorder(FILE *file, const BITraceRecorderConfiguration &configuration)
+    : _configuration(configuration)
+    , _file(file)
+{
+    _configuration.chunkSize = std::max<uint32_t>(_configuration.chunkSize, 256);
+    _configuration.maximumChunks = std::max<uint32_t>(_configuration.maximumChunks, 2);
+    _configuration.maximumBeacons = std::max<uint32_t>(_configuration.maximumBeacons, 1);
+    _bytesWritten = std::fwrite(trace::magic, 1, sizeof(trace::magic), _file);
+    std::fflush(_file);
+    _writer = std::thread(&TraceRecorder::runWriter, this);
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        queueCurrentChunkLocked();
+        _stopping = true;
+    }
+    _writerWake.notify_all();
+    _writer.join();
+    std::fclose(_file);
+}
+
+void TraceRecorder::startRecordLocked(double timestamp)
+{
+    _record.clear();
+    _definedInRecord.clear();
+    _encodedMicroseconds = _lastMicroseconds;
+    if (_pendingGap > 0) {
+        beginRecordLocked(BITraceRecordGap, timestamp);
+        trace::appendVarint(_record, _pendingGap);
+    }
+    if (_beaconNumbers.size() >= _configuration.maximumBeacons) {
+        _beaconNumbers.clear();
+        _pendingReset = true;
+    }
+    if (_pendingReset) {
+        // Stays pending until a record that carries it is committed.
+        beginRecordLocked(BITraceRecordBeaconReset, timestamp);
+    }
+}
+
+void TraceRecorder::beginRecordLocked(BITraceRecordType type, double timestamp)
+{
+    int64_t microseconds = trace::microseconds(timestamp);
+    _record.push_back(uint8_t(type));
+    trace::appendSignedVarint(_record, microseconds - _encodedMicroseconds);
+    _encodedMicroseconds = microseconds;
+}
+
+uint32_t TraceRecorder::beaconNumberLocked(const BIBeaconKey &key, double timestamp)
+{
+    // Look up first: emplace() would allocate a node for every known beacon.
+    auto it = _beaconNumbers.find(key);
+    if (it != _beaconNumbers.end()) {
+        return it->second;
+    }
+    uint32_t number = uint32_t(_beaconNumbers.size());
+    _beaconNumbers.emplace(key, number);
+    beginRecordLocked(BITraceRecordBeaconDefinition, timestamp);
+    _record.insert(_record.end(), key.proximityUUID, key.proximityUUID + sizeof(key.proximityUUID));
+    trace::appendVarint(_record, key.major);
+    trace::appendVarint(_record, key.minor);
+    _definedInRecord.push_back(key);
+    return number;
+}
+
+void TraceRecorder::commitRecordLocked()
+{
+    if (!makeRoomLocked(_record.size())) {
+        // Beacons defined by the dropped record get their numbers again when they are next recorded.
+        for (const BIBeaconKey &key : _definedInRecord) {
+            _beaconNumbers.erase(key);
+        }
+        _recordsDropped++;
+        _pendingGap++;
+        return;
+    }
+
+    bool wasEmpty = _current->bytes.empty();
+    _current->bytes.insert(_current->bytes.end(), _record.begin(), _record.end());
+    _lastMicroseconds = _encodedMicroseconds;
+    _pendingGap = 0;
+    _pendingReset = false;
+    _recordsWritten++;
+    if (wasEmpty) {
+        // Let the writer start the flush interval.
+        _currentOpened = Clock::now();
+        _writerWake.notify_one();
+    }
+}
+
+bool TraceRecorder::makeRoomLocked(size_t size)
+{
+    if (_current != nullptr) {
+        if (_current->bytes.empty() || _current->bytes.size() + size <= _configuration.chunkSize) {
+            return true;
+        }
+        queueCurrentChunkLocked();
+    }
+
+    if (!_free.empty()) {
+        _current = std::move(_free.back());
+        _free.pop_back();
+    } else if (_chunkCount < _configuration.maximumChunks) {
+        _current.reset(new Chunk());
+        _current->bytes.reserve(_configuration.chunkSize);
+        _chunkCount++;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void TraceRecorder::queueCurrentChunkLocked()
+{
+    if (_current == nullptr || _current->bytes.empty()) {
+        return;
+    }
+    _queued.push_back(std::move(_current));
+    _chunksQueued++;
+    _writerWake.notify_one();
+}
+
+void TraceRecorder::recordRegionDefinition(uint32_t regionID, double timestamp, const char *identifier)
+{
+    size_t length = identifier ? std::strlen(identifier) : 0;
+    std::lock_guard<std::mutex> lock(_mutex);
+    startRecordLocked(timestamp);
+    beginRecordLocked(BITraceRecordRegionDefinition, timestamp);
+    trace::appendVarint(_record, regionID);
+    trace::appendVarint(_record, length);
+    _record.insert(_record.end(), identifier, identifier + length);
+    commitRecordLocked();
+}
+
+void TraceRecorder::recordRanging(uint32_t regionID, double timestamp, const BIBeaconSample *samples, size_t count)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    startRecordLocked(timestamp);
+    _sampleNumbers.clear();
+    for (size_t i = 0; i < count; i++) {
+        _sampleNumbers.push_back(beaconNumberLocked(samples[i].key, timestamp));
+    }
+    beginRecordLocked(BITraceRecordRanging, timestamp);
+    trace::appendVarint(_record, regionID);
+    trace::appendVarint(_record, count);
+    for (size_t i = 0; i < count; i++) {
+        trace::appendVarint(_record, _sampleNumbers[i]);
+        trace::appendSignedVarint(_record, int64_t(samples[i].RSSI) - trace::RSSIOffset);
+        trace::appendSignedVarint(_record, samples[i].proximity);
+        trace::appendSignedVarint(_record, trace::millimeters(samples[i].accuracy));
+    }
+    commitRecordLocked();
+}
+
+void TraceRecorder::recordRegionEvent(uint32_t regionID, double timestamp, BIRegionEvent event)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    startRecordLocked(timestamp);
+    beginRecordLocked(BITraceRecordRegionEvent, timestamp);
+    trace::appendVarint(_record, regionID);
+    trace::appendVarint(_record, uint64_t(event));
+    commitRecordLocked();
+}
+
+void TraceRecorder::recordBluetoothState(double timestamp, BIBluetoothState state)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    startRecordLocked(timestamp);
+    beginRecordLocked(BITraceRecordBluetoothState, timestamp);
+    trace::appendVarint(_record, uint64_t(state));
+    commitRecordLocked();
+}
+
+void TraceRecorder::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    queueCurrentChunkLocked();
+    uint64_t target = _chunksQueued;
+    _chunkWritten.wait(lock, [&] { return _chunksWritten >= target; });
+}
+
+BITraceRecorderStatistics TraceRecorder::statistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    BITraceRecorderStatistics statistics;
+    statistics.recordsWritten = _recordsWritten;
+    statistics.recordsDropped = _recordsDropped;
+    statistics.bytesWritten = _bytesWritten;
+    return statistics;
+}
+
+void TraceRecorder::runWriter()
+{
+    const auto flushInterval =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(_configuration.flushInterval));
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        if (!_queued.empty()) {
+            std::unique_ptr<Chunk> chunk = std::move(_queued.front());
+            _queued.pop_front();
+            lock.unlock();
+            size_t written = std::fwrite(chunk->bytes.data(), 1, chunk->bytes.size(), _file);
+            std::fflush(_file);
+            lock.lock();
+            _bytesWritten += written;
+            chunk->bytes.clear();
+            _free.push_back(std::move(chunk));
+            _chunksWritten++;
+            _chunkWritten.notify_all();
+            continue;
+        }
+
+        if (_stopping) {
+            break;
+        }
+
+        if (_current != nullptr && !_current->bytes.empty()) {
+            // The current chunk may have been replaced while waiting, so check its age again afterwards.
+            _writerWake.wait_until(lock, _currentOpened + flushInterval);
+            if (_current != nullptr && !_current->bytes.empty() && Clock::now() >= _currentOpened + flushInterval) {
+                queueCurrentChunkLocked();
+            }
+            continue;
+        }
+
+        _writerWake.wait(lock);
+    }
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BITraceRecorder {
+    std::unique_ptr<bi::TraceRecorder> recorder;
+};
+
+BITraceRecorderConfiguration BITraceRecorderConfigurationMakeDefault(void)
+{
+    BITraceRecorderConfiguration configuration;
+    configuration.chunkSize = 64 * 1024;
+    configuration.maximumChunks = 16;
+    configuration.flushInterval = 5.0;
+    configuration.maximumBeacons = 4096;
+    return configuration;
+}
+
+BITraceRecorderRef BITraceRecorderCreate(const char *path, const BITraceRecorderConfiguration *configuration)
+{
+    std::unique_ptr<bi::TraceRecorder> recorder =
+        bi::TraceRecorder::create(path, configuration ? *configuration : BITraceRecorderConfigurationMakeDefault());
+    if (recorder == nullptr) {
+        return nullptr;
+    }
+    return new BITraceRecorder{std::move(recorder)};
+}
+
+void BITraceRecorderDestroy(BITraceRecorderRef recorder)
+{
+    delete recorder;
+}
+
+void BITraceRecorderRecordRegionDefinition(BITraceRecorderRef recorder, uint32_t regionID, double timestamp,
+                                           const char *identifier)
+{
+    recorder->recorder->recordRegionDefinition(regionID, timestamp, identifier);
+}
+
+void BITraceRecorderRecordRanging(BITraceRecorderRef recorder, uint32_t regionID, double timestamp,
+                                  const BIBeaconSample *samples, size_t count)
+{
+    recorder->recorder->recordRanging(regionID, timestamp, samples, count);
+}
+
+void BITraceRecorderRecordRegionEvent(BITraceRecorderRef recorder, uint32_t regionID, double timestamp,
+                                      BIRegionEvent event)
+{
+    recorder->recorder->recordRegionEvent(regionID, timestamp, event);
+}
+
+void BITraceRecorderRecordBluetoothState(BITraceRecorderRef recorder, double timestamp, BIBluetoothState state)
+{
+    recorder->recorder->recordBluetoothState(timestamp, state);
+}
+
+void BITraceRecorderFlush(BITraceRecorderRef recorder)
+{
+    recorder->recorder->flush();
+}
+
+BITraceRecorderStatistics BITraceRecorderGetStatistics(BITraceRecorderRef recorder)
+{
+    return recorder->recorder->statistics();
+}
@@ -0,0 +1,93 @@
+//
+//  TraceRecorder.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BITrace.h>
+
+#include "BeaconKey.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Records are encoded into _record under _mutex and then appended to the current chunk. Full chunks are queued for
+// the writer thread and recycled afterwards, so at most maximumChunks chunks exist at any time.
+class TraceRecorder {
+public:
+    // Returns nullptr if the file cannot be created.
+    static std::unique_ptr<TraceRecorder> create(const char *path, const BITraceRecorderConfiguration &configuration);
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    void recordRegionDefinition(uint32_t regionID, double timestamp, const char *identifier);
+    void recordRanging(uint32_t regionID, double timestamp, const BIBeaconSample *samples, size_t count);
+    void recordRegionEvent(uint32_t regionID, double timestamp, BIRegionEvent event);
+    void recordBluetoothState(double timestamp, BIBluetoothState state);
+    void flush();
+    BITraceRecorderStatistics statistics() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Chunk {
+        std::vector<uint8_t> bytes;
+    };
+
+    TraceRecorder(FILE *file, const BITraceRecorderConfiguration &configuration);
+
+    void startRecordLocked(double timestamp);
+    void beginRecordLocked(BITraceRecordType type, double timestamp);
+    uint32_t beaconNumberLocked(const BIBeaconKey &key, double timestamp);
+    void commitRecordLocked();
+    bool makeRoomLocked(size_t size);
+    void queueCurrentChunkLocked();
+    void runWriter();
+
+    BITraceRecorderConfiguration _configuration;
+    FILE *_file;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _writerWake;
+    std::condition_variable _chunkWritten;
+
+    // Encoding state. Rolled back if a record has to be dropped.
+    std::vector<uint8_t> _record;
+    std::unordered_map<BIBeaconKey, uint32_t, BeaconKeyHash> _beaconNumbers;
+    std::vector<BIBeaconKey> _definedInRecord;
+    std::vector<uint32_t> _sampleNumbers;
+    int64_t _lastMicroseconds = 0;
+    int64_t _encodedMicroseconds = 0;
+    uint64_t _pendingGap = 0;
+    bool _pendingReset = false;
+
+    std::unique_ptr<Chunk> _current;
+    Clock::time_point _currentOpened;
+    std::deque<std::unique_ptr<Chunk>> _queued;
+    std::vector<std::unique_ptr<Chunk>> _free;
+    uint32_t _chunkCount = 0;
+    uint64_t _chunksQueued = 0;
+    uint64_t _chunksWritten = 0;
+    bool _stopping = false;
+
+    uint64_t _recordsWritten = 0;
+    uint64_t _recordsDropped = 0;
+    uint64_t _bytesWritten = 0;
+    std::thread _writer;
+};
+
+} // namespace bi
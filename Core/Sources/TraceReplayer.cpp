@@ -0,0 +1,173 @@
+//
+//  TraceReplayer.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "TraceReplayer.hpp"
+
+namespace bi {
+
+static BIRangingPipelineConfiguration synchronousConfiguration(BIRangingPipelineConfiguration configuration)
+{
+    configuration.synchronous = true;
+    return configuration;
+}
+
+TraceReplayer::TraceReplayer(std::unique_ptr<TraceReader> reader, const BITraceReplayConfiguration &configuration,
+                             BITraceReplayHandlers handlers, void *context)
+    : _reader(std::move(reader))
+    , _handlers(handlers)
+    , _context(context)
+    , _smoothing(configuration.pipeline.smoothing)
+    , _pipeline(synchronousConfiguration(configuration.pipeline), BIDeliveryQueue{nullptr, nullptr}, &TraceReplayer::deliverBatch,
+                this)
+    , _regionMonitor(configuration.regionMonitor, &TraceReplayer::deliverTransition, this)
+{
+}
+
+const TraceReplayer::Region &TraceReplayer::region(uint32_t traceRegionID)
+{
+    auto it = _regions.find(traceRegionID);
+    if (it != _regions.end()) {
+        return it->second;
+    }
+    Region region;
+    region.pipelineID = _pipeline.addRegion(_smoothing);
+    region.monitorID = _regionMonitor.addRegion();
+    _traceRegionsByPipelineID.emplace(region.pipelineID, traceRegionID);
+    _traceRegionsByMonitorID.emplace(region.monitorID, traceRegionID);
+    return _regions.emplace(traceRegionID, region).first->second;
+}
+
+bool TraceReplayer::run()
+{
+    BITraceRecord record;
+    while (_reader->next(record)) {
+        if (_statistics.records == 0) {
+            _statistics.firstTimestamp = record.timestamp;
+        }
+        _statistics.records++;
+        _statistics.lastTimestamp = record.timestamp;
+        _regionMonitor.advance(record.timestamp);
+
+        switch (record.type) {
+        case BITraceRecordBeaconDefinition:
+        case BITraceRecordBeaconReset:
+            continue;
+        case BITraceRecordRanging:
+            _statistics.rangingRecords++;
+            _statistics.samples += record.sampleCount;
+            _pipeline.submit(region(record.regionID).pipelineID, record.timestamp, record.samples, record.sampleCount);
+            continue;
+        case BITraceRecordRegionDefinition:
+            region(record.regionID);
+            break;
+        case BITraceRecordRegionEvent:
+            _statistics.regionEvents++;
+            _regionMonitor.reportEvent(region(record.regionID).monitorID, record.timestamp, record.regionEvent);
+            break;
+        case BITraceRecordBluetoothState:
+            _statistics.bluetoothStateChanges++;
+            break;
+        case BITraceRecordGap:
+            _statistics.droppedRecords += record.droppedRecords;
+            break;
+        }
+        if (_handlers.record != nullptr) {
+            _handlers.record(&record, _context);
+        }
+    }
+    _pipeline.flush();
+    return _reader->error() == nullptr;
+}
+
+void TraceReplayer::deliverBatch(const BIRangingBatch *batch, void *context)
+{
+    TraceReplayer *replayer = static_cast<TraceReplayer *>(context);
+    replayer->_statistics.batchesDelivered++;
+
+    replayer->_batchRegions.assign(batch->regions, batch->regions + batch->regionCount);
+    for (BIRegionRangingResult &result : replayer->_batchRegions) {
+        result.regionID = replayer->_traceRegionsByPipelineID[result.regionID];
+        size_t inRange = 0;
+        for (size_t i = 0; i < result.beaconCount; i++) {
+            inRange += result.beacons[i].smoothedSignal.inRange ? 1 : 0;
+        }
+        replayer->_regionMonitor.reportRanging(replayer->_regions[result.regionID].monitorID, batch->timestamp, inRange);
+    }
+    if (replayer->_handlers.rangingBatch != nullptr) {
+        BIRangingBatch translated = *batch;
+        translated.regions = replayer->_batchRegions.data();
+        replayer->_handlers.rangingBatch(&translated, replayer->_context);
+    }
+}
+
+void TraceReplayer::deliverTransition(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context)
+{
+    TraceReplayer *replayer = static_cast<TraceReplayer *>(context);
+    if (replayer->_handlers.regionTransition != nullptr) {
+        replayer->_handlers.regionTransition(replayer->_traceRegionsByMonitorID[regionID], transition, timestamp,
+                                             replayer->_context);
+    }
+}
+
+BITraceReplayStatistics TraceReplayer::statistics() const
+{
+    BITraceReplayStatistics statistics = _statistics;
+    statistics.regionTransitions = _regionMonitor.statistics(0);
+    return statistics;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BITraceReplayer {
+    BITraceReplayer(std::unique_ptr<bi::TraceReader> reader, const BITraceReplayConfiguration &configuration,
+                    BITraceReplayHandlers handlers, void *context)
+        : replayer(std::move(reader), configuration, handlers, context)
+    {
+    }
+    bi::TraceReplayer replayer;
+};
+
+BITraceReplayConfiguration BITraceReplayConfigurationMakeDefault(void)
+{
+    BITraceReplayConfiguration configuration;
+    configuration.pipeline = BIRangingPipelineConfigurationMakeDefault();
+    configuration.regionMonitor = BIRegionMonitorConfigurationMakeDefault();
+    return configuration;
+}
+
+BITraceReplayerRef BITraceReplayerCreate(const char *path, const BITraceReplayConfiguration *configuration,
+                                         BITraceReplayHandlers handlers, void *context)
+{
+    std::unique_ptr<bi::TraceReader> reader = bi::TraceReader::open(path);
+    if (reader == nullptr) {
+        return nullptr;
+    }
+    return new BITraceReplayer(std::move(reader), configuration ? *configuration : BITraceReplayConfigurationMakeDefault(),
+                               handlers, context);
+}
+
+void BITraceReplayerDestroy(BITraceReplayerRef replayer)
+{
+    delete replayer;
+}
+
+bool BITraceReplayerRun(BITraceReplayerRef replayer)
+{
+    return replayer->replayer.run();
+}
+
+const char *BITraceReplayerGetError(BITraceReplayerRef replayer)
+{
+    return replayer->replayer.error();
+}
+
+BITraceReplayStatistics BITraceReplayerGetStatistics(BITraceReplayerRef replayer)
+{
+    return replayer->replayer.statistics();
+}
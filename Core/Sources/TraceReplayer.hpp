@@ -0,0 +1,57 @@
+//
+//  TraceReplayer.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BITrace.h>
+
+#include "RangingPipeline.hpp"
+#include "RegionMonitor.hpp"
+#include "TraceReader.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+class TraceReplayer {
+public:
+    TraceReplayer(std::unique_ptr<TraceReader> reader, const BITraceReplayConfiguration &configuration,
+                  BITraceReplayHandlers handlers, void *context);
+
+    bool run();
+    const char *error() const { return _reader->error(); }
+    BITraceReplayStatistics statistics() const;
+
+private:
+    // Pipeline and monitor IDs of a trace region.
+    struct Region {
+        uint32_t pipelineID;
+        uint32_t monitorID;
+    };
+
+    static void deliverBatch(const BIRangingBatch *batch, void *context);
+    static void deliverTransition(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context);
+
+    const Region &region(uint32_t traceRegionID);
+
+    std::unique_ptr<TraceReader> _reader;
+    BITraceReplayHandlers _handlers;
+    void *_context;
+    BISmoothingConfiguration _smoothing;
+    RangingPipeline _pipeline;
+    RegionMonitor _regionMonitor;
+
+    std::unordered_map<uint32_t, Region> _regions;                     // by trace region ID
+    std::unordered_map<uint32_t, uint32_t> _traceRegionsByPipelineID;
+    std::unordered_map<uint32_t, uint32_t> _traceRegionsByMonitorID;
+    std::vector<BIRegionRangingResult> _batchRegions;                  // batch regions with trace region IDs
+    BITraceReplayStatistics _statistics = {};
+};
+
+} // namespace bi
@@ -0,0 +1,106 @@
+//
+//  Trilateration.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "Trilateration.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bi {
+
+void setPositionCovariance(BIPositionEstimate &estimate, double xx, double xy, double yy)
+{
+    estimate.covarianceXX = xx;
+    estimate.covarianceXY = xy;
+    estimate.covarianceYY = yy;
+    estimate.uncertainty = std::sqrt(std::max(xx + yy, 0.0));
+}
+
+// A step that does not lower the cost is halved (up to four times) before the iteration gives up.
+BIPositionEstimate trilaterate(const RangeObservation *observations, size_t count, uint32_t maximumIterations,
+                               double convergenceThreshold, uint32_t &iterations)
+{
+    BIPositionEstimate estimate = {};
+    estimate.valid = false;
+    if (count < 3) {
+        return estimate;
+    }
+    double x = 0.0;
+    double y = 0.0;
+    double totalWeight = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        x += observations[i].weight * observations[i].x;
+        y += observations[i].weight * observations[i].y;
+        totalWeight += observations[i].weight;
+    }
+    x /= totalWeight;
+    y /= totalWeight;
+    double currentCost = rangeCost(observations, count, x, y);
+
+    double xx = 0.0;
+    double xy = 0.0;
+    double yy = 0.0;
+    double determinant = 0.0;
+    for (iterations = 1;; iterations++) {
+        // Normal equations: (J^T W J) step = -J^T W r.
+        xx = xy = yy = 0.0;
+        double gx = 0.0;
+        double gy = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            const RangeObservation &observation = observations[i];
+            double dx = x - observation.x;
+            double dy = y - observation.y;
+            double distance = std::hypot(dx, dy);
+            if (distance < 1e-9) {
+                continue; // the gradient of the distance is undefined on top of the anchor
+            }
+            double jx = dx / distance;
+            double jy = dy / distance;
+            double residual = distance - observation.range;
+            xx += observation.weight * jx * jx;
+            xy += observation.weight * jx * jy;
+            yy += observation.weight * jy * jy;
+            gx += observation.weight * jx * residual;
+            gy += observation.weight * jy * residual;
+        }
+        determinant = xx * yy - xy * xy;
+        if (!(determinant > 1e-12 * (xx + yy) * (xx + yy))) {
+            return estimate; // the anchors (as seen from here) are on one line
+        }
+        double stepX = -(yy * gx - xy * gy) / determinant;
+        double stepY = -(xx * gy - xy * gx) / determinant;
+        double nextCost = rangeCost(observations, count, x + stepX, y + stepY);
+        for (int halvings = 0; halvings < 4 && nextCost > currentCost; halvings++) {
+            stepX *= 0.5;
+            stepY *= 0.5;
+            nextCost = rangeCost(observations, count, x + stepX, y + stepY);
+        }
+        if (nextCost > currentCost) {
+            break;
+        }
+        x += stepX;
+        y += stepY;
+        currentCost = nextCost;
+        if (std::hypot(stepX, stepY) < convergenceThreshold || iterations >= maximumIterations) {
+            break;
+        }
+    }
+
+    // The covariance is the inverse of J^T W J, scaled up by the reduced chi-square when the residuals are larger than
+    // the range errors predict.
+    size_t degreesOfFreedom = count - 2;
+    double scale = degreesOfFreedom > 1 ? std::max(1.0, currentCost / double(degreesOfFreedom)) : 1.0;
+    estimate.valid = true;
+    estimate.x = x;
+    estimate.y = y;
+    estimate.floor = 0;
+    estimate.beaconCount = uint32_t(count);
+    setPositionCovariance(estimate, scale * yy / determinant, -scale * xy / determinant, scale * xx / determinant);
+    return estimate;
+}
+
+} // namespace bi
@@ -0,0 +1,48 @@
+//
+//  Trilateration.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIPositionEngine.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace bi {
+
+// A distance to an anchor at a known position: a beacon for the position engine, a receiver for the fusion engine.
+struct RangeObservation {
+    double x;
+    double y;
+    double range;
+    double weight; // inverse variance of range
+    uint32_t index; // of the anchor
+    int32_t floor;
+};
+
+// Sum of the squared range residuals at (x, y), weighted by the inverse variance of the ranges. Inline, since the
+// particle filter evaluates it for every particle.
+inline double rangeCost(const RangeObservation *observations, size_t count, double x, double y)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        const RangeObservation &observation = observations[i];
+        double residual = std::hypot(x - observation.x, y - observation.y) - observation.range;
+        sum += observation.weight * residual * residual;
+    }
+    return sum;
+}
+
+// Gauss-Newton on the range residuals, starting from the centroid of the anchors weighted by their inverse variance.
+// Needs at least three anchors that are not on one line; the floor of the estimate is left to the caller.
+BIPositionEstimate trilaterate(const RangeObservation *observations, size_t count, uint32_t maximumIterations,
+                               double convergenceThreshold, uint32_t &iterations);
+
+void setPositionCovariance(BIPositionEstimate &estimate, double xx, double xy, double yy);
+
+} // namespace bi
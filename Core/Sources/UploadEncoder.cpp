@@ -0,0 +1,350 @@
+//
+//  UploadEncoder.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "UploadEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bi {
+
+namespace {
+
+enum Column { Beacons, Ticks, SightingBeacons, Accuracies };
+
+} // namespace
+
+UploadEncoder::UploadEncoder(const BIUploadEncoderConfiguration &configuration, const uint8_t deviceID[16],
+                             uint64_t sequenceNumber, BIUploadHandler handler, void *context)
+    : _configuration(configuration)
+    , _sequenceNumber(sequenceNumber)
+    , _handler(handler)
+    , _context(context)
+{
+    std::memcpy(_deviceID, deviceID, sizeof(_deviceID));
+}
+
+void UploadEncoder::add(double timestamp, const BIBeaconSample *samples, size_t count)
+{
+    beginTick(timestamp);
+    for (size_t i = 0; i < count; i++) {
+        addSighting(samples[i].key, samples[i].RSSI, samples[i].proximity, samples[i].accuracy);
+    }
+}
+
+void UploadEncoder::add(const BIRangingBatch &batch)
+{
+    beginTick(batch.timestamp);
+    for (size_t region = 0; region < batch.regionCount; region++) {
+        const BIRegionRangingResult &result = batch.regions[region];
+        for (size_t i = 0; i < result.beaconCount; i++) {
+            const BIRangedBeacon &beacon = result.beacons[i];
+            if (beacon.rawSignal.inRange) {
+                addSighting(beacon.key, beacon.rawSignal.RSSI, beacon.rawSignal.proximity, beacon.rawSignal.accuracy);
+            }
+        }
+    }
+}
+
+void UploadEncoder::addRegionEvent(uint32_t regionID, double timestamp, BIRegionEvent event)
+{
+    int64_t time = upload::milliseconds(timestamp);
+    if (!_regionEvents.empty() && time < _regionEvents.back().time) {
+        flushRegionEvents();
+    }
+    _regionEvents.push_back({time, regionID, event});
+}
+
+void UploadEncoder::advance(double timestamp)
+{
+    finishDue(upload::milliseconds(timestamp));
+}
+
+// Starts a tick unless the timestamp belongs to the current one. Only a new tick may finish the upload, so that a tick
+// never spans two uploads.
+void UploadEncoder::beginTick(double timestamp)
+{
+    int64_t time = upload::milliseconds(timestamp);
+    if (!_tickTimes.empty() && time == _tickTimes.back()) {
+        return;
+    }
+    if (!_tickTimes.empty() && time < _tickTimes.back()) {
+        flushSightings();
+    }
+    finishDue(time);
+    _tickTimes.push_back(time);
+    _tickEnds.push_back(uint32_t(_sightings.size()));
+}
+
+// Finishes the region event upload and the sighting upload if they are due at time. The current tick only counts as
+// complete once time is past it.
+void UploadEncoder::finishDue(int64_t time)
+{
+    if (!_regionEvents.empty() &&
+        upload::seconds(time - _regionEvents.front().time) >= _configuration.maximumEventDelay) {
+        flushRegionEvents();
+    }
+    if (_tickTimes.empty() || time <= _tickTimes.back()) {
+        return;
+    }
+    dropEmptyTick();
+    if (!_tickTimes.empty() && (_sightings.size() >= _configuration.maximumSightings ||
+                                upload::seconds(time - _tickTimes.front()) >= _configuration.maximumAge)) {
+        flushSightings();
+    }
+}
+
+uint32_t UploadEncoder::tickStart() const
+{
+    return _tickEnds.size() > 1 ? _tickEnds[_tickEnds.size() - 2] : 0;
+}
+
+// A tick whose samples were all merged into nothing (or that had no samples) is not encoded.
+void UploadEncoder::dropEmptyTick()
+{
+    if (!_tickEnds.empty() && _tickEnds.back() == tickStart()) {
+        _tickTimes.pop_back();
+        _tickEnds.pop_back();
+    }
+}
+
+void UploadEncoder::addSighting(const BIBeaconKey &key, int32_t RSSI, int32_t proximity, double accuracy)
+{
+    auto inserted = _beaconIndexes.emplace(key, uint32_t(_beacons.size()));
+    uint32_t beacon = inserted.first->second;
+    if (inserted.second) {
+        _beacons.push_back(key);
+        _lastSightings.push_back(None);
+    }
+
+    uint32_t last = _lastSightings[beacon];
+    if (last != None && last >= tickStart()) {
+        Sighting &sighting = _sightings[last];
+        if (RSSI < 0 && (sighting.RSSI >= 0 || RSSI > sighting.RSSI)) {
+            sighting = {beacon, RSSI, proximity, accuracy};
+        }
+        return;
+    }
+    _lastSightings[beacon] = uint32_t(_sightings.size());
+    _sightings.push_back({beacon, RSSI, proximity, accuracy});
+    _tickEnds.back() = uint32_t(_sightings.size());
+}
+
+bool UploadEncoder::flush()
+{
+    bool regionEvents = flushRegionEvents();
+    return flushSightings() || regionEvents;
+}
+
+bool UploadEncoder::flushSightings()
+{
+    if (_sightings.empty()) {
+        clear();
+        return false;
+    }
+    dropEmptyTick();
+    encode();
+    _statistics.ticks += _tickTimes.size();
+    _statistics.sightings += _sightings.size();
+    clear();
+    finish();
+    return true;
+}
+
+bool UploadEncoder::flushRegionEvents()
+{
+    if (_regionEvents.empty()) {
+        return false;
+    }
+    _bytes.assign(upload::regionEventMagic, upload::regionEventMagic + sizeof(upload::regionEventMagic));
+    _bytes.insert(_bytes.end(), _deviceID, _deviceID + sizeof(_deviceID));
+    trace::appendVarint(_bytes, _sequenceNumber);
+    trace::appendSignedVarint(_bytes, _regionEvents.front().time);
+    trace::appendVarint(_bytes, _regionEvents.size());
+    int64_t previous = _regionEvents.front().time;
+    for (const RegionEvent &event : _regionEvents) {
+        trace::appendVarint(_bytes, uint64_t(event.time - previous));
+        trace::appendVarint(_bytes, event.regionID);
+        trace::appendVarint(_bytes, uint64_t(event.event));
+        previous = event.time;
+    }
+    upload::appendChecksum(_bytes);
+    _statistics.regionEvents += _regionEvents.size();
+    _regionEvents.clear();
+    finish();
+    return true;
+}
+
+// Counts the upload in _bytes and passes it to the handler.
+void UploadEncoder::finish()
+{
+    _statistics.uploads++;
+    _statistics.bytes += _bytes.size();
+    _sequenceNumber++;
+    if (_handler != nullptr) {
+        _handler(_bytes.data(), _bytes.size(), _context);
+    }
+}
+
+void UploadEncoder::clear()
+{
+    _beaconIndexes.clear();
+    _beacons.clear();
+    _lastSightings.clear();
+    _sightings.clear();
+    _tickTimes.clear();
+    _tickEnds.clear();
+}
+
+void UploadEncoder::encode()
+{
+    // Sort the beacons and collect their UUIDs.
+    _order.resize(_beacons.size());
+    for (uint32_t i = 0; i < _order.size(); i++) {
+        _order[i] = i;
+    }
+    std::sort(_order.begin(), _order.end(),
+              [this](uint32_t lhs, uint32_t rhs) { return beaconKeyLess(_beacons[lhs], _beacons[rhs]); });
+    _ranks.resize(_beacons.size());
+    _UUIDs.clear();
+    for (std::vector<uint8_t> &column : _columns) {
+        column.clear();
+    }
+
+    const BIBeaconKey *previous = nullptr;
+    uint64_t UUIDCount = 0;
+    for (uint32_t rank = 0; rank < _order.size(); rank++) {
+        const BIBeaconKey &key = _beacons[_order[rank]];
+        _ranks[_order[rank]] = rank;
+        if (previous == nullptr ||
+            std::memcmp(previous->proximityUUID, key.proximityUUID, sizeof(key.proximityUUID)) != 0) {
+            _UUIDs.insert(_UUIDs.end(), key.proximityUUID, key.proximityUUID + sizeof(key.proximityUUID));
+            UUIDCount++;
+        }
+        trace::appendVarint(_columns[Beacons], UUIDCount - 1);
+        trace::appendSignedVarint(_columns[Beacons], int64_t(key.major) - (previous ? previous->major : 0));
+        trace::appendSignedVarint(_columns[Beacons], int64_t(key.minor) - (previous ? previous->minor : 0));
+        previous = &key;
+    }
+
+    // Renumber the sightings and sort each tick by beacon.
+    for (Sighting &sighting : _sightings) {
+        sighting.beacon = _ranks[sighting.beacon];
+    }
+    uint32_t tickStart = 0;
+    for (size_t tick = 0; tick < _tickTimes.size(); tick++) {
+        uint32_t tickEnd = _tickEnds[tick];
+        std::sort(_sightings.begin() + tickStart, _sightings.begin() + tickEnd,
+                  [](const Sighting &lhs, const Sighting &rhs) { return lhs.beacon < rhs.beacon; });
+        trace::appendVarint(_columns[Ticks], uint64_t(_tickTimes[tick] - _tickTimes[tick > 0 ? tick - 1 : 0]));
+        trace::appendVarint(_columns[Ticks], tickEnd - tickStart);
+        for (uint32_t i = tickStart; i < tickEnd; i++) {
+            uint32_t gap = i > tickStart ? _sightings[i].beacon - _sightings[i - 1].beacon - 1 : _sightings[i].beacon;
+            trace::appendVarint(_columns[SightingBeacons], gap);
+            trace::appendVarint(_columns[Accuracies], upload::encodeAccuracy(_sightings[i].accuracy));
+        }
+        tickStart = tickEnd;
+    }
+
+    // Header, columns and checksum.
+    _bytes.assign(upload::magic, upload::magic + sizeof(upload::magic));
+    _bytes.insert(_bytes.end(), _deviceID, _deviceID + sizeof(_deviceID));
+    trace::appendVarint(_bytes, _sequenceNumber);
+    trace::appendSignedVarint(_bytes, _tickTimes.front());
+    trace::appendVarint(_bytes, _tickTimes.size());
+    trace::appendVarint(_bytes, _sightings.size());
+    trace::appendVarint(_bytes, UUIDCount);
+    trace::appendVarint(_bytes, _beacons.size());
+    for (const std::vector<uint8_t> &column : _columns) {
+        trace::appendVarint(_bytes, column.size());
+    }
+    _bytes.insert(_bytes.end(), _UUIDs.begin(), _UUIDs.end());
+    _bytes.insert(_bytes.end(), _columns[Beacons].begin(), _columns[Beacons].end());
+    _bytes.insert(_bytes.end(), _columns[Ticks].begin(), _columns[Ticks].end());
+    _bytes.insert(_bytes.end(), _columns[SightingBeacons].begin(), _columns[SightingBeacons].end());
+    for (const Sighting &sighting : _sightings) {
+        _bytes.push_back(upload::encodeRSSI(sighting.RSSI));
+    }
+    size_t proximities = _bytes.size();
+    _bytes.resize(proximities + (_sightings.size() + 3) / 4, 0);
+    for (size_t i = 0; i < _sightings.size(); i++) {
+        _bytes[proximities + i / 4] |= uint8_t(upload::encodeProximity(_sightings[i].proximity) << (2 * (i % 4)));
+    }
+    _bytes.insert(_bytes.end(), _columns[Accuracies].begin(), _columns[Accuracies].end());
+    upload::appendChecksum(_bytes);
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIUploadEncoder {
+    BIUploadEncoder(const BIUploadEncoderConfiguration &configuration, const uint8_t deviceID[16],
+                    uint64_t sequenceNumber, BIUploadHandler handler, void *context)
+        : encoder(configuration, deviceID, sequenceNumber, handler, context)
+    {
+    }
+    bi::UploadEncoder encoder;
+};
+
+BIUploadEncoderConfiguration BIUploadEncoderConfigurationMakeDefault(void)
+{
+    BIUploadEncoderConfiguration configuration;
+    configuration.maximumSightings = 4096;
+    configuration.maximumAge = 300.0;
+    configuration.maximumEventDelay = 10.0;
+    return configuration;
+}
+
+BIUploadEncoderRef BIUploadEncoderCreate(const BIUploadEncoderConfiguration *configuration, const uint8_t deviceID[16],
+                                         uint64_t sequenceNumber, BIUploadHandler handler, void *context)
+{
+    return new BIUploadEncoder(configuration ? *configuration : BIUploadEncoderConfigurationMakeDefault(), deviceID,
+                               sequenceNumber, handler, context);
+}
+
+void BIUploadEncoderDestroy(BIUploadEncoderRef encoder)
+{
+    delete encoder;
+}
+
+void BIUploadEncoderAddSamples(BIUploadEncoderRef encoder, double timestamp, const BIBeaconSample *samples,
+                               size_t count)
+{
+    encoder->encoder.add(timestamp, samples, count);
+}
+
+void BIUploadEncoderAddBatch(BIUploadEncoderRef encoder, const BIRangingBatch *batch)
+{
+    encoder->encoder.add(*batch);
+}
+
+void BIUploadEncoderAddRegionEvent(BIUploadEncoderRef encoder, uint32_t regionID, double timestamp,
+                                   BIRegionEvent event)
+{
+    encoder->encoder.addRegionEvent(regionID, timestamp, event);
+}
+
+void BIUploadEncoderAdvance(BIUploadEncoderRef encoder, double timestamp)
+{
+    encoder->encoder.advance(timestamp);
+}
+
+bool BIUploadEncoderFlush(BIUploadEncoderRef encoder)
+{
+    return encoder->encoder.flush();
+}
+
+uint64_t BIUploadEncoderGetSequenceNumber(BIUploadEncoderRef encoder)
+{
+    return encoder->encoder.sequenceNumber();
+}
+
+BIUploadEncoderStatistics BIUploadEncoderGetStatistics(BIUploadEncoderRef encoder)
+{
+    return encoder->encoder.statistics();
+}
@@ -0,0 +1,88 @@
+//
+//  UploadEncoder.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIUpload.h>
+
+#include "BeaconKey.hpp"
+#include "UploadFormat.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Sightings are collected in the order they arrive, with beacons numbered in the order they first appear. Encoding
+// sorts the beacons, renumbers the sightings and writes the columns; all buffers are kept for the next upload. Region
+// events are few and written as they are, in an upload of their own with its own deadline.
+class UploadEncoder {
+public:
+    UploadEncoder(const BIUploadEncoderConfiguration &configuration, const uint8_t deviceID[16], uint64_t sequenceNumber,
+                  BIUploadHandler handler, void *context);
+
+    void add(double timestamp, const BIBeaconSample *samples, size_t count);
+    void add(const BIRangingBatch &batch);
+    void addRegionEvent(uint32_t regionID, double timestamp, BIRegionEvent event);
+    void advance(double timestamp);
+    bool flush();
+
+    uint64_t sequenceNumber() const { return _sequenceNumber; }
+    const BIUploadEncoderStatistics &statistics() const { return _statistics; }
+
+private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Sighting {
+        uint32_t beacon;
+        int32_t RSSI;
+        int32_t proximity;
+        double accuracy;
+    };
+
+    struct RegionEvent {
+        int64_t time; // in milliseconds
+        uint32_t regionID;
+        BIRegionEvent event;
+    };
+
+    void beginTick(double timestamp);
+    void finishDue(int64_t time);
+    uint32_t tickStart() const;
+    void dropEmptyTick();
+    void addSighting(const BIBeaconKey &key, int32_t RSSI, int32_t proximity, double accuracy);
+    bool flushSightings();
+    bool flushRegionEvents();
+    void encode();
+    void clear();
+    void finish();
+
+    BIUploadEncoderConfiguration _configuration;
+    uint8_t _deviceID[upload::deviceIDSize];
+    uint64_t _sequenceNumber;
+    BIUploadHandler _handler;
+    void *_context;
+
+    std::unordered_map<BIBeaconKey, uint32_t, BeaconKeyHash> _beaconIndexes;
+    std::vector<BIBeaconKey> _beacons;
+    std::vector<uint32_t> _lastSightings; // per beacon, its sighting in the current tick or None
+    std::vector<Sighting> _sightings;
+    std::vector<int64_t> _tickTimes; // in milliseconds
+    std::vector<uint32_t> _tickEnds; // one past the last sighting of each tick
+    std::vector<RegionEvent> _regionEvents;
+
+    // Scratch space of encode().
+    std::vector<uint32_t> _order;
+    std::vector<uint32_t> _ranks;
+    std::vector<uint8_t> _UUIDs;
+    std::vector<uint8_t> _columns[4];
+    std::vector<uint8_t> _bytes;
+
+    BIUploadEncoderStatistics _statistics = {};
+};
+
+} // namespace bi
@@ -0,0 +1,113 @@
+//
+//  UploadFormat.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Building blocks of the upload format described in BIUpload.h.
+
+#pragma once
+
+#include <BICore/BIUpload.h>
+
+#include "TraceFormat.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace bi {
+namespace upload {
+
+const char magic[8] = {'B', 'I', 'S', 'I', 'G', 'H', 'T', 1};
+const char regionEventMagic[8] = {'B', 'I', 'E', 'V', 'E', 'N', 'T', 1};
+
+const size_t deviceIDSize = 16;
+const size_t UUIDSize = 16;
+const size_t checksumSize = 4;
+
+// Accuracies are stored in centimeters plus one, up to 100 km.
+const int64_t maximumAccuracy = 10000000;
+
+inline uint32_t checksum(const uint8_t *bytes, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+inline void appendChecksum(std::vector<uint8_t> &bytes)
+{
+    uint32_t hash = checksum(bytes.data(), bytes.size());
+    for (size_t i = 0; i < checksumSize; i++) {
+        bytes.push_back(uint8_t(hash >> (8 * i)));
+    }
+}
+
+inline BIUploadKind kind(const uint8_t *bytes, size_t length)
+{
+    if (length >= sizeof(magic) && std::memcmp(bytes, magic, sizeof(magic)) == 0) {
+        return BIUploadKindSightings;
+    }
+    if (length >= sizeof(regionEventMagic) && std::memcmp(bytes, regionEventMagic, sizeof(regionEventMagic)) == 0) {
+        return BIUploadKindRegionEvents;
+    }
+    return BIUploadKindNone;
+}
+
+inline int64_t milliseconds(double timestamp)
+{
+    return int64_t(std::llround(timestamp * 1e3));
+}
+
+inline double seconds(int64_t milliseconds)
+{
+    return double(milliseconds) / 1e3;
+}
+
+inline uint8_t encodeRSSI(int32_t RSSI)
+{
+    return RSSI >= 0 ? 0 : RSSI <= -255 ? 255 : uint8_t(-RSSI);
+}
+
+inline uint8_t encodeProximity(int32_t proximity)
+{
+    return proximity >= BIProximityUnknown && proximity <= BIProximityFar ? uint8_t(proximity) : 0;
+}
+
+inline uint64_t encodeAccuracy(double accuracy)
+{
+    if (!(accuracy >= 0.0)) {
+        return 0;
+    }
+    double centimeters = accuracy * 100.0;
+    return uint64_t(centimeters < double(maximumAccuracy) ? std::llround(centimeters) : maximumAccuracy) + 1;
+}
+
+inline double decodeAccuracy(uint64_t value)
+{
+    return value == 0 ? -1.0 : double(value - 1) / 100.0;
+}
+
+inline bool readVarint(const uint8_t *&position, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (position == end) {
+            return false;
+        }
+        uint8_t byte = *position++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace upload
+} // namespace bi
@@ -0,0 +1,580 @@
+//
+//  UploadQueue.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "UploadQueue.hpp"
+
+#include "UploadReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bi {
+
+static_assert(sizeof(UploadQueue::SegmentHeader) == 16, "unexpected segment header layout");
+static_assert(sizeof(UploadQueue::RecordHeader) == 8, "unexpected record header layout");
+
+namespace {
+
+const char magic[8] = {'B', 'I', 'Q', 'U', 'E', 'U', 'E', 1};
+const char segmentSuffix[] = ".segment";
+const uint64_t segmentHeaderSize = sizeof(UploadQueue::SegmentHeader);
+const uint64_t recordHeaderSize = sizeof(UploadQueue::RecordHeader);
+
+bool writeAll(int file, const void *bytes, size_t count, uint64_t offset)
+{
+    const uint8_t *position = static_cast<const uint8_t *>(bytes);
+    while (count > 0) {
+        ssize_t written = pwrite(file, position, count, off_t(offset));
+        if (written < 0) {
+            return false;
+        }
+        position += written;
+        count -= size_t(written);
+        offset += uint64_t(written);
+    }
+    return true;
+}
+
+bool readAll(int file, void *bytes, size_t count, uint64_t offset)
+{
+    uint8_t *position = static_cast<uint8_t *>(bytes);
+    while (count > 0) {
+        ssize_t read = pread(file, position, count, off_t(offset));
+        if (read <= 0) {
+            return false;
+        }
+        position += read;
+        count -= size_t(read);
+        offset += uint64_t(read);
+    }
+    return true;
+}
+
+// Parses the number of a segment from its file name, e.g. "000000000000002a.segment".
+bool parseSegmentName(const char *name, uint64_t &number)
+{
+    if (std::strlen(name) != 16 + sizeof(segmentSuffix) - 1 || std::strcmp(name + 16, segmentSuffix) != 0) {
+        return false;
+    }
+    number = 0;
+    for (size_t i = 0; i < 16; i++) {
+        char c = name[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) {
+            return false;
+        }
+        number = number << 4 | uint64_t(digit);
+    }
+    return true;
+}
+
+// A record is valid if it holds an upload with a matching checksum; anything else is a write that was cut off.
+bool isValidUpload(const uint8_t *bytes, size_t length)
+{
+    if (upload::kind(bytes, length) == BIUploadKindNone || length < sizeof(upload::magic) + upload::checksumSize) {
+        return false;
+    }
+    const uint8_t *end = bytes + length - upload::checksumSize;
+    uint32_t expected = 0;
+    for (size_t i = 0; i < upload::checksumSize; i++) {
+        expected |= uint32_t(end[i]) << (8 * i);
+    }
+    return upload::checksum(bytes, length - upload::checksumSize) == expected;
+}
+
+} // namespace
+
+std::unique_ptr<UploadQueue> UploadQueue::open(const char *directory, const BIUploadQueueConfiguration &configuration,
+                                               const uint8_t deviceID[16], BIUploadSendFunction send, void *context)
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        return nullptr;
+    }
+    std::unique_ptr<UploadQueue> queue(new UploadQueue(directory, configuration, send, context));
+    uint64_t sequenceNumber;
+    if (!queue->load(sequenceNumber)) {
+        return nullptr;
+    }
+    queue->_encoder.reset(
+        new UploadEncoder(configuration.encoder, deviceID, sequenceNumber, &UploadQueue::handleUpload, queue.get()));
+    // Seeding the jitter with the device ID keeps devices apart and replays reproducible.
+    uint64_t seed[2];
+    std::memcpy(seed, deviceID, sizeof(seed));
+    queue->_randomState = seed[0] ^ seed[1];
+    return queue;
+}
+
+UploadQueue::UploadQueue(const char *directory, const BIUploadQueueConfiguration &configuration,
+                         BIUploadSendFunction send, void *context)
+    : _configuration(configuration)
+    , _directory(directory)
+    , _send(send)
+    , _context(context)
+    , _nextAttempt(-std::numeric_limits<double>::infinity())
+{
+    _configuration.segmentSize = std::max<uint32_t>(_configuration.segmentSize, 4096);
+    _configuration.maximumLogSize = uint32_t(
+        std::min<uint64_t>(std::max<uint64_t>(_configuration.maximumLogSize, 2 * uint64_t(_configuration.segmentSize)),
+                           UINT32_MAX));
+}
+
+UploadQueue::~UploadQueue()
+{
+    for (const Segment &segment : _segments) {
+        close(segment.file);
+    }
+}
+
+// MARK: - Segments
+
+bool UploadQueue::load(uint64_t &sequenceNumber)
+{
+    DIR *directory = opendir(_directory.c_str());
+    if (directory == nullptr) {
+        return false;
+    }
+    std::vector<uint64_t> numbers;
+    while (struct dirent *entry = readdir(directory)) {
+        uint64_t number;
+        if (parseSegmentName(entry->d_name, number)) {
+            numbers.push_back(number);
+        }
+    }
+    closedir(directory);
+    std::sort(numbers.begin(), numbers.end());
+
+    sequenceNumber = 0;
+    for (uint64_t number : numbers) {
+        int file = ::open(path(number).c_str(), O_RDWR);
+        if (file < 0) {
+            return false;
+        }
+        _segments.push_back({number, file, 0, 0});
+        sequenceNumber = std::max(sequenceNumber, loadSegment(_segments.back()));
+        _logSize += _segments.back().size;
+    }
+
+    // Segments without pending records are only kept for the sequence number, which the newest one carries as well.
+    for (size_t i = 0; i + 1 < _segments.size();) {
+        if (_segments[i].pendingRecords == 0) {
+            removeSegment(_segments.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    if (!_segments.empty() && _segments.back().size >= segmentHeaderSize) {
+        return true;
+    }
+    return startSegment(sequenceNumber);
+}
+
+// Reads the records of a segment up to the first one that is cut off or damaged, and cuts the file off there. Returns
+// the sequence number that follows everything in the segment.
+uint64_t UploadQueue::loadSegment(Segment &segment)
+{
+    struct stat status;
+    SegmentHeader header;
+    if (fstat(segment.file, &status) != 0 || uint64_t(status.st_size) < segmentHeaderSize ||
+        !readAll(segment.file, &header, sizeof(header), 0) || std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        // Not a segment of this version: it is replaced by a new one.
+        return 0;
+    }
+    uint64_t fileSize = uint64_t(status.st_size);
+    std::vector<uint8_t> bytes(fileSize - segmentHeaderSize);
+    if (!readAll(segment.file, bytes.data(), bytes.size(), segmentHeaderSize)) {
+        return 0;
+    }
+
+    uint64_t sequenceNumber = header.sequenceNumber;
+    uint64_t offset = 0;
+    while (bytes.size() - offset >= recordHeaderSize) {
+        RecordHeader record;
+        std::memcpy(&record, bytes.data() + offset, sizeof(record));
+        const uint8_t *payload = bytes.data() + offset + recordHeaderSize;
+        uint8_t deviceID[upload::deviceIDSize];
+        uint64_t recordSequenceNumber;
+        if (record.length > bytes.size() - offset - recordHeaderSize || !isValidUpload(payload, record.length) ||
+            !UploadReader::peek(payload, record.length, deviceID, recordSequenceNumber)) {
+            break;
+        }
+        if (record.state == Pending) {
+            Priority priority =
+                upload::kind(payload, record.length) == BIUploadKindRegionEvents ? RegionEvents : Sightings;
+            Record entry = {segment.number, segmentHeaderSize + offset, record.length};
+            if (_pending[priority].emplace(recordSequenceNumber, entry).second) {
+                segment.pendingRecords++;
+                _statistics.recoveredUploads++;
+            }
+        }
+        sequenceNumber = std::max(sequenceNumber, recordSequenceNumber + 1);
+        offset += recordHeaderSize + record.length;
+    }
+    segment.size = segmentHeaderSize + offset;
+    if (segment.size < fileSize && ftruncate(segment.file, off_t(segment.size)) != 0) {
+        _statistics.failedIO++;
+    }
+    return sequenceNumber;
+}
+
+bool UploadQueue::startSegment(uint64_t sequenceNumber)
+{
+    uint64_t number = _segments.empty() ? 0 : _segments.back().number + 1;
+    int file = ::open(path(number).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        return false;
+    }
+    SegmentHeader header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.sequenceNumber = sequenceNumber;
+    if (!writeAll(file, &header, sizeof(header), 0)) {
+        close(file);
+        unlink(path(number).c_str());
+        return false;
+    }
+    _segments.push_back({number, file, segmentHeaderSize, 0});
+    _logSize += segmentHeaderSize;
+
+    // The previous segment only carried the sequence number if none of its records is pending.
+    if (_segments.size() > 1 && _segments[_segments.size() - 2].pendingRecords == 0) {
+        removeSegment(_segments.end() - 2);
+    }
+    return true;
+}
+
+std::deque<UploadQueue::Segment>::iterator UploadQueue::findSegment(uint64_t number)
+{
+    return std::find_if(_segments.begin(), _segments.end(),
+                        [number](const Segment &segment) { return segment.number == number; });
+}
+
+void UploadQueue::removeSegment(std::deque<Segment>::iterator segment)
+{
+    close(segment->file);
+    unlink(path(segment->number).c_str());
+    _logSize -= segment->size;
+    _segments.erase(segment);
+}
+
+std::string UploadQueue::path(uint64_t number) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(number), segmentSuffix);
+    return _directory + "/" + name;
+}
+
+// MARK: - Appending
+
+void UploadQueue::handleUpload(const uint8_t *bytes, size_t length, void *context)
+{
+    static_cast<UploadQueue *>(context)->append(bytes, length);
+}
+
+void UploadQueue::append(const uint8_t *bytes, size_t length)
+{
+    uint64_t recordSize = recordHeaderSize + length;
+    bool regionEvents = upload::kind(bytes, length) == BIUploadKindRegionEvents;
+    if (segmentHeaderSize + recordSize <= _configuration.maximumLogSize) {
+        Segment &newest = _segments.back();
+        if (newest.size > segmentHeaderSize && newest.size + recordSize > _configuration.segmentSize &&
+            !startSegment(_encoder->sequenceNumber())) {
+            _statistics.failedIO++;
+        }
+        while (_logSize + recordSize > _configuration.maximumLogSize && _segments.size() > 1 &&
+               evictOldest(regionEvents)) {
+        }
+    }
+    if (_logSize + recordSize > _configuration.maximumLogSize) {
+        (regionEvents ? _statistics.droppedRegionEventUploads : _statistics.droppedSightingUploads)++;
+        return;
+    }
+    if (!write(bytes, length)) {
+        _statistics.failedIO++;
+        return;
+    }
+    _statistics.appendedUploads++;
+    _statistics.appendedBytes += length;
+}
+
+// Appends a record to the newest segment.
+bool UploadQueue::write(const uint8_t *bytes, size_t length)
+{
+    uint8_t deviceID[upload::deviceIDSize];
+    uint64_t sequenceNumber;
+    if (!UploadReader::peek(bytes, length, deviceID, sequenceNumber) || length > UINT32_MAX) {
+        return false;
+    }
+    Segment &segment = _segments.back();
+    RecordHeader header = {uint32_t(length), Pending};
+    if (!writeAll(segment.file, &header, sizeof(header), segment.size) ||
+        !writeAll(segment.file, bytes, length, segment.size + recordHeaderSize)) {
+        // Whatever was written is overwritten by the next record, or ends the segment when it is loaded.
+        return false;
+    }
+    Priority priority = upload::kind(bytes, length) == BIUploadKindRegionEvents ? RegionEvents : Sightings;
+    if (_pending[priority].emplace(sequenceNumber, Record{segment.number, segment.size, uint32_t(length)}).second) {
+        segment.pendingRecords++;
+    }
+    segment.size += recordHeaderSize + length;
+    _logSize += recordHeaderSize + length;
+    return true;
+}
+
+// Deletes the oldest segment. Its region event uploads are moved to the newest segment as long as other segments hold
+// sighting uploads, which are dropped first. Otherwise they are only dropped to make room for newer region events, and
+// the segment is kept if dropRegionEvents is false.
+bool UploadQueue::evictOldest(bool dropRegionEvents)
+{
+    auto oldest = _segments.begin();
+    size_t otherSightings = 0;
+    for (const auto &entry : _pending[Sightings]) {
+        otherSightings += entry.second.segment != oldest->number;
+    }
+    if (otherSightings == 0 && !dropRegionEvents) {
+        for (const auto &entry : _pending[RegionEvents]) {
+            if (entry.second.segment == oldest->number) {
+                return false;
+            }
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> moved;
+    for (int priority = 0; priority < PriorityCount; priority++) {
+        Index &pending = _pending[priority];
+        for (auto record = pending.begin(); record != pending.end();) {
+            if (record->second.segment != oldest->number) {
+                ++record;
+                continue;
+            }
+            if (priority == Sightings) {
+                _statistics.droppedSightingUploads++;
+            } else if (otherSightings == 0) {
+                _statistics.droppedRegionEventUploads++;
+            } else {
+                moved.emplace_back(record->second.length);
+                if (!readAll(oldest->file, moved.back().data(), moved.back().size(),
+                             record->second.offset + recordHeaderSize)) {
+                    _statistics.failedIO++;
+                    moved.pop_back();
+                }
+            }
+            record = pending.erase(record);
+        }
+    }
+    removeSegment(oldest);
+    for (const std::vector<uint8_t> &bytes : moved) {
+        if (!write(bytes.data(), bytes.size())) {
+            _statistics.failedIO++;
+        }
+    }
+    return true;
+}
+
+// Records the outcome of a pending record and deletes its segment if nothing in it is pending anymore.
+void UploadQueue::finish(Priority priority, Index::iterator record)
+{
+    auto segment = findSegment(record->second.segment);
+    uint32_t state = Finished;
+    if (!writeAll(segment->file, &state, sizeof(state), record->second.offset + offsetof(RecordHeader, state))) {
+        _statistics.failedIO++;
+    }
+    _pending[priority].erase(record);
+    if (--segment->pendingRecords == 0 && segment != _segments.end() - 1) {
+        removeSegment(segment);
+    }
+}
+
+// MARK: - Sending
+
+void UploadQueue::add(const BIRangingBatch &batch)
+{
+    _encoder->add(batch);
+    sendNext(batch.timestamp);
+}
+
+void UploadQueue::addRegionEvent(uint32_t regionID, double timestamp, BIRegionEvent event)
+{
+    _encoder->addRegionEvent(regionID, timestamp, event);
+    sendNext(timestamp);
+}
+
+void UploadQueue::advance(double timestamp)
+{
+    _encoder->advance(timestamp);
+    sendNext(timestamp);
+}
+
+bool UploadQueue::flush()
+{
+    return _encoder->flush();
+}
+
+void UploadQueue::setReachable(bool reachable, double timestamp)
+{
+    bool wasReachable = _reachable;
+    _reachable = reachable;
+    if (reachable && !wasReachable) {
+        _failures = 0;
+        _nextAttempt = timestamp;
+        sendNext(timestamp);
+    }
+}
+
+void UploadQueue::didSend(double timestamp, BIUploadResult result)
+{
+    if (!_sending) {
+        return;
+    }
+    _sending = false;
+
+    // The record is gone if its segment was evicted while it was being sent.
+    Index &pending = _pending[_sendingPriority];
+    auto record = pending.find(_sendingSequenceNumber);
+    if (result == BIUploadResultFailed) {
+        _statistics.failedRequests++;
+        _failures++;
+        _nextAttempt = timestamp + backoff();
+        return;
+    }
+    if (result == BIUploadResultAccepted) {
+        _statistics.acceptedUploads++;
+        _statistics.acceptedBytes += _buffer.size();
+    } else {
+        _statistics.rejectedUploads++;
+    }
+    _failures = 0;
+    _nextAttempt = timestamp;
+    if (record != pending.end()) {
+        finish(_sendingPriority, record);
+    }
+    sendNext(timestamp);
+}
+
+void UploadQueue::sendNext(double timestamp)
+{
+    while (!_sending && _reachable && timestamp >= _nextAttempt) {
+        Priority priority = !_pending[RegionEvents].empty() ? RegionEvents : Sightings;
+        Index &pending = _pending[priority];
+        if (pending.empty()) {
+            return;
+        }
+        auto record = pending.begin();
+        auto segment = findSegment(record->second.segment);
+        _buffer.resize(record->second.length);
+        if (!readAll(segment->file, _buffer.data(), _buffer.size(), record->second.offset + recordHeaderSize)) {
+            _statistics.failedIO++;
+            finish(priority, record);
+            continue;
+        }
+        _sending = true;
+        _sendingPriority = priority;
+        _sendingSequenceNumber = record->first;
+        _statistics.requests++;
+        _send(_buffer.data(), _buffer.size(), _context);
+    }
+}
+
+double UploadQueue::backoff()
+{
+    double delay = std::min(std::ldexp(_configuration.initialBackoff, int(std::min<uint32_t>(_failures - 1, 30))),
+                            _configuration.maximumBackoff);
+    return delay * (1.0 - 0.5 * uniform());
+}
+
+double UploadQueue::uniform()
+{
+    uint64_t z = (_randomState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return double(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+BIUploadQueueStatistics UploadQueue::statistics() const
+{
+    BIUploadQueueStatistics statistics = _statistics;
+    statistics.pendingUploads = _pending[RegionEvents].size() + _pending[Sightings].size();
+    statistics.logSize = _logSize;
+    return statistics;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIUploadQueue {
+    std::unique_ptr<bi::UploadQueue> queue;
+};
+
+BIUploadQueueConfiguration BIUploadQueueConfigurationMakeDefault(void)
+{
+    BIUploadQueueConfiguration configuration;
+    configuration.encoder = BIUploadEncoderConfigurationMakeDefault();
+    configuration.maximumLogSize = 4 * 1024 * 1024;
+    configuration.segmentSize = 256 * 1024;
+    configuration.initialBackoff = 5.0;
+    configuration.maximumBackoff = 600.0;
+    return configuration;
+}
+
+BIUploadQueueRef BIUploadQueueOpen(const char *directory, const BIUploadQueueConfiguration *configuration,
+                                   const uint8_t deviceID[16], BIUploadSendFunction send, void *context)
+{
+    std::unique_ptr<bi::UploadQueue> queue = bi::UploadQueue::open(
+        directory, configuration ? *configuration : BIUploadQueueConfigurationMakeDefault(), deviceID, send, context);
+    return queue ? new BIUploadQueue{std::move(queue)} : nullptr;
+}
+
+void BIUploadQueueClose(BIUploadQueueRef queue)
+{
+    queue->queue->flush();
+    delete queue;
+}
+
+void BIUploadQueueAddBatch(BIUploadQueueRef queue, const BIRangingBatch *batch)
+{
+    queue->queue->add(*batch);
+}
+
+void BIUploadQueueAddRegionEvent(BIUploadQueueRef queue, uint32_t regionID, double timestamp, BIRegionEvent event)
+{
+    queue->queue->addRegionEvent(regionID, timestamp, event);
+}
+
+void BIUploadQueueAdvance(BIUploadQueueRef queue, double timestamp)
+{
+    queue->queue->advance(timestamp);
+}
+
+bool BIUploadQueueFlush(BIUploadQueueRef queue)
+{
+    return queue->queue->flush();
+}
+
+void BIUploadQueueSetReachable(BIUploadQueueRef queue, bool reachable, double timestamp)
+{
+    queue->queue->setReachable(reachable, timestamp);
+}
+
+void BIUploadQueueDidSend(BIUploadQueueRef queue, double timestamp, BIUploadResult result)
+{
+    queue->queue->didSend(timestamp, result);
+}
+
+BIUploadQueueStatistics BIUploadQueueGetStatistics(BIUploadQueueRef queue)
+{
+    return queue->queue->statistics();
+}
@@ -0,0 +1,121 @@
+//
+//  UploadQueue.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIUploadQueue.h>
+
+#include "UploadEncoder.hpp"
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bi {
+
+// The log is a sequence of segment files named by their number. A segment starts with a header holding the sequence
+// number of the encoder when the segment was started, followed by records: the length and state of an upload and the
+// upload itself. Only the newest segment is appended to. The outcome of a request overwrites the state of its record
+// with pwrite(), and a segment is deleted once none of its records is pending, except the newest one, so that the
+// sequence number survives. The pending records are indexed by sequence number, one index for each kind of upload, which
+// is also the order they are sent in.
+class UploadQueue {
+public:
+    // Returns nullptr if the directory cannot be created or read.
+    static std::unique_ptr<UploadQueue> open(const char *directory, const BIUploadQueueConfiguration &configuration,
+                                             const uint8_t deviceID[16], BIUploadSendFunction send, void *context);
+    ~UploadQueue();
+
+    UploadQueue(const UploadQueue &) = delete;
+    UploadQueue &operator=(const UploadQueue &) = delete;
+
+    void add(const BIRangingBatch &batch);
+    void addRegionEvent(uint32_t regionID, double timestamp, BIRegionEvent event);
+    void advance(double timestamp);
+    bool flush();
+    void setReachable(bool reachable, double timestamp);
+    void didSend(double timestamp, BIUploadResult result);
+    BIUploadQueueStatistics statistics() const;
+
+    // On-disk layout, in the byte order of the device.
+    struct SegmentHeader {
+        char magic[8];
+        uint64_t sequenceNumber;
+    };
+
+    struct RecordHeader {
+        uint32_t length;
+        uint32_t state;
+    };
+
+private:
+    enum State : uint32_t { Pending = 0, Finished = 1 };
+
+    // Region event uploads are sent first.
+    enum Priority { RegionEvents, Sightings, PriorityCount };
+
+    struct Segment {
+        uint64_t number;
+        int file;
+        uint64_t size;
+        uint32_t pendingRecords;
+    };
+
+    struct Record {
+        uint64_t segment;
+        uint64_t offset; // of the record header
+        uint32_t length; // of the upload
+    };
+
+    using Index = std::map<uint64_t, Record>; // by sequence number
+
+    UploadQueue(const char *directory, const BIUploadQueueConfiguration &configuration, BIUploadSendFunction send,
+                void *context);
+
+    static void handleUpload(const uint8_t *bytes, size_t length, void *context);
+
+    bool load(uint64_t &sequenceNumber);
+    uint64_t loadSegment(Segment &segment);
+    bool startSegment(uint64_t sequenceNumber);
+    std::deque<Segment>::iterator findSegment(uint64_t number);
+    void removeSegment(std::deque<Segment>::iterator segment);
+    std::string path(uint64_t number) const;
+
+    void append(const uint8_t *bytes, size_t length);
+    bool write(const uint8_t *bytes, size_t length);
+    bool evictOldest(bool dropRegionEvents);
+    void finish(Priority priority, Index::iterator record);
+
+    void sendNext(double timestamp);
+    double backoff();
+    double uniform();
+
+    BIUploadQueueConfiguration _configuration;
+    std::string _directory;
+    BIUploadSendFunction _send;
+    void *_context;
+    std::unique_ptr<UploadEncoder> _encoder;
+
+    std::deque<Segment> _segments;
+    Index _pending[PriorityCount];
+    uint64_t _logSize = 0;
+
+    bool _reachable = true;
+    bool _sending = false;
+    Priority _sendingPriority = Sightings;
+    uint64_t _sendingSequenceNumber = 0;
+    uint32_t _failures = 0;
+    double _nextAttempt;
+    uint64_t _randomState = 0;
+    std::vector<uint8_t> _buffer; // the upload being sent
+
+    BIUploadQueueStatistics _statistics = {};
+};
+
+} // namespace bi
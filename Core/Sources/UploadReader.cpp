@@ -0,0 +1,322 @@
+//
+//  UploadReader.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "UploadReader.hpp"
+
+#include <cstring>
+
+namespace bi {
+
+namespace {
+
+// The counts and column lengths that follow the sequence number and start time in the header.
+const size_t headerCounts = 8;
+
+// Start times are bounded so that adding up the tick intervals cannot overflow.
+const int64_t maximumTime = int64_t(1) << 53;
+
+bool readSignedVarint(const uint8_t *&position, const uint8_t *end, int64_t &value)
+{
+    uint64_t encoded;
+    if (!upload::readVarint(position, end, encoded)) {
+        return false;
+    }
+    value = trace::unzigzag(encoded);
+    return true;
+}
+
+// Reads a 16-bit field stored as the zigzag-encoded difference to its previous value.
+bool readDelta(const uint8_t *&position, const uint8_t *end, uint16_t &value)
+{
+    int64_t delta;
+    if (!readSignedVarint(position, end, delta) || delta < -int64_t(UINT16_MAX) || delta > int64_t(UINT16_MAX)) {
+        return false;
+    }
+    int64_t result = int64_t(value) + delta;
+    if (result < 0 || result > int64_t(UINT16_MAX)) {
+        return false;
+    }
+    value = uint16_t(result);
+    return true;
+}
+
+} // namespace
+
+bool UploadReader::peek(const uint8_t *bytes, size_t length, uint8_t deviceID[16], uint64_t &sequenceNumber)
+{
+    size_t prefix = sizeof(upload::magic) + upload::deviceIDSize;
+    if (length < prefix || upload::kind(bytes, length) == BIUploadKindNone) {
+        return false;
+    }
+    std::memcpy(deviceID, bytes + sizeof(upload::magic), upload::deviceIDSize);
+    const uint8_t *position = bytes + prefix;
+    return upload::readVarint(position, bytes + length, sequenceNumber);
+}
+
+bool UploadReader::fail(const char *message)
+{
+    _error = message;
+    _info.sightingCount = 0;
+    _info.regionEventCount = 0;
+    _regionEvents.clear();
+    _sighting = 0;
+    return false;
+}
+
+bool UploadReader::open(const uint8_t *bytes, size_t length)
+{
+    _info = {};
+    _beacons.clear();
+    _regionEvents.clear();
+    _sighting = 0;
+    _tickRemaining = 0;
+    _previousBeacon = NoBeacon;
+    _error = nullptr;
+
+    if (!peek(bytes, length, _info.deviceID, _info.sequenceNumber)) {
+        return fail("not an upload");
+    }
+    if (length < sizeof(upload::magic) + upload::deviceIDSize + upload::checksumSize) {
+        return fail("truncated upload");
+    }
+    const uint8_t *end = bytes + length - upload::checksumSize;
+    uint32_t expected = 0;
+    for (size_t i = 0; i < upload::checksumSize; i++) {
+        expected |= uint32_t(end[i]) << (8 * i);
+    }
+    if (upload::checksum(bytes, length - upload::checksumSize) != expected) {
+        return fail("checksum mismatch");
+    }
+
+    const uint8_t *position = bytes + sizeof(upload::magic) + upload::deviceIDSize;
+    _info.kind = upload::kind(bytes, length);
+    if (_info.kind == BIUploadKindRegionEvents) {
+        return readRegionEvents(position, end) || fail("malformed region events");
+    }
+
+    // Everything after the header must be covered by the columns exactly. Every count is bounded by the length of the
+    // upload first, so that the sums below cannot overflow.
+    uint64_t sequenceNumber;
+    int64_t startTime;
+    uint64_t header[headerCounts];
+    if (!upload::readVarint(position, end, sequenceNumber) || !readSignedVarint(position, end, startTime) ||
+        startTime < -maximumTime || startTime > maximumTime) {
+        return fail("malformed header");
+    }
+    for (uint64_t &value : header) {
+        if (!upload::readVarint(position, end, value) || value > length || value > UINT32_MAX) {
+            return fail("malformed header");
+        }
+    }
+    uint64_t tickCount = header[0];
+    uint64_t sightingCount = header[1];
+    uint64_t UUIDCount = header[2];
+    uint64_t beaconCount = header[3];
+    uint64_t beaconsLength = header[4];
+    uint64_t ticksLength = header[5];
+    uint64_t sightingBeaconsLength = header[6];
+    uint64_t accuraciesLength = header[7];
+    uint64_t columnsLength = UUIDCount * upload::UUIDSize + beaconsLength + ticksLength + sightingBeaconsLength +
+                             sightingCount + (sightingCount + 3) / 4 + accuraciesLength;
+    if (columnsLength != uint64_t(end - position)) {
+        return fail("malformed header");
+    }
+
+    const uint8_t *UUIDs = position;
+    const uint8_t *beacons = UUIDs + UUIDCount * upload::UUIDSize;
+    _ticks = beacons + beaconsLength;
+    _sightingBeacons = _ticks + ticksLength;
+    _RSSIs = _sightingBeacons + sightingBeaconsLength;
+    _proximities = _RSSIs + sightingCount;
+    _accuracies = _proximities + (sightingCount + 3) / 4;
+    _ticksEnd = _sightingBeacons;
+    _sightingBeaconsEnd = _RSSIs;
+    _accuraciesEnd = end;
+
+    _info.tickCount = uint32_t(tickCount);
+    _info.sightingCount = uint32_t(sightingCount);
+    _info.beaconCount = uint32_t(beaconCount);
+    _time = startTime;
+    _info.startTime = upload::seconds(startTime);
+    if (!readBeacons(UUIDs, UUIDCount, beacons, _ticks)) {
+        return fail("malformed beacon list");
+    }
+    if (!readTicks(_ticks, _ticksEnd)) {
+        return fail("malformed ticks");
+    }
+    return true;
+}
+
+bool UploadReader::readBeacons(const uint8_t *UUIDs, uint64_t UUIDCount, const uint8_t *position, const uint8_t *end)
+{
+    _beacons.resize(_info.beaconCount);
+    BIBeaconKey previous = {};
+    for (BIBeaconKey &key : _beacons) {
+        uint64_t UUID;
+        if (!upload::readVarint(position, end, UUID) || UUID >= UUIDCount) {
+            return false;
+        }
+        std::memcpy(key.proximityUUID, UUIDs + UUID * upload::UUIDSize, upload::UUIDSize);
+        key.major = previous.major;
+        key.minor = previous.minor;
+        if (!readDelta(position, end, key.major) || !readDelta(position, end, key.minor)) {
+            return false;
+        }
+        previous = key;
+    }
+    return position == end;
+}
+
+bool UploadReader::readTicks(const uint8_t *position, const uint8_t *end)
+{
+    int64_t time = _time;
+    uint64_t sightings = 0;
+    for (uint32_t tick = 0; tick < _info.tickCount; tick++) {
+        uint64_t delta;
+        uint64_t count;
+        if (!upload::readVarint(position, end, delta) || !upload::readVarint(position, end, count) ||
+            delta > uint64_t(INT32_MAX) || count > _info.sightingCount - sightings) {
+            return false;
+        }
+        time += int64_t(delta);
+        sightings += count;
+    }
+    _info.endTime = upload::seconds(time);
+    return position == end && sightings == _info.sightingCount;
+}
+
+bool UploadReader::readRegionEvents(const uint8_t *position, const uint8_t *end)
+{
+    uint64_t sequenceNumber;
+    int64_t time;
+    uint64_t count;
+    if (!upload::readVarint(position, end, sequenceNumber) || !readSignedVarint(position, end, time) ||
+        time < -maximumTime || time > maximumTime || !upload::readVarint(position, end, count) ||
+        count > uint64_t(end - position)) {
+        return false;
+    }
+    _info.startTime = upload::seconds(time);
+    _regionEvents.resize(count);
+    for (BIUploadRegionEvent &regionEvent : _regionEvents) {
+        uint64_t delta;
+        uint64_t regionID;
+        uint64_t event;
+        if (!upload::readVarint(position, end, delta) || !upload::readVarint(position, end, regionID) ||
+            !upload::readVarint(position, end, event) || delta > uint64_t(INT32_MAX) || regionID > UINT32_MAX ||
+            event > BIRegionEventStateOutside) {
+            return false;
+        }
+        time += int64_t(delta);
+        regionEvent.timestamp = upload::seconds(time);
+        regionEvent.regionID = uint32_t(regionID);
+        regionEvent.event = BIRegionEvent(event);
+    }
+    if (position != end) {
+        return false;
+    }
+    _info.endTime = upload::seconds(time);
+    _info.regionEventCount = uint32_t(count);
+    return true;
+}
+
+size_t UploadReader::read(BIUploadSighting *sightings, size_t capacity)
+{
+    size_t count = 0;
+    while (count < capacity && _sighting < _info.sightingCount) {
+        if (_tickRemaining == 0) {
+            // The ticks were verified by open().
+            uint64_t delta;
+            upload::readVarint(_ticks, _ticksEnd, delta);
+            upload::readVarint(_ticks, _ticksEnd, _tickRemaining);
+            _time += int64_t(delta);
+            _previousBeacon = NoBeacon;
+            continue;
+        }
+        uint64_t gap;
+        uint64_t accuracy;
+        if (!upload::readVarint(_sightingBeacons, _sightingBeaconsEnd, gap) ||
+            !upload::readVarint(_accuracies, _accuraciesEnd, accuracy) || gap >= _info.beaconCount) {
+            fail("malformed sightings");
+            return 0;
+        }
+        uint64_t beacon = _previousBeacon == NoBeacon ? gap : _previousBeacon + 1 + gap;
+        if (beacon >= _info.beaconCount) {
+            fail("malformed sightings");
+            return 0;
+        }
+        BIUploadSighting &sighting = sightings[count++];
+        sighting.timestamp = upload::seconds(_time);
+        sighting.beacon = uint32_t(beacon);
+        sighting.RSSI = -int32_t(_RSSIs[_sighting]);
+        sighting.proximity = (_proximities[_sighting / 4] >> (2 * (_sighting % 4))) & 3;
+        sighting.accuracy = upload::decodeAccuracy(accuracy);
+        _previousBeacon = beacon;
+        _tickRemaining--;
+        _sighting++;
+    }
+    if (_sighting == _info.sightingCount &&
+        (_sightingBeacons != _sightingBeaconsEnd || _accuracies != _accuraciesEnd)) {
+        fail("malformed sightings");
+        return 0;
+    }
+    return count;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIUploadReader {
+    bi::UploadReader reader;
+};
+
+BIUploadKind BIUploadGetKind(const uint8_t *bytes, size_t length)
+{
+    return bi::upload::kind(bytes, length);
+}
+
+BIUploadReaderRef BIUploadReaderCreate(void)
+{
+    return new BIUploadReader;
+}
+
+void BIUploadReaderDestroy(BIUploadReaderRef reader)
+{
+    delete reader;
+}
+
+bool BIUploadReaderOpen(BIUploadReaderRef reader, const uint8_t *bytes, size_t length)
+{
+    return reader->reader.open(bytes, length);
+}
+
+BIUploadInfo BIUploadReaderGetInfo(BIUploadReaderRef reader)
+{
+    return reader->reader.info();
+}
+
+const BIBeaconKey *BIUploadReaderGetBeacons(BIUploadReaderRef reader, size_t *count)
+{
+    *count = reader->reader.beacons().size();
+    return reader->reader.beacons().data();
+}
+
+const BIUploadRegionEvent *BIUploadReaderGetRegionEvents(BIUploadReaderRef reader, size_t *count)
+{
+    *count = reader->reader.regionEvents().size();
+    return reader->reader.regionEvents().data();
+}
+
+size_t BIUploadReaderRead(BIUploadReaderRef reader, BIUploadSighting *sightings, size_t capacity)
+{
+    return reader->reader.read(sightings, capacity);
+}
+
+const char *BIUploadReaderGetError(BIUploadReaderRef reader)
+{
+    return reader->reader.error();
+}
@@ -0,0 +1,62 @@
+//
+//  UploadReader.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIUpload.h>
+
+#include "UploadFormat.hpp"
+
+#include <vector>
+
+namespace bi {
+
+// Keeps a cursor into each per-sighting column of the open upload. The tick column is short (one entry per
+// tick, not per sighting), so it is verified when the upload is opened; the sighting columns are only verified as they
+// are read. Region event uploads are small and decoded as a whole when they are opened.
+class UploadReader {
+public:
+    // Reads the device ID and sequence number of an upload of either kind without verifying the rest of it.
+    static bool peek(const uint8_t *bytes, size_t length, uint8_t deviceID[16], uint64_t &sequenceNumber);
+
+    bool open(const uint8_t *bytes, size_t length);
+
+    const BIUploadInfo &info() const { return _info; }
+    const std::vector<BIBeaconKey> &beacons() const { return _beacons; }
+    const std::vector<BIUploadRegionEvent> &regionEvents() const { return _regionEvents; }
+    size_t read(BIUploadSighting *sightings, size_t capacity);
+    const char *error() const { return _error; }
+
+private:
+    static constexpr uint64_t NoBeacon = UINT64_MAX;
+
+    bool fail(const char *message);
+    bool readBeacons(const uint8_t *UUIDs, uint64_t UUIDCount, const uint8_t *position, const uint8_t *end);
+    bool readTicks(const uint8_t *position, const uint8_t *end);
+    bool readRegionEvents(const uint8_t *position, const uint8_t *end);
+
+    BIUploadInfo _info = {};
+    std::vector<BIBeaconKey> _beacons;
+    std::vector<BIUploadRegionEvent> _regionEvents;
+    const char *_error = "no upload";
+
+    const uint8_t *_ticks = nullptr;
+    const uint8_t *_ticksEnd = nullptr;
+    const uint8_t *_sightingBeacons = nullptr;
+    const uint8_t *_sightingBeaconsEnd = nullptr;
+    const uint8_t *_RSSIs = nullptr;
+    const uint8_t *_proximities = nullptr;
+    const uint8_t *_accuracies = nullptr;
+    const uint8_t *_accuraciesEnd = nullptr;
+
+    uint32_t _sighting = 0;      // index of the next sighting
+    uint64_t _tickRemaining = 0; // sightings of the current tick that have not been read
+    int64_t _time = 0;           // of the current tick, in milliseconds
+    uint64_t _previousBeacon = NoBeacon;
+};
+
+} // namespace bi
@@ -0,0 +1,515 @@
+//
+//  ZoneEngine.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include "ZoneEngine.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace bi {
+
+namespace {
+
+const uint32_t maximumDepth = 64;
+
+// Checks the subtree at nodes[position] and calls emit(node) for its nodes in postfix order, advancing position past it.
+template <typename Emit>
+bool compileNode(const BIZoneNode *nodes, size_t count, size_t &position, uint32_t depth, Emit &emit)
+{
+    if (position >= count || depth > maximumDepth) {
+        return false;
+    }
+    const BIZoneNode &node = nodes[position++];
+    switch (node.type) {
+    case BIZoneNodeBeacon:
+        if (!(node.dwellTime >= 0.0)) {
+            return false;
+        }
+        break;
+    case BIZoneNodeAll:
+    case BIZoneNodeAny:
+        if (node.childCount == 0) {
+            return false;
+        }
+        break;
+    case BIZoneNodeAtLeast:
+        if (node.childCount == 0 || node.threshold == 0 || node.threshold > node.childCount) {
+            return false;
+        }
+        break;
+    case BIZoneNodeNot:
+        if (node.childCount != 1) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    if (node.type != BIZoneNodeBeacon) {
+        for (uint32_t i = 0; i < node.childCount; i++) {
+            if (!compileNode(nodes, count, position, depth + 1, emit)) {
+                return false;
+            }
+        }
+    }
+    emit(node);
+    return true;
+}
+
+template <typename Emit>
+bool compileZone(const BIZoneDefinition &zone, Emit &emit)
+{
+    if (zone.nodes == nullptr || zone.nodeCount == 0 || !(zone.enterDwellTime >= 0.0) || !(zone.exitDwellTime >= 0.0)) {
+        return false;
+    }
+    size_t position = 0;
+    return compileNode(zone.nodes, zone.nodeCount, position, 1, emit) && position == zone.nodeCount;
+}
+
+} // namespace
+
+bool ZoneEngine::isValid(const BIZoneDefinition &zone)
+{
+    auto ignore = [](const BIZoneNode &) {};
+    return compileZone(zone, ignore);
+}
+
+ZoneEngine::ZoneEngine(const BIZoneEngineConfiguration &configuration, const BIZoneDefinition *zones, size_t count,
+                       BIZoneTransitionHandler handler, void *context)
+    : _handler(handler), _context(context), _timers(configuration.timerResolution, configuration.timerSlots)
+{
+    uint32_t maximumHeight = 1;
+    std::vector<uint32_t> conditionBeacons;
+    for (size_t z = 0; z < count; z++) {
+        Zone zone = {};
+        zone.id = zones[z].zoneID;
+        zone.firstInstruction = uint32_t(_program.size());
+        zone.enterDwellTime = zones[z].enterDwellTime;
+        zone.exitDwellTime = zones[z].exitDwellTime;
+        zone.pending = Pending::None;
+
+        uint32_t height = 0;
+        auto emit = [&](const BIZoneNode &node) {
+            switch (node.type) {
+            case BIZoneNodeBeacon: {
+                auto inserted = _beaconsByKey.emplace(node.key, uint32_t(_beacons.size()));
+                if (inserted.second) {
+                    _beacons.push_back(Beacon{0, 0, Reading{false, 0, 0}, Reading{false, 0, 0}, 0, false});
+                }
+                Condition condition;
+                condition.zone = uint32_t(z);
+                condition.minimumRSSI = node.minimumRSSI;
+                condition.maximumProximity = int32_t(node.maximumProximity);
+                condition.holds = false;
+                _program.push_back(Instruction{Operation::Push, 0, uint32_t(_conditions.size())});
+                _conditions.push_back(condition);
+                _dwellTimes.push_back(node.dwellTime);
+                conditionBeacons.push_back(inserted.first->second);
+                height++;
+                break;
+            }
+            case BIZoneNodeAll:
+                _program.push_back(Instruction{Operation::All, node.childCount, 0});
+                height -= node.childCount - 1;
+                break;
+            case BIZoneNodeAny:
+                _program.push_back(Instruction{Operation::Any, node.childCount, 0});
+                height -= node.childCount - 1;
+                break;
+            case BIZoneNodeAtLeast:
+                _program.push_back(Instruction{Operation::AtLeast, node.childCount, node.threshold});
+                height -= node.childCount - 1;
+                break;
+            case BIZoneNodeNot:
+                _program.push_back(Instruction{Operation::Not, 1, 0});
+                break;
+            }
+            maximumHeight = std::max(maximumHeight, height);
+        };
+        compileZone(zones[z], emit);
+        zone.instructionCount = uint32_t(_program.size()) - zone.firstInstruction;
+        _zonesByID[zone.id] = uint32_t(_zones.size());
+        _zones.push_back(zone);
+    }
+    _stack.resize(maximumHeight);
+
+    // Group the conditions by beacon (counting sort) and renumber them in the programs.
+    std::vector<uint32_t> starts(_beacons.size() + 1, 0);
+    for (uint32_t beacon : conditionBeacons) {
+        starts[beacon + 1]++;
+    }
+    for (size_t b = 0; b < _beacons.size(); b++) {
+        starts[b + 1] += starts[b];
+        _beacons[b].firstCondition = starts[b];
+        _beacons[b].conditionCount = starts[b + 1] - starts[b];
+    }
+    std::vector<uint32_t> renumbered(_conditions.size());
+    std::vector<Condition> grouped(_conditions.size());
+    std::vector<double> groupedDwellTimes(_conditions.size());
+    for (size_t c = 0; c < _conditions.size(); c++) {
+        renumbered[c] = starts[conditionBeacons[c]]++;
+        grouped[renumbered[c]] = _conditions[c];
+        groupedDwellTimes[renumbered[c]] = _dwellTimes[c];
+    }
+    _conditions.swap(grouped);
+    _dwellTimes.swap(groupedDwellTimes);
+    for (Instruction &instruction : _program) {
+        if (instruction.operation == Operation::Push) {
+            instruction.argument = renumbered[instruction.argument];
+        }
+    }
+    _values.assign(_conditions.size(), 0);
+}
+
+void ZoneEngine::update(double timestamp, const BIRangedBeacon *beacons, size_t count)
+{
+    advanceTimers(timestamp);
+    _tick++;
+    for (size_t i = 0; i < count; i++) {
+        observe(beacons[i]);
+    }
+    finishTick(timestamp);
+}
+
+void ZoneEngine::update(const BIRangingBatch &batch)
+{
+    advanceTimers(batch.timestamp);
+    _tick++;
+    for (size_t r = 0; r < batch.regionCount; r++) {
+        const BIRegionRangingResult &region = batch.regions[r];
+        for (size_t i = 0; i < region.beaconCount; i++) {
+            observe(region.beacons[i]);
+        }
+    }
+    finishTick(batch.timestamp);
+}
+
+uint32_t ZoneEngine::findBeacon(const BIRangedBeacon &beacon)
+{
+    if (beacon.handle >= maximumCachedHandle) {
+        auto it = _beaconsByKey.find(beacon.key);
+        return it != _beaconsByKey.end() ? it->second : Absent;
+    }
+    if (beacon.handle >= _beaconsByHandle.size()) {
+        _beaconsByHandle.resize(size_t(beacon.handle) + 1, CachedHandle{BIBeaconKey(), Unfilled});
+    }
+    CachedHandle &cached = _beaconsByHandle[beacon.handle];
+    if (cached.beacon == Unfilled || !(cached.key == beacon.key)) {
+        auto it = _beaconsByKey.find(beacon.key);
+        cached.key = beacon.key;
+        cached.beacon = it != _beaconsByKey.end() ? it->second : Absent;
+    }
+    return cached.beacon;
+}
+
+void ZoneEngine::observe(const BIRangedBeacon &beacon)
+{
+    uint32_t index = findBeacon(beacon);
+    if (index == Absent) {
+        return;
+    }
+    Beacon &state = _beacons[index];
+    Reading reading = {beacon.smoothedSignal.inRange, beacon.smoothedSignal.RSSI, beacon.smoothedSignal.proximity};
+    if (state.observedTick != _tick) {
+        state.observedTick = _tick;
+        state.observed = reading;
+        _observedBeacons.push_back(index);
+    } else if (!state.observed.inRange && reading.inRange) {
+        state.observed = reading;
+    }
+}
+
+void ZoneEngine::finishTick(double timestamp)
+{
+    _statistics.ticks++;
+    for (uint32_t beacon : _observedBeacons) {
+        setReading(beacon, _beacons[beacon].observed, timestamp);
+    }
+    _observedBeacons.clear();
+
+    // Beacons that were in range and did not appear went out of range.
+    size_t kept = 0;
+    for (uint32_t beacon : _liveBeacons) {
+        Beacon &state = _beacons[beacon];
+        if (state.observedTick != _tick) {
+            setReading(beacon, Reading{false, 0, 0}, timestamp);
+        }
+        if (state.current.inRange) {
+            _liveBeacons[kept++] = beacon;
+        } else {
+            state.live = false;
+        }
+    }
+    _liveBeacons.resize(kept);
+
+    if (!_started) {
+        start();
+    }
+    evaluateDirtyZones(timestamp);
+}
+
+// Only zones with a changed condition are evaluated, so a zone that holds while none of its beacons is in range (e.g.
+// "not beacon A") would never be entered if the beacon is never seen. The first tick or advance therefore evaluates
+// every zone, and the dwell times of the zones that hold start then.
+void ZoneEngine::start()
+{
+    _started = true;
+    for (uint32_t zone = 0; zone < _zones.size(); zone++) {
+        if (!_zones[zone].dirty) {
+            _zones[zone].dirty = true;
+            _dirtyZones.push_back(zone);
+        }
+    }
+}
+
+void ZoneEngine::setReading(uint32_t beacon, const Reading &reading, double timestamp)
+{
+    Beacon &state = _beacons[beacon];
+    if (state.current == reading) {
+        return;
+    }
+    state.current = reading;
+    if (reading.inRange && !state.live) {
+        state.live = true;
+        _liveBeacons.push_back(beacon);
+    }
+
+    uint32_t end = state.firstCondition + state.conditionCount;
+    for (uint32_t c = state.firstCondition; c < end; c++) {
+        Condition &condition = _conditions[c];
+        bool holds = reading.inRange &&
+                     (condition.minimumRSSI == 0 || (reading.RSSI != 0 && reading.RSSI >= condition.minimumRSSI)) &&
+                     (condition.maximumProximity == BIProximityUnknown ||
+                      (reading.proximity != BIProximityUnknown && reading.proximity <= condition.maximumProximity));
+        if (holds == condition.holds) {
+            continue;
+        }
+        condition.holds = holds;
+        if (!holds) {
+            _timers.cancel(c);
+            setValue(c, false);
+        } else if (_dwellTimes[c] > 0.0) {
+            _timers.schedule(c, timestamp + _dwellTimes[c]);
+        } else {
+            setValue(c, true);
+        }
+    }
+}
+
+void ZoneEngine::setValue(uint32_t condition, bool value)
+{
+    if (_values[condition] == uint8_t(value)) {
+        return;
+    }
+    _values[condition] = uint8_t(value);
+    _statistics.conditionChanges++;
+    Zone &zone = _zones[_conditions[condition].zone];
+    if (!zone.dirty) {
+        zone.dirty = true;
+        _dirtyZones.push_back(_conditions[condition].zone);
+    }
+}
+
+void ZoneEngine::evaluateDirtyZones(double timestamp)
+{
+    for (uint32_t zone : _dirtyZones) {
+        _zones[zone].dirty = false;
+        evaluate(zone, timestamp);
+    }
+    _dirtyZones.clear();
+}
+
+void ZoneEngine::evaluate(uint32_t index, double timestamp)
+{
+    _statistics.zoneEvaluations++;
+    Zone &zone = _zones[index];
+    uint32_t *stack = _stack.data();
+    uint32_t top = 0;
+    const Instruction *end = _program.data() + zone.firstInstruction + zone.instructionCount;
+    for (const Instruction *instruction = _program.data() + zone.firstInstruction; instruction != end; instruction++) {
+        switch (instruction->operation) {
+        case Operation::Push:
+            stack[top++] = _values[instruction->argument];
+            break;
+        case Operation::All:
+        case Operation::Any:
+        case Operation::AtLeast: {
+            top -= instruction->count;
+            uint32_t holding = 0;
+            for (uint32_t i = 0; i < instruction->count; i++) {
+                holding += stack[top + i];
+            }
+            uint32_t needed = instruction->operation == Operation::All   ? instruction->count
+                              : instruction->operation == Operation::Any ? 1
+                                                                         : instruction->argument;
+            stack[top++] = holding >= needed ? 1 : 0;
+            break;
+        }
+        case Operation::Not:
+            stack[top - 1] ^= 1;
+            break;
+        }
+    }
+    bool value = stack[0] != 0;
+    if (value == zone.value) {
+        return;
+    }
+    zone.value = value;
+
+    uint32_t timer = uint32_t(_conditions.size()) + index;
+    if (value) {
+        if (zone.inside) {
+            if (zone.pending == Pending::Exit) {
+                _timers.cancel(timer);
+                zone.pending = Pending::None;
+            }
+            return;
+        }
+        zone.pending = Pending::Enter;
+        if (zone.enterDwellTime > 0.0) {
+            _timers.schedule(timer, timestamp + zone.enterDwellTime);
+        } else {
+            fire(index, timestamp);
+        }
+        return;
+    }
+    if (zone.inside) {
+        zone.pending = Pending::Exit;
+        if (zone.exitDwellTime > 0.0) {
+            _timers.schedule(timer, timestamp + zone.exitDwellTime);
+        } else {
+            fire(index, timestamp);
+        }
+    } else if (zone.pending == Pending::Enter) {
+        _timers.cancel(timer);
+        zone.pending = Pending::None;
+    }
+}
+
+void ZoneEngine::fire(uint32_t index, double timestamp)
+{
+    Zone &zone = _zones[index];
+    BIZoneTransition transition;
+    if (zone.pending == Pending::Enter) {
+        zone.inside = true;
+        transition = BIZoneTransitionEnter;
+        _statistics.enters++;
+    } else if (zone.pending == Pending::Exit) {
+        zone.inside = false;
+        transition = BIZoneTransitionExit;
+        _statistics.exits++;
+    } else {
+        return;
+    }
+    zone.pending = Pending::None;
+    if (_handler != nullptr) {
+        _handler(zone.id, transition, timestamp, _context);
+    }
+}
+
+// Conditions whose dwell time ends at the same time change together: their zones are evaluated once all of them have
+// fired, and before zone timers due at that time (which sort after them), so that no zone flips back and forth.
+void ZoneEngine::advanceTimers(double timestamp)
+{
+    uint32_t conditionCount = uint32_t(_conditions.size());
+    _timers.advance(timestamp, [this, conditionCount](uint32_t timer, double deadline) {
+        if (!_dirtyZones.empty() && (timer >= conditionCount || deadline > _dirtySince)) {
+            evaluateDirtyZones(_dirtySince);
+        }
+        if (timer < conditionCount) {
+            _dirtySince = deadline;
+            setValue(timer, true);
+        } else {
+            fire(timer - conditionCount, deadline);
+        }
+    });
+    evaluateDirtyZones(_dirtySince);
+}
+
+void ZoneEngine::advance(double timestamp)
+{
+    advanceTimers(timestamp);
+    if (!_started) {
+        start();
+        evaluateDirtyZones(timestamp);
+    }
+}
+
+bool ZoneEngine::isInside(uint32_t zoneID) const
+{
+    auto it = _zonesByID.find(zoneID);
+    return it != _zonesByID.end() && _zones[it->second].inside;
+}
+
+} // namespace bi
+
+// MARK: - C interface
+
+struct BIZoneEngine {
+    BIZoneEngine(const BIZoneEngineConfiguration &configuration, const BIZoneDefinition *zones, size_t count,
+                 BIZoneTransitionHandler handler, void *context)
+        : engine(configuration, zones, count, handler, context)
+    {
+    }
+    bi::ZoneEngine engine;
+};
+
+BIZoneEngineConfiguration BIZoneEngineConfigurationMakeDefault(void)
+{
+    BIZoneEngineConfiguration configuration;
+    configuration.timerResolution = 0.25;
+    configuration.timerSlots = 512;
+    return configuration;
+}
+
+bool BIZoneDefinitionIsValid(const BIZoneDefinition *zone)
+{
+    return bi::ZoneEngine::isValid(*zone);
+}
+
+BIZoneEngineRef BIZoneEngineCreate(const BIZoneEngineConfiguration *configuration, const BIZoneDefinition *zones,
+                                   size_t zoneCount, BIZoneTransitionHandler handler, void *context)
+{
+    std::unordered_set<uint32_t> IDs;
+    for (size_t i = 0; i < zoneCount; i++) {
+        if (!bi::ZoneEngine::isValid(zones[i]) || !IDs.insert(zones[i].zoneID).second) {
+            return nullptr;
+        }
+    }
+    return new BIZoneEngine(configuration ? *configuration : BIZoneEngineConfigurationMakeDefault(), zones, zoneCount,
+                            handler, context);
+}
+
+void BIZoneEngineDestroy(BIZoneEngineRef engine)
+{
+    delete engine;
+}
+
+void BIZoneEngineUpdate(BIZoneEngineRef engine, double timestamp, const BIRangedBeacon *beacons, size_t beaconCount)
+{
+    engine->engine.update(timestamp, beacons, beaconCount);
+}
+
+void BIZoneEngineUpdateWithBatch(BIZoneEngineRef engine, const BIRangingBatch *batch)
+{
+    engine->engine.update(*batch);
+}
+
+void BIZoneEngineAdvance(BIZoneEngineRef engine, double timestamp)
+{
+    engine->engine.advance(timestamp);
+}
+
+bool BIZoneEngineIsInside(BIZoneEngineRef engine, uint32_t zoneID)
+{
+    return engine->engine.isInside(zoneID);
+}
+
+BIZoneEngineStatistics BIZoneEngineGetStatistics(BIZoneEngineRef engine)
+{
+    return engine->engine.statistics();
+}
@@ -0,0 +1,133 @@
+//
+//  ZoneEngine.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#pragma once
+
+#include <BICore/BIZoneEngine.h>
+
+#include "BeaconKey.hpp"
+#include "TimerWheel.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace bi {
+
+// Conditions are stored grouped by beacon, so a changed beacon re-checks one contiguous range of them. The zone programs
+// live one after another in _program; a program pushes condition values and combines the top of a small stack, which
+// is sized for the deepest program when the engine is created. Timer IDs are condition indexes followed by zone indexes.
+class ZoneEngine {
+public:
+    static bool isValid(const BIZoneDefinition &zone);
+
+    // The definitions must be valid and their IDs unique.
+    ZoneEngine(const BIZoneEngineConfiguration &configuration, const BIZoneDefinition *zones, size_t count,
+               BIZoneTransitionHandler handler, void *context);
+
+    void update(double timestamp, const BIRangedBeacon *beacons, size_t count);
+    void update(const BIRangingBatch &batch);
+    void advance(double timestamp);
+
+    bool isInside(uint32_t zoneID) const;
+    const BIZoneEngineStatistics &statistics() const { return _statistics; }
+
+private:
+    enum class Operation : uint8_t { Push, All, Any, AtLeast, Not };
+    enum class Pending : uint8_t { None, Enter, Exit };
+
+    struct Instruction {
+        Operation operation;
+        uint32_t count;    // children
+        uint32_t argument; // condition index for Push, threshold for AtLeast
+    };
+
+    struct Reading {
+        bool inRange;
+        int32_t RSSI;
+        int32_t proximity;
+
+        bool operator==(const Reading &other) const
+        {
+            return inRange == other.inRange && RSSI == other.RSSI && proximity == other.proximity;
+        }
+    };
+
+    // Beacon handles are dense, so the beacon of a handle is cached by handle; the key tells if the entry still holds.
+    struct CachedHandle {
+        BIBeaconKey key;
+        uint32_t beacon; // Absent for beacons that no zone refers to, Unfilled for empty entries
+    };
+
+    static constexpr uint32_t Absent = UINT32_MAX;
+    static constexpr uint32_t Unfilled = UINT32_MAX - 1;
+    static constexpr uint32_t maximumCachedHandle = 65536;
+
+    struct Beacon {
+        uint32_t firstCondition;
+        uint32_t conditionCount;
+        Reading current;
+        Reading observed; // in the current tick
+        uint64_t observedTick;
+        bool live; // in _liveBeacons
+    };
+
+    // What a changed beacon reads for each of its conditions; the dwell times are kept apart.
+    struct Condition {
+        uint32_t zone;
+        int32_t minimumRSSI;
+        int32_t maximumProximity;
+        bool holds; // the thresholds are met; the value follows after the dwell time
+    };
+
+    struct Zone {
+        uint32_t id;
+        uint32_t firstInstruction;
+        uint32_t instructionCount;
+        double enterDwellTime;
+        double exitDwellTime;
+        bool value;
+        bool inside;
+        bool dirty;
+        Pending pending;
+    };
+
+    uint32_t findBeacon(const BIRangedBeacon &beacon);
+    void observe(const BIRangedBeacon &beacon);
+    void finishTick(double timestamp);
+    void start();
+    void setReading(uint32_t beacon, const Reading &reading, double timestamp);
+    void setValue(uint32_t condition, bool value);
+    void evaluateDirtyZones(double timestamp);
+    void evaluate(uint32_t zone, double timestamp);
+    void fire(uint32_t zone, double timestamp);
+    void advanceTimers(double timestamp);
+
+    BIZoneTransitionHandler _handler;
+    void *_context;
+
+    std::vector<Beacon> _beacons;
+    std::unordered_map<BIBeaconKey, uint32_t, BeaconKeyHash> _beaconsByKey;
+    std::vector<CachedHandle> _beaconsByHandle;
+    std::vector<Condition> _conditions;
+    std::vector<double> _dwellTimes; // per condition
+    std::vector<uint8_t> _values; // per condition, read by the programs
+    std::vector<Instruction> _program;
+    std::vector<Zone> _zones;
+    std::unordered_map<uint32_t, uint32_t> _zonesByID;
+
+    std::vector<uint32_t> _stack;
+    std::vector<uint32_t> _observedBeacons; // in the current tick
+    std::vector<uint32_t> _liveBeacons;     // in range as of the previous tick
+    std::vector<uint32_t> _dirtyZones;
+    double _dirtySince = 0.0; // time of the condition timers waiting in _dirtyZones
+    uint64_t _tick = 0;
+    bool _started = false; // every zone has been evaluated once
+    TimerWheel _timers;
+    BIZoneEngineStatistics _statistics = {};
+};
+
+} // namespace bi
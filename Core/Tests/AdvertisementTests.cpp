@@ -0,0 +1,163 @@
+//
+//  AdvertisementTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIAdvertisement.h>
+
+#include "TestHarness.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+std::vector<uint8_t> iBeaconData(const BIBeaconKey &key, int8_t measuredPower)
+{
+    std::vector<uint8_t> data(25);
+    const uint8_t prefix[] = {0x4C, 0x00, 0x02, 0x15};
+    std::memcpy(data.data(), prefix, sizeof(prefix));
+    std::memcpy(data.data() + 4, key.proximityUUID, sizeof(key.proximityUUID));
+    data[20] = uint8_t(key.major >> 8);
+    data[21] = uint8_t(key.major);
+    data[22] = uint8_t(key.minor >> 8);
+    data[23] = uint8_t(key.minor);
+    data[24] = uint8_t(measuredPower);
+    return data;
+}
+
+// An AD structure of a raw payload.
+void appendStructure(std::vector<uint8_t> &payload, uint8_t type, const std::vector<uint8_t> &data)
+{
+    payload.push_back(uint8_t(data.size() + 1));
+    payload.push_back(type);
+    payload.insert(payload.end(), data.begin(), data.end());
+}
+
+std::string copyURL(const BIAdvertisement &advertisement, size_t capacity = 64)
+{
+    std::vector<char> buffer(capacity + 1, 'x');
+    BIAdvertisementCopyURL(&advertisement, buffer.data(), capacity);
+    return std::string(buffer.data());
+}
+
+} // namespace
+
+TEST(iBeaconManufacturerDataIsDecoded)
+{
+    BIBeaconKey key = beaconKey(0x0304, 0x0102);
+    std::vector<uint8_t> data = iBeaconData(key, -59);
+    BIAdvertisement advertisement = {};
+    REQUIRE(BIAdvertisementDecodeManufacturerData(data.data(), data.size(), &advertisement));
+    CHECK_EQUAL(BIAdvertisementTypeIBeacon, advertisement.type);
+    CHECK(BIBeaconKeyEqual(&key, &advertisement.key));
+    CHECK_EQUAL(-59, advertisement.measuredPower);
+
+    // Too short, or another company's data: the advertisement is left alone.
+    BIAdvertisement untouched = {};
+    CHECK(!BIAdvertisementDecodeManufacturerData(data.data(), data.size() - 1, &untouched));
+    data[0] = 0x4D;
+    CHECK(!BIAdvertisementDecodeManufacturerData(data.data(), data.size(), &untouched));
+    CHECK_EQUAL(BIAdvertisementTypeUnknown, untouched.type);
+}
+
+TEST(eddystoneFramesAreDecoded)
+{
+    BIAdvertisement advertisement = {};
+    std::vector<uint8_t> UID = {0x00, 0xEE, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    REQUIRE(BIAdvertisementDecodeServiceData(0xFEAA, UID.data(), UID.size(), &advertisement));
+    CHECK_EQUAL(BIAdvertisementTypeEddystoneUID, advertisement.type);
+    CHECK_EQUAL(-18, advertisement.measuredPower);
+    CHECK_EQUAL(9, advertisement.namespaceID[9]);
+    CHECK_EQUAL(15, advertisement.instanceID[5]);
+    CHECK(!BIAdvertisementDecodeServiceData(0xFEAB, UID.data(), UID.size(), &advertisement));
+    CHECK(!BIAdvertisementDecodeServiceData(0xFEAA, UID.data(), 17, &advertisement));
+
+    std::vector<uint8_t> TLM = {0x20, 0x00, 0x0B, 0xB8, 0x17, 0x80, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x2C};
+    REQUIRE(BIAdvertisementDecodeServiceData(0xFEAA, TLM.data(), TLM.size(), &advertisement));
+    CHECK_EQUAL(BIAdvertisementTypeEddystoneTLM, advertisement.type);
+    CHECK_EQUAL(3000u, advertisement.batteryVoltage);
+    CHECK_EQUAL(23.5, advertisement.temperature);
+    CHECK_EQUAL(65536u, advertisement.advertisementCount);
+    CHECK_EQUAL(30.0, advertisement.uptime);
+    TLM[4] = 0x80;
+    TLM[5] = 0x00;
+    REQUIRE(BIAdvertisementDecodeServiceData(0xFEAA, TLM.data(), TLM.size(), &advertisement));
+    CHECK(std::isnan(advertisement.temperature));
+    TLM[1] = 0x01; // encrypted
+    CHECK(!BIAdvertisementDecodeServiceData(0xFEAA, TLM.data(), TLM.size(), &advertisement));
+
+    std::vector<uint8_t> EID = {0x30, 0xF0, 1, 2, 3, 4, 5, 6, 7, 8};
+    REQUIRE(BIAdvertisementDecodeServiceData(0xFEAA, EID.data(), EID.size(), &advertisement));
+    CHECK_EQUAL(BIAdvertisementTypeEddystoneEID, advertisement.type);
+    CHECK_EQUAL(8, advertisement.ephemeralID[7]);
+}
+
+TEST(eddystoneURLsAreExpanded)
+{
+    // "https://" "beacon" ".com/" "x", with a reserved code that is skipped.
+    std::vector<uint8_t> URL = {0x10, 0xF4, 0x03, 'b', 'e', 'a', 'c', 'o', 'n', 0x00, 0x15, 'x'};
+    BIAdvertisement advertisement = {};
+    REQUIRE(BIAdvertisementDecodeServiceData(0xFEAA, URL.data(), URL.size(), &advertisement));
+    CHECK_EQUAL(BIAdvertisementTypeEddystoneURL, advertisement.type);
+    CHECK(advertisement.URL == URL.data() + 3);
+    CHECK_EQUAL(std::string("https://beacon.com/x"), copyURL(advertisement));
+    CHECK_EQUAL(20u, BIAdvertisementCopyURL(&advertisement, NULL, 0));
+    CHECK_EQUAL(std::string("https"), copyURL(advertisement, 6));
+
+    URL[2] = 0x04;
+    CHECK(!BIAdvertisementDecodeServiceData(0xFEAA, URL.data(), URL.size(), &advertisement));
+}
+
+TEST(payloadsAreWalkedStructureByStructure)
+{
+    std::vector<uint8_t> payload;
+    appendStructure(payload, 0x01, {0x06});
+    appendStructure(payload, 0x16, {0x0F, 0x18, 0x64}); // battery service data
+    appendStructure(payload, 0xFF, iBeaconData(beaconKey(7), -60));
+    BIAdvertisement advertisement = {};
+    REQUIRE(BIAdvertisementDecodePayload(payload.data(), payload.size(), &advertisement));
+    CHECK_EQUAL(BIAdvertisementTypeIBeacon, advertisement.type);
+    CHECK_EQUAL(7u, advertisement.key.minor);
+
+    std::vector<uint8_t> eddystone;
+    appendStructure(eddystone, 0x03, {0xAA, 0xFE});
+    appendStructure(eddystone, 0x16, {0xAA, 0xFE, 0x30, 0xF0, 1, 2, 3, 4, 5, 6, 7, 8});
+    REQUIRE(BIAdvertisementDecodePayload(eddystone.data(), eddystone.size(), &advertisement));
+    CHECK_EQUAL(BIAdvertisementTypeEddystoneEID, advertisement.type);
+
+    // A structure running past the end, or of length 0, ends the payload.
+    BIAdvertisement untouched = {};
+    CHECK(!BIAdvertisementDecodePayload(payload.data(), payload.size() - 1, &untouched));
+    std::vector<uint8_t> empty = {0x00, 0x1A, 0xFF};
+    CHECK(!BIAdvertisementDecodePayload(empty.data(), empty.size(), &untouched));
+    CHECK_EQUAL(BIAdvertisementTypeUnknown, untouched.type);
+}
+
+// Every truncation gets a buffer of its own size, so that reads past the end show up in an AddressSanitizer build.
+TEST(truncatedInputsAreRejected)
+{
+    std::vector<uint8_t> payload;
+    appendStructure(payload, 0xFF, iBeaconData(beaconKey(7), -60));
+    for (size_t length = 0; length < payload.size(); length++) {
+        std::vector<uint8_t> truncated(payload.begin(), payload.begin() + std::ptrdiff_t(length));
+        BIAdvertisement advertisement = {};
+        CHECK(!BIAdvertisementDecodePayload(truncated.data(), truncated.size(), &advertisement));
+    }
+
+    std::vector<uint8_t> TLM = {0x20, 0x00, 0x0B, 0xB8, 0x17, 0x80, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x2C};
+    for (size_t length = 0; length < TLM.size(); length++) {
+        std::vector<uint8_t> truncated(TLM.begin(), TLM.begin() + std::ptrdiff_t(length));
+        BIAdvertisement advertisement = {};
+        CHECK(!BIAdvertisementDecodeServiceData(0xFEAA, truncated.data(), truncated.size(), &advertisement));
+    }
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,323 @@
+//
+//  BeaconCacheTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIBeaconCache.h>
+
+#include "TestHarness.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace bi::tests;
+
+namespace {
+
+const char *const cachePath = "BeaconCacheTests.cache";
+
+BICachedBeacon signalUpdate(uint16_t minor, double lastSeen, int32_t RSSI = -60)
+{
+    BICachedBeacon beacon = {};
+    beacon.key = beaconKey(minor);
+    beacon.fields = BICachedBeaconFieldSignal;
+    beacon.lastSeen = lastSeen;
+    beacon.RSSI = RSSI;
+    beacon.proximity = BIProximityNear;
+    beacon.accuracy = 1.5;
+    return beacon;
+}
+
+BIBeaconCacheRef openEmptyCache(uint32_t maximumBeacons = 1024, uint32_t maximumJournalRecords = 8192)
+{
+    std::remove(cachePath);
+    BIBeaconCacheConfiguration configuration = BIBeaconCacheConfigurationMakeDefault();
+    configuration.maximumBeacons = maximumBeacons;
+    configuration.maximumJournalRecords = maximumJournalRecords;
+    return BIBeaconCacheOpen(cachePath, &configuration);
+}
+
+void update(BIBeaconCacheRef cache, const BICachedBeacon &beacon)
+{
+    BIBeaconCacheUpdate(cache, &beacon);
+}
+
+bool contains(BIBeaconCacheRef cache, uint16_t minor)
+{
+    BIBeaconKey key = beaconKey(minor);
+    BICachedBeacon beacon;
+    return BIBeaconCacheLookup(cache, &key, &beacon);
+}
+
+// The address space the process has mapped, or 0 where /proc is unavailable.
+uint64_t mappedBytes()
+{
+    FILE *file = std::fopen("/proc/self/statm", "r");
+    unsigned long pages = 0;
+    if (file) {
+        if (std::fscanf(file, "%lu", &pages) != 1) {
+            pages = 0;
+        }
+        std::fclose(file);
+    }
+    return uint64_t(pages) * uint64_t(sysconf(_SC_PAGESIZE));
+}
+
+} // namespace
+
+TEST(updatesSurviveReopening)
+{
+    BIBeaconCacheRef cache = openEmptyCache();
+    REQUIRE(cache != NULL);
+    update(cache, signalUpdate(1, 10.0, -61));
+    BICachedBeacon metadata = {};
+    metadata.key = beaconKey(1);
+    metadata.fields = BICachedBeaconFieldName | BICachedBeaconFieldBatteryLevel;
+    std::strcpy(metadata.name, "Entrance");
+    metadata.batteryLevel = 87;
+    BIBeaconCacheUpdate(cache, &metadata);
+    CHECK(BIBeaconCacheFlush(cache));
+    BIBeaconCacheClose(cache);
+
+    cache = BIBeaconCacheOpen(cachePath, NULL);
+    REQUIRE(cache != NULL);
+    BIBeaconKey key = beaconKey(1);
+    BICachedBeacon beacon;
+    REQUIRE(BIBeaconCacheLookup(cache, &key, &beacon));
+    CHECK_EQUAL(uint32_t(BICachedBeaconFieldSignal | BICachedBeaconFieldName | BICachedBeaconFieldBatteryLevel),
+                beacon.fields);
+    CHECK_EQUAL(10.0, beacon.lastSeen);
+    CHECK_EQUAL(-61, beacon.RSSI);
+    CHECK(std::strcmp(beacon.name, "Entrance") == 0);
+    CHECK_EQUAL(87, beacon.batteryLevel);
+    CHECK_EQUAL(1u, BIBeaconCacheGetCount(cache));
+    CHECK_EQUAL(1u, BIBeaconCacheGetStatistics(cache).recordsLoaded);
+    BIBeaconCacheClose(cache);
+    std::remove(cachePath);
+}
+
+TEST(removalsSurviveReopening)
+{
+    BIBeaconCacheRef cache = openEmptyCache();
+    REQUIRE(cache != NULL);
+    update(cache, signalUpdate(1, 1.0));
+    update(cache, signalUpdate(2, 2.0));
+    BIBeaconCacheFlush(cache);
+    BIBeaconKey key = beaconKey(1);
+    CHECK(BIBeaconCacheRemove(cache, &key));
+    CHECK(!BIBeaconCacheRemove(cache, &key));
+    BIBeaconCacheClose(cache);
+
+    cache = BIBeaconCacheOpen(cachePath, NULL);
+    REQUIRE(cache != NULL);
+    CHECK(!contains(cache, 1));
+    CHECK(contains(cache, 2));
+    BIBeaconCacheClose(cache);
+    std::remove(cachePath);
+}
+
+TEST(damagedRecordEndsTheJournal)
+{
+    BIBeaconCacheRef cache = openEmptyCache();
+    REQUIRE(cache != NULL);
+    update(cache, signalUpdate(1, 1.0));
+    BIBeaconCacheFlush(cache);
+    update(cache, signalUpdate(2, 2.0));
+    BIBeaconCacheFlush(cache);
+    BIBeaconCacheClose(cache);
+
+    // Flip a byte in the last record.
+    FILE *file = std::fopen(cachePath, "r+b");
+    REQUIRE(file != NULL);
+    std::fseek(file, -8, SEEK_END);
+    int byte = std::fgetc(file);
+    std::fseek(file, -8, SEEK_END);
+    std::fputc(byte ^ 0xFF, file);
+    std::fclose(file);
+
+    cache = BIBeaconCacheOpen(cachePath, NULL);
+    REQUIRE(cache != NULL);
+    CHECK(contains(cache, 1));
+    CHECK(!contains(cache, 2));
+    CHECK_EQUAL(1u, BIBeaconCacheGetStatistics(cache).recordsDiscarded);
+    BIBeaconCacheClose(cache);
+    std::remove(cachePath);
+}
+
+TEST(fullJournalIsCompacted)
+{
+    BIBeaconCacheRef cache = openEmptyCache(4, 8);
+    REQUIRE(cache != NULL);
+    for (int round = 0; round < 5; round++) {
+        for (uint16_t minor = 1; minor <= 4; minor++) {
+            update(cache, signalUpdate(minor, round * 10.0 + minor));
+        }
+        CHECK(BIBeaconCacheFlush(cache));
+    }
+    CHECK(BIBeaconCacheGetStatistics(cache).compactions > 0);
+    BIBeaconCacheClose(cache);
+
+    cache = BIBeaconCacheOpen(cachePath, NULL);
+    REQUIRE(cache != NULL);
+    BIBeaconKey key = beaconKey(3);
+    BICachedBeacon beacon;
+    CHECK(BIBeaconCacheLookup(cache, &key, &beacon));
+    CHECK_EQUAL(43.0, beacon.lastSeen);
+    CHECK_EQUAL(4u, BIBeaconCacheGetCount(cache));
+    BIBeaconCacheClose(cache);
+    std::remove(cachePath);
+}
+
+// Updates in and out of time order, beacons without a signal and removals, checked against the beacons a model
+// ordered by last seen time keeps.
+TEST(failedCompactionKeepsTheOldFile)
+{
+    // Every flush compacts: the journal has no room beyond one record per beacon.
+    const uint16_t count = 16384;
+    BIBeaconCacheRef cache = openEmptyCache(count, count);
+    REQUIRE(cache != NULL);
+    for (uint16_t minor = 1; minor <= count; minor++) {
+        update(cache, signalUpdate(minor, minor));
+    }
+    REQUIRE(BIBeaconCacheFlush(cache));
+    struct stat file;
+    REQUIRE(stat(cachePath, &file) == 0);
+    uint64_t mapped = mappedBytes();
+    if (mapped == 0) {
+        BIBeaconCacheClose(cache);
+        std::remove(cachePath);
+        return;
+    }
+
+    // Leave room for the compacted records but not for a second mapping of them.
+    update(cache, signalUpdate(1, 100000.0));
+    struct rlimit limit;
+    REQUIRE(getrlimit(RLIMIT_AS, &limit) == 0);
+    struct rlimit lowered = limit;
+    lowered.rlim_cur = rlim_t(mapped + uint64_t(file.st_size) * 3 / 2);
+    REQUIRE(setrlimit(RLIMIT_AS, &lowered) == 0);
+    bool flushed = BIBeaconCacheFlush(cache);
+    setrlimit(RLIMIT_AS, &limit);
+    CHECK(!flushed);
+    CHECK_EQUAL(1u, BIBeaconCacheGetStatistics(cache).failedFlushes);
+    CHECK(stat((std::string(cachePath) + ".tmp").c_str(), &file) != 0);
+
+    // The beacons are still read from the old file, and the next flush retries the compaction.
+    BIBeaconKey key = beaconKey(count);
+    BICachedBeacon beacon;
+    REQUIRE(BIBeaconCacheLookup(cache, &key, &beacon));
+    CHECK_EQUAL(double(count), beacon.lastSeen);
+    CHECK_EQUAL(size_t(count), BIBeaconCacheGetCount(cache));
+    CHECK(BIBeaconCacheFlush(cache));
+    BIBeaconCacheClose(cache);
+
+    cache = BIBeaconCacheOpen(cachePath, NULL);
+    REQUIRE(cache != NULL);
+    key = beaconKey(1);
+    REQUIRE(BIBeaconCacheLookup(cache, &key, &beacon));
+    CHECK_EQUAL(100000.0, beacon.lastSeen);
+    key = beaconKey(count);
+    REQUIRE(BIBeaconCacheLookup(cache, &key, &beacon));
+    CHECK_EQUAL(double(count), beacon.lastSeen);
+    BIBeaconCacheClose(cache);
+    std::remove(cachePath);
+}
+
+TEST(evictsLeastRecentlySeen)
+{
+    const uint32_t capacity = 16;
+    BIBeaconCacheRef cache = openEmptyCache(capacity);
+    REQUIRE(cache != NULL);
+    std::map<uint16_t, double> model;
+    uint64_t state = 7;
+    auto next = [&state](uint32_t bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return uint32_t(state >> 33) % bound;
+    };
+    for (int i = 1; i <= 2000; i++) {
+        uint16_t minor = uint16_t(1 + next(64));
+        uint32_t kind = next(10);
+        if (kind == 0) {
+            BIBeaconKey key = beaconKey(minor);
+            CHECK_EQUAL(model.erase(minor) == 1, BIBeaconCacheRemove(cache, &key));
+            continue;
+        }
+        BICachedBeacon beacon;
+        double lastSeen = model.count(minor) ? model[minor] : 0.0;
+        if (kind == 1) {
+            // Metadata only: the beacon keeps its last seen time (0 if it has no signal yet).
+            beacon = {};
+            beacon.key = beaconKey(minor);
+            beacon.fields = BICachedBeaconFieldMeasuredPower;
+            beacon.measuredPower = -59;
+        } else {
+            // Mostly in time order, sometimes late.
+            lastSeen = kind == 2 ? double(i - int(next(100))) : double(i);
+            beacon = signalUpdate(minor, lastSeen);
+        }
+        bool full = !model.count(minor) && model.size() == capacity;
+        update(cache, beacon);
+        if (full) {
+            // Exactly one beacon was evicted, one of those seen longest ago (ties may go either way).
+            double oldest = model.begin()->second;
+            for (auto &entry : model) {
+                oldest = std::min(oldest, entry.second);
+            }
+            std::vector<uint16_t> evicted;
+            for (auto &entry : model) {
+                if (!contains(cache, entry.first)) {
+                    evicted.push_back(entry.first);
+                }
+            }
+            REQUIRE(evicted.size() == 1);
+            CHECK_EQUAL(oldest, model[evicted[0]]);
+            model.erase(evicted[0]);
+        }
+        model[minor] = lastSeen;
+        for (auto &entry : model) {
+            REQUIRE(contains(cache, entry.first));
+        }
+        CHECK_EQUAL(model.size(), BIBeaconCacheGetCount(cache));
+        if (i % 500 == 0) {
+            BIBeaconCacheFlush(cache);
+        }
+    }
+    BIBeaconCacheClose(cache);
+    std::remove(cachePath);
+}
+
+TEST(loadEvictsDownToTheLimit)
+{
+    BIBeaconCacheRef cache = openEmptyCache(100);
+    REQUIRE(cache != NULL);
+    for (uint16_t minor = 1; minor <= 100; minor++) {
+        update(cache, signalUpdate(minor, 1000.0 - minor));
+    }
+    BIBeaconCacheClose(cache);
+
+    BIBeaconCacheConfiguration configuration = BIBeaconCacheConfigurationMakeDefault();
+    configuration.maximumBeacons = 10;
+    cache = BIBeaconCacheOpen(cachePath, &configuration);
+    REQUIRE(cache != NULL);
+    CHECK_EQUAL(10u, BIBeaconCacheGetCount(cache));
+    CHECK(contains(cache, 1));
+    CHECK(contains(cache, 10));
+    CHECK(!contains(cache, 11));
+    BIBeaconCacheClose(cache);
+    std::remove(cachePath);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
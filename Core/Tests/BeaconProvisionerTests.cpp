@@ -0,0 +1,302 @@
+//
+//  BeaconProvisionerTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIBeaconProvisioner.h>
+
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+enum OperationKind { Connect, Disconnect, DiscoverServices, DiscoverCharacteristics, Write, Read };
+
+struct Operation {
+    OperationKind kind;
+    uint32_t deviceID;
+    uint16_t characteristic; // short UUID of writes and reads
+    std::vector<uint8_t> value;
+};
+
+const uint16_t configurationService = 0xFFF0;
+const uint16_t passkeyCharacteristic = 0xFFF1;
+const uint16_t majorCharacteristic = 0xFFF3;
+const uint16_t minorCharacteristic = 0xFFF4;
+const uint16_t rebootCharacteristic = 0xFFF7;
+
+BIGATTCharacteristicPath path(uint16_t characteristic)
+{
+    return BIGATTCharacteristicPath{BIGATTUUIDMakeShort(configurationService), BIGATTUUIDMakeShort(characteristic)};
+}
+
+uint16_t shortUUID(const BIGATTUUID &uuid)
+{
+    return uint16_t(uuid.bytes[2] << 8 | uuid.bytes[3]);
+}
+
+// Records what the provisioner asks for; the tests answer by hand.
+class Transport {
+public:
+    Transport()
+    {
+        _characteristics.passkey = path(passkeyCharacteristic);
+        _characteristics.proximityUUID = path(0xFFF2);
+        _characteristics.major = path(majorCharacteristic);
+        _characteristics.minor = path(minorCharacteristic);
+        _characteristics.TXPowerLevel = path(0xFFF5);
+        _characteristics.advertisingInterval = path(0xFFF6);
+        _characteristics.reboot = path(rebootCharacteristic);
+    }
+
+    BIBeaconProvisionerRef create(const BIBeaconProvisionerConfiguration &configuration)
+    {
+        BIGATTTransport transport = {};
+        transport.connect = [](uint32_t deviceID, void *context) {
+            static_cast<Transport *>(context)->operations.push_back({Connect, deviceID, 0, {}});
+        };
+        transport.disconnect = [](uint32_t deviceID, void *context) {
+            static_cast<Transport *>(context)->operations.push_back({Disconnect, deviceID, 0, {}});
+        };
+        transport.discoverServices = [](uint32_t deviceID, const BIGATTUUID *, size_t, void *context) {
+            static_cast<Transport *>(context)->operations.push_back({DiscoverServices, deviceID, 0, {}});
+        };
+        transport.discoverCharacteristics = [](uint32_t deviceID, const BIGATTUUID *, const BIGATTUUID *, size_t,
+                                               void *context) {
+            static_cast<Transport *>(context)->operations.push_back({DiscoverCharacteristics, deviceID, 0, {}});
+        };
+        transport.writeValue = [](uint32_t deviceID, const BIGATTCharacteristicPath *path, const uint8_t *value,
+                                  size_t length, void *context) {
+            static_cast<Transport *>(context)->operations.push_back(
+                {Write, deviceID, shortUUID(path->characteristic), std::vector<uint8_t>(value, value + length)});
+        };
+        transport.readValue = [](uint32_t deviceID, const BIGATTCharacteristicPath *path, void *context) {
+            Transport *self = static_cast<Transport *>(context);
+            self->operations.push_back({Read, deviceID, shortUUID(path->characteristic), {}});
+        };
+        BIBeaconProvisionerHandlers handlers = {};
+        handlers.deviceFinished = [](const BIBeaconProvisioningResult *result, void *context) {
+            static_cast<Transport *>(context)->finished.push_back(*result);
+        };
+        handlers.jobFinished = [](void *context) { static_cast<Transport *>(context)->jobFinished = true; };
+        provisioner = BIBeaconProvisionerCreate(&configuration, &_characteristics, &transport, handlers, this);
+        return provisioner;
+    }
+
+    size_t count(OperationKind kind) const
+    {
+        size_t count = 0;
+        for (const Operation &operation : operations) {
+            count += operation.kind == kind;
+        }
+        return count;
+    }
+
+    // Answers the connection and both discoveries of the device with success and every characteristic.
+    void connectAndDiscover(uint32_t deviceID, double timestamp)
+    {
+        BIBeaconProvisionerDidConnect(provisioner, deviceID, timestamp, BIGATTStatusSuccess);
+        BIGATTUUID service = BIGATTUUIDMakeShort(configurationService);
+        BIBeaconProvisionerDidDiscoverServices(provisioner, deviceID, timestamp, BIGATTStatusSuccess, &service, 1);
+        std::vector<BIGATTUUID> characteristics;
+        for (uint16_t characteristic = 0xFFF1; characteristic <= 0xFFF7; characteristic++) {
+            characteristics.push_back(BIGATTUUIDMakeShort(characteristic));
+        }
+        BIBeaconProvisionerDidDiscoverCharacteristics(provisioner, deviceID, timestamp, &service, BIGATTStatusSuccess,
+                                                      characteristics.data(), characteristics.size());
+    }
+
+    std::vector<Operation> operations;
+    std::vector<BIBeaconProvisioningResult> finished;
+    bool jobFinished = false;
+    BIBeaconProvisionerRef provisioner = NULL;
+
+private:
+    BIBeaconCharacteristics _characteristics;
+};
+
+BIBeaconProvisioningTarget target(uint32_t deviceID, uint16_t major, uint16_t minor)
+{
+    BIBeaconProvisioningTarget target = {};
+    target.deviceID = deviceID;
+    target.settings = BIBeaconSettingMajor | BIBeaconSettingMinor;
+    target.key = beaconKey(minor, major);
+    return target;
+}
+
+const uint8_t passkey[] = {'1', '2', '3', '4'};
+
+} // namespace
+
+TEST(provisionsVerifiesAndReboots)
+{
+    Transport transport;
+    BIBeaconProvisionerRef provisioner = transport.create(BIBeaconProvisionerConfigurationMakeDefault());
+    BIBeaconProvisioningTarget targets[] = {target(7, 0x0102, 0x0304)};
+    REQUIRE(BIBeaconProvisionerStart(provisioner, 0.0, targets, 1, passkey, sizeof(passkey), NULL, 0));
+    transport.connectAndDiscover(7, 1.0);
+    REQUIRE(transport.operations.back().kind == Write);
+    CHECK_EQUAL(passkeyCharacteristic, transport.operations.back().characteristic);
+
+    BIGATTCharacteristicPath written = path(passkeyCharacteristic);
+    BIBeaconProvisionerDidWriteValue(provisioner, 7, 1.5, &written, BIGATTStatusSuccess);
+    REQUIRE(transport.count(Write) == 3);
+    const Operation &major = transport.operations[transport.operations.size() - 2];
+    CHECK_EQUAL(majorCharacteristic, major.characteristic);
+    CHECK(major.value == std::vector<uint8_t>({0x02, 0x01}));
+    written = path(majorCharacteristic);
+    BIBeaconProvisionerDidWriteValue(provisioner, 7, 2.0, &written, BIGATTStatusSuccess);
+    written = path(minorCharacteristic);
+    BIBeaconProvisionerDidWriteValue(provisioner, 7, 2.0, &written, BIGATTStatusSuccess);
+    CHECK_EQUAL(2u, transport.count(Read));
+
+    const uint8_t majorValue[] = {0x02, 0x01};
+    const uint8_t minorValue[] = {0x04, 0x03};
+    BIGATTCharacteristicPath read = path(majorCharacteristic);
+    BIBeaconProvisionerDidReadValue(provisioner, 7, 2.5, &read, BIGATTStatusSuccess, majorValue, 2);
+    read = path(minorCharacteristic);
+    BIBeaconProvisionerDidReadValue(provisioner, 7, 2.5, &read, BIGATTStatusSuccess, minorValue, 2);
+    REQUIRE(transport.operations.back().kind == Write);
+    CHECK_EQUAL(rebootCharacteristic, transport.operations.back().characteristic);
+
+    // The device drops the connection when it reboots.
+    BIBeaconProvisionerDidDisconnect(provisioner, 7, 3.0);
+    REQUIRE(transport.finished.size() == 1);
+    CHECK_EQUAL(BIProvisioningStatusProvisioned, transport.finished[0].status);
+    CHECK(transport.finished[0].rebooted);
+    CHECK_EQUAL(1u, transport.finished[0].attempts);
+    CHECK_EQUAL(3.0, transport.finished[0].finishedAt);
+    CHECK(transport.jobFinished);
+    CHECK_EQUAL(2u, BIBeaconProvisionerGetStatistics(provisioner).valuesWritten);
+
+    // Resuming with the progress skips the device, but not once its target changes.
+    std::vector<uint8_t> progress(BIBeaconProvisionerCopyProgress(provisioner, NULL, 0));
+    BIBeaconProvisionerCopyProgress(provisioner, progress.data(), progress.size());
+    BIBeaconProvisioningTarget resumed[] = {target(7, 0x0102, 0x0304), target(8, 1, 1)};
+    transport.operations.clear();
+    REQUIRE(BIBeaconProvisionerStart(provisioner, 10.0, resumed, 2, passkey, sizeof(passkey), progress.data(),
+                                     progress.size()));
+    CHECK_EQUAL(BIProvisioningStatusAlreadyProvisioned, BIBeaconProvisionerGetDeviceResult(provisioner, 0).status);
+    REQUIRE(transport.count(Connect) == 1);
+    CHECK_EQUAL(8u, transport.operations[0].deviceID);
+    BIBeaconProvisionerCancel(provisioner, 11.0);
+
+    resumed[0].key.minor = 5;
+    transport.operations.clear();
+    REQUIRE(BIBeaconProvisionerStart(provisioner, 20.0, resumed, 1, passkey, sizeof(passkey), progress.data(),
+                                     progress.size()));
+    CHECK_EQUAL(1u, transport.count(Connect));
+    BIBeaconProvisionerDestroy(provisioner);
+}
+
+TEST(failedConnectionsAreRetriedAfterTheDelay)
+{
+    Transport transport;
+    BIBeaconProvisionerConfiguration configuration = BIBeaconProvisionerConfigurationMakeDefault();
+    configuration.maximumAttempts = 2;
+    configuration.retryDelay = 2.0;
+    BIBeaconProvisionerRef provisioner = transport.create(configuration);
+    BIBeaconProvisioningTarget targets[] = {target(1, 1, 1)};
+    BIBeaconProvisionerStart(provisioner, 0.0, targets, 1, NULL, 0, NULL, 0);
+    BIBeaconProvisionerDidConnect(provisioner, 1, 0.5, BIGATTStatusError);
+    // Answers for an attempt that has ended are ignored.
+    BIBeaconProvisionerDidDisconnect(provisioner, 1, 0.6);
+    BIBeaconProvisionerAdvance(provisioner, 2.4);
+    CHECK_EQUAL(1u, transport.count(Connect));
+    BIBeaconProvisionerAdvance(provisioner, 2.5);
+    CHECK_EQUAL(2u, transport.count(Connect));
+
+    BIBeaconProvisionerDidConnect(provisioner, 1, 3.0, BIGATTStatusError);
+    REQUIRE(transport.finished.size() == 1);
+    CHECK_EQUAL(BIProvisioningStatusFailed, transport.finished[0].status);
+    CHECK_EQUAL(BIGATTStatusError, transport.finished[0].error);
+    CHECK_EQUAL(2u, transport.finished[0].attempts);
+    CHECK_EQUAL(0.0, transport.finished[0].startedAt);
+    BIBeaconProvisionerStatistics statistics = BIBeaconProvisionerGetStatistics(provisioner);
+    CHECK_EQUAL(2u, statistics.connectionAttempts);
+    CHECK_EQUAL(0u, statistics.disconnections);
+    BIBeaconProvisionerDestroy(provisioner);
+}
+
+TEST(connectionLimitAndTimeouts)
+{
+    Transport transport;
+    BIBeaconProvisionerConfiguration configuration = BIBeaconProvisionerConfigurationMakeDefault();
+    configuration.maximumConnections = 2;
+    configuration.maximumAttempts = 1;
+    configuration.connectTimeout = 5.0;
+    configuration.deviceTimeout = 20.0;
+    BIBeaconProvisionerRef provisioner = transport.create(configuration);
+    BIBeaconProvisioningTarget targets[] = {target(1, 1, 1), target(2, 1, 2), target(3, 1, 3)};
+    BIBeaconProvisionerStart(provisioner, 0.0, targets, 3, NULL, 0, NULL, 0);
+    CHECK_EQUAL(2u, transport.count(Connect));
+
+    // Once connected, a device has the device timeout from the start of its attempt.
+    transport.connectAndDiscover(1, 1.0);
+    BIBeaconProvisionerAdvance(provisioner, 5.0);
+    REQUIRE(transport.finished.size() == 1);
+    CHECK_EQUAL(2u, transport.finished[0].deviceID);
+    CHECK_EQUAL(5.0, transport.finished[0].finishedAt);
+    CHECK_EQUAL(3u, transport.count(Connect));
+    CHECK_EQUAL(3u, transport.operations.back().deviceID);
+
+    BIBeaconProvisionerAdvance(provisioner, 20.0);
+    REQUIRE(transport.finished.size() == 3);
+    CHECK_EQUAL(3u, transport.finished[1].deviceID);
+    CHECK_EQUAL(10.0, transport.finished[1].finishedAt);
+    CHECK_EQUAL(1u, transport.finished[2].deviceID);
+    CHECK_EQUAL(20.0, transport.finished[2].finishedAt);
+    CHECK_EQUAL(BIGATTStatusTimedOut, transport.finished[2].error);
+    CHECK_EQUAL(3u, BIBeaconProvisionerGetStatistics(provisioner).timeouts);
+    CHECK(transport.jobFinished);
+    BIBeaconProvisionerDestroy(provisioner);
+}
+
+TEST(wrongPasskeyIsNotRetried)
+{
+    Transport transport;
+    BIBeaconProvisionerRef provisioner = transport.create(BIBeaconProvisionerConfigurationMakeDefault());
+    BIBeaconProvisioningTarget targets[] = {target(1, 1, 1)};
+    BIBeaconProvisionerStart(provisioner, 0.0, targets, 1, passkey, sizeof(passkey), NULL, 0);
+    transport.connectAndDiscover(1, 1.0);
+    BIGATTCharacteristicPath written = path(passkeyCharacteristic);
+    BIBeaconProvisionerDidWriteValue(provisioner, 1, 1.5, &written, BIGATTStatusError);
+    REQUIRE(transport.finished.size() == 1);
+    CHECK_EQUAL(BIProvisioningStatusAuthenticationFailed, transport.finished[0].status);
+    CHECK_EQUAL(Disconnect, transport.operations.back().kind);
+    BIBeaconProvisionerAdvance(provisioner, 100.0);
+    CHECK_EQUAL(1u, transport.count(Connect));
+    BIBeaconProvisionerDestroy(provisioner);
+}
+
+TEST(cancelFinishesEveryDevice)
+{
+    Transport transport;
+    BIBeaconProvisionerConfiguration configuration = BIBeaconProvisionerConfigurationMakeDefault();
+    configuration.maximumConnections = 1;
+    BIBeaconProvisionerRef provisioner = transport.create(configuration);
+    BIBeaconProvisioningTarget targets[] = {target(1, 1, 1), target(2, 1, 2)};
+    BIBeaconProvisionerStart(provisioner, 0.0, targets, 2, NULL, 0, NULL, 0);
+    BIBeaconProvisionerCancel(provisioner, 1.0);
+    CHECK_EQUAL(1u, transport.count(Disconnect));
+    REQUIRE(transport.finished.size() == 2);
+    CHECK_EQUAL(BIProvisioningStatusCancelled, transport.finished[0].status);
+    CHECK_EQUAL(BIProvisioningStatusCancelled, transport.finished[1].status);
+    CHECK(transport.jobFinished);
+    CHECK(BIBeaconProvisionerIsFinished(provisioner));
+
+    // Nothing is left to connect or time out.
+    BIBeaconProvisionerAdvance(provisioner, 100.0);
+    CHECK_EQUAL(1u, transport.count(Connect));
+    BIBeaconProvisionerDestroy(provisioner);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,143 @@
+//
+//  BeaconTableTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIBeaconTable.h>
+
+#include "TestHarness.hpp"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+BIBeaconTableRef createTable(uint32_t maximumCount, double idleTimeout)
+{
+    BIBeaconTableConfiguration configuration = BIBeaconTableConfigurationMakeDefault();
+    configuration.maximumCount = maximumCount;
+    configuration.idleTimeout = idleTimeout;
+    return BIBeaconTableCreate(&configuration);
+}
+
+BIBeaconHandle intern(BIBeaconTableRef table, uint16_t minor, double timestamp)
+{
+    BIBeaconKey key = beaconKey(minor);
+    return BIBeaconTableIntern(table, &key, timestamp);
+}
+
+bool contains(BIBeaconTableRef table, uint16_t minor)
+{
+    BIBeaconKey key = beaconKey(minor);
+    return BIBeaconTableLookup(table, &key) != BIBeaconHandleInvalid;
+}
+
+} // namespace
+
+TEST(internedBeaconsKeepTheirHandle)
+{
+    BIBeaconTableRef table = createTable(16, 0.0);
+    BIBeaconHandle first = intern(table, 1, 1.0);
+    BIBeaconHandle second = intern(table, 2, 1.0);
+    CHECK(first != second);
+    CHECK_EQUAL(first, intern(table, 1, 2.0));
+    BIBeaconKey key = beaconKey(2, 2);
+    CHECK_EQUAL(BIBeaconHandleInvalid, BIBeaconTableLookup(table, &key));
+    REQUIRE(BIBeaconTableGetKey(table, second, &key));
+    CHECK_EQUAL(2, key.minor);
+    CHECK(!BIBeaconTableGetKey(table, 5, &key));
+    CHECK_EQUAL(2u, BIBeaconTableGetCount(table));
+    BIBeaconTableDestroy(table);
+}
+
+TEST(idleBeaconsAreEvicted)
+{
+    BIBeaconTableRef table = createTable(16, 10.0);
+    intern(table, 1, 1.0);
+    intern(table, 2, 5.0);
+    intern(table, 3, 8.0);
+    intern(table, 1, 9.0);
+    CHECK_EQUAL(0u, BIBeaconTableEvictIdle(table, 15.0));
+    CHECK_EQUAL(1u, BIBeaconTableEvictIdle(table, 15.5));
+    CHECK(!contains(table, 2));
+    CHECK_EQUAL(2u, BIBeaconTableEvictIdle(table, 30.0));
+    CHECK_EQUAL(0u, BIBeaconTableGetCount(table));
+    BIBeaconTableDestroy(table);
+}
+
+TEST(reusedHandleGetsANewGeneration)
+{
+    BIBeaconTableRef table = createTable(1, 0.0);
+    BIBeaconHandle handle = intern(table, 1, 1.0);
+    uint32_t generation = BIBeaconTableGetGeneration(table, handle);
+    CHECK_EQUAL(handle, intern(table, 2, 2.0));
+    CHECK(BIBeaconTableGetGeneration(table, handle) != generation);
+    CHECK(!contains(table, 1));
+    BIBeaconTableDestroy(table);
+}
+
+// Interning in and out of time order with idle evictions, checked against the beacons a model ordered by last seen
+// time keeps.
+TEST(fullTableEvictsLeastRecentlySeen)
+{
+    const uint32_t capacity = 32;
+    BIBeaconTableRef table = createTable(capacity, 50.0);
+    std::map<uint16_t, double> model;
+    uint64_t state = 11;
+    auto next = [&state](uint32_t bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return uint32_t(state >> 33) % bound;
+    };
+    for (int i = 1; i <= 5000; i++) {
+        uint16_t minor = uint16_t(1 + next(100));
+        // Mostly in time order, sometimes late.
+        double timestamp = next(8) == 0 ? double(i - int(next(60))) : double(i);
+        bool full = !model.count(minor) && model.size() == capacity;
+        intern(table, minor, timestamp);
+        if (full) {
+            // Exactly one beacon was evicted, one of those seen longest ago (ties may go either way).
+            double oldest = model.begin()->second;
+            for (auto &entry : model) {
+                oldest = std::min(oldest, entry.second);
+            }
+            std::vector<uint16_t> evicted;
+            for (auto &entry : model) {
+                if (!contains(table, entry.first)) {
+                    evicted.push_back(entry.first);
+                }
+            }
+            REQUIRE(evicted.size() == 1);
+            CHECK_EQUAL(oldest, model[evicted[0]]);
+            model.erase(evicted[0]);
+        }
+        model[minor] = std::max(model.count(minor) ? model[minor] : timestamp, timestamp);
+
+        if (i % 100 == 0) {
+            size_t idle = 0;
+            for (auto entry = model.begin(); entry != model.end();) {
+                if (i - entry->second > 50.0) {
+                    entry = model.erase(entry);
+                    idle++;
+                } else {
+                    ++entry;
+                }
+            }
+            CHECK_EQUAL(idle, BIBeaconTableEvictIdle(table, double(i)));
+        }
+        for (auto &entry : model) {
+            REQUIRE(contains(table, entry.first));
+        }
+        CHECK_EQUAL(model.size(), BIBeaconTableGetCount(table));
+    }
+    BIBeaconTableDestroy(table);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
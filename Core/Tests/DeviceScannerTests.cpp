@@ -0,0 +1,210 @@
+//
+//  DeviceScannerTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIDeviceScanner.h>
+
+#include "TestHarness.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+// A delta, copied during the handler call. URLs are expanded since they only live as long as the call.
+struct Delta {
+    double timestamp;
+    std::vector<BIScannedDevice> added;
+    std::vector<BIScannedDevice> updated;
+    std::vector<BIScannedDevice> lost;
+    std::vector<std::string> URLs;
+};
+
+void recordDelta(const BIDeviceScanDelta *delta, void *context)
+{
+    Delta copy;
+    copy.timestamp = delta->timestamp;
+    copy.added.assign(delta->added, delta->added + delta->addedCount);
+    copy.updated.assign(delta->updated, delta->updated + delta->updatedCount);
+    copy.lost.assign(delta->lost, delta->lost + delta->lostCount);
+    for (const BIScannedDevice &device : copy.updated) {
+        char URL[64];
+        BIAdvertisementCopyURL(&device.advertisement, URL, sizeof(URL));
+        copy.URLs.push_back(URL);
+    }
+    static_cast<std::vector<Delta> *>(context)->push_back(copy);
+}
+
+BIDeviceScannerRef createScanner(std::vector<Delta> &deltas, uint32_t maximumDevices = 1024)
+{
+    BIDeviceScannerConfiguration configuration = BIDeviceScannerConfigurationMakeDefault();
+    configuration.maximumDevices = maximumDevices;
+    return BIDeviceScannerCreate(&configuration, &recordDelta, &deltas);
+}
+
+BIPeripheralIdentifier peripheral(uint8_t index)
+{
+    BIPeripheralIdentifier identifier = {};
+    identifier.bytes[0] = 0xC0;
+    identifier.bytes[5] = index;
+    return identifier;
+}
+
+void report(BIDeviceScannerRef scanner, uint8_t index, double timestamp, int32_t RSSI,
+            const BIAdvertisement *advertisement = NULL)
+{
+    BIPeripheralIdentifier identifier = peripheral(index);
+    BIDeviceScannerReportPacket(scanner, &identifier, timestamp, RSSI, advertisement);
+}
+
+bool isPeripheral(const BIScannedDevice &device, uint8_t index)
+{
+    BIPeripheralIdentifier identifier = peripheral(index);
+    return std::memcmp(device.identifier.bytes, identifier.bytes, sizeof(identifier.bytes)) == 0;
+}
+
+} // namespace
+
+TEST(packetsAreBatchedPerDeliveryInterval)
+{
+    std::vector<Delta> deltas;
+    BIDeviceScannerRef scanner = createScanner(deltas);
+    report(scanner, 1, 0.0, -80);
+    REQUIRE(deltas.size() == 1);
+    REQUIRE(deltas[0].added.size() == 1);
+    CHECK(isPeripheral(deltas[0].added[0], 1));
+    CHECK_EQUAL(-80, deltas[0].added[0].lastRSSI);
+
+    report(scanner, 1, 0.2, -60);
+    report(scanner, 1, 0.5, -70);
+    report(scanner, 1, 0.7, BIScannerRSSIUnavailable);
+    BIDeviceScannerAdvance(scanner, 0.9);
+    CHECK_EQUAL(1u, deltas.size());
+    BIDeviceScannerAdvance(scanner, 1.0);
+    REQUIRE(deltas.size() == 2);
+    REQUIRE(deltas[1].updated.size() == 1);
+    const BIScannedDevice &device = deltas[1].updated[0];
+    CHECK_EQUAL(0.0, device.firstSeen);
+    CHECK_EQUAL(0.7, device.lastSeen);
+    CHECK_EQUAL(4u, device.packetCount);
+    CHECK_EQUAL(3u, device.intervalPacketCount);
+    CHECK_EQUAL(-70, device.lastRSSI);
+    CHECK_EQUAL(-70, device.minimumRSSI);
+    CHECK_EQUAL(-60, device.maximumRSSI);
+    CHECK_EQUAL(-65.0, device.meanRSSI);
+    CHECK(deltas[1].added.empty());
+
+    // Nothing changed: no delta.
+    BIDeviceScannerAdvance(scanner, 2.0);
+    CHECK_EQUAL(2u, deltas.size());
+
+    // Packets without an RSSI are counted, but leave the interval's RSSI values unavailable.
+    report(scanner, 1, 2.5, BIScannerRSSIUnavailable);
+    BIDeviceScannerFlush(scanner, 2.5);
+    REQUIRE(deltas.size() == 3);
+    REQUIRE(deltas[2].updated.size() == 1);
+    CHECK_EQUAL(1u, deltas[2].updated[0].intervalPacketCount);
+    CHECK_EQUAL(BIScannerRSSIUnavailable, deltas[2].updated[0].minimumRSSI);
+    CHECK_EQUAL(double(BIScannerRSSIUnavailable), deltas[2].updated[0].meanRSSI);
+    CHECK_EQUAL(-70, deltas[2].updated[0].lastRSSI);
+    CHECK_EQUAL(5u, BIDeviceScannerGetStatistics(scanner).packets);
+    BIDeviceScannerDestroy(scanner);
+}
+
+TEST(silentDevicesAreLost)
+{
+    std::vector<Delta> deltas;
+    BIDeviceScannerRef scanner = createScanner(deltas);
+    report(scanner, 1, 0.0, -80);
+    report(scanner, 2, 0.5, -70);
+    report(scanner, 2, 8.0, -70);
+    BIDeviceScannerAdvance(scanner, 11.0);
+    CHECK_EQUAL(1u, BIDeviceScannerGetDeviceCount(scanner));
+    REQUIRE(!deltas.empty());
+    REQUIRE(deltas.back().lost.size() == 1);
+    CHECK(isPeripheral(deltas.back().lost[0], 1));
+
+    // Seen at 8, so lost at 18, not at 10.5.
+    BIDeviceScannerAdvance(scanner, 17.0);
+    CHECK_EQUAL(1u, BIDeviceScannerGetDeviceCount(scanner));
+    BIDeviceScannerAdvance(scanner, 19.0);
+    CHECK_EQUAL(0u, BIDeviceScannerGetDeviceCount(scanner));
+    REQUIRE(deltas.back().lost.size() == 1);
+    CHECK(isPeripheral(deltas.back().lost[0], 2));
+    CHECK_EQUAL(8.0, deltas.back().lost[0].lastSeen);
+
+    // A lost device that comes back is added again.
+    report(scanner, 1, 20.0, -80);
+    REQUIRE(deltas.back().added.size() == 1);
+    CHECK_EQUAL(20.0, deltas.back().added[0].firstSeen);
+    BIDeviceScannerStatistics statistics = BIDeviceScannerGetStatistics(scanner);
+    CHECK_EQUAL(3u, statistics.devicesAdded);
+    CHECK_EQUAL(2u, statistics.devicesLost);
+    CHECK_EQUAL(0u, statistics.devicesEvicted);
+    BIDeviceScannerDestroy(scanner);
+}
+
+TEST(fullScannerEvictsTheLeastRecentlySeenDevice)
+{
+    std::vector<Delta> deltas;
+    BIDeviceScannerRef scanner = createScanner(deltas, 2);
+    report(scanner, 1, 0.0, -80);
+    report(scanner, 2, 0.5, -70);
+    report(scanner, 3, 0.6, -60);
+    CHECK_EQUAL(2u, BIDeviceScannerGetDeviceCount(scanner));
+    BIDeviceScannerAdvance(scanner, 1.0);
+    REQUIRE(deltas.size() == 2);
+    CHECK_EQUAL(2u, deltas[1].added.size());
+    REQUIRE(deltas[1].lost.size() == 1);
+    CHECK(isPeripheral(deltas[1].lost[0], 1));
+
+    // A device evicted before it was ever delivered is not reported at all.
+    report(scanner, 4, 1.1, -60);
+    report(scanner, 5, 1.2, -60);
+    report(scanner, 6, 1.3, -60);
+    BIDeviceScannerAdvance(scanner, 2.0);
+    REQUIRE(deltas.size() == 3);
+    REQUIRE(deltas[2].added.size() == 2);
+    REQUIRE(deltas[2].lost.size() == 2);
+    for (size_t i = 0; i < 2; i++) {
+        CHECK(isPeripheral(deltas[2].added[i], 5) || isPeripheral(deltas[2].added[i], 6));
+        CHECK(isPeripheral(deltas[2].lost[i], 2) || isPeripheral(deltas[2].lost[i], 3));
+    }
+    CHECK_EQUAL(4u, BIDeviceScannerGetStatistics(scanner).devicesEvicted);
+    BIDeviceScannerDestroy(scanner);
+}
+
+TEST(advertisementsAreCopied)
+{
+    std::vector<Delta> deltas;
+    BIDeviceScannerRef scanner = createScanner(deltas);
+    std::vector<uint8_t> URL = {0x10, 0xF4, 0x03, 'b', 'e', 'a', 'c', 'o', 'n', 0x08};
+    BIAdvertisement advertisement = {};
+    REQUIRE(BIAdvertisementDecodeServiceData(0xFEAA, URL.data(), URL.size(), &advertisement));
+    report(scanner, 1, 0.0, -80);
+    report(scanner, 1, 0.5, -80, &advertisement);
+    std::fill(URL.begin(), URL.end(), uint8_t(0));
+
+    BIScannedDevice devices[2];
+    REQUIRE(BIDeviceScannerCopyDevices(scanner, devices, 2) == 1);
+    CHECK_EQUAL(BIAdvertisementTypeEddystoneURL, devices[0].advertisement.type);
+    CHECK(devices[0].advertisement.URL == NULL);
+
+    BIDeviceScannerAdvance(scanner, 1.0);
+    REQUIRE(deltas.size() == 2);
+    REQUIRE(deltas[1].URLs.size() == 1);
+    CHECK_EQUAL(std::string("https://beacon.org"), deltas[1].URLs[0]);
+    CHECK_EQUAL(0u, BIDeviceScannerCopyDevices(scanner, devices, 0));
+    BIDeviceScannerDestroy(scanner);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,134 @@
+//
+//  DistanceEstimationTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIDistanceEstimation.h>
+
+#include "TestHarness.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+struct Estimates {
+    explicit Estimates(size_t count) : distances(count, 0.0), accuracies(count, 0.0), proximities(count, 99) {}
+
+    std::vector<double> distances;
+    std::vector<double> accuracies;
+    std::vector<int32_t> proximities;
+};
+
+bool estimate(BIDistanceKernel kernel, const BIDistanceModel &model, const std::vector<int32_t> &RSSI,
+              const std::vector<int32_t> &txPower, Estimates &estimates)
+{
+    return BIEstimateDistancesWithKernel(kernel, &model, RSSI.data(), txPower.data(), RSSI.size(),
+                                         estimates.distances.data(), estimates.accuracies.data(),
+                                         estimates.proximities.data());
+}
+
+bool sameBits(const std::vector<double> &lhs, const std::vector<double> &rhs)
+{
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    // Empty vectors may have null data(), which memcmp() must not be passed even for a size of 0.
+    return lhs.empty() || std::memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(double)) == 0;
+}
+
+} // namespace
+
+TEST(estimatesFollowTheModel)
+{
+    BIDistanceModel model = BIDistanceModelMakeDefault();
+    model.referenceLoss = 0.0;
+    model.pathLossExponent = 2.0;
+    std::vector<int32_t> RSSI = {-79, -50};
+    std::vector<int32_t> txPower = {-59, -59};
+    Estimates estimates(2);
+    REQUIRE(estimate(BIDistanceKernelScalar, model, RSSI, txPower, estimates));
+
+    CHECK_NEAR(10.0, estimates.distances[0], 1e-12);
+    double ratio = 79.0 / 59.0;
+    double accuracy = model.accuracyScale * std::pow(ratio, model.accuracyExponent) + model.accuracyOffset;
+    CHECK_NEAR(accuracy, estimates.accuracies[0], accuracy * 1e-12);
+    CHECK_EQUAL(int32_t(BIProximityForAccuracy(accuracy)), estimates.proximities[0]);
+
+    // Stronger than at 1 m.
+    CHECK_NEAR(std::pow(10.0, -9.0 / 20.0), estimates.distances[1], 1e-12);
+    CHECK_NEAR(std::pow(50.0 / 59.0, 10.0), estimates.accuracies[1], 1e-12);
+    CHECK_EQUAL(int32_t(BIProximityImmediate), estimates.proximities[1]);
+}
+
+TEST(unknownSignalsGetNoEstimate)
+{
+    BIDistanceModel model = BIDistanceModelMakeDefault();
+    model.referenceLoss = 0.0;
+    std::vector<int32_t> RSSI = {0, 5, -60};
+    std::vector<int32_t> txPower = {-59, -59, 0};
+    Estimates estimates(3);
+    BIEstimateDistances(&model, RSSI.data(), txPower.data(), 3, estimates.distances.data(),
+                        estimates.accuracies.data(), estimates.proximities.data());
+    for (size_t i = 0; i < 3; i++) {
+        CHECK_EQUAL(-1.0, estimates.distances[i]);
+        CHECK_EQUAL(-1.0, estimates.accuracies[i]);
+        CHECK_EQUAL(int32_t(BIProximityUnknown), estimates.proximities[i]);
+    }
+}
+
+// Every kernel must give the scalar loop's bits, for every batch length (full vectors, unrolled pairs and tails).
+TEST(kernelsMatchTheScalarLoopBitForBit)
+{
+    BIDistanceModel model = BIDistanceModelMakeDefault();
+    uint32_t state = 7;
+    for (size_t count = 0; count <= 37; count++) {
+        std::vector<int32_t> RSSI(count);
+        std::vector<int32_t> txPower(count);
+        for (size_t i = 0; i < count; i++) {
+            state = state * 1664525u + 1013904223u;
+            RSSI[i] = -int32_t(state >> 25); // 0 ... -127, including unknown RSSIs
+            txPower[i] = -int32_t((state >> 8) % 30) - 4;
+        }
+        Estimates expected(count);
+        REQUIRE(estimate(BIDistanceKernelScalar, model, RSSI, txPower, expected));
+        for (BIDistanceKernel kernel : {BIDistanceKernelAutomatic, BIDistanceKernelSSE2, BIDistanceKernelAVX2,
+                                        BIDistanceKernelNEON}) {
+            Estimates actual(count);
+            if (!estimate(kernel, model, RSSI, txPower, actual)) {
+                CHECK(!BIDistanceKernelIsAvailable(kernel));
+                CHECK(actual.proximities == std::vector<int32_t>(count, 99));
+                continue;
+            }
+            CHECK(sameBits(expected.distances, actual.distances));
+            CHECK(sameBits(expected.accuracies, actual.accuracies));
+            CHECK(expected.proximities == actual.proximities);
+        }
+    }
+    CHECK(BIDistanceKernelIsAvailable(BIDistanceKernelScalar));
+    CHECK(BIDistanceKernelIsAvailable(BIDistanceKernelGetAutomatic()));
+}
+
+TEST(outputsMayBeOmitted)
+{
+    std::vector<int32_t> RSSI = {-70, -80, -90};
+    std::vector<int32_t> txPower = {-20, -20, -20};
+    std::vector<double> distances(3);
+    BIEstimateDistances(NULL, RSSI.data(), txPower.data(), 3, distances.data(), NULL, NULL);
+    Estimates estimates(3);
+    BIEstimateDistances(NULL, RSSI.data(), txPower.data(), 3, estimates.distances.data(), estimates.accuracies.data(),
+                        estimates.proximities.data());
+    CHECK(sameBits(estimates.distances, distances));
+    CHECK(estimates.distances[0] < estimates.distances[1]);
+    CHECK(estimates.distances[1] < estimates.distances[2]);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
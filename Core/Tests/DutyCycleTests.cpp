@@ -0,0 +1,169 @@
+//
+//  DutyCycleTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIDutyCycle.h>
+
+#include "TestHarness.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+// A batch of one region whose nearest beacon does not change.
+class Batch {
+public:
+    explicit Batch(double timestamp)
+    {
+        _region.regionID = 1;
+        _region.nearestBeacon = NULL;
+        _region.nearestBeaconChanged = false;
+        _batch.sequenceNumber = 0;
+        _batch.timestamp = timestamp;
+        _batch.regions = &_region;
+        _batch.regionCount = 1;
+    }
+
+    Batch &add(uint16_t minor, int32_t RSSI, bool inRange = true)
+    {
+        BIRangedBeacon beacon = {};
+        beacon.handle = minor;
+        beacon.key = beaconKey(minor);
+        beacon.smoothedSignal = {_batch.timestamp, inRange ? RSSI : 0, int32_t(BIProximityNear), inRange ? 1.0 : -1.0,
+                                 inRange};
+        beacon.rawSignal = beacon.smoothedSignal;
+        _beacons.push_back(beacon);
+        return *this;
+    }
+
+    const BIRangingBatch *get()
+    {
+        _region.beacons = _beacons.data();
+        _region.beaconCount = _beacons.size();
+        return &_batch;
+    }
+
+private:
+    std::vector<BIRangedBeacon> _beacons;
+    BIRegionRangingResult _region;
+    BIRangingBatch _batch;
+};
+
+} // namespace
+
+TEST(pausedWithoutRegionsOrBluetooth)
+{
+    BIDutyCycleRef dutyCycle = BIDutyCycleCreate(NULL, 0.0);
+    BIDutyCycleState state = BIDutyCycleAdvance(dutyCycle, 0.0);
+    CHECK_EQUAL(BIDutyCycleModePaused, state.mode);
+    CHECK(!state.ranging);
+
+    BIDutyCycleSetActiveRegionCount(dutyCycle, 1.0, 1);
+    state = BIDutyCycleAdvance(dutyCycle, 1.0);
+    CHECK_EQUAL(BIDutyCycleModeContinuous, state.mode);
+    CHECK(state.ranging);
+    CHECK(std::isinf(state.nextChange));
+
+    BIDutyCycleSetBluetoothState(dutyCycle, 2.0, BIBluetoothStatePoweredOff);
+    state = BIDutyCycleAdvance(dutyCycle, 5.0);
+    CHECK(!state.ranging);
+    BIDutyCycleStatistics statistics = BIDutyCycleGetStatistics(dutyCycle);
+    CHECK_NEAR(1.0, statistics.rangingTime, 1e-9);
+    CHECK_NEAR(4.0, statistics.pausedTime, 1e-9);
+    BIDutyCycleDestroy(dutyCycle);
+}
+
+TEST(stableTicksRampDownToWindows)
+{
+    BIDutyCycleRef dutyCycle = BIDutyCycleCreate(NULL, 0.0);
+    BIDutyCycleSetActiveRegionCount(dutyCycle, 0.0, 1);
+    double timestamp = 1.0;
+    for (int tick = 0; tick < 11; tick++, timestamp += 1.0) {
+        BIDutyCycleReportBatch(dutyCycle, Batch(timestamp).add(1, -60).get());
+    }
+    // The first tick is significant, the next ten double the interval twice.
+    BIDutyCycleState state = BIDutyCycleAdvance(dutyCycle, timestamp);
+    CHECK_EQUAL(4.0, state.interval);
+    CHECK_EQUAL(BIDutyCycleModeWindowed, state.mode);
+    BIDutyCycleStatistics statistics = BIDutyCycleGetStatistics(dutyCycle);
+    CHECK_EQUAL(1u, statistics.significantTicks);
+    CHECK_EQUAL(10u, statistics.stableTicks);
+    CHECK_EQUAL(2u, statistics.rampDowns);
+
+    // An entry goes back to continuous ranging.
+    BIDutyCycleReportRegionEvent(dutyCycle, timestamp, BIRegionEventEnter);
+    state = BIDutyCycleAdvance(dutyCycle, timestamp);
+    CHECK_EQUAL(BIDutyCycleModeContinuous, state.mode);
+    CHECK(state.ranging);
+    BIDutyCycleDestroy(dutyCycle);
+}
+
+TEST(RSSIChangeIsSignificant)
+{
+    BIDutyCycleRef dutyCycle = BIDutyCycleCreate(NULL, 0.0);
+    BIDutyCycleSetActiveRegionCount(dutyCycle, 0.0, 1);
+    BIDutyCycleReportBatch(dutyCycle, Batch(1.0).add(1, -60).get());
+    BIDutyCycleReportBatch(dutyCycle, Batch(2.0).add(1, -67).get());
+    BIDutyCycleReportBatch(dutyCycle, Batch(3.0).add(1, -68).get());
+    BIDutyCycleStatistics statistics = BIDutyCycleGetStatistics(dutyCycle);
+    CHECK_EQUAL(2u, statistics.significantTicks);
+    CHECK_EQUAL(1u, statistics.stableTicks);
+    BIDutyCycleDestroy(dutyCycle);
+}
+
+// A beacon that was out of range at the last significant tick is new when it comes back, even with its old RSSI.
+TEST(returningBeaconIsSignificant)
+{
+    BIDutyCycleRef dutyCycle = BIDutyCycleCreate(NULL, 0.0);
+    BIDutyCycleSetActiveRegionCount(dutyCycle, 0.0, 1);
+    BIDutyCycleReportBatch(dutyCycle, Batch(1.0).add(1, -60).add(2, -70).get());
+    BIDutyCycleReportBatch(dutyCycle, Batch(2.0).add(1, -60).add(2, 0, false).get());
+    BIDutyCycleReportBatch(dutyCycle, Batch(3.0).add(1, -50).add(2, 0, false).get());
+    BIDutyCycleStatistics statistics = BIDutyCycleGetStatistics(dutyCycle);
+    CHECK_EQUAL(2u, statistics.significantTicks);
+    CHECK_EQUAL(1u, statistics.stableTicks);
+
+    BIDutyCycleReportBatch(dutyCycle, Batch(4.0).add(1, -50).add(2, -70).get());
+    statistics = BIDutyCycleGetStatistics(dutyCycle);
+    CHECK_EQUAL(3u, statistics.significantTicks);
+    CHECK_EQUAL(1u, statistics.stableTicks);
+    BIDutyCycleDestroy(dutyCycle);
+}
+
+TEST(budgetLimitsRadioTime)
+{
+    BIDutyCycleConfiguration configuration = BIDutyCycleConfigurationMakeDefault();
+    configuration.radioBudget = 0.25;
+    configuration.budgetPeriod = 40.0;
+    BIDutyCycleRef dutyCycle = BIDutyCycleCreate(&configuration, 0.0);
+    BIDutyCycleSetActiveRegionCount(dutyCycle, 0.0, 1);
+
+    // Follow the duty cycle for an hour, with a significant tick every second ranging is on.
+    BIDutyCycleState state = BIDutyCycleAdvance(dutyCycle, 0.0);
+    double timestamp = 0.0;
+    int minor = 0;
+    while (timestamp < 3600.0) {
+        double next = state.ranging ? std::min(timestamp + 1.0, state.nextChange) : state.nextChange;
+        timestamp = std::isinf(next) ? 3600.0 : next;
+        if (state.ranging) {
+            BIDutyCycleReportBatch(dutyCycle, Batch(timestamp).add(uint16_t(++minor % 1000), -60).get());
+        }
+        state = BIDutyCycleAdvance(dutyCycle, timestamp);
+    }
+    BIDutyCycleStatistics statistics = BIDutyCycleGetStatistics(dutyCycle);
+    CHECK(statistics.rangingTime <= 0.25 * timestamp + configuration.budgetPeriod * 0.25 + 1e-6);
+    CHECK(statistics.rangingTime >= 0.2 * timestamp);
+    CHECK(statistics.budgetLimitedTime > 0.0);
+    BIDutyCycleDestroy(dutyCycle);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
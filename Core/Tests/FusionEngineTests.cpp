@@ -0,0 +1,270 @@
+//
+//  FusionEngineTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIFusionEngine.h>
+
+#include "TestHarness.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+BIFusionSignal fusionSignal(uint16_t minor, double timestamp, int32_t RSSI, bool inRange = true)
+{
+    BIFusionSignal signal;
+    signal.key = beaconKey(minor);
+    signal.signal = {timestamp, RSSI, BIProximityUnknown, -1.0, inRange};
+    return signal;
+}
+
+void submit(BIFusionEngineRef engine, uint32_t receiver, const std::vector<BIFusionSignal> &signals)
+{
+    CHECK_EQUAL(signals.size(), BIFusionEngineSubmit(engine, receiver, signals.data(), signals.size()));
+}
+
+BIFusionReceiver receiverAt(double x, double y, int32_t floor = 0)
+{
+    BIFusionReceiver receiver = {};
+    receiver.located = true;
+    receiver.x = x;
+    receiver.y = y;
+    receiver.floor = floor;
+    return receiver;
+}
+
+const BIFusedBeacon *find(const BIFusionResult &result, uint16_t minor)
+{
+    for (size_t i = 0; i < result.beaconCount; i++) {
+        if (result.beacons[i].key.minor == minor) {
+            return &result.beacons[i];
+        }
+    }
+    return NULL;
+}
+
+} // namespace
+
+TEST(receiversAreAveragedWithTheirCalibration)
+{
+    BIFusionReceiver receivers[2] = {};
+    receivers[1].RSSIOffset = 5.0;
+    BIFusionBeacon beacons[] = {{beaconKey(1), -12}};
+    BIFusionEngineRef engine = BIFusionEngineCreate(NULL, receivers, 2, beacons, 1);
+
+    // Receiver 0 reports more often, but counts as much as receiver 1.
+    submit(engine, 0, {fusionSignal(1, 0.5, -60), fusionSignal(1, 1.0, -70), fusionSignal(2, 1.0, -50)});
+    submit(engine, 1, {fusionSignal(1, 0.8, -81)});
+    BIFusionResult result = BIFusionEngineFuse(engine, 1.0);
+    REQUIRE(result.beaconCount == 2);
+    CHECK_EQUAL(2u, result.beacons[0].key.minor);
+    const BIFusedBeacon &fused = result.beacons[1];
+    CHECK_EQUAL(1u, fused.key.minor);
+    CHECK_EQUAL(-70.5, fused.meanRSSI);
+    CHECK_EQUAL(2u, fused.receiverCount);
+    CHECK_EQUAL(3u, fused.signalCount);
+    CHECK_EQUAL(0u, fused.nearestReceiver);
+    CHECK_EQUAL(-65.0, fused.nearestRSSI);
+    CHECK(!fused.position.valid);
+
+    // The accuracy follows from the rounded RSSI and the beacon's own TX power.
+    CHECK_EQUAL(1.0, fused.signal.timestamp);
+    CHECK(fused.signal.inRange);
+    int32_t RSSI = -71;
+    int32_t txPower = -12;
+    double accuracy = 0.0;
+    int32_t proximity = 0;
+    BIEstimateDistances(NULL, &RSSI, &txPower, 1, NULL, &accuracy, &proximity);
+    CHECK_EQUAL(RSSI, fused.signal.RSSI);
+    CHECK_EQUAL(accuracy, fused.signal.accuracy);
+    CHECK_EQUAL(proximity, fused.signal.proximity);
+
+    // A new calibration applies to the signals drained from then on; those already drained keep theirs.
+    BIFusionEngineSetReceiverCalibration(engine, 1, 0.0, 0.0);
+    submit(engine, 1, {fusionSignal(1, 1.5, -81)});
+    result = BIFusionEngineFuse(engine, 2.0);
+    REQUIRE(find(result, 1) != NULL);
+    CHECK_EQUAL(-65.0 / 2.0 + (-76.0 - 81.0) / 4.0, find(result, 1)->meanRSSI);
+    BIFusionEngineDestroy(engine);
+}
+
+TEST(signalsAreFusedWithinTheWindowOnTheAggregatorsClock)
+{
+    BIFusionReceiver receivers[2] = {};
+    receivers[1].clockOffset = -100.0;
+    BIFusionEngineRef engine = BIFusionEngineCreate(NULL, receivers, 2, NULL, 0);
+    submit(engine, 0, {fusionSignal(1, 9.0, -60), fusionSignal(1, 7.9, -60), fusionSignal(1, 11.0, -60)});
+    submit(engine, 1, {fusionSignal(1, 109.5, -70), fusionSignal(2, 110.0, 0), fusionSignal(2, 110.0, -70, false)});
+    BIFusionSignal unknownReceiver = fusionSignal(1, 10.0, -70);
+    CHECK_EQUAL(1u, BIFusionEngineSubmit(engine, 2, &unknownReceiver, 1));
+
+    BIFusionResult result = BIFusionEngineFuse(engine, 10.0);
+    REQUIRE(result.beaconCount == 1);
+    CHECK_EQUAL(2u, result.beacons[0].signalCount);
+    CHECK_EQUAL(-65.0, result.beacons[0].meanRSSI);
+
+    // The signal from the future is kept for a later tick, and old signals fall out of the window.
+    result = BIFusionEngineFuse(engine, 11.6);
+    REQUIRE(result.beaconCount == 1);
+    CHECK_EQUAL(1u, result.beacons[0].signalCount);
+    CHECK_EQUAL(-60.0, result.beacons[0].meanRSSI);
+    result = BIFusionEngineFuse(engine, 14.0);
+    CHECK_EQUAL(0u, result.beaconCount);
+
+    BIFusionStatistics statistics = BIFusionEngineGetStatistics(engine);
+    CHECK_EQUAL(4u, statistics.signals);
+    CHECK_EQUAL(3u, statistics.ignoredSignals);
+    CHECK_EQUAL(1u, statistics.lateSignals);
+    CHECK_EQUAL(3u, statistics.ticks);
+    CHECK_EQUAL(0u, statistics.beacons);
+    BIFusionEngineDestroy(engine);
+}
+
+TEST(beaconsHeardByThreeLocatedReceiversAreTrilaterated)
+{
+    // At -69 dB the default model puts a beacon of the default TX power at sqrt(10) m: the receivers are on a circle
+    // of that radius around (5, 5). The receiver upstairs hears it through the ceiling and is left out.
+    double radius = std::sqrt(10.0);
+    BIFusionReceiver receivers[] = {receiverAt(5.0, 5.0 + radius),
+                                    receiverAt(5.0 - radius * std::sqrt(0.75), 5.0 - radius / 2.0),
+                                    receiverAt(5.0 + radius * std::sqrt(0.75), 5.0 - radius / 2.0),
+                                    receiverAt(5.0, 5.0, 1), {}};
+    BIFusionEngineRef engine = BIFusionEngineCreate(NULL, receivers, 5, NULL, 0);
+    for (uint32_t receiver = 0; receiver < 3; receiver++) {
+        submit(engine, receiver, {fusionSignal(1, 1.0, -69)});
+    }
+    submit(engine, 3, {fusionSignal(1, 1.0, -75)});
+    submit(engine, 4, {fusionSignal(1, 1.0, -40)}); // strongest, but not located
+    submit(engine, 0, {fusionSignal(2, 1.0, -69)});
+    submit(engine, 1, {fusionSignal(2, 1.0, -69)});
+
+    BIFusionResult result = BIFusionEngineFuse(engine, 1.0);
+    const BIFusedBeacon *located = find(result, 1);
+    REQUIRE(located != NULL);
+    CHECK_EQUAL(4u, located->nearestReceiver);
+    REQUIRE(located->position.valid);
+    CHECK_NEAR(5.0, located->position.x, 1e-3);
+    CHECK_NEAR(5.0, located->position.y, 1e-3);
+    CHECK_EQUAL(0, located->position.floor);
+    CHECK_EQUAL(3u, located->position.beaconCount);
+    const BIFusedBeacon *unlocated = find(result, 2);
+    REQUIRE(unlocated != NULL);
+    CHECK_EQUAL(2u, unlocated->receiverCount);
+    CHECK(!unlocated->position.valid);
+    BIFusionEngineDestroy(engine);
+}
+
+TEST(fullRingsDropSignals)
+{
+    BIFusionEngineConfiguration configuration = BIFusionEngineConfigurationMakeDefault();
+    configuration.ringCapacity = 3; // rounded up to 4
+    BIFusionReceiver receiver = {};
+    BIFusionEngineRef engine = BIFusionEngineCreate(&configuration, &receiver, 1, NULL, 0);
+    std::vector<BIFusionSignal> signals(6, fusionSignal(1, 1.0, -60));
+    signals[1].signal.RSSI = 0;
+    CHECK_EQUAL(5u, BIFusionEngineSubmit(engine, 0, signals.data(), signals.size()));
+    BIFusionStatistics statistics = BIFusionEngineGetStatistics(engine);
+    CHECK_EQUAL(4u, statistics.signals);
+    CHECK_EQUAL(1u, statistics.droppedSignals);
+    CHECK_EQUAL(1u, statistics.ignoredSignals);
+    BIFusionResult result = BIFusionEngineFuse(engine, 1.0);
+    REQUIRE(result.beaconCount == 1);
+    CHECK_EQUAL(4u, result.beacons[0].signalCount);
+    CHECK_EQUAL(4u, BIFusionEngineSubmit(engine, 0, signals.data(), 4));
+    BIFusionEngineDestroy(engine);
+}
+
+TEST(beaconsAreForgottenOnceTheirSignalsLeaveTheWindow)
+{
+    BIFusionReceiver receiver = {};
+    BIFusionBeacon beacons[] = {{beaconKey(1, 0), -12}};
+    BIFusionEngineRef engine = BIFusionEngineCreate(NULL, &receiver, 1, beacons, 1);
+
+    // A new beacon every 0.1 s: about 20 are in the default window of 2 seconds at any time.
+    for (uint32_t i = 0; i < 20000; i++) {
+        double timestamp = 0.1 * i;
+        BIFusionSignal signal = fusionSignal(uint16_t(i), timestamp, -60);
+        signal.key.major = uint16_t(1 + i / 65536);
+        submit(engine, 0, {signal});
+        BIFusionResult result = BIFusionEngineFuse(engine, timestamp);
+        CHECK(result.beaconCount <= 21);
+        CHECK(BIFusionEngineGetStatistics(engine).beacons <= 22);
+    }
+    CHECK_EQUAL(0u, BIFusionEngineFuse(engine, 5000.0).beaconCount);
+    CHECK_EQUAL(1u, BIFusionEngineGetStatistics(engine).beacons);
+
+    // The configured beacon keeps its stronger TX power (so it is farther away at the same RSSI), and a forgotten
+    // beacon that is heard again gets the default one.
+    BIFusionSignal configured = fusionSignal(1, 5000.0, -70);
+    configured.key.major = 0;
+    submit(engine, 0, {configured, fusionSignal(5, 5000.0, -70)});
+    BIFusionResult result = BIFusionEngineFuse(engine, 5000.0);
+    REQUIRE(result.beaconCount == 2);
+    const BIFusedBeacon *first = find(result, 1);
+    const BIFusedBeacon *second = find(result, 5);
+    REQUIRE(first != NULL && second != NULL);
+    CHECK(first->signal.accuracy > second->signal.accuracy);
+    CHECK_EQUAL(2u, BIFusionEngineGetStatistics(engine).beacons);
+    BIFusionEngineDestroy(engine);
+}
+
+// Producers fill their rings while ticks drain them. Run it under ThreadSanitizer to check the ring's memory ordering.
+TEST(concurrentProducersLoseNoSignals)
+{
+    const uint32_t receiverCount = 4;
+    const size_t signalsPerReceiver = 20000;
+    BIFusionEngineConfiguration configuration = BIFusionEngineConfigurationMakeDefault();
+    configuration.ringCapacity = 64;
+    configuration.window = 1000.0;
+    std::vector<BIFusionReceiver> receivers(receiverCount, BIFusionReceiver());
+    BIFusionEngineRef engine = BIFusionEngineCreate(&configuration, receivers.data(), receiverCount, NULL, 0);
+
+    std::atomic<uint32_t> running(receiverCount);
+    std::vector<std::thread> producers;
+    for (uint32_t receiver = 0; receiver < receiverCount; receiver++) {
+        producers.emplace_back([engine, receiver, &running]() {
+            std::vector<BIFusionSignal> signals;
+            for (size_t i = 0; i < signalsPerReceiver; i++) {
+                signals.push_back(fusionSignal(uint16_t(i % 5), 1.0, -50 - int32_t(receiver)));
+            }
+            size_t submitted = 0;
+            while (submitted < signals.size()) {
+                size_t count = std::min<size_t>(16, signals.size() - submitted);
+                submitted += BIFusionEngineSubmit(engine, receiver, signals.data() + submitted, count);
+                if (submitted < signals.size()) {
+                    std::this_thread::yield();
+                }
+            }
+            running--;
+        });
+    }
+    while (running > 0) {
+        BIFusionEngineFuse(engine, 1.0);
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+
+    BIFusionResult result = BIFusionEngineFuse(engine, 1.0);
+    REQUIRE(result.beaconCount == 5);
+    for (size_t i = 0; i < result.beaconCount; i++) {
+        CHECK_EQUAL(uint32_t(receiverCount * signalsPerReceiver / 5), result.beacons[i].signalCount);
+        CHECK_EQUAL(-51.5, result.beacons[i].meanRSSI);
+    }
+    BIFusionStatistics statistics = BIFusionEngineGetStatistics(engine);
+    CHECK_EQUAL(uint64_t(receiverCount * signalsPerReceiver), statistics.signals);
+    BIFusionEngineDestroy(engine);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
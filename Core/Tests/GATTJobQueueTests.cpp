@@ -0,0 +1,286 @@
+//
+//  GATTJobQueueTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIGATTJobQueue.h>
+
+#include "TestHarness.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+// Devices that answer every operation of the queue in the order it was issued, one per step.
+class FakeDevices {
+public:
+    struct Device {
+        bool answersConnect = true;
+        bool hasSecondCharacteristic = true;
+        uint32_t failedConnects = 0; // connection attempts that fail before one succeeds
+    };
+
+    static std::vector<uint8_t> valueOf(uint32_t deviceID, size_t characteristic)
+    {
+        // Long enough that a job's values do not fit into one allocation.
+        std::vector<uint8_t> value;
+        for (size_t i = 0; i < 300 + characteristic; i++) {
+            value.push_back(uint8_t(deviceID * 31 + characteristic * 7 + i));
+        }
+        return value;
+    }
+
+    FakeDevices()
+    {
+        _paths[0] = {BIGATTUUIDMakeShort(0x180F), BIGATTUUIDMakeShort(0x2A19)};
+        _paths[1] = {BIGATTUUIDMakeShort(0x180A), BIGATTUUIDMakeShort(0x2A26)};
+    }
+
+    const BIGATTCharacteristicPath *paths() const { return _paths; }
+    std::map<uint32_t, Device> devices;
+    BIGATTJobQueueRef queue = NULL;
+    double timestamp = 0.0;
+    size_t maximumConnected = 0;
+    std::set<uint32_t> connected;
+    std::vector<BIGATTDeviceResult> finished;
+    bool jobFinished = false;
+
+    BIGATTTransport transport() const
+    {
+        BIGATTTransport transport = {};
+        transport.connect = [](uint32_t deviceID, void *context) {
+            static_cast<FakeDevices *>(context)->issue(Operation{Connect, deviceID, 0});
+        };
+        transport.disconnect = [](uint32_t deviceID, void *context) {
+            static_cast<FakeDevices *>(context)->connected.erase(deviceID);
+        };
+        transport.discoverServices = [](uint32_t deviceID, const BIGATTUUID *, size_t, void *context) {
+            static_cast<FakeDevices *>(context)->issue(Operation{DiscoverServices, deviceID, 0});
+        };
+        transport.discoverCharacteristics = [](uint32_t deviceID, const BIGATTUUID *service, const BIGATTUUID *, size_t,
+                                               void *context) {
+            FakeDevices *self = static_cast<FakeDevices *>(context);
+            self->issue(Operation{DiscoverCharacteristics, deviceID, self->characteristicIndex(*service)});
+        };
+        transport.readValue = [](uint32_t deviceID, const BIGATTCharacteristicPath *path, void *context) {
+            FakeDevices *self = static_cast<FakeDevices *>(context);
+            self->issue(Operation{ReadValue, deviceID, self->characteristicIndex(path->service)});
+        };
+        return transport;
+    }
+
+    BIGATTJobHandlers handlers() const
+    {
+        BIGATTJobHandlers handlers;
+        handlers.deviceFinished = [](const BIGATTDeviceResult *result, void *context) {
+            static_cast<FakeDevices *>(context)->finished.push_back(*result);
+        };
+        handlers.jobFinished = [](void *context) { static_cast<FakeDevices *>(context)->jobFinished = true; };
+        return handlers;
+    }
+
+    // Answers the next operation, or advances the time by a second if none is outstanding.
+    void step()
+    {
+        timestamp += 0.1;
+        if (_operations.empty()) {
+            timestamp += 1.0;
+            BIGATTJobQueueAdvance(queue, timestamp);
+            return;
+        }
+        Operation operation = _operations.front();
+        _operations.pop_front();
+        Device &device = devices[operation.deviceID];
+        switch (operation.type) {
+        case Connect:
+            if (!device.answersConnect) {
+                return;
+            }
+            if (device.failedConnects > 0) {
+                device.failedConnects--;
+                BIGATTJobQueueDidConnect(queue, operation.deviceID, timestamp, BIGATTStatusError);
+                return;
+            }
+            connected.insert(operation.deviceID);
+            maximumConnected = std::max(maximumConnected, connected.size());
+            BIGATTJobQueueDidConnect(queue, operation.deviceID, timestamp, BIGATTStatusSuccess);
+            return;
+        case DiscoverServices: {
+            BIGATTUUID services[] = {_paths[0].service, _paths[1].service};
+            BIGATTJobQueueDidDiscoverServices(queue, operation.deviceID, timestamp, BIGATTStatusSuccess, services,
+                                              device.hasSecondCharacteristic ? 2 : 1);
+            return;
+        }
+        case DiscoverCharacteristics:
+            BIGATTJobQueueDidDiscoverCharacteristics(queue, operation.deviceID, timestamp,
+                                                     &_paths[operation.characteristic].service, BIGATTStatusSuccess,
+                                                     &_paths[operation.characteristic].characteristic, 1);
+            return;
+        case ReadValue: {
+            std::vector<uint8_t> value = valueOf(operation.deviceID, operation.characteristic);
+            BIGATTJobQueueDidReadValue(queue, operation.deviceID, timestamp, &_paths[operation.characteristic],
+                                       BIGATTStatusSuccess, value.data(), value.size());
+            return;
+        }
+        }
+    }
+
+private:
+    enum Type { Connect, DiscoverServices, DiscoverCharacteristics, ReadValue };
+
+    struct Operation {
+        Type type;
+        uint32_t deviceID;
+        size_t characteristic;
+    };
+
+    void issue(const Operation &operation) { _operations.push_back(operation); }
+
+    size_t characteristicIndex(const BIGATTUUID &service) const
+    {
+        return BIGATTUUIDEqual(&service, &_paths[0].service) ? 0 : 1;
+    }
+
+    BIGATTCharacteristicPath _paths[2];
+    std::deque<Operation> _operations;
+};
+
+BIGATTJobQueueRef createQueue(FakeDevices &devices, uint32_t maximumConnections = 4)
+{
+    BIGATTJobConfiguration configuration = BIGATTJobConfigurationMakeDefault();
+    configuration.maximumConnections = maximumConnections;
+    BIGATTTransport transport = devices.transport();
+    devices.queue = BIGATTJobQueueCreate(&configuration, &transport, devices.handlers(), &devices);
+    return devices.queue;
+}
+
+} // namespace
+
+TEST(uuidStringsParse)
+{
+    BIGATTUUID uuid;
+    CHECK(BIGATTUUIDSetString(&uuid, "2A19"));
+    BIGATTUUID battery = BIGATTUUIDMakeShort(0x2A19);
+    CHECK(BIGATTUUIDEqual(&uuid, &battery));
+    CHECK(BIGATTUUIDSetString(&uuid, "f0018b9b-7509-4c31-a905-1a27d39c003c"));
+    CHECK_EQUAL(0xF0, uuid.bytes[0]);
+    CHECK_EQUAL(0x3C, uuid.bytes[15]);
+    CHECK(!BIGATTUUIDSetString(&uuid, "2A1"));
+}
+
+// Value pointers handed out while the job runs must still be valid, and unchanged, once it is done.
+TEST(readsEveryValueAndKeepsValuesInPlace)
+{
+    FakeDevices devices;
+    BIGATTJobQueueRef queue = createQueue(devices);
+    std::vector<uint32_t> IDs;
+    for (uint32_t i = 1; i <= 40; i++) {
+        IDs.push_back(i);
+    }
+    REQUIRE(BIGATTJobQueueStart(queue, 0.0, IDs.data(), IDs.size(), devices.paths(), 2));
+
+    std::map<std::pair<size_t, size_t>, const uint8_t *> firstPointers;
+    for (int steps = 0; steps < 10000 && !devices.jobFinished; steps++) {
+        devices.step();
+        for (size_t d = 0; d < IDs.size(); d++) {
+            for (size_t c = 0; c < 2; c++) {
+                const uint8_t *value = NULL;
+                if (BIGATTJobQueueGetValue(queue, d, c, &value, NULL) == BIGATTStatusSuccess) {
+                    firstPointers.emplace(std::make_pair(d, c), value);
+                }
+            }
+        }
+    }
+    REQUIRE(devices.jobFinished);
+    CHECK(devices.maximumConnected <= 4);
+    CHECK_EQUAL(IDs.size(), devices.finished.size());
+    CHECK_EQUAL(2 * IDs.size(), firstPointers.size());
+    for (size_t d = 0; d < IDs.size(); d++) {
+        CHECK_EQUAL(BIGATTStatusSuccess, BIGATTJobQueueGetDeviceResult(queue, d).status);
+        for (size_t c = 0; c < 2; c++) {
+            const uint8_t *value = NULL;
+            size_t length = 0;
+            CHECK_EQUAL(BIGATTStatusSuccess, BIGATTJobQueueGetValue(queue, d, c, &value, &length));
+            std::vector<uint8_t> expected = FakeDevices::valueOf(IDs[d], c);
+            CHECK(value == firstPointers[std::make_pair(d, c)]);
+            CHECK(length == expected.size() && std::memcmp(value, expected.data(), length) == 0);
+        }
+    }
+    CHECK_EQUAL(80u, BIGATTJobQueueGetStatistics(queue).valuesRead);
+    BIGATTJobQueueDestroy(queue);
+}
+
+TEST(missingCharacteristicDoesNotFailTheDevice)
+{
+    FakeDevices devices;
+    devices.devices[1].hasSecondCharacteristic = false;
+    BIGATTJobQueueRef queue = createQueue(devices);
+    uint32_t ID = 1;
+    REQUIRE(BIGATTJobQueueStart(queue, 0.0, &ID, 1, devices.paths(), 2));
+    for (int steps = 0; steps < 100 && !devices.jobFinished; steps++) {
+        devices.step();
+    }
+    REQUIRE(devices.jobFinished);
+    CHECK_EQUAL(BIGATTStatusSuccess, BIGATTJobQueueGetDeviceResult(queue, 0).status);
+    CHECK_EQUAL(BIGATTStatusSuccess, BIGATTJobQueueGetValue(queue, 0, 0, NULL, NULL));
+    CHECK_EQUAL(BIGATTStatusNotFound, BIGATTJobQueueGetValue(queue, 0, 1, NULL, NULL));
+    CHECK_EQUAL(1u, BIGATTJobQueueGetDeviceResult(queue, 0).valuesRead);
+    BIGATTJobQueueDestroy(queue);
+}
+
+TEST(failedAttemptsAreRetried)
+{
+    FakeDevices devices;
+    devices.devices[1].failedConnects = 2;
+    devices.devices[2].answersConnect = false;
+    BIGATTJobQueueRef queue = createQueue(devices);
+    uint32_t IDs[] = {1, 2};
+    REQUIRE(BIGATTJobQueueStart(queue, 0.0, IDs, 2, devices.paths(), 2));
+    for (int steps = 0; steps < 1000 && !devices.jobFinished; steps++) {
+        devices.step();
+    }
+    REQUIRE(devices.jobFinished);
+    BIGATTDeviceResult flaky = BIGATTJobQueueGetDeviceResult(queue, 0);
+    CHECK_EQUAL(BIGATTStatusSuccess, flaky.status);
+    CHECK_EQUAL(3u, flaky.attempts);
+    BIGATTDeviceResult silent = BIGATTJobQueueGetDeviceResult(queue, 1);
+    CHECK_EQUAL(BIGATTStatusTimedOut, silent.status);
+    CHECK_EQUAL(3u, silent.attempts);
+    BIGATTJobStatistics statistics = BIGATTJobQueueGetStatistics(queue);
+    CHECK_EQUAL(1u, statistics.devicesSucceeded);
+    CHECK_EQUAL(1u, statistics.devicesFailed);
+    CHECK_EQUAL(3u, statistics.timeouts);
+    BIGATTJobQueueDestroy(queue);
+}
+
+TEST(cancelFinishesTheJob)
+{
+    FakeDevices devices;
+    BIGATTJobQueueRef queue = createQueue(devices, 1);
+    uint32_t IDs[] = {1, 2, 3};
+    REQUIRE(BIGATTJobQueueStart(queue, 0.0, IDs, 3, devices.paths(), 2));
+    CHECK(!BIGATTJobQueueStart(queue, 0.0, IDs, 3, devices.paths(), 2));
+    devices.step();
+    BIGATTJobQueueCancel(queue, 1.0);
+    CHECK(devices.jobFinished);
+    CHECK(BIGATTJobQueueIsFinished(queue));
+    CHECK(devices.connected.empty());
+    for (size_t d = 0; d < 3; d++) {
+        CHECK_EQUAL(BIGATTStatusCancelled, BIGATTJobQueueGetDeviceResult(queue, d).status);
+    }
+    BIGATTJobQueueDestroy(queue);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,153 @@
+//
+//  IngestionAggregatorTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIIngestion.h>
+#include <BICore/BIUpload.h>
+
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+void storeUpload(const uint8_t *bytes, size_t length, void *context)
+{
+    static_cast<std::vector<uint8_t> *>(context)->assign(bytes, bytes + length);
+}
+
+// An upload of one device with a sighting of each of minors at every timestamp of [start, end] in 10 second steps.
+std::vector<uint8_t> makeUpload(uint64_t sequenceNumber, double start, double end, std::vector<uint16_t> minors = {1},
+                                uint8_t device = 1)
+{
+    uint8_t deviceID[16] = {device};
+    std::vector<uint8_t> bytes;
+    BIUploadEncoderRef encoder = BIUploadEncoderCreate(NULL, deviceID, sequenceNumber, storeUpload, &bytes);
+    for (double timestamp = start; timestamp <= end; timestamp += 10.0) {
+        std::vector<BIBeaconSample> samples;
+        for (uint16_t minor : minors) {
+            samples.push_back(beaconSample(minor, -60, 1.0));
+        }
+        BIUploadEncoderAddSamples(encoder, timestamp, samples.data(), samples.size());
+    }
+    BIUploadEncoderFlush(encoder);
+    BIUploadEncoderDestroy(encoder);
+    return bytes;
+}
+
+size_t add(BIIngestionAggregatorRef aggregator, const std::vector<uint8_t> &upload)
+{
+    BIUploadBuffer buffer = {upload.data(), upload.size()};
+    return BIIngestionAggregatorAddUploads(aggregator, &buffer, 1);
+}
+
+BIIngestionTotals beaconTotals(BIIngestionAggregatorRef aggregator)
+{
+    BIIngestionBeaconStatistics beacon = {};
+    BIIngestionAggregatorCopyBeacons(aggregator, &beacon, 1);
+    return beacon.totals;
+}
+
+} // namespace
+
+TEST(visitsAndDwellTimeAreCounted)
+{
+    BIIngestionZoneMember members[] = {{beaconKey(1), 7}, {beaconKey(2), 7}};
+    BIIngestionAggregatorRef aggregator = BIIngestionAggregatorCreate(NULL, members, 2);
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(0, 0.0, 50.0, {1})));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(1, 60.0, 100.0, {2})));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(2, 300.0, 300.0, {1})));
+
+    BIIngestionTotals totals = beaconTotals(aggregator);
+    CHECK_EQUAL(7u, totals.sightings);
+    CHECK_EQUAL(2u, totals.visits);
+    CHECK_EQUAL(1u, totals.devices);
+    CHECK_EQUAL(50.0, totals.dwellTime);
+
+    BIIngestionZoneStatistics zone;
+    REQUIRE(BIIngestionAggregatorCopyZones(aggregator, &zone, 1) == 1);
+    CHECK_EQUAL(7u, zone.zoneID);
+    CHECK_EQUAL(12u, zone.totals.sightings);
+    CHECK_EQUAL(2u, zone.totals.visits);
+    CHECK_EQUAL(100.0, zone.totals.dwellTime);
+    BIIngestionAggregatorDestroy(aggregator);
+}
+
+TEST(retriedUploadsAreSkipped)
+{
+    BIIngestionAggregatorRef aggregator = BIIngestionAggregatorCreate(NULL, NULL, 0);
+    std::vector<std::vector<uint8_t>> uploads = {makeUpload(5, 0.0, 20.0), makeUpload(6, 30.0, 40.0),
+                                                 makeUpload(5, 0.0, 20.0, {1}, 2)};
+    std::vector<BIUploadBuffer> buffers;
+    for (const std::vector<uint8_t> &upload : uploads) {
+        buffers.push_back({upload.data(), upload.size()});
+    }
+    CHECK_EQUAL(3u, BIIngestionAggregatorAddUploads(aggregator, buffers.data(), buffers.size()));
+    CHECK_EQUAL(0u, BIIngestionAggregatorAddUploads(aggregator, buffers.data(), buffers.size()));
+    BIIngestionStatistics statistics = BIIngestionAggregatorGetStatistics(aggregator);
+    CHECK_EQUAL(3u, statistics.uploads);
+    CHECK_EQUAL(3u, statistics.duplicateUploads);
+    CHECK_EQUAL(2u, statistics.devices);
+    CHECK_EQUAL(8u, beaconTotals(aggregator).sightings);
+    BIIngestionAggregatorDestroy(aggregator);
+}
+
+// Uploads within the window of sequence numbers up to the highest one are told apart, older ones count as seen.
+TEST(sequenceNumbersAreKeptInAWindow)
+{
+    BIIngestionConfiguration configuration = BIIngestionConfigurationMakeDefault();
+    configuration.sequenceWindow = 64;
+    BIIngestionAggregatorRef aggregator = BIIngestionAggregatorCreate(&configuration, NULL, 0);
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(1000, 1000.0, 1000.0)));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(937, 937.0, 937.0)));
+    CHECK_EQUAL(0u, add(aggregator, makeUpload(936, 936.0, 936.0)));
+    CHECK_EQUAL(0u, add(aggregator, makeUpload(937, 937.0, 937.0)));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(999, 999.0, 999.0)));
+
+    // Moving the window forgets the numbers that leave it, but not those that stay.
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(1050, 1050.0, 1050.0)));
+    CHECK_EQUAL(0u, add(aggregator, makeUpload(999, 999.0, 999.0)));
+    CHECK_EQUAL(0u, add(aggregator, makeUpload(1000, 1000.0, 1000.0)));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(1049, 1049.0, 1049.0)));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(1001, 1001.0, 1001.0)));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(5000, 5000.0, 5000.0)));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(4999, 4999.0, 4999.0)));
+    CHECK_EQUAL(0u, add(aggregator, makeUpload(1050, 1050.0, 1050.0)));
+
+    BIIngestionStatistics statistics = BIIngestionAggregatorGetStatistics(aggregator);
+    CHECK_EQUAL(8u, statistics.uploads);
+    CHECK_EQUAL(5u, statistics.duplicateUploads);
+    BIIngestionAggregatorDestroy(aggregator);
+}
+
+TEST(idleDevicesExpire)
+{
+    BIIngestionConfiguration configuration = BIIngestionConfigurationMakeDefault();
+    configuration.deviceTimeout = 60.0;
+    BIIngestionAggregatorRef aggregator = BIIngestionAggregatorCreate(&configuration, NULL, 0);
+    std::vector<uint8_t> upload = makeUpload(0, 0.0, 100.0);
+    CHECK_EQUAL(1u, add(aggregator, upload));
+    CHECK_EQUAL(1u, add(aggregator, makeUpload(0, 0.0, 200.0, {1}, 2)));
+    CHECK_EQUAL(0u, BIIngestionAggregatorExpireDevices(aggregator, 160.0));
+    CHECK_EQUAL(1u, BIIngestionAggregatorExpireDevices(aggregator, 160.5));
+    CHECK_EQUAL(1u, BIIngestionAggregatorExpireDevices(aggregator, 1000.0));
+
+    // The visits stay counted. A device that comes back is new again.
+    CHECK_EQUAL(2u, beaconTotals(aggregator).devices);
+    CHECK_EQUAL(1u, add(aggregator, upload));
+    BIIngestionStatistics statistics = BIIngestionAggregatorGetStatistics(aggregator);
+    CHECK_EQUAL(3u, statistics.devices);
+    CHECK_EQUAL(2u, statistics.expiredDevices);
+    CHECK_EQUAL(3u, beaconTotals(aggregator).devices);
+    BIIngestionAggregatorDestroy(aggregator);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,189 @@
+//
+//  MetricsTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIMetrics.h>
+#include <BICore/BIRangingPipeline.h>
+
+#include "Metrics.hpp"
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+std::vector<uint8_t> binaryDump(BIMetricsRef metrics)
+{
+    std::vector<uint8_t> bytes(BIMetricsDump(metrics, BIMetricsDumpFormatBinary, NULL, 0));
+    BIMetricsDump(metrics, BIMetricsDumpFormatBinary, bytes.data(), bytes.size());
+    return bytes;
+}
+
+void countBatch(const BIRangingBatch *, void *context)
+{
+    (*static_cast<uint64_t *>(context))++;
+}
+
+void dispatchInline(void *, void *context, BIWorkFunction work)
+{
+    work(context);
+}
+
+} // namespace
+
+TEST(percentilesAreWithinTheBucketWidth)
+{
+    BIMetricsRef metrics = BIMetricsCreate(NULL, NULL, NULL);
+    for (uint64_t value = 1; value <= 10000; value++) {
+        BIMetricsRecord(metrics, BIMetricsHistogramSmoothing, value);
+    }
+    BIMetricsSnapshot snapshot;
+    BIMetricsGetSnapshot(metrics, &snapshot);
+    const BIHistogramSnapshot &histogram = snapshot.histograms[BIMetricsHistogramSmoothing];
+    CHECK_EQUAL(10000u, histogram.count);
+    CHECK_EQUAL(1u, histogram.minimum);
+    CHECK_EQUAL(10000u, histogram.maximum);
+    CHECK_NEAR(5000.5, histogram.mean, 1e-9);
+    CHECK_NEAR(5000.0, double(histogram.p50), 5000.0 / 32);
+    CHECK_NEAR(9900.0, double(histogram.p99), 9900.0 / 32);
+    CHECK_EQUAL(0u, snapshot.histograms[BIMetricsHistogramQueueing].count);
+    BIMetricsDestroy(metrics);
+}
+
+TEST(binaryDumpRoundTrips)
+{
+    BIMetricsRef metrics = BIMetricsCreate(NULL, NULL, NULL);
+    for (uint64_t value = 0; value < 5000; value += 7) {
+        BIMetricsRecord(metrics, BIMetricsHistogramEndToEnd, value * value);
+    }
+    BIMetricsIncrement(metrics, BIMetricsCounterTicks, 42);
+    std::vector<uint8_t> bytes = binaryDump(metrics);
+
+    BIMetricsRef merged = BIMetricsCreate(NULL, NULL, NULL);
+    CHECK(!BIMetricsMergeBinary(merged, bytes.data(), bytes.size() - 1));
+    REQUIRE(BIMetricsMergeBinary(merged, bytes.data(), bytes.size()));
+    CHECK(binaryDump(merged) == bytes);
+    BIMetricsDestroy(merged);
+    BIMetricsDestroy(metrics);
+}
+
+// A batch must add exactly what recording every value on its own adds.
+TEST(batchMatchesSingleRecords)
+{
+    BIMetricsRef single = BIMetricsCreate(NULL, NULL, NULL);
+    BIMetricsRef batched = BIMetricsCreate(NULL, NULL, NULL);
+    bi::MetricsBatch batch(bi::unwrapMetrics(batched));
+    uint64_t state = 3;
+    for (int i = 0; i < 1000; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        BIMetricsHistogram histogram = BIMetricsHistogram((state >> 20) % BIMetricsHistogramCount);
+        // Mostly a few recurring values, sometimes anything up to past the largest tracked value.
+        uint64_t value = i % 5 == 0 ? state >> (state % 64) : 20000 + (state >> 60) * 100;
+        BIMetricsRecord(single, histogram, value);
+        batch.record(histogram, value);
+        BIMetricsIncrement(single, BIMetricsCounterSamples, i);
+        batch.increment(BIMetricsCounterSamples, i);
+    }
+    batch.flush();
+    CHECK(binaryDump(single) == binaryDump(batched));
+    BIMetricsDestroy(batched);
+    BIMetricsDestroy(single);
+}
+
+TEST(batchIsAddedWhenFullOrFlushed)
+{
+    BIMetricsRef metrics = BIMetricsCreate(NULL, NULL, NULL);
+    bi::MetricsBatch batch(bi::unwrapMetrics(metrics));
+    batch.increment(BIMetricsCounterTicks);
+    for (uint32_t i = 1; i < bi::MetricsBatch::valuesPerHistogram; i++) {
+        batch.record(BIMetricsHistogramHandler, uint64_t(i));
+    }
+    BIMetricsSnapshot snapshot;
+    BIMetricsGetSnapshot(metrics, &snapshot);
+    CHECK_EQUAL(0u, snapshot.histograms[BIMetricsHistogramHandler].count);
+    CHECK_EQUAL(0u, snapshot.counters[BIMetricsCounterTicks]);
+
+    batch.record(BIMetricsHistogramHandler, uint64_t(1));
+    BIMetricsGetSnapshot(metrics, &snapshot);
+    CHECK_EQUAL(uint64_t(bi::MetricsBatch::valuesPerHistogram), snapshot.histograms[BIMetricsHistogramHandler].count);
+    CHECK_EQUAL(1u, snapshot.counters[BIMetricsCounterTicks]);
+
+    batch.record(BIMetricsHistogramHandler, uint64_t(1));
+    batch.flush();
+    BIMetricsGetSnapshot(metrics, &snapshot);
+    const BIHistogramSnapshot &handler = snapshot.histograms[BIMetricsHistogramHandler];
+    CHECK_EQUAL(uint64_t(bi::MetricsBatch::valuesPerHistogram + 1), handler.count);
+    BIMetricsDestroy(metrics);
+}
+
+// The pipeline batches its measurements, but all of them are in the metrics once it is destroyed.
+TEST(pipelineAddsEveryTick)
+{
+    const uint64_t ticks = 37;
+    for (bool synchronous : {true, false}) {
+        BIMetricsRef metrics = BIMetricsCreate(NULL, NULL, NULL);
+        uint64_t delivered = 0;
+        BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+        configuration.synchronous = synchronous;
+        configuration.metrics = metrics;
+        BIRangingPipelineRef pipeline = BIRangingPipelineCreate(&configuration, BIDeliveryQueue{&dispatchInline, NULL},
+                                                                &countBatch, &delivered);
+        uint32_t regionID = BIRangingPipelineAddRegion(pipeline);
+        BIBeaconSample samples[] = {beaconSample(1, -60, 1.0), beaconSample(2, -70, 3.0)};
+        for (uint64_t tick = 1; tick <= ticks; tick++) {
+            BIRangingPipelineSubmit(pipeline, regionID, double(tick), samples, 2);
+            BIRangingPipelineWaitUntilIdle(pipeline);
+        }
+        BIRangingPipelineDestroy(pipeline);
+
+        BIMetricsSnapshot snapshot;
+        BIMetricsGetSnapshot(metrics, &snapshot);
+        CHECK_EQUAL(ticks, delivered);
+        CHECK_EQUAL(ticks, snapshot.counters[BIMetricsCounterTicks]);
+        CHECK_EQUAL(2 * ticks, snapshot.counters[BIMetricsCounterSamples]);
+        CHECK_EQUAL(ticks, snapshot.histograms[BIMetricsHistogramSmoothing].count);
+        CHECK_EQUAL(ticks, snapshot.histograms[BIMetricsHistogramHandler].count);
+        CHECK_EQUAL(ticks, snapshot.histograms[BIMetricsHistogramNearestBeacon].count);
+        CHECK_EQUAL(ticks, snapshot.histograms[BIMetricsHistogramBatchAssembly].count);
+        CHECK_EQUAL(2u, snapshot.histograms[BIMetricsHistogramBeaconsPerTick].maximum);
+        BIMetricsDestroy(metrics);
+    }
+}
+
+TEST(pipelineAddsTicksWithoutABatch)
+{
+    BIMetricsRef metrics = BIMetricsCreate(NULL, NULL, NULL);
+    uint64_t delivered = 0;
+    BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+    configuration.synchronous = true;
+    configuration.metrics = metrics;
+    BIRangingPipelineRef pipeline = BIRangingPipelineCreate(&configuration, BIDeliveryQueue{&dispatchInline, NULL},
+                                                            &countBatch, &delivered);
+    // The region is removed while its tick waits for the other region, so the tick has nothing to deliver.
+    uint32_t regionID = BIRangingPipelineAddRegion(pipeline);
+    BIRangingPipelineAddRegion(pipeline);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    BIRangingPipelineSubmit(pipeline, regionID, 1.0, &sample, 1);
+    BIRangingPipelineRemoveRegion(pipeline, regionID);
+    BIRangingPipelineFlush(pipeline);
+    BIRangingPipelineDestroy(pipeline);
+
+    BIMetricsSnapshot snapshot;
+    BIMetricsGetSnapshot(metrics, &snapshot);
+    CHECK_EQUAL(0u, delivered);
+    CHECK_EQUAL(1u, snapshot.counters[BIMetricsCounterTicks]);
+    CHECK_EQUAL(1u, snapshot.histograms[BIMetricsHistogramSmoothing].count);
+    CHECK_EQUAL(1u, snapshot.histograms[BIMetricsHistogramNearestBeacon].count);
+    CHECK_EQUAL(0u, snapshot.histograms[BIMetricsHistogramBatchAssembly].count);
+    BIMetricsDestroy(metrics);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,149 @@
+//
+//  NearestBeaconTrackerTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BINearestBeaconTracker.h>
+
+#include "TestHarness.hpp"
+
+using namespace bi::tests;
+
+namespace {
+
+BINearestBeaconTrackerRef createTracker(double hysteresisMargin, double minimumDwellTime, double maximumJump)
+{
+    BINearestBeaconTrackerConfiguration configuration = BINearestBeaconTrackerConfigurationMakeDefault();
+    configuration.hysteresisMargin = hysteresisMargin;
+    configuration.minimumDwellTime = minimumDwellTime;
+    configuration.maximumJump = maximumJump;
+    return BINearestBeaconTrackerCreate(&configuration);
+}
+
+void update(BINearestBeaconTrackerRef tracker, BIBeaconHandle handle, int32_t RSSI, double accuracy = 1.0,
+            bool inRange = true)
+{
+    BISignal signal = {0.0, RSSI, int32_t(BIProximityForAccuracy(accuracy)), accuracy, inRange};
+    BINearestBeaconTrackerUpdate(tracker, handle, &signal);
+}
+
+BIBeaconLocation location(double x, double y, int32_t floor)
+{
+    BIBeaconLocation location = {beaconKey(0), x, y, floor};
+    return location;
+}
+
+} // namespace
+
+TEST(strongestBeaconIsNearestWithoutHysteresis)
+{
+    BINearestBeaconTrackerRef tracker = createTracker(0.0, 0.0, 0.0);
+    CHECK(!BINearestBeaconTrackerEvaluate(tracker, 0.0));
+    CHECK_EQUAL(BIBeaconHandleInvalid, BINearestBeaconTrackerGetNearest(tracker));
+
+    update(tracker, 1, -70);
+    update(tracker, 2, -60);
+    update(tracker, 3, -60, 0.5);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 1.0));
+    CHECK_EQUAL(3u, BINearestBeaconTrackerGetNearest(tracker));
+    CHECK(!BINearestBeaconTrackerEvaluate(tracker, 2.0));
+
+    update(tracker, 1, -50);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 3.0));
+    CHECK_EQUAL(1u, BINearestBeaconTrackerGetNearest(tracker));
+
+    BIBeaconHandle handles[4];
+    REQUIRE(BINearestBeaconTrackerCopyStrongest(tracker, handles, 4) == 3);
+    CHECK_EQUAL(1u, handles[0]);
+    CHECK_EQUAL(3u, handles[1]);
+    CHECK_EQUAL(2u, handles[2]);
+    CHECK_EQUAL(1u, BINearestBeaconTrackerCopyStrongest(tracker, handles, 1));
+    CHECK_EQUAL(3u, BINearestBeaconTrackerGetCount(tracker));
+    BINearestBeaconTrackerDestroy(tracker);
+}
+
+TEST(challengerNeedsTheMarginAndTheDwellTime)
+{
+    BINearestBeaconTrackerRef tracker = createTracker(3.0, 3.0, 0.0);
+    update(tracker, 1, -60);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 0.0));
+
+    update(tracker, 2, -58);
+    CHECK(!BINearestBeaconTrackerEvaluate(tracker, 10.0));
+    CHECK_EQUAL(1u, BINearestBeaconTrackerGetNearest(tracker));
+
+    update(tracker, 1, -62);
+    update(tracker, 2, -56);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 11.0));
+    CHECK_EQUAL(2u, BINearestBeaconTrackerGetNearest(tracker));
+
+    // Beacon 2 has only just become the nearest beacon.
+    update(tracker, 1, -40);
+    CHECK(!BINearestBeaconTrackerEvaluate(tracker, 13.0));
+    CHECK_EQUAL(2u, BINearestBeaconTrackerGetNearest(tracker));
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 14.0));
+    CHECK_EQUAL(1u, BINearestBeaconTrackerGetNearest(tracker));
+    BINearestBeaconTrackerDestroy(tracker);
+}
+
+TEST(nearestBeaconLeavingRangeIsReplacedAtOnce)
+{
+    BINearestBeaconTrackerRef tracker = createTracker(3.0, 3.0, 0.0);
+    update(tracker, 1, -60);
+    update(tracker, 2, -70);
+    update(tracker, 3, -80);
+    BINearestBeaconTrackerEvaluate(tracker, 0.0);
+    REQUIRE(BINearestBeaconTrackerGetNearest(tracker) == 1);
+
+    update(tracker, 1, -60, 1.0, false);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 0.5));
+    CHECK_EQUAL(2u, BINearestBeaconTrackerGetNearest(tracker));
+    CHECK_EQUAL(2u, BINearestBeaconTrackerGetCount(tracker));
+
+    BINearestBeaconTrackerRemove(tracker, 2);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 1.0));
+    CHECK_EQUAL(3u, BINearestBeaconTrackerGetNearest(tracker));
+
+    BINearestBeaconTrackerRemove(tracker, 3);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 1.5));
+    CHECK_EQUAL(BIBeaconHandleInvalid, BINearestBeaconTrackerGetNearest(tracker));
+    BINearestBeaconTrackerDestroy(tracker);
+}
+
+TEST(impossibleJumpsAreIgnored)
+{
+    BINearestBeaconTrackerRef tracker = createTracker(3.0, 0.0, 20.0);
+    BIBeaconLocation here = location(0.0, 0.0, 0);
+    BIBeaconLocation farAway = location(50.0, 0.0, 0);
+    BIBeaconLocation upstairs = location(1.0, 0.0, 1);
+    BIBeaconLocation nearby = location(10.0, 0.0, 0);
+    update(tracker, 1, -70);
+    BINearestBeaconTrackerSetLocation(tracker, 1, &here);
+    BINearestBeaconTrackerEvaluate(tracker, 0.0);
+
+    update(tracker, 2, -50);
+    BINearestBeaconTrackerSetLocation(tracker, 2, &farAway);
+    update(tracker, 3, -55);
+    BINearestBeaconTrackerSetLocation(tracker, 3, &upstairs);
+    CHECK(!BINearestBeaconTrackerEvaluate(tracker, 1.0));
+    CHECK_EQUAL(1u, BINearestBeaconTrackerGetNearest(tracker));
+
+    // The strongest beacon that is within reach challenges instead.
+    update(tracker, 4, -60);
+    BINearestBeaconTrackerSetLocation(tracker, 4, &nearby);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 2.0));
+    CHECK_EQUAL(4u, BINearestBeaconTrackerGetNearest(tracker));
+
+    // Beacons without a location are always candidates.
+    update(tracker, 5, -45);
+    CHECK(BINearestBeaconTrackerEvaluate(tracker, 3.0));
+    CHECK_EQUAL(5u, BINearestBeaconTrackerGetNearest(tracker));
+    BINearestBeaconTrackerDestroy(tracker);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
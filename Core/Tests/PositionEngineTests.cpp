@@ -0,0 +1,184 @@
+//
+//  PositionEngineTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIPositionEngine.h>
+
+#include "TestHarness.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+// Four beacons in the corners of a 10 m square on floor 0, and one beacon on floor 1 above its center.
+const BIBeaconLocation squareMap[] = {
+    {beaconKey(1), 0.0, 0.0, 0},
+    {beaconKey(2), 10.0, 0.0, 0},
+    {beaconKey(3), 0.0, 10.0, 0},
+    {beaconKey(4), 10.0, 10.0, 0},
+    {beaconKey(5), 5.0, 5.0, 1},
+};
+
+BIRangedBeacon rangedBeacon(uint16_t minor, double timestamp, double smoothedDistance, double rawDistance)
+{
+    BIRangedBeacon beacon;
+    beacon.handle = minor;
+    beacon.key = beaconKey(minor);
+    beacon.smoothedSignal = {timestamp, -70, int32_t(BIProximityForAccuracy(smoothedDistance)), smoothedDistance, true};
+    beacon.rawSignal = {timestamp, -70, int32_t(BIProximityForAccuracy(rawDistance)), rawDistance, true};
+    return beacon;
+}
+
+// The ranged beacons of the floor 0 corners for a device at (x, y), with the raw distances off by a few percent.
+std::vector<BIRangedBeacon> rangeCorners(double timestamp, double x, double y, int tick)
+{
+    std::vector<BIRangedBeacon> beacons;
+    for (uint16_t minor = 1; minor <= 4; minor++) {
+        const BIBeaconLocation &location = squareMap[minor - 1];
+        double distance = std::hypot(location.x - x, location.y - y);
+        double noise = 1.0 + 0.05 * std::sin(double(tick * 7 + minor * 3));
+        beacons.push_back(rangedBeacon(minor, timestamp, distance, distance * noise));
+    }
+    return beacons;
+}
+
+} // namespace
+
+TEST(fixTrilateratesExactDistances)
+{
+    BIPositionEngineRef engine = BIPositionEngineCreate(NULL, squareMap, 5);
+    std::vector<BIRangedBeacon> beacons = rangeCorners(1.0, 3.0, 4.0, 0);
+    BIPosition position = BIPositionEngineUpdate(engine, 1.0, beacons.data(), beacons.size());
+    CHECK(position.fix.valid);
+    CHECK_NEAR(3.0, position.fix.x, 1e-3);
+    CHECK_NEAR(4.0, position.fix.y, 1e-3);
+    CHECK_EQUAL(0, position.fix.floor);
+    CHECK_EQUAL(4u, position.fix.beaconCount);
+    CHECK(position.filtered.valid);
+    BIPositionEngineDestroy(engine);
+}
+
+TEST(twoBeaconsGiveNoFix)
+{
+    BIPositionEngineRef engine = BIPositionEngineCreate(NULL, squareMap, 5);
+    std::vector<BIRangedBeacon> beacons = rangeCorners(1.0, 3.0, 4.0, 0);
+    BIPosition position = BIPositionEngineUpdate(engine, 1.0, beacons.data(), 2);
+    CHECK(!position.fix.valid);
+    CHECK(!position.filtered.valid);
+    BIPositionEngineDestroy(engine);
+}
+
+// The filter follows a walk across the square, and a second engine with the same seed replays it exactly.
+TEST(filterFollowsAWalkDeterministically)
+{
+    BIPositionEngineRef engine = BIPositionEngineCreate(NULL, squareMap, 5);
+    BIPositionEngineRef replay = BIPositionEngineCreate(NULL, squareMap, 5);
+    BIPosition position = {};
+    for (int tick = 0; tick < 40; tick++) {
+        double timestamp = double(tick);
+        double x = 2.0 + 0.15 * tick;
+        std::vector<BIRangedBeacon> beacons = rangeCorners(timestamp, x, 3.0, tick);
+        position = BIPositionEngineUpdate(engine, timestamp, beacons.data(), beacons.size());
+        BIPosition replayed = BIPositionEngineUpdate(replay, timestamp, beacons.data(), beacons.size());
+        CHECK(position.filtered.valid);
+        CHECK_EQUAL(position.filtered.x, replayed.filtered.x);
+        CHECK_EQUAL(position.filtered.y, replayed.filtered.y);
+        CHECK_EQUAL(position.filtered.uncertainty, replayed.filtered.uncertainty);
+    }
+    CHECK_NEAR(7.85, position.filtered.x, 1.5);
+    CHECK_NEAR(3.0, position.filtered.y, 1.5);
+    CHECK(position.filtered.covarianceXX > 0.0 && position.filtered.covarianceYY > 0.0);
+    double spread = std::sqrt(position.filtered.covarianceXX + position.filtered.covarianceYY);
+    CHECK_NEAR(spread, position.filtered.uncertainty, 1e-9);
+
+    // Ticks with too few beacons for a fix still get a position from the filter.
+    std::vector<BIRangedBeacon> beacons = rangeCorners(40.0, 7.85, 3.0, 40);
+    position = BIPositionEngineUpdate(engine, 40.0, beacons.data(), 2);
+    CHECK(!position.fix.valid);
+    CHECK(position.filtered.valid);
+    BIPositionEngineDestroy(engine);
+    BIPositionEngineDestroy(replay);
+}
+
+TEST(resetStartsOverFromTheNextFix)
+{
+    BIPositionEngineRef engine = BIPositionEngineCreate(NULL, squareMap, 5);
+    std::vector<BIRangedBeacon> beacons = rangeCorners(1.0, 3.0, 4.0, 0);
+    BIPositionEngineUpdate(engine, 1.0, beacons.data(), beacons.size());
+    BIPositionEngineReset(engine);
+    beacons = rangeCorners(2.0, 7.0, 6.0, 1);
+    BIPosition position = BIPositionEngineUpdate(engine, 2.0, beacons.data(), 2);
+    CHECK(!position.filtered.valid);
+    position = BIPositionEngineUpdate(engine, 3.0, beacons.data(), beacons.size());
+    CHECK(position.filtered.valid);
+    CHECK_NEAR(7.0, position.filtered.x, 1.5);
+    CHECK_NEAR(6.0, position.filtered.y, 1.5);
+    BIPositionEngineDestroy(engine);
+}
+
+TEST(floorOfTheNearestBeaconsWins)
+{
+    // Three beacons on floor 1 right above the corners of floor 0; the device is on floor 1 near one corner, and the
+    // corners of floor 0 are heard farther away through the floor.
+    std::vector<BIBeaconLocation> map(squareMap, squareMap + 4);
+    map.push_back({beaconKey(6), 0.0, 0.0, 1});
+    map.push_back({beaconKey(7), 10.0, 0.0, 1});
+    map.push_back({beaconKey(8), 0.0, 10.0, 1});
+    BIPositionEngineRef engine = BIPositionEngineCreate(NULL, map.data(), map.size());
+    std::vector<BIRangedBeacon> beacons = rangeCorners(1.0, 2.0, 2.0, 0);
+    for (BIRangedBeacon &beacon : beacons) {
+        beacon.smoothedSignal.accuracy += 4.0;
+        beacon.rawSignal.accuracy += 4.0;
+    }
+    for (size_t i = 4; i < map.size(); i++) {
+        double distance = std::hypot(map[i].x - 2.0, map[i].y - 2.0);
+        beacons.push_back(rangedBeacon(map[i].key.minor, 1.0, distance, distance));
+    }
+    BIPosition position = BIPositionEngineUpdate(engine, 1.0, beacons.data(), beacons.size());
+    CHECK(position.fix.valid);
+    CHECK_EQUAL(1, position.fix.floor);
+    CHECK_EQUAL(3u, position.fix.beaconCount);
+    CHECK_NEAR(2.0, position.fix.x, 1e-3);
+    CHECK_NEAR(2.0, position.fix.y, 1e-3);
+    BIPositionEngineDestroy(engine);
+}
+
+// A beacon heard through the ceiling must not restart the particle filter, wherever it appears among the ranged
+// beacons of a tick.
+TEST(beaconOrderDoesNotChangePosition)
+{
+    BIPositionEngineRef first = BIPositionEngineCreate(NULL, squareMap, 5);
+    BIPositionEngineRef last = BIPositionEngineCreate(NULL, squareMap, 5);
+    for (int tick = 0; tick < 20; tick++) {
+        double timestamp = double(tick);
+        double x = 2.0 + 0.3 * tick;
+        std::vector<BIRangedBeacon> beacons = rangeCorners(timestamp, x, 4.0, tick);
+        BIRangedBeacon ceiling = rangedBeacon(5, timestamp, 8.0, 8.0);
+
+        std::vector<BIRangedBeacon> ceilingFirst(1, ceiling);
+        ceilingFirst.insert(ceilingFirst.end(), beacons.begin(), beacons.end());
+        beacons.push_back(ceiling);
+
+        BIPosition a = BIPositionEngineUpdate(first, timestamp, ceilingFirst.data(), ceilingFirst.size());
+        BIPosition b = BIPositionEngineUpdate(last, timestamp, beacons.data(), beacons.size());
+        CHECK_EQUAL(0, a.fix.floor);
+        CHECK_EQUAL(b.fix.x, a.fix.x);
+        CHECK_EQUAL(b.fix.y, a.fix.y);
+        CHECK(a.filtered.valid && b.filtered.valid);
+        CHECK_EQUAL(b.filtered.x, a.filtered.x);
+        CHECK_EQUAL(b.filtered.y, a.filtered.y);
+    }
+    BIPositionEngineDestroy(first);
+    BIPositionEngineDestroy(last);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
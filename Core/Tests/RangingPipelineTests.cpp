@@ -0,0 +1,199 @@
+//
+//  RangingPipelineTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIRangingPipeline.h>
+
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+struct RegionCopy {
+    uint32_t regionID;
+    std::vector<BIRangedBeacon> beacons;
+    uint16_t nearestMinor; // 0 without a nearest beacon
+    bool nearestBeaconChanged;
+};
+
+struct BatchCopy {
+    uint64_t sequenceNumber;
+    double timestamp;
+    std::vector<RegionCopy> regions;
+};
+
+void copyBatch(const BIRangingBatch *batch, void *context)
+{
+    BatchCopy copy = {batch->sequenceNumber, batch->timestamp, {}};
+    for (size_t i = 0; i < batch->regionCount; i++) {
+        const BIRegionRangingResult &region = batch->regions[i];
+        copy.regions.push_back({region.regionID,
+                                std::vector<BIRangedBeacon>(region.beacons, region.beacons + region.beaconCount),
+                                uint16_t(region.nearestBeacon != NULL ? region.nearestBeacon->key.minor : 0),
+                                region.nearestBeaconChanged});
+    }
+    static_cast<std::vector<BatchCopy> *>(context)->push_back(copy);
+}
+
+BIRangingPipelineRef createSynchronousPipeline(std::vector<BatchCopy> &batches)
+{
+    BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+    configuration.synchronous = true;
+    return BIRangingPipelineCreate(&configuration, BIDeliveryQueue{NULL, NULL}, &copyBatch, &batches);
+}
+
+// A delivery queue that keeps the work until the test runs it.
+struct HeldWork {
+    void *context;
+    BIWorkFunction work;
+};
+
+void holdWork(void *queue, void *context, BIWorkFunction work)
+{
+    static_cast<std::vector<HeldWork> *>(queue)->push_back({context, work});
+}
+
+} // namespace
+
+TEST(reportsOfAllRegionsFormOneBatch)
+{
+    std::vector<BatchCopy> batches;
+    BIRangingPipelineRef pipeline = createSynchronousPipeline(batches);
+    uint32_t first = BIRangingPipelineAddRegion(pipeline);
+    uint32_t second = BIRangingPipelineAddRegion(pipeline);
+    BIBeaconSample samples[] = {beaconSample(1, -60, 1.0), beaconSample(2, -70, 3.0)};
+    BIRangingPipelineSubmit(pipeline, first, 1.0, samples, 1);
+    CHECK(batches.empty());
+    BIRangingPipelineSubmit(pipeline, second, 1.2, samples + 1, 1);
+    REQUIRE(batches.size() == 1);
+    CHECK_EQUAL(1u, batches[0].sequenceNumber);
+    CHECK_EQUAL(1.2, batches[0].timestamp);
+    REQUIRE(batches[0].regions.size() == 2);
+    CHECK_EQUAL(first, batches[0].regions[0].regionID);
+    CHECK_EQUAL(1u, batches[0].regions[0].nearestMinor);
+    CHECK_EQUAL(second, batches[0].regions[1].regionID);
+    CHECK_EQUAL(2u, batches[0].regions[1].nearestMinor);
+    BIRangingPipelineDestroy(pipeline);
+}
+
+TEST(secondReportStartsTheNextTick)
+{
+    std::vector<BatchCopy> batches;
+    BIRangingPipelineRef pipeline = createSynchronousPipeline(batches);
+    uint32_t first = BIRangingPipelineAddRegion(pipeline);
+    BIRangingPipelineAddRegion(pipeline);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    BIRangingPipelineSubmit(pipeline, first, 1.0, &sample, 1);
+    BIRangingPipelineSubmit(pipeline, first, 2.0, &sample, 1);
+    REQUIRE(batches.size() == 1);
+    CHECK_EQUAL(1.0, batches[0].timestamp);
+    CHECK_EQUAL(1u, batches[0].regions.size());
+
+    BIRangingPipelineFlush(pipeline);
+    REQUIRE(batches.size() == 2);
+    CHECK_EQUAL(2.0, batches[1].timestamp);
+    CHECK_EQUAL(2u, BIRangingPipelineGetStatistics(pipeline).batchesDelivered);
+    BIRangingPipelineDestroy(pipeline);
+}
+
+TEST(beaconsAreSortedAndNearestChangesAreFlagged)
+{
+    std::vector<BatchCopy> batches;
+    BIRangingPipelineRef pipeline = createSynchronousPipeline(batches);
+    uint32_t region = BIRangingPipelineAddRegion(pipeline);
+    BIBeaconSample samples[] = {beaconSample(1, -75, 4.0), beaconSample(2, -60, 1.0), beaconSample(3, -70, 2.0)};
+    BIRangingPipelineSubmit(pipeline, region, 1.0, samples, 3);
+    BIRangingPipelineSubmit(pipeline, region, 2.0, samples, 3);
+    REQUIRE(batches.size() == 2);
+    const RegionCopy &result = batches[0].regions[0];
+    REQUIRE(result.beacons.size() == 3);
+    CHECK_EQUAL(2u, result.beacons[0].key.minor);
+    CHECK_EQUAL(3u, result.beacons[1].key.minor);
+    CHECK_EQUAL(1u, result.beacons[2].key.minor);
+    CHECK_EQUAL(2u, result.nearestMinor);
+    CHECK(result.nearestBeaconChanged);
+    CHECK_EQUAL(2u, batches[1].regions[0].nearestMinor);
+    CHECK(!batches[1].regions[0].nearestBeaconChanged);
+    BIRangingPipelineDestroy(pipeline);
+}
+
+TEST(regionsSmoothWithTheirOwnConfiguration)
+{
+    std::vector<BatchCopy> batches;
+    BIRangingPipelineRef pipeline = createSynchronousPipeline(batches);
+    uint32_t averaged = BIRangingPipelineAddRegion(pipeline);
+    BISmoothingConfiguration smoothing = BISmoothingConfigurationMakeDefault();
+    smoothing.windowSize = 1;
+    uint32_t unsmoothed = BIRangingPipelineAddRegionWithSmoothing(pipeline, &smoothing);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    BIRangingPipelineSubmit(pipeline, averaged, 1.0, &sample, 1);
+    BIRangingPipelineSubmit(pipeline, unsmoothed, 1.0, &sample, 1);
+    sample.RSSI = -70;
+    BIRangingPipelineSubmit(pipeline, averaged, 2.0, &sample, 1);
+    BIRangingPipelineSubmit(pipeline, unsmoothed, 2.0, &sample, 1);
+    REQUIRE(batches.size() == 2);
+    REQUIRE(batches[1].regions.size() == 2);
+    CHECK_EQUAL(-65, batches[1].regions[0].beacons[0].smoothedSignal.RSSI);
+    CHECK_EQUAL(-70, batches[1].regions[1].beacons[0].smoothedSignal.RSSI);
+    CHECK_EQUAL(-70, batches[1].regions[0].beacons[0].rawSignal.RSSI);
+    BIRangingPipelineDestroy(pipeline);
+}
+
+TEST(removedRegionNoLongerHoldsTheTick)
+{
+    std::vector<BatchCopy> batches;
+    BIRangingPipelineRef pipeline = createSynchronousPipeline(batches);
+    uint32_t kept = BIRangingPipelineAddRegion(pipeline);
+    uint32_t removed = BIRangingPipelineAddRegion(pipeline);
+    BIRangingPipelineRemoveRegion(pipeline, removed);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    BIRangingPipelineSubmit(pipeline, removed, 1.0, &sample, 1);
+    CHECK(batches.empty());
+    BIRangingPipelineSubmit(pipeline, kept, 1.0, &sample, 1);
+    REQUIRE(batches.size() == 1);
+    REQUIRE(batches[0].regions.size() == 1);
+    CHECK_EQUAL(kept, batches[0].regions[0].regionID);
+    BIRangingPipelineDestroy(pipeline);
+}
+
+TEST(batchesAreDroppedWhileDeliveryFallsBehind)
+{
+    std::vector<BatchCopy> batches;
+    std::vector<HeldWork> queue;
+    BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+    configuration.maximumPendingDeliveries = 1;
+    BIRangingPipelineRef pipeline =
+        BIRangingPipelineCreate(&configuration, BIDeliveryQueue{&holdWork, &queue}, &copyBatch, &batches);
+    uint32_t region = BIRangingPipelineAddRegion(pipeline);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    for (int tick = 1; tick <= 3; tick++) {
+        BIRangingPipelineSubmit(pipeline, region, double(tick), &sample, 1);
+        BIRangingPipelineWaitUntilIdle(pipeline);
+    }
+    BIRangingPipelineStatistics statistics = BIRangingPipelineGetStatistics(pipeline);
+    CHECK_EQUAL(3u, statistics.ticksProcessed);
+    CHECK_EQUAL(2u, statistics.batchesDropped);
+    REQUIRE(queue.size() == 1);
+    queue[0].work(queue[0].context);
+    REQUIRE(batches.size() == 1);
+    CHECK_EQUAL(1.0, batches[0].timestamp);
+
+    // Once delivered, the batch can be reused; a batch still queued when the pipeline goes away is discarded.
+    BIRangingPipelineSubmit(pipeline, region, 4.0, &sample, 1);
+    BIRangingPipelineWaitUntilIdle(pipeline);
+    REQUIRE(queue.size() == 2);
+    BIRangingPipelineDestroy(pipeline);
+    queue[1].work(queue[1].context);
+    CHECK_EQUAL(1u, batches.size());
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,174 @@
+//
+//  RegionMonitorTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIRegionMonitor.h>
+
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+struct Transition {
+    uint32_t regionID;
+    BIRegionTransition transition;
+    double timestamp;
+};
+
+void recordTransition(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context)
+{
+    static_cast<std::vector<Transition> *>(context)->push_back({regionID, transition, timestamp});
+}
+
+BIRegionMonitorRef createMonitor(std::vector<Transition> &transitions, double exitGracePeriod = 30.0,
+                                 double minimumDwell = 10.0)
+{
+    BIRegionMonitorConfiguration configuration = BIRegionMonitorConfigurationMakeDefault();
+    configuration.exitGracePeriod = exitGracePeriod;
+    configuration.minimumDwell = minimumDwell;
+    return BIRegionMonitorCreate(&configuration, &recordTransition, &transitions);
+}
+
+} // namespace
+
+TEST(enterEventEntersAtOnce)
+{
+    std::vector<Transition> transitions;
+    BIRegionMonitorRef monitor = createMonitor(transitions);
+    uint32_t region = BIRegionMonitorAddRegion(monitor);
+    CHECK_EQUAL(BIRegionStateUnknown, BIRegionMonitorGetState(monitor, region));
+    BIRegionMonitorReportEvent(monitor, region, 1.0, BIRegionEventEnter);
+    REQUIRE(transitions.size() == 1);
+    CHECK_EQUAL(region, transitions[0].regionID);
+    CHECK_EQUAL(BIRegionTransitionEnter, transitions[0].transition);
+    CHECK_EQUAL(1.0, transitions[0].timestamp);
+    CHECK_EQUAL(BIRegionStateInside, BIRegionMonitorGetState(monitor, region));
+
+    BIRegionMonitorReportEvent(monitor, region, 2.0, BIRegionEventStateInside);
+    BIRegionMonitorReportEvent(monitor, region, 3.0, BIRegionEventStateUnknown);
+    CHECK_EQUAL(1u, transitions.size());
+    BIRegionMonitorStatistics statistics = BIRegionMonitorGetStatistics(monitor, region);
+    CHECK_EQUAL(1u, statistics.enters);
+    CHECK_EQUAL(1u, statistics.duplicateEnters);
+    BIRegionMonitorDestroy(monitor);
+}
+
+TEST(exitIsReportedAfterTheGracePeriod)
+{
+    std::vector<Transition> transitions;
+    BIRegionMonitorRef monitor = createMonitor(transitions);
+    uint32_t region = BIRegionMonitorAddRegion(monitor);
+    BIRegionMonitorReportEvent(monitor, region, 0.0, BIRegionEventEnter);
+    BIRegionMonitorReportEvent(monitor, region, 20.0, BIRegionEventExit);
+    BIRegionMonitorReportEvent(monitor, region, 25.0, BIRegionEventStateOutside);
+    CHECK_EQUAL(1u, BIRegionMonitorGetPendingCount(monitor));
+    BIRegionMonitorAdvance(monitor, 49.9);
+    CHECK_EQUAL(1u, transitions.size());
+    CHECK_EQUAL(BIRegionStateInside, BIRegionMonitorGetState(monitor, region));
+
+    // Reported with the time it became due, not the time of the call.
+    BIRegionMonitorAdvance(monitor, 60.0);
+    REQUIRE(transitions.size() == 2);
+    CHECK_EQUAL(BIRegionTransitionExit, transitions[1].transition);
+    CHECK_EQUAL(50.0, transitions[1].timestamp);
+    CHECK_EQUAL(BIRegionStateOutside, BIRegionMonitorGetState(monitor, region));
+    CHECK_EQUAL(0u, BIRegionMonitorGetPendingCount(monitor));
+    CHECK_EQUAL(1u, BIRegionMonitorGetStatistics(monitor, region).duplicateExits);
+    BIRegionMonitorDestroy(monitor);
+}
+
+TEST(insideEvidenceCancelsAnExit)
+{
+    std::vector<Transition> transitions;
+    BIRegionMonitorRef monitor = createMonitor(transitions);
+    uint32_t region = BIRegionMonitorAddRegion(monitor);
+    BIRegionMonitorReportEvent(monitor, region, 0.0, BIRegionEventEnter);
+    BIRegionMonitorReportRanging(monitor, region, 20.0, 0);
+    BIRegionMonitorReportRanging(monitor, region, 21.0, 2);
+    BIRegionMonitorAdvance(monitor, 100.0);
+    CHECK_EQUAL(1u, transitions.size());
+    CHECK_EQUAL(BIRegionStateInside, BIRegionMonitorGetState(monitor, region));
+    CHECK_EQUAL(1u, BIRegionMonitorGetStatistics(monitor, region).suppressedExits);
+    BIRegionMonitorDestroy(monitor);
+}
+
+TEST(rangingAloneEntersAfterConsecutiveReports)
+{
+    std::vector<Transition> transitions;
+    BIRegionMonitorRef monitor = createMonitor(transitions);
+    uint32_t region = BIRegionMonitorAddRegion(monitor);
+    BIRegionMonitorReportRanging(monitor, region, 0.0, 1);
+    BIRegionMonitorReportRanging(monitor, region, 1.0, 1);
+    // Too long after the previous report: the count starts over.
+    BIRegionMonitorReportRanging(monitor, region, 40.0, 1);
+    BIRegionMonitorReportRanging(monitor, region, 41.0, 1);
+    CHECK(transitions.empty());
+    BIRegionMonitorReportRanging(monitor, region, 42.0, 3);
+    REQUIRE(transitions.size() == 1);
+    CHECK_EQUAL(42.0, transitions[0].timestamp);
+
+    // A report without beacons breaks the streak as well.
+    uint32_t other = BIRegionMonitorAddRegion(monitor);
+    BIRegionMonitorReportRanging(monitor, other, 43.0, 1);
+    BIRegionMonitorReportRanging(monitor, other, 44.0, 1);
+    BIRegionMonitorReportRanging(monitor, other, 45.0, 0);
+    BIRegionMonitorReportRanging(monitor, other, 46.0, 1);
+    CHECK_EQUAL(1u, transitions.size());
+    CHECK_EQUAL(BIRegionStateOutside, BIRegionMonitorGetState(monitor, other));
+    BIRegionMonitorDestroy(monitor);
+}
+
+TEST(minimumDwellPostponesAndDropsTransitions)
+{
+    std::vector<Transition> transitions;
+    BIRegionMonitorRef monitor = createMonitor(transitions, 2.0, 10.0);
+    uint32_t region = BIRegionMonitorAddRegion(monitor);
+    BIRegionMonitorReportEvent(monitor, region, 0.0, BIRegionEventEnter);
+    BIRegionMonitorReportEvent(monitor, region, 1.0, BIRegionEventExit);
+    BIRegionMonitorAdvance(monitor, 9.0);
+    CHECK_EQUAL(1u, transitions.size());
+    BIRegionMonitorAdvance(monitor, 10.0);
+    REQUIRE(transitions.size() == 2);
+    CHECK_EQUAL(10.0, transitions[1].timestamp);
+
+    // The entry would be due at 20; leaving again before that drops it.
+    BIRegionMonitorReportEvent(monitor, region, 11.0, BIRegionEventEnter);
+    CHECK_EQUAL(1u, BIRegionMonitorGetPendingCount(monitor));
+    BIRegionMonitorReportEvent(monitor, region, 12.0, BIRegionEventExit);
+    BIRegionMonitorAdvance(monitor, 100.0);
+    CHECK_EQUAL(2u, transitions.size());
+    CHECK_EQUAL(BIRegionStateOutside, BIRegionMonitorGetState(monitor, region));
+    CHECK_EQUAL(1u, BIRegionMonitorGetStatistics(monitor, region).suppressedEnters);
+    BIRegionMonitorDestroy(monitor);
+}
+
+TEST(removedRegionsKeepCountingInTheTotals)
+{
+    std::vector<Transition> transitions;
+    BIRegionMonitorRef monitor = createMonitor(transitions);
+    uint32_t first = BIRegionMonitorAddRegion(monitor);
+    uint32_t second = BIRegionMonitorAddRegion(monitor);
+    BIRegionMonitorReportEvent(monitor, first, 0.0, BIRegionEventEnter);
+    BIRegionMonitorReportEvent(monitor, second, 0.0, BIRegionEventEnter);
+    BIRegionMonitorReportEvent(monitor, second, 1.0, BIRegionEventExit);
+    BIRegionMonitorRemoveRegion(monitor, second);
+    CHECK_EQUAL(0u, BIRegionMonitorGetPendingCount(monitor));
+    BIRegionMonitorAdvance(monitor, 100.0);
+    CHECK_EQUAL(2u, transitions.size());
+    CHECK_EQUAL(BIRegionStateUnknown, BIRegionMonitorGetState(monitor, second));
+    BIRegionMonitorReportEvent(monitor, second, 101.0, BIRegionEventEnter);
+    CHECK_EQUAL(2u, transitions.size());
+    CHECK_EQUAL(2u, BIRegionMonitorGetStatistics(monitor, 0).enters);
+    BIRegionMonitorDestroy(monitor);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
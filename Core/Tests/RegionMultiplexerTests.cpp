@@ -0,0 +1,213 @@
+//
+//  RegionMultiplexerTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIRegionMultiplexer.h>
+
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+struct Change {
+    BIPhysicalRegion region;
+    bool monitor;
+};
+
+struct Event {
+    uint32_t logicalRegionID;
+    BIRegionEvent event;
+};
+
+struct Recorder {
+    std::vector<Change> changes;
+    std::vector<Event> events;
+
+    // The physical region currently registered for a logical region (0 for the wildcard region), or 0.
+    uint32_t registered(uint32_t logicalRegionID) const
+    {
+        uint32_t physicalRegionID = 0;
+        for (const Change &change : changes) {
+            if (change.region.logicalRegionID == logicalRegionID) {
+                physicalRegionID = change.monitor ? change.region.physicalRegionID : 0;
+            }
+        }
+        return physicalRegionID;
+    }
+
+    size_t count(uint32_t logicalRegionID, BIRegionEvent event) const
+    {
+        size_t count = 0;
+        for (const Event &recorded : events) {
+            count += recorded.logicalRegionID == logicalRegionID && recorded.event == event;
+        }
+        return count;
+    }
+};
+
+void recordChange(const BIPhysicalRegion *region, bool monitor, void *context)
+{
+    static_cast<Recorder *>(context)->changes.push_back({*region, monitor});
+}
+
+void recordEvent(uint32_t logicalRegionID, BIRegionEvent event, double, void *context)
+{
+    static_cast<Recorder *>(context)->events.push_back({logicalRegionID, event});
+}
+
+BIRegionMultiplexerRef createMultiplexer(Recorder &recorder, uint32_t maximumRegions, uint32_t wildcardRegions)
+{
+    BIRegionMultiplexerConfiguration configuration = BIRegionMultiplexerConfigurationMakeDefault();
+    configuration.maximumRegions = maximumRegions;
+    configuration.wildcardRegions = wildcardRegions;
+    return BIRegionMultiplexerCreate(&configuration, &recordChange, &recordEvent, &recorder);
+}
+
+BIBeaconKey otherUUIDKey(uint16_t minor, uint16_t major)
+{
+    BIBeaconKey key = beaconKey(minor, major);
+    key.proximityUUID[0] ^= 0xFF;
+    return key;
+}
+
+uint32_t addRegion(BIRegionMultiplexerRef multiplexer, const BIBeaconKey &key, BIBeaconRegionScope scope,
+                   double priority)
+{
+    BIBeaconRegionDefinition definition = {key, scope};
+    return BIRegionMultiplexerAddRegion(multiplexer, &definition, priority);
+}
+
+BIBeaconSample sample(uint16_t minor, uint16_t major, int32_t RSSI)
+{
+    BIBeaconSample sample = beaconSample(minor, RSSI, 1.0);
+    sample.key.major = major;
+    return sample;
+}
+
+} // namespace
+
+TEST(wildcardAndHighestScoringRegionsAreRegistered)
+{
+    Recorder recorder;
+    BIRegionMultiplexerRef multiplexer = createMultiplexer(recorder, 3, 1);
+    uint32_t major = addRegion(multiplexer, beaconKey(0, 1), BIBeaconRegionScopeMajor, 5.0);
+    uint32_t minor = addRegion(multiplexer, beaconKey(2, 1), BIBeaconRegionScopeMinor, 1.0);
+    uint32_t other = addRegion(multiplexer, otherUUIDKey(0, 1), BIBeaconRegionScopeMajor, 3.0);
+    uint32_t uuid = addRegion(multiplexer, beaconKey(0, 0), BIBeaconRegionScopeUUID, 0.0);
+    CHECK_EQUAL(3u, BIRegionMultiplexerEvaluate(multiplexer, 0.0));
+
+    // The UUID region is served by the wildcard region, the minor region does not fit any more.
+    REQUIRE(recorder.registered(0) != 0);
+    const Change &wildcard = recorder.changes[0];
+    CHECK_EQUAL(BIBeaconRegionScopeUUID, wildcard.region.definition.scope);
+    CHECK_EQUAL(0, std::memcmp(wildcard.region.definition.key.proximityUUID, beaconKey(0).proximityUUID, 16));
+    CHECK(BIRegionMultiplexerGetPhysicalRegion(multiplexer, major) != 0);
+    CHECK_EQUAL(recorder.registered(major), BIRegionMultiplexerGetPhysicalRegion(multiplexer, major));
+    CHECK(BIRegionMultiplexerGetPhysicalRegion(multiplexer, other) != 0);
+    CHECK_EQUAL(0u, BIRegionMultiplexerGetPhysicalRegion(multiplexer, minor));
+    CHECK_EQUAL(0u, BIRegionMultiplexerGetPhysicalRegion(multiplexer, uuid));
+
+    CHECK_EQUAL(0u, BIRegionMultiplexerEvaluate(multiplexer, 1.0));
+    CHECK_EQUAL(3u, BIRegionMultiplexerGetStatistics(multiplexer).registrations);
+    BIRegionMultiplexerDestroy(multiplexer);
+}
+
+TEST(physicalEventsBecomeLogicalEvents)
+{
+    Recorder recorder;
+    BIRegionMultiplexerRef multiplexer = createMultiplexer(recorder, 3, 1);
+    uint32_t major = addRegion(multiplexer, beaconKey(0, 1), BIBeaconRegionScopeMajor, 5.0);
+    uint32_t uuid = addRegion(multiplexer, beaconKey(0, 0), BIBeaconRegionScopeUUID, 0.0);
+    BIRegionMultiplexerEvaluate(multiplexer, 0.0);
+
+    BIRegionMultiplexerReportEvent(multiplexer, recorder.registered(major), 1.0, BIRegionEventEnter);
+    BIRegionMultiplexerReportEvent(multiplexer, recorder.registered(major), 2.0, BIRegionEventStateInside);
+    CHECK_EQUAL(1u, recorder.count(major, BIRegionEventEnter));
+    CHECK(BIRegionMultiplexerIsInside(multiplexer, major));
+    BIRegionMultiplexerReportEvent(multiplexer, recorder.registered(0), 3.0, BIRegionEventEnter);
+    CHECK_EQUAL(1u, recorder.count(uuid, BIRegionEventEnter));
+
+    // Leaving the wildcard region leaves every region of its UUID.
+    BIRegionMultiplexerReportEvent(multiplexer, recorder.registered(0), 4.0, BIRegionEventExit);
+    CHECK_EQUAL(1u, recorder.count(major, BIRegionEventExit));
+    CHECK_EQUAL(1u, recorder.count(uuid, BIRegionEventExit));
+    CHECK(!BIRegionMultiplexerIsInside(multiplexer, major));
+
+    // Events of regions that are no longer monitored are ignored.
+    BIRegionMultiplexerReportEvent(multiplexer, 999, 5.0, BIRegionEventEnter);
+    CHECK_EQUAL(4u, recorder.events.size());
+    BIRegionMultiplexerDestroy(multiplexer);
+}
+
+TEST(rangedBeaconsAreDemultiplexed)
+{
+    Recorder recorder;
+    BIRegionMultiplexerRef multiplexer = createMultiplexer(recorder, 2, 1);
+    uint32_t major = addRegion(multiplexer, beaconKey(0, 1), BIBeaconRegionScopeMajor, 5.0);
+    uint32_t minor = addRegion(multiplexer, beaconKey(2, 1), BIBeaconRegionScopeMinor, 1.0);
+    uint32_t uuid = addRegion(multiplexer, beaconKey(0, 0), BIBeaconRegionScopeUUID, 0.0);
+    BIRegionMultiplexerEvaluate(multiplexer, 0.0);
+    REQUIRE(BIRegionMultiplexerGetPhysicalRegion(multiplexer, major) != 0);
+    REQUIRE(BIRegionMultiplexerGetPhysicalRegion(multiplexer, minor) == 0);
+
+    // Beacon 4 was just lost (RSSI 0), beacon 5 has another UUID.
+    BIBeaconSample samples[] = {sample(2, 1, -60), sample(3, 9, -70), sample(4, 9, 0), sample(5, 1, -80)};
+    samples[3].key = otherUUIDKey(5, 1);
+    BIRegionMultiplexerReportRanging(multiplexer, 10.0, samples, 4);
+    CHECK(BIRegionMultiplexerIsInside(multiplexer, major));
+    CHECK(BIRegionMultiplexerIsInside(multiplexer, minor));
+    CHECK(BIRegionMultiplexerIsInside(multiplexer, uuid));
+    CHECK_EQUAL(2u, BIRegionMultiplexerGetStatistics(multiplexer).demultiplexedBeacons);
+
+    // Without a physical region of their own, regions are left once their beacons are not ranged any more.
+    BIRegionMultiplexerReportRanging(multiplexer, 30.0, samples + 1, 1);
+    CHECK(BIRegionMultiplexerIsInside(multiplexer, minor));
+    BIRegionMultiplexerReportRanging(multiplexer, 41.0, samples + 1, 1);
+    CHECK(!BIRegionMultiplexerIsInside(multiplexer, minor));
+    CHECK(BIRegionMultiplexerIsInside(multiplexer, uuid));
+    CHECK(BIRegionMultiplexerIsInside(multiplexer, major));
+    BIRegionMultiplexerDestroy(multiplexer);
+}
+
+TEST(registrationsChurnOnlyPastTheMarginAndMinimumTime)
+{
+    Recorder recorder;
+    BIRegionMultiplexerRef multiplexer = createMultiplexer(recorder, 1, 0);
+    uint32_t first = addRegion(multiplexer, beaconKey(1), BIBeaconRegionScopeMinor, 1.0);
+    BIRegionMultiplexerEvaluate(multiplexer, 0.0);
+    REQUIRE(recorder.registered(first) != 0);
+
+    uint32_t slightlyBetter = addRegion(multiplexer, beaconKey(2), BIBeaconRegionScopeMinor, 1.05);
+    uint32_t better = addRegion(multiplexer, beaconKey(3), BIBeaconRegionScopeMinor, 1.5);
+    CHECK_EQUAL(0u, BIRegionMultiplexerEvaluate(multiplexer, 10.0));
+    BIRegionMultiplexerRemoveRegion(multiplexer, better);
+    CHECK_EQUAL(0u, BIRegionMultiplexerEvaluate(multiplexer, 40.0));
+    better = addRegion(multiplexer, beaconKey(3), BIBeaconRegionScopeMinor, 1.5);
+
+    CHECK_EQUAL(2u, BIRegionMultiplexerEvaluate(multiplexer, 40.0));
+    REQUIRE(recorder.changes.size() == 3);
+    CHECK(!recorder.changes[1].monitor);
+    CHECK_EQUAL(first, recorder.changes[1].region.logicalRegionID);
+    CHECK(recorder.changes[2].monitor);
+    CHECK_EQUAL(better, recorder.changes[2].region.logicalRegionID);
+    CHECK_EQUAL(0u, BIRegionMultiplexerGetPhysicalRegion(multiplexer, slightlyBetter));
+
+    // A removed region is unregistered by the next evaluation.
+    BIRegionMultiplexerRemoveRegion(multiplexer, better);
+    CHECK_EQUAL(2u, BIRegionMultiplexerEvaluate(multiplexer, 41.0));
+    CHECK_EQUAL(0u, recorder.registered(better));
+    CHECK(recorder.registered(slightlyBetter) != 0);
+    CHECK_EQUAL(2u, BIRegionMultiplexerGetStatistics(multiplexer).unregistrations);
+    BIRegionMultiplexerDestroy(multiplexer);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
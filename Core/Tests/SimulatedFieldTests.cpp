@@ -0,0 +1,143 @@
+//
+//  SimulatedFieldTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BICoreTypes.h>
+
+#include "SimulatedField.hpp"
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+using namespace bi::tools;
+
+namespace {
+
+FieldLayout smallLayout()
+{
+    FieldLayout layout;
+    layout.beaconCount = 400;
+    layout.floorCount = 2;
+    return layout;
+}
+
+// What a user reported in one tick: its position, the ranging samples and the packets it heard.
+struct Tick {
+    double x;
+    double y;
+    int32_t floor;
+    std::vector<BIBeaconSample> samples;
+    std::vector<SimulatedPacket> packets;
+};
+
+Tick nextTick(SimulatedUser &user)
+{
+    Tick tick;
+    tick.samples = user.nextTick();
+    tick.packets = user.packets();
+    tick.x = user.x();
+    tick.y = user.y();
+    tick.floor = user.floor();
+    return tick;
+}
+
+bool sameTick(const Tick &lhs, const Tick &rhs)
+{
+    if (lhs.x != rhs.x || lhs.y != rhs.y || lhs.floor != rhs.floor || lhs.samples.size() != rhs.samples.size() ||
+        lhs.packets.size() != rhs.packets.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.samples.size(); i++) {
+        const BIBeaconSample &a = lhs.samples[i];
+        const BIBeaconSample &b = rhs.samples[i];
+        if (!BIBeaconKeyEqual(&a.key, &b.key) || a.RSSI != b.RSSI || a.proximity != b.proximity ||
+            a.accuracy != b.accuracy) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < lhs.packets.size(); i++) {
+        const SimulatedPacket &a = lhs.packets[i];
+        const SimulatedPacket &b = rhs.packets[i];
+        if (a.timestamp != b.timestamp || a.beacon != b.beacon || a.RSSI != b.RSSI) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(sameSeedGivesTheSameField)
+{
+    SimulatedField field(smallLayout(), FieldProfile(), 42);
+    SimulatedField same(smallLayout(), FieldProfile(), 42);
+    SimulatedField other(smallLayout(), FieldProfile(), 43);
+    REQUIRE(field.beaconCount() == 400);
+    REQUIRE(same.beaconCount() == 400);
+    size_t differences = 0;
+    for (uint32_t i = 0; i < field.beaconCount(); i++) {
+        const SimulatedBeacon &a = field.beacon(i);
+        const SimulatedBeacon &b = same.beacon(i);
+        CHECK(BIBeaconKeyEqual(&a.location.key, &b.location.key));
+        CHECK_EQUAL(a.location.x, b.location.x);
+        CHECK_EQUAL(a.location.y, b.location.y);
+        CHECK_EQUAL(a.location.floor, b.location.floor);
+        CHECK_EQUAL(a.TXPower, b.TXPower);
+        CHECK_EQUAL(a.advertisingInterval, b.advertisingInterval);
+        CHECK_EQUAL(a.phase, b.phase);
+        CHECK_EQUAL(a.seed, b.seed);
+        differences += a.location.x != other.beacon(i).location.x ? 1 : 0;
+    }
+    CHECK(differences > 0);
+}
+
+TEST(sameSeedGivesTheSameStreams)
+{
+    SimulatedField field(smallLayout(), FieldProfile(), 42);
+    SimulatedUser user(field, 7, true);
+    SimulatedUser same(field, 7, true);
+    SimulatedUser other(field, 8, true);
+    size_t samples = 0;
+    size_t packets = 0;
+    size_t differentTicks = 0;
+    for (int i = 0; i < 120; i++) {
+        Tick tick = nextTick(user);
+        CHECK(sameTick(tick, nextTick(same)));
+        differentTicks += sameTick(tick, nextTick(other)) ? 0 : 1;
+        samples += tick.samples.size();
+        packets += tick.packets.size();
+    }
+    CHECK(samples > 0);
+    CHECK(packets > samples);
+    CHECK(differentTicks > 0);
+}
+
+// Users share nothing but the read-only field, so the order in which they are advanced does not change their streams.
+TEST(usersDoNotDependOnEachOther)
+{
+    SimulatedField field(smallLayout(), FieldProfile(), 42);
+    std::vector<Tick> alone;
+    SimulatedUser user(field, 7, true);
+    for (int i = 0; i < 60; i++) {
+        alone.push_back(nextTick(user));
+    }
+
+    SimulatedUser interleaved(field, 7, true);
+    SimulatedUser neighbor(field, 9, true);
+    for (int i = 0; i < 60; i++) {
+        nextTick(neighbor);
+        if (i % 3 == 0) {
+            nextTick(neighbor);
+        }
+        CHECK(sameTick(alone[size_t(i)], nextTick(interleaved)));
+    }
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
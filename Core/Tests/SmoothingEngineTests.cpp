@@ -0,0 +1,250 @@
+//
+//  SmoothingEngineTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BISmoothingEngine.h>
+
+#include "TestHarness.hpp"
+
+using namespace bi::tests;
+
+TEST(windowAverageAveragesUsableSignals)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(NULL);
+    BIBeaconSample samples[] = {beaconSample(1, -60, 1.0)};
+    BISmoothingEngineProcessTick(engine, 1.0, samples, 1);
+    samples[0] = beaconSample(1, 0, -1.0); // unknown RSSI and accuracy
+    BISmoothingEngineProcessTick(engine, 2.0, samples, 1);
+    samples[0] = beaconSample(1, -70, 3.0);
+    BISmoothingEngineProcessTick(engine, 3.0, samples, 1);
+
+    BIBeaconKey key = beaconKey(1);
+    BISignal signal;
+    CHECK(BISmoothingEngineGetSmoothedSignal(engine, &key, &signal));
+    CHECK(signal.inRange);
+    CHECK_EQUAL(3.0, signal.timestamp);
+    CHECK_EQUAL(-65, signal.RSSI);
+    CHECK_NEAR(2.0, signal.accuracy, 1e-12);
+    CHECK_EQUAL(int32_t(BIProximityNear), signal.proximity);
+    BISmoothingEngineDestroy(engine);
+}
+
+TEST(lastSampleOfATickWins)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(NULL);
+    BIBeaconSample samples[] = {beaconSample(1, -80, 5.0), beaconSample(1, -50, 0.3)};
+    BISmoothingEngineProcessTick(engine, 1.0, samples, 2);
+
+    BIBeaconKey key = beaconKey(1);
+    BISignal signal;
+    CHECK(BISmoothingEngineGetRawSignal(engine, &key, &signal));
+    CHECK_EQUAL(-50, signal.RSSI);
+    CHECK_EQUAL(1u, BISmoothingEngineCopyRawSignals(engine, &key, NULL, 0));
+    CHECK_EQUAL(1u, BISmoothingEngineGetBeaconCount(engine));
+    BISmoothingEngineDestroy(engine);
+}
+
+TEST(missingBeaconLeavesRangeAfterWindow)
+{
+    BISmoothingConfiguration configuration = BISmoothingConfigurationMakeDefault();
+    configuration.windowSize = 3;
+    configuration.windowDuration = 10.0;
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(&configuration);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    BISmoothingEngineProcessTick(engine, 1.0, &sample, 1);
+
+    BIBeaconKey key = beaconKey(1);
+    BISignal signal;
+    BISmoothingEngineProcessTick(engine, 2.0, NULL, 0);
+    BISmoothingEngineProcessTick(engine, 3.0, NULL, 0);
+    CHECK(BISmoothingEngineGetRawSignal(engine, &key, &signal));
+    CHECK(!signal.inRange);
+    CHECK(BISmoothingEngineGetSmoothedSignal(engine, &key, &signal));
+    CHECK(signal.inRange);
+    CHECK_EQUAL(-60, signal.RSSI);
+
+    BISmoothingEngineProcessTick(engine, 4.0, NULL, 0);
+    CHECK(BISmoothingEngineGetSmoothedSignal(engine, &key, &signal));
+    CHECK(!signal.inRange);
+    CHECK_EQUAL(4u, BISmoothingEngineCopySmoothedSignals(engine, &key, NULL, 0));
+    BISmoothingEngineDestroy(engine);
+}
+
+TEST(changedHandlesListOnlyChangedBeacons)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(NULL);
+    BIBeaconSample samples[] = {beaconSample(1, -60, 1.0), beaconSample(2, -70, 2.0)};
+    BISmoothingEngineProcessTick(engine, 1.0, samples, 2);
+    CHECK_EQUAL(2u, BISmoothingEngineCopyChangedHandles(engine, NULL, 0));
+
+    // The same signals again leave both averages unchanged; a weaker signal of beacon 2 changes its average.
+    samples[1].RSSI = -80;
+    BISmoothingEngineProcessTick(engine, 2.0, samples, 2);
+    BIBeaconHandle handles[2];
+    CHECK_EQUAL(1u, BISmoothingEngineCopyChangedHandles(engine, handles, 2));
+    BIBeaconKey key = beaconKey(2);
+    BIBeaconHandle handle = BISmoothingEngineGetBeaconHandleAtIndex(engine, 1);
+    CHECK_EQUAL(handle, handles[0]);
+    BIBeaconKey indexedKey;
+    CHECK(BISmoothingEngineGetBeaconKeyAtIndex(engine, 1, &indexedKey));
+    CHECK(BIBeaconKeyEqual(&key, &indexedKey));
+    CHECK(!BISmoothingEngineGetBeaconKeyAtIndex(engine, 2, &indexedKey));
+    BISmoothingEngineDestroy(engine);
+}
+
+TEST(copyKeepsTheMostRecentSignals)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(NULL);
+    for (int i = 0; i < 10; i++) {
+        BIBeaconSample sample = beaconSample(1, -50 - i, 1.0);
+        BISmoothingEngineProcessTick(engine, double(i), &sample, 1);
+    }
+
+    BIBeaconKey key = beaconKey(1);
+    BISignal signals[3];
+    CHECK_EQUAL(3u, BISmoothingEngineCopyRawSignals(engine, &key, signals, 3));
+    CHECK_EQUAL(-57, signals[0].RSSI);
+    CHECK_EQUAL(-59, signals[2].RSSI);
+    CHECK_EQUAL(9.0, signals[2].timestamp);
+    BISmoothingEngineDestroy(engine);
+}
+
+TEST(restoredSampleSeedsTheFilter)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(NULL);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    CHECK(BISmoothingEngineRestoreSample(engine, 0.0, &sample) != BIBeaconHandleInvalid);
+    CHECK_EQUAL(BIBeaconHandleInvalid, BISmoothingEngineRestoreSample(engine, 0.0, &sample));
+
+    sample.RSSI = -70;
+    BISmoothingEngineProcessTick(engine, 1.0, &sample, 1);
+    BIBeaconKey key = beaconKey(1);
+    BISignal signal;
+    CHECK(BISmoothingEngineGetSmoothedSignal(engine, &key, &signal));
+    CHECK_EQUAL(-65, signal.RSSI);
+    BISmoothingEngineDestroy(engine);
+}
+
+// Histories keep RSSIs in 16 bits and proximities in 8 bits; values that do not fit are clamped instead of wrapping.
+TEST(outOfRangeValuesAreClamped)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(NULL);
+    BIBeaconSample samples[] = {beaconSample(1, -40000, 1.0), beaconSample(2, 70000, 1.0)};
+    samples[0].proximity = 300;
+    samples[1].proximity = -300;
+    BISmoothingEngineProcessTick(engine, 1.0, samples, 2);
+
+    BIBeaconKey key = beaconKey(1);
+    BISignal signal;
+    REQUIRE(BISmoothingEngineGetRawSignal(engine, &key, &signal));
+    CHECK_EQUAL(-32768, signal.RSSI);
+    CHECK_EQUAL(127, signal.proximity);
+    key = beaconKey(2);
+    REQUIRE(BISmoothingEngineGetRawSignal(engine, &key, &signal));
+    CHECK_EQUAL(32767, signal.RSSI);
+    CHECK_EQUAL(-128, signal.proximity);
+    BISmoothingEngineDestroy(engine);
+}
+
+namespace {
+
+BISmoothingEngineRef createEngine(BISmoothingFilter filter)
+{
+    BISmoothingConfiguration configuration = BISmoothingConfigurationMakeDefault();
+    configuration.filter = filter;
+    return BISmoothingEngineCreate(&configuration);
+}
+
+BISignal smoothedSignal(BISmoothingEngineRef engine, uint16_t minor)
+{
+    BIBeaconKey key = beaconKey(minor);
+    BISignal signal = BISignalMakeNotInRange(0.0);
+    BISmoothingEngineGetSmoothedSignal(engine, &key, &signal);
+    return signal;
+}
+
+} // namespace
+
+TEST(EWMAHalvesTheWeightPerHalfLife)
+{
+    BISmoothingEngineRef engine = createEngine(BISmoothingFilterEWMA);
+    BIBeaconSample sample = beaconSample(1, -60, 1.0);
+    BISmoothingEngineProcessTick(engine, 0.0, &sample, 1);
+    sample = beaconSample(1, -80, 100.0);
+    BISmoothingEngineProcessTick(engine, 2.0, &sample, 1);
+    // Accuracies are averaged in decibels: halfway between 0 dB and 40 dB.
+    BISignal signal = smoothedSignal(engine, 1);
+    CHECK_EQUAL(-70, signal.RSSI);
+    CHECK_NEAR(10.0, signal.accuracy, 1e-9);
+
+    sample = beaconSample(1, 0, -1.0);
+    BISmoothingEngineProcessTick(engine, 3.0, &sample, 1);
+    CHECK_EQUAL(-70, smoothedSignal(engine, 1).RSSI);
+    BISmoothingEngineDestroy(engine);
+}
+
+TEST(medianIgnoresOutliers)
+{
+    BISmoothingEngineRef engine = createEngine(BISmoothingFilterMedian);
+    const int32_t RSSIs[] = {-60, -62, -20, -61, -60, 0};
+    const double accuracies[] = {1.0, 1.5, 0.1, 1.2, -1.0, 2.0};
+    for (int i = 0; i < 6; i++) {
+        BIBeaconSample sample = beaconSample(1, RSSIs[i], 1.0);
+        sample.accuracy = accuracies[i];
+        BISmoothingEngineProcessTick(engine, double(i), &sample, 1);
+    }
+    // The window holds the last five ticks; the unknown RSSI does not count, and neither does the unknown accuracy.
+    BISignal signal = smoothedSignal(engine, 1);
+    CHECK_EQUAL(-61, signal.RSSI);
+    CHECK_NEAR(1.2, signal.accuracy, 1e-12);
+    BISmoothingEngineDestroy(engine);
+}
+
+TEST(KalmanFollowsAnApproachWithLessLag)
+{
+    BISmoothingEngineRef kalman = createEngine(BISmoothingFilterKalman);
+    BISmoothingEngineRef average = createEngine(BISmoothingFilterWindowAverage);
+    for (int i = 0; i <= 20; i++) {
+        BIBeaconSample sample = beaconSample(1, -80 + i, 1.0);
+        BISmoothingEngineProcessTick(kalman, double(i), &sample, 1);
+        BISmoothingEngineProcessTick(average, double(i), &sample, 1);
+    }
+    CHECK_EQUAL(-62, smoothedSignal(average, 1).RSSI);
+    CHECK(smoothedSignal(kalman, 1).RSSI > -62);
+    CHECK(smoothedSignal(kalman, 1).RSSI <= -59);
+    BISmoothingEngineDestroy(average);
+    BISmoothingEngineDestroy(kalman);
+}
+
+TEST(everyFilterLeavesRangeAfterTheWindowDuration)
+{
+    for (BISmoothingFilter filter : {BISmoothingFilterWindowAverage, BISmoothingFilterEWMA, BISmoothingFilterKalman,
+                                     BISmoothingFilterMedian}) {
+        BISmoothingConfiguration configuration = BISmoothingConfigurationMakeDefault();
+        configuration.filter = filter;
+        configuration.windowSize = 100;
+        configuration.windowDuration = 3.0;
+        BISmoothingEngineRef engine = BISmoothingEngineCreate(&configuration);
+        BIBeaconSample sample = beaconSample(1, -60, 1.0);
+        BISmoothingEngineProcessTick(engine, 1.0, &sample, 1);
+        BISmoothingEngineProcessTick(engine, 4.0, NULL, 0);
+        CHECK(smoothedSignal(engine, 1).inRange);
+        CHECK_EQUAL(-60, smoothedSignal(engine, 1).RSSI);
+        BISmoothingEngineProcessTick(engine, 4.5, NULL, 0);
+        CHECK(!smoothedSignal(engine, 1).inRange);
+
+        // A beacon coming back starts over instead of being blended with its old signal.
+        sample.RSSI = -80;
+        BISmoothingEngineProcessTick(engine, 5.0, &sample, 1);
+        CHECK_EQUAL(-80, smoothedSignal(engine, 1).RSSI);
+        BISmoothingEngineDestroy(engine);
+    }
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
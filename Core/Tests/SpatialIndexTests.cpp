@@ -0,0 +1,153 @@
+//
+//  SpatialIndexTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BISpatialIndex.h>
+
+#include "TestHarness.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+BIBeaconLocation location(uint16_t minor, double x, double y, int32_t floor = 0)
+{
+    BIBeaconLocation location;
+    location.key = beaconKey(minor, uint16_t(floor + 100));
+    location.x = x;
+    location.y = y;
+    location.floor = floor;
+    return location;
+}
+
+// Beacons scattered over three floors, denser in one corner so that cells hold very different numbers of beacons.
+std::vector<BIBeaconLocation> venue(size_t count)
+{
+    std::vector<BIBeaconLocation> beacons;
+    uint32_t state = 11;
+    for (size_t i = 0; i < count; i++) {
+        state = state * 1664525u + 1013904223u;
+        double x = double(state >> 16) / 65536.0 * 200.0;
+        state = state * 1664525u + 1013904223u;
+        double y = double(state >> 16) / 65536.0 * 120.0;
+        if (i % 3 == 0) {
+            x /= 10.0;
+            y /= 10.0;
+        }
+        beacons.push_back(location(uint16_t(i), x, y, int32_t(i % 3) - 1));
+    }
+    return beacons;
+}
+
+// The distances of the beacons on a floor to a point, nearest first.
+std::vector<double> distances(const std::vector<BIBeaconLocation> &beacons, int32_t floor, double x, double y)
+{
+    std::vector<double> distances;
+    for (const BIBeaconLocation &beacon : beacons) {
+        if (beacon.floor == floor) {
+            distances.push_back(std::hypot(beacon.x - x, beacon.y - y));
+        }
+    }
+    std::sort(distances.begin(), distances.end());
+    return distances;
+}
+
+void checkQueries(BISpatialIndexRef index, const std::vector<BIBeaconLocation> &beacons)
+{
+    const double points[][2] = {{0.0, 0.0}, {5.0, 7.0}, {100.0, 60.0}, {199.0, 1.0}, {-50.0, 300.0}};
+    for (int32_t floor = -1; floor <= 1; floor++) {
+        for (const double *point : points) {
+            std::vector<double> expected = distances(beacons, floor, point[0], point[1]);
+
+            std::vector<BISpatialMatch> matches(8);
+            size_t count = BISpatialIndexFindNearest(index, floor, point[0], point[1], matches.size(), matches.data());
+            REQUIRE(count == std::min(matches.size(), expected.size()));
+            for (size_t i = 0; i < count; i++) {
+                CHECK_NEAR(expected[i], matches[i].distance, 1e-9);
+                CHECK_EQUAL(floor, matches[i].location.floor);
+            }
+
+            const double radius = 15.0;
+            size_t within = size_t(std::upper_bound(expected.begin(), expected.end(), radius) - expected.begin());
+            CHECK_EQUAL(within, BISpatialIndexFindWithinRadius(index, floor, point[0], point[1], radius, NULL, 0));
+            matches.resize(within);
+            CHECK_EQUAL(within, BISpatialIndexFindWithinRadius(index, floor, point[0], point[1], radius,
+                                                               matches.data(), matches.size()));
+            for (const BISpatialMatch &match : matches) {
+                CHECK(match.distance <= radius);
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST(queriesMatchABruteForceSearch)
+{
+    std::vector<BIBeaconLocation> beacons = venue(600);
+    BISpatialIndexRef index = BISpatialIndexCreate(NULL, beacons.data(), beacons.size());
+    CHECK_EQUAL(beacons.size(), BISpatialIndexGetCount(index));
+    CHECK(BISpatialIndexGetStorageSize(index) >= beacons.size() * sizeof(BIBeaconLocation));
+    checkQueries(index, beacons);
+    BISpatialIndexDestroy(index);
+
+    // Tiny and huge cells alike.
+    for (double cellSize : {0.01, 4.0, 1000.0}) {
+        BISpatialIndexConfiguration configuration = BISpatialIndexConfigurationMakeDefault();
+        configuration.cellSize = cellSize;
+        index = BISpatialIndexCreate(&configuration, beacons.data(), beacons.size());
+        checkQueries(index, beacons);
+        BISpatialIndexDestroy(index);
+    }
+}
+
+TEST(beaconsAreFoundByTheirKey)
+{
+    std::vector<BIBeaconLocation> beacons = {location(1, 0.0, 0.0), location(2, 5.0, 5.0), location(1, 3.0, 4.0, 2)};
+    beacons[2].key = beacons[0].key; // moved to another floor
+    BISpatialIndexRef index = BISpatialIndexCreate(NULL, beacons.data(), beacons.size());
+    CHECK_EQUAL(2u, BISpatialIndexGetCount(index));
+
+    BIBeaconLocation found;
+    REQUIRE(BISpatialIndexGetLocation(index, &beacons[0].key, &found));
+    CHECK_EQUAL(2, found.floor);
+    CHECK_EQUAL(3.0, found.x);
+    BISpatialMatch match;
+    CHECK_EQUAL(0u, BISpatialIndexFindWithinRadius(index, 0, 0.0, 0.0, 1.0, &match, 1));
+    REQUIRE(BISpatialIndexGetLocation(index, &beacons[1].key, &found));
+    CHECK_EQUAL(5.0, found.y);
+    BIBeaconKey missing = beaconKey(3);
+    CHECK(!BISpatialIndexGetLocation(index, &missing, &found));
+    BISpatialIndexDestroy(index);
+}
+
+TEST(degenerateMapsAreHandled)
+{
+    BISpatialIndexRef index = BISpatialIndexCreate(NULL, NULL, 0);
+    BISpatialMatch matches[4];
+    CHECK_EQUAL(0u, BISpatialIndexGetCount(index));
+    CHECK_EQUAL(0u, BISpatialIndexFindNearest(index, 0, 0.0, 0.0, 4, matches));
+    CHECK_EQUAL(0u, BISpatialIndexFindWithinRadius(index, 0, 0.0, 0.0, 10.0, matches, 4));
+    BISpatialIndexDestroy(index);
+
+    // All beacons at one point: the floor's bounding box is empty.
+    std::vector<BIBeaconLocation> beacons = {location(1, 2.0, 2.0), location(2, 2.0, 2.0), location(3, 2.0, 2.0)};
+    index = BISpatialIndexCreate(NULL, beacons.data(), beacons.size());
+    CHECK_EQUAL(3u, BISpatialIndexFindNearest(index, 0, 2.0, 3.0, 4, matches));
+    CHECK_EQUAL(1.0, matches[2].distance);
+    CHECK_EQUAL(3u, BISpatialIndexFindWithinRadius(index, 0, 2.0, 2.0, 0.0, matches, 4));
+    CHECK_EQUAL(0u, BISpatialIndexFindNearest(index, 1, 2.0, 2.0, 4, matches));
+    CHECK_EQUAL(0u, BISpatialIndexFindNearest(index, 0, 2.0, 2.0, 0, matches));
+    BISpatialIndexDestroy(index);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
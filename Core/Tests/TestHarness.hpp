@@ -0,0 +1,119 @@
+//
+//  TestHarness.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// A minimal test harness for the unit tests. TEST(name) defines and registers a test case, CHECK(), CHECK_EQUAL() and
+// CHECK_NEAR() report a failed expectation with its location and let the test case continue, REQUIRE() reports it and
+// returns from the test case (for expectations the rest of the test case depends on). Every test file ends with
+//
+//     int main() { return bi::tests::runAll(); }
+//
+// which runs the registered test cases in the order they are defined and exits with 1 if an expectation failed.
+
+#pragma once
+
+#include <BICore/BICoreTypes.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace bi {
+namespace tests {
+
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+inline std::vector<TestCase> &registeredTests()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int &failedExpectations()
+{
+    static int count = 0;
+    return count;
+}
+
+struct Registration {
+    Registration(const char *name, void (*run)()) { registeredTests().push_back({name, run}); }
+};
+
+inline void fail(const char *file, int line, const char *expression)
+{
+    std::fprintf(stderr, "%s:%d: expectation failed: %s\n", file, line, expression);
+    failedExpectations()++;
+}
+
+inline int runAll()
+{
+    int failedTests = 0;
+    for (const TestCase &test : registeredTests()) {
+        int failuresBefore = failedExpectations();
+        test.run();
+        bool passed = failedExpectations() == failuresBefore;
+        std::printf("%s %s\n", passed ? "[  OK  ]" : "[FAILED]", test.name);
+        std::fflush(stdout);
+        if (!passed) {
+            failedTests++;
+        }
+    }
+    std::printf("%zu tests, %d failed\n", registeredTests().size(), failedTests);
+    return failedTests == 0 ? 0 : 1;
+}
+
+// Beacons of the tests, all in one UUID and distinguished by their minor value.
+inline BIBeaconKey beaconKey(uint16_t minor, uint16_t major = 1)
+{
+    static const uint8_t UUID[16] = {0xF0, 0x01, 0x8B, 0x9B, 0x75, 0x09, 0x4C, 0x31,
+                                     0xA9, 0x05, 0x1A, 0x27, 0xD3, 0x9C, 0x00, 0x3C};
+    BIBeaconKey key;
+    std::memcpy(key.proximityUUID, UUID, sizeof(UUID));
+    key.major = major;
+    key.minor = minor;
+    return key;
+}
+
+inline BIBeaconSample beaconSample(uint16_t minor, int32_t RSSI, double accuracy)
+{
+    BIBeaconSample sample;
+    sample.key = beaconKey(minor);
+    sample.RSSI = RSSI;
+    sample.proximity = int32_t(BIProximityForAccuracy(accuracy));
+    sample.accuracy = accuracy;
+    return sample;
+}
+
+} // namespace tests
+} // namespace bi
+
+#define TEST(name)                                                                                                      \
+    static void name();                                                                                                 \
+    static bi::tests::Registration name##Registration(#name, name);                                                     \
+    static void name()
+
+#define CHECK(condition)                                                                                                \
+    do {                                                                                                                \
+        if (!(condition)) {                                                                                             \
+            bi::tests::fail(__FILE__, __LINE__, #condition);                                                            \
+        }                                                                                                               \
+    } while (0)
+
+#define REQUIRE(condition)                                                                                              \
+    do {                                                                                                                \
+        if (!(condition)) {                                                                                             \
+            bi::tests::fail(__FILE__, __LINE__, #condition);                                                            \
+            return;                                                                                                     \
+        }                                                                                                               \
+    } while (0)
+
+#define CHECK_EQUAL(expected, actual) CHECK((expected) == (actual))
+
+#define CHECK_NEAR(expected, actual, tolerance) CHECK(std::fabs(double(expected) - double(actual)) <= (tolerance))
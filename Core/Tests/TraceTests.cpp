@@ -0,0 +1,162 @@
+//
+//  TraceTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BITrace.h>
+
+#include "TestHarness.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+const char *const tracePath = "TraceTests.trace";
+
+std::vector<BITraceRecordType> readTypes(std::vector<BIBeaconSample> *samples = NULL)
+{
+    std::vector<BITraceRecordType> types;
+    BITraceReaderRef reader = BITraceReaderCreate(tracePath);
+    if (reader == NULL) {
+        return types;
+    }
+    BITraceRecord record;
+    while (BITraceReaderNext(reader, &record)) {
+        types.push_back(record.type);
+        if (samples != NULL && record.type == BITraceRecordRanging) {
+            samples->insert(samples->end(), record.samples, record.samples + record.sampleCount);
+        }
+    }
+    CHECK(BITraceReaderGetError(reader) == NULL);
+    BITraceReaderDestroy(reader);
+    return types;
+}
+
+void writeBytes(const std::vector<uint8_t> &bytes)
+{
+    FILE *file = std::fopen(tracePath, "wb");
+    std::fwrite("BITRACE\1", 1, 8, file);
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+}
+
+} // namespace
+
+TEST(recordsReadBackInOrder)
+{
+    BITraceRecorderRef recorder = BITraceRecorderCreate(tracePath, NULL);
+    REQUIRE(recorder != NULL);
+    BITraceRecorderRecordRegionDefinition(recorder, 1, 10.0, "Lobby");
+    BIBeaconSample samples[] = {beaconSample(1, -60, 1.25), beaconSample(2, -90, 12.0)};
+    BITraceRecorderRecordRanging(recorder, 1, 10.5, samples, 2);
+    BITraceRecorderRecordRegionEvent(recorder, 1, 11.0, BIRegionEventEnter);
+    BITraceRecorderRecordBluetoothState(recorder, 12.0, BIBluetoothStatePoweredOff);
+    BITraceRecorderDestroy(recorder);
+
+    BITraceReaderRef reader = BITraceReaderCreate(tracePath);
+    REQUIRE(reader != NULL);
+    BITraceRecord record;
+    REQUIRE(BITraceReaderNext(reader, &record));
+    CHECK_EQUAL(BITraceRecordRegionDefinition, record.type);
+    CHECK_EQUAL(10.0, record.timestamp);
+    REQUIRE(BITraceReaderNext(reader, &record));
+    CHECK_EQUAL(BITraceRecordBeaconDefinition, record.type);
+    REQUIRE(BITraceReaderNext(reader, &record));
+    CHECK_EQUAL(BITraceRecordBeaconDefinition, record.type);
+    REQUIRE(BITraceReaderNext(reader, &record));
+    CHECK_EQUAL(BITraceRecordRanging, record.type);
+    CHECK_EQUAL(10.5, record.timestamp);
+    REQUIRE(record.sampleCount == 2);
+    CHECK_EQUAL(2, record.samples[1].key.minor);
+    CHECK_EQUAL(-90, record.samples[1].RSSI);
+    CHECK_EQUAL(12.0, record.samples[1].accuracy);
+    REQUIRE(BITraceReaderNext(reader, &record));
+    CHECK_EQUAL(BIRegionEventEnter, record.regionEvent);
+    REQUIRE(BITraceReaderNext(reader, &record));
+    CHECK_EQUAL(BIBluetoothStatePoweredOff, record.bluetoothState);
+    CHECK(!BITraceReaderNext(reader, &record));
+    CHECK(BITraceReaderGetError(reader) == NULL);
+    BITraceReaderDestroy(reader);
+    std::remove(tracePath);
+}
+
+// A recorder that sees many different beacons restarts the numbering instead of remembering all of them.
+TEST(beaconNumbersAreResetAtTheLimit)
+{
+    BITraceRecorderConfiguration configuration = BITraceRecorderConfigurationMakeDefault();
+    configuration.maximumBeacons = 4;
+    BITraceRecorderRef recorder = BITraceRecorderCreate(tracePath, &configuration);
+    REQUIRE(recorder != NULL);
+    for (uint16_t minor = 1; minor <= 10; minor++) {
+        BIBeaconSample samples[] = {beaconSample(minor, -60, 1.0), beaconSample(1, -70, 2.0)};
+        BITraceRecorderRecordRanging(recorder, 1, double(minor), samples, 2);
+    }
+    BITraceRecorderDestroy(recorder);
+
+    std::vector<BIBeaconSample> samples;
+    std::vector<BITraceRecordType> types = readTypes(&samples);
+    size_t resets = 0;
+    size_t definitions = 0;
+    size_t definedSinceReset = 0;
+    for (BITraceRecordType type : types) {
+        if (type == BITraceRecordBeaconReset) {
+            resets++;
+            definedSinceReset = 0;
+        } else if (type == BITraceRecordBeaconDefinition) {
+            definitions++;
+            definedSinceReset++;
+            CHECK(definedSinceReset <= 5);
+        }
+    }
+    CHECK(resets >= 2);
+    CHECK(definitions > 10);
+    REQUIRE(samples.size() == 20);
+    for (size_t i = 0; i < samples.size(); i += 2) {
+        CHECK_EQUAL(uint16_t(i / 2 + 1), samples[i].key.minor);
+        CHECK_EQUAL(1, samples[i + 1].key.minor);
+        CHECK_EQUAL(-70, samples[i + 1].RSSI);
+    }
+    std::remove(tracePath);
+}
+
+// Two Bluetooth state records (type 5) whose time deltas (INT64_MAX microseconds each) add up beyond 64 bits.
+TEST(timestampOverflowFailsTheRead)
+{
+    std::vector<uint8_t> bluetoothState = {5, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 5};
+    std::vector<uint8_t> bytes = bluetoothState;
+    bytes.insert(bytes.end(), bluetoothState.begin(), bluetoothState.end());
+    writeBytes(bytes);
+
+    BITraceReaderRef reader = BITraceReaderCreate(tracePath);
+    REQUIRE(reader != NULL);
+    BITraceRecord record;
+    CHECK(!BITraceReaderNext(reader, &record));
+    REQUIRE(BITraceReaderGetError(reader) != NULL);
+    CHECK(std::strcmp(BITraceReaderGetError(reader), "timestamp out of range") == 0);
+    BITraceReaderDestroy(reader);
+    std::remove(tracePath);
+}
+
+TEST(truncatedRecordIsReported)
+{
+    writeBytes({5, 0x80});
+    BITraceReaderRef reader = BITraceReaderCreate(tracePath);
+    REQUIRE(reader != NULL);
+    BITraceRecord record;
+    CHECK(!BITraceReaderNext(reader, &record));
+    REQUIRE(BITraceReaderGetError(reader) != NULL);
+    CHECK(std::strcmp(BITraceReaderGetError(reader), "truncated record") == 0);
+    BITraceReaderDestroy(reader);
+    std::remove(tracePath);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
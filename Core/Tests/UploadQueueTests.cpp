@@ -0,0 +1,240 @@
+//
+//  UploadQueueTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIUploadQueue.h>
+
+#include "TestHarness.hpp"
+
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace bi::tests;
+
+namespace {
+
+const char *const queuePath = "UploadQueueTests.queue";
+
+void removeQueue()
+{
+    if (DIR *directory = opendir(queuePath)) {
+        while (struct dirent *entry = readdir(directory)) {
+            if (entry->d_name[0] != '.') {
+                unlink((std::string(queuePath) + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(directory);
+    }
+    rmdir(queuePath);
+}
+
+struct Backend {
+    std::vector<std::vector<uint8_t>> requests;
+
+    BIUploadKind kind(size_t request) const
+    {
+        return BIUploadGetKind(requests[request].data(), requests[request].size());
+    }
+
+    uint64_t sequenceNumber(size_t request) const
+    {
+        BIUploadReaderRef reader = BIUploadReaderCreate();
+        bool opened = BIUploadReaderOpen(reader, requests[request].data(), requests[request].size());
+        uint64_t sequenceNumber = opened ? BIUploadReaderGetInfo(reader).sequenceNumber : UINT64_MAX;
+        BIUploadReaderDestroy(reader);
+        return sequenceNumber;
+    }
+};
+
+void sendUpload(const uint8_t *bytes, size_t length, void *context)
+{
+    static_cast<Backend *>(context)->requests.emplace_back(bytes, bytes + length);
+}
+
+BIUploadQueueRef openQueue(Backend &backend, uint32_t maximumLogSize = 4 << 20)
+{
+    const uint8_t deviceID[16] = {0xD0, 1, 2, 3};
+    BIUploadQueueConfiguration configuration = BIUploadQueueConfigurationMakeDefault();
+    configuration.maximumLogSize = maximumLogSize;
+    configuration.segmentSize = 4096;
+    configuration.initialBackoff = 4.0;
+    configuration.maximumBackoff = 16.0;
+    return BIUploadQueueOpen(queuePath, &configuration, deviceID, sendUpload, &backend);
+}
+
+// A ranging tick in which beacons [first, first + count) are in range.
+void addBatch(BIUploadQueueRef queue, double timestamp, uint16_t first = 1, uint16_t count = 1)
+{
+    std::vector<BIRangedBeacon> beacons(count);
+    for (uint16_t i = 0; i < count; i++) {
+        beacons[i].key = beaconKey(uint16_t(first + i));
+        beacons[i].rawSignal = {timestamp, -60 - i, BIProximityNear, 1.5, true};
+    }
+    BIRegionRangingResult region = {};
+    region.regionID = 1;
+    region.beacons = beacons.data();
+    region.beaconCount = beacons.size();
+    BIRangingBatch batch = {0, timestamp, &region, 1};
+    BIUploadQueueAddBatch(queue, &batch);
+}
+
+} // namespace
+
+TEST(regionEventsAreSentBeforeSightings)
+{
+    removeQueue();
+    Backend backend;
+    BIUploadQueueRef queue = openQueue(backend);
+    REQUIRE(queue != NULL);
+    addBatch(queue, 0.0);
+    BIUploadQueueAddRegionEvent(queue, 1, 0.5, BIRegionEventEnter);
+    REQUIRE(BIUploadQueueFlush(queue));
+    CHECK(!BIUploadQueueFlush(queue));
+    CHECK(backend.requests.empty());
+    CHECK_EQUAL(2u, BIUploadQueueGetStatistics(queue).pendingUploads);
+
+    // One request at a time, the next one as soon as the previous one is accepted.
+    BIUploadQueueAdvance(queue, 1.0);
+    REQUIRE(backend.requests.size() == 1);
+    CHECK_EQUAL(BIUploadKindRegionEvents, backend.kind(0));
+    BIUploadQueueAdvance(queue, 2.0);
+    CHECK_EQUAL(1u, backend.requests.size());
+    BIUploadQueueDidSend(queue, 2.0, BIUploadResultAccepted);
+    REQUIRE(backend.requests.size() == 2);
+    CHECK_EQUAL(BIUploadKindSightings, backend.kind(1));
+    BIUploadQueueDidSend(queue, 2.5, BIUploadResultAccepted);
+
+    BIUploadQueueStatistics statistics = BIUploadQueueGetStatistics(queue);
+    CHECK_EQUAL(2u, statistics.appendedUploads);
+    CHECK_EQUAL(2u, statistics.acceptedUploads);
+    CHECK_EQUAL(statistics.appendedBytes, statistics.acceptedBytes);
+    CHECK_EQUAL(0u, statistics.pendingUploads);
+    BIUploadQueueClose(queue);
+    removeQueue();
+}
+
+TEST(failedRequestsAreRetriedAfterABackoff)
+{
+    removeQueue();
+    Backend backend;
+    BIUploadQueueRef queue = openQueue(backend);
+    REQUIRE(queue != NULL);
+    addBatch(queue, 0.0);
+    BIUploadQueueFlush(queue);
+    BIUploadQueueAdvance(queue, 0.0);
+    REQUIRE(backend.requests.size() == 1);
+
+    // Backoffs of 4, 8 and 16 seconds, each shortened by up to half.
+    double timestamp = 0.0;
+    for (double backoff : {4.0, 8.0, 16.0, 16.0}) {
+        size_t requests = backend.requests.size();
+        BIUploadQueueDidSend(queue, timestamp, BIUploadResultFailed);
+        BIUploadQueueAdvance(queue, timestamp + backoff / 2.0 - 0.01);
+        CHECK_EQUAL(requests, backend.requests.size());
+        timestamp += backoff;
+        BIUploadQueueAdvance(queue, timestamp);
+        CHECK_EQUAL(requests + 1, backend.requests.size());
+    }
+
+    // Nothing is sent while unreachable; becoming reachable again ends the backoff.
+    BIUploadQueueDidSend(queue, timestamp, BIUploadResultFailed);
+    BIUploadQueueSetReachable(queue, false, timestamp);
+    BIUploadQueueAdvance(queue, timestamp + 100.0);
+    CHECK_EQUAL(5u, backend.requests.size());
+    BIUploadQueueSetReachable(queue, true, timestamp + 101.0);
+    CHECK_EQUAL(6u, backend.requests.size());
+
+    BIUploadQueueDidSend(queue, timestamp + 102.0, BIUploadResultRejected);
+    BIUploadQueueStatistics statistics = BIUploadQueueGetStatistics(queue);
+    CHECK_EQUAL(6u, statistics.requests);
+    CHECK_EQUAL(5u, statistics.failedRequests);
+    CHECK_EQUAL(1u, statistics.rejectedUploads);
+    CHECK_EQUAL(0u, statistics.pendingUploads);
+    BIUploadQueueClose(queue);
+    removeQueue();
+}
+
+TEST(reopenedQueuesPickUpWhereTheyLeftOff)
+{
+    removeQueue();
+    Backend backend;
+    BIUploadQueueRef queue = openQueue(backend);
+    REQUIRE(queue != NULL);
+    for (int upload = 0; upload < 3; upload++) {
+        addBatch(queue, upload);
+        BIUploadQueueFlush(queue);
+    }
+    BIUploadQueueAdvance(queue, 10.0);
+    BIUploadQueueDidSend(queue, 10.0, BIUploadResultAccepted);
+    REQUIRE(backend.requests.size() == 2);
+    addBatch(queue, 11.0); // closing appends it
+    BIUploadQueueClose(queue);
+
+    // The request that was still being sent goes out again.
+    queue = openQueue(backend);
+    REQUIRE(queue != NULL);
+    CHECK_EQUAL(3u, BIUploadQueueGetStatistics(queue).recoveredUploads);
+    BIUploadQueueAdvance(queue, 20.0);
+    REQUIRE(backend.requests.size() == 3);
+    CHECK(backend.requests[2] == backend.requests[1]);
+    BIUploadQueueDidSend(queue, 20.0, BIUploadResultAccepted);
+    BIUploadQueueDidSend(queue, 20.0, BIUploadResultAccepted);
+    BIUploadQueueDidSend(queue, 20.0, BIUploadResultAccepted);
+
+    // The sequence numbers continue across launches.
+    addBatch(queue, 21.0);
+    BIUploadQueueFlush(queue);
+    BIUploadQueueAdvance(queue, 22.0);
+    REQUIRE(backend.requests.size() == 6);
+    for (size_t request = 2; request < 6; request++) {
+        CHECK_EQUAL(request - 1, backend.sequenceNumber(request));
+    }
+    CHECK_EQUAL(1u, BIUploadQueueGetStatistics(queue).pendingUploads);
+    BIUploadQueueDidSend(queue, 22.0, BIUploadResultAccepted);
+    CHECK_EQUAL(0u, BIUploadQueueGetStatistics(queue).pendingUploads);
+    BIUploadQueueClose(queue);
+    removeQueue();
+}
+
+TEST(fullLogsDropSightingsBeforeRegionEvents)
+{
+    removeQueue();
+    Backend backend;
+    BIUploadQueueRef queue = openQueue(backend, 8192);
+    REQUIRE(queue != NULL);
+    BIUploadQueueSetReachable(queue, false, 0.0);
+    for (int upload = 0; upload < 200; upload++) {
+        addBatch(queue, upload, uint16_t(upload), 20);
+        if (upload % 20 == 0) {
+            BIUploadQueueAddRegionEvent(queue, uint32_t(upload), upload, BIRegionEventEnter);
+        }
+        BIUploadQueueFlush(queue);
+        CHECK(BIUploadQueueGetStatistics(queue).logSize <= 8192);
+    }
+    BIUploadQueueStatistics statistics = BIUploadQueueGetStatistics(queue);
+    CHECK(statistics.droppedSightingUploads > 0);
+    CHECK_EQUAL(0u, statistics.droppedRegionEventUploads);
+    CHECK_EQUAL(statistics.appendedUploads - statistics.droppedSightingUploads, statistics.pendingUploads);
+
+    BIUploadQueueSetReachable(queue, true, 300.0);
+    for (size_t request = 0; request < statistics.pendingUploads; request++) {
+        REQUIRE(backend.requests.size() == request + 1);
+        CHECK_EQUAL(request < 10 ? BIUploadKindRegionEvents : BIUploadKindSightings, backend.kind(request));
+        BIUploadQueueDidSend(queue, 300.0, BIUploadResultAccepted);
+    }
+    // The newest sightings were kept.
+    CHECK_EQUAL(statistics.appendedUploads - 1, backend.sequenceNumber(backend.requests.size() - 1));
+    BIUploadQueueClose(queue);
+    removeQueue();
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,235 @@
+//
+//  UploadTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIUpload.h>
+
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+typedef std::vector<std::vector<uint8_t>> Uploads;
+
+void appendUpload(const uint8_t *bytes, size_t length, void *context)
+{
+    static_cast<Uploads *>(context)->emplace_back(bytes, bytes + length);
+}
+
+BIUploadEncoderRef createEncoder(Uploads &uploads, uint64_t sequenceNumber = 10, uint32_t maximumSightings = 4096,
+                                 double maximumAge = 300.0)
+{
+    const uint8_t deviceID[16] = {0xD0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    BIUploadEncoderConfiguration configuration = BIUploadEncoderConfigurationMakeDefault();
+    configuration.maximumSightings = maximumSightings;
+    configuration.maximumAge = maximumAge;
+    return BIUploadEncoderCreate(&configuration, deviceID, sequenceNumber, appendUpload, &uploads);
+}
+
+void addSample(BIUploadEncoderRef encoder, double timestamp, const BIBeaconSample &sample)
+{
+    BIUploadEncoderAddSamples(encoder, timestamp, &sample, 1);
+}
+
+BIBeaconKey otherUUIDKey(uint16_t minor)
+{
+    BIBeaconKey key = beaconKey(minor);
+    key.proximityUUID[0] ^= 0xFF;
+    return key;
+}
+
+std::vector<BIUploadSighting> readAll(BIUploadReaderRef reader, size_t chunk)
+{
+    std::vector<BIUploadSighting> sightings;
+    std::vector<BIUploadSighting> buffer(chunk);
+    while (size_t count = BIUploadReaderRead(reader, buffer.data(), buffer.size())) {
+        sightings.insert(sightings.end(), buffer.begin(), buffer.begin() + std::ptrdiff_t(count));
+    }
+    return sightings;
+}
+
+} // namespace
+
+TEST(sightingsSurviveTheRoundTrip)
+{
+    Uploads uploads;
+    BIUploadEncoderRef encoder = createEncoder(uploads);
+    BIBeaconSample samples[] = {beaconSample(5, -60, 1.234), beaconSample(3, 0, -1.0), beaconSample(7, -300, 250.0),
+                                beaconSample(5, -50, 0.4)};
+    samples[1].key.major = 2;
+    samples[2].key = otherUUIDKey(7);
+    BIUploadEncoderAddSamples(encoder, 1000.0, samples, 3);
+    addSample(encoder, 1000.0, samples[3]); // same tick: merged, the stronger RSSI wins
+    addSample(encoder, 1000.5, samples[1]);
+    CHECK(uploads.empty());
+    REQUIRE(BIUploadEncoderFlush(encoder));
+    CHECK(!BIUploadEncoderFlush(encoder));
+    REQUIRE(uploads.size() == 1);
+    CHECK_EQUAL(11u, BIUploadEncoderGetSequenceNumber(encoder));
+    BIUploadEncoderStatistics statistics = BIUploadEncoderGetStatistics(encoder);
+    CHECK_EQUAL(2u, statistics.ticks);
+    CHECK_EQUAL(4u, statistics.sightings);
+    CHECK_EQUAL(uint64_t(uploads[0].size()), statistics.bytes);
+    BIUploadEncoderDestroy(encoder);
+
+    CHECK_EQUAL(BIUploadKindSightings, BIUploadGetKind(uploads[0].data(), uploads[0].size()));
+    BIUploadReaderRef reader = BIUploadReaderCreate();
+    REQUIRE(BIUploadReaderOpen(reader, uploads[0].data(), uploads[0].size()));
+    BIUploadInfo info = BIUploadReaderGetInfo(reader);
+    CHECK_EQUAL(BIUploadKindSightings, info.kind);
+    CHECK_EQUAL(0xD0, info.deviceID[0]);
+    CHECK_EQUAL(15, info.deviceID[15]);
+    CHECK_EQUAL(10u, info.sequenceNumber);
+    CHECK_EQUAL(1000.0, info.startTime);
+    CHECK_EQUAL(1000.5, info.endTime);
+    CHECK_EQUAL(2u, info.tickCount);
+    CHECK_EQUAL(4u, info.sightingCount);
+    CHECK_EQUAL(0u, info.regionEventCount);
+
+    size_t beaconCount = 0;
+    const BIBeaconKey *beacons = BIUploadReaderGetBeacons(reader, &beaconCount);
+    REQUIRE(beaconCount == 3);
+    CHECK(BIBeaconKeyEqual(&samples[2].key, &beacons[0]));
+    CHECK(BIBeaconKeyEqual(&samples[0].key, &beacons[1]));
+    CHECK(BIBeaconKeyEqual(&samples[1].key, &beacons[2]));
+
+    // Read in chunks that do not line up with the ticks.
+    std::vector<BIUploadSighting> sightings = readAll(reader, 3);
+    REQUIRE(sightings.size() == 4);
+    CHECK_EQUAL(0u, sightings[0].beacon);
+    CHECK_EQUAL(-255, sightings[0].RSSI);
+    CHECK_EQUAL(250.0, sightings[0].accuracy);
+    CHECK_EQUAL(1u, sightings[1].beacon);
+    CHECK_EQUAL(-50, sightings[1].RSSI);
+    CHECK_EQUAL(0.4, sightings[1].accuracy);
+    CHECK_EQUAL(samples[3].proximity, sightings[1].proximity);
+    CHECK_EQUAL(2u, sightings[2].beacon);
+    CHECK_EQUAL(0, sightings[2].RSSI);
+    CHECK_EQUAL(-1.0, sightings[2].accuracy);
+    CHECK_EQUAL(1000.0, sightings[2].timestamp);
+    CHECK_EQUAL(2u, sightings[3].beacon);
+    CHECK_EQUAL(1000.5, sightings[3].timestamp);
+    CHECK(BIUploadReaderGetError(reader) == NULL);
+    BIUploadReaderDestroy(reader);
+}
+
+TEST(uploadsAreCutBySizeAgeAndTimeGoingBackwards)
+{
+    Uploads uploads;
+    BIUploadEncoderRef encoder = createEncoder(uploads, 10, 4, 30.0);
+    for (int tick = 0; tick < 10; tick++) {
+        addSample(encoder, tick, beaconSample(1, -60, 1.0));
+    }
+    // Finished at the start of the ticks at 4 and 8, never in the middle of a tick.
+    CHECK_EQUAL(2u, uploads.size());
+    BIUploadEncoderAdvance(encoder, 37.9);
+    CHECK_EQUAL(2u, uploads.size());
+    BIUploadEncoderAdvance(encoder, 38.0);
+    CHECK_EQUAL(3u, uploads.size());
+
+    addSample(encoder, 50.0, beaconSample(1, -60, 1.0));
+    addSample(encoder, 40.0, beaconSample(1, -60, 1.0));
+    CHECK_EQUAL(4u, uploads.size());
+    BIUploadEncoderFlush(encoder);
+    REQUIRE(uploads.size() == 5);
+    BIUploadEncoderDestroy(encoder);
+
+    const double startTimes[] = {0.0, 4.0, 8.0, 50.0, 40.0};
+    const uint32_t tickCounts[] = {4, 4, 2, 1, 1};
+    BIUploadReaderRef reader = BIUploadReaderCreate();
+    for (size_t i = 0; i < uploads.size(); i++) {
+        REQUIRE(BIUploadReaderOpen(reader, uploads[i].data(), uploads[i].size()));
+        BIUploadInfo info = BIUploadReaderGetInfo(reader);
+        CHECK_EQUAL(10 + i, info.sequenceNumber);
+        CHECK_EQUAL(startTimes[i], info.startTime);
+        CHECK_EQUAL(tickCounts[i], info.tickCount);
+        CHECK_EQUAL(size_t(tickCounts[i]), readAll(reader, 16).size());
+    }
+    BIUploadReaderDestroy(reader);
+}
+
+TEST(regionEventsSurviveTheRoundTrip)
+{
+    Uploads uploads;
+    BIUploadEncoderRef encoder = createEncoder(uploads);
+    BIUploadEncoderAddRegionEvent(encoder, 3, 5.0, BIRegionEventEnter);
+    addSample(encoder, 6.0, beaconSample(1, -60, 1.0));
+    BIUploadEncoderAddRegionEvent(encoder, 4000000000u, 6.25, BIRegionEventStateOutside);
+    BIUploadEncoderAdvance(encoder, 14.9);
+    CHECK(uploads.empty());
+    BIUploadEncoderAdvance(encoder, 15.0);
+    REQUIRE(uploads.size() == 1);
+    BIUploadEncoderFlush(encoder);
+    REQUIRE(uploads.size() == 2);
+    CHECK_EQUAL(2u, BIUploadEncoderGetStatistics(encoder).regionEvents);
+    BIUploadEncoderDestroy(encoder);
+
+    CHECK_EQUAL(BIUploadKindRegionEvents, BIUploadGetKind(uploads[0].data(), uploads[0].size()));
+    BIUploadReaderRef reader = BIUploadReaderCreate();
+    REQUIRE(BIUploadReaderOpen(reader, uploads[0].data(), uploads[0].size()));
+    BIUploadInfo info = BIUploadReaderGetInfo(reader);
+    CHECK_EQUAL(BIUploadKindRegionEvents, info.kind);
+    CHECK_EQUAL(10u, info.sequenceNumber);
+    CHECK_EQUAL(5.0, info.startTime);
+    CHECK_EQUAL(6.25, info.endTime);
+    CHECK_EQUAL(0u, info.sightingCount);
+    size_t count = 0;
+    const BIUploadRegionEvent *events = BIUploadReaderGetRegionEvents(reader, &count);
+    REQUIRE(count == 2);
+    CHECK_EQUAL(3u, events[0].regionID);
+    CHECK_EQUAL(BIRegionEventEnter, events[0].event);
+    CHECK_EQUAL(4000000000u, events[1].regionID);
+    CHECK_EQUAL(BIRegionEventStateOutside, events[1].event);
+    CHECK_EQUAL(6.25, events[1].timestamp);
+    CHECK_EQUAL(0u, readAll(reader, 4).size());
+
+    // Both kinds share the device's sequence numbers.
+    REQUIRE(BIUploadReaderOpen(reader, uploads[1].data(), uploads[1].size()));
+    CHECK_EQUAL(11u, BIUploadReaderGetInfo(reader).sequenceNumber);
+    BIUploadReaderDestroy(reader);
+}
+
+TEST(damagedUploadsAreRejected)
+{
+    Uploads uploads;
+    BIUploadEncoderRef encoder = createEncoder(uploads);
+    for (int tick = 0; tick < 5; tick++) {
+        BIBeaconSample samples[] = {beaconSample(1, -60, 1.0), beaconSample(uint16_t(tick + 2), -70, 3.0)};
+        BIUploadEncoderAddSamples(encoder, tick, samples, 2);
+    }
+    BIUploadEncoderFlush(encoder);
+    BIUploadEncoderDestroy(encoder);
+    REQUIRE(uploads.size() == 1);
+    const std::vector<uint8_t> &upload = uploads[0];
+
+    BIUploadReaderRef reader = BIUploadReaderCreate();
+    for (size_t length = 0; length < upload.size(); length++) {
+        std::vector<uint8_t> truncated(upload.begin(), upload.begin() + std::ptrdiff_t(length));
+        CHECK(!BIUploadReaderOpen(reader, truncated.data(), truncated.size()));
+        CHECK(BIUploadReaderGetError(reader) != NULL);
+        CHECK_EQUAL(0u, readAll(reader, 4).size());
+    }
+    for (size_t i = 0; i < upload.size(); i++) {
+        std::vector<uint8_t> damaged = upload;
+        damaged[i] ^= 0x10;
+        CHECK(!BIUploadReaderOpen(reader, damaged.data(), damaged.size()));
+    }
+    CHECK_EQUAL(BIUploadKindNone, BIUploadGetKind(upload.data() + 1, upload.size() - 1));
+
+    // The reader recovers with the next upload.
+    REQUIRE(BIUploadReaderOpen(reader, upload.data(), upload.size()));
+    CHECK_EQUAL(10u, readAll(reader, 4).size());
+    CHECK(BIUploadReaderGetError(reader) == NULL);
+    BIUploadReaderDestroy(reader);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
@@ -0,0 +1,196 @@
+//
+//  ZoneEngineTests.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+#include <BICore/BIZoneEngine.h>
+
+#include "TestHarness.hpp"
+
+#include <vector>
+
+using namespace bi::tests;
+
+namespace {
+
+struct Transition {
+    uint32_t zoneID;
+    BIZoneTransition transition;
+    double timestamp;
+};
+
+void recordTransition(uint32_t zoneID, BIZoneTransition transition, double timestamp, void *context)
+{
+    static_cast<std::vector<Transition> *>(context)->push_back({zoneID, transition, timestamp});
+}
+
+BIZoneNode beaconNode(uint16_t minor, int32_t minimumRSSI = 0, double dwellTime = 0.0)
+{
+    BIZoneNode node = {};
+    node.type = BIZoneNodeBeacon;
+    node.key = beaconKey(minor);
+    node.minimumRSSI = minimumRSSI;
+    node.maximumProximity = BIProximityUnknown;
+    node.dwellTime = dwellTime;
+    return node;
+}
+
+BIZoneNode combinationNode(BIZoneNodeType type, uint32_t childCount, uint32_t threshold = 0)
+{
+    BIZoneNode node = {};
+    node.type = type;
+    node.childCount = childCount;
+    node.threshold = threshold;
+    return node;
+}
+
+BIZoneDefinition zoneDefinition(uint32_t zoneID, const BIZoneNode *nodes, size_t nodeCount, double enterDwellTime = 0.0,
+                                double exitDwellTime = 0.0)
+{
+    return BIZoneDefinition{zoneID, nodes, nodeCount, enterDwellTime, exitDwellTime};
+}
+
+BIRangedBeacon rangedBeacon(uint16_t minor, int32_t RSSI)
+{
+    BIRangedBeacon beacon = {};
+    beacon.handle = minor;
+    beacon.key = beaconKey(minor);
+    beacon.smoothedSignal = {0.0, RSSI, int32_t(BIProximityNear), 1.0, true};
+    beacon.rawSignal = beacon.smoothedSignal;
+    return beacon;
+}
+
+} // namespace
+
+TEST(invalidDefinitionsAreRejected)
+{
+    BIZoneNode notWithTwoChildren[] = {combinationNode(BIZoneNodeNot, 2), beaconNode(1), beaconNode(2)};
+    BIZoneNode thresholdTooHigh[] = {combinationNode(BIZoneNodeAtLeast, 2, 3), beaconNode(1), beaconNode(2)};
+    BIZoneNode trailingNode[] = {beaconNode(1), beaconNode(2)};
+    BIZoneDefinition zone = zoneDefinition(1, notWithTwoChildren, 3);
+    CHECK(!BIZoneDefinitionIsValid(&zone));
+    zone = zoneDefinition(1, thresholdTooHigh, 3);
+    CHECK(!BIZoneDefinitionIsValid(&zone));
+    zone = zoneDefinition(1, trailingNode, 2);
+    CHECK(!BIZoneDefinitionIsValid(&zone));
+    zone = zoneDefinition(1, trailingNode, 1, -1.0);
+    CHECK(!BIZoneDefinitionIsValid(&zone));
+
+    BIZoneDefinition duplicates[] = {zoneDefinition(1, trailingNode, 1), zoneDefinition(1, trailingNode + 1, 1)};
+    CHECK(BIZoneEngineCreate(NULL, duplicates, 2, NULL, NULL) == NULL);
+}
+
+TEST(enterAndExitFollowTheRule)
+{
+    // A and not B, where A must be at least -70 dBm.
+    BIZoneNode nodes[] = {combinationNode(BIZoneNodeAll, 2), beaconNode(1, -70), combinationNode(BIZoneNodeNot, 1),
+                          beaconNode(2)};
+    BIZoneDefinition zone = zoneDefinition(7, nodes, 4);
+    std::vector<Transition> transitions;
+    BIZoneEngineRef engine = BIZoneEngineCreate(NULL, &zone, 1, recordTransition, &transitions);
+
+    BIRangedBeacon beacons[] = {rangedBeacon(1, -80), rangedBeacon(2, -60)};
+    BIZoneEngineUpdate(engine, 1.0, beacons, 1);
+    CHECK(transitions.empty());
+    beacons[0].smoothedSignal.RSSI = -65;
+    BIZoneEngineUpdate(engine, 2.0, beacons, 1);
+    CHECK_EQUAL(1u, transitions.size());
+    CHECK(BIZoneEngineIsInside(engine, 7));
+    BIZoneEngineUpdate(engine, 3.0, beacons, 2);
+    REQUIRE(transitions.size() == 2);
+    CHECK(!BIZoneEngineIsInside(engine, 7));
+    CHECK_EQUAL(BIZoneTransitionExit, transitions.back().transition);
+    CHECK_EQUAL(3.0, transitions.back().timestamp);
+    BIZoneEngineDestroy(engine);
+}
+
+TEST(dwellTimesDelayTransitions)
+{
+    BIZoneNode nodes[] = {beaconNode(1)};
+    BIZoneDefinition zone = zoneDefinition(1, nodes, 1, 5.0, 10.0);
+    std::vector<Transition> transitions;
+    BIZoneEngineRef engine = BIZoneEngineCreate(NULL, &zone, 1, recordTransition, &transitions);
+
+    BIRangedBeacon beacon = rangedBeacon(1, -60);
+    BIZoneEngineUpdate(engine, 1.0, &beacon, 1);
+    BIZoneEngineAdvance(engine, 5.5);
+    CHECK(transitions.empty());
+    BIZoneEngineAdvance(engine, 6.5);
+    REQUIRE(transitions.size() == 1);
+    CHECK_EQUAL(6.0, transitions[0].timestamp);
+
+    // Leaving for less than the exit dwell time does not count.
+    BIZoneEngineUpdate(engine, 7.0, NULL, 0);
+    BIZoneEngineUpdate(engine, 12.0, &beacon, 1);
+    BIZoneEngineAdvance(engine, 30.0);
+    CHECK_EQUAL(1u, transitions.size());
+    BIZoneEngineUpdate(engine, 31.0, NULL, 0);
+    BIZoneEngineAdvance(engine, 45.0);
+    REQUIRE(transitions.size() == 2);
+    CHECK_EQUAL(41.0, transitions[1].timestamp);
+
+    BIZoneEngineStatistics statistics = BIZoneEngineGetStatistics(engine);
+    CHECK_EQUAL(1u, statistics.enters);
+    CHECK_EQUAL(1u, statistics.exits);
+    BIZoneEngineDestroy(engine);
+}
+
+// A zone that holds while its beacon has never been seen is entered after its dwell time from the first call.
+TEST(notZoneEntersWithoutItsBeacon)
+{
+    BIZoneNode nodes[] = {combinationNode(BIZoneNodeNot, 1), beaconNode(1)};
+    BIZoneDefinition zones[] = {zoneDefinition(1, nodes, 2), zoneDefinition(2, nodes, 2, 3.0)};
+    std::vector<Transition> transitions;
+    BIZoneEngineRef engine = BIZoneEngineCreate(NULL, zones, 2, recordTransition, &transitions);
+
+    BIZoneEngineUpdate(engine, 10.0, NULL, 0);
+    REQUIRE(transitions.size() == 1);
+    CHECK(BIZoneEngineIsInside(engine, 1));
+    CHECK_EQUAL(10.0, transitions[0].timestamp);
+    CHECK(!BIZoneEngineIsInside(engine, 2));
+    BIZoneEngineAdvance(engine, 14.0);
+    REQUIRE(transitions.size() == 2);
+    CHECK_EQUAL(2u, transitions[1].zoneID);
+    CHECK_EQUAL(13.0, transitions[1].timestamp);
+
+    BIRangedBeacon beacon = rangedBeacon(1, -60);
+    BIZoneEngineUpdate(engine, 15.0, &beacon, 1);
+    CHECK(!BIZoneEngineIsInside(engine, 1));
+    CHECK(!BIZoneEngineIsInside(engine, 2));
+    BIZoneEngineDestroy(engine);
+}
+
+// The first tick evaluates the zones after its beacons, so a not zone whose beacon is in range right away never enters.
+TEST(notZoneStaysOutsideWhenItsBeaconIsThereFromTheStart)
+{
+    BIZoneNode nodes[] = {combinationNode(BIZoneNodeNot, 1), beaconNode(1)};
+    BIZoneDefinition zone = zoneDefinition(1, nodes, 2);
+    std::vector<Transition> transitions;
+    BIZoneEngineRef engine = BIZoneEngineCreate(NULL, &zone, 1, recordTransition, &transitions);
+
+    BIRangedBeacon beacon = rangedBeacon(1, -60);
+    BIZoneEngineUpdate(engine, 1.0, &beacon, 1);
+    CHECK(transitions.empty());
+    BIZoneEngineDestroy(engine);
+}
+
+TEST(atLeastCountsHoldingChildren)
+{
+    BIZoneNode nodes[] = {combinationNode(BIZoneNodeAtLeast, 3, 2), beaconNode(1), beaconNode(2), beaconNode(3)};
+    BIZoneDefinition zone = zoneDefinition(1, nodes, 4);
+    BIZoneEngineRef engine = BIZoneEngineCreate(NULL, &zone, 1, NULL, NULL);
+
+    BIRangedBeacon beacons[] = {rangedBeacon(1, -60), rangedBeacon(3, -60)};
+    BIZoneEngineUpdate(engine, 1.0, beacons, 1);
+    CHECK(!BIZoneEngineIsInside(engine, 1));
+    BIZoneEngineUpdate(engine, 2.0, beacons, 2);
+    CHECK(BIZoneEngineIsInside(engine, 1));
+    BIZoneEngineDestroy(engine);
+}
+
+int main()
+{
+    return bi::tests::runAll();
+}
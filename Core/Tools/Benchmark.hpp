@@ -0,0 +1,308 @@
+//
+//  Benchmark.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// A small benchmark harness after Google Benchmark, for the suite in bi-bench.cpp. A benchmark function sets up its
+// data and then runs `while (state.keepRunning())`, which times the loop. The harness raises the iteration count until
+// a run takes at least the minimum time, repeats that run and reports the median time per iteration. Results are
+// written as JSON in Google Benchmark's format (so that its compare.py reads them too) and can be read back from such
+// files to compare two sets of results.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace bi {
+namespace tools {
+
+class BenchmarkState {
+public:
+    BenchmarkState(uint64_t iterations, int64_t argument) : _iterations(iterations), _remaining(iterations), _argument(argument) {}
+
+    int64_t argument() const { return _argument; }
+    uint64_t iterations() const { return _iterations; }
+
+    // Items (beacons, packets, ...) processed per iteration, for the throughput.
+    void setItemsPerIteration(double items) { _itemsPerIteration = items; }
+    double itemsPerIteration() const { return _itemsPerIteration; }
+
+    // Starts the clocks on the first call and stops them after the last iteration.
+    bool keepRunning()
+    {
+        if (_remaining == _iterations) {
+            _startCPU = std::clock();
+            _start = std::chrono::steady_clock::now();
+        }
+        if (_remaining > 0) {
+            _remaining--;
+            return true;
+        }
+        _realTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        _CPUTime = double(std::clock() - _startCPU) / CLOCKS_PER_SEC;
+        return false;
+    }
+
+    double realTime() const { return _realTime; }
+    double CPUTime() const { return _CPUTime; }
+
+private:
+    uint64_t _iterations;
+    uint64_t _remaining;
+    int64_t _argument;
+    double _itemsPerIteration = 0.0;
+    std::chrono::steady_clock::time_point _start;
+    std::clock_t _startCPU = 0;
+    double _realTime = 0.0;
+    double _CPUTime = 0.0;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState &state);
+
+struct BenchmarkOptions {
+    double minimumTime = 0.2; // seconds per run
+    uint32_t repetitions = 3;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t iterations = 0;
+    uint32_t repetitions = 0;
+    double realTime = 0.0;  // median, in ns per iteration
+    double CPUTime = 0.0;   // median, in ns per iteration
+    double deviation = 0.0; // standard deviation of the CPU time relative to its mean
+    double itemsPerSecond = 0.0;
+};
+
+inline double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 == 1 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+inline BenchmarkResult runBenchmark(const std::string &name, BenchmarkFunction function, int64_t argument,
+                                    const BenchmarkOptions &options)
+{
+    uint64_t iterations = 1;
+    double items = 0.0;
+    while (true) {
+        BenchmarkState state(iterations, argument);
+        function(state);
+        items = state.itemsPerIteration();
+        double time = state.realTime();
+        if (time >= options.minimumTime || iterations >= 1000000000) {
+            break;
+        }
+        double factor = time > 0.0 ? std::min(std::max(1.4 * options.minimumTime / time, 1.4), 10.0) : 10.0;
+        iterations = std::min(uint64_t(std::ceil(double(iterations) * factor)), uint64_t(1000000000));
+    }
+
+    std::vector<double> realTimes;
+    std::vector<double> CPUTimes;
+    for (uint32_t i = 0; i < std::max(options.repetitions, 1u); i++) {
+        BenchmarkState state(iterations, argument);
+        function(state);
+        realTimes.push_back(1e9 * state.realTime() / double(iterations));
+        CPUTimes.push_back(1e9 * state.CPUTime() / double(iterations));
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.repetitions = uint32_t(realTimes.size());
+    result.realTime = median(realTimes);
+    result.CPUTime = median(CPUTimes);
+    double mean = 0.0;
+    double squares = 0.0;
+    for (double time : CPUTimes) {
+        mean += time / double(CPUTimes.size());
+    }
+    for (double time : CPUTimes) {
+        squares += (time - mean) * (time - mean);
+    }
+    result.deviation = mean > 0.0 ? std::sqrt(squares / double(CPUTimes.size())) / mean : 0.0;
+    result.itemsPerSecond = result.CPUTime > 0.0 ? 1e9 * items / result.CPUTime : 0.0;
+    return result;
+}
+
+inline void writeBenchmarkJSON(FILE *file, const std::vector<BenchmarkResult> &results, const char *executable,
+                               const BenchmarkOptions &options)
+{
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    std::fprintf(file, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": \"%s\",\n", date, executable);
+#if defined(NDEBUG)
+    std::fprintf(file, "    \"library_build_type\": \"release\",\n");
+#else
+    std::fprintf(file, "    \"library_build_type\": \"debug\",\n");
+#endif
+    std::fprintf(file, "    \"min_time\": %.3f,\n    \"repetitions\": %u\n  },\n  \"benchmarks\": [", options.minimumTime,
+                 options.repetitions);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &result = results[i];
+        std::fprintf(file,
+                     "%s\n    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n"
+                     "      \"repetitions\": %u,\n      \"iterations\": %llu,\n      \"real_time\": %.4f,\n"
+                     "      \"cpu_time\": %.4f,\n      \"time_unit\": \"ns\",\n      \"cv\": %.4f,\n"
+                     "      \"items_per_second\": %.6e\n    }",
+                     i > 0 ? "," : "", result.name.c_str(), result.name.c_str(), result.repetitions,
+                     (unsigned long long)result.iterations, result.realTime, result.CPUTime, result.deviation,
+                     result.itemsPerSecond);
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+}
+
+// Reads the names and CPU times (in ns) of the benchmarks in a JSON file written by writeBenchmarkJSON() or by Google
+// Benchmark. Aggregates (mean, median, ...) are skipped, repeated iterations of a benchmark are combined into their
+// median. This is not a general JSON parser: it expects the benchmarks to be flat objects.
+inline bool readBenchmarkJSON(const char *path, std::vector<BenchmarkResult> &results)
+{
+    FILE *file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t length;
+    while ((length = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, length);
+    }
+    std::fclose(file);
+
+    size_t position = text.find("\"benchmarks\"");
+    if (position == std::string::npos || (position = text.find('[', position)) == std::string::npos) {
+        return false;
+    }
+    std::vector<std::string> names;
+    std::vector<std::vector<double>> times;
+    while ((position = text.find_first_of("{]", position)) != std::string::npos && text[position] == '{') {
+        size_t end = text.find('}', position);
+        if (end == std::string::npos) {
+            return false;
+        }
+        std::string object = text.substr(position, end - position);
+        position = end + 1;
+
+        auto value = [&object](const char *key) -> std::string {
+            std::string quoted = std::string("\"") + key + "\"";
+            size_t at = object.find(quoted);
+            if (at == std::string::npos || (at = object.find(':', at + quoted.size())) == std::string::npos) {
+                return std::string();
+            }
+            at = object.find_first_not_of(" \t\r\n", at + 1);
+            if (at == std::string::npos) {
+                return std::string();
+            }
+            if (object[at] == '"') {
+                size_t close = object.find('"', at + 1);
+                return close == std::string::npos ? std::string() : object.substr(at + 1, close - at - 1);
+            }
+            return object.substr(at, object.find_first_of(",\r\n", at) - at);
+        };
+
+        if (value("run_type") == "aggregate") {
+            continue;
+        }
+        std::string name = value("name");
+        std::string time = value("cpu_time");
+        if (name.empty() || time.empty()) {
+            return false;
+        }
+        std::string unit = value("time_unit");
+        double scale = unit == "us" ? 1e3 : unit == "ms" ? 1e6 : unit == "s" ? 1e9 : 1.0;
+        size_t index = size_t(std::find(names.begin(), names.end(), name) - names.begin());
+        if (index == names.size()) {
+            names.push_back(name);
+            times.emplace_back();
+        }
+        times[index].push_back(std::strtod(time.c_str(), nullptr) * scale);
+    }
+
+    results.clear();
+    for (size_t i = 0; i < names.size(); i++) {
+        BenchmarkResult result;
+        result.name = names[i];
+        result.repetitions = uint32_t(times[i].size());
+        result.CPUTime = median(times[i]);
+        results.push_back(result);
+    }
+    return true;
+}
+
+struct BenchmarkComparison {
+    // Benchmarks whose CPU time grew by more than the threshold.
+    size_t regressions = 0;
+    // Benchmarks of the baseline that are missing from the current results.
+    size_t missing = 0;
+};
+
+// Prints the change of each benchmark in current against baseline to file. A benchmark regressed if its CPU time grew by more
+// than threshold (e.g. 0.1 for 10%). A benchmark of the baseline that current lacks is marked MISSING, or only missing if
+// allowMissing is set (e.g. because the benchmark was removed on purpose).
+inline BenchmarkComparison compareBenchmarks(FILE *file, const std::vector<BenchmarkResult> &baseline,
+                                             const std::vector<BenchmarkResult> &current, double threshold,
+                                             bool allowMissing)
+{
+    BenchmarkComparison comparison;
+    std::fprintf(file, "%-32s %14s %14s %9s\n", "benchmark", "baseline (ns)", "current (ns)", "change");
+    for (const BenchmarkResult &result : current) {
+        auto match = std::find_if(baseline.begin(), baseline.end(),
+                                  [&result](const BenchmarkResult &other) { return other.name == result.name; });
+        if (match == baseline.end() || match->CPUTime <= 0.0) {
+            std::fprintf(file, "%-32s %14s %14.1f %9s\n", result.name.c_str(), "-", result.CPUTime, "new");
+            continue;
+        }
+        double change = result.CPUTime / match->CPUTime - 1.0;
+        const char *verdict = "";
+        if (change > threshold) {
+            verdict = "  REGRESSION";
+            comparison.regressions++;
+        } else if (change < -threshold) {
+            verdict = "  improved";
+        }
+        std::fprintf(file, "%-32s %14.1f %14.1f %+8.1f%%%s\n", result.name.c_str(), match->CPUTime, result.CPUTime,
+                    100.0 * change, verdict);
+    }
+    for (const BenchmarkResult &result : baseline) {
+        auto match = std::find_if(current.begin(), current.end(),
+                                  [&result](const BenchmarkResult &other) { return other.name == result.name; });
+        if (match == current.end()) {
+            std::fprintf(file, "%-32s %14.1f %14s %9s\n", result.name.c_str(), result.CPUTime, "-",
+                         allowMissing ? "missing" : "MISSING");
+            comparison.missing++;
+        }
+    }
+    return comparison;
+}
+
+// Prints the summary line of a comparison.
+//
+// @return Whether the comparison failed: a benchmark regressed, or one is missing and allowMissing is not set.
+inline bool reportBenchmarkComparison(FILE *file, const BenchmarkComparison &comparison, double threshold,
+                                      bool allowMissing)
+{
+    std::fprintf(file, "\n%zu regression%s beyond %.0f%%", comparison.regressions,
+                 comparison.regressions == 1 ? "" : "s", 100.0 * threshold);
+    if (comparison.missing > 0) {
+        std::fprintf(file, ", %zu benchmark%s missing%s", comparison.missing, comparison.missing == 1 ? "" : "s",
+                     allowMissing ? " (allowed)" : "");
+    }
+    std::fprintf(file, "\n");
+    return comparison.regressions > 0 || (comparison.missing > 0 && !allowMissing);
+}
+
+} // namespace tools
+} // namespace bi
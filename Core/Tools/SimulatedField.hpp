@@ -0,0 +1,434 @@
+//
+//  SimulatedField.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// A deterministic beacon field for load and regression runs: a venue with beacons on a grid on every floor, each with
+// a TX power level and an advertising interval as BIBeaconProvisioner writes them, and virtual users walking through
+// it. A user hears the advertisements of the beacons around it through a log-distance path loss model with shadowing
+// that changes as the user moves, multipath fading per packet, loss through floors and dropouts (lost packets, the body
+// of the user blocking a beacon for a while, seconds in which the phone receives nothing at all). From the packets it
+// hears, a user produces what a phone reports: the raw advertisements with their RSSI as Core Bluetooth delivers them,
+// and once per second the ranging samples of CLLocationManager, with the RSSI averaged over the packets of that second
+// and an RSSI of 0 for beacons that were heard within the last few seconds but not in this one.
+//
+// A user only depends on the field and its own seed, so users can be spread over any number of threads and still
+// produce exactly the same streams.
+
+#pragma once
+
+#include <BICore/BIDeviceScanner.h>
+#include <BICore/BIDistanceEstimation.h>
+#include <BICore/BISpatialIndex.h>
+
+#include "SyntheticAdvertisements.hpp"
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace bi {
+namespace tools {
+
+struct FieldLayout {
+    uint32_t beaconCount = 10000;
+    int32_t floorCount = 4;
+    double spacing = 6.0;      // grid spacing (m) of the beacons, each moved by up to a quarter of it
+    double floorHeight = 4.0;  // height (m) of a floor
+    double mountHeight = 1.5;  // height (m) of the beacons above the phones
+};
+
+struct FieldProfile {
+    double pathLossExponent = 3.5; // a venue full of shelves and people
+    double shadowing = 4.0;        // standard deviation (dB) of the shadowing of a beacon
+    double decorrelation = 5.0;    // distance (m) after which the shadowing has changed by 63%
+    double fading = 4.0;           // standard deviation (dB) of the multipath fading of a packet
+    double floorLoss = 18.0;       // attenuation (dB) per floor between beacon and user
+    double packetLoss = 0.1;       // probability that a packet is lost (collisions, gaps between scan windows)
+    double blocking = 0.05;        // probability per second that the body of the user starts blocking a beacon
+    double unblocking = 0.25;      // probability per second that a blocked beacon becomes visible again
+    double bodyLoss = 10.0;        // attenuation (dB) of a blocked beacon
+    double scanGap = 0.01;         // probability that the phone receives nothing for a second
+    double sensitivity = -95.0;    // weakest RSSI (dBm) the phone receives
+    double rangingMemory = 3.0;    // time (s) Core Location keeps reporting a beacon it no longer hears
+    double walkingSpeed = 1.2;     // average speed (m/s) of the users
+    double standingTime = 20.0;    // average time (s) a user stands at a spot
+    double floorChange = 0.1;      // probability that a user takes the stairs after standing
+};
+
+struct SimulatedBeacon {
+    BIBeaconLocation location;
+    uint8_t TXPowerLevel;         // 0 == -23 dBm, 1 == -6 dBm, 2 == 0 dBm
+    uint16_t advertisingInterval; // in steps of 0.625 ms
+    int32_t TXPower;              // dBm
+    int32_t measuredPower;        // RSSI (dBm) at 1 m, as advertised
+    double period;                // average time (s) between two advertising events
+    double phase;                 // time (s) of the first advertising event
+    double audibleRadius;         // distance (m) beyond which no packet is received on the same floor
+    uint64_t seed;
+};
+
+struct SimulatedPacket {
+    double timestamp;
+    uint32_t beacon;
+    int32_t RSSI;
+};
+
+// The beacons of a venue. Beacon i is syntheticBeaconKey(i); beacons are numbered floor by floor, row by row, so that
+// the beacons of one major cover one part of a floor. Read-only after construction and shared by all users.
+class SimulatedField {
+public:
+    SimulatedField(const FieldLayout &layout, const FieldProfile &profile, uint64_t seed)
+        : _layout(layout), _profile(profile)
+    {
+        static const int32_t TXPowers[3] = {-23, -6, 0};
+        static const uint16_t advertisingIntervals[4] = {160, 400, 800, 1600};
+
+        SplitMix64 random(seed);
+        uint32_t perFloor = (layout.beaconCount + uint32_t(layout.floorCount) - 1) / uint32_t(layout.floorCount);
+        uint32_t columns = std::max(uint32_t(std::ceil(std::sqrt(double(perFloor)))), 1u);
+        _width = layout.spacing * double(columns);
+        _length = layout.spacing * double((perFloor + columns - 1) / columns);
+        double referenceLoss = BIDistanceModelMakeDefault().referenceLoss;
+
+        _beacons.reserve(layout.beaconCount);
+        std::vector<BIBeaconLocation> locations;
+        locations.reserve(layout.beaconCount);
+        for (uint32_t i = 0; i < layout.beaconCount; i++) {
+            SimulatedBeacon beacon;
+            uint32_t cell = i % perFloor;
+            beacon.location.key = syntheticBeaconKey(i);
+            beacon.location.floor = int32_t(i / perFloor);
+            beacon.location.x = layout.spacing * (double(cell % columns) + 0.5 + 0.5 * (random.uniform() - 0.5));
+            beacon.location.y = layout.spacing * (double(cell / columns) + 0.5 + 0.5 * (random.uniform() - 0.5));
+
+            // Most venues turn the power down to save battery, a few turn it down further where beacons are dense.
+            double power = random.uniform();
+            beacon.TXPowerLevel = power < 0.2 ? 0 : power < 0.8 ? 1 : 2;
+            beacon.advertisingInterval = advertisingIntervals[random.next() % 4];
+            beacon.TXPower = TXPowers[beacon.TXPowerLevel];
+            beacon.measuredPower = int32_t(std::lround(double(beacon.TXPower) + referenceLoss));
+
+            // Every advertising event is delayed by a random 0-10 ms (advDelay in the Bluetooth specification).
+            beacon.period = 0.000625 * double(beacon.advertisingInterval) + 0.005;
+            beacon.phase = beacon.period * random.uniform();
+
+            // Two standard deviations of shadowing above the median, packets still get through.
+            double margin = double(beacon.measuredPower) - profile.sensitivity + 2.0 * profile.shadowing;
+            beacon.audibleRadius = std::pow(10.0, margin / (10.0 * profile.pathLossExponent));
+            beacon.seed = random.next();
+            _maximumRadius = std::max(_maximumRadius, beacon.audibleRadius);
+
+            _beacons.push_back(beacon);
+            locations.push_back(beacon.location);
+            _payloads.push_back(iBeaconPacket(beacon.location.key, int8_t(beacon.measuredPower)));
+        }
+        _index = BISpatialIndexCreate(nullptr, locations.data(), locations.size());
+    }
+
+    ~SimulatedField() { BISpatialIndexDestroy(_index); }
+
+    SimulatedField(const SimulatedField &) = delete;
+    SimulatedField &operator=(const SimulatedField &) = delete;
+
+    const FieldLayout &layout() const { return _layout; }
+    const FieldProfile &profile() const { return _profile; }
+    BISpatialIndexRef index() const { return _index; }
+    double width() const { return _width; }
+    double length() const { return _length; }
+    double maximumRadius() const { return _maximumRadius; }
+
+    size_t beaconCount() const { return _beacons.size(); }
+    const SimulatedBeacon &beacon(uint32_t index) const { return _beacons[index]; }
+
+    // The advertising payload (AD structures) of a beacon.
+    const Packet &payload(uint32_t index) const { return _payloads[index]; }
+
+    // The Bluetooth device address of a beacon, as BIDeviceScanner identifies devices on Linux.
+    static BIPeripheralIdentifier identifier(uint32_t index)
+    {
+        BIPeripheralIdentifier identifier = {{0xC4, 0xB1, 0x00, uint8_t(index >> 16), uint8_t(index >> 8), uint8_t(index)}};
+        return identifier;
+    }
+
+    // The first advertising event of a beacon that may happen at or after timestamp.
+    uint64_t firstEvent(uint32_t index, double timestamp) const
+    {
+        const SimulatedBeacon &beacon = _beacons[index];
+        double event = std::floor((timestamp - beacon.phase) / beacon.period);
+        return event > 0.0 ? uint64_t(event) : 0;
+    }
+
+    // The time of an advertising event. The same for all users, so that they hear the same packets.
+    double eventTime(uint32_t index, uint64_t event) const
+    {
+        const SimulatedBeacon &beacon = _beacons[index];
+        double delay = SplitMix64(beacon.seed + event).uniform() * 0.01 - 0.005;
+        return beacon.phase + double(event) * beacon.period + delay;
+    }
+
+private:
+    FieldLayout _layout;
+    FieldProfile _profile;
+    std::vector<SimulatedBeacon> _beacons;
+    std::vector<Packet> _payloads;
+    BISpatialIndexRef _index = nullptr;
+    double _width = 0.0;
+    double _length = 0.0;
+    double _maximumRadius = 0.0;
+};
+
+// A user walking through a field with a phone: to a random spot on its floor, stands there for a while, sometimes
+// takes the stairs, and moves on. Keeps the state of the beacons it can hear, which is all the memory it needs.
+class SimulatedUser {
+public:
+    SimulatedUser(const SimulatedField &field, uint64_t seed, bool recordPackets = false)
+        : _field(field), _random(SplitMix64(seed).next()), _recordPackets(recordPackets)
+    {
+        const FieldProfile &profile = field.profile();
+        _floor = int32_t(_random.next() % uint64_t(field.layout().floorCount));
+        _x = _targetX = field.width() * _random.uniform();
+        _y = _targetY = field.length() * _random.uniform();
+        _speed = profile.walkingSpeed * (0.8 + 0.4 * _random.uniform());
+        _standingUntil = profile.standingTime * _random.uniform();
+    }
+
+    double timestamp() const { return _timestamp; }
+    double x() const { return _x; }
+    double y() const { return _y; }
+    int32_t floor() const { return _floor; }
+
+    // The packets received during the last tick, by time. Only recorded if the user was created with recordPackets.
+    const std::vector<SimulatedPacket> &packets() const { return _packets; }
+
+    // Advances the clock by one second and returns the ranging samples at its end, nearest first as Core Location
+    // orders them.
+    const std::vector<BIBeaconSample> &nextTick()
+    {
+        const FieldProfile &profile = _field.profile();
+        double start = _timestamp;
+        double end = start + 1.0;
+        double startX = _x;
+        double startY = _y;
+        walk(end);
+        double moved = std::hypot(_x - startX, _y - startY);
+        findAudibleBeacons();
+
+        double correlation = std::exp(-moved / profile.decorrelation);
+        double innovation = profile.shadowing * std::sqrt(1.0 - correlation * correlation);
+        bool gap = _random.uniform() < profile.scanGap;
+        _packets.clear();
+        _heard.clear();
+        _RSSIs.clear();
+        _TXPowers.clear();
+
+        size_t kept = 0;
+        for (size_t i = 0; i < _links.size(); i++) {
+            Link link = _links[i];
+            const SimulatedBeacon &beacon = _field.beacon(link.beacon);
+            link.shadowing = correlation * link.shadowing + innovation * _random.normal();
+            if (_random.uniform() < (link.blocked ? profile.unblocking : profile.blocking)) {
+                link.blocked = !link.blocked;
+            }
+
+            int32_t sum = 0;
+            int32_t count = 0;
+            if (link.audible) {
+                int32_t floors = std::abs(beacon.location.floor - _floor);
+                double dz = _field.layout().floorHeight * double(floors) + _field.layout().mountHeight;
+                double median = double(beacon.measuredPower) + link.shadowing - profile.floorLoss * double(floors) -
+                                (link.blocked ? profile.bodyLoss : 0.0);
+                for (;; link.event++) {
+                    double time = _field.eventTime(link.beacon, link.event);
+                    if (time < start) {
+                        continue;
+                    }
+                    if (time >= end) {
+                        break;
+                    }
+                    if (gap || _random.uniform() < profile.packetLoss) {
+                        continue;
+                    }
+                    double fraction = time - start;
+                    double dx = startX + fraction * (_x - startX) - beacon.location.x;
+                    double dy = startY + fraction * (_y - startY) - beacon.location.y;
+                    double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+                    double RSSI = median - 10.0 * profile.pathLossExponent * std::log10(distance) +
+                                  profile.fading * _random.normal();
+                    if (RSSI < profile.sensitivity) {
+                        continue;
+                    }
+                    int32_t rounded = std::min(int32_t(std::lround(RSSI)), -1);
+                    sum += rounded;
+                    count++;
+                    if (_recordPackets) {
+                        _packets.push_back(SimulatedPacket{time, link.beacon, rounded});
+                    }
+                }
+            }
+
+            if (count > 0) {
+                link.lastHeard = end;
+                _heard.push_back(link.beacon);
+                _RSSIs.push_back(int32_t(std::lround(double(sum) / double(count))));
+                _TXPowers.push_back(beacon.TXPower);
+            } else if (!link.audible && end - link.lastHeard > profile.rangingMemory) {
+                continue;
+            }
+            _links[kept++] = link;
+        }
+        _links.resize(kept);
+
+        _accuracies.resize(_heard.size());
+        _proximities.resize(_heard.size());
+        BIEstimateDistances(nullptr, _RSSIs.data(), _TXPowers.data(), _heard.size(), nullptr, _accuracies.data(),
+                            _proximities.data());
+        _samples.clear();
+        for (size_t i = 0; i < _heard.size(); i++) {
+            _samples.push_back(BIBeaconSample{syntheticBeaconKey(_heard[i]), _RSSIs[i], _proximities[i], _accuracies[i]});
+        }
+        std::stable_sort(_samples.begin(), _samples.end(), [](const BIBeaconSample &a, const BIBeaconSample &b) {
+            return a.accuracy < b.accuracy;
+        });
+        for (const Link &link : _links) {
+            if (link.lastHeard < end && end - link.lastHeard <= profile.rangingMemory) {
+                _samples.push_back(BIBeaconSample{syntheticBeaconKey(link.beacon), 0, BIProximityUnknown, -1.0});
+            }
+        }
+
+        if (_recordPackets) {
+            std::sort(_packets.begin(), _packets.end(), [](const SimulatedPacket &a, const SimulatedPacket &b) {
+                return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && a.beacon < b.beacon);
+            });
+        }
+        _timestamp = end;
+        return _samples;
+    }
+
+private:
+    struct Link {
+        uint32_t beacon;
+        bool audible;
+        bool blocked;
+        uint64_t event; // the next advertising event
+        double shadowing;
+        double lastHeard;
+    };
+
+    void walk(double end)
+    {
+        const FieldProfile &profile = _field.profile();
+        double remaining = std::hypot(_targetX - _x, _targetY - _y);
+        if (remaining > _speed) {
+            _x += (_targetX - _x) * _speed / remaining;
+            _y += (_targetY - _y) * _speed / remaining;
+            return;
+        }
+        _x = _targetX;
+        _y = _targetY;
+        if (!_standing) {
+            _standing = true;
+            _standingUntil = end - profile.standingTime * std::log(1.0 - _random.uniform());
+        } else if (end >= _standingUntil) {
+            _standing = false;
+            int32_t floorCount = _field.layout().floorCount;
+            if (floorCount > 1 && _random.uniform() < profile.floorChange) {
+                _floor = (_floor == 0 || (_floor < floorCount - 1 && _random.uniform() < 0.5)) ? _floor + 1 : _floor - 1;
+            }
+            _targetX = _field.width() * _random.uniform();
+            _targetY = _field.length() * _random.uniform();
+        }
+    }
+
+    // Merges the beacons within reach of the user, by index, into the links.
+    void findAudibleBeacons()
+    {
+        const FieldProfile &profile = _field.profile();
+        const FieldLayout &layout = _field.layout();
+        _candidates.clear();
+        for (int32_t floors = 0; floors < layout.floorCount; floors++) {
+            // Radii shrink with the loss through the floors in between.
+            double attenuation = std::pow(10.0, -profile.floorLoss * double(floors) / (10.0 * profile.pathLossExponent));
+            double radius = _field.maximumRadius() * attenuation;
+            if (floors > 0 && radius <= layout.floorHeight * double(floors)) {
+                break;
+            }
+            for (int32_t side = floors == 0 ? 1 : -1; side <= 1; side += 2) {
+                int32_t floor = _floor + side * floors;
+                if (floor < 0 || floor >= layout.floorCount) {
+                    continue;
+                }
+                size_t count = BISpatialIndexFindWithinRadius(_field.index(), floor, _x, _y, radius, _matches.data(),
+                                                              _matches.size());
+                if (count > _matches.size()) {
+                    _matches.resize(count);
+                    count = BISpatialIndexFindWithinRadius(_field.index(), floor, _x, _y, radius, _matches.data(),
+                                                           _matches.size());
+                }
+                for (size_t i = 0; i < count; i++) {
+                    uint32_t beacon = syntheticBeaconIndex(_matches[i].location.key);
+                    if (_matches[i].distance <= _field.beacon(beacon).audibleRadius * attenuation) {
+                        _candidates.push_back(beacon);
+                    }
+                }
+            }
+        }
+        std::sort(_candidates.begin(), _candidates.end());
+
+        _merged.clear();
+        size_t i = 0;
+        size_t j = 0;
+        while (i < _links.size() || j < _candidates.size()) {
+            if (j == _candidates.size() || (i < _links.size() && _links[i].beacon < _candidates[j])) {
+                Link link = _links[i++];
+                link.audible = false;
+                _merged.push_back(link);
+            } else if (i == _links.size() || _candidates[j] < _links[i].beacon) {
+                uint32_t beacon = _candidates[j++];
+                _merged.push_back(Link{beacon, true, false, _field.firstEvent(beacon, _timestamp),
+                                       profile.shadowing * _random.normal(), -HUGE_VAL});
+            } else {
+                Link link = _links[i++];
+                j++;
+                if (!link.audible) {
+                    link.event = _field.firstEvent(link.beacon, _timestamp);
+                    link.audible = true;
+                }
+                _merged.push_back(link);
+            }
+        }
+        _links.swap(_merged);
+    }
+
+    const SimulatedField &_field;
+    SplitMix64 _random;
+    bool _recordPackets;
+
+    double _timestamp = 0.0;
+    int32_t _floor;
+    double _x;
+    double _y;
+    double _targetX;
+    double _targetY;
+    double _speed;
+    bool _standing = true;
+    double _standingUntil;
+
+    std::vector<Link> _links; // by beacon
+    std::vector<Link> _merged;
+    std::vector<uint32_t> _candidates;
+    std::vector<BISpatialMatch> _matches = std::vector<BISpatialMatch>(256);
+    std::vector<uint32_t> _heard;
+    std::vector<int32_t> _RSSIs;
+    std::vector<int32_t> _TXPowers;
+    std::vector<double> _accuracies;
+    std::vector<int32_t> _proximities;
+    std::vector<BIBeaconSample> _samples;
+    std::vector<SimulatedPacket> _packets;
+};
+
+} // namespace tools
+} // namespace bi
@@ -0,0 +1,536 @@
+//
+//  SimulatedPeripherals.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// A deterministic stand-in for Core Bluetooth that drives a BIGATTJobQueue or a BIBeaconProvisioner in simulated time:
+// a population of beacons with battery, device information and TX power services plus the configuration services of
+// the BEACONinside firmware, realistic connection and ATT latencies, radio contention between concurrent connections,
+// and unreachable devices, failed connections, spontaneous disconnections, read and write errors, lost writes and
+// beacons with a different passkey at configurable rates.
+
+#pragma once
+
+#include <BICore/BIBeaconProvisioner.h>
+#include <BICore/BIGATTJobQueue.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <vector>
+
+namespace bi {
+namespace tools {
+
+struct PeripheralProfile {
+    double unreachable = 0.03;       // share of devices that never answer a connection request
+    double connectFailure = 0.08;    // probability that a connection attempt fails
+    double disconnection = 0.03;     // probability that a connection drops on its own
+    double readError = 0.02;         // probability that a read fails
+    double deviceInformation = 0.95; // share of devices with the device information service
+    double TXPowerService = 0.8;     // share of devices with the TX power service
+    double contention = 0.15;        // slowdown of ATT operations per additional connection
+    double writeError = 0.02;        // probability that a write fails
+    double lostWrite = 0.01;         // probability that a write is acknowledged but not stored
+    double otherPasskey = 0.01;      // share of devices with a passkey other than defaultPasskey
+    double timerService = 0.98;      // share of devices whose firmware can change the advertising interval
+};
+
+const uint16_t batteryService = 0x180F;
+const uint16_t batteryLevelCharacteristic = 0x2A19;
+const uint16_t deviceInformationService = 0x180A;
+const uint16_t firmwareRevisionCharacteristic = 0x2A26;
+const uint16_t TXPowerService = 0x1804;
+const uint16_t TXPowerLevelCharacteristic = 0x2A07;
+
+// Stand-ins for the BEACONinside services and characteristics declared in BITypes.h.
+inline BIGATTUUID vendorUUID(uint16_t shortUUID)
+{
+    BIGATTUUID uuid = BIGATTUUIDMakeShort(shortUUID);
+    uuid.bytes[0] = 0xB1;
+    uuid.bytes[1] = 0xC0;
+    return uuid;
+}
+
+const uint16_t accessControlService = 0x0100;
+const uint16_t passkeyCharacteristic = 0x0101;
+const uint16_t proximityService = 0x0200;
+const uint16_t proximityUUIDCharacteristic = 0x0201;
+const uint16_t majorCharacteristic = 0x0202;
+const uint16_t minorCharacteristic = 0x0203;
+const uint16_t beaconTXPowerService = 0x0300;
+const uint16_t beaconTXPowerLevelCharacteristic = 0x0301;
+const uint16_t timerService = 0x0400;
+const uint16_t advertisingIntervalCharacteristic = 0x0401;
+const uint16_t resetService = 0x0500;
+const uint16_t rebootCharacteristic = 0x0501;
+
+const uint8_t defaultPasskey[6] = {'0', '0', '0', '0', '0', '0'};
+
+inline BIBeaconCharacteristics beaconCharacteristics()
+{
+    auto path = [](uint16_t service, uint16_t characteristic) {
+        return BIGATTCharacteristicPath{vendorUUID(service), vendorUUID(characteristic)};
+    };
+    BIBeaconCharacteristics characteristics;
+    characteristics.passkey = path(accessControlService, passkeyCharacteristic);
+    characteristics.proximityUUID = path(proximityService, proximityUUIDCharacteristic);
+    characteristics.major = path(proximityService, majorCharacteristic);
+    characteristics.minor = path(proximityService, minorCharacteristic);
+    characteristics.TXPowerLevel = path(beaconTXPowerService, beaconTXPowerLevelCharacteristic);
+    characteristics.advertisingInterval = path(timerService, advertisingIntervalCharacteristic);
+    characteristics.reboot = path(resetService, rebootCharacteristic);
+    return characteristics;
+}
+
+// What the simulated peripherals report to.
+class GATTClient {
+public:
+    virtual ~GATTClient() {}
+    virtual bool isFinished() = 0;
+    virtual void advance(double timestamp) = 0;
+    virtual void didConnect(uint32_t deviceID, double timestamp, BIGATTStatus status) = 0;
+    virtual void didDisconnect(uint32_t deviceID, double timestamp) = 0;
+    virtual void didDiscoverServices(uint32_t deviceID, double timestamp, BIGATTStatus status, const BIGATTUUID *services,
+                                     size_t serviceCount) = 0;
+    virtual void didDiscoverCharacteristics(uint32_t deviceID, double timestamp, const BIGATTUUID *service,
+                                            BIGATTStatus status, const BIGATTUUID *characteristics,
+                                            size_t characteristicCount) = 0;
+    virtual void didWriteValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath *path,
+                               BIGATTStatus status) = 0;
+    virtual void didReadValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath *path,
+                              BIGATTStatus status, const uint8_t *value, size_t length) = 0;
+};
+
+class JobQueueClient : public GATTClient {
+public:
+    explicit JobQueueClient(BIGATTJobQueueRef queue) : _queue(queue) {}
+
+    bool isFinished() override { return BIGATTJobQueueIsFinished(_queue); }
+    void advance(double timestamp) override { BIGATTJobQueueAdvance(_queue, timestamp); }
+    void didConnect(uint32_t deviceID, double timestamp, BIGATTStatus status) override
+    {
+        BIGATTJobQueueDidConnect(_queue, deviceID, timestamp, status);
+    }
+    void didDisconnect(uint32_t deviceID, double timestamp) override
+    {
+        BIGATTJobQueueDidDisconnect(_queue, deviceID, timestamp);
+    }
+    void didDiscoverServices(uint32_t deviceID, double timestamp, BIGATTStatus status, const BIGATTUUID *services,
+                             size_t serviceCount) override
+    {
+        BIGATTJobQueueDidDiscoverServices(_queue, deviceID, timestamp, status, services, serviceCount);
+    }
+    void didDiscoverCharacteristics(uint32_t deviceID, double timestamp, const BIGATTUUID *service, BIGATTStatus status,
+                                    const BIGATTUUID *characteristics, size_t characteristicCount) override
+    {
+        BIGATTJobQueueDidDiscoverCharacteristics(_queue, deviceID, timestamp, service, status, characteristics,
+                                                 characteristicCount);
+    }
+    void didWriteValue(uint32_t, double, const BIGATTCharacteristicPath *, BIGATTStatus) override {}
+    void didReadValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath *path, BIGATTStatus status,
+                      const uint8_t *value, size_t length) override
+    {
+        BIGATTJobQueueDidReadValue(_queue, deviceID, timestamp, path, status, value, length);
+    }
+
+private:
+    BIGATTJobQueueRef _queue;
+};
+
+class ProvisionerClient : public GATTClient {
+public:
+    explicit ProvisionerClient(BIBeaconProvisionerRef provisioner) : _provisioner(provisioner) {}
+
+    bool isFinished() override { return BIBeaconProvisionerIsFinished(_provisioner); }
+    void advance(double timestamp) override { BIBeaconProvisionerAdvance(_provisioner, timestamp); }
+    void didConnect(uint32_t deviceID, double timestamp, BIGATTStatus status) override
+    {
+        BIBeaconProvisionerDidConnect(_provisioner, deviceID, timestamp, status);
+    }
+    void didDisconnect(uint32_t deviceID, double timestamp) override
+    {
+        BIBeaconProvisionerDidDisconnect(_provisioner, deviceID, timestamp);
+    }
+    void didDiscoverServices(uint32_t deviceID, double timestamp, BIGATTStatus status, const BIGATTUUID *services,
+                             size_t serviceCount) override
+    {
+        BIBeaconProvisionerDidDiscoverServices(_provisioner, deviceID, timestamp, status, services, serviceCount);
+    }
+    void didDiscoverCharacteristics(uint32_t deviceID, double timestamp, const BIGATTUUID *service, BIGATTStatus status,
+                                    const BIGATTUUID *characteristics, size_t characteristicCount) override
+    {
+        BIBeaconProvisionerDidDiscoverCharacteristics(_provisioner, deviceID, timestamp, service, status,
+                                                      characteristics, characteristicCount);
+    }
+    void didWriteValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath *path,
+                       BIGATTStatus status) override
+    {
+        BIBeaconProvisionerDidWriteValue(_provisioner, deviceID, timestamp, path, status);
+    }
+    void didReadValue(uint32_t deviceID, double timestamp, const BIGATTCharacteristicPath *path, BIGATTStatus status,
+                      const uint8_t *value, size_t length) override
+    {
+        BIBeaconProvisionerDidReadValue(_provisioner, deviceID, timestamp, path, status, value, length);
+    }
+
+private:
+    BIBeaconProvisionerRef _provisioner;
+};
+
+class SimulatedPeripherals {
+public:
+    SimulatedPeripherals(size_t count, uint64_t seed, const PeripheralProfile &profile = PeripheralProfile())
+        : _random(seed), _profile(profile), _devices(count)
+    {
+        SplitMix64 firmware(seed ^ 0x5EED);
+        for (Device &device : _devices) {
+            device.reachable = _random.uniform() >= profile.unreachable;
+            device.services.push_back(BIGATTUUIDMakeShort(batteryService));
+            if (_random.uniform() < profile.deviceInformation) {
+                device.services.push_back(BIGATTUUIDMakeShort(deviceInformationService));
+            }
+            if (_random.uniform() < profile.TXPowerService) {
+                device.services.push_back(BIGATTUUIDMakeShort(TXPowerService));
+            }
+            device.batteryLevel = uint8_t(20 + _random.next() % 81);
+            device.TXPower = int8_t(-int(_random.next() % 24));
+
+            device.services.push_back(vendorUUID(accessControlService));
+            device.services.push_back(vendorUUID(proximityService));
+            device.services.push_back(vendorUUID(beaconTXPowerService));
+            device.services.push_back(vendorUUID(resetService));
+            if (firmware.uniform() < profile.timerService) {
+                device.services.push_back(vendorUUID(timerService));
+            }
+            device.passkey.assign(defaultPasskey, defaultPasskey + sizeof(defaultPasskey));
+            if (firmware.uniform() < profile.otherPasskey) {
+                device.passkey[0] = '1';
+            }
+            device.registers[0].assign(16, 0);
+            device.registers[1] = {1, 0};
+            device.registers[2] = {uint8_t(firmware.next()), uint8_t(firmware.next())};
+            device.registers[3] = {2};
+            device.registers[4] = {0x40, 0x06}; // 1600 == 1 s
+        }
+    }
+
+    BIGATTTransport transport() const
+    {
+        BIGATTTransport transport;
+        transport.connect = [](uint32_t deviceID, void *context) { static_cast<SimulatedPeripherals *>(context)->connect(deviceID); };
+        transport.disconnect = [](uint32_t deviceID, void *context) {
+            static_cast<SimulatedPeripherals *>(context)->disconnect(deviceID);
+        };
+        transport.discoverServices = [](uint32_t deviceID, const BIGATTUUID *services, size_t count, void *context) {
+            static_cast<SimulatedPeripherals *>(context)->discoverServices(deviceID, services, count);
+        };
+        transport.discoverCharacteristics = [](uint32_t deviceID, const BIGATTUUID *service, const BIGATTUUID *characteristics,
+                                               size_t count, void *context) {
+            static_cast<SimulatedPeripherals *>(context)->discoverCharacteristics(deviceID, *service, characteristics, count);
+        };
+        transport.readValue = [](uint32_t deviceID, const BIGATTCharacteristicPath *path, void *context) {
+            static_cast<SimulatedPeripherals *>(context)->readValue(deviceID, *path);
+        };
+        transport.writeValue = [](uint32_t deviceID, const BIGATTCharacteristicPath *path, const uint8_t *value,
+                                  size_t length, void *context) {
+            static_cast<SimulatedPeripherals *>(context)->writeValue(deviceID, *path, value, length);
+        };
+        return transport;
+    }
+
+    // Handlers that forward to deviceFinished. Create the queue with this object as the context.
+    static BIGATTJobHandlers handlers()
+    {
+        BIGATTJobHandlers handlers;
+        handlers.deviceFinished = [](const BIGATTDeviceResult *result, void *context) {
+            SimulatedPeripherals &peripherals = *static_cast<SimulatedPeripherals *>(context);
+            if (peripherals.deviceFinished) {
+                peripherals.deviceFinished(*result);
+            }
+        };
+        handlers.jobFinished = nullptr;
+        return handlers;
+    }
+
+    // Handlers that forward to deviceProvisioned. Create the provisioner with this object as the context.
+    static BIBeaconProvisionerHandlers provisionerHandlers()
+    {
+        BIBeaconProvisionerHandlers handlers;
+        handlers.deviceFinished = [](const BIBeaconProvisioningResult *result, void *context) {
+            SimulatedPeripherals &peripherals = *static_cast<SimulatedPeripherals *>(context);
+            if (peripherals.deviceProvisioned) {
+                peripherals.deviceProvisioned(*result);
+            }
+        };
+        handlers.jobFinished = nullptr;
+        return handlers;
+    }
+
+    double run(BIGATTJobQueueRef queue, double tick = 0.1)
+    {
+        JobQueueClient client(queue);
+        return run(client, tick);
+    }
+
+    double run(BIBeaconProvisionerRef provisioner, double tick = 0.1, double until = HUGE_VAL)
+    {
+        ProvisionerClient client(provisioner);
+        return run(client, tick, until);
+    }
+
+    // Runs the client until its job is finished or until is reached, calling advance() every tick seconds. Returns the
+    // simulated time at the end. Operations still in flight when it stops are dropped.
+    double run(GATTClient &client, double tick = 0.1, double until = HUGE_VAL)
+    {
+        _client = &client;
+        while (!client.isFinished() && _now < until) {
+            double nextTick = _now + tick;
+            if (!_events.empty() && _events.top().timestamp <= nextTick) {
+                Event event = _events.top();
+                _events.pop();
+                _now = event.timestamp;
+                event.fire();
+            } else {
+                _now = nextTick;
+                client.advance(_now);
+            }
+        }
+        _client = nullptr;
+        _events = decltype(_events)();
+        for (uint32_t deviceID = 0; deviceID < _devices.size(); deviceID++) {
+            disconnect(deviceID);
+        }
+        return _now;
+    }
+
+    // The configuration a device currently advertises, in the encoding of BIBeaconProvisioningTarget.
+    bool hasConfiguration(uint32_t deviceID, const BIBeaconProvisioningTarget &target) const
+    {
+        const Device &device = _devices[deviceID];
+        auto uint16 = [](const std::vector<uint8_t> &value) { return uint16_t(value[0] | value[1] << 8); };
+        return (!(target.settings & BIBeaconSettingProximityUUID) ||
+                std::equal(device.registers[0].begin(), device.registers[0].end(), target.key.proximityUUID)) &&
+               (!(target.settings & BIBeaconSettingMajor) || uint16(device.registers[1]) == target.key.major) &&
+               (!(target.settings & BIBeaconSettingMinor) || uint16(device.registers[2]) == target.key.minor) &&
+               (!(target.settings & BIBeaconSettingTXPowerLevel) || device.registers[3][0] == target.TXPowerLevel) &&
+               (!(target.settings & BIBeaconSettingAdvertisingInterval) ||
+                uint16(device.registers[4]) == target.advertisingInterval);
+    }
+
+    double now() const { return _now; }
+    size_t count() const { return _devices.size(); }
+
+    std::function<void(const BIGATTDeviceResult &)> deviceFinished;
+    std::function<void(const BIBeaconProvisioningResult &)> deviceProvisioned;
+
+private:
+    struct Device {
+        bool reachable = true;
+        std::vector<BIGATTUUID> services;
+        uint8_t batteryLevel = 100;
+        int8_t TXPower = 0;
+        std::vector<uint8_t> passkey;
+        std::vector<uint8_t> registers[5]; // proximity UUID, major, minor, TX power level, advertising interval
+        bool authenticated = false;        // per connection
+        uint64_t session = 0; // incremented by every connect and disconnect
+        bool connected = false;
+        double busyUntil = 0.0; // ATT operations of a connection are serialized
+    };
+
+    struct Event {
+        double timestamp;
+        uint64_t sequence;
+        std::function<void()> fire;
+
+        bool operator>(const Event &other) const
+        {
+            return timestamp != other.timestamp ? timestamp > other.timestamp : sequence > other.sequence;
+        }
+    };
+
+    void schedule(double delay, std::function<void()> fire)
+    {
+        _events.push(Event{_now + delay, _sequence++, std::move(fire)});
+    }
+
+    bool hasService(const Device &device, const BIGATTUUID &service) const
+    {
+        return std::any_of(device.services.begin(), device.services.end(),
+                           [&](const BIGATTUUID &uuid) { return BIGATTUUIDEqual(&uuid, &service); });
+    }
+
+    // Schedules an ATT operation that takes duration seconds on an idle radio. Operations of a device are serialized and
+    // dropped if the device disconnects in the meantime.
+    void operation(uint32_t deviceID, double duration, std::function<void()> complete)
+    {
+        Device &device = _devices[deviceID];
+        double slowdown = 1.0 + _profile.contention * double(std::max<size_t>(_connected, 1) - 1);
+        double start = std::max(_now, device.busyUntil);
+        device.busyUntil = start + duration * slowdown;
+        uint64_t session = device.session;
+        schedule(device.busyUntil - _now, [this, deviceID, session, complete]() {
+            if (_devices[deviceID].session == session) {
+                complete();
+            }
+        });
+    }
+
+    void connect(uint32_t deviceID)
+    {
+        Device &device = _devices[deviceID];
+        uint64_t session = ++device.session;
+        if (!device.reachable) {
+            return;
+        }
+        double latency = 0.3 - 0.7 * std::log(1.0 - _random.uniform());
+        bool fails = _random.uniform() < _profile.connectFailure;
+        bool drops = _random.uniform() < _profile.disconnection;
+        double dropAfter = latency + 3.0 * _random.uniform();
+        schedule(latency, [this, deviceID, session, fails]() {
+            Device &device = _devices[deviceID];
+            if (device.session != session) {
+                return;
+            }
+            if (fails) {
+                _client->didConnect(deviceID, _now, BIGATTStatusError);
+                return;
+            }
+            device.connected = true;
+            device.authenticated = false;
+            device.busyUntil = _now;
+            _connected++;
+            _client->didConnect(deviceID, _now, BIGATTStatusSuccess);
+        });
+        if (drops && !fails) {
+            schedule(dropAfter, [this, deviceID, session]() {
+                Device &device = _devices[deviceID];
+                if (device.session == session && device.connected) {
+                    disconnect(deviceID);
+                    _client->didDisconnect(deviceID, _now);
+                }
+            });
+        }
+    }
+
+    void disconnect(uint32_t deviceID)
+    {
+        Device &device = _devices[deviceID];
+        device.session++;
+        if (device.connected) {
+            device.connected = false;
+            _connected--;
+        }
+    }
+
+    void discoverServices(uint32_t deviceID, const BIGATTUUID *services, size_t count)
+    {
+        std::vector<BIGATTUUID> found;
+        for (size_t i = 0; i < count; i++) {
+            if (hasService(_devices[deviceID], services[i])) {
+                found.push_back(services[i]);
+            }
+        }
+        operation(deviceID, 0.3 + 0.3 * _random.uniform(), [this, deviceID, found]() {
+            _client->didDiscoverServices(deviceID, _now, BIGATTStatusSuccess, found.data(), found.size());
+        });
+    }
+
+    void discoverCharacteristics(uint32_t deviceID, const BIGATTUUID &service, const BIGATTUUID *characteristics,
+                                 size_t count)
+    {
+        std::vector<BIGATTUUID> found(characteristics, characteristics + count);
+        operation(deviceID, 0.1 + 0.1 * _random.uniform(), [this, deviceID, service, found]() {
+            _client->didDiscoverCharacteristics(deviceID, _now, &service, BIGATTStatusSuccess, found.data(), found.size());
+        });
+    }
+
+    void readValue(uint32_t deviceID, const BIGATTCharacteristicPath &path)
+    {
+        const Device &device = _devices[deviceID];
+        std::vector<uint8_t> value;
+        BIGATTUUID battery = BIGATTUUIDMakeShort(batteryLevelCharacteristic);
+        BIGATTUUID firmware = BIGATTUUIDMakeShort(firmwareRevisionCharacteristic);
+        BIGATTUUID TXPower = BIGATTUUIDMakeShort(TXPowerLevelCharacteristic);
+        if (BIGATTUUIDEqual(&path.characteristic, &battery)) {
+            value.push_back(device.batteryLevel);
+        } else if (BIGATTUUIDEqual(&path.characteristic, &firmware)) {
+            char revision[16];
+            std::snprintf(revision, sizeof(revision), "2.1.%u", unsigned(deviceID % 7));
+            value.assign(revision, revision + std::strlen(revision));
+        } else if (BIGATTUUIDEqual(&path.characteristic, &TXPower)) {
+            value.push_back(uint8_t(device.TXPower));
+        } else if (int index = registerIndex(path.characteristic); index >= 0) {
+            value = device.registers[index];
+        }
+        BIGATTStatus status = _random.uniform() < _profile.readError ? BIGATTStatusError : BIGATTStatusSuccess;
+        operation(deviceID, 0.06 + 0.06 * _random.uniform(), [this, deviceID, path, status, value]() {
+            _client->didReadValue(deviceID, _now, &path, status, value.data(), value.size());
+        });
+    }
+
+    static int registerIndex(const BIGATTUUID &characteristic)
+    {
+        const uint16_t characteristics[] = {proximityUUIDCharacteristic, majorCharacteristic, minorCharacteristic,
+                                            beaconTXPowerLevelCharacteristic, advertisingIntervalCharacteristic};
+        for (int i = 0; i < 5; i++) {
+            BIGATTUUID uuid = vendorUUID(characteristics[i]);
+            if (BIGATTUUIDEqual(&uuid, &characteristic)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Writes take effect when they complete. Configuration writes need an authenticated connection; a reboot drops
+    // the connection shortly after it is acknowledged.
+    void writeValue(uint32_t deviceID, const BIGATTCharacteristicPath &path, const uint8_t *bytes, size_t length)
+    {
+        std::vector<uint8_t> value(bytes, bytes + length);
+        bool error = _random.uniform() < _profile.writeError;
+        bool lost = _random.uniform() < _profile.lostWrite;
+        operation(deviceID, 0.1 + 0.1 * _random.uniform(), [this, deviceID, path, value, error, lost]() {
+            Device &device = _devices[deviceID];
+            BIGATTUUID passkey = vendorUUID(passkeyCharacteristic);
+            BIGATTUUID reboot = vendorUUID(rebootCharacteristic);
+            int index = registerIndex(path.characteristic);
+            BIGATTStatus status = BIGATTStatusSuccess;
+            if (BIGATTUUIDEqual(&path.characteristic, &passkey)) {
+                device.authenticated = value == device.passkey;
+                status = device.authenticated ? BIGATTStatusSuccess : BIGATTStatusError;
+            } else if (error || !device.authenticated) {
+                status = BIGATTStatusError;
+            } else if (BIGATTUUIDEqual(&path.characteristic, &reboot)) {
+                uint64_t session = device.session;
+                schedule(0.05, [this, deviceID, session]() {
+                    if (_devices[deviceID].session == session) {
+                        disconnect(deviceID);
+                        _client->didDisconnect(deviceID, _now);
+                    }
+                });
+            } else if (index >= 0 && !lost && value.size() == device.registers[index].size()) {
+                device.registers[index] = value;
+            }
+            _client->didWriteValue(deviceID, _now, &path, status);
+        });
+    }
+
+    SplitMix64 _random;
+    PeripheralProfile _profile;
+    std::vector<Device> _devices;
+    size_t _connected = 0;
+    double _now = 0.0;
+    uint64_t _sequence = 0;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _events;
+    GATTClient *_client = nullptr;
+};
+
+} // namespace tools
+} // namespace bi
@@ -0,0 +1,143 @@
+//
+//  SyntheticAdvertisements.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Raw advertising payloads (AD structures as delivered by HCI) for the advertisement decoder tools: iBeacon, the four
+// Eddystone frames, and the other advertisements a scan picks up in an office, mixed in fixed proportions.
+
+#pragma once
+
+#include <BICore/BICoreTypes.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace bi {
+namespace tools {
+
+typedef std::vector<uint8_t> Packet;
+
+inline void appendStructure(Packet &packet, uint8_t type, const uint8_t *data, size_t length)
+{
+    packet.push_back(uint8_t(length + 1));
+    packet.push_back(type);
+    packet.insert(packet.end(), data, data + length);
+}
+
+inline Packet flagsPacket()
+{
+    Packet packet;
+    const uint8_t flags = 0x06; // LE General Discoverable, BR/EDR not supported
+    appendStructure(packet, 0x01, &flags, 1);
+    return packet;
+}
+
+inline Packet iBeaconPacket(const BIBeaconKey &key, int8_t measuredPower)
+{
+    Packet packet = flagsPacket();
+    uint8_t data[25] = {0x4C, 0x00, 0x02, 0x15};
+    std::memcpy(data + 4, key.proximityUUID, 16);
+    data[20] = uint8_t(key.major >> 8);
+    data[21] = uint8_t(key.major);
+    data[22] = uint8_t(key.minor >> 8);
+    data[23] = uint8_t(key.minor);
+    data[24] = uint8_t(measuredPower);
+    appendStructure(packet, 0xFF, data, sizeof(data));
+    return packet;
+}
+
+inline Packet eddystonePacket(const uint8_t *frame, size_t length)
+{
+    Packet packet = flagsPacket();
+    const uint8_t services[2] = {0xAA, 0xFE};
+    appendStructure(packet, 0x03, services, sizeof(services));
+    std::vector<uint8_t> data(services, services + 2);
+    data.insert(data.end(), frame, frame + length);
+    appendStructure(packet, 0x16, data.data(), data.size());
+    return packet;
+}
+
+inline Packet eddystoneUIDPacket(uint32_t instance, int8_t TXPower)
+{
+    uint8_t frame[20] = {0x00, uint8_t(TXPower), 0x8B, 0x0C, 0xA7, 0x50, 0xE7, 0xA7, 0x4E, 0x14, 0xBD, 0x99};
+    for (int i = 0; i < 4; i++) {
+        frame[14 + i] = uint8_t(instance >> (24 - 8 * i));
+    }
+    return eddystonePacket(frame, sizeof(frame));
+}
+
+inline Packet eddystoneURLPacket(int8_t TXPower)
+{
+    // https://www.beaconinside.com/
+    const uint8_t frame[] = {0x10, uint8_t(TXPower), 0x01, 'b', 'e', 'a', 'c', 'o', 'n', 'i', 'n', 's', 'i', 'd', 'e', 0x00};
+    return eddystonePacket(frame, sizeof(frame));
+}
+
+inline Packet eddystoneTLMPacket(uint16_t batteryVoltage, double temperature, uint32_t count, uint32_t uptime)
+{
+    int16_t fixed = int16_t(temperature * 256.0);
+    uint8_t frame[14] = {0x20, 0x00, uint8_t(batteryVoltage >> 8), uint8_t(batteryVoltage), uint8_t(uint16_t(fixed) >> 8),
+                         uint8_t(fixed)};
+    for (int i = 0; i < 4; i++) {
+        frame[6 + i] = uint8_t(count >> (24 - 8 * i));
+        frame[10 + i] = uint8_t(uptime >> (24 - 8 * i));
+    }
+    return eddystonePacket(frame, sizeof(frame));
+}
+
+inline Packet eddystoneEIDPacket(uint64_t identifier, int8_t TXPower)
+{
+    uint8_t frame[10] = {0x30, uint8_t(TXPower)};
+    for (int i = 0; i < 8; i++) {
+        frame[2 + i] = uint8_t(identifier >> (56 - 8 * i));
+    }
+    return eddystonePacket(frame, sizeof(frame));
+}
+
+// A phone or laptop: flags, other manufacturer data and a name.
+inline Packet otherPacket(SplitMix64 &random)
+{
+    Packet packet = flagsPacket();
+    uint8_t data[12] = {0x06, 0x00, 0x01, 0x09, 0x20, 0x02};
+    for (size_t i = 6; i < sizeof(data); i++) {
+        data[i] = uint8_t(random.next());
+    }
+    appendStructure(packet, 0xFF, data, sizeof(data));
+    const char name[] = "Surface";
+    appendStructure(packet, 0x09, reinterpret_cast<const uint8_t *>(name), sizeof(name) - 1);
+    return packet;
+}
+
+// 60% iBeacon, 5% each Eddystone UID, URL, TLM and EID, 20% other devices.
+inline std::vector<Packet> syntheticAdvertisements(size_t count, uint64_t seed)
+{
+    SplitMix64 random(seed);
+    std::vector<Packet> packets;
+    packets.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t kind = random.next() % 20;
+        if (kind < 12) {
+            packets.push_back(iBeaconPacket(syntheticBeaconKey(uint32_t(random.next() % 5000)), -59));
+        } else if (kind == 12) {
+            packets.push_back(eddystoneUIDPacket(uint32_t(random.next()), -20));
+        } else if (kind == 13) {
+            packets.push_back(eddystoneURLPacket(-20));
+        } else if (kind == 14) {
+            packets.push_back(eddystoneTLMPacket(uint16_t(2800 + random.next() % 400), 21.5, uint32_t(random.next()),
+                                                 uint32_t(random.next())));
+        } else if (kind == 15) {
+            packets.push_back(eddystoneEIDPacket(random.next(), -20));
+        } else {
+            packets.push_back(otherPacket(random));
+        }
+    }
+    return packets;
+}
+
+} // namespace tools
+} // namespace bi
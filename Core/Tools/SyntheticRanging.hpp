@@ -0,0 +1,114 @@
+//
+//  SyntheticRanging.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Deterministic synthetic ranging data for the benchmark tools: a fixed population of beacons at random distances,
+// each reported with a configurable probability per tick and with noisy RSSI and accuracy values.
+
+#pragma once
+
+#include <BICore/BICoreTypes.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace bi {
+namespace tools {
+
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : _state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, 1).
+    double uniform() { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Standard normal (Box-Muller).
+    double normal()
+    {
+        double u1 = uniform();
+        double u2 = uniform();
+        if (u1 < 1e-300) {
+            u1 = 1e-300;
+        }
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+    }
+
+private:
+    uint64_t _state;
+};
+
+inline BIBeaconKey syntheticBeaconKey(uint32_t index)
+{
+    static const uint8_t UUID[16] = {0xF0, 0x01, 0x8B, 0x9B, 0x75, 0x09, 0x4C, 0x31,
+                                     0xA9, 0x05, 0x1A, 0x27, 0xD3, 0x9C, 0x00, 0x3C};
+    BIBeaconKey key;
+    for (int i = 0; i < 16; i++) {
+        key.proximityUUID[i] = UUID[i];
+    }
+    key.major = uint16_t(1 + index / 1000);
+    key.minor = uint16_t(index % 1000);
+    return key;
+}
+
+// The index of a key made by syntheticBeaconKey().
+inline uint32_t syntheticBeaconIndex(const BIBeaconKey &key) { return uint32_t(key.major - 1) * 1000 + key.minor; }
+
+class SyntheticRanging {
+public:
+    SyntheticRanging(size_t beaconCount, uint64_t seed, double visibility = 0.9)
+        : _random(seed), _visibility(visibility)
+    {
+        _distances.reserve(beaconCount);
+        for (size_t i = 0; i < beaconCount; i++) {
+            _distances.push_back(0.3 + 25.0 * _random.uniform());
+        }
+        _samples.reserve(beaconCount);
+    }
+
+    double timestamp() const { return _timestamp; }
+
+    // Advances the clock by one second and returns the beacons reported in that tick.
+    const std::vector<BIBeaconSample> &nextTick()
+    {
+        _timestamp += 1.0;
+        _samples.clear();
+        for (size_t i = 0; i < _distances.size(); i++) {
+            if (_random.uniform() >= _visibility) {
+                continue;
+            }
+            double distance = _distances[i] * std::exp(0.25 * _random.normal());
+            BIBeaconSample sample;
+            sample.key = syntheticBeaconKey(uint32_t(i));
+            sample.RSSI = int32_t(std::lround(-59.0 - 20.0 * std::log10(distance) + 2.0 * _random.normal()));
+            sample.accuracy = distance;
+            sample.proximity = BIProximityForAccuracy(distance);
+            if (sample.RSSI >= 0) {
+                sample.RSSI = -1;
+            }
+            _samples.push_back(sample);
+        }
+        return _samples;
+    }
+
+private:
+    SplitMix64 _random;
+    double _visibility;
+    double _timestamp = 0.0;
+    std::vector<double> _distances;
+    std::vector<BIBeaconSample> _samples;
+};
+
+} // namespace tools
+} // namespace bi
@@ -0,0 +1,214 @@
+//
+//  TraceCSV.hpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Reader and writer for recorded ranging traces in CSV form. One row per beacon per ranging callback:
+//
+//     timestamp,uuid,major,minor,rssi,proximity,accuracy[,smoothed_rssi,smoothed_proximity,smoothed_accuracy]
+//
+// Consecutive rows with the same timestamp form one tick. The raw columns (rssi, proximity, accuracy) are left empty
+// for a beacon that was not reported in a tick but whose expected smoothed values are recorded. A row with an empty
+// uuid marks a tick in which no beacon was reported. The optional smoothed columns hold what BIBeacon reported on the
+// device after the callback; a smoothed_rssi of 0 means the beacon was not in range. Lines starting with '#' and a
+// header line starting with "timestamp" are ignored.
+
+#pragma once
+
+#include <BICore/BICoreTypes.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace bi {
+namespace tools {
+
+struct ExpectedSignal {
+    BIBeaconKey key;
+    BISignal signal;
+};
+
+struct CSVTick {
+    double timestamp = 0.0;
+    std::vector<BIBeaconSample> samples;
+    std::vector<ExpectedSignal> expected;
+};
+
+inline std::vector<std::string> splitCSVLine(const std::string &line)
+{
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        fields.push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    for (std::string &field : fields) {
+        while (!field.empty() && (field.back() == '\r' || field.back() == ' ')) {
+            field.pop_back();
+        }
+    }
+    return fields;
+}
+
+inline bool parseDouble(const std::string &field, double &value)
+{
+    if (field.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    value = std::strtod(field.c_str(), &end);
+    return errno == 0 && end != nullptr && *end == '\0';
+}
+
+inline bool parseInteger(const std::string &field, long &value)
+{
+    if (field.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    value = std::strtol(field.c_str(), &end, 10);
+    return errno == 0 && end != nullptr && *end == '\0';
+}
+
+// Reads a trace file into ticks. Returns false and fills `error` on malformed input.
+inline bool readCSVTrace(const char *path, std::vector<CSVTick> &ticks, std::string &error)
+{
+    FILE *file = std::strcmp(path, "-") == 0 ? stdin : std::fopen(path, "r");
+    if (file == nullptr) {
+        error = std::string("cannot open ") + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    std::string line;
+    size_t lineNumber = 0;
+    bool ok = true;
+    char buffer[512];
+    while (ok && std::fgets(buffer, sizeof(buffer), file) != nullptr) {
+        line.assign(buffer);
+        if (!line.empty() && line.back() == '\n') {
+            line.pop_back();
+        } else if (!std::feof(file)) {
+            // Longer than the buffer; keep reading the rest of the line.
+            while (std::fgets(buffer, sizeof(buffer), file) != nullptr) {
+                line.append(buffer);
+                if (line.back() == '\n') {
+                    line.pop_back();
+                    break;
+                }
+            }
+        }
+        lineNumber++;
+        if (line.empty() || line[0] == '#' || line.compare(0, 9, "timestamp") == 0) {
+            continue;
+        }
+
+        std::vector<std::string> fields = splitCSVLine(line);
+        double timestamp;
+        if (!parseDouble(fields[0], timestamp)) {
+            error = "line " + std::to_string(lineNumber) + ": invalid timestamp";
+            ok = false;
+            break;
+        }
+        if (ticks.empty() || ticks.back().timestamp != timestamp) {
+            if (!ticks.empty() && timestamp < ticks.back().timestamp) {
+                error = "line " + std::to_string(lineNumber) + ": timestamps must not decrease";
+                ok = false;
+                break;
+            }
+            ticks.emplace_back();
+            ticks.back().timestamp = timestamp;
+        }
+        if (fields.size() < 2 || fields[1].empty()) {
+            continue;
+        }
+        if (fields.size() != 7 && fields.size() != 10) {
+            error = "line " + std::to_string(lineNumber) + ": expected 7 or 10 columns";
+            ok = false;
+            break;
+        }
+
+        BIBeaconKey key;
+        long major;
+        long minor;
+        if (!BIBeaconKeySetUUIDString(&key, fields[1].c_str()) || !parseInteger(fields[2], major) ||
+            !parseInteger(fields[3], minor) || major < 0 || major > 0xFFFF || minor < 0 || minor > 0xFFFF) {
+            error = "line " + std::to_string(lineNumber) + ": invalid beacon identifier";
+            ok = false;
+            break;
+        }
+        key.major = uint16_t(major);
+        key.minor = uint16_t(minor);
+
+        long rssi;
+        long proximity;
+        double accuracy;
+        if (!fields[4].empty()) {
+            if (!parseInteger(fields[4], rssi) || !parseInteger(fields[5], proximity) || !parseDouble(fields[6], accuracy)) {
+                error = "line " + std::to_string(lineNumber) + ": invalid raw signal";
+                ok = false;
+                break;
+            }
+            BIBeaconSample sample;
+            sample.key = key;
+            sample.RSSI = int32_t(rssi);
+            sample.proximity = int32_t(proximity);
+            sample.accuracy = accuracy;
+            ticks.back().samples.push_back(sample);
+        }
+
+        if (fields.size() == 10) {
+            if (!parseInteger(fields[7], rssi) || !parseInteger(fields[8], proximity) || !parseDouble(fields[9], accuracy)) {
+                error = "line " + std::to_string(lineNumber) + ": invalid smoothed signal";
+                ok = false;
+                break;
+            }
+            ExpectedSignal expected;
+            expected.key = key;
+            expected.signal.timestamp = timestamp;
+            expected.signal.RSSI = int32_t(rssi);
+            expected.signal.proximity = int32_t(proximity);
+            expected.signal.accuracy = accuracy;
+            expected.signal.inRange = (rssi != 0);
+            ticks.back().expected.push_back(expected);
+        }
+    }
+
+    if (file != stdin) {
+        std::fclose(file);
+    }
+    return ok;
+}
+
+inline void writeCSVHeader(FILE *file)
+{
+    std::fputs("timestamp,uuid,major,minor,rssi,proximity,accuracy,smoothed_rssi,smoothed_proximity,smoothed_accuracy\n", file);
+}
+
+// Writes one row. `raw` may be null for a beacon that was not reported in this tick.
+inline void writeCSVRow(FILE *file, double timestamp, const BIBeaconKey &key, const BIBeaconSample *raw, const BISignal &smoothed)
+{
+    char uuid[37];
+    BIBeaconKeyGetUUIDString(&key, uuid);
+    std::fprintf(file, "%.6f,%s,%u,%u,", timestamp, uuid, unsigned(key.major), unsigned(key.minor));
+    if (raw != nullptr) {
+        std::fprintf(file, "%d,%d,%.17g,", int(raw->RSSI), int(raw->proximity), raw->accuracy);
+    } else {
+        std::fputs(",,,", file);
+    }
+    std::fprintf(file, "%d,%d,%.17g\n", int(smoothed.RSSI), int(smoothed.proximity), smoothed.accuracy);
+}
+
+} // namespace tools
+} // namespace bi
@@ -0,0 +1,187 @@
+//
+//  bi-bench-advertisement.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Throughput of the advertisement decoders in packets per second on one core, for a mix of iBeacon, Eddystone and
+// other advertisements: decoding raw payloads, decoding manufacturer data that has already been extracted (what Core
+// Bluetooth delivers), and, as a stand-in for building an advertisementData dictionary per packet, collecting every
+// AD structure into a std::map of heap-allocated values before decoding.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticAdvertisements.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const size_t packetCount = 65536;
+const size_t rounds = 64;
+
+// All packets back to back, as they would arrive in an HCI buffer.
+struct Buffer {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> offsets; // packetCount + 1
+
+    const uint8_t *packet(size_t index) const { return bytes.data() + offsets[index]; }
+    size_t length(size_t index) const { return offsets[index + 1] - offsets[index]; }
+};
+
+struct Digest {
+    size_t counts[6] = {};
+    uint64_t keys = 0;
+
+    void add(const BIAdvertisement &advertisement)
+    {
+        counts[advertisement.type]++;
+        if (advertisement.type == BIAdvertisementTypeIBeacon) {
+            keys += uint64_t(advertisement.key.major) << 16 | advertisement.key.minor;
+        }
+    }
+};
+
+Buffer makeBuffer(const std::vector<Packet> &packets)
+{
+    Buffer buffer;
+    for (const Packet &packet : packets) {
+        buffer.offsets.push_back(buffer.bytes.size());
+        buffer.bytes.insert(buffer.bytes.end(), packet.begin(), packet.end());
+    }
+    buffer.offsets.push_back(buffer.bytes.size());
+    return buffer;
+}
+
+// Manufacturer data and Eddystone service data of every packet, extracted beforehand.
+struct Extracted {
+    std::vector<size_t> manufacturerOffsets;
+    std::vector<size_t> manufacturerLengths;
+    std::vector<size_t> serviceOffsets;
+    std::vector<size_t> serviceLengths;
+};
+
+Extracted extract(const Buffer &buffer)
+{
+    Extracted extracted;
+    for (size_t i = 0; i < packetCount; i++) {
+        size_t manufacturerOffset = 0, manufacturerLength = 0, serviceOffset = 0, serviceLength = 0;
+        const uint8_t *packet = buffer.packet(i);
+        for (size_t offset = 0; offset + 1 < buffer.length(i); offset += 1 + packet[offset]) {
+            size_t start = buffer.offsets[i] + offset + 2;
+            if (packet[offset + 1] == 0xFF) {
+                manufacturerOffset = start;
+                manufacturerLength = packet[offset] - 1;
+            } else if (packet[offset + 1] == 0x16) {
+                serviceOffset = start + 2;
+                serviceLength = packet[offset] - 3;
+            }
+        }
+        extracted.manufacturerOffsets.push_back(manufacturerOffset);
+        extracted.manufacturerLengths.push_back(manufacturerLength);
+        extracted.serviceOffsets.push_back(serviceOffset);
+        extracted.serviceLengths.push_back(serviceLength);
+    }
+    return extracted;
+}
+
+template <typename Decode>
+double measure(Decode decode, Digest &digest)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < packetCount; i++) {
+            decode(i, digest);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(rounds * packetCount) / seconds;
+}
+
+void print(const char *label, double packetsPerSecond, const Digest &digest)
+{
+    std::printf("%-22s %12.1f %10.1f %9zu %9zu %6zu %6zu %6zu %6zu\n", label, packetsPerSecond / 1e6,
+                1e9 / packetsPerSecond, digest.counts[BIAdvertisementTypeUnknown] / rounds,
+                digest.counts[BIAdvertisementTypeIBeacon] / rounds, digest.counts[BIAdvertisementTypeEddystoneUID] / rounds,
+                digest.counts[BIAdvertisementTypeEddystoneURL] / rounds,
+                digest.counts[BIAdvertisementTypeEddystoneTLM] / rounds,
+                digest.counts[BIAdvertisementTypeEddystoneEID] / rounds);
+}
+
+} // namespace
+
+int main()
+{
+    Buffer buffer = makeBuffer(syntheticAdvertisements(packetCount, 3));
+    Extracted extracted = extract(buffer);
+
+    std::printf("%zu packets (%.1f bytes on average), %zu rounds\n\n", packetCount,
+                double(buffer.bytes.size()) / double(packetCount), rounds);
+    std::printf("%-22s %12s %10s %9s %9s %6s %6s %6s %6s\n", "decoder", "Mpackets/s", "ns/packet", "other", "iBeacon",
+                "UID", "URL", "TLM", "EID");
+
+    Digest payload;
+    double payloadRate = measure(
+        [&](size_t i, Digest &digest) {
+            BIAdvertisement advertisement;
+            advertisement.type = BIAdvertisementTypeUnknown;
+            BIAdvertisementDecodePayload(buffer.packet(i), buffer.length(i), &advertisement);
+            digest.add(advertisement);
+        },
+        payload);
+    print("raw payload", payloadRate, payload);
+
+    Digest fields;
+    double fieldsRate = measure(
+        [&](size_t i, Digest &digest) {
+            BIAdvertisement advertisement;
+            advertisement.type = BIAdvertisementTypeUnknown;
+            if (!BIAdvertisementDecodeManufacturerData(buffer.bytes.data() + extracted.manufacturerOffsets[i],
+                                                       extracted.manufacturerLengths[i], &advertisement)) {
+                BIAdvertisementDecodeServiceData(0xFEAA, buffer.bytes.data() + extracted.serviceOffsets[i],
+                                                 extracted.serviceLengths[i], &advertisement);
+            }
+            digest.add(advertisement);
+        },
+        fields);
+    print("extracted fields", fieldsRate, fields);
+
+    Digest dictionary;
+    double dictionaryRate = measure(
+        [&](size_t i, Digest &digest) {
+            std::map<std::string, std::vector<uint8_t>> advertisementData;
+            const uint8_t *packet = buffer.packet(i);
+            for (size_t offset = 0; offset + 1 < buffer.length(i); offset += 1 + packet[offset]) {
+                std::string key = packet[offset + 1] == 0xFF   ? "kCBAdvDataManufacturerData"
+                                  : packet[offset + 1] == 0x16 ? "kCBAdvDataServiceData"
+                                                               : "kCBAdvDataType" + std::to_string(packet[offset + 1]);
+                advertisementData[key].assign(packet + offset + 2, packet + offset + 1 + packet[offset]);
+            }
+            BIAdvertisement advertisement;
+            advertisement.type = BIAdvertisementTypeUnknown;
+            auto manufacturer = advertisementData.find("kCBAdvDataManufacturerData");
+            auto service = advertisementData.find("kCBAdvDataServiceData");
+            if (manufacturer != advertisementData.end()) {
+                BIAdvertisementDecodeManufacturerData(manufacturer->second.data(), manufacturer->second.size(),
+                                                      &advertisement);
+            } else if (service != advertisementData.end() && service->second.size() >= 2) {
+                BIAdvertisementDecodeServiceData(0xFEAA, service->second.data() + 2, service->second.size() - 2,
+                                                 &advertisement);
+            }
+            digest.add(advertisement);
+        },
+        dictionary);
+    print("dictionary per packet", dictionaryRate, dictionary);
+
+    std::printf("\nraw payload decoding is %.0fx faster than building a dictionary per packet; keys digest %s\n",
+                payloadRate / dictionaryRate,
+                payload.keys == fields.keys && payload.keys == dictionary.keys ? "matches" : "MISMATCH");
+    return payload.keys == fields.keys && payload.keys == dictionary.keys ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+//
+//  bi-bench-cache.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Cold versus warm starts with the beacon cache. 500 places with six beacons each are ranged for two minutes in a
+// first session, whose last smoothed signals are written to a cache. After a relaunch every place is ranged again for
+// 30 s, once with empty filters (cold) and once with the filters restored from the cache (warm), with the same raw
+// signals. Reports, per smoothing filter, how long it takes until the nearest beacon is the truly nearest one and stays
+// so, how often the first reported nearest beacon is wrong, and what opening, loading and flushing the cache cost.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t placeCount = 500;
+const uint32_t beaconsPerPlace = 6;
+const int firstSession = 120;
+const int secondSession = 30;
+
+struct Place {
+    std::vector<double> distances; // the first beacon is the nearest
+};
+
+std::vector<Place> makePlaces()
+{
+    SplitMix64 random(31);
+    std::vector<Place> places(placeCount);
+    for (Place &place : places) {
+        double nearest = 1.0 + 2.0 * random.uniform();
+        place.distances.push_back(nearest);
+        for (uint32_t i = 1; i < beaconsPerPlace; i++) {
+            place.distances.push_back(nearest * (1.6 + 3.0 * random.uniform()));
+        }
+    }
+    return places;
+}
+
+BIBeaconKey keyForBeacon(uint32_t place, uint32_t beacon)
+{
+    return syntheticBeaconKey(place * beaconsPerPlace + beacon);
+}
+
+std::vector<BIBeaconSample> rangeTick(const Place &place, uint32_t placeIndex, SplitMix64 &random)
+{
+    std::vector<BIBeaconSample> samples;
+    for (uint32_t i = 0; i < beaconsPerPlace; i++) {
+        if (random.uniform() >= 0.9) {
+            continue;
+        }
+        double distance = place.distances[i] * std::exp(0.25 * random.normal());
+        BIBeaconSample sample;
+        sample.key = keyForBeacon(placeIndex, i);
+        sample.RSSI = std::min(-1, int32_t(std::lround(-59.0 - 20.0 * std::log10(place.distances[i]) +
+                                                       4.0 * random.normal())));
+        sample.accuracy = distance;
+        sample.proximity = BIProximityForAccuracy(distance);
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+void updateTracker(BISmoothingEngineRef engine, BINearestBeaconTrackerRef tracker, double timestamp)
+{
+    BIBeaconHandle handles[beaconsPerPlace * 2];
+    size_t count = BISmoothingEngineCopyDroppedHandles(engine, handles, beaconsPerPlace * 2);
+    for (size_t i = 0; i < count; i++) {
+        BINearestBeaconTrackerRemove(tracker, handles[i]);
+    }
+    count = BISmoothingEngineCopyChangedHandles(engine, handles, beaconsPerPlace * 2);
+    for (size_t i = 0; i < count; i++) {
+        BISignal signal;
+        if (BISmoothingEngineGetSmoothedSignalForHandle(engine, handles[i], &signal)) {
+            BINearestBeaconTrackerUpdate(tracker, handles[i], &signal);
+        }
+    }
+    BINearestBeaconTrackerEvaluate(tracker, timestamp);
+}
+
+struct Outcome {
+    double settled; // time after which the nearest beacon was right until the end, or NaN
+    bool firstWrong;
+};
+
+Outcome runSession(const Place &place, uint32_t placeIndex, const BISmoothingConfiguration &configuration,
+                   BIBeaconCacheRef cache, uint64_t seed)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(&configuration);
+    BINearestBeaconTrackerRef tracker = BINearestBeaconTrackerCreate(nullptr);
+    if (cache != nullptr) {
+        for (uint32_t i = 0; i < beaconsPerPlace; i++) {
+            BIBeaconKey key = keyForBeacon(placeIndex, i);
+            BICachedBeacon cached;
+            if (!BIBeaconCacheLookup(cache, &key, &cached) || !(cached.fields & BICachedBeaconFieldSignal)) {
+                continue;
+            }
+            BIBeaconSample sample = {key, cached.RSSI, cached.proximity, cached.accuracy};
+            BIBeaconHandle handle = BISmoothingEngineRestoreSample(engine, 0.0, &sample);
+            BISignal signal;
+            if (BISmoothingEngineGetSmoothedSignalForHandle(engine, handle, &signal)) {
+                BINearestBeaconTrackerUpdate(tracker, handle, &signal);
+            }
+        }
+        BINearestBeaconTrackerEvaluate(tracker, 0.0);
+    }
+
+    BIBeaconKey nearestKey = keyForBeacon(placeIndex, 0);
+    Outcome outcome = {NAN, false};
+    bool reported = false;
+    SplitMix64 random(seed);
+    for (int t = 1; t <= secondSession; t++) {
+        std::vector<BIBeaconSample> samples = rangeTick(place, placeIndex, random);
+        BISmoothingEngineProcessTick(engine, double(t), samples.data(), samples.size());
+        updateTracker(engine, tracker, double(t));
+        BIBeaconHandle nearest = BINearestBeaconTrackerGetNearest(tracker);
+        bool right = false;
+        for (size_t i = 0; i < BISmoothingEngineGetBeaconCount(engine); i++) {
+            BIBeaconKey key;
+            if (BISmoothingEngineGetBeaconHandleAtIndex(engine, i) == nearest &&
+                BISmoothingEngineGetBeaconKeyAtIndex(engine, i, &key)) {
+                right = BIBeaconKeyEqual(&key, &nearestKey);
+            }
+        }
+        if (nearest != BIBeaconHandleInvalid && !reported) {
+            reported = true;
+            outcome.firstWrong = !right;
+        }
+        if (!right) {
+            outcome.settled = NAN;
+        } else if (std::isnan(outcome.settled)) {
+            outcome.settled = double(t);
+        }
+    }
+    BINearestBeaconTrackerDestroy(tracker);
+    BISmoothingEngineDestroy(engine);
+    return outcome;
+}
+
+struct Summary {
+    std::vector<double> settled;
+    uint32_t unsettled = 0;
+    uint32_t firstWrong = 0;
+
+    void add(const Outcome &outcome)
+    {
+        if (std::isnan(outcome.settled)) {
+            unsettled++;
+        } else {
+            settled.push_back(outcome.settled);
+        }
+        firstWrong += outcome.firstWrong ? 1 : 0;
+    }
+};
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) {
+        return NAN;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, size_t(p * double(values.size())))];
+}
+
+double mean(const std::vector<double> &values)
+{
+    double sum = 0.0;
+    for (double value : values) {
+        sum += value;
+    }
+    return values.empty() ? NAN : sum / double(values.size());
+}
+
+void print(const char *filter, const char *start, const Summary &summary)
+{
+    std::printf("%-15s %-5s %8.2f %8.1f %8.1f %10.1f%% %10.1f%%\n", filter, start, mean(summary.settled),
+                percentile(summary.settled, 0.5), percentile(summary.settled, 0.9),
+                100.0 * summary.firstWrong / placeCount, 100.0 * summary.unsettled / placeCount);
+}
+
+double elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "bi-bench-cache.bicache";
+    std::remove(path);
+    BIBeaconCacheConfiguration configuration = BIBeaconCacheConfigurationMakeDefault();
+    configuration.maximumBeacons = placeCount * beaconsPerPlace;
+    std::vector<Place> places = makePlaces();
+
+    // First session: every place is ranged for a while, and the cache is flushed after each place.
+    BIBeaconCacheRef cache = BIBeaconCacheOpen(path, &configuration);
+    if (cache == nullptr) {
+        std::fprintf(stderr, "bi-bench-cache: cannot create %s\n", path);
+        return 1;
+    }
+    BISmoothingConfiguration smoothing = BISmoothingConfigurationMakeDefault();
+    std::chrono::steady_clock::duration flushTime{0};
+    for (uint32_t p = 0; p < placeCount; p++) {
+        BISmoothingEngineRef engine = BISmoothingEngineCreate(&smoothing);
+        SplitMix64 random(1000 + p);
+        for (int t = 1; t <= firstSession; t++) {
+            std::vector<BIBeaconSample> samples = rangeTick(places[p], p, random);
+            BISmoothingEngineProcessTick(engine, double(t), samples.data(), samples.size());
+        }
+        for (uint32_t i = 0; i < beaconsPerPlace; i++) {
+            BICachedBeacon beacon = {};
+            beacon.key = keyForBeacon(p, i);
+            BISignal signal;
+            if (BISmoothingEngineGetSmoothedSignal(engine, &beacon.key, &signal) && signal.inRange) {
+                beacon.fields = BICachedBeaconFieldSignal;
+                beacon.lastSeen = signal.timestamp;
+                beacon.RSSI = signal.RSSI;
+                beacon.proximity = signal.proximity;
+                beacon.accuracy = signal.accuracy;
+                BIBeaconCacheUpdate(cache, &beacon);
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        BIBeaconCacheFlush(cache);
+        flushTime += std::chrono::steady_clock::now() - start;
+        BISmoothingEngineDestroy(engine);
+    }
+    BIBeaconCacheStatistics written = BIBeaconCacheGetStatistics(cache);
+    BIBeaconCacheClose(cache);
+
+    // Relaunch.
+    auto start = std::chrono::steady_clock::now();
+    cache = BIBeaconCacheOpen(path, &configuration);
+    double openSeconds = elapsed(start);
+    start = std::chrono::steady_clock::now();
+    size_t cachedCount = BIBeaconCacheGetCount(cache);
+    double loadSeconds = elapsed(start);
+
+    std::printf("cache: %zu beacons, %llu records appended in %llu compactions and %u flushes of %u beacons "
+                "(%.1f us per flush)\n",
+                cachedCount, (unsigned long long)written.recordsAppended, (unsigned long long)written.compactions,
+                placeCount, beaconsPerPlace,
+                1e6 * std::chrono::duration<double>(flushTime).count() / double(placeCount));
+    std::printf("relaunch: opening the cache took %.1f us, loading it on first access %.1f us\n\n", 1e6 * openSeconds,
+                1e6 * loadSeconds);
+
+    std::printf("%-15s %-5s %8s %8s %8s %11s %11s\n", "filter", "start", "settled", "median", "p90", "first wrong",
+                "unsettled");
+    const BISmoothingFilter filters[] = {BISmoothingFilterWindowAverage, BISmoothingFilterEWMA, BISmoothingFilterKalman,
+                                         BISmoothingFilterMedian};
+    const char *names[] = {"window average", "EWMA", "Kalman", "median"};
+    bool warmBetter = true;
+    for (size_t f = 0; f < 4; f++) {
+        smoothing.filter = filters[f];
+        Summary cold;
+        Summary warm;
+        for (uint32_t p = 0; p < placeCount; p++) {
+            cold.add(runSession(places[p], p, smoothing, nullptr, 2000 + p));
+            warm.add(runSession(places[p], p, smoothing, cache, 2000 + p));
+        }
+        print(names[f], "cold", cold);
+        print(names[f], "warm", warm);
+        warmBetter = warmBetter && mean(warm.settled) <= mean(cold.settled);
+    }
+    std::printf("\nsettled: seconds after launch until the nearest beacon is right for the rest of the %d s "
+                "(mean, median, p90)\n",
+                secondSession);
+
+    BIBeaconCacheClose(cache);
+    std::remove(path);
+    return warmBetter ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+//
+//  bi-bench-distance.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Microbenchmark of the distance estimation kernels at 64, 512 and 4096 beacons per batch, compared with estimating
+// one beacon at a time with libm's pow(). Before measuring, checks that every available kernel produces bit-identical
+// results to the scalar kernel and reports the largest deviation from the libm-based reference.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+struct Kernel {
+    BIDistanceKernel kernel;
+    const char *name;
+};
+
+const Kernel kernels[] = {
+    {BIDistanceKernelScalar, "scalar"},
+    {BIDistanceKernelSSE2, "SSE2"},
+    {BIDistanceKernelAVX2, "AVX2"},
+    {BIDistanceKernelNEON, "NEON"},
+};
+
+struct Batch {
+    std::vector<int32_t> RSSI;
+    std::vector<int32_t> txPower;
+    std::vector<double> distances;
+    std::vector<double> accuracies;
+    std::vector<int32_t> proximities;
+
+    explicit Batch(size_t count, uint64_t seed)
+    {
+        SplitMix64 random(seed);
+        for (size_t i = 0; i < count; i++) {
+            // Mostly plausible values, with unknown RSSIs and odd TX powers mixed in.
+            double choice = random.uniform();
+            RSSI.push_back(choice < 0.05 ? 0 : -30 - int32_t(random.next() % 70));
+            txPower.push_back(choice > 0.97 ? 45 : -30 + int32_t(random.next() % 35));
+        }
+        distances.resize(count);
+        accuracies.resize(count);
+        proximities.resize(count);
+    }
+};
+
+// The per-beacon computation as it would be written without the batch API.
+void estimateWithLibm(const BIDistanceModel &model, Batch &batch)
+{
+    for (size_t i = 0; i < batch.RSSI.size(); i++) {
+        double RSSI = batch.RSSI[i];
+        double measuredPower = batch.txPower[i] + model.referenceLoss;
+        if (RSSI >= 0.0 || measuredPower >= 0.0) {
+            batch.distances[i] = -1.0;
+            batch.accuracies[i] = -1.0;
+            batch.proximities[i] = BIProximityUnknown;
+            continue;
+        }
+        batch.distances[i] = std::pow(10.0, (measuredPower - RSSI) / (10.0 * model.pathLossExponent));
+        double ratio = RSSI / measuredPower;
+        batch.accuracies[i] = (ratio < 1.0) ? std::pow(ratio, 10.0)
+                                            : model.accuracyScale * std::pow(ratio, model.accuracyExponent) + model.accuracyOffset;
+        batch.proximities[i] = BIProximityForAccuracy(batch.accuracies[i]);
+    }
+}
+
+bool verify(const BIDistanceModel &model)
+{
+    // Odd sizes exercise the scalar tail of the vector kernels.
+    const size_t count = 100003;
+    Batch reference(count, 1);
+    BIEstimateDistancesWithKernel(BIDistanceKernelScalar, &model, reference.RSSI.data(), reference.txPower.data(), count,
+                                  reference.distances.data(), reference.accuracies.data(), reference.proximities.data());
+
+    bool identical = true;
+    for (const Kernel &kernel : kernels) {
+        if (!BIDistanceKernelIsAvailable(kernel.kernel)) {
+            std::printf("%-8s not available\n", kernel.name);
+            continue;
+        }
+        Batch batch(count, 1);
+        BIEstimateDistancesWithKernel(kernel.kernel, &model, batch.RSSI.data(), batch.txPower.data(), count,
+                                      batch.distances.data(), batch.accuracies.data(), batch.proximities.data());
+        bool same = std::memcmp(batch.distances.data(), reference.distances.data(), count * sizeof(double)) == 0 &&
+                    std::memcmp(batch.accuracies.data(), reference.accuracies.data(), count * sizeof(double)) == 0 &&
+                    std::memcmp(batch.proximities.data(), reference.proximities.data(), count * sizeof(int32_t)) == 0;
+        std::printf("%-8s %s\n", kernel.name, same ? "bit-identical to scalar" : "MISMATCH");
+        identical = identical && same;
+    }
+
+    Batch libm(count, 1);
+    estimateWithLibm(model, libm);
+    double maximumError = 0.0;
+    size_t proximityMismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (libm.distances[i] > 0.0) {
+            maximumError = std::max(maximumError, std::fabs(reference.distances[i] / libm.distances[i] - 1.0));
+            maximumError = std::max(maximumError, std::fabs(reference.accuracies[i] / libm.accuracies[i] - 1.0));
+        }
+        proximityMismatches += (libm.proximities[i] != reference.proximities[i]) ? 1 : 0;
+    }
+    std::printf("largest relative deviation from libm: %.2e, proximity mismatches: %zu\n\n", maximumError, proximityMismatches);
+    return identical;
+}
+
+template <typename Function>
+double nanosecondsPerBeacon(size_t count, Function function)
+{
+    const size_t beaconsPerRun = 4000000;
+    size_t repetitions = beaconsPerRun / count;
+    function(); // warm up
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < repetitions; r++) {
+        function();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(repetitions * count);
+}
+
+} // namespace
+
+int main()
+{
+    BIDistanceModel model = BIDistanceModelMakeDefault();
+    bool identical = verify(model);
+
+    const size_t batchSizes[] = {64, 512, 4096};
+    std::printf("%-8s", "batch");
+    std::printf(" %12s", "libm");
+    for (const Kernel &kernel : kernels) {
+        if (BIDistanceKernelIsAvailable(kernel.kernel)) {
+            std::printf(" %12s", kernel.name);
+        }
+    }
+    std::printf("   (ns/beacon)\n");
+
+    for (size_t batchSize : batchSizes) {
+        Batch batch(batchSize, batchSize);
+        std::printf("%-8zu", batchSize);
+        std::printf(" %12.2f", nanosecondsPerBeacon(batchSize, [&] { estimateWithLibm(model, batch); }));
+        for (const Kernel &kernel : kernels) {
+            if (!BIDistanceKernelIsAvailable(kernel.kernel)) {
+                continue;
+            }
+            double nanoseconds = nanosecondsPerBeacon(batchSize, [&] {
+                BIEstimateDistancesWithKernel(kernel.kernel, &model, batch.RSSI.data(), batch.txPower.data(), batchSize,
+                                              batch.distances.data(), batch.accuracies.data(), batch.proximities.data());
+            });
+            std::printf(" %12.2f", nanoseconds);
+        }
+        std::printf("\n");
+    }
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+//
+//  bi-bench-duty-cycle.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Replays a trace once with continuous ranging and then through the duty cycle with several radio budgets, dropping
+// the ranging records that arrive while the duty cycle has ranging off. Reports the radio time against how late each
+// nearest-beacon change of the continuous run is seen, and how many are missed. Without a trace argument, a ten-hour
+// staff shift is synthesized: walks between 40 rooms in three wings (one region each), long stays in rooms and a
+// lunch break outside the building.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t roomCount = 40;
+const uint32_t wingCount = 3;
+const double roomSpacing = 8.0;
+const double rangingRange = 20.0;
+const double shiftDuration = 10.0 * 60.0 * 60.0;
+const double startTime = 1000.0;
+
+uint32_t wingOfRoom(uint32_t room)
+{
+    return room * wingCount / roomCount;
+}
+
+// Writes the shift as a trace. The device walks at 1.2 m/s along the corridor between rooms, stays in each room for
+// an exponentially distributed time (mean 12 minutes, at least one), and leaves the building for lunch after five
+// hours. Wings are entered 2 seconds after their first beacon is in range and left 30 seconds after the last one.
+bool synthesizeShift(const char *path)
+{
+    BITraceRecorderRef recorder = BITraceRecorderCreate(path, nullptr);
+    if (recorder == nullptr) {
+        return false;
+    }
+    SplitMix64 random(17);
+    std::vector<bool> inside(wingCount, false);
+    std::vector<double> lastInRange(wingCount, -1e9);
+    std::vector<double> firstInRange(wingCount, NAN);
+    for (uint32_t wing = 0; wing < wingCount; wing++) {
+        char identifier[32];
+        std::snprintf(identifier, sizeof(identifier), "wing-%c", char('A' + wing));
+        BITraceRecorderRecordRegionDefinition(recorder, wing + 1, startTime, identifier);
+    }
+
+    double position = -60.0; // the entrance lies before the first room
+    double target = position;
+    double stayUntil = startTime + 300.0;
+    bool lunchTaken = false;
+    std::vector<BIBeaconSample> samples;
+    for (double t = startTime; t < startTime + shiftDuration; t += 1.0) {
+        if (std::fabs(target - position) > 0.6) {
+            position += target > position ? 1.2 : -1.2;
+        } else if (t >= stayUntil) {
+            if (!lunchTaken && t - startTime > 5.0 * 60.0 * 60.0) {
+                lunchTaken = true;
+                target = -60.0;
+                stayUntil = t + 30.0 * 60.0 + 120.0;
+            } else {
+                target = roomSpacing * double(random.next() % roomCount);
+                stayUntil = t + std::fabs(target - position) / 1.2 + std::max(60.0, -720.0 * std::log(1.0 - random.uniform()));
+            }
+        }
+
+        for (uint32_t wing = 0; wing < wingCount; wing++) {
+            samples.clear();
+            for (uint32_t room = 0; room < roomCount; room++) {
+                if (wingOfRoom(room) != wing) {
+                    continue;
+                }
+                double dx = roomSpacing * room - position;
+                double distance = std::sqrt(dx * dx + 9.0);
+                if (distance > rangingRange || random.uniform() >= 0.9) {
+                    continue;
+                }
+                BIBeaconSample sample;
+                sample.key = syntheticBeaconKey(room);
+                sample.RSSI = std::min(-30, int32_t(std::lround(-59.0 - 20.0 * std::log10(distance) + 3.0 * random.normal())));
+                sample.accuracy = distance * std::exp(0.2 * random.normal());
+                sample.proximity = BIProximityForAccuracy(sample.accuracy);
+                samples.push_back(sample);
+            }
+            if (!samples.empty()) {
+                lastInRange[wing] = t;
+                if (std::isnan(firstInRange[wing])) {
+                    firstInRange[wing] = t;
+                }
+            } else if (!inside[wing]) {
+                firstInRange[wing] = NAN;
+            }
+            if (!inside[wing] && !std::isnan(firstInRange[wing]) && t - firstInRange[wing] >= 2.0) {
+                inside[wing] = true;
+                BITraceRecorderRecordRegionEvent(recorder, wing + 1, t, BIRegionEventEnter);
+            } else if (inside[wing] && t - lastInRange[wing] >= 30.0) {
+                inside[wing] = false;
+                firstInRange[wing] = NAN;
+                BITraceRecorderRecordRegionEvent(recorder, wing + 1, t, BIRegionEventExit);
+            }
+            if (inside[wing]) {
+                BITraceRecorderRecordRanging(recorder, wing + 1, t, samples.data(), samples.size());
+            }
+        }
+    }
+    BITraceRecorderDestroy(recorder);
+    return true;
+}
+
+struct Change {
+    double timestamp;
+    uint32_t region; // trace region ID
+    bool hasNearest;
+    BIBeaconKey nearest;
+};
+
+struct Replay {
+    BIDutyCycleRef dutyCycle = nullptr;
+    std::map<uint32_t, uint32_t> traceRegionsByPipelineID;
+    std::vector<Change> changes;
+    uint64_t rangingRecords = 0;
+    uint64_t droppedRecords = 0;
+    uint64_t rangingTicks = 0; // distinct timestamps of the ranging records that reached the pipeline
+    double firstTimestamp = NAN;
+    double lastTimestamp = NAN;
+};
+
+void handleBatch(const BIRangingBatch *batch, void *context)
+{
+    Replay &replay = *static_cast<Replay *>(context);
+    for (size_t i = 0; i < batch->regionCount; i++) {
+        const BIRegionRangingResult &region = batch->regions[i];
+        if (region.nearestBeaconChanged) {
+            Change change = {batch->timestamp, replay.traceRegionsByPipelineID[region.regionID], region.nearestBeacon != nullptr,
+                             region.nearestBeacon != nullptr ? region.nearestBeacon->key : BIBeaconKey()};
+            replay.changes.push_back(change);
+        }
+    }
+    if (replay.dutyCycle != nullptr) {
+        BIDutyCycleReportBatch(replay.dutyCycle, batch);
+    }
+}
+
+// Replays the trace through a synchronous pipeline. With a duty cycle, ranging records only reach the pipeline while
+// it has ranging on, and the duty cycle's timer is fired at the times it asks for. Regions count as active from their
+// first enter (or first ranging record, for traces without monitoring events) until they are left.
+bool replay(const char *path, const BIDutyCycleConfiguration *configuration, Replay &replay, BIDutyCycleStatistics &statistics)
+{
+    BITraceReaderRef reader = BITraceReaderCreate(path);
+    if (reader == nullptr) {
+        return false;
+    }
+    BIRangingPipelineConfiguration pipelineConfiguration = BIRangingPipelineConfigurationMakeDefault();
+    pipelineConfiguration.synchronous = true;
+    BIRangingPipelineRef pipeline =
+        BIRangingPipelineCreate(&pipelineConfiguration, BIDeliveryQueue{nullptr, nullptr}, &handleBatch, &replay);
+    std::map<uint32_t, uint32_t> pipelineIDs;
+    std::map<uint32_t, bool> inside;
+
+    BITraceRecord record;
+    BIDutyCycleState state = {BIDutyCycleModeContinuous, true, 1.0, INFINITY};
+    double rangingTimestamp = NAN;
+    while (BITraceReaderNext(reader, &record)) {
+        double t = record.timestamp;
+        if (std::isnan(replay.firstTimestamp)) {
+            replay.firstTimestamp = t;
+            if (configuration != nullptr) {
+                replay.dutyCycle = BIDutyCycleCreate(configuration, t);
+                state = BIDutyCycleAdvance(replay.dutyCycle, t);
+            }
+        }
+        replay.lastTimestamp = t;
+        if (t != rangingTimestamp && !std::isnan(rangingTimestamp)) {
+            // All regions of the previous ranging tick have reported.
+            BIRangingPipelineFlush(pipeline);
+            rangingTimestamp = NAN;
+        }
+        if (replay.dutyCycle != nullptr) {
+            while (state.nextChange <= t) {
+                state = BIDutyCycleAdvance(replay.dutyCycle, state.nextChange);
+            }
+            state = BIDutyCycleAdvance(replay.dutyCycle, t);
+        }
+
+        bool activeRegionsChanged = false;
+        switch (record.type) {
+        case BITraceRecordRanging: {
+            replay.rangingRecords++;
+            if (inside.find(record.regionID) == inside.end()) {
+                inside[record.regionID] = true;
+                activeRegionsChanged = true;
+            }
+            if (!state.ranging) {
+                replay.droppedRecords++;
+                break;
+            }
+            auto it = pipelineIDs.find(record.regionID);
+            if (it == pipelineIDs.end()) {
+                it = pipelineIDs.emplace(record.regionID, BIRangingPipelineAddRegion(pipeline)).first;
+                replay.traceRegionsByPipelineID[it->second] = record.regionID;
+            }
+            BIRangingPipelineSubmit(pipeline, it->second, t, record.samples, record.sampleCount);
+            replay.rangingTicks += t != rangingTimestamp ? 1 : 0;
+            rangingTimestamp = t;
+            break;
+        }
+        case BITraceRecordRegionEvent: {
+            bool isInside = record.regionEvent == BIRegionEventEnter || record.regionEvent == BIRegionEventStateInside;
+            bool isOutside = record.regionEvent == BIRegionEventExit || record.regionEvent == BIRegionEventStateOutside;
+            if (isInside || isOutside) {
+                inside[record.regionID] = isInside;
+                activeRegionsChanged = true;
+            }
+            if (replay.dutyCycle != nullptr) {
+                BIDutyCycleReportRegionEvent(replay.dutyCycle, t, record.regionEvent);
+            }
+            break;
+        }
+        case BITraceRecordBluetoothState:
+            if (replay.dutyCycle != nullptr) {
+                BIDutyCycleSetBluetoothState(replay.dutyCycle, t, record.bluetoothState);
+            }
+            break;
+        default:
+            break;
+        }
+        if (activeRegionsChanged && replay.dutyCycle != nullptr) {
+            uint32_t count = 0;
+            for (const auto &region : inside) {
+                count += region.second ? 1 : 0;
+            }
+            BIDutyCycleSetActiveRegionCount(replay.dutyCycle, t, count);
+        }
+        if (replay.dutyCycle != nullptr) {
+            state = BIDutyCycleAdvance(replay.dutyCycle, t);
+        }
+    }
+    BIRangingPipelineFlush(pipeline);
+    bool ok = BITraceReaderGetError(reader) == nullptr;
+    if (replay.dutyCycle != nullptr) {
+        BIDutyCycleAdvance(replay.dutyCycle, replay.lastTimestamp);
+        statistics = BIDutyCycleGetStatistics(replay.dutyCycle);
+        BIDutyCycleDestroy(replay.dutyCycle);
+        replay.dutyCycle = nullptr;
+    }
+    BIRangingPipelineDestroy(pipeline);
+    BITraceReaderDestroy(reader);
+    return ok;
+}
+
+struct Detection {
+    std::vector<double> latencies;
+    size_t missed = 0;
+};
+
+bool reports(const Change &change, const BIBeaconKey &nearest)
+{
+    return change.hasNearest && BIBeaconKeyEqual(&change.nearest, &nearest);
+}
+
+// Matches every change to a nearest beacon in the continuous run with the first time the duty-cycled run reports the
+// same nearest beacon for the region, before the continuous run changes again. A beacon the duty-cycled run already
+// reported as nearest counts as detected right away.
+Detection detect(const std::vector<Change> &reference, const std::vector<Change> &observed)
+{
+    std::map<uint32_t, std::vector<const Change *>> observedByRegion;
+    for (const Change &change : observed) {
+        observedByRegion[change.region].push_back(&change);
+    }
+    Detection detection;
+    for (size_t i = 0; i < reference.size(); i++) {
+        const Change &change = reference[i];
+        if (!change.hasNearest) {
+            continue;
+        }
+        double until = INFINITY;
+        for (size_t j = i + 1; j < reference.size(); j++) {
+            if (reference[j].region == change.region) {
+                until = reference[j].timestamp;
+                break;
+            }
+        }
+        const std::vector<const Change *> &changes = observedByRegion[change.region];
+        auto next = std::upper_bound(changes.begin(), changes.end(), change.timestamp,
+                                     [](double timestamp, const Change *candidate) { return timestamp < candidate->timestamp; });
+        double detected = NAN;
+        if (next != changes.begin() && reports(**(next - 1), change.nearest)) {
+            detected = change.timestamp;
+        }
+        for (; std::isnan(detected) && next != changes.end() && (*next)->timestamp < until; ++next) {
+            if (reports(**next, change.nearest)) {
+                detected = (*next)->timestamp;
+            }
+        }
+        if (std::isnan(detected)) {
+            detection.missed++;
+        } else {
+            detection.latencies.push_back(detected - change.timestamp);
+        }
+    }
+    std::sort(detection.latencies.begin(), detection.latencies.end());
+    return detection;
+}
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    return sorted.empty() ? NAN : sorted[std::min(sorted.size() - 1, size_t(p * double(sorted.size())))];
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "bi-bench-duty-cycle.bitrace";
+    if (argc == 1 && !synthesizeShift(path)) {
+        std::fprintf(stderr, "bi-bench-duty-cycle: cannot create %s\n", path);
+        return 1;
+    }
+
+    Replay reference;
+    BIDutyCycleStatistics unused;
+    if (!replay(path, nullptr, reference, unused)) {
+        std::fprintf(stderr, "bi-bench-duty-cycle: cannot replay %s\n", path);
+        return 1;
+    }
+    double duration = reference.lastTimestamp - reference.firstTimestamp;
+    size_t referenceChanges = 0;
+    for (const Change &change : reference.changes) {
+        referenceChanges += change.hasNearest ? 1 : 0;
+    }
+    std::printf("%.1f hours, %llu ranging records, %zu nearest-beacon changes with continuous ranging\n\n",
+                duration / 3600.0, (unsigned long long)reference.rangingRecords, referenceChanges);
+
+    std::printf("%-22s %9s %9s %9s %8s %8s %8s %8s\n", "duty cycle", "radio", "records", "windows", "p50", "p90", "max",
+                "missed");
+    std::printf("%-22s %8.1f%% %9llu\n", "continuous", 100.0 * double(reference.rangingTicks) / duration,
+                (unsigned long long)reference.rangingRecords);
+    const double budgets[] = {1.0, 0.25, 0.1};
+    bool ok = true;
+    for (double budget : budgets) {
+        BIDutyCycleConfiguration configuration = BIDutyCycleConfigurationMakeDefault();
+        configuration.radioBudget = budget;
+        Replay adaptive;
+        BIDutyCycleStatistics statistics;
+        replay(path, &configuration, adaptive, statistics);
+        Detection detection = detect(reference.changes, adaptive.changes);
+        char name[32];
+        std::snprintf(name, sizeof(name), budget < 1.0 ? "budget %.0f%%" : "adaptive", 100.0 * budget);
+        std::printf("%-22s %8.1f%% %9llu %9llu %7.1fs %7.1fs %7.1fs %7.1f%%\n", name, 100.0 * statistics.rangingTime / duration,
+                    (unsigned long long)(adaptive.rangingRecords - adaptive.droppedRecords),
+                    (unsigned long long)statistics.windows, percentile(detection.latencies, 0.5),
+                    percentile(detection.latencies, 0.9), detection.latencies.empty() ? NAN : detection.latencies.back(),
+                    referenceChanges > 0 ? 100.0 * detection.missed / referenceChanges : 0.0);
+        if (budget >= 1.0) {
+            ok = statistics.rangingTime < 0.6 * double(reference.rangingTicks) && detection.missed <= referenceChanges / 10;
+        }
+    }
+    std::printf("\nradio: share of the trace with ranging on (continuous: seconds with ranging records)\n"
+                "p50, p90, max: delay until a nearest-beacon change of the continuous run is reported\n");
+
+    if (argc == 1) {
+        std::remove(path);
+    }
+    return ok ? 0 : 1;
+}
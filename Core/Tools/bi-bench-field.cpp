@@ -0,0 +1,312 @@
+//
+//  bi-bench-field.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Runs virtual users through a simulated venue (see SimulatedField.hpp), by default 1,000 users for a minute among
+// 10,000 beacons on four floors, with 1 thread up to one per core. Each user runs what the SDK runs on a phone: a
+// device scanner fed with the decoded advertisements, and a smoothing engine, nearest-beacon tracker (with the beacon
+// locations) and region monitor (one region per major) fed with the ranging samples. Reports the simulated
+// user-seconds per second of wall time for the simulator alone and with the engines, i.e. how many users one machine
+// can keep up with in real time, and how often the nearest beacon is one of the three beacons geometrically nearest to
+// the user.
+//
+// The users are spread over the threads in blocks. The digest of what all engines reported must be the same for every
+// thread count and for a run with uneven blocks; the tool exits with 1 if not.
+
+#include <BICore/BICore.h>
+
+#include "SimulatedField.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "usage: bi-bench-field [options]\n"
+                 "\n"
+                 "options:\n"
+                 "  --beacons N     beacons in the venue (default: 10000)\n"
+                 "  --floors N      floors of the venue (default: 4)\n"
+                 "  --users N       virtual users (default: 1000)\n"
+                 "  --duration S    simulated seconds (default: 60)\n"
+                 "  --threads N     largest number of threads (default: one per core)\n");
+}
+
+uint64_t mix(uint64_t digest, uint64_t value)
+{
+    return SplitMix64(digest ^ value).next();
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct UserResult {
+    uint64_t digest;
+    uint64_t packets;
+    uint64_t samples;
+    uint64_t transitions;
+    uint32_t ticksWithNearest;
+    uint32_t nearestAgreement;
+};
+
+void recordTransition(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context)
+{
+    UserResult *result = static_cast<UserResult *>(context);
+    result->digest = mix(result->digest, (uint64_t(regionID) << 8) ^ uint64_t(transition) ^ (uint64_t(timestamp) << 32));
+    result->transitions++;
+}
+
+void recordScan(const BIDeviceScanDelta *delta, void *context)
+{
+    UserResult *result = static_cast<UserResult *>(context);
+    result->digest = mix(result->digest, (uint64_t(delta->addedCount) << 32) ^ (uint64_t(delta->lostCount) << 16) ^
+                                             uint64_t(delta->updatedCount));
+}
+
+// The streams of the simulator alone.
+UserResult simulate(const SimulatedField &field, uint32_t user, uint32_t duration)
+{
+    SimulatedUser simulated(field, 1000 + user, true);
+    UserResult result = {};
+    for (uint32_t second = 0; second < duration; second++) {
+        const std::vector<BIBeaconSample> &samples = simulated.nextTick();
+        for (const BIBeaconSample &sample : samples) {
+            result.digest = mix(result.digest, (uint64_t(syntheticBeaconIndex(sample.key)) << 32) ^ uint32_t(sample.RSSI));
+        }
+        for (const SimulatedPacket &packet : simulated.packets()) {
+            result.digest = mix(result.digest, (uint64_t(packet.beacon) << 32) ^ uint32_t(packet.RSSI));
+        }
+        result.samples += samples.size();
+        result.packets += simulated.packets().size();
+    }
+    return result;
+}
+
+// The streams fed into the engines of a phone.
+UserResult run(const SimulatedField &field, uint32_t user, uint32_t duration)
+{
+    UserResult result = {};
+    SimulatedUser simulated(field, 1000 + user, true);
+    BIDeviceScannerRef scanner = BIDeviceScannerCreate(nullptr, recordScan, &result);
+    BIBeaconTableRef table = BIBeaconTableCreate(nullptr);
+    BISmoothingEngineRef engine = BISmoothingEngineCreateWithBeaconTable(nullptr, table);
+    BINearestBeaconTrackerRef tracker = BINearestBeaconTrackerCreate(nullptr);
+    BIRegionMonitorRef monitor = BIRegionMonitorCreate(nullptr, recordTransition, &result);
+    std::vector<uint32_t> regionIDs((field.beaconCount() + 999) / 1000);
+    for (uint32_t &regionID : regionIDs) {
+        regionID = BIRegionMonitorAddRegion(monitor);
+    }
+
+    std::vector<BIBeaconHandle> handles;
+    std::vector<size_t> inRange(regionIDs.size());
+    BISpatialMatch nearest[3];
+    for (uint32_t second = 0; second < duration; second++) {
+        const std::vector<BIBeaconSample> &samples = simulated.nextTick();
+        double timestamp = simulated.timestamp();
+        for (const SimulatedPacket &packet : simulated.packets()) {
+            const Packet &payload = field.payload(packet.beacon);
+            BIAdvertisement advertisement;
+            BIPeripheralIdentifier identifier = SimulatedField::identifier(packet.beacon);
+            bool decoded = BIAdvertisementDecodePayload(payload.data(), payload.size(), &advertisement);
+            BIDeviceScannerReportPacket(scanner, &identifier, packet.timestamp, packet.RSSI,
+                                        decoded ? &advertisement : nullptr);
+        }
+        BIDeviceScannerAdvance(scanner, timestamp);
+        result.packets += simulated.packets().size();
+        result.samples += samples.size();
+
+        BISmoothingEngineProcessTick(engine, timestamp, samples.data(), samples.size());
+        handles.resize(BISmoothingEngineGetBeaconCount(engine));
+        size_t droppedCount = BISmoothingEngineCopyDroppedHandles(engine, handles.data(), handles.size());
+        for (size_t i = 0; i < droppedCount; i++) {
+            BINearestBeaconTrackerRemove(tracker, handles[i]);
+        }
+        size_t changedCount = BISmoothingEngineCopyChangedHandles(engine, handles.data(), handles.size());
+        for (size_t i = 0; i < changedCount; i++) {
+            BISignal signal;
+            BIBeaconKey key;
+            BISmoothingEngineGetSmoothedSignalForHandle(engine, handles[i], &signal);
+            BINearestBeaconTrackerUpdate(tracker, handles[i], &signal);
+            if (signal.inRange && BIBeaconTableGetKey(table, handles[i], &key)) {
+                BINearestBeaconTrackerSetLocation(tracker, handles[i], &field.beacon(syntheticBeaconIndex(key)).location);
+            }
+        }
+        BINearestBeaconTrackerEvaluate(tracker, timestamp);
+
+        BIBeaconHandle handle = BINearestBeaconTrackerGetNearest(tracker);
+        BIBeaconKey key;
+        if (handle != BIBeaconHandleInvalid && BIBeaconTableGetKey(table, handle, &key)) {
+            uint32_t beacon = syntheticBeaconIndex(key);
+            result.digest = mix(result.digest, beacon);
+            result.ticksWithNearest++;
+            size_t count = BISpatialIndexFindNearest(field.index(), simulated.floor(), simulated.x(), simulated.y(), 3,
+                                                     nearest);
+            for (size_t i = 0; i < count; i++) {
+                if (syntheticBeaconIndex(nearest[i].location.key) == beacon) {
+                    result.nearestAgreement++;
+                    break;
+                }
+            }
+        }
+
+        std::fill(inRange.begin(), inRange.end(), 0);
+        for (const BIBeaconSample &sample : samples) {
+            if (sample.RSSI != 0) {
+                inRange[sample.key.major - 1]++;
+            }
+        }
+        for (size_t region = 0; region < regionIDs.size(); region++) {
+            BIRegionMonitorReportRanging(monitor, regionIDs[region], timestamp, inRange[region]);
+        }
+        BIRegionMonitorAdvance(monitor, timestamp);
+    }
+
+    BIRegionMonitorDestroy(monitor);
+    BINearestBeaconTrackerDestroy(tracker);
+    BISmoothingEngineDestroy(engine);
+    BIBeaconTableDestroy(table);
+    BIDeviceScannerDestroy(scanner);
+    return result;
+}
+
+typedef UserResult (*UserFunction)(const SimulatedField &field, uint32_t user, uint32_t duration);
+
+// Runs the users in blocks of about users / threadCount, each block on a thread of its own.
+std::vector<UserResult> runUsers(UserFunction function, const SimulatedField &field, uint32_t userCount,
+                                 uint32_t duration, uint32_t threadCount)
+{
+    std::vector<UserResult> results(userCount);
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < threadCount; thread++) {
+        uint32_t begin = uint32_t(uint64_t(userCount) * thread / threadCount);
+        uint32_t end = uint32_t(uint64_t(userCount) * (thread + 1) / threadCount);
+        threads.emplace_back([&, begin, end] {
+            for (uint32_t user = begin; user < end; user++) {
+                results[user] = function(field, user, duration);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return results;
+}
+
+struct Totals {
+    uint64_t digest = 0;
+    uint64_t packets = 0;
+    uint64_t samples = 0;
+    uint64_t transitions = 0;
+    uint64_t ticksWithNearest = 0;
+    uint64_t nearestAgreement = 0;
+};
+
+Totals total(const std::vector<UserResult> &results)
+{
+    Totals totals;
+    for (const UserResult &result : results) {
+        totals.digest = mix(totals.digest, result.digest);
+        totals.packets += result.packets;
+        totals.samples += result.samples;
+        totals.transitions += result.transitions;
+        totals.ticksWithNearest += result.ticksWithNearest;
+        totals.nearestAgreement += result.nearestAgreement;
+    }
+    return totals;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    FieldLayout layout;
+    uint32_t userCount = 1000;
+    uint32_t duration = 60;
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+        if (std::strcmp(argv[i], "--beacons") == 0 && hasValue) {
+            layout.beaconCount = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--floors") == 0 && hasValue) {
+            layout.floorCount = int32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--users") == 0 && hasValue) {
+            userCount = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--duration") == 0 && hasValue) {
+            duration = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            cores = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SimulatedField field(layout, FieldProfile(), 23);
+    std::printf("%u beacons on %d floors of %.0f x %.0f m, %u users, %u s (field built in %.1f ms)\n\n",
+                layout.beaconCount, layout.floorCount, field.width(), field.length(), userCount, duration,
+                1e3 * secondsSince(start));
+
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cores);
+
+    bool identical = true;
+    double userSeconds = double(userCount) * double(duration);
+    std::printf("%-10s %8s %10s %18s %16s %8s\n", "run", "threads", "seconds", "user-seconds/s", "M packets/s",
+                "speedup");
+    const struct {
+        const char *name;
+        UserFunction function;
+    } runs[] = {{"simulator", simulate}, {"engines", run}};
+    Totals totals[2];
+    for (size_t r = 0; r < 2; r++) {
+        double baseline = 0.0;
+        for (uint32_t threads : threadCounts) {
+            start = std::chrono::steady_clock::now();
+            Totals result = total(runUsers(runs[r].function, field, userCount, duration, threads));
+            double seconds = secondsSince(start);
+            if (threads == 1) {
+                totals[r] = result;
+            }
+            identical = identical && result.digest == totals[r].digest;
+            baseline = baseline > 0.0 ? baseline : seconds;
+            std::printf("%-10s %8u %10.3f %18.0f %16.2f %7.2fx\n", runs[r].name, threads, seconds, userSeconds / seconds,
+                        double(result.packets) / seconds / 1e6, baseline / seconds);
+        }
+    }
+
+    // Blocks of uneven size, interleaved with each other on fewer cores.
+    identical = identical && total(runUsers(run, field, userCount, duration, 7)).digest == totals[1].digest;
+
+    const Totals &engines = totals[1];
+    std::printf("\nper user-second: %.1f packets, %.1f ranging samples; %.2f region transitions per user\n",
+                double(engines.packets) / userSeconds, double(engines.samples) / userSeconds,
+                double(engines.transitions) / double(userCount));
+    std::printf("nearest beacon among the 3 geometrically nearest: %.1f%% of %llu ticks with a nearest beacon\n",
+                100.0 * double(engines.nearestAgreement) / double(std::max<uint64_t>(engines.ticksWithNearest, 1)),
+                (unsigned long long)engines.ticksWithNearest);
+    std::printf("digest %016llx\n", (unsigned long long)engines.digest);
+    if (!identical) {
+        std::printf("FAIL: results differ between thread counts\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+//
+//  bi-bench-filters.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Replays 1000 beacons that alternate every 30 seconds between 6 m (far) and 1.2 m (near) through each smoothing
+// filter. Reports the CPU cost per beacon and tick, how long each filter takes to report the new proximity after a
+// real change (the lag it adds), and how often the smoothed proximity flips without a real change (its instability).
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t beaconCount = 1000;
+const uint32_t tickCount = 1200;
+const uint32_t phaseLength = 30;
+const double farDistance = 6.0;
+const double nearDistance = 1.2;
+
+struct Trace {
+    std::vector<std::vector<BIBeaconSample>> ticks;
+    std::vector<uint32_t> phaseOffsets;
+};
+
+double trueDistance(const Trace &trace, uint32_t beacon, uint32_t tick)
+{
+    return (((tick + trace.phaseOffsets[beacon]) / phaseLength) % 2 == 0) ? farDistance : nearDistance;
+}
+
+Trace makeTrace()
+{
+    SplitMix64 random(11);
+    Trace trace;
+    for (uint32_t i = 0; i < beaconCount; i++) {
+        trace.phaseOffsets.push_back(uint32_t(random.next() % phaseLength));
+    }
+    trace.ticks.resize(tickCount);
+    for (uint32_t t = 0; t < tickCount; t++) {
+        for (uint32_t i = 0; i < beaconCount; i++) {
+            if (random.uniform() < 0.1) {
+                continue; // dropout
+            }
+            // 4 dB shadowing plus occasional reflections that arrive 10 dB stronger.
+            double RSSI = -59.0 - 20.0 * std::log10(trueDistance(trace, i, t)) + 4.0 * random.normal();
+            if (random.uniform() < 0.05) {
+                RSSI += 10.0;
+            }
+            BIBeaconSample sample;
+            sample.key = syntheticBeaconKey(i);
+            sample.RSSI = int32_t(std::lround(std::min(RSSI, -1.0)));
+            // Core Location derives the accuracy from the RSSI in a similar way.
+            sample.accuracy = std::pow(10.0, (-59.0 - double(sample.RSSI)) / 20.0);
+            sample.proximity = BIProximityForAccuracy(sample.accuracy);
+            trace.ticks[t].push_back(sample);
+        }
+    }
+    return trace;
+}
+
+struct Result {
+    double nanosecondsPerBeaconTick;
+    double meanLag;
+    double p90Lag;
+    double missedChanges;
+    double flipsPerBeaconHour;
+};
+
+Result replay(const Trace &trace, const BISmoothingConfiguration &configuration)
+{
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(&configuration);
+    std::vector<int32_t> reported(beaconCount, BIProximityUnknown);
+    std::vector<int32_t> awaited(beaconCount, BIProximityUnknown);
+    std::vector<uint32_t> changedAt(beaconCount, 0);
+    std::vector<double> lags;
+    uint64_t missed = 0;
+    uint64_t flips = 0;
+    std::chrono::steady_clock::duration processingTime{0};
+
+    for (uint32_t t = 0; t < tickCount; t++) {
+        const std::vector<BIBeaconSample> &samples = trace.ticks[t];
+        auto start = std::chrono::steady_clock::now();
+        BISmoothingEngineProcessTick(engine, double(t + 1), samples.data(), samples.size());
+        processingTime += std::chrono::steady_clock::now() - start;
+
+        for (uint32_t i = 0; i < beaconCount; i++) {
+            int32_t expected = BIProximityForAccuracy(trueDistance(trace, i, t));
+            bool realChange = (t > 0 && expected != BIProximityForAccuracy(trueDistance(trace, i, t - 1)));
+            if (realChange) {
+                if (awaited[i] != BIProximityUnknown) {
+                    missed++; // the previous change was never reported
+                }
+                awaited[i] = expected;
+                changedAt[i] = t;
+            }
+
+            BIBeaconKey key = syntheticBeaconKey(i);
+            BISignal signal;
+            if (!BISmoothingEngineGetSmoothedSignal(engine, &key, &signal)) {
+                continue;
+            }
+            if (signal.proximity != reported[i]) {
+                if (awaited[i] != BIProximityUnknown && signal.proximity == awaited[i]) {
+                    lags.push_back(double(t - changedAt[i]));
+                    awaited[i] = BIProximityUnknown;
+                } else if (t >= phaseLength) { // the first phase only warms the filter up
+                    flips++;
+                }
+                reported[i] = signal.proximity;
+            }
+        }
+    }
+    BISmoothingEngineDestroy(engine);
+
+    Result result;
+    result.nanosecondsPerBeaconTick =
+        std::chrono::duration<double, std::nano>(processingTime).count() / double(uint64_t(beaconCount) * tickCount);
+    std::sort(lags.begin(), lags.end());
+    double sum = 0.0;
+    for (double lag : lags) {
+        sum += lag;
+    }
+    result.meanLag = lags.empty() ? 0.0 : sum / double(lags.size());
+    result.p90Lag = lags.empty() ? 0.0 : lags[lags.size() * 9 / 10];
+    result.missedChanges = double(missed);
+    result.flipsPerBeaconHour = double(flips) / double(beaconCount) / (double(tickCount - phaseLength) / 3600.0);
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    Trace trace = makeTrace();
+
+    struct Variant {
+        const char *name;
+        BISmoothingFilter filter;
+    };
+    const Variant variants[] = {
+        {"window average", BISmoothingFilterWindowAverage},
+        {"EWMA", BISmoothingFilterEWMA},
+        {"Kalman", BISmoothingFilterKalman},
+        {"median", BISmoothingFilterMedian},
+    };
+
+    std::printf("%u beacons, %u ticks, proximity changes every %u s\n\n", beaconCount, tickCount, phaseLength);
+    std::printf("%-16s %16s %14s %14s %10s %18s\n", "filter", "ns/beacon/tick", "mean lag (s)", "p90 lag (s)", "missed",
+                "false flips/hour");
+    for (const Variant &variant : variants) {
+        BISmoothingConfiguration configuration = BISmoothingConfigurationMakeDefault();
+        configuration.filter = variant.filter;
+        Result result = replay(trace, configuration);
+        std::printf("%-16s %16.1f %14.2f %14.0f %10.0f %18.1f\n", variant.name, result.nanosecondsPerBeaconTick,
+                    result.meanLag, result.p90Lag, result.missedChanges, result.flipsPerBeaconHour);
+    }
+    return 0;
+}
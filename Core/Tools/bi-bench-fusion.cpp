@@ -0,0 +1,380 @@
+//
+//  bi-bench-fusion.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Runs the fusion engine the way a local aggregator would: by default 100 receivers on a 4 m grid, each reporting
+// 1,000 beacons once per second, for 30 simulated seconds. Every receiver has its own antenna offset (up to +-6 dB) and
+// clock skew (up to +-2 s). Producer threads (1 up to one per core) submit the signals of their receivers while the
+// fusion thread runs a tick per simulated second as soon as all signals of that second are in. Reports the cost of a
+// submit per signal, the latency of the fusion ticks, and how far the trilaterated beacons are from their true
+// positions, once with the receivers' calibration and once without.
+//
+// With calibration, no signal may be dropped or late, the digest of the fused beacons must be the same for every
+// number of producers, the slowest tick must fit into the one-second tick interval, and the median position error must
+// be lower than without calibration (with at least three receivers); the tool exits with 1 if not.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const double spacing = 4.0;            // between receivers, in meters
+const double pathLossExponent = 2.5;
+const double shadowing = 4.0;          // dB
+const double packetLoss = 0.1;
+const double sensitivity = -105.0;     // dBm
+const double maximumAntennaOffset = 6.0; // dB
+const double maximumClockSkew = 2.0;   // seconds
+const size_t batchSize = 50;           // signals per submit, about one network packet
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "usage: bi-bench-fusion [options]\n"
+                 "\n"
+                 "options:\n"
+                 "  --receivers N   receivers (default: 100)\n"
+                 "  --beacons N     beacons (default: 1000)\n"
+                 "  --duration S    simulated seconds (default: 30)\n"
+                 "  --window S      fusion window in seconds (default: 2)\n"
+                 "  --producers N   largest number of producer threads (default: one per core)\n");
+}
+
+uint64_t mix(uint64_t digest, uint64_t value)
+{
+    return SplitMix64(digest ^ value).next();
+}
+
+uint64_t bits(double value)
+{
+    uint64_t result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Receiver {
+    double x;
+    double y;
+    double antennaOffset;
+    double clockSkew;
+};
+
+struct Beacon {
+    double x;
+    double y;
+    int32_t txPower;
+    uint32_t nearestReceiver;
+};
+
+struct Scenario {
+    std::vector<Receiver> receivers;
+    std::vector<Beacon> beacons;
+    uint32_t duration;
+    double window;
+};
+
+Scenario makeScenario(uint32_t receiverCount, uint32_t beaconCount, uint32_t duration, double window)
+{
+    Scenario scenario;
+    scenario.duration = duration;
+    scenario.window = window;
+    SplitMix64 random(25);
+    uint32_t columns = uint32_t(std::ceil(std::sqrt(double(receiverCount))));
+    uint32_t rows = (receiverCount + columns - 1) / columns;
+    for (uint32_t i = 0; i < receiverCount; i++) {
+        Receiver receiver;
+        receiver.x = spacing * double(i % columns);
+        receiver.y = spacing * double(i / columns);
+        receiver.antennaOffset = maximumAntennaOffset * (2.0 * random.uniform() - 1.0);
+        receiver.clockSkew = maximumClockSkew * (2.0 * random.uniform() - 1.0);
+        scenario.receivers.push_back(receiver);
+    }
+    static const int32_t txPowers[] = {-23, -6, 0};
+    for (uint32_t i = 0; i < beaconCount; i++) {
+        Beacon beacon;
+        beacon.x = spacing * double(columns - 1) * random.uniform();
+        beacon.y = spacing * double(rows - 1) * random.uniform();
+        beacon.txPower = txPowers[random.next() % 3];
+        beacon.nearestReceiver = 0;
+        double nearest = INFINITY;
+        for (uint32_t r = 0; r < receiverCount; r++) {
+            double distance = std::hypot(beacon.x - scenario.receivers[r].x, beacon.y - scenario.receivers[r].y);
+            if (distance < nearest) {
+                nearest = distance;
+                beacon.nearestReceiver = r;
+            }
+        }
+        scenario.beacons.push_back(beacon);
+    }
+    return scenario;
+}
+
+// The signals a receiver reports during one second, with its own clock and antenna.
+void makeSignals(const Scenario &scenario, uint32_t receiver, uint32_t second, double referenceLoss,
+                 std::vector<BIFusionSignal> &signals)
+{
+    signals.clear();
+    const Receiver &source = scenario.receivers[receiver];
+    for (uint32_t b = 0; b < scenario.beacons.size(); b++) {
+        const Beacon &beacon = scenario.beacons[b];
+        SplitMix64 random((uint64_t(receiver) << 48) ^ (uint64_t(b) << 24) ^ second);
+        if (random.uniform() < packetLoss) {
+            continue;
+        }
+        double phase = random.uniform();
+        double distance = std::max(std::hypot(beacon.x - source.x, beacon.y - source.y), 0.5);
+        double RSSI = double(beacon.txPower) + referenceLoss - 10.0 * pathLossExponent * std::log10(distance) +
+                      shadowing * random.normal() + source.antennaOffset;
+        if (RSSI < sensitivity) {
+            continue;
+        }
+        BIFusionSignal signal;
+        signal.key = syntheticBeaconKey(b);
+        signal.signal.timestamp = double(second) + phase + source.clockSkew;
+        signal.signal.RSSI = std::min(int32_t(std::lround(RSSI)), -1);
+        signal.signal.proximity = BIProximityUnknown;
+        signal.signal.accuracy = -1.0;
+        signal.signal.inRange = true;
+        signals.push_back(signal);
+    }
+}
+
+struct RunResult {
+    uint64_t digest = 0;
+    uint64_t submitted = 0;
+    double submitSeconds = 0.0;
+    double seconds = 0.0;
+    std::vector<double> tickLatencies; // in seconds
+    std::vector<double> positionErrors;
+    uint64_t fusedBeacons = 0;
+    uint64_t nearestAgreement = 0;
+    BIFusionStatistics statistics = {};
+};
+
+RunResult run(const Scenario &scenario, uint32_t producerCount, bool calibrated)
+{
+    BIFusionEngineConfiguration configuration = BIFusionEngineConfigurationMakeDefault();
+    configuration.window = scenario.window;
+    configuration.distanceModel.pathLossExponent = pathLossExponent;
+    std::vector<BIFusionReceiver> receivers;
+    for (const Receiver &source : scenario.receivers) {
+        BIFusionReceiver receiver = {};
+        receiver.RSSIOffset = calibrated ? -source.antennaOffset : 0.0;
+        receiver.clockOffset = calibrated ? -source.clockSkew : 0.0;
+        receiver.located = true;
+        receiver.x = source.x;
+        receiver.y = source.y;
+        receiver.floor = 0;
+        receivers.push_back(receiver);
+    }
+    std::vector<BIFusionBeacon> beacons;
+    for (uint32_t b = 0; b < scenario.beacons.size(); b++) {
+        beacons.push_back({syntheticBeaconKey(b), scenario.beacons[b].txPower});
+    }
+    BIFusionEngineRef engine =
+        BIFusionEngineCreate(&configuration, receivers.data(), receivers.size(), beacons.data(), beacons.size());
+
+    // Producers stay at most two seconds ahead of the fusion thread, which waits for all producers to finish a second
+    // before it fuses it.
+    RunResult result;
+    std::vector<std::atomic<uint32_t>> progress(producerCount);
+    std::vector<uint64_t> submitted(producerCount, 0);
+    std::vector<double> submitSeconds(producerCount, 0.0);
+    std::atomic<uint32_t> fusedTicks{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < producerCount; p++) {
+        progress[p].store(0);
+        producers.emplace_back([&, p] {
+            std::vector<BIFusionSignal> signals;
+            for (uint32_t second = 0; second < scenario.duration; second++) {
+                while (fusedTicks.load(std::memory_order_acquire) + 1 < second) {
+                    std::this_thread::yield();
+                }
+                for (uint32_t receiver = p; receiver < scenario.receivers.size(); receiver += producerCount) {
+                    makeSignals(scenario, receiver, second, configuration.distanceModel.referenceLoss, signals);
+                    auto submitStart = std::chrono::steady_clock::now();
+                    for (size_t i = 0; i < signals.size(); i += batchSize) {
+                        BIFusionEngineSubmit(engine, receiver, signals.data() + i, std::min(batchSize, signals.size() - i));
+                    }
+                    submitSeconds[p] += secondsSince(submitStart);
+                    submitted[p] += signals.size();
+                }
+                progress[p].store(second + 1, std::memory_order_release);
+            }
+        });
+    }
+
+    for (uint32_t tick = 1; tick <= scenario.duration; tick++) {
+        for (uint32_t p = 0; p < producerCount; p++) {
+            while (progress[p].load(std::memory_order_acquire) < tick) {
+                std::this_thread::yield();
+            }
+        }
+        auto tickStart = std::chrono::steady_clock::now();
+        BIFusionResult fused = BIFusionEngineFuse(engine, double(tick));
+        result.tickLatencies.push_back(secondsSince(tickStart));
+        fusedTicks.store(tick, std::memory_order_release);
+
+        for (size_t i = 0; i < fused.beaconCount; i++) {
+            const BIFusedBeacon &beacon = fused.beacons[i];
+            uint32_t index = syntheticBeaconIndex(beacon.key);
+            const Beacon &truth = scenario.beacons[index];
+            result.digest = mix(result.digest, (uint64_t(index) << 32) ^ bits(beacon.meanRSSI));
+            result.fusedBeacons++;
+            result.nearestAgreement += beacon.nearestReceiver == truth.nearestReceiver ? 1 : 0;
+            if (beacon.position.valid) {
+                result.digest = mix(result.digest, bits(beacon.position.x) ^ (bits(beacon.position.y) >> 1));
+                result.positionErrors.push_back(std::hypot(beacon.position.x - truth.x, beacon.position.y - truth.y));
+            }
+        }
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+    result.seconds = secondsSince(start);
+    for (uint32_t p = 0; p < producerCount; p++) {
+        result.submitted += submitted[p];
+        result.submitSeconds += submitSeconds[p];
+    }
+    result.statistics = BIFusionEngineGetStatistics(engine);
+    BIFusionEngineDestroy(engine);
+    return result;
+}
+
+double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, size_t(fraction * double(values.size())))];
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    uint32_t receiverCount = 100;
+    uint32_t beaconCount = 1000;
+    uint32_t duration = 30;
+    double window = 2.0;
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+        if (std::strcmp(argv[i], "--receivers") == 0 && hasValue) {
+            receiverCount = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--beacons") == 0 && hasValue) {
+            beaconCount = uint32_t(std::min(std::max(1L, std::strtol(argv[++i], nullptr, 10)), 60000L));
+        } else if (std::strcmp(argv[i], "--duration") == 0 && hasValue) {
+            duration = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--window") == 0 && hasValue) {
+            window = std::max(0.1, std::strtod(argv[++i], nullptr));
+        } else if (std::strcmp(argv[i], "--producers") == 0 && hasValue) {
+            cores = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    Scenario scenario = makeScenario(receiverCount, beaconCount, duration, window);
+    std::printf("%u receivers on a %.0f m grid, %u beacons at 1 Hz, %u s, window %.1f s\n\n", receiverCount, spacing,
+                beaconCount, duration, window);
+
+    std::vector<uint32_t> producerCounts;
+    for (uint32_t producers = 1; producers < cores; producers *= 2) {
+        producerCounts.push_back(producers);
+    }
+    producerCounts.push_back(cores);
+
+    struct Run {
+        const char *name;
+        uint32_t producers;
+        bool calibrated;
+    };
+    std::vector<Run> runs;
+    for (uint32_t producers : producerCounts) {
+        runs.push_back({"calibrated", producers, true});
+    }
+    // Receivers spread unevenly over more producers than cores.
+    runs.push_back({"calibrated", 7, true});
+    runs.push_back({"uncalibrated", cores, false});
+
+    bool passed = true;
+    uint64_t digest = 0;
+    double calibratedError = 0.0;
+    double uncalibratedError = 0.0;
+    bool located = false;
+    std::printf("%-13s %9s %10s %12s %10s %10s %10s %8s %8s %8s %8s\n", "run", "producers", "M signals", "submit ns",
+                "tick p50", "tick max", "realtime", "valid", "err p50", "err p90", "nearest");
+    for (size_t r = 0; r < runs.size(); r++) {
+        RunResult result = run(scenario, runs[r].producers, runs[r].calibrated);
+        double tickMaximum = *std::max_element(result.tickLatencies.begin(), result.tickLatencies.end());
+        double errorMedian = percentile(result.positionErrors, 0.5);
+        std::printf("%-13s %9u %10.2f %12.1f %8.1fms %8.1fms %9.1fx %7.1f%% %7.2fm %7.2fm %7.1f%%\n", runs[r].name,
+                    runs[r].producers, double(result.submitted) / 1e6, 1e9 * result.submitSeconds / double(result.submitted),
+                    1e3 * percentile(result.tickLatencies, 0.5), 1e3 * tickMaximum, double(duration) / result.seconds,
+                    100.0 * double(result.positionErrors.size()) / double(std::max<uint64_t>(result.fusedBeacons, 1)),
+                    errorMedian, percentile(result.positionErrors, 0.9),
+                    100.0 * double(result.nearestAgreement) / double(std::max<uint64_t>(result.fusedBeacons, 1)));
+
+        const BIFusionStatistics &statistics = result.statistics;
+        if (!runs[r].calibrated) {
+            uncalibratedError = errorMedian;
+            std::printf("%-13s %llu late, %llu dropped signals\n", "", (unsigned long long)statistics.lateSignals,
+                        (unsigned long long)statistics.droppedSignals);
+            continue;
+        }
+        if (statistics.droppedSignals != 0 || statistics.lateSignals != 0 || statistics.signals != result.submitted) {
+            std::printf("FAIL: %llu of %llu signals accepted, %llu dropped, %llu late\n",
+                        (unsigned long long)statistics.signals, (unsigned long long)result.submitted,
+                        (unsigned long long)statistics.droppedSignals, (unsigned long long)statistics.lateSignals);
+            passed = false;
+        }
+        if (r == 0) {
+            digest = result.digest;
+            calibratedError = errorMedian;
+            located = !result.positionErrors.empty();
+        } else if (result.digest != digest) {
+            std::printf("FAIL: fused beacons differ between producer counts\n");
+            passed = false;
+        }
+        if (tickMaximum >= 1.0) {
+            std::printf("FAIL: a tick took %.0f ms, longer than the tick interval\n", 1e3 * tickMaximum);
+            passed = false;
+        }
+    }
+
+    std::printf("\nsubmit ns: time spent in BIFusionEngineSubmit per signal; tick: latency of BIFusionEngineFuse;\n"
+                "realtime: simulated seconds per second of wall time; err: distance of the trilaterated beacons to their\n"
+                "true positions; nearest: share of fused beacons whose nearest receiver is the geometrically nearest\n");
+    std::printf("digest %016llx\n", (unsigned long long)digest);
+    if (located && !(calibratedError < uncalibratedError)) {
+        std::printf("FAIL: calibration does not improve the positions (%.2f m vs %.2f m)\n", calibratedError,
+                    uncalibratedError);
+        passed = false;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+//
+//  bi-bench-gatt.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Audits 300 simulated beacons (battery level, firmware revision and TX power) with the GATT job queue and different
+// numbers of concurrent connections. One connection corresponds to doing the audit one device at a time. Reports the
+// simulated duration of the audit, devices audited per minute, the outcome per device and characteristic, and the
+// host CPU time per device (scheduler plus simulator).
+
+#include <BICore/BICore.h>
+
+#include "SimulatedPeripherals.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const size_t deviceCount = 300;
+
+struct Result {
+    double duration;
+    BIGATTJobStatistics statistics;
+    size_t complete; // devices with all three values
+    size_t notFound;
+    double p50;
+    double p90;
+    double hostMicrosecondsPerDevice;
+};
+
+Result audit(uint32_t maximumConnections)
+{
+    SimulatedPeripherals peripherals(deviceCount, 21);
+    std::vector<double> durations;
+    peripherals.deviceFinished = [&](const BIGATTDeviceResult &result) {
+        if (result.status == BIGATTStatusSuccess) {
+            durations.push_back(result.finishedAt - result.startedAt);
+        }
+    };
+
+    BIGATTJobConfiguration configuration = BIGATTJobConfigurationMakeDefault();
+    configuration.maximumConnections = maximumConnections;
+    BIGATTTransport transport = peripherals.transport();
+    BIGATTJobQueueRef queue = BIGATTJobQueueCreate(&configuration, &transport, SimulatedPeripherals::handlers(), &peripherals);
+
+    std::vector<uint32_t> deviceIDs(deviceCount);
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        deviceIDs[i] = i;
+    }
+    const BIGATTCharacteristicPath characteristics[] = {
+        {BIGATTUUIDMakeShort(batteryService), BIGATTUUIDMakeShort(batteryLevelCharacteristic)},
+        {BIGATTUUIDMakeShort(deviceInformationService), BIGATTUUIDMakeShort(firmwareRevisionCharacteristic)},
+        {BIGATTUUIDMakeShort(TXPowerService), BIGATTUUIDMakeShort(TXPowerLevelCharacteristic)},
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    BIGATTJobQueueStart(queue, 0.0, deviceIDs.data(), deviceIDs.size(), characteristics, 3);
+    Result result = {};
+    result.duration = peripherals.run(queue);
+    double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.statistics = BIGATTJobQueueGetStatistics(queue);
+    for (size_t device = 0; device < deviceCount; device++) {
+        size_t read = 0;
+        for (size_t characteristic = 0; characteristic < 3; characteristic++) {
+            BIGATTStatus status = BIGATTJobQueueGetValue(queue, device, characteristic, nullptr, nullptr);
+            read += status == BIGATTStatusSuccess ? 1 : 0;
+            result.notFound += status == BIGATTStatusNotFound ? 1 : 0;
+        }
+        result.complete += read == 3 ? 1 : 0;
+    }
+    BIGATTJobQueueDestroy(queue);
+
+    std::sort(durations.begin(), durations.end());
+    result.p50 = durations.empty() ? 0.0 : durations[durations.size() / 2];
+    result.p90 = durations.empty() ? 0.0 : durations[durations.size() * 9 / 10];
+    result.hostMicrosecondsPerDevice = 1e6 * hostSeconds / double(deviceCount);
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    std::printf("%zu devices, 3 characteristics each\n\n", deviceCount);
+    std::printf("%-11s %9s %11s %9s %7s %9s %9s %9s %8s %8s %8s %9s\n", "connections", "duration", "devices/min",
+                "succeeded", "failed", "complete", "not found", "attempts", "timeouts", "p50 (s)", "p90 (s)", "host µs");
+    for (uint32_t connections : {1u, 2u, 4u, 8u}) {
+        Result result = audit(connections);
+        std::printf("%-11u %8.0fs %11.1f %9llu %7llu %9zu %9zu %9llu %8llu %8.2f %8.2f %9.1f\n", connections,
+                    result.duration, 60.0 * double(deviceCount) / result.duration,
+                    (unsigned long long)result.statistics.devicesSucceeded,
+                    (unsigned long long)result.statistics.devicesFailed, result.complete, result.notFound,
+                    (unsigned long long)result.statistics.connectionAttempts,
+                    (unsigned long long)result.statistics.timeouts, result.p50, result.p90,
+                    result.hostMicrosecondsPerDevice);
+    }
+    std::printf("\n\"complete\" counts devices with all three values, \"not found\" characteristics the device does not "
+                "have.\n");
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+//  bi-bench-history.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Measures heap allocations per ranging tick of the signal history. Compares the smoothing engine's ring buffers with
+// a model of the previous design, in which every raw and smoothed signal was a separate heap object kept in a list.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <new>
+#include <unordered_map>
+
+namespace {
+
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocatedBytes{0};
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+using namespace bi::tools;
+
+namespace {
+
+struct Result {
+    double allocationsPerTick;
+    double bytesPerTick;
+    double nanosecondsPerTick;
+};
+
+struct BeaconKeyHasher {
+    size_t operator()(const BIBeaconKey &key) const { return size_t(key.major) << 16 | key.minor; }
+};
+
+struct BeaconKeyEquals {
+    bool operator()(const BIBeaconKey &lhs, const BIBeaconKey &rhs) const { return BIBeaconKeyEqual(&lhs, &rhs); }
+};
+
+// One heap object per signal, like BIBeaconSignal instances (with their NSDate) in an NSArray.
+class ObjectPerSignalHistory {
+public:
+    explicit ObjectPerSignalHistory(size_t capacity) : _capacity(capacity) {}
+
+    void processTick(double timestamp, const std::vector<BIBeaconSample> &samples)
+    {
+        for (auto &entry : _beacons) {
+            entry.second.seen = false;
+        }
+        for (const BIBeaconSample &sample : samples) {
+            Beacon &beacon = _beacons[sample.key];
+            BISignal signal = {timestamp, sample.RSSI, sample.proximity, sample.accuracy, true};
+            append(beacon.raw, std::make_shared<BISignal>(signal));
+            beacon.seen = true;
+        }
+        for (auto &entry : _beacons) {
+            Beacon &beacon = entry.second;
+            if (!beacon.seen) {
+                append(beacon.raw, std::make_shared<BISignal>(BISignalMakeNotInRange(timestamp)));
+            }
+            append(beacon.smoothed, std::make_shared<BISignal>(*beacon.raw.back()));
+        }
+    }
+
+private:
+    using Signals = std::deque<std::shared_ptr<BISignal>>;
+
+    struct Beacon {
+        Signals raw;
+        Signals smoothed;
+        bool seen = false;
+    };
+
+    void append(Signals &signals, std::shared_ptr<BISignal> signal)
+    {
+        if (signals.size() >= _capacity) {
+            signals.pop_front();
+        }
+        signals.push_back(std::move(signal));
+    }
+
+    size_t _capacity;
+    std::unordered_map<BIBeaconKey, Beacon, BeaconKeyHasher, BeaconKeyEquals> _beacons;
+};
+
+template <typename ProcessTick>
+Result measure(size_t beaconCount, size_t warmupTicks, size_t ticks, ProcessTick processTick)
+{
+    SyntheticRanging ranging(beaconCount, 42);
+    for (size_t i = 0; i < warmupTicks; i++) {
+        const std::vector<BIBeaconSample> &samples = ranging.nextTick();
+        processTick(ranging.timestamp(), samples);
+    }
+
+    // Generate the measured ticks up front so that the generator's own work does not show up in the numbers.
+    std::vector<std::vector<BIBeaconSample>> pending;
+    pending.reserve(ticks);
+    for (size_t i = 0; i < ticks; i++) {
+        pending.push_back(ranging.nextTick());
+    }
+    double timestamp = ranging.timestamp() - double(ticks);
+
+    uint64_t allocationsBefore = allocationCount.load();
+    uint64_t bytesBefore = allocatedBytes.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ticks; i++) {
+        timestamp += 1.0;
+        processTick(timestamp, pending[i]);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    Result result;
+    result.allocationsPerTick = double(allocationCount.load() - allocationsBefore) / double(ticks);
+    result.bytesPerTick = double(allocatedBytes.load() - bytesBefore) / double(ticks);
+    result.nanosecondsPerTick = std::chrono::duration<double, std::nano>(end - start).count() / double(ticks);
+    return result;
+}
+
+void printResult(size_t beaconCount, const char *mode, const Result &result)
+{
+    std::printf("%8zu  %-16s %14.1f %14.1f %14.0f\n", beaconCount, mode, result.allocationsPerTick, result.bytesPerTick,
+                result.nanosecondsPerTick);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t ticks = 600;
+    if (argc > 1) {
+        ticks = size_t(std::max(1L, std::strtol(argv[1], nullptr, 10)));
+    }
+    BISmoothingConfiguration configuration = BISmoothingConfigurationMakeDefault();
+    size_t warmupTicks = configuration.historyCapacity;
+
+    std::printf("%8s  %-16s %14s %14s %14s\n", "beacons", "history", "allocs/tick", "bytes/tick", "ns/tick");
+    const size_t beaconCounts[] = {50, 200, 1000};
+    for (size_t beaconCount : beaconCounts) {
+        BISmoothingEngineRef engine = BISmoothingEngineCreate(&configuration);
+        Result ring = measure(beaconCount, warmupTicks, ticks, [engine](double timestamp, const std::vector<BIBeaconSample> &samples) {
+            BISmoothingEngineProcessTick(engine, timestamp, samples.data(), samples.size());
+        });
+        BISmoothingEngineDestroy(engine);
+        printResult(beaconCount, "ring buffer", ring);
+
+        ObjectPerSignalHistory objects(configuration.historyCapacity);
+        Result perSignal = measure(beaconCount, warmupTicks, ticks, [&objects](double timestamp, const std::vector<BIBeaconSample> &samples) {
+            objects.processTick(timestamp, samples);
+        });
+        printResult(beaconCount, "object/signal", perSignal);
+    }
+    return 0;
+}
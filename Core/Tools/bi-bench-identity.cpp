@@ -0,0 +1,133 @@
+//
+//  bi-bench-identity.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Compares interning beacons through the beacon table with the string-keyed lookup used by BIBeacon before, and
+// simulates a 12-hour shift with thousands of transient beacons to show that the table stays bounded.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+// Keeps the compiler from optimizing the measured loops away.
+volatile uint64_t sink;
+
+double measureStringKeyed(const std::vector<BIBeaconKey> &lookups)
+{
+    std::unordered_map<std::string, uint32_t> knownBeacons;
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const BIBeaconKey &key : lookups) {
+        // Same shape as beaconIdentifier: "<UUID>:<major>:<minor>".
+        char identifier[64];
+        char uuid[37];
+        BIBeaconKeyGetUUIDString(&key, uuid);
+        std::snprintf(identifier, sizeof(identifier), "%s:%u:%u", uuid, unsigned(key.major), unsigned(key.minor));
+        auto inserted = knownBeacons.emplace(identifier, uint32_t(knownBeacons.size()));
+        checksum += inserted.first->second;
+    }
+    auto end = std::chrono::steady_clock::now();
+    sink = checksum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(lookups.size());
+}
+
+double measureBeaconTable(const std::vector<BIBeaconKey> &lookups)
+{
+    BIBeaconTableRef table = BIBeaconTableCreate(nullptr);
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const BIBeaconKey &key : lookups) {
+        checksum += BIBeaconTableIntern(table, &key, 0.0);
+    }
+    auto end = std::chrono::steady_clock::now();
+    BIBeaconTableDestroy(table);
+    sink = checksum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(lookups.size());
+}
+
+void simulateShift()
+{
+    // 150 resident beacons plus transient ones (e.g. beacons carried by visitors) that stay for 5 to 30 minutes.
+    const double shiftDuration = 12.0 * 3600.0;
+    const uint32_t residentCount = 150;
+    const double transientArrivalsPerSecond = 0.25;
+
+    SplitMix64 random(7);
+    struct Transient {
+        BIBeaconKey key;
+        double departure;
+    };
+    std::vector<Transient> present;
+    uint32_t nextTransient = 100000;
+
+    BIBeaconTableRef table = BIBeaconTableCreate(nullptr);
+    size_t peakCount = 0;
+    size_t evicted = 0;
+    uint64_t distinctBeacons = residentCount;
+    double nextEviction = 0.0;
+
+    for (double now = 0.0; now < shiftDuration; now += 1.0) {
+        for (uint32_t i = 0; i < residentCount; i++) {
+            BIBeaconKey key = syntheticBeaconKey(i);
+            BIBeaconTableIntern(table, &key, now);
+        }
+        if (random.uniform() < transientArrivalsPerSecond) {
+            present.push_back({syntheticBeaconKey(nextTransient++), now + 300.0 + 1500.0 * random.uniform()});
+            distinctBeacons++;
+        }
+        size_t kept = 0;
+        for (const Transient &transient : present) {
+            if (transient.departure > now) {
+                BIBeaconTableIntern(table, &transient.key, now);
+                present[kept++] = transient;
+            }
+        }
+        present.resize(kept);
+
+        if (now >= nextEviction) {
+            evicted += BIBeaconTableEvictIdle(table, now);
+            nextEviction = now + 60.0;
+        }
+        peakCount = std::max(peakCount, BIBeaconTableGetCount(table));
+    }
+    BIBeaconTableDestroy(table);
+
+    std::printf("12h shift: %llu distinct beacons, peak table size %zu, %zu evicted\n", (unsigned long long)distinctBeacons,
+                peakCount, evicted);
+}
+
+} // namespace
+
+int main()
+{
+    const size_t lookupCount = 2000000;
+    const size_t beaconCounts[] = {100, 1000, 4000};
+
+    std::printf("%8s %22s %22s\n", "beacons", "string key (ns/lookup)", "table (ns/lookup)");
+    for (size_t beaconCount : beaconCounts) {
+        SplitMix64 random(beaconCount);
+        std::vector<BIBeaconKey> lookups;
+        lookups.reserve(lookupCount);
+        for (size_t i = 0; i < lookupCount; i++) {
+            lookups.push_back(syntheticBeaconKey(uint32_t(random.next() % beaconCount)));
+        }
+        std::printf("%8zu %22.1f %22.1f\n", beaconCount, measureStringKeyed(lookups), measureBeaconTable(lookups));
+    }
+
+    simulateShift();
+    return 0;
+}
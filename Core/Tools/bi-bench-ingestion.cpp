@@ -0,0 +1,375 @@
+//
+//  bi-bench-ingestion.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Measures the upload format and the ingestion aggregator on the sightings of 400 devices that each spend 10 to 40
+// minutes walking through a venue of 500 beacons on a 5 m grid, ranging once per second. Every beacon is in one of 25
+// block zones, and the beacons of one wing are also in a hall zone. Reports the size of the uploads next to JSON built
+// from beaconIdentifierDictionaryRepresentation, the encoding and decoding throughput, and the throughput of decoding
+// and aggregating for 1 thread up to one per core, in sightings per second.
+//
+// Every upload is decoded right after it is encoded and compared with the sightings that went in, and the aggregates
+// of every thread count are compared with a straightforward single-threaded aggregation of the same sightings. Retried,
+// corrupted and truncated uploads must be skipped. The tool exits with 1 if any of these checks fails.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t columns = 25;
+const uint32_t rows = 20;
+const uint32_t beaconCount = columns * rows;
+const double spacing = 5.0;
+const double rangingRadius = 15.0;
+const double visibility = 0.7;
+const size_t deviceCount = 400;
+const double visitGap = 60.0;
+const uint32_t hallZone = 1000;
+const size_t uploadsPerCall = 1024;
+
+struct Upload {
+    size_t offset;
+    size_t length;
+    double time; // when the device finished it
+};
+
+struct Uploads {
+    std::vector<uint8_t> bytes;
+    std::vector<Upload> uploads;
+    double now = 0.0;
+};
+
+struct Totals {
+    uint64_t sightings = 0;
+    uint64_t visits = 0;
+    uint64_t devices = 0;
+    int64_t dwellTime = 0; // in milliseconds
+};
+
+// Aggregates the sightings of one device at a time, the way BIIngestion.h describes it.
+class Reference {
+public:
+    Reference() : _beacons(beaconCount), _zones(hallZone + 1), _lastBeacon(beaconCount), _lastZone(hallZone + 1) {}
+
+    void beginDevice()
+    {
+        std::fill(_lastBeacon.begin(), _lastBeacon.end(), INT64_MIN);
+        std::fill(_lastZone.begin(), _lastZone.end(), INT64_MIN);
+    }
+
+    void add(int64_t time, uint32_t beacon, const std::vector<uint32_t> &zones)
+    {
+        visit(_beacons[beacon], _lastBeacon[beacon], time);
+        for (uint32_t zone : zones) {
+            visit(_zones[zone], _lastZone[zone], time);
+        }
+    }
+
+    const Totals &beacon(uint32_t beacon) const { return _beacons[beacon]; }
+    const Totals &zone(uint32_t zoneID) const { return _zones[zoneID]; }
+
+private:
+    static void visit(Totals &totals, int64_t &last, int64_t time)
+    {
+        totals.sightings++;
+        if (last == INT64_MIN) {
+            totals.devices++;
+            totals.visits++;
+        } else if (time - last > int64_t(visitGap * 1e3)) {
+            totals.visits++;
+        } else {
+            totals.dwellTime += time - last;
+        }
+        last = time;
+    }
+
+    std::vector<Totals> _beacons;
+    std::vector<Totals> _zones;
+    std::vector<int64_t> _lastBeacon;
+    std::vector<int64_t> _lastZone;
+};
+
+std::vector<uint32_t> zonesOf(uint32_t beacon)
+{
+    uint32_t column = beacon % columns;
+    uint32_t row = beacon / columns;
+    std::vector<uint32_t> zones = {1 + column / 5 + (row / 4) * (columns / 5)};
+    if (column < 10) {
+        zones.push_back(hallZone);
+    }
+    return zones;
+}
+
+void collectUpload(const uint8_t *bytes, size_t length, void *context)
+{
+    Uploads *uploads = static_cast<Uploads *>(context);
+    uploads->uploads.push_back({uploads->bytes.size(), length, uploads->now});
+    uploads->bytes.insert(uploads->bytes.end(), bytes, bytes + length);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool sameTotals(const BIIngestionTotals &totals, const Totals &expected)
+{
+    return totals.sightings == expected.sightings && totals.visits == expected.visits &&
+           totals.devices == expected.devices && totals.dwellTime == double(expected.dwellTime) / 1e3;
+}
+
+bool sameAggregates(BIIngestionAggregatorRef aggregator, const Reference &reference,
+                    const std::vector<uint32_t> &zoneIDs)
+{
+    std::vector<BIIngestionBeaconStatistics> beacons(beaconCount + 1);
+    if (BIIngestionAggregatorCopyBeacons(aggregator, beacons.data(), beacons.size()) != beaconCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < beaconCount; i++) {
+        BIBeaconKey key = syntheticBeaconKey(i);
+        if (!BIBeaconKeyEqual(&beacons[i].key, &key) ||
+            !sameTotals(beacons[i].totals, reference.beacon(i))) {
+            return false;
+        }
+    }
+    std::vector<BIIngestionZoneStatistics> zones(zoneIDs.size() + 1);
+    if (BIIngestionAggregatorCopyZones(aggregator, zones.data(), zones.size()) != zoneIDs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < zoneIDs.size(); i++) {
+        if (zones[i].zoneID != zoneIDs[i] || !sameTotals(zones[i].totals, reference.zone(zoneIDs[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<std::vector<uint32_t>> zones(beaconCount);
+    std::vector<BIIngestionZoneMember> members;
+    std::vector<uint32_t> zoneIDs;
+    for (uint32_t i = 0; i < beaconCount; i++) {
+        zones[i] = zonesOf(i);
+        for (uint32_t zone : zones[i]) {
+            members.push_back({syntheticBeaconKey(i), zone});
+            if (std::find(zoneIDs.begin(), zoneIDs.end(), zone) == zoneIDs.end()) {
+                zoneIDs.push_back(zone);
+            }
+        }
+    }
+
+    // Simulate, encode and verify one device at a time.
+    Uploads uploads;
+    Reference reference;
+    BIUploadReaderRef reader = BIUploadReaderCreate();
+    SplitMix64 random(21);
+    std::vector<BIBeaconSample> samples;
+    std::vector<size_t> tickEnds;
+    std::vector<double> tickTimes;
+    std::vector<BIUploadSighting> decoded(1024);
+    double encodeSeconds = 0.0;
+    uint64_t sightingCount = 0;
+    double JSONBytes = 0.0;
+    bool identical = true;
+    for (size_t device = 0; device < deviceCount; device++) {
+        uint8_t deviceID[16];
+        for (size_t i = 0; i < sizeof(deviceID); i++) {
+            deviceID[i] = uint8_t(random.next());
+        }
+        int64_t start = 500000000000 + int64_t(random.next() % 28800000);
+        size_t ticks = 600 + size_t(random.next() % 1800);
+        double x = random.uniform() * spacing * (columns - 1);
+        double y = random.uniform() * spacing * (rows - 1);
+        double heading = random.uniform() * 2.0 * M_PI;
+
+        samples.clear();
+        tickEnds.clear();
+        tickTimes.clear();
+        for (size_t tick = 0; tick < ticks; tick++) {
+            heading += 0.3 * random.normal();
+            x = std::min(std::max(x + std::cos(heading), 0.0), spacing * (columns - 1));
+            y = std::min(std::max(y + std::sin(heading), 0.0), spacing * (rows - 1));
+            int firstColumn = std::max(int(std::ceil((x - rangingRadius) / spacing)), 0);
+            int lastColumn = std::min(int(std::floor((x + rangingRadius) / spacing)), int(columns) - 1);
+            int firstRow = std::max(int(std::ceil((y - rangingRadius) / spacing)), 0);
+            int lastRow = std::min(int(std::floor((y + rangingRadius) / spacing)), int(rows) - 1);
+            for (int row = firstRow; row <= lastRow; row++) {
+                for (int column = firstColumn; column <= lastColumn; column++) {
+                    double distance = std::hypot(column * spacing - x, row * spacing - y);
+                    if (distance > rangingRadius || random.uniform() > visibility) {
+                        continue;
+                    }
+                    distance = std::max(distance, 0.1);
+                    double estimate = distance * std::exp(0.2 * random.normal());
+                    double RSSI = -59.0 - 20.0 * std::log10(distance) + 3.0 * random.normal();
+                    BIBeaconSample sample;
+                    sample.key = syntheticBeaconKey(uint32_t(row) * columns + uint32_t(column));
+                    sample.RSSI = int32_t(std::lround(std::min(std::max(RSSI, -100.0), -30.0)));
+                    sample.proximity = estimate < BIProximityImmediateThreshold ? BIProximityImmediate
+                                       : estimate < BIProximityNearThreshold    ? BIProximityNear
+                                                                                : BIProximityFar;
+                    sample.accuracy = double(std::lround(estimate * 100.0)) / 100.0;
+                    samples.push_back(sample);
+                }
+            }
+            tickEnds.push_back(samples.size());
+            tickTimes.push_back(double(start + int64_t(tick) * 1000) / 1e3);
+        }
+
+        size_t firstUpload = uploads.uploads.size();
+        auto begin = std::chrono::steady_clock::now();
+        BIUploadEncoderRef encoder = BIUploadEncoderCreate(nullptr, deviceID, 0, collectUpload, &uploads);
+        for (size_t tick = 0; tick < ticks; tick++) {
+            uploads.now = tickTimes[tick];
+            size_t first = tick > 0 ? tickEnds[tick - 1] : 0;
+            BIUploadEncoderAddSamples(encoder, tickTimes[tick], &samples[first], tickEnds[tick] - first);
+        }
+        BIUploadEncoderFlush(encoder);
+        BIUploadEncoderDestroy(encoder);
+        encodeSeconds += secondsSince(begin);
+        sightingCount += samples.size();
+
+        // Decode the device's uploads and feed the reference.
+        reference.beginDevice();
+        size_t sample = 0;
+        size_t tick = 0;
+        for (size_t i = firstUpload; i < uploads.uploads.size() && identical; i++) {
+            const Upload &upload = uploads.uploads[i];
+            identical = BIUploadReaderOpen(reader, &uploads.bytes[upload.offset], upload.length) &&
+                        BIUploadReaderGetInfo(reader).sequenceNumber == i - firstUpload;
+            size_t keyCount;
+            const BIBeaconKey *keys = BIUploadReaderGetBeacons(reader, &keyCount);
+            size_t count;
+            while (identical && (count = BIUploadReaderRead(reader, decoded.data(), decoded.size())) > 0) {
+                for (size_t j = 0; j < count && identical; j++, sample++) {
+                    while (tick < ticks && tickEnds[tick] <= sample) {
+                        tick++;
+                    }
+                    const BIUploadSighting &sighting = decoded[j];
+                    const BIBeaconSample &expected = samples[sample];
+                    identical = sample < samples.size() && sighting.timestamp == tickTimes[tick] &&
+                                BIBeaconKeyEqual(&keys[sighting.beacon], &expected.key) &&
+                                sighting.RSSI == expected.RSSI && sighting.proximity == expected.proximity &&
+                                sighting.accuracy == expected.accuracy;
+                    uint32_t beacon = (expected.key.major - 1) * 1000 + expected.key.minor;
+                    reference.add(start + int64_t(tick) * 1000, beacon, zones[beacon]);
+                }
+            }
+            identical = identical && BIUploadReaderGetError(reader) == nullptr;
+        }
+        identical = identical && sample == samples.size();
+
+        if (device == 0) {
+            // What an app sends today, per sighting.
+            char UUID[37];
+            for (const BIBeaconSample &s : samples) {
+                BIBeaconKeyGetUUIDString(&s.key, UUID);
+                JSONBytes += 1 + std::snprintf(nullptr, 0,
+                                               "{\"proximityUUID\":\"%s\",\"major\":%u,\"minor\":%u,\"rssi\":%d,"
+                                               "\"proximity\":%d,\"accuracy\":%.2f,\"timestamp\":%.3f}",
+                                               UUID, s.key.major, s.key.minor, s.RSSI, s.proximity, s.accuracy,
+                                               tickTimes[0]);
+            }
+            JSONBytes /= double(samples.size());
+        }
+    }
+
+    // The backend receives the uploads in the order they were finished.
+    std::stable_sort(uploads.uploads.begin(), uploads.uploads.end(),
+                     [](const Upload &lhs, const Upload &rhs) { return lhs.time < rhs.time; });
+    std::vector<BIUploadBuffer> buffers;
+    for (const Upload &upload : uploads.uploads) {
+        buffers.push_back({&uploads.bytes[upload.offset], upload.length});
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    int64_t checksum = 0;
+    for (const BIUploadBuffer &buffer : buffers) {
+        BIUploadReaderOpen(reader, buffer.bytes, buffer.length);
+        size_t count;
+        while ((count = BIUploadReaderRead(reader, decoded.data(), decoded.size())) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                checksum += decoded[i].RSSI;
+            }
+        }
+    }
+    double decodeSeconds = secondsSince(begin);
+    BIUploadReaderDestroy(reader);
+
+    double bytesPerSighting = double(uploads.bytes.size()) / double(sightingCount);
+    std::printf("%zu devices, %zu uploads, %llu sightings (checksum %lld)\n", deviceCount, buffers.size(),
+                (unsigned long long)sightingCount, (long long)checksum);
+    std::printf("upload: %.2f B/sighting, JSON: %.1f B/sighting (%.0fx)\n", bytesPerSighting, JSONBytes,
+                JSONBytes / bytesPerSighting);
+    std::printf("encode: %.1f M sightings/s, decode: %.1f M sightings/s\n\n", double(sightingCount) / encodeSeconds / 1e6,
+                double(sightingCount) / decodeSeconds / 1e6);
+
+    std::vector<uint32_t> threadCounts;
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t threads = 1; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cores);
+
+    std::printf("%8s %10s %22s %8s\n", "threads", "seconds", "M sightings/s", "speedup");
+    BIIngestionConfiguration configuration = BIIngestionConfigurationMakeDefault();
+    configuration.visitGap = visitGap;
+    double baseline = 0.0;
+    for (uint32_t threads : threadCounts) {
+        configuration.threadCount = threads;
+        BIIngestionAggregatorRef aggregator = BIIngestionAggregatorCreate(&configuration, members.data(), members.size());
+        auto start = std::chrono::steady_clock::now();
+        size_t accepted = 0;
+        for (size_t i = 0; i < buffers.size(); i += uploadsPerCall) {
+            accepted += BIIngestionAggregatorAddUploads(aggregator, &buffers[i],
+                                                        std::min(uploadsPerCall, buffers.size() - i));
+        }
+        double seconds = secondsSince(start);
+        BIIngestionStatistics statistics = BIIngestionAggregatorGetStatistics(aggregator);
+        identical = identical && accepted == buffers.size() && statistics.sightings == sightingCount &&
+                    statistics.devices == deviceCount && sameAggregates(aggregator, reference, zoneIDs);
+        BIIngestionAggregatorDestroy(aggregator);
+        baseline = baseline > 0.0 ? baseline : seconds;
+        std::printf("%8u %10.3f %22.1f %7.2fx\n", threads, seconds, double(sightingCount) / seconds / 1e6,
+                    baseline / seconds);
+    }
+
+    // Retried, corrupted and truncated uploads.
+    configuration.threadCount = 2;
+    BIIngestionAggregatorRef aggregator = BIIngestionAggregatorCreate(&configuration, members.data(), members.size());
+    std::vector<uint8_t> corrupted(buffers[1].bytes, buffers[1].bytes + buffers[1].length);
+    corrupted[corrupted.size() / 2] ^= 0x10;
+    BIUploadBuffer invalid[] = {{corrupted.data(), corrupted.size()}, {buffers[2].bytes, buffers[2].length - 1}};
+    identical = identical && BIIngestionAggregatorAddUploads(aggregator, buffers.data(), 1) == 1 &&
+                BIIngestionAggregatorAddUploads(aggregator, buffers.data(), 1) == 0 &&
+                BIIngestionAggregatorAddUploads(aggregator, invalid, 2) == 0;
+    BIIngestionStatistics statistics = BIIngestionAggregatorGetStatistics(aggregator);
+    identical = identical && statistics.uploads == 1 && statistics.duplicateUploads == 1 &&
+                statistics.rejectedUploads == 2;
+    BIIngestionAggregatorDestroy(aggregator);
+
+    std::printf("\nuploads of %u sightings or 5 minutes; %zu uploads per call; visit gap %.0f s\n", 4096u,
+                uploadsPerCall, visitGap);
+    if (!identical) {
+        std::printf("FAIL: decoded sightings or aggregates differ from the reference\n");
+        return 1;
+    }
+    return 0;
+}
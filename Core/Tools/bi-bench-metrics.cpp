@@ -0,0 +1,226 @@
+//
+//  bi-bench-metrics.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Cost of the pipeline metrics. Runs the same workload (10 regions with 20 beacons each) through a synchronous ranging
+// pipeline with and without metrics, alternating, and compares the run times. As that difference is within the noise
+// of most machines, the work the pipeline adds per synchronous tick (four clock reads, the batched records and
+// increments, and the dump check) is also timed on its own. Prints the resulting per-stage latencies, the size of a
+// JSON and a binary dump, and checks that merging the binary dump into empty metrics reproduces the snapshot.
+
+#include <BICore/BICore.h>
+
+#include "Metrics.hpp"
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const size_t regionCount = 10;
+const size_t beaconsPerRegion = 20;
+const size_t tickCount = 3000;
+const int repetitions = 15;
+
+struct Workload {
+    std::vector<std::vector<std::vector<BIBeaconSample>>> ticks; // [tick][region] -> samples
+    std::vector<double> timestamps;
+};
+
+Workload makeWorkload()
+{
+    Workload workload;
+    std::vector<std::unique_ptr<SyntheticRanging>> regions;
+    for (size_t r = 0; r < regionCount; r++) {
+        regions.emplace_back(new SyntheticRanging(beaconsPerRegion, 500 + r));
+    }
+    for (size_t t = 0; t < tickCount; t++) {
+        std::vector<std::vector<BIBeaconSample>> tick;
+        for (size_t r = 0; r < regionCount; r++) {
+            std::vector<BIBeaconSample> samples = regions[r]->nextTick();
+            for (BIBeaconSample &sample : samples) {
+                sample.key.major = uint16_t(sample.key.major + 100 * r);
+            }
+            tick.push_back(std::move(samples));
+        }
+        workload.ticks.push_back(std::move(tick));
+        workload.timestamps.push_back(regions[0]->timestamp());
+    }
+    return workload;
+}
+
+void countBatch(const BIRangingBatch *batch, void *context)
+{
+    *static_cast<uint64_t *>(context) += batch->regionCount;
+}
+
+void countDump(const uint8_t *, size_t, void *context)
+{
+    (*static_cast<uint32_t *>(context))++;
+}
+
+double run(const Workload &workload, BIMetricsRef metrics)
+{
+    uint64_t delivered = 0;
+    BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+    configuration.synchronous = true;
+    configuration.metrics = metrics;
+    BIRangingPipelineRef pipeline = BIRangingPipelineCreate(&configuration, BIDeliveryQueue{nullptr, nullptr}, &countBatch,
+                                                            &delivered);
+    std::vector<uint32_t> regionIDs;
+    for (size_t r = 0; r < regionCount; r++) {
+        regionIDs.push_back(BIRangingPipelineAddRegion(pipeline));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < workload.ticks.size(); t++) {
+        for (size_t r = 0; r < regionCount; r++) {
+            const std::vector<BIBeaconSample> &samples = workload.ticks[t][r];
+            BIRangingPipelineSubmit(pipeline, regionIDs[r], workload.timestamps[t], samples.data(), samples.size());
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    BIRangingPipelineDestroy(pipeline);
+    return seconds;
+}
+
+void printHistogram(const char *name, const BIHistogramSnapshot &histogram, double scale, const char *unit)
+{
+    std::printf("%-15s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f  %s\n", name, (unsigned long long)histogram.count,
+                histogram.mean / scale, histogram.p50 / scale, histogram.p90 / scale, histogram.p99 / scale,
+                histogram.maximum / scale, unit);
+}
+
+// What the pipeline does per synchronous tick when it has metrics, with its two batches (one tick per second, so that
+// every 60th tick dumps).
+double instrumentationSecondsPerTick(BIMetricsRef metricsRef)
+{
+    const int iterations = 200000;
+    bi::Metrics &metrics = *bi::unwrapMetrics(metricsRef);
+    bi::MetricsBatch stages(&metrics);
+    bi::MetricsBatch delivery(&metrics);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        bi::Metrics::Clock::time_point opened = start;
+        bi::Metrics::Clock::time_point started = bi::Metrics::Clock::now();
+        bi::Metrics::Clock::time_point smoothed = bi::Metrics::Clock::now();
+        bi::Metrics::Clock::time_point ready = bi::Metrics::Clock::now();
+        stages.record(BIMetricsHistogramQueueing, started - opened);
+        stages.record(BIMetricsHistogramSmoothing, smoothed - started);
+        stages.record(BIMetricsHistogramNearestBeacon, ready - smoothed);
+        stages.record(BIMetricsHistogramBeaconsPerTick, uint64_t(180));
+        stages.increment(BIMetricsCounterTicks);
+        stages.increment(BIMetricsCounterSamples, 180);
+        if (metrics.dumpDue(double(i))) {
+            stages.flush();
+            delivery.flush();
+            metrics.dumpIfDue(double(i));
+        }
+        bi::Metrics::Clock::time_point finished = bi::Metrics::Clock::now();
+        delivery.record(BIMetricsHistogramDispatch, ready - ready);
+        delivery.record(BIMetricsHistogramHandler, finished - ready);
+        delivery.record(BIMetricsHistogramEndToEnd, finished - opened);
+    }
+    stages.flush();
+    delivery.flush();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+bool sameSnapshot(const BIMetricsSnapshot &lhs, const BIMetricsSnapshot &rhs)
+{
+    if (std::memcmp(lhs.counters, rhs.counters, sizeof(lhs.counters)) != 0) {
+        return false;
+    }
+    for (int i = 0; i < BIMetricsHistogramCount; i++) {
+        const BIHistogramSnapshot &a = lhs.histograms[i];
+        const BIHistogramSnapshot &b = rhs.histograms[i];
+        if (a.count != b.count || a.minimum != b.minimum || a.maximum != b.maximum || a.mean != b.mean || a.p50 != b.p50 ||
+            a.p90 != b.p90 || a.p99 != b.p99 || a.p999 != b.p999) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    Workload workload = makeWorkload();
+    BIMetricsConfiguration configuration = BIMetricsConfigurationMakeDefault();
+    uint32_t dumps = 0;
+    BIMetricsRef metrics = BIMetricsCreate(&configuration, &countDump, &dumps);
+
+    // Adjacent runs are compared, and the median of their ratios is reported, so that drifting machine load cancels out.
+    run(workload, nullptr);
+    std::vector<double> withouts;
+    std::vector<double> withs;
+    std::vector<double> ratios;
+    for (int i = 0; i < repetitions; i++) {
+        withouts.push_back(run(workload, nullptr));
+        BIMetricsReset(metrics);
+        withs.push_back(run(workload, metrics));
+        ratios.push_back(withs.back() / withouts.back());
+    }
+    double without = median(withouts);
+    double with = median(withs);
+    std::printf("%zu ticks of %zu regions x %zu beacons: %.2f us/tick without metrics, %.2f us/tick with metrics "
+                "(%+.2f%%)\n",
+                tickCount, regionCount, beaconsPerRegion, 1e6 * without / tickCount, 1e6 * with / tickCount,
+                100.0 * (median(ratios) - 1.0));
+    uint32_t scratchDumps = 0;
+    BIMetricsRef scratch = BIMetricsCreate(&configuration, &countDump, &scratchDumps);
+    std::vector<double> instrumentations;
+    for (int i = 0; i < 5; i++) {
+        instrumentations.push_back(instrumentationSecondsPerTick(scratch));
+    }
+    double instrumentation = median(instrumentations);
+    BIMetricsDestroy(scratch);
+    double overhead = 100.0 * instrumentation * tickCount / without;
+    std::printf("instrumentation alone: %.0f ns/tick (%.2f%% of a tick)\n\n", 1e9 * instrumentation, overhead);
+
+    BIMetricsSnapshot snapshot;
+    BIMetricsGetSnapshot(metrics, &snapshot);
+    std::printf("%-15s %10s %10s %10s %10s %10s %10s\n", "histogram", "count", "mean", "p50", "p90", "p99", "max");
+    printHistogram("queueing", snapshot.histograms[BIMetricsHistogramQueueing], 1e3, "us");
+    printHistogram("smoothing", snapshot.histograms[BIMetricsHistogramSmoothing], 1e3, "us");
+    printHistogram("nearest beacon", snapshot.histograms[BIMetricsHistogramNearestBeacon], 1e3, "us");
+    printHistogram("handler", snapshot.histograms[BIMetricsHistogramHandler], 1e3, "us");
+    printHistogram("end to end", snapshot.histograms[BIMetricsHistogramEndToEnd], 1e3, "us");
+    printHistogram("beacons/tick", snapshot.histograms[BIMetricsHistogramBeaconsPerTick], 1.0, "beacons");
+    std::printf("\nticks %llu, samples %llu, dumps passed to the handler %u\n",
+                (unsigned long long)snapshot.counters[BIMetricsCounterTicks],
+                (unsigned long long)snapshot.counters[BIMetricsCounterSamples], dumps);
+
+    size_t JSONLength = BIMetricsDump(metrics, BIMetricsDumpFormatJSON, nullptr, 0);
+    std::vector<uint8_t> binary(BIMetricsDump(metrics, BIMetricsDumpFormatBinary, nullptr, 0));
+    BIMetricsDump(metrics, BIMetricsDumpFormatBinary, binary.data(), binary.size());
+    BIMetricsRef merged = BIMetricsCreate(nullptr, nullptr, nullptr);
+    BIMetricsSnapshot mergedSnapshot;
+    bool roundTrip = BIMetricsMergeBinary(merged, binary.data(), binary.size());
+    BIMetricsGetSnapshot(merged, &mergedSnapshot);
+    roundTrip = roundTrip && sameSnapshot(snapshot, mergedSnapshot);
+    bool rejectsTruncated = !BIMetricsMergeBinary(merged, binary.data(), binary.size() - 1);
+    std::printf("dump: %zu bytes JSON, %zu bytes binary; binary round trip %s\n", JSONLength, binary.size(),
+                roundTrip && rejectsTruncated ? "ok" : "FAILED");
+
+    BIMetricsDestroy(merged);
+    BIMetricsDestroy(metrics);
+    return roundTrip && rejectsTruncated ? 0 : 1;
+}
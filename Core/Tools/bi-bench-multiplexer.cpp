@@ -0,0 +1,330 @@
+//
+//  bi-bench-multiplexer.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Simulates four hours of a visitor walking through a mall with 500 logical regions (one beacon each, on a 10 m grid)
+// while the app runs in the background, and compares registration strategies for the 20 physical regions: a fixed set,
+// the region multiplexer, and the multiplexer without a wildcard region. Core Location is modelled as reporting enters
+// of registered regions after 1-5 s, exits after 20-40 s and the state of a newly registered region after 1-3 s; each
+// report wakes the app for 10 s of ranging, and the app comes to the foreground for one minute every 15 minutes.
+//
+// Reports, for visits of at least 30 s, how late the multiplexer reported the enter (or whether it missed it), and how
+// often physical regions were registered and unregistered.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t columns = 25;
+const uint32_t rows = 20;
+const uint32_t regionCount = columns * rows;
+const double spacing = 10.0;
+const double beaconRange = 12.0;
+const int duration = 4 * 60 * 60;
+const double wakeTime = 10.0;
+const double minimumVisit = 30.0;
+
+double beaconX(uint32_t index) { return spacing * double(index % columns); }
+double beaconY(uint32_t index) { return spacing * double(index / columns); }
+
+struct Position {
+    double x;
+    double y;
+};
+
+// The visitor walks at 1 m/s to a random spot and stands there for two minutes.
+std::vector<Position> makeWalk()
+{
+    SplitMix64 random(11);
+    const double length = spacing * (columns - 1);
+    const double width = spacing * (rows - 1);
+    std::vector<Position> walk(duration + 1);
+    double x = 0.5 * length;
+    double y = 0.5 * width;
+    double targetX = x;
+    double targetY = y;
+    double standingUntil = 120.0;
+    for (int t = 0; t <= duration; t++) {
+        double remaining = std::hypot(targetX - x, targetY - y);
+        if (remaining > 1.0) {
+            x += (targetX - x) / remaining;
+            y += (targetY - y) / remaining;
+        } else if (double(t) >= standingUntil) {
+            targetX = length * random.uniform();
+            targetY = width * random.uniform();
+            standingUntil = double(t) + std::hypot(targetX - x, targetY - y) + 120.0;
+        } else {
+            x = targetX;
+            y = targetY;
+        }
+        walk[t] = Position{x, y};
+    }
+    return walk;
+}
+
+bool isInside(const Position &position, uint32_t region)
+{
+    return std::hypot(beaconX(region) - position.x, beaconY(region) - position.y) < beaconRange;
+}
+
+// The system's view of one registered physical region.
+struct PhysicalRegion {
+    BIPhysicalRegion region;
+    bool determined = false;
+    bool inside = false;
+    double lastEvent = 0.0;
+};
+
+struct PendingEvent {
+    double timestamp;
+    uint32_t physicalRegionID;
+    bool determineState; // report the state at delivery time instead of event
+    BIRegionEvent event;
+};
+
+struct Simulation {
+    SplitMix64 random{12};
+    double now = 0.0;
+    std::map<uint32_t, PhysicalRegion> physicalRegions;
+    std::vector<PendingEvent> pending;
+    std::vector<std::vector<double>> enters; // per logical region index
+    std::vector<uint32_t> logicalIndexes;    // by logical region ID
+};
+
+bool physicalInside(const Simulation &simulation, const BIPhysicalRegion &region, const Position &position)
+{
+    if (region.logicalRegionID == 0) {
+        return true; // the whole mall is covered by beacons with the same UUID
+    }
+    return isInside(position, simulation.logicalIndexes[region.logicalRegionID]);
+}
+
+void schedule(Simulation &simulation, PhysicalRegion &physical, double delay, bool determineState, BIRegionEvent event)
+{
+    physical.lastEvent = std::max(simulation.now + delay, physical.lastEvent);
+    simulation.pending.push_back({physical.lastEvent, physical.region.physicalRegionID, determineState, event});
+}
+
+void physicalRegionChanged(const BIPhysicalRegion *region, bool monitor, void *context)
+{
+    Simulation &simulation = *static_cast<Simulation *>(context);
+    if (!monitor) {
+        simulation.physicalRegions.erase(region->physicalRegionID);
+        return;
+    }
+    PhysicalRegion &physical = simulation.physicalRegions[region->physicalRegionID];
+    physical.region = *region;
+    schedule(simulation, physical, 1.0 + 2.0 * simulation.random.uniform(), true, BIRegionEventStateUnknown);
+}
+
+void logicalRegionEvent(uint32_t logicalRegionID, BIRegionEvent event, double timestamp, void *context)
+{
+    Simulation &simulation = *static_cast<Simulation *>(context);
+    if (event == BIRegionEventEnter) {
+        simulation.enters[simulation.logicalIndexes[logicalRegionID]].push_back(timestamp);
+    }
+}
+
+struct Result {
+    uint32_t visits = 0;
+    uint32_t detected = 0;
+    uint32_t alreadyInside = 0;
+    std::vector<double> latencies;
+    BIRegionMultiplexerStatistics statistics;
+    double nanosecondsPerEvaluation = 0.0;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, size_t(p * double(values.size())))];
+}
+
+Result run(const std::vector<Position> &walk, const BIRegionMultiplexerConfiguration &configuration)
+{
+    Simulation simulation;
+    simulation.enters.resize(regionCount);
+    BIRegionMultiplexerRef multiplexer =
+        BIRegionMultiplexerCreate(&configuration, physicalRegionChanged, logicalRegionEvent, &simulation);
+    std::vector<uint32_t> logicalRegionIDs(regionCount);
+    for (uint32_t i = 0; i < regionCount; i++) {
+        BIBeaconRegionDefinition definition;
+        definition.key = syntheticBeaconKey(i);
+        definition.scope = BIBeaconRegionScopeMinor;
+        logicalRegionIDs[i] = BIRegionMultiplexerAddRegion(multiplexer, &definition, 0.0);
+        simulation.logicalIndexes.resize(logicalRegionIDs[i] + 1);
+        simulation.logicalIndexes[logicalRegionIDs[i]] = i;
+    }
+
+    Result result;
+    SplitMix64 random(13);
+    std::vector<double> visitStart(regionCount, -1.0);
+    std::vector<bool> visitAlreadyInside(regionCount, false);
+    std::vector<BIBeaconSample> samples;
+    std::chrono::steady_clock::duration evaluationTime{0};
+    uint64_t evaluations = 0;
+    double awakeUntil = -1.0;
+
+    auto finishVisit = [&](uint32_t region, double end) {
+        double start = visitStart[region];
+        visitStart[region] = -1.0;
+        if (end - start < minimumVisit) {
+            return;
+        }
+        result.visits++;
+        if (visitAlreadyInside[region]) {
+            result.alreadyInside++;
+            return;
+        }
+        const std::vector<double> &enters = simulation.enters[region];
+        auto enter = std::lower_bound(enters.begin(), enters.end(), start);
+        if (enter != enters.end() && *enter < end) {
+            result.detected++;
+            result.latencies.push_back(*enter - start);
+        }
+    };
+
+    for (int second = 0; second <= duration; second++) {
+        double now = double(second);
+        simulation.now = now;
+        const Position &position = walk[second];
+
+        for (uint32_t i = 0; i < regionCount; i++) {
+            bool inside = isInside(position, i);
+            if (inside && visitStart[i] < 0.0) {
+                visitStart[i] = now;
+                visitAlreadyInside[i] = BIRegionMultiplexerIsInside(multiplexer, logicalRegionIDs[i]);
+            } else if (!inside && visitStart[i] >= 0.0) {
+                finishVisit(i, now);
+            }
+        }
+
+        for (auto &entry : simulation.physicalRegions) {
+            PhysicalRegion &physical = entry.second;
+            bool inside = physicalInside(simulation, physical.region, position);
+            if (physical.determined && inside != physical.inside) {
+                physical.inside = inside;
+                if (inside) {
+                    schedule(simulation, physical, 1.0 + 4.0 * random.uniform(), false, BIRegionEventEnter);
+                } else {
+                    schedule(simulation, physical, 20.0 + 20.0 * random.uniform(), false, BIRegionEventExit);
+                }
+            }
+        }
+
+        std::vector<PendingEvent> due;
+        auto split = std::stable_partition(simulation.pending.begin(), simulation.pending.end(),
+                                           [&](const PendingEvent &event) { return event.timestamp > now; });
+        due.assign(split, simulation.pending.end());
+        simulation.pending.erase(split, simulation.pending.end());
+        std::stable_sort(due.begin(), due.end(),
+                         [](const PendingEvent &lhs, const PendingEvent &rhs) { return lhs.timestamp < rhs.timestamp; });
+        for (const PendingEvent &pending : due) {
+            auto it = simulation.physicalRegions.find(pending.physicalRegionID);
+            if (it == simulation.physicalRegions.end()) {
+                continue;
+            }
+            BIRegionEvent event = pending.event;
+            if (pending.determineState) {
+                it->second.determined = true;
+                it->second.inside = physicalInside(simulation, it->second.region, position);
+                event = it->second.inside ? BIRegionEventStateInside : BIRegionEventStateOutside;
+            }
+            BIRegionMultiplexerReportEvent(multiplexer, pending.physicalRegionID, now, event);
+            if (event == BIRegionEventEnter || event == BIRegionEventStateInside) {
+                awakeUntil = std::max(awakeUntil, now + wakeTime);
+            }
+        }
+
+        bool foreground = second % (15 * 60) < 60;
+        if (!foreground && now > awakeUntil) {
+            continue;
+        }
+        samples.clear();
+        for (uint32_t i = 0; i < regionCount; i++) {
+            double distance = std::hypot(beaconX(i) - position.x, beaconY(i) - position.y);
+            if (distance > beaconRange || random.uniform() >= 0.9) {
+                continue;
+            }
+            BIBeaconSample sample;
+            sample.key = syntheticBeaconKey(i);
+            sample.RSSI = int32_t(std::lround(std::min(-59.0 - 20.0 * std::log10(std::max(distance, 0.3)) + 4.0 * random.normal(), -1.0)));
+            sample.accuracy = std::pow(10.0, (-59.0 - double(sample.RSSI)) / 20.0);
+            sample.proximity = BIProximityForAccuracy(sample.accuracy);
+            samples.push_back(sample);
+        }
+        // The app ranges the wildcard regions it monitors.
+        bool wildcard = std::any_of(simulation.physicalRegions.begin(), simulation.physicalRegions.end(),
+                                    [](const std::pair<const uint32_t, PhysicalRegion> &entry) {
+                                        return entry.second.region.logicalRegionID == 0;
+                                    });
+        if (wildcard) {
+            BIRegionMultiplexerReportRanging(multiplexer, now, samples.data(), samples.size());
+        }
+        auto start = std::chrono::steady_clock::now();
+        BIRegionMultiplexerEvaluate(multiplexer, now);
+        evaluationTime += std::chrono::steady_clock::now() - start;
+        evaluations++;
+    }
+    for (uint32_t i = 0; i < regionCount; i++) {
+        if (visitStart[i] >= 0.0) {
+            finishVisit(i, double(duration));
+        }
+    }
+
+    result.statistics = BIRegionMultiplexerGetStatistics(multiplexer);
+    result.nanosecondsPerEvaluation = std::chrono::duration<double, std::nano>(evaluationTime).count() / double(evaluations);
+    BIRegionMultiplexerDestroy(multiplexer);
+    return result;
+}
+
+void print(const char *name, const Result &result)
+{
+    uint32_t missed = result.visits - result.detected - result.alreadyInside;
+    double hours = double(duration) / 3600.0;
+    std::printf("%-20s %7u %9u %8u %7.1f%% %8.1f %8.1f %8.1f %10.0f %11.0f\n", name, result.visits, result.detected,
+                result.alreadyInside, 100.0 * double(missed) / double(std::max(result.visits, 1u)),
+                percentile(result.latencies, 0.5), percentile(result.latencies, 0.9), percentile(result.latencies, 0.99),
+                double(result.statistics.registrations + result.statistics.unregistrations) / hours,
+                result.nanosecondsPerEvaluation);
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<Position> walk = makeWalk();
+
+    BIRegionMultiplexerConfiguration fixed = BIRegionMultiplexerConfigurationMakeDefault();
+    fixed.minimumRegistration = HUGE_VAL;
+    BIRegionMultiplexerConfiguration multiplexed = BIRegionMultiplexerConfigurationMakeDefault();
+    BIRegionMultiplexerConfiguration specificOnly = BIRegionMultiplexerConfigurationMakeDefault();
+    specificOnly.wildcardRegions = 0;
+
+    std::printf("%u logical regions, %d s, visits of at least %.0f s\n\n", regionCount, duration, minimumVisit);
+    std::printf("%-20s %7s %9s %8s %8s %8s %8s %8s %10s %11s\n", "strategy", "visits", "detected", "inside", "missed",
+                "p50 (s)", "p90 (s)", "p99 (s)", "churn/h", "ns/evaluate");
+    print("fixed 19 + wildcard", run(walk, fixed));
+    print("multiplexer", run(walk, multiplexed));
+    print("without wildcard", run(walk, specificOnly));
+    std::printf("\n\"inside\" counts visits to regions that were still inside from an earlier visit; churn counts\n"
+                "registrations plus unregistrations per hour.\n");
+    return 0;
+}
@@ -0,0 +1,236 @@
+//
+//  bi-bench-nearest.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Replays an hour of a user walking through a hall with 1000 beacons on a 4 m grid and compares nearest-beacon
+// selection with and without hysteresis. Reports the CPU time of the selection per tick (smoothing excluded), the
+// number of nearest-beacon switches and how many of them were spurious, i.e. switched to a beacon that was not the
+// geometrically nearest beacon at that moment. A full rescan of all smoothed signals is measured for comparison.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t columns = 40;
+const uint32_t rows = 25;
+const double spacing = 4.0;
+const double rangingRadius = 30.0;
+
+struct Tick {
+    double timestamp;
+    uint32_t trueNearest;
+    std::vector<BIBeaconSample> samples;
+};
+
+double beaconX(uint32_t index) { return spacing * double(index % columns); }
+double beaconY(uint32_t index) { return spacing * double(index / columns); }
+
+// The user walks at 1 m/s to a random spot in the hall, stands there for a minute (like a visitor in front of an
+// exhibit), and moves on. Standing still among closely spaced beacons is where the nearest beacon used to flap.
+std::vector<Tick> makeWalk(size_t tickCount)
+{
+    SplitMix64 random(5);
+    const double length = spacing * (columns - 1);
+    const double width = spacing * (rows - 1);
+    const double standingTime = 60.0;
+    std::vector<Tick> ticks(tickCount);
+    double x = 0.5 * length;
+    double y = 0.5 * width;
+    double targetX = x;
+    double targetY = y;
+    double standingUntil = standingTime;
+    for (size_t t = 0; t < tickCount; t++) {
+        double remaining = std::hypot(targetX - x, targetY - y);
+        if (remaining > 1.0) {
+            x += (targetX - x) / remaining;
+            y += (targetY - y) / remaining;
+        } else if (double(t) >= standingUntil) {
+            targetX = length * random.uniform();
+            targetY = width * random.uniform();
+            standingUntil = double(t) + std::hypot(targetX - x, targetY - y) + standingTime;
+        } else {
+            x = targetX;
+            y = targetY;
+        }
+
+        Tick &tick = ticks[t];
+        tick.timestamp = double(t + 1);
+        double nearestDistance = HUGE_VAL;
+        for (uint32_t i = 0; i < columns * rows; i++) {
+            double distance = std::hypot(beaconX(i) - x, beaconY(i) - y);
+            if (distance < nearestDistance) {
+                nearestDistance = distance;
+                tick.trueNearest = i;
+            }
+            if (distance > rangingRadius || random.uniform() >= 0.9) {
+                continue;
+            }
+            // Log-distance path loss with 4 dB shadowing, which makes neighbouring beacons overlap.
+            double RSSI = -59.0 - 20.0 * std::log10(std::max(distance, 0.3)) + 4.0 * random.normal();
+            BIBeaconSample sample;
+            sample.key = syntheticBeaconKey(i);
+            sample.RSSI = int32_t(std::lround(std::min(RSSI, -1.0)));
+            sample.accuracy = std::pow(10.0, (-59.0 - double(sample.RSSI)) / 20.0);
+            sample.proximity = BIProximityForAccuracy(sample.accuracy);
+            tick.samples.push_back(sample);
+        }
+    }
+    return ticks;
+}
+
+uint32_t beaconIndex(BIBeaconTableRef table, BIBeaconHandle handle)
+{
+    BIBeaconKey key;
+    BIBeaconTableGetKey(table, handle, &key);
+    return uint32_t(key.major - 1) * 1000 + key.minor;
+}
+
+struct Result {
+    double trackerNanosecondsPerTick;
+    double rescanNanosecondsPerTick;
+    double topFiveNanosecondsPerTick;
+    uint32_t switches;
+    uint32_t spuriousSwitches;
+    uint32_t trueChanges;
+    double agreement;
+    double changedBeaconsPerTick;
+};
+
+Result replay(const std::vector<Tick> &ticks, const BINearestBeaconTrackerConfiguration &configuration)
+{
+    BIBeaconTableRef table = BIBeaconTableCreate(nullptr);
+    BISmoothingEngineRef engine = BISmoothingEngineCreateWithBeaconTable(nullptr, table);
+    BINearestBeaconTrackerRef tracker = BINearestBeaconTrackerCreate(&configuration);
+
+    Result result = {};
+    std::chrono::steady_clock::duration trackerTime{0};
+    std::chrono::steady_clock::duration rescanTime{0};
+    std::chrono::steady_clock::duration topFiveTime{0};
+    uint32_t agreeing = 0;
+    BIBeaconHandle topFive[5];
+    std::vector<BIBeaconHandle> handles(columns * rows);
+    size_t changedBeacons = 0;
+    volatile BIBeaconHandle sink;
+
+    for (const Tick &tick : ticks) {
+        BISmoothingEngineProcessTick(engine, tick.timestamp, tick.samples.data(), tick.samples.size());
+        size_t beaconCount = BISmoothingEngineGetBeaconCount(engine);
+
+        auto start = std::chrono::steady_clock::now();
+        size_t droppedCount = BISmoothingEngineCopyDroppedHandles(engine, handles.data(), handles.size());
+        for (size_t i = 0; i < droppedCount; i++) {
+            BINearestBeaconTrackerRemove(tracker, handles[i]);
+        }
+        size_t changedCount = BISmoothingEngineCopyChangedHandles(engine, handles.data(), handles.size());
+        for (size_t i = 0; i < changedCount; i++) {
+            BISignal signal;
+            BISmoothingEngineGetSmoothedSignalForHandle(engine, handles[i], &signal);
+            BINearestBeaconTrackerUpdate(tracker, handles[i], &signal);
+        }
+        changedBeacons += changedCount;
+        bool changed = BINearestBeaconTrackerEvaluate(tracker, tick.timestamp);
+        auto end = std::chrono::steady_clock::now();
+        trackerTime += end - start;
+
+        // What a per-tick full re-evaluation costs: scan every smoothed signal for the strongest one.
+        start = std::chrono::steady_clock::now();
+        BIBeaconHandle strongest = BIBeaconHandleInvalid;
+        BISignal strongestSignal = BISignalMakeNotInRange(0.0);
+        for (size_t i = 0; i < beaconCount; i++) {
+            BIBeaconHandle handle = BISmoothingEngineGetBeaconHandleAtIndex(engine, i);
+            BISignal signal;
+            BISmoothingEngineGetSmoothedSignalForHandle(engine, handle, &signal);
+            if (signal.inRange && (strongest == BIBeaconHandleInvalid || signal.RSSI > strongestSignal.RSSI)) {
+                strongest = handle;
+                strongestSignal = signal;
+            }
+        }
+        sink = strongest;
+        rescanTime += std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        BINearestBeaconTrackerCopyStrongest(tracker, topFive, 5);
+        topFiveTime += std::chrono::steady_clock::now() - start;
+        sink = topFive[0];
+
+        BIBeaconHandle nearest = BINearestBeaconTrackerGetNearest(tracker);
+        bool isTrueNearest = (nearest != BIBeaconHandleInvalid && beaconIndex(table, nearest) == tick.trueNearest);
+        agreeing += isTrueNearest ? 1 : 0;
+        if (&tick != &ticks.front() && tick.trueNearest != (&tick - 1)->trueNearest) {
+            result.trueChanges++;
+        }
+        if (changed) {
+            result.switches++;
+            result.spuriousSwitches += isTrueNearest ? 0 : 1;
+        }
+    }
+    (void)sink;
+
+    double tickCount = double(ticks.size());
+    result.trackerNanosecondsPerTick = std::chrono::duration<double, std::nano>(trackerTime).count() / tickCount;
+    result.rescanNanosecondsPerTick = std::chrono::duration<double, std::nano>(rescanTime).count() / tickCount;
+    result.topFiveNanosecondsPerTick = std::chrono::duration<double, std::nano>(topFiveTime).count() / tickCount;
+    result.agreement = double(agreeing) / tickCount;
+    result.changedBeaconsPerTick = double(changedBeacons) / tickCount;
+
+    BINearestBeaconTrackerDestroy(tracker);
+    BISmoothingEngineDestroy(engine);
+    BIBeaconTableDestroy(table);
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    const size_t tickCount = 3600;
+    std::vector<Tick> ticks = makeWalk(tickCount);
+
+    size_t samples = 0;
+    for (const Tick &tick : ticks) {
+        samples += tick.samples.size();
+    }
+    std::printf("%u beacons, %zu ticks, %.0f beacons ranged per tick\n\n", columns * rows, tickCount,
+                double(samples) / double(tickCount));
+
+    struct Variant {
+        const char *name;
+        double margin;
+        double dwell;
+    };
+    const Variant variants[] = {
+        {"no hysteresis", 0.0, 0.0},
+        {"3 dB margin", 3.0, 0.0},
+        {"3 s dwell", 0.0, 3.0},
+        {"3 dB + 3 s (default)", 3.0, 3.0},
+    };
+
+    std::printf("%-22s %14s %14s %14s %9s %9s %10s\n", "hysteresis", "tracker ns/tk", "rescan ns/tk", "top-5 ns/tk",
+                "switches", "spurious", "agreement");
+    Result result = {};
+    for (const Variant &variant : variants) {
+        BINearestBeaconTrackerConfiguration configuration = BINearestBeaconTrackerConfigurationMakeDefault();
+        configuration.hysteresisMargin = variant.margin;
+        configuration.minimumDwellTime = variant.dwell;
+        result = replay(ticks, configuration);
+        std::printf("%-22s %14.0f %14.0f %14.0f %9u %9u %9.1f%%\n", variant.name, result.trackerNanosecondsPerTick,
+                    result.rescanNanosecondsPerTick, result.topFiveNanosecondsPerTick, result.switches,
+                    result.spuriousSwitches, 100.0 * result.agreement);
+    }
+    std::printf("\nThe geometrically nearest beacon changed %u times; %.0f smoothed signals changed per tick.\n",
+                result.trueChanges, result.changedBeaconsPerTick);
+    return 0;
+}
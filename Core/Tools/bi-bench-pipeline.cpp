@@ -0,0 +1,200 @@
+//
+//  bi-bench-pipeline.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Headless run of the ranging pipeline with 1, 10 and 50 regions. Measures the time the submitting ("main") thread
+// spends per ranging tick when smoothing runs inline (synchronous mode) and when it runs on the pipeline's worker
+// thread with delivery on a separate queue.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+// A minimal serial queue standing in for a GCD queue.
+class SerialQueue {
+public:
+    SerialQueue() : _thread(&SerialQueue::run, this) {}
+
+    ~SerialQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _available.notify_one();
+        _thread.join();
+    }
+
+    static void dispatch(void *queue, void *context, BIWorkFunction work)
+    {
+        SerialQueue *self = static_cast<SerialQueue *>(queue);
+        {
+            std::lock_guard<std::mutex> lock(self->_mutex);
+            self->_work.emplace_back(work, context);
+        }
+        self->_available.notify_one();
+    }
+
+    void drain()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _drained.wait(lock, [this] { return _work.empty() && !_running; });
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _available.wait(lock, [this] { return _stopping || !_work.empty(); });
+            if (_work.empty()) {
+                return;
+            }
+            std::pair<BIWorkFunction, void *> item = _work.front();
+            _work.pop_front();
+            _running = true;
+            lock.unlock();
+            item.first(item.second);
+            lock.lock();
+            _running = false;
+            _drained.notify_all();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _available;
+    std::condition_variable _drained;
+    std::deque<std::pair<BIWorkFunction, void *>> _work;
+    bool _running = false;
+    bool _stopping = false;
+    std::thread _thread;
+};
+
+struct DeliveryCounter {
+    uint64_t batches = 0;
+    uint64_t beacons = 0;
+    uint64_t nearestChanges = 0;
+};
+
+void countBatch(const BIRangingBatch *batch, void *context)
+{
+    DeliveryCounter *counter = static_cast<DeliveryCounter *>(context);
+    counter->batches++;
+    for (size_t i = 0; i < batch->regionCount; i++) {
+        counter->beacons += batch->regions[i].beaconCount;
+        counter->nearestChanges += batch->regions[i].nearestBeaconChanged ? 1 : 0;
+    }
+}
+
+// Pre-generated ranging reports, so that generating samples does not count as caller time.
+struct Workload {
+    std::vector<std::vector<std::vector<BIBeaconSample>>> ticks; // [tick][region] -> samples
+    std::vector<double> timestamps;
+};
+
+Workload makeWorkload(size_t regionCount, size_t beaconsPerRegion, size_t tickCount)
+{
+    Workload workload;
+    std::vector<std::unique_ptr<SyntheticRanging>> regions;
+    for (size_t r = 0; r < regionCount; r++) {
+        regions.emplace_back(new SyntheticRanging(beaconsPerRegion, 1000 + r));
+    }
+    for (size_t t = 0; t < tickCount; t++) {
+        std::vector<std::vector<BIBeaconSample>> tick;
+        for (size_t r = 0; r < regionCount; r++) {
+            std::vector<BIBeaconSample> samples = regions[r]->nextTick();
+            // Each region monitors its own beacons.
+            for (BIBeaconSample &sample : samples) {
+                sample.key.major = uint16_t(sample.key.major + 100 * r);
+            }
+            tick.push_back(std::move(samples));
+        }
+        workload.ticks.push_back(std::move(tick));
+        workload.timestamps.push_back(regions[0]->timestamp());
+    }
+    return workload;
+}
+
+struct Result {
+    double callerMicrosecondsPerTick;
+    BIRangingPipelineStatistics statistics;
+};
+
+Result run(const Workload &workload, bool synchronous)
+{
+    SerialQueue queue;
+    DeliveryCounter counter;
+    BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+    configuration.synchronous = synchronous;
+    BIRangingPipelineRef pipeline = BIRangingPipelineCreate(&configuration, BIDeliveryQueue{&SerialQueue::dispatch, &queue},
+                                                            &countBatch, &counter);
+
+    size_t regionCount = workload.ticks.front().size();
+    std::vector<uint32_t> regionIDs;
+    for (size_t r = 0; r < regionCount; r++) {
+        regionIDs.push_back(BIRangingPipelineAddRegion(pipeline));
+    }
+
+    std::chrono::steady_clock::duration callerTime{0};
+    for (size_t t = 0; t < workload.ticks.size(); t++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < regionCount; r++) {
+            const std::vector<BIBeaconSample> &samples = workload.ticks[t][r];
+            BIRangingPipelineSubmit(pipeline, regionIDs[r], workload.timestamps[t], samples.data(), samples.size());
+        }
+        callerTime += std::chrono::steady_clock::now() - start;
+
+        // Ranging callbacks arrive once per second; give the worker the gaps between ticks like the main run loop does.
+        if (!synchronous) {
+            BIRangingPipelineWaitUntilIdle(pipeline);
+        }
+    }
+    BIRangingPipelineWaitUntilIdle(pipeline);
+    queue.drain();
+
+    Result result;
+    result.callerMicrosecondsPerTick = std::chrono::duration<double, std::micro>(callerTime).count() / double(workload.ticks.size());
+    result.statistics = BIRangingPipelineGetStatistics(pipeline);
+    BIRangingPipelineDestroy(pipeline);
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    const size_t regionCounts[] = {1, 10, 50};
+    const size_t beaconsPerRegion = 20;
+    const size_t tickCount = 2000;
+
+    std::printf("%8s %20s %20s %10s %10s %10s\n", "regions", "inline (us/tick)", "pipeline (us/tick)", "reduction",
+                "delivered", "dropped");
+    for (size_t regionCount : regionCounts) {
+        Workload workload = makeWorkload(regionCount, beaconsPerRegion, tickCount);
+        Result inlineResult = run(workload, true);
+        Result pipelineResult = run(workload, false);
+        std::printf("%8zu %20.2f %20.2f %9.1fx %10llu %10llu\n", regionCount, inlineResult.callerMicrosecondsPerTick,
+                    pipelineResult.callerMicrosecondsPerTick,
+                    inlineResult.callerMicrosecondsPerTick / pipelineResult.callerMicrosecondsPerTick,
+                    (unsigned long long)pipelineResult.statistics.batchesDelivered,
+                    (unsigned long long)pipelineResult.statistics.batchesDropped);
+    }
+    return 0;
+}
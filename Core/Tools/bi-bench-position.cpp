@@ -0,0 +1,331 @@
+//
+//  bi-bench-position.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Measures the position engine on an hour of a user walking across a 56 x 40 m floor with beacons on an 8 m grid, with
+// the distances smoothed by a ranging pipeline. Reports the solves per second and the position error of the per-tick
+// trilateration and of the particle filter for several particle counts, and how often the error stays within the
+// reported uncertainty.
+//
+// With a recorded trace (the CSV format of bi-replay) and a floor map (rows of uuid,major,minor,x,y and optionally a
+// floor number), the trace is replayed instead. Without ground truth, the report is limited to the solves per second,
+// the share of ticks with a fix, the reported uncertainties and how far the filter stays from the fixes.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+#include "TraceCSV.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t columns = 8;
+const uint32_t rows = 6;
+const double spacing = 8.0;
+const double rangingRadius = 25.0;
+
+struct Tick {
+    double timestamp;
+    double x; // ground truth, NAN for recorded traces
+    double y;
+    std::vector<BIRangedBeacon> beacons;
+};
+
+void collectTick(const BIRangingBatch *batch, void *context)
+{
+    std::vector<Tick> &ticks = *static_cast<std::vector<Tick> *>(context);
+    Tick tick;
+    tick.timestamp = batch->timestamp;
+    tick.x = NAN;
+    tick.y = NAN;
+    for (size_t r = 0; r < batch->regionCount; r++) {
+        tick.beacons.insert(tick.beacons.end(), batch->regions[r].beacons,
+                            batch->regions[r].beacons + batch->regions[r].beaconCount);
+    }
+    ticks.push_back(std::move(tick));
+}
+
+std::vector<BIBeaconLocation> makeGrid()
+{
+    std::vector<BIBeaconLocation> beacons;
+    for (uint32_t i = 0; i < columns * rows; i++) {
+        BIBeaconLocation location;
+        location.key = syntheticBeaconKey(i);
+        location.x = spacing * double(i % columns);
+        location.y = spacing * double(i / columns);
+        location.floor = 0;
+        beacons.push_back(location);
+    }
+    return beacons;
+}
+
+// The user walks at 1.2 m/s to a random spot on the floor and stands there for 30 seconds. Distances follow the
+// log-distance model with 4 dB shadowing and are smoothed by a one-region synchronous pipeline, as on the device.
+std::vector<Tick> makeWalk(const std::vector<BIBeaconLocation> &beacons, size_t tickCount)
+{
+    SplitMix64 random(18);
+    const double length = spacing * (columns - 1);
+    const double width = spacing * (rows - 1);
+    std::vector<Tick> ticks;
+    BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+    configuration.synchronous = true;
+    BIRangingPipelineRef pipeline = BIRangingPipelineCreate(&configuration, BIDeliveryQueue{nullptr, nullptr}, &collectTick, &ticks);
+    uint32_t region = BIRangingPipelineAddRegion(pipeline);
+
+    double x = 0.5 * length;
+    double y = 0.5 * width;
+    double targetX = x;
+    double targetY = y;
+    double standingUntil = 30.0;
+    std::vector<BIBeaconSample> samples;
+    for (size_t t = 0; t < tickCount; t++) {
+        double remaining = std::hypot(targetX - x, targetY - y);
+        if (remaining > 1.2) {
+            x += 1.2 * (targetX - x) / remaining;
+            y += 1.2 * (targetY - y) / remaining;
+        } else if (double(t) >= standingUntil) {
+            targetX = length * random.uniform();
+            targetY = width * random.uniform();
+            standingUntil = double(t) + std::hypot(targetX - x, targetY - y) / 1.2 + 30.0;
+        } else {
+            x = targetX;
+            y = targetY;
+        }
+
+        samples.clear();
+        for (const BIBeaconLocation &beacon : beacons) {
+            double distance = std::hypot(std::hypot(beacon.x - x, beacon.y - y), 1.5);
+            if (distance > rangingRadius || random.uniform() >= 0.9) {
+                continue;
+            }
+            double RSSI = -59.0 - 20.0 * std::log10(distance) + 4.0 * random.normal();
+            BIBeaconSample sample;
+            sample.key = beacon.key;
+            sample.RSSI = int32_t(std::lround(std::min(RSSI, -1.0)));
+            sample.accuracy = std::pow(10.0, (-59.0 - double(sample.RSSI)) / 20.0);
+            sample.proximity = BIProximityForAccuracy(sample.accuracy);
+            samples.push_back(sample);
+        }
+        BIRangingPipelineSubmit(pipeline, region, double(t + 1), samples.data(), samples.size());
+        if (!ticks.empty() && std::isnan(ticks.back().x)) {
+            ticks.back().x = x;
+            ticks.back().y = y;
+        }
+    }
+    BIRangingPipelineDestroy(pipeline);
+    return ticks;
+}
+
+bool readMap(const char *path, std::vector<BIBeaconLocation> &beacons, std::string &error)
+{
+    FILE *file = std::fopen(path, "r");
+    if (file == nullptr) {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+    char buffer[256];
+    size_t lineNumber = 0;
+    bool ok = true;
+    while (ok && std::fgets(buffer, sizeof(buffer), file) != nullptr) {
+        lineNumber++;
+        std::string line(buffer);
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#' || line.compare(0, 4, "uuid") == 0) {
+            continue;
+        }
+        std::vector<std::string> fields = splitCSVLine(line);
+        BIBeaconLocation location;
+        long major;
+        long minor;
+        long floor = 0;
+        ok = (fields.size() == 5 || (fields.size() == 6 && parseInteger(fields[5], floor))) && BIBeaconKeySetUUIDString(&location.key, fields[0].c_str()) &&
+             parseInteger(fields[1], major) && parseInteger(fields[2], minor) && major >= 0 && major <= 0xFFFF &&
+             minor >= 0 && minor <= 0xFFFF && parseDouble(fields[3], location.x) && parseDouble(fields[4], location.y);
+        if (!ok) {
+            error = "line " + std::to_string(lineNumber) + ": expected uuid,major,minor,x,y[,floor]";
+            break;
+        }
+        location.key.major = uint16_t(major);
+        location.key.minor = uint16_t(minor);
+        location.floor = int32_t(floor);
+        beacons.push_back(location);
+    }
+    std::fclose(file);
+    return ok;
+}
+
+std::vector<Tick> replayTrace(const std::vector<CSVTick> &trace)
+{
+    std::vector<Tick> ticks;
+    BIRangingPipelineConfiguration configuration = BIRangingPipelineConfigurationMakeDefault();
+    configuration.synchronous = true;
+    BIRangingPipelineRef pipeline = BIRangingPipelineCreate(&configuration, BIDeliveryQueue{nullptr, nullptr}, &collectTick, &ticks);
+    uint32_t region = BIRangingPipelineAddRegion(pipeline);
+    for (const CSVTick &tick : trace) {
+        BIRangingPipelineSubmit(pipeline, region, tick.timestamp, tick.samples.data(), tick.samples.size());
+    }
+    BIRangingPipelineDestroy(pipeline);
+    return ticks;
+}
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) {
+        return NAN;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, size_t(p * double(values.size())))];
+}
+
+struct Run {
+    double solvesPerSecond;
+    std::vector<BIPosition> positions;
+};
+
+Run run(const std::vector<BIBeaconLocation> &beacons, const std::vector<Tick> &ticks, uint32_t particleCount)
+{
+    BIPositionEngineConfiguration configuration = BIPositionEngineConfigurationMakeDefault();
+    configuration.particleCount = particleCount;
+    BIPositionEngineRef engine = BIPositionEngineCreate(&configuration, beacons.data(), beacons.size());
+    Run run;
+    run.positions.resize(ticks.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ticks.size(); i++) {
+        run.positions[i] = BIPositionEngineUpdate(engine, ticks[i].timestamp, ticks[i].beacons.data(), ticks[i].beacons.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    run.solvesPerSecond = double(ticks.size()) / seconds;
+    BIPositionEngineDestroy(engine);
+    return run;
+}
+
+struct Errors {
+    std::vector<double> errors;
+    size_t withinUncertainty = 0;
+};
+
+Errors errors(const std::vector<Tick> &ticks, const std::vector<BIPosition> &positions, bool filtered)
+{
+    Errors result;
+    for (size_t i = 0; i < ticks.size(); i++) {
+        const BIPositionEstimate &estimate = filtered ? positions[i].filtered : positions[i].fix;
+        if (!estimate.valid) {
+            continue;
+        }
+        double error = std::hypot(estimate.x - ticks[i].x, estimate.y - ticks[i].y);
+        result.errors.push_back(error);
+        result.withinUncertainty += error <= estimate.uncertainty ? 1 : 0;
+    }
+    return result;
+}
+
+const uint32_t particleCounts[] = {0, 100, 300, 1000, 3000};
+
+int benchmarkSynthetic()
+{
+    std::vector<BIBeaconLocation> beacons = makeGrid();
+    std::vector<Tick> ticks = makeWalk(beacons, 3600);
+    size_t ranged = 0;
+    for (const Tick &tick : ticks) {
+        for (const BIRangedBeacon &beacon : tick.beacons) {
+            ranged += beacon.smoothedSignal.inRange ? 1 : 0;
+        }
+    }
+    std::printf("%zu beacons on a %.0f m grid, %zu ticks, %.1f beacons in range per tick\n\n", beacons.size(), spacing,
+                ticks.size(), double(ranged) / double(ticks.size()));
+    std::printf("%-18s %12s %9s %9s %9s %9s %12s\n", "estimate", "solves/s", "valid", "p50", "p90", "p99", "within unc.");
+
+    bool ok = true;
+    double fixTail = NAN;
+    for (uint32_t particleCount : particleCounts) {
+        Run result = run(beacons, ticks, particleCount);
+        if (particleCount == 0) {
+            Errors fix = errors(ticks, result.positions, false);
+            fixTail = percentile(fix.errors, 0.9);
+            std::printf("%-18s %12.0f %8.1f%% %8.2fm %8.2fm %8.2fm %11.1f%%\n", "fix only", result.solvesPerSecond,
+                        100.0 * double(fix.errors.size()) / double(ticks.size()), percentile(fix.errors, 0.5), fixTail,
+                        percentile(fix.errors, 0.99), 100.0 * double(fix.withinUncertainty) / double(fix.errors.size()));
+            ok = ok && fix.errors.size() > ticks.size() * 9 / 10;
+            continue;
+        }
+        Errors filtered = errors(ticks, result.positions, true);
+        char name[32];
+        std::snprintf(name, sizeof(name), "%u particles", particleCount);
+        double tail = percentile(filtered.errors, 0.9);
+        std::printf("%-18s %12.0f %8.1f%% %8.2fm %8.2fm %8.2fm %11.1f%%\n", name, result.solvesPerSecond,
+                    100.0 * double(filtered.errors.size()) / double(ticks.size()), percentile(filtered.errors, 0.5), tail,
+                    percentile(filtered.errors, 0.99),
+                    100.0 * double(filtered.withinUncertainty) / double(filtered.errors.size()));
+        if (particleCount >= 300) {
+            ok = ok && tail < 1.1 * fixTail;
+        }
+    }
+    std::printf("\np50, p90, p99: distance to the true position; within unc.: share of estimates whose error is at most "
+                "the reported uncertainty\n");
+    return ok ? 0 : 1;
+}
+
+int benchmarkTrace(const char *tracePath, const char *mapPath)
+{
+    std::vector<BIBeaconLocation> beacons;
+    std::vector<CSVTick> trace;
+    std::string error;
+    if (!readMap(mapPath, beacons, error) || !readCSVTrace(tracePath, trace, error)) {
+        std::fprintf(stderr, "bi-bench-position: %s\n", error.c_str());
+        return 1;
+    }
+    std::vector<Tick> ticks = replayTrace(trace);
+    std::printf("%zu mapped beacons, %zu ticks\n\n", beacons.size(), ticks.size());
+    std::printf("%-18s %12s %9s %14s %14s\n", "estimate", "solves/s", "valid", "uncertainty", "from fix p50");
+    for (uint32_t particleCount : particleCounts) {
+        Run result = run(beacons, ticks, particleCount);
+        std::vector<double> uncertainties;
+        std::vector<double> distances;
+        for (const BIPosition &position : result.positions) {
+            const BIPositionEstimate &estimate = particleCount == 0 ? position.fix : position.filtered;
+            if (estimate.valid) {
+                uncertainties.push_back(estimate.uncertainty);
+            }
+            if (particleCount > 0 && position.fix.valid && position.filtered.valid) {
+                distances.push_back(std::hypot(position.fix.x - position.filtered.x, position.fix.y - position.filtered.y));
+            }
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), particleCount == 0 ? "fix only" : "%u particles", particleCount);
+        char fromFix[32] = "-";
+        if (!distances.empty()) {
+            std::snprintf(fromFix, sizeof(fromFix), "%.2fm", percentile(distances, 0.5));
+        }
+        std::printf("%-18s %12.0f %8.1f%% %13.2fm %14s\n", name, result.solvesPerSecond,
+                    ticks.empty() ? 0.0 : 100.0 * double(uncertainties.size()) / double(ticks.size()),
+                    percentile(uncertainties, 0.5), fromFix);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc == 3) {
+        return benchmarkTrace(argv[1], argv[2]);
+    }
+    if (argc != 1) {
+        std::fprintf(stderr, "usage: bi-bench-position [trace.csv map.csv]\n");
+        return 1;
+    }
+    return benchmarkSynthetic();
+}
@@ -0,0 +1,151 @@
+//
+//  bi-bench-provisioning.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Provisions 300 simulated beacons with a new proximity UUID, major, minor, TX power level and advertising interval
+// using different numbers of concurrent connections. One connection corresponds to configuring one beacon at a time.
+// Reports the simulated duration, beacons configured per hour, the outcome per device, and checks that every beacon
+// reported as provisioned really has its target configuration. A second run is interrupted halfway, saves its progress
+// and resumes with a new provisioner to show how much work resuming saves.
+
+#include <BICore/BICore.h>
+
+#include "SimulatedPeripherals.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const size_t deviceCount = 300;
+
+struct Result {
+    double duration;
+    BIBeaconProvisionerStatistics statistics;
+    size_t statuses[8];
+    size_t confirmed; // provisioned devices that have their target configuration
+    double hostMicrosecondsPerDevice;
+};
+
+std::vector<BIBeaconProvisioningTarget> targets()
+{
+    std::vector<BIBeaconProvisioningTarget> targets(deviceCount);
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        BIBeaconProvisioningTarget &target = targets[i];
+        target.deviceID = i;
+        target.settings = BIBeaconSettingProximityUUID | BIBeaconSettingMajor | BIBeaconSettingMinor |
+                          BIBeaconSettingTXPowerLevel | BIBeaconSettingAdvertisingInterval;
+        target.key = syntheticBeaconKey(i);
+        target.TXPowerLevel = 1;
+        target.advertisingInterval = 800;
+    }
+    return targets;
+}
+
+BIBeaconProvisionerRef create(SimulatedPeripherals &peripherals, uint32_t maximumConnections)
+{
+    BIBeaconProvisionerConfiguration configuration = BIBeaconProvisionerConfigurationMakeDefault();
+    configuration.maximumConnections = maximumConnections;
+    BIGATTTransport transport = peripherals.transport();
+    BIBeaconCharacteristics characteristics = beaconCharacteristics();
+    return BIBeaconProvisionerCreate(&configuration, &characteristics, &transport,
+                                     SimulatedPeripherals::provisionerHandlers(), &peripherals);
+}
+
+void collect(Result &result, SimulatedPeripherals &peripherals, BIBeaconProvisionerRef provisioner,
+             const std::vector<BIBeaconProvisioningTarget> &targets)
+{
+    BIBeaconProvisionerStatistics statistics = BIBeaconProvisionerGetStatistics(provisioner);
+    result.statistics.devicesProvisioned += statistics.devicesProvisioned;
+    result.statistics.connectionAttempts += statistics.connectionAttempts;
+    result.statistics.timeouts += statistics.timeouts;
+    result.statistics.verificationFailures += statistics.verificationFailures;
+    for (size_t i = 0; i < 8; i++) {
+        result.statuses[i] = 0;
+    }
+    result.confirmed = 0;
+    for (size_t device = 0; device < BIBeaconProvisionerGetDeviceCount(provisioner); device++) {
+        BIBeaconProvisioningResult deviceResult = BIBeaconProvisionerGetDeviceResult(provisioner, device);
+        result.statuses[deviceResult.status]++;
+        if ((deviceResult.status == BIProvisioningStatusProvisioned ||
+             deviceResult.status == BIProvisioningStatusAlreadyProvisioned) &&
+            peripherals.hasConfiguration(deviceResult.deviceID, targets[device])) {
+            result.confirmed++;
+        }
+    }
+}
+
+Result provision(uint32_t maximumConnections, double interruptAt)
+{
+    SimulatedPeripherals peripherals(deviceCount, 33);
+    std::vector<BIBeaconProvisioningTarget> targets = ::targets();
+    Result result = {};
+
+    auto start = std::chrono::steady_clock::now();
+    BIBeaconProvisionerRef provisioner = create(peripherals, maximumConnections);
+    BIBeaconProvisionerStart(provisioner, 0.0, targets.data(), targets.size(), defaultPasskey, sizeof(defaultPasskey),
+                             nullptr, 0);
+    result.duration = peripherals.run(provisioner, 0.1, interruptAt);
+    if (!BIBeaconProvisionerIsFinished(provisioner)) {
+        // The app was terminated: save the progress and continue with a new provisioner.
+        BIBeaconProvisionerCancel(provisioner, result.duration);
+        collect(result, peripherals, provisioner, targets);
+        std::vector<uint8_t> progress(BIBeaconProvisionerCopyProgress(provisioner, nullptr, 0));
+        BIBeaconProvisionerCopyProgress(provisioner, progress.data(), progress.size());
+        BIBeaconProvisionerDestroy(provisioner);
+
+        provisioner = create(peripherals, maximumConnections);
+        BIBeaconProvisionerStart(provisioner, result.duration, targets.data(), targets.size(), defaultPasskey,
+                                 sizeof(defaultPasskey), progress.data(), progress.size());
+        result.duration = peripherals.run(provisioner);
+    }
+    double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    collect(result, peripherals, provisioner, targets);
+    result.statistics.devicesSkipped = BIBeaconProvisionerGetStatistics(provisioner).devicesSkipped;
+    BIBeaconProvisionerDestroy(provisioner);
+    result.hostMicrosecondsPerDevice = 1e6 * hostSeconds / double(deviceCount);
+    return result;
+}
+
+void print(const char *label, uint32_t connections, const Result &result)
+{
+    std::printf("%-11s %11u %8.0fs %10.0f %11zu %7zu %9zu %9zu %8zu %8zu %9llu %8llu %9zu %8.1f\n", label, connections,
+                result.duration, 3600.0 * double(result.statistics.devicesProvisioned) / result.duration,
+                result.statuses[BIProvisioningStatusProvisioned],
+                result.statuses[BIProvisioningStatusAlreadyProvisioned],
+                result.statuses[BIProvisioningStatusAuthenticationFailed],
+                result.statuses[BIProvisioningStatusNotSupported],
+                result.statuses[BIProvisioningStatusVerificationFailed], result.statuses[BIProvisioningStatusFailed],
+                (unsigned long long)result.statistics.connectionAttempts,
+                (unsigned long long)result.statistics.verificationFailures, result.confirmed,
+                result.hostMicrosecondsPerDevice);
+}
+
+} // namespace
+
+int main()
+{
+    std::printf("%zu beacons, 5 settings each, passkey authentication, verification and reboot\n\n", deviceCount);
+    std::printf("%-11s %11s %9s %10s %11s %7s %9s %9s %8s %8s %9s %8s %9s %8s\n", "run", "connections", "duration",
+                "beacons/h", "provisioned", "skipped", "auth fail", "no suppt", "mismatch", "failed", "attempts",
+                "rewrites", "confirmed", "host µs");
+    double uninterrupted = 0.0;
+    for (uint32_t connections : {1u, 2u, 4u, 8u}) {
+        Result result = provision(connections, HUGE_VAL);
+        print("complete", connections, result);
+        if (connections == 4) {
+            uninterrupted = result.duration;
+        }
+    }
+    print("resumed", 4, provision(4, uninterrupted / 2));
+    std::printf("\n\"beacons/h\" counts beacons provisioned per hour, \"rewrites\" writes that did not stick and were retried, "
+                "\"confirmed\" provisioned beacons that advertise their target configuration. The resumed run is "
+                "interrupted after half the time of the complete run with 4 connections.\n");
+    return 0;
+}
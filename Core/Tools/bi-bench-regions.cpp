@@ -0,0 +1,198 @@
+//
+//  bi-bench-regions.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Simulates four hours of 5000 monitored regions whose monitoring events arrive late, repeated and flapping, plus
+// ranging evidence for the regions the device is in, and feeds them into a region monitor that is advanced once per
+// second. Reports the CPU time per report and per advance, raw monitoring events against debounced transitions, the
+// suppression counters, and the cost of scanning one deadline per region every second for comparison.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t regionCount = 5000;
+const int duration = 4 * 60 * 60;
+const double meanTimeInside = 10.0 * 60.0;
+const double meanTimeOutside = 60.0 * 60.0;
+
+struct Event {
+    double timestamp;
+    uint32_t region;
+    BIRegionEvent event;
+
+    bool operator<(const Event &other) const
+    {
+        return timestamp != other.timestamp ? timestamp < other.timestamp : region < other.region;
+    }
+};
+
+double exponential(SplitMix64 &random, double mean)
+{
+    return -mean * std::log(1.0 - random.uniform());
+}
+
+struct Simulation {
+    std::vector<Event> events;            // raw monitoring events, sorted
+    std::vector<std::vector<bool>> inside; // per second, per region: ground truth
+    uint64_t trueEnters = 0;
+    uint64_t trueExits = 0;
+};
+
+// Each region alternates between being outside and inside. Enters are reported 1-5 seconds late and sometimes twice,
+// exits 5-60 seconds late. While inside, monitoring occasionally reports an exit immediately followed by an enter.
+Simulation simulate()
+{
+    SplitMix64 random(9);
+    Simulation simulation;
+    simulation.inside.assign(duration + 1, std::vector<bool>(regionCount, false));
+    for (uint32_t region = 0; region < regionCount; region++) {
+        double t = exponential(random, meanTimeOutside);
+        while (t < duration) {
+            double leave = t + exponential(random, meanTimeInside);
+            simulation.trueEnters++;
+            simulation.events.push_back({t + 1.0 + 4.0 * random.uniform(), region, BIRegionEventEnter});
+            if (random.uniform() < 0.3) {
+                simulation.events.push_back({t + 10.0 + 20.0 * random.uniform(), region, BIRegionEventEnter});
+            }
+            for (double flap = t + exponential(random, 300.0); flap < leave; flap += exponential(random, 300.0)) {
+                simulation.events.push_back({flap, region, BIRegionEventExit});
+                simulation.events.push_back({flap + 0.5 + 5.0 * random.uniform(), region, BIRegionEventEnter});
+            }
+            for (int second = int(std::ceil(t)); second < std::min(leave, double(duration + 1)); second++) {
+                simulation.inside[second][region] = true;
+            }
+            if (leave < duration) {
+                simulation.trueExits++;
+                simulation.events.push_back({leave + 5.0 + 55.0 * random.uniform(), region, BIRegionEventExit});
+            }
+            t = leave + exponential(random, meanTimeOutside);
+        }
+    }
+    std::sort(simulation.events.begin(), simulation.events.end());
+    return simulation;
+}
+
+struct Transitions {
+    uint64_t enters = 0;
+    uint64_t exits = 0;
+};
+
+void countTransition(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context)
+{
+    (void)regionID;
+    (void)timestamp;
+    Transitions &transitions = *static_cast<Transitions *>(context);
+    if (transition == BIRegionTransitionEnter) {
+        transitions.enters++;
+    } else {
+        transitions.exits++;
+    }
+}
+
+} // namespace
+
+int main()
+{
+    Simulation simulation = simulate();
+
+    Transitions transitions;
+    BIRegionMonitorRef monitor = BIRegionMonitorCreate(nullptr, countTransition, &transitions);
+    std::vector<uint32_t> regionIDs(regionCount);
+    for (uint32_t region = 0; region < regionCount; region++) {
+        regionIDs[region] = BIRegionMonitorAddRegion(monitor);
+    }
+
+    // Ranging runs while monitoring last said the device is inside, and misses the region's beacons in 10% of ticks.
+    SplitMix64 random(10);
+    std::vector<bool> monitoredInside(regionCount, false);
+    std::chrono::steady_clock::duration reportTime{0};
+    std::chrono::steady_clock::duration advanceTime{0};
+    std::chrono::steady_clock::duration scanTime{0};
+    uint64_t reports = 0;
+    uint64_t rangingReports = 0;
+    size_t maximumPending = 0;
+    std::vector<double> deadlines(regionCount, HUGE_VAL);
+    volatile size_t sink;
+    size_t next = 0;
+
+    for (int second = 1; second <= duration; second++) {
+        double now = double(second);
+        for (; next < simulation.events.size() && simulation.events[next].timestamp <= now; next++) {
+            const Event &event = simulation.events[next];
+            monitoredInside[event.region] = (event.event == BIRegionEventEnter);
+            auto start = std::chrono::steady_clock::now();
+            BIRegionMonitorReportEvent(monitor, regionIDs[event.region], event.timestamp, event.event);
+            reportTime += std::chrono::steady_clock::now() - start;
+            reports++;
+        }
+        for (uint32_t region = 0; region < regionCount; region++) {
+            if (!monitoredInside[region]) {
+                continue;
+            }
+            size_t inRange = (simulation.inside[second][region] && random.uniform() < 0.9) ? 1 + random.next() % 6 : 0;
+            auto start = std::chrono::steady_clock::now();
+            BIRegionMonitorReportRanging(monitor, regionIDs[region], now, inRange);
+            reportTime += std::chrono::steady_clock::now() - start;
+            reports++;
+            rangingReports++;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        BIRegionMonitorAdvance(monitor, now);
+        advanceTime += std::chrono::steady_clock::now() - start;
+        maximumPending = std::max(maximumPending, BIRegionMonitorGetPendingCount(monitor));
+
+        // What one timer per region costs at the very least: look at every region's deadline every second.
+        start = std::chrono::steady_clock::now();
+        size_t due = 0;
+        for (uint32_t region = 0; region < regionCount; region++) {
+            due += deadlines[region] <= now ? 1 : 0;
+        }
+        sink = due;
+        scanTime += std::chrono::steady_clock::now() - start;
+    }
+    (void)sink;
+
+    BIRegionMonitorStatistics statistics = BIRegionMonitorGetStatistics(monitor, 0);
+    BIRegionMonitorDestroy(monitor);
+
+    uint64_t rawEnters = 0;
+    uint64_t rawExits = 0;
+    for (const Event &event : simulation.events) {
+        rawEnters += event.event == BIRegionEventEnter ? 1 : 0;
+        rawExits += event.event == BIRegionEventExit ? 1 : 0;
+    }
+
+    std::printf("simulated:             %u regions, %d s, %llu monitoring events, %llu ranging reports\n", regionCount,
+                duration, (unsigned long long)simulation.events.size(), (unsigned long long)rangingReports);
+    std::printf("true transitions:      %llu enters, %llu exits\n", (unsigned long long)simulation.trueEnters,
+                (unsigned long long)simulation.trueExits);
+    std::printf("raw events:            %llu enters, %llu exits\n", (unsigned long long)rawEnters, (unsigned long long)rawExits);
+    std::printf("debounced:             %llu enters, %llu exits\n", (unsigned long long)transitions.enters,
+                (unsigned long long)transitions.exits);
+    std::printf("suppressed:            %llu enters, %llu exits; duplicates: %llu enters, %llu exits\n",
+                (unsigned long long)statistics.suppressedEnters, (unsigned long long)statistics.suppressedExits,
+                (unsigned long long)statistics.duplicateEnters, (unsigned long long)statistics.duplicateExits);
+    std::printf("pending transitions:   at most %zu\n", maximumPending);
+    std::printf("report:                %.0f ns per report\n",
+                std::chrono::duration<double, std::nano>(reportTime).count() / double(reports));
+    std::printf("advance:               %.0f ns per second (timer wheel)\n",
+                std::chrono::duration<double, std::nano>(advanceTime).count() / double(duration));
+    std::printf("full scan:             %.0f ns per second (one deadline per region)\n",
+                std::chrono::duration<double, std::nano>(scanTime).count() / double(duration));
+    return 0;
+}
@@ -0,0 +1,221 @@
+//
+//  bi-bench-scanner.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Simulates ten minutes of a continuous scan in a busy place: 1800 devices come and go, each present for 30-300 s
+// (about 400 at a time) and advertising at 1-10 Hz, with a fifth of the packets lost. Compares the device scanner with
+// one delta per second against what the demo's device list does, one callback per packet that searches the list
+// linearly and updates a row.
+//
+// Reports the time per packet, the callbacks and row updates per second, and checks that the devices the scanner keeps
+// track of at the end, and the list maintained from its deltas, are exactly those seen within timeToLive.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+using namespace bi::tools;
+
+// Found by argument-dependent lookup from std::sort and std::map, so not in the anonymous namespace.
+bool operator<(const BIPeripheralIdentifier &a, const BIPeripheralIdentifier &b)
+{
+    return std::memcmp(a.bytes, b.bytes, sizeof(a.bytes)) < 0;
+}
+
+bool operator==(const BIPeripheralIdentifier &a, const BIPeripheralIdentifier &b)
+{
+    return std::memcmp(a.bytes, b.bytes, sizeof(a.bytes)) == 0;
+}
+
+namespace {
+
+const uint32_t deviceCount = 1800;
+const double duration = 600.0;
+const double lossRate = 0.2;
+
+struct Packet {
+    double timestamp;
+    uint32_t device;
+    int32_t RSSI;
+};
+
+BIPeripheralIdentifier identifierForDevice(uint32_t device)
+{
+    BIPeripheralIdentifier identifier = {};
+    SplitMix64 random(device);
+    uint64_t address = random.next();
+    std::memcpy(identifier.bytes, &address, 6);
+    return identifier;
+}
+
+std::vector<Packet> makePackets()
+{
+    SplitMix64 random(21);
+    std::vector<Packet> packets;
+    for (uint32_t device = 0; device < deviceCount; device++) {
+        double stay = 30.0 + 270.0 * random.uniform();
+        double arrival = (duration + stay) * random.uniform() - stay;
+        double interval = 0.1 + 0.9 * random.uniform();
+        double distance = 1.0 + 20.0 * random.uniform();
+        for (double t = arrival + interval * random.uniform(); t < arrival + stay; t += interval) {
+            if (t < 0.0 || t >= duration || random.uniform() < lossRate) {
+                continue;
+            }
+            int32_t RSSI = int32_t(-59.0 - 20.0 * std::log10(distance) + 4.0 * random.normal());
+            packets.push_back({t, device, random.uniform() < 0.01 ? BIScannerRSSIUnavailable : RSSI});
+        }
+    }
+    std::sort(packets.begin(), packets.end(),
+              [](const Packet &a, const Packet &b) { return a.timestamp < b.timestamp; });
+    return packets;
+}
+
+// The demo's device list: an array searched linearly for every packet, with one row inserted or reloaded per packet.
+struct NaiveList {
+    struct Row {
+        BIPeripheralIdentifier identifier;
+        int32_t RSSI;
+        uint64_t packetCount;
+    };
+
+    std::vector<Row> rows;
+    uint64_t callbacks = 0;
+    uint64_t rowUpdates = 0;
+
+    void discovered(const BIPeripheralIdentifier &identifier, int32_t RSSI)
+    {
+        callbacks++;
+        rowUpdates++;
+        for (Row &row : rows) {
+            if (row.identifier == identifier) {
+                row.RSSI = RSSI;
+                row.packetCount++;
+                return;
+            }
+        }
+        rows.push_back({identifier, RSSI, 1});
+    }
+};
+
+// The list maintained from the scanner's deltas.
+struct DeltaList {
+    std::map<BIPeripheralIdentifier, BIScannedDevice> devices;
+    uint64_t callbacks = 0;
+    uint64_t rowUpdates = 0;
+    uint64_t inconsistencies = 0;
+};
+
+void scanned(const BIDeviceScanDelta *delta, void *context)
+{
+    DeltaList &list = *static_cast<DeltaList *>(context);
+    list.callbacks++;
+    list.rowUpdates += delta->addedCount + delta->updatedCount + delta->lostCount;
+    for (size_t i = 0; i < delta->lostCount; i++) {
+        list.inconsistencies += list.devices.erase(delta->lost[i].identifier) == 1 ? 0 : 1;
+    }
+    for (size_t i = 0; i < delta->addedCount; i++) {
+        list.inconsistencies += list.devices.emplace(delta->added[i].identifier, delta->added[i]).second ? 0 : 1;
+    }
+    for (size_t i = 0; i < delta->updatedCount; i++) {
+        auto device = list.devices.find(delta->updated[i].identifier);
+        if (device == list.devices.end()) {
+            list.inconsistencies++;
+        } else {
+            device->second = delta->updated[i];
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<Packet> packets = makePackets();
+    std::vector<BIPeripheralIdentifier> identifiers(deviceCount);
+    std::vector<BIAdvertisement> advertisements(deviceCount);
+    for (uint32_t device = 0; device < deviceCount; device++) {
+        identifiers[device] = identifierForDevice(device);
+        advertisements[device] = BIAdvertisement();
+        advertisements[device].type = BIAdvertisementTypeIBeacon;
+        advertisements[device].measuredPower = -59;
+        advertisements[device].key = syntheticBeaconKey(device);
+    }
+    std::printf("%zu packets from %u devices over %.0f s (%.0f packets/s)\n\n", packets.size(), deviceCount, duration,
+                double(packets.size()) / duration);
+
+    NaiveList naive;
+    auto start = std::chrono::steady_clock::now();
+    for (const Packet &packet : packets) {
+        naive.discovered(identifiers[packet.device], packet.RSSI);
+    }
+    double naiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BIDeviceScannerConfiguration configuration = BIDeviceScannerConfigurationMakeDefault();
+    DeltaList list;
+    BIDeviceScannerRef scanner = BIDeviceScannerCreate(&configuration, scanned, &list);
+    double nextTick = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (const Packet &packet : packets) {
+        // The app's timer, so that devices are lost in quiet moments too.
+        for (; nextTick <= packet.timestamp; nextTick += configuration.deliveryInterval) {
+            BIDeviceScannerAdvance(scanner, nextTick);
+        }
+        BIDeviceScannerReportPacket(scanner, &identifiers[packet.device], packet.timestamp, packet.RSSI,
+                                    &advertisements[packet.device]);
+    }
+    BIDeviceScannerFlush(scanner, duration);
+    double scannerSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-14s %10s %12s %14s %8s\n", "", "ns/packet", "callbacks/s", "row updates/s", "rows");
+    std::printf("%-14s %10.1f %12.1f %14.1f %8zu\n", "per packet", 1e9 * naiveSeconds / double(packets.size()),
+                double(naive.callbacks) / duration, double(naive.rowUpdates) / duration, naive.rows.size());
+    std::printf("%-14s %10.1f %12.1f %14.1f %8zu\n", "scanner", 1e9 * scannerSeconds / double(packets.size()),
+                double(list.callbacks) / duration, double(list.rowUpdates) / duration, list.devices.size());
+
+    // The devices seen within timeToLive before the end.
+    std::vector<double> lastSeen(deviceCount, -HUGE_VAL);
+    for (const Packet &packet : packets) {
+        lastSeen[packet.device] = packet.timestamp;
+    }
+    std::vector<BIPeripheralIdentifier> expected;
+    for (uint32_t device = 0; device < deviceCount; device++) {
+        if (lastSeen[device] + configuration.timeToLive > duration) {
+            expected.push_back(identifiers[device]);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<BIScannedDevice> devices(BIDeviceScannerGetDeviceCount(scanner));
+    devices.resize(BIDeviceScannerCopyDevices(scanner, devices.data(), devices.size()));
+    std::vector<BIPeripheralIdentifier> tracked;
+    for (const BIScannedDevice &device : devices) {
+        tracked.push_back(device.identifier);
+    }
+    std::sort(tracked.begin(), tracked.end());
+    std::vector<BIPeripheralIdentifier> listed;
+    for (const auto &device : list.devices) {
+        listed.push_back(device.first);
+    }
+
+    BIDeviceScannerStatistics statistics = BIDeviceScannerGetStatistics(scanner);
+    bool matches = tracked == expected && listed == expected && list.inconsistencies == 0;
+    std::printf("\n%llu devices added, %llu lost (%llu evicted), %zu tracked at the end: %s\n",
+                (unsigned long long)statistics.devicesAdded, (unsigned long long)statistics.devicesLost,
+                (unsigned long long)statistics.devicesEvicted, tracked.size(),
+                matches ? "matches the devices seen within timeToLive" : "MISMATCH");
+    std::printf("%.0fx fewer callbacks and %.0fx fewer row updates than one callback per packet\n",
+                double(naive.callbacks) / double(list.callbacks), double(naive.rowUpdates) / double(list.rowUpdates));
+    BIDeviceScannerDestroy(scanner);
+    return matches ? 0 : 1;
+}
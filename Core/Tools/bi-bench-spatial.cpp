@@ -0,0 +1,233 @@
+//
+//  bi-bench-spatial.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Measures the spatial index on venues of 1,000 to 100,000 beacons spread over several floors at about one beacon per
+// 50 m², a third of them in dense clusters (shops, gates). Reports the build time, the memory the index occupies and
+// the latency of identity lookups, 8-nearest queries and 25 m radius queries, next to a linear scan over the floor.
+// Every query is checked against the linear scan; the tool exits with 1 if any result differs.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const double areaPerBeacon = 50.0;
+const size_t k = 8;
+const double radius = 25.0;
+const size_t queryCount = 2000;
+
+struct Venue {
+    size_t beaconCount;
+    int32_t floorCount;
+};
+
+struct Query {
+    int32_t floor;
+    double x;
+    double y;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<BIBeaconLocation> makeVenue(const Venue &venue, double &side, SplitMix64 &random)
+{
+    size_t perFloor = venue.beaconCount / size_t(venue.floorCount);
+    side = std::sqrt(double(perFloor) * areaPerBeacon);
+    std::vector<BIBeaconLocation> beacons;
+    for (uint32_t i = 0; i < venue.beaconCount; i++) {
+        BIBeaconLocation location;
+        location.key = syntheticBeaconKey(i);
+        location.floor = int32_t(i % uint32_t(venue.floorCount));
+        if (i % 3 == 0) {
+            // 20 clusters per floor with a spread of 5 m.
+            SplitMix64 cluster(uint64_t(location.floor) * 1000 + random.next() % 20);
+            location.x = std::min(std::max(cluster.uniform() * side + 5.0 * random.normal(), 0.0), side);
+            location.y = std::min(std::max(cluster.uniform() * side + 5.0 * random.normal(), 0.0), side);
+        } else {
+            location.x = random.uniform() * side;
+            location.y = random.uniform() * side;
+        }
+        beacons.push_back(location);
+    }
+    return beacons;
+}
+
+// The linear scan keeps the k nearest beacons the same way as the index, so the distances compare exactly.
+size_t scanNearest(const std::vector<BIBeaconLocation> &beacons, const Query &query, BISpatialMatch *matches)
+{
+    size_t found = 0;
+    for (const BIBeaconLocation &beacon : beacons) {
+        if (beacon.floor != query.floor) {
+            continue;
+        }
+        double dx = beacon.x - query.x;
+        double dy = beacon.y - query.y;
+        double distance = dx * dx + dy * dy;
+        if (found == k && distance >= matches[k - 1].distance) {
+            continue;
+        }
+        size_t position = found < k ? found++ : k - 1;
+        while (position > 0 && matches[position - 1].distance > distance) {
+            matches[position] = matches[position - 1];
+            position--;
+        }
+        matches[position].location = beacon;
+        matches[position].distance = distance;
+    }
+    for (size_t i = 0; i < found; i++) {
+        matches[i].distance = std::sqrt(matches[i].distance);
+    }
+    return found;
+}
+
+size_t scanWithinRadius(const std::vector<BIBeaconLocation> &beacons, const Query &query, BISpatialMatch *matches,
+                        size_t capacity)
+{
+    size_t found = 0;
+    for (const BIBeaconLocation &beacon : beacons) {
+        double dx = beacon.x - query.x;
+        double dy = beacon.y - query.y;
+        if (beacon.floor == query.floor && dx * dx + dy * dy <= radius * radius) {
+            if (found < capacity) {
+                matches[found].location = beacon;
+                matches[found].distance = std::sqrt(dx * dx + dy * dy);
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+std::vector<double> sortedDistances(const BISpatialMatch *matches, size_t count)
+{
+    std::vector<double> distances;
+    for (size_t i = 0; i < count; i++) {
+        distances.push_back(matches[i].distance);
+    }
+    std::sort(distances.begin(), distances.end());
+    return distances;
+}
+
+} // namespace
+
+int main()
+{
+    const Venue venues[] = {{1000, 2}, {10000, 5}, {100000, 10}};
+
+    std::printf("%8s %7s %10s %10s %8s %10s %10s %10s %10s %10s %9s\n", "beacons", "floors", "build ms", "memory",
+                "B/beacon", "lookup ns", "8-NN ns", "scan ns", "25 m ns", "scan ns", "in 25 m");
+    bool identical = true;
+    for (const Venue &venue : venues) {
+        SplitMix64 random(venue.beaconCount);
+        double side;
+        std::vector<BIBeaconLocation> beacons = makeVenue(venue, side, random);
+        std::vector<Query> queries;
+        for (size_t i = 0; i < queryCount; i++) {
+            queries.push_back({int32_t(random.next() % uint64_t(venue.floorCount)), random.uniform() * side,
+                               random.uniform() * side});
+        }
+
+        // Best of three builds.
+        double buildSeconds = HUGE_VAL;
+        BISpatialIndexRef index = nullptr;
+        for (int run = 0; run < 3; run++) {
+            BISpatialIndexDestroy(index);
+            auto start = std::chrono::steady_clock::now();
+            index = BISpatialIndexCreate(nullptr, beacons.data(), beacons.size());
+            buildSeconds = std::min(buildSeconds, secondsSince(start));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        size_t located = 0;
+        for (size_t i = 0; i < queryCount; i++) {
+            BIBeaconLocation location;
+            located += BISpatialIndexGetLocation(index, &beacons[(i * 7919) % beacons.size()].key, &location) ? 1 : 0;
+        }
+        double lookupSeconds = secondsSince(start);
+        identical = identical && located == queryCount;
+
+        std::vector<BISpatialMatch> nearest(queryCount * k);
+        std::vector<size_t> nearestCounts(queryCount);
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < queryCount; i++) {
+            nearestCounts[i] = BISpatialIndexFindNearest(index, queries[i].floor, queries[i].x, queries[i].y, k,
+                                                         &nearest[i * k]);
+        }
+        double nearestSeconds = secondsSince(start);
+
+        std::vector<BISpatialMatch> scanned(queryCount * k);
+        std::vector<size_t> scannedCounts(queryCount);
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < queryCount; i++) {
+            scannedCounts[i] = scanNearest(beacons, queries[i], &scanned[i * k]);
+        }
+        double nearestScanSeconds = secondsSince(start);
+        for (size_t i = 0; i < queryCount; i++) {
+            identical = identical && nearestCounts[i] == scannedCounts[i];
+            for (size_t j = 0; j < std::min(nearestCounts[i], scannedCounts[i]); j++) {
+                identical = identical && nearest[i * k + j].distance == scanned[i * k + j].distance;
+            }
+        }
+
+        // Dense clusters hold a few hundred beacons within 25 m; the buffers take them all so that the sets compare.
+        const size_t capacity = 2048;
+        std::vector<BISpatialMatch> within(queryCount * capacity);
+        std::vector<size_t> withinCounts(queryCount);
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < queryCount; i++) {
+            withinCounts[i] = BISpatialIndexFindWithinRadius(index, queries[i].floor, queries[i].x, queries[i].y, radius,
+                                                             &within[i * capacity], capacity);
+        }
+        double radiusSeconds = secondsSince(start);
+
+        std::vector<BISpatialMatch> withinScanned(queryCount * capacity);
+        std::vector<size_t> withinScannedCounts(queryCount);
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < queryCount; i++) {
+            withinScannedCounts[i] = scanWithinRadius(beacons, queries[i], &withinScanned[i * capacity], capacity);
+        }
+        double radiusScanSeconds = secondsSince(start);
+        size_t totalWithin = 0;
+        for (size_t i = 0; i < queryCount; i++) {
+            size_t copied = std::min(withinCounts[i], capacity);
+            identical = identical && withinCounts[i] == withinScannedCounts[i] &&
+                        sortedDistances(&within[i * capacity], copied) ==
+                            sortedDistances(&withinScanned[i * capacity], copied);
+            totalWithin += withinCounts[i];
+        }
+
+        size_t storage = BISpatialIndexGetStorageSize(index);
+        double perQuery = 1e9 / double(queryCount);
+        std::printf("%8zu %7d %10.2f %9.1fk %8.1f %10.0f %10.0f %10.0f %10.0f %10.0f %9.1f\n", venue.beaconCount,
+                    venue.floorCount, 1e3 * buildSeconds, double(storage) / 1024.0,
+                    double(storage) / double(venue.beaconCount), lookupSeconds * perQuery, nearestSeconds * perQuery,
+                    nearestScanSeconds * perQuery, radiusSeconds * perQuery, radiusScanSeconds * perQuery,
+                    double(totalWithin) / double(queryCount));
+        BISpatialIndexDestroy(index);
+    }
+
+    std::printf("\n%zu queries per venue at random points; scan: linear scan over all beacons; in 25 m: beacons per "
+                "radius query\n",
+                queryCount);
+    if (!identical) {
+        std::printf("FAIL: the index disagrees with the linear scan\n");
+        return 1;
+    }
+    return 0;
+}
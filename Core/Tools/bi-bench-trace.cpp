@@ -0,0 +1,186 @@
+//
+//  bi-bench-trace.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Records a synthetic 24-hour trace (three regions with 40 beacons each, ranged once per second, plus region events
+// and Bluetooth state changes) with BITraceRecorder and replays it twice. Reports the cost of recording on the calling
+// thread, the size of the trace compared to CSV, the replay speed and whether both replays produced the same output.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+#include "TraceCSV.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t regionCount = 3;
+const size_t beaconsPerRegion = 40;
+const int day = 24 * 60 * 60;
+
+struct Digest {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    uint64_t batches = 0;
+    uint64_t nearestBeaconChanges = 0;
+    uint64_t regionEvents = 0;
+    uint64_t regionTransitions = 0;
+
+    void add(uint64_t value)
+    {
+        for (int i = 0; i < 8; i++) {
+            hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 0x100000001B3ULL;
+        }
+    }
+};
+
+void digestBatch(const BIRangingBatch *batch, void *context)
+{
+    Digest &digest = *static_cast<Digest *>(context);
+    digest.batches++;
+    digest.add(batch->sequenceNumber);
+    for (size_t i = 0; i < batch->regionCount; i++) {
+        const BIRegionRangingResult &region = batch->regions[i];
+        digest.add(region.regionID);
+        digest.add(region.nearestBeacon ? region.nearestBeacon->handle : BIBeaconHandleInvalid);
+        digest.nearestBeaconChanges += region.nearestBeaconChanged ? 1 : 0;
+        for (size_t j = 0; j < region.beaconCount; j++) {
+            digest.add(region.beacons[j].handle);
+            digest.add(uint64_t(int64_t(region.beacons[j].smoothedSignal.RSSI)));
+        }
+    }
+}
+
+void digestTransition(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context)
+{
+    Digest &digest = *static_cast<Digest *>(context);
+    digest.regionTransitions++;
+    digest.add(regionID);
+    digest.add(uint64_t(transition));
+    digest.add(uint64_t(int64_t(timestamp * 1e6)));
+}
+
+void digestRecord(const BITraceRecord *record, void *context)
+{
+    Digest &digest = *static_cast<Digest *>(context);
+    if (record->type == BITraceRecordRegionEvent) {
+        digest.regionEvents++;
+        digest.add(record->regionID);
+        digest.add(uint64_t(record->regionEvent));
+    }
+}
+
+bool replay(const char *path, Digest &digest, double &seconds)
+{
+    BITraceReplayHandlers handlers = {digestBatch, digestTransition, digestRecord};
+    BITraceReplayerRef replayer = BITraceReplayerCreate(path, nullptr, handlers, &digest);
+    if (replayer == nullptr) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool ok = BITraceReplayerRun(replayer);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    BITraceReplayerDestroy(replayer);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "bi-bench-trace.bitrace";
+    BITraceRecorderRef recorder = BITraceRecorderCreate(path, nullptr);
+    if (recorder == nullptr) {
+        std::fprintf(stderr, "bi-bench-trace: cannot create %s\n", path);
+        return 1;
+    }
+
+    std::vector<SyntheticRanging> regions;
+    for (uint32_t region = 0; region < regionCount; region++) {
+        regions.emplace_back(beaconsPerRegion, 100 + region);
+        BITraceRecorderRecordRegionDefinition(recorder, region + 1, 0.0, region == 0 ? "entrance" : region == 1 ? "hall" : "checkout");
+    }
+    SplitMix64 random(7);
+    FILE *CSV = std::tmpfile();
+
+    double recordingNanoseconds = 0.0;
+    uint64_t samples = 0;
+    uint64_t rangingRecords = 0;
+    uint64_t CSVSamples = 0;
+    for (int second = 1; second <= day; second++) {
+        double timestamp = double(second);
+        if (second % (8 * 60 * 60) == 0) {
+            BITraceRecorderRecordBluetoothState(recorder, timestamp, BIBluetoothStatePoweredOff);
+            BITraceRecorderRecordBluetoothState(recorder, timestamp + 0.5, BIBluetoothStatePoweredOn);
+        }
+        // The entrance region flaps for a few minutes every two hours, like in an enter/exit storm.
+        if (second % (2 * 60 * 60) < 300 && second % 20 == 0) {
+            BITraceRecorderRecordRegionEvent(recorder, 1, timestamp, BIRegionEventExit);
+            BITraceRecorderRecordRegionEvent(recorder, 1, timestamp + 0.2 + random.uniform(), BIRegionEventEnter);
+        }
+
+        for (uint32_t region = 0; region < regionCount; region++) {
+            const std::vector<BIBeaconSample> &tick = regions[region].nextTick();
+            double reported = timestamp + 0.001 * region;
+            auto start = std::chrono::steady_clock::now();
+            BITraceRecorderRecordRanging(recorder, region + 1, reported, tick.data(), tick.size());
+            recordingNanoseconds += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            rangingRecords++;
+            samples += tick.size();
+
+            // The CSV size is extrapolated from the first hour.
+            if (CSV != nullptr && second <= 60 * 60) {
+                CSVSamples += tick.size();
+                for (const BIBeaconSample &sample : tick) {
+                    writeCSVRow(CSV, reported, sample.key, &sample, BISignalMakeNotInRange(reported));
+                }
+            }
+        }
+    }
+
+    BITraceRecorderFlush(recorder);
+    BITraceRecorderStatistics statistics = BITraceRecorderGetStatistics(recorder);
+    BITraceRecorderDestroy(recorder);
+    double CSVBytesPerBeacon = 0.0;
+    if (CSV != nullptr) {
+        CSVBytesPerBeacon = double(std::ftell(CSV)) / double(CSVSamples);
+        std::fclose(CSV);
+    }
+
+    std::printf("recorded:              %d s, %llu ranging records, %llu beacons\n", day, (unsigned long long)rangingRecords,
+                (unsigned long long)samples);
+    std::printf("recording cost:        %.0f ns per ranging record on the calling thread\n",
+                recordingNanoseconds / double(rangingRecords));
+    std::printf("dropped records:       %llu\n", (unsigned long long)statistics.recordsDropped);
+    std::printf("trace size:            %.2f MB (%.2f bytes per beacon)\n", double(statistics.bytesWritten) / 1e6,
+                double(statistics.bytesWritten) / double(samples));
+    std::printf("CSV size:              %.2f MB (%.2f bytes per beacon)\n", CSVBytesPerBeacon * double(samples) / 1e6,
+                CSVBytesPerBeacon);
+
+    Digest first;
+    Digest second;
+    double firstSeconds = 0.0;
+    double secondSeconds = 0.0;
+    if (!replay(path, first, firstSeconds) || !replay(path, second, secondSeconds)) {
+        std::fprintf(stderr, "bi-bench-trace: replay failed\n");
+        return 1;
+    }
+    std::remove(path);
+
+    double seconds = std::min(firstSeconds, secondSeconds);
+    std::printf("replay:                %.3f s (%.0fx real time), %llu batches, %llu nearest-beacon changes, %llu region events\n",
+                seconds, double(day) / seconds, (unsigned long long)first.batches,
+                (unsigned long long)first.nearestBeaconChanges, (unsigned long long)first.regionEvents);
+    std::printf("region transitions:    %llu after debouncing\n", (unsigned long long)first.regionTransitions);
+    bool deterministic = (first.hash == second.hash && first.batches == second.batches);
+    std::printf("deterministic:         %s (%016llx)\n", deterministic ? "yes" : "NO", (unsigned long long)first.hash);
+    return deterministic ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+//
+//  bi-bench-upload-queue.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Measures the upload queue on a device that ranges about 12 beacons once per second for 8 hours and crosses a region
+// boundary every 10 minutes. The queue sends to a stand-in for the backend's upload endpoint, which answers every
+// request after 300 ms with the outcome of an HTTP status and feeds the uploads it accepts to an ingestion aggregator.
+// Three runs: always online; offline for 3 hours with 20% of the requests failing, 5% of the responses lost after the
+// backend processed the upload, and the app relaunched every 2 hours; and a 64 KiB log that stays offline for the whole
+// run. Reports the bytes per sighting sent and written to the log, the number of requests next to one request per
+// ranging callback, and the CPU time of the queue per ranging batch and per upload.
+//
+// After each run the device comes back online until the log is drained. The first two runs must deliver every sighting
+// and region event to the backend exactly once (retried uploads are skipped by their sequence number); the third must
+// deliver every region event, drop only sighting uploads and never let the log grow past its limit. The tool exits with
+// 1 if any of these checks fails.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace bi::tools;
+
+namespace {
+
+const double duration = 8 * 3600.0;
+const double latency = 0.3;
+const double advanceInterval = 5.0;
+const double regionInterval = 600.0;
+const size_t beaconCount = 16;
+const uint8_t deviceID[16] = {0x3C, 0x1F, 0x5A, 0x77, 0x02, 0xE4, 0x4B, 0x19,
+                              0x8D, 0x61, 0xC0, 0x2A, 0x95, 0x0E, 0xB3, 0x48};
+
+struct Scenario {
+    const char *name;
+    double offlineStart;
+    double offlineEnd;
+    double failureRate;
+    double lostRate;
+    double relaunchInterval; // 0 for none
+    uint32_t maximumLogSize;
+    uint32_t segmentSize;
+};
+
+// The backend's upload endpoint: one request at a time, answered after the latency.
+class Backend {
+public:
+    Backend(double failureRate, double lostRate)
+        : _random(0xBAC4E2D), _failureRate(failureRate), _lostRate(lostRate)
+    {
+        BIIngestionConfiguration configuration = BIIngestionConfigurationMakeDefault();
+        configuration.threadCount = 1;
+        _aggregator = BIIngestionAggregatorCreate(&configuration, nullptr, 0);
+        _reader = BIUploadReaderCreate();
+    }
+
+    ~Backend()
+    {
+        BIIngestionAggregatorDestroy(_aggregator);
+        BIUploadReaderDestroy(_reader);
+    }
+
+    void receive(const uint8_t *bytes, size_t length, double now)
+    {
+        _request.assign(bytes, bytes + length);
+        _responseTime = now + latency;
+        _waiting = true;
+        _bytesReceived += length;
+    }
+
+    // The app was terminated before the response arrived.
+    void cancel() { _waiting = false; }
+
+    // Answers the request once the latency has passed.
+    bool respond(double now, bool online, BIUploadResult &result)
+    {
+        if (!_waiting || now < _responseTime) {
+            return false;
+        }
+        _waiting = false;
+        if (!online || _random.uniform() < _failureRate) {
+            result = BIUploadResultFailed; // no connection, or 503
+            return true;
+        }
+        if (BIUploadGetKind(_request.data(), _request.size()) == BIUploadKindRegionEvents &&
+            BIUploadReaderOpen(_reader, _request.data(), _request.size())) {
+            BIUploadInfo info = BIUploadReaderGetInfo(_reader);
+            if (_regionEventUploads.insert(info.sequenceNumber).second) {
+                _regionEvents += info.regionEventCount;
+            }
+        }
+        BIUploadBuffer buffer = {_request.data(), _request.size()};
+        uint64_t rejected = BIIngestionAggregatorGetStatistics(_aggregator).rejectedUploads;
+        BIIngestionAggregatorAddUploads(_aggregator, &buffer, 1);
+        if (BIIngestionAggregatorGetStatistics(_aggregator).rejectedUploads != rejected) {
+            result = BIUploadResultRejected; // 400
+        } else if (_random.uniform() < _lostRate) {
+            result = BIUploadResultFailed; // processed, but the response never arrived
+        } else {
+            result = BIUploadResultAccepted; // 200, also for uploads that were already processed
+        }
+        return true;
+    }
+
+    BIIngestionStatistics statistics() const { return BIIngestionAggregatorGetStatistics(_aggregator); }
+    uint64_t regionEvents() const { return _regionEvents; }
+    uint64_t bytesReceived() const { return _bytesReceived; }
+
+private:
+    SplitMix64 _random;
+    double _failureRate;
+    double _lostRate;
+    BIIngestionAggregatorRef _aggregator;
+    BIUploadReaderRef _reader;
+
+    std::vector<uint8_t> _request;
+    double _responseTime = 0.0;
+    bool _waiting = false;
+
+    std::set<uint64_t> _regionEventUploads;
+    uint64_t _regionEvents = 0;
+    uint64_t _bytesReceived = 0;
+};
+
+struct Device {
+    Backend *backend;
+    double now;
+};
+
+void sendUpload(const uint8_t *bytes, size_t length, void *context)
+{
+    Device *device = static_cast<Device *>(context);
+    device->backend->receive(bytes, length, device->now);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void removeDirectory(const std::string &path)
+{
+    if (DIR *directory = opendir(path.c_str())) {
+        while (struct dirent *entry = readdir(directory)) {
+            if (entry->d_name[0] != '.') {
+                unlink((path + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(directory);
+    }
+    rmdir(path.c_str());
+}
+
+bool run(const Scenario &scenario)
+{
+    char directory[] = "/tmp/bi-bench-upload-queue.XXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        std::perror("mkdtemp");
+        return false;
+    }
+    std::string path = std::string(directory) + "/queue";
+
+    BIUploadQueueConfiguration configuration = BIUploadQueueConfigurationMakeDefault();
+    if (scenario.maximumLogSize != 0) {
+        configuration.maximumLogSize = scenario.maximumLogSize;
+        configuration.segmentSize = scenario.segmentSize;
+    }
+    Backend backend(scenario.failureRate, scenario.lostRate);
+    Device device = {&backend, 0.0};
+    double queueSeconds = 0.0;
+    auto begin = std::chrono::steady_clock::now();
+    BIUploadQueueRef queue = BIUploadQueueOpen(path.c_str(), &configuration, deviceID, sendUpload, &device);
+    queueSeconds += secondsSince(begin);
+    if (queue == nullptr) {
+        std::printf("FAIL: %s: cannot open the queue\n", scenario.name);
+        return false;
+    }
+
+    // Statistics of the queues before a relaunch.
+    BIUploadQueueStatistics closed = {};
+    auto accumulate = [&closed](const BIUploadQueueStatistics &statistics) {
+        closed.appendedUploads += statistics.appendedUploads;
+        closed.appendedBytes += statistics.appendedBytes;
+        closed.recoveredUploads += statistics.recoveredUploads;
+        closed.requests += statistics.requests;
+        closed.failedRequests += statistics.failedRequests;
+        closed.rejectedUploads += statistics.rejectedUploads;
+        closed.droppedSightingUploads += statistics.droppedSightingUploads;
+        closed.droppedRegionEventUploads += statistics.droppedRegionEventUploads;
+        closed.failedIO += statistics.failedIO;
+    };
+
+    SyntheticRanging ranging(beaconCount, 0x5167, 0.75);
+    std::vector<BIRangedBeacon> beacons;
+    uint64_t ticks = 0;
+    uint64_t sightings = 0;
+    uint64_t regionEvents = 0;
+    uint64_t maximumLogSize = 0;
+    bool online = true;
+
+    auto respond = [&]() {
+        BIUploadResult result;
+        if (backend.respond(device.now, online, result)) {
+            auto start = std::chrono::steady_clock::now();
+            BIUploadQueueDidSend(queue, device.now, result);
+            queueSeconds += secondsSince(start);
+        }
+    };
+    auto setOnline = [&](bool value) {
+        online = value;
+        auto start = std::chrono::steady_clock::now();
+        BIUploadQueueSetReachable(queue, online, device.now);
+        queueSeconds += secondsSince(start);
+    };
+
+    while (ranging.timestamp() < duration) {
+        const std::vector<BIBeaconSample> &samples = ranging.nextTick();
+        device.now = ranging.timestamp();
+        if (device.now == scenario.offlineStart) {
+            setOnline(false);
+        } else if (device.now == scenario.offlineEnd) {
+            setOnline(true);
+        }
+        respond();
+
+        beacons.resize(samples.size());
+        for (size_t i = 0; i < samples.size(); i++) {
+            beacons[i] = {};
+            beacons[i].key = samples[i].key;
+            beacons[i].rawSignal = {device.now, samples[i].RSSI, samples[i].proximity, samples[i].accuracy, true};
+            beacons[i].smoothedSignal = beacons[i].rawSignal;
+        }
+        BIRegionRangingResult region = {};
+        region.regionID = 1;
+        region.beacons = beacons.data();
+        region.beaconCount = beacons.size();
+        BIRangingBatch batch = {ticks, device.now, &region, 1};
+        ticks++;
+        sightings += samples.size();
+
+        auto start = std::chrono::steady_clock::now();
+        BIUploadQueueAddBatch(queue, &batch);
+        if (std::fmod(device.now, regionInterval) == 0.0) {
+            uint32_t crossing = uint32_t(device.now / regionInterval);
+            BIUploadQueueAddRegionEvent(queue, 1 + crossing % 3, device.now,
+                                        crossing % 2 ? BIRegionEventEnter : BIRegionEventExit);
+            regionEvents++;
+        }
+        if (std::fmod(device.now, advanceInterval) == 0.0) {
+            BIUploadQueueAdvance(queue, device.now);
+        }
+        if (scenario.relaunchInterval > 0.0 && std::fmod(device.now, scenario.relaunchInterval) == 0.0) {
+            BIUploadQueueFlush(queue);
+            accumulate(BIUploadQueueGetStatistics(queue));
+            BIUploadQueueClose(queue);
+            backend.cancel();
+            queue = BIUploadQueueOpen(path.c_str(), &configuration, deviceID, sendUpload, &device);
+            if (queue == nullptr) {
+                std::printf("FAIL: %s: cannot reopen the queue\n", scenario.name);
+                return false;
+            }
+            BIUploadQueueSetReachable(queue, online, device.now);
+        }
+        queueSeconds += secondsSince(start);
+        maximumLogSize = std::max(maximumLogSize, BIUploadQueueGetStatistics(queue).logSize);
+    }
+
+    // Back online until everything is delivered.
+    BIUploadQueueFlush(queue);
+    setOnline(true);
+    for (double end = device.now + 24 * 3600.0; device.now < end; device.now += 1.0) {
+        respond();
+        auto start = std::chrono::steady_clock::now();
+        BIUploadQueueAdvance(queue, device.now);
+        queueSeconds += secondsSince(start);
+        if (BIUploadQueueGetStatistics(queue).pendingUploads == 0) {
+            break;
+        }
+    }
+    BIUploadQueueStatistics statistics = BIUploadQueueGetStatistics(queue);
+    accumulate(statistics);
+    BIUploadQueueClose(queue);
+    removeDirectory(path);
+    rmdir(directory);
+
+    BIIngestionStatistics delivered = backend.statistics();
+    uint64_t uploads = closed.appendedUploads;
+    std::printf("%-8s %8llu %10llu %8llu %9llu %7llu %9llu %8llu %9.2f %9.2f %9.2f %10.1f\n", scenario.name,
+                (unsigned long long)ticks, (unsigned long long)delivered.sightings, (unsigned long long)uploads,
+                (unsigned long long)closed.requests, (unsigned long long)closed.failedRequests,
+                (unsigned long long)closed.recoveredUploads,
+                (unsigned long long)(closed.droppedSightingUploads + closed.droppedRegionEventUploads),
+                double(backend.bytesReceived()) / double(delivered.sightings),
+                double(closed.appendedBytes + 8 * uploads) / double(sightings), queueSeconds / double(ticks) * 1e6,
+                queueSeconds / double(uploads) * 1e6);
+
+    bool complete = statistics.pendingUploads == 0 && closed.failedIO == 0 && closed.rejectedUploads == 0 &&
+                    backend.regionEvents() == regionEvents && closed.droppedRegionEventUploads == 0;
+    if (scenario.maximumLogSize == 0) {
+        complete = complete && delivered.sightings == sightings && closed.droppedSightingUploads == 0;
+    } else {
+        complete = complete && delivered.sightings < sightings && closed.droppedSightingUploads > 0 &&
+                   maximumLogSize <= scenario.maximumLogSize;
+    }
+    if (scenario.relaunchInterval > 0.0) {
+        complete = complete && closed.recoveredUploads > 0 && delivered.duplicateUploads > 0;
+    }
+    if (!complete) {
+        std::printf("FAIL: %s: %llu of %llu sightings and %llu of %llu region events delivered, %llu pending, "
+                    "%llu region event uploads dropped, log up to %llu bytes\n",
+                    scenario.name, (unsigned long long)delivered.sightings, (unsigned long long)sightings,
+                    (unsigned long long)backend.regionEvents(), (unsigned long long)regionEvents,
+                    (unsigned long long)statistics.pendingUploads,
+                    (unsigned long long)closed.droppedRegionEventUploads, (unsigned long long)maximumLogSize);
+    }
+    return complete;
+}
+
+} // namespace
+
+int main()
+{
+    const Scenario scenarios[] = {
+        {"online", -1.0, -1.0, 0.0, 0.0, 0.0, 0, 0},
+        {"flaky", 3600.0, 4 * 3600.0, 0.2, 0.05, 2 * 3600.0, 0, 0},
+        {"full", 1.0, duration + 1.0, 0.0, 0.0, 0.0, 64 * 1024, 8 * 1024},
+    };
+
+    std::printf("%-8s %8s %10s %8s %9s %7s %9s %8s %9s %9s %9s %10s\n", "run", "ticks", "delivered", "uploads",
+                "requests", "failed", "recovered", "dropped", "B/sent", "B/disk", "us/batch", "us/upload");
+    bool passed = true;
+    for (const Scenario &scenario : scenarios) {
+        passed = run(scenario) && passed;
+    }
+    std::printf("\nB/sent: bytes received by the backend per delivered sighting, retries included; B/disk: bytes "
+                "appended to the log per sighting. One request per ranging callback would be %.0f requests.\n",
+                duration);
+    return passed ? 0 : 1;
+}
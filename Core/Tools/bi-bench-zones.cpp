@@ -0,0 +1,445 @@
+//
+//  bi-bench-zones.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Measures the zone engine on an hour of a user walking through a venue with 1,000 beacons on a 4 m grid. The zones
+// are rules over a beacon and its neighbours: single beacons within a proximity, any of three above an RSSI, two with
+// a dwell time, two of four, and "near A but not B". Reports the time per ranging tick next to evaluating every rule
+// in every tick, and how many zone programs the engine ran.
+//
+// The straightforward evaluation is also the reference: dwell times are whole seconds and ticks come every second, so
+// both must report the same zones inside after every tick and the same number of transitions. The tool exits with 1
+// if they differ, or if the 99th percentile tick with 5,000 zones takes longer than 100 µs.
+
+#include <BICore/BICore.h>
+
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+const uint32_t columns = 40;
+const uint32_t rows = 25;
+const double spacing = 4.0;
+const double rangingRadius = 25.0;
+const size_t tickCount = 3600;
+const double budgetMicroseconds = 100.0;
+
+struct Zone {
+    std::vector<BIZoneNode> nodes;
+    std::vector<uint32_t> beacons; // of the beacon nodes, in node order
+    BIZoneDefinition definition;
+};
+
+BIZoneNode beaconNode(uint32_t beacon, int32_t minimumRSSI, BIProximity maximumProximity, double dwellTime)
+{
+    BIZoneNode node = {};
+    node.type = BIZoneNodeBeacon;
+    node.key = syntheticBeaconKey(beacon);
+    node.minimumRSSI = minimumRSSI;
+    node.maximumProximity = maximumProximity;
+    node.dwellTime = dwellTime;
+    return node;
+}
+
+BIZoneNode combination(BIZoneNodeType type, uint32_t childCount, uint32_t threshold = 0)
+{
+    BIZoneNode node = {};
+    node.type = type;
+    node.childCount = childCount;
+    node.threshold = threshold;
+    return node;
+}
+
+uint32_t neighbour(uint32_t beacon, SplitMix64 &random)
+{
+    int64_t column = int64_t(beacon % columns) + int64_t(random.next() % 5) - 2;
+    int64_t row = int64_t(beacon / columns) + int64_t(random.next() % 5) - 2;
+    column = std::min<int64_t>(std::max<int64_t>(column, 0), columns - 1);
+    row = std::min<int64_t>(std::max<int64_t>(row, 0), rows - 1);
+    return uint32_t(row * columns + column);
+}
+
+std::vector<Zone> makeZones(size_t count)
+{
+    SplitMix64 random(count);
+    std::vector<Zone> zones(count);
+    for (size_t z = 0; z < count; z++) {
+        Zone &zone = zones[z];
+        uint32_t beacon = uint32_t(random.next() % (columns * rows));
+        auto add = [&](uint32_t b, int32_t minimumRSSI, BIProximity maximumProximity, double dwellTime) {
+            zone.nodes.push_back(beaconNode(b, minimumRSSI, maximumProximity, dwellTime));
+            zone.beacons.push_back(b);
+        };
+        switch (random.next() % 10) {
+        case 0:
+        case 1:
+        case 2:
+            add(beacon, 0, BIProximityNear, 0.0);
+            break;
+        case 3:
+        case 4:
+            zone.nodes.push_back(combination(BIZoneNodeAny, 3));
+            add(beacon, -75, BIProximityUnknown, 0.0);
+            add(neighbour(beacon, random), -75, BIProximityUnknown, 0.0);
+            add(neighbour(beacon, random), -75, BIProximityUnknown, 0.0);
+            break;
+        case 5:
+        case 6:
+            zone.nodes.push_back(combination(BIZoneNodeAll, 2));
+            add(beacon, -80, BIProximityUnknown, 2.0);
+            add(neighbour(beacon, random), -80, BIProximityUnknown, 0.0);
+            break;
+        case 7:
+        case 8:
+            zone.nodes.push_back(combination(BIZoneNodeAtLeast, 4, 2));
+            for (int i = 0; i < 4; i++) {
+                add(i == 0 ? beacon : neighbour(beacon, random), -78, BIProximityUnknown, 0.0);
+            }
+            break;
+        default:
+            zone.nodes.push_back(combination(BIZoneNodeAll, 2));
+            add(beacon, 0, BIProximityNear, 1.0);
+            zone.nodes.push_back(combination(BIZoneNodeNot, 1));
+            add(neighbour(beacon, random), -65, BIProximityUnknown, 0.0);
+            break;
+        }
+        zone.definition.zoneID = uint32_t(z + 1);
+        zone.definition.nodes = zone.nodes.data();
+        zone.definition.nodeCount = zone.nodes.size();
+        zone.definition.enterDwellTime = double(random.next() % 3);
+        zone.definition.exitDwellTime = double(random.next() % 6);
+    }
+    return zones;
+}
+
+// The user walks at 1.2 m/s to a random spot in the venue and stands there for 30 seconds. Every beacon within the
+// ranging radius reports a noisy RSSI and proximity; beacons up to 5 m beyond it are reported out of range, like the
+// ranging pipeline does for beacons it still tracks.
+std::vector<std::vector<BIRangedBeacon>> makeWalk()
+{
+    SplitMix64 random(0x20);
+    std::vector<std::vector<BIRangedBeacon>> ticks;
+    double width = spacing * (columns - 1);
+    double height = spacing * (rows - 1);
+    double x = width / 2.0;
+    double y = height / 2.0;
+    double targetX = x;
+    double targetY = y;
+    double pause = 0.0;
+    for (size_t t = 0; t < tickCount; t++) {
+        double dx = targetX - x;
+        double dy = targetY - y;
+        double remaining = std::hypot(dx, dy);
+        if (remaining <= 1.2) {
+            x = targetX;
+            y = targetY;
+            if (pause <= 0.0) {
+                pause = 30.0;
+                targetX = random.uniform() * width;
+                targetY = random.uniform() * height;
+            }
+        }
+        if (pause > 0.0) {
+            pause -= 1.0;
+        } else if (remaining > 1.2) {
+            x += 1.2 * dx / remaining;
+            y += 1.2 * dy / remaining;
+        }
+
+        std::vector<BIRangedBeacon> beacons;
+        for (uint32_t b = 0; b < columns * rows; b++) {
+            double distance = std::hypot(spacing * double(b % columns) - x, spacing * double(b / columns) - y);
+            if (distance > rangingRadius + 5.0) {
+                continue;
+            }
+            BIRangedBeacon beacon = {};
+            beacon.handle = b;
+            beacon.key = syntheticBeaconKey(b);
+            BISignal &signal = beacon.smoothedSignal;
+            signal.timestamp = double(t);
+            signal.inRange = distance <= rangingRadius;
+            if (signal.inRange) {
+                signal.RSSI = int32_t(std::lround(-59.0 - 20.0 * std::log10(std::max(distance, 0.5)) + 2.0 * random.normal()));
+                signal.accuracy = std::max(distance, 0.1) * std::exp(0.2 * random.normal());
+                signal.proximity = int32_t(BIProximityForAccuracy(signal.accuracy));
+            } else {
+                signal.accuracy = -1.0;
+            }
+            beacon.rawSignal = signal;
+            beacons.push_back(beacon);
+        }
+        ticks.push_back(std::move(beacons));
+    }
+    return ticks;
+}
+
+// Evaluates every rule in every tick. At tick t the dwell times that ended at t take effect first (with the previous
+// readings), then the tick's readings; the zones are evaluated after each step.
+class Reference {
+public:
+    explicit Reference(const std::vector<Zone> &zones) : _zones(zones)
+    {
+        for (const Zone &zone : zones) {
+            ZoneState state = {};
+            state.firstCondition = _conditions.size();
+            for (size_t i = 0, c = 0; i < zone.nodes.size(); i++) {
+                if (zone.nodes[i].type == BIZoneNodeBeacon) {
+                    _conditions.push_back(Condition{&zone.nodes[i], zone.beacons[c++], false, false, 0.0});
+                }
+            }
+            _states.push_back(state);
+        }
+        _readings.assign(columns * rows, Reading{false, 0, 0});
+    }
+
+    void update(double timestamp, const std::vector<BIRangedBeacon> &beacons)
+    {
+        for (Condition &condition : _conditions) {
+            if (condition.holds && !condition.value && condition.since + condition.node->dwellTime <= timestamp) {
+                condition.value = true;
+            }
+        }
+        evaluateAll(timestamp);
+        for (size_t z = 0; z < _zones.size(); z++) {
+            if (_states[z].pending != Pending::None && _states[z].due <= timestamp) {
+                fire(z);
+            }
+        }
+
+        std::fill(_readings.begin(), _readings.end(), Reading{false, 0, 0});
+        for (const BIRangedBeacon &beacon : beacons) {
+            _readings[beacon.handle] = Reading{beacon.smoothedSignal.inRange, beacon.smoothedSignal.RSSI,
+                                               beacon.smoothedSignal.proximity};
+        }
+        for (Condition &condition : _conditions) {
+            const Reading &reading = _readings[condition.beacon];
+            const BIZoneNode &node = *condition.node;
+            bool holds = reading.inRange && (node.minimumRSSI == 0 || (reading.RSSI != 0 && reading.RSSI >= node.minimumRSSI)) &&
+                         (node.maximumProximity == BIProximityUnknown ||
+                          (reading.proximity != BIProximityUnknown && reading.proximity <= node.maximumProximity));
+            if (holds != condition.holds) {
+                condition.holds = holds;
+                condition.since = timestamp;
+                condition.value = holds && node.dwellTime <= 0.0;
+            }
+        }
+        evaluateAll(timestamp);
+    }
+
+    bool isInside(size_t zone) const { return _states[zone].inside; }
+    uint64_t transitions() const { return _transitions; }
+
+private:
+    enum class Pending { None, Enter, Exit };
+
+    struct Reading {
+        bool inRange;
+        int32_t RSSI;
+        int32_t proximity;
+    };
+
+    struct Condition {
+        const BIZoneNode *node;
+        uint32_t beacon;
+        bool holds;
+        bool value;
+        double since;
+    };
+
+    struct ZoneState {
+        size_t firstCondition;
+        bool value;
+        bool inside;
+        Pending pending;
+        double due;
+    };
+
+    bool evaluateNode(const Zone &zone, size_t &node, size_t &condition) const
+    {
+        const BIZoneNode &current = zone.nodes[node++];
+        if (current.type == BIZoneNodeBeacon) {
+            return _conditions[condition++].value;
+        }
+        uint32_t holding = 0;
+        for (uint32_t i = 0; i < current.childCount; i++) {
+            holding += evaluateNode(zone, node, condition) ? 1 : 0;
+        }
+        switch (current.type) {
+        case BIZoneNodeAll:
+            return holding == current.childCount;
+        case BIZoneNodeAny:
+            return holding > 0;
+        case BIZoneNodeAtLeast:
+            return holding >= current.threshold;
+        default:
+            return holding == 0;
+        }
+    }
+
+    void evaluateAll(double timestamp)
+    {
+        for (size_t z = 0; z < _zones.size(); z++) {
+            ZoneState &state = _states[z];
+            size_t node = 0;
+            size_t condition = state.firstCondition;
+            bool value = evaluateNode(_zones[z], node, condition);
+            if (value == state.value) {
+                continue;
+            }
+            state.value = value;
+            const BIZoneDefinition &definition = _zones[z].definition;
+            if (value && state.inside) {
+                state.pending = Pending::None;
+            } else if (value) {
+                state.pending = Pending::Enter;
+                state.due = timestamp + definition.enterDwellTime;
+            } else if (state.inside) {
+                state.pending = Pending::Exit;
+                state.due = timestamp + definition.exitDwellTime;
+            } else {
+                state.pending = Pending::None;
+            }
+            if (state.pending != Pending::None && state.due <= timestamp) {
+                fire(z);
+            }
+        }
+    }
+
+    void fire(size_t zone)
+    {
+        _states[zone].inside = _states[zone].pending == Pending::Enter;
+        _states[zone].pending = Pending::None;
+        _transitions++;
+    }
+
+    const std::vector<Zone> &_zones;
+    std::vector<Condition> _conditions;
+    std::vector<ZoneState> _states;
+    std::vector<Reading> _readings;
+    uint64_t _transitions = 0;
+};
+
+void countTransition(uint32_t, BIZoneTransition, double, void *context)
+{
+    (*static_cast<uint64_t *>(context))++;
+}
+
+struct Result {
+    double meanMicroseconds;
+    double p50Microseconds;
+    double p99Microseconds;
+    double maxMicroseconds;
+    double referenceMicroseconds;
+    double evaluationsPerTick;
+    uint64_t transitions;
+    bool identical;
+};
+
+Result run(const std::vector<Zone> &zones, const std::vector<std::vector<BIRangedBeacon>> &ticks)
+{
+    std::vector<BIZoneDefinition> definitions;
+    for (const Zone &zone : zones) {
+        definitions.push_back(zone.definition);
+    }
+    Result result = {};
+
+    // Timed on its own, so that the reference does not evict the engine's state from the caches between ticks.
+    uint64_t transitions = 0;
+    BIZoneEngineRef engine = BIZoneEngineCreate(nullptr, definitions.data(), definitions.size(), &countTransition, &transitions);
+    if (engine == nullptr) {
+        return result;
+    }
+    std::vector<double> durations;
+    for (size_t t = 0; t < ticks.size(); t++) {
+        auto start = std::chrono::steady_clock::now();
+        BIZoneEngineUpdate(engine, double(t), ticks[t].data(), ticks[t].size());
+        durations.push_back(1e6 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    BIZoneEngineStatistics statistics = BIZoneEngineGetStatistics(engine);
+    BIZoneEngineDestroy(engine);
+
+    uint64_t checkedTransitions = 0;
+    engine = BIZoneEngineCreate(nullptr, definitions.data(), definitions.size(), &countTransition, &checkedTransitions);
+    Reference reference(zones);
+    result.identical = true;
+    auto start = std::chrono::steady_clock::now();
+    double referenceSeconds = 0.0;
+    for (size_t t = 0; t < ticks.size() && result.identical; t++) {
+        BIZoneEngineUpdate(engine, double(t), ticks[t].data(), ticks[t].size());
+        start = std::chrono::steady_clock::now();
+        reference.update(double(t), ticks[t]);
+        referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (size_t z = 0; z < zones.size(); z++) {
+            result.identical = result.identical && BIZoneEngineIsInside(engine, uint32_t(z + 1)) == reference.isInside(z);
+        }
+    }
+    result.identical = result.identical && transitions == reference.transitions() && checkedTransitions == transitions;
+    BIZoneEngineDestroy(engine);
+
+    double total = 0.0;
+    for (double duration : durations) {
+        total += duration;
+    }
+    std::sort(durations.begin(), durations.end());
+    result.meanMicroseconds = total / double(durations.size());
+    result.p50Microseconds = durations[durations.size() / 2];
+    result.p99Microseconds = durations[durations.size() * 99 / 100];
+    result.maxMicroseconds = durations.back();
+    result.referenceMicroseconds = 1e6 * referenceSeconds / double(durations.size());
+    result.evaluationsPerTick = double(statistics.zoneEvaluations) / double(statistics.ticks);
+    result.transitions = transitions;
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<std::vector<BIRangedBeacon>> ticks = makeWalk();
+    size_t reported = 0;
+    for (const auto &tick : ticks) {
+        reported += tick.size();
+    }
+    std::printf("%u beacons on a %.0f m grid, %zu ticks, %.1f beacons reported per tick\n\n", columns * rows, spacing,
+                ticks.size(), double(reported) / double(ticks.size()));
+
+    std::printf("%8s %9s %9s %9s %9s %12s %12s %12s\n", "zones", "mean us", "p50 us", "p99 us", "max us",
+                "all rules us", "programs/tk", "transitions");
+    const size_t zoneCounts[] = {1000, 5000, 20000};
+    bool identical = true;
+    double budgetedP99 = 0.0;
+    for (size_t zoneCount : zoneCounts) {
+        Result result = run(makeZones(zoneCount), ticks);
+        identical = identical && result.identical;
+        if (zoneCount == 5000) {
+            budgetedP99 = result.p99Microseconds;
+        }
+        std::printf("%8zu %9.1f %9.1f %9.1f %9.1f %12.1f %12.1f %12llu\n", zoneCount, result.meanMicroseconds,
+                    result.p50Microseconds, result.p99Microseconds, result.maxMicroseconds, result.referenceMicroseconds,
+                    result.evaluationsPerTick, (unsigned long long)result.transitions);
+    }
+
+    std::printf("\nus: time of BIZoneEngineUpdate per tick; all rules: evaluating every rule in every tick; programs/tk: "
+                "zone programs the engine ran per tick\n");
+    if (!identical) {
+        std::printf("FAIL: the engine disagrees with evaluating every rule\n");
+        return 1;
+    }
+    if (budgetedP99 > budgetMicroseconds) {
+        std::printf("FAIL: 99th percentile tick with 5000 zones takes %.1f us, more than %.0f us\n", budgetedP99,
+                    budgetMicroseconds);
+        return 1;
+    }
+    return 0;
+}
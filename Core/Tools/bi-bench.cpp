@@ -0,0 +1,398 @@
+//
+//  bi-bench.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// The benchmark suite of the beacon pipeline, one benchmark per stage at realistic beacon counts: interning beacon
+// identities (what beaconWithProximityUUID:major:minor: does for every ranged beacon), appending to the signal
+// histories, smoothing a ranging tick with each filter, nearest-beacon selection, region monitoring and advertisement
+// parsing. Reports the median CPU time per iteration (one ranging tick, or one pass over the beacons or packets) and
+// the throughput in items per second, and writes the results as JSON (see Benchmark.hpp).
+//
+// With --baseline, the results are compared with an earlier JSON file; the tool exits with 1 if any benchmark got
+// slower than the threshold, or if a benchmark of the baseline did not run (unless --allow-missing is given). --compare
+// compares two JSON files without running anything.
+
+#include <BICore/BICore.h>
+
+#include "Benchmark.hpp"
+#include "SignalHistory.hpp"
+#include "SyntheticAdvertisements.hpp"
+#include "SyntheticRanging.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "usage: bi-bench [options]\n"
+                 "       bi-bench --compare <baseline.json> <current.json> [--threshold P] [--allow-missing]\n"
+                 "\n"
+                 "options:\n"
+                 "  --filter REGEX      run the benchmarks whose name matches (default: all)\n"
+                 "  --list              list the benchmarks and exit\n"
+                 "  --min-time S        minimum duration of a run in seconds (default: 0.2)\n"
+                 "  --repetitions N     runs per benchmark; the median is reported (default: 3)\n"
+                 "  --json PATH         write the results as JSON ('-' for stdout)\n"
+                 "  --baseline PATH     compare the results with an earlier JSON file\n"
+                 "  --threshold P       CPU time increase in percent that counts as a regression (default: 10)\n"
+                 "  --allow-missing     do not fail if a benchmark of the baseline is missing from the results\n");
+}
+
+volatile uint64_t sink;
+
+const size_t tickCount = 64;
+
+// Ranging ticks of count beacons, 90% of them in each tick.
+std::vector<std::vector<BIBeaconSample>> makeTicks(size_t count)
+{
+    SyntheticRanging ranging(count, 24);
+    std::vector<std::vector<BIBeaconSample>> ticks;
+    for (size_t i = 0; i < tickCount; i++) {
+        ticks.push_back(ranging.nextTick());
+    }
+    return ticks;
+}
+
+void internBeacons(BenchmarkState &state)
+{
+    size_t count = size_t(state.argument());
+    std::vector<BIBeaconKey> keys;
+    for (size_t i = 0; i < count; i++) {
+        keys.push_back(syntheticBeaconKey(uint32_t(i)));
+    }
+    SplitMix64 random(24);
+    for (size_t i = count; i > 1; i--) {
+        std::swap(keys[i - 1], keys[random.next() % i]);
+    }
+    BIBeaconTableConfiguration configuration = BIBeaconTableConfigurationMakeDefault();
+    configuration.maximumCount = std::max(configuration.maximumCount, uint32_t(count));
+    BIBeaconTableRef table = BIBeaconTableCreate(&configuration);
+    for (const BIBeaconKey &key : keys) {
+        BIBeaconTableIntern(table, &key, 0.0);
+    }
+
+    uint64_t checksum = 0;
+    double timestamp = 0.0;
+    while (state.keepRunning()) {
+        timestamp += 1.0;
+        for (const BIBeaconKey &key : keys) {
+            checksum += BIBeaconTableIntern(table, &key, timestamp);
+        }
+    }
+    sink = checksum;
+    BIBeaconTableDestroy(table);
+    state.setItemsPerIteration(double(count));
+}
+
+void appendHistory(BenchmarkState &state)
+{
+    uint32_t count = uint32_t(state.argument());
+    bi::SignalHistoryStore store(60);
+    for (uint32_t i = 0; i < count; i++) {
+        store.addSeries();
+    }
+
+    BISignal signal = {0.0, -70, 2, 1.5, true};
+    while (state.keepRunning()) {
+        signal.timestamp += 1.0;
+        for (uint32_t i = 0; i < count; i++) {
+            signal.RSSI = -60 - int32_t(i % 30);
+            store.append(i, signal);
+        }
+    }
+    sink = uint64_t(store.last(0).RSSI);
+    state.setItemsPerIteration(double(count));
+}
+
+void smooth(BenchmarkState &state, BISmoothingFilter filter)
+{
+    std::vector<std::vector<BIBeaconSample>> ticks = makeTicks(size_t(state.argument()));
+    BISmoothingConfiguration configuration = BISmoothingConfigurationMakeDefault();
+    configuration.filter = filter;
+    BISmoothingEngineRef engine = BISmoothingEngineCreate(&configuration);
+
+    size_t samples = 0;
+    uint64_t tick = 0;
+    while (state.keepRunning()) {
+        const std::vector<BIBeaconSample> &samplesOfTick = ticks[tick % tickCount];
+        tick++;
+        BISmoothingEngineProcessTick(engine, double(tick), samplesOfTick.data(), samplesOfTick.size());
+        samples += samplesOfTick.size();
+    }
+    sink = BISmoothingEngineGetBeaconCount(engine);
+    BISmoothingEngineDestroy(engine);
+    state.setItemsPerIteration(tick > 0 ? double(samples) / double(tick) : 0.0);
+}
+
+void smoothWindowAverage(BenchmarkState &state) { smooth(state, BISmoothingFilterWindowAverage); }
+void smoothEWMA(BenchmarkState &state) { smooth(state, BISmoothingFilterEWMA); }
+void smoothKalman(BenchmarkState &state) { smooth(state, BISmoothingFilterKalman); }
+void smoothMedian(BenchmarkState &state) { smooth(state, BISmoothingFilterMedian); }
+
+// Every beacon reports a new smoothed signal in every tick, which is then evaluated with hysteresis.
+void selectNearest(BenchmarkState &state)
+{
+    size_t count = size_t(state.argument());
+    SplitMix64 random(24);
+    std::vector<std::vector<int32_t>> RSSIs(tickCount, std::vector<int32_t>(count));
+    for (size_t beacon = 0; beacon < count; beacon++) {
+        double base = -60.0 - 30.0 * random.uniform();
+        for (size_t tick = 0; tick < tickCount; tick++) {
+            RSSIs[tick][beacon] = int32_t(std::lround(base + 3.0 * random.normal()));
+        }
+    }
+    BINearestBeaconTrackerRef tracker = BINearestBeaconTrackerCreate(nullptr);
+
+    uint64_t checksum = 0;
+    uint64_t tick = 0;
+    while (state.keepRunning()) {
+        const std::vector<int32_t> &RSSIsOfTick = RSSIs[tick % tickCount];
+        tick++;
+        for (size_t beacon = 0; beacon < count; beacon++) {
+            BISignal signal = {double(tick), RSSIsOfTick[beacon], 2, 2.0, true};
+            BINearestBeaconTrackerUpdate(tracker, BIBeaconHandle(beacon), &signal);
+        }
+        BINearestBeaconTrackerEvaluate(tracker, double(tick));
+        checksum += BINearestBeaconTrackerGetNearest(tracker);
+    }
+    sink = checksum;
+    BINearestBeaconTrackerDestroy(tracker);
+    state.setItemsPerIteration(double(count));
+}
+
+void countTransition(uint32_t, BIRegionTransition, double, void *context)
+{
+    (*static_cast<uint64_t *>(context))++;
+}
+
+// One ranging tick of all regions. A region is entered and left every minute or so; while the device is inside,
+// monitoring reports the entry and ranging finds some of its beacons in most ticks.
+void monitorRegions(BenchmarkState &state)
+{
+    uint32_t count = uint32_t(state.argument());
+    const size_t period = 1024;
+    SplitMix64 random(24);
+    std::vector<std::vector<uint8_t>> beaconsInRange(period, std::vector<uint8_t>(count));
+    std::vector<std::vector<int8_t>> events(period, std::vector<int8_t>(count, -1));
+    for (uint32_t region = 0; region < count; region++) {
+        bool inside = random.uniform() < 0.5;
+        for (size_t tick = 0; tick < period; tick++) {
+            if (random.uniform() < 1.0 / 60.0) {
+                inside = !inside;
+                events[tick][region] = inside ? BIRegionEventEnter : BIRegionEventExit;
+            }
+            beaconsInRange[tick][region] = (inside && random.uniform() < 0.9) ? uint8_t(1 + random.next() % 6) : 0;
+        }
+    }
+    uint64_t transitions = 0;
+    BIRegionMonitorRef monitor = BIRegionMonitorCreate(nullptr, countTransition, &transitions);
+    std::vector<uint32_t> regionIDs(count);
+    for (uint32_t &regionID : regionIDs) {
+        regionID = BIRegionMonitorAddRegion(monitor);
+    }
+
+    uint64_t tick = 0;
+    while (state.keepRunning()) {
+        size_t index = tick % period;
+        tick++;
+        double timestamp = double(tick);
+        for (uint32_t region = 0; region < count; region++) {
+            if (events[index][region] >= 0) {
+                BIRegionMonitorReportEvent(monitor, regionIDs[region], timestamp, BIRegionEvent(events[index][region]));
+            }
+            BIRegionMonitorReportRanging(monitor, regionIDs[region], timestamp, beaconsInRange[index][region]);
+        }
+        BIRegionMonitorAdvance(monitor, timestamp);
+    }
+    sink = transitions;
+    BIRegionMonitorDestroy(monitor);
+    state.setItemsPerIteration(double(count));
+}
+
+void decodePackets(BenchmarkState &state, const std::vector<Packet> &packets)
+{
+    uint64_t decoded = 0;
+    while (state.keepRunning()) {
+        for (const Packet &packet : packets) {
+            BIAdvertisement advertisement;
+            decoded += BIAdvertisementDecodePayload(packet.data(), packet.size(), &advertisement) ? 1 : 0;
+        }
+    }
+    sink = decoded;
+    state.setItemsPerIteration(double(packets.size()));
+}
+
+void decodeIBeacons(BenchmarkState &state)
+{
+    std::vector<Packet> packets;
+    for (uint32_t i = 0; i < 1024; i++) {
+        packets.push_back(iBeaconPacket(syntheticBeaconKey(i), -59));
+    }
+    decodePackets(state, packets);
+}
+
+void decodeMixed(BenchmarkState &state) { decodePackets(state, syntheticAdvertisements(1024, 24)); }
+
+struct Definition {
+    const char *name;
+    BenchmarkFunction function;
+    std::vector<int64_t> arguments; // empty for benchmarks without an argument
+};
+
+const Definition definitions[] = {
+    {"intern", internBeacons, {100, 1000, 10000}},
+    {"history/append", appendHistory, {100, 1000, 10000}},
+    {"smoothing/window", smoothWindowAverage, {10, 100, 1000}},
+    {"smoothing/ewma", smoothEWMA, {100}},
+    {"smoothing/kalman", smoothKalman, {100}},
+    {"smoothing/median", smoothMedian, {100}},
+    {"nearest", selectNearest, {10, 100, 1000}},
+    {"regions", monitorRegions, {10, 100, 1000}},
+    {"advertisement/ibeacon", decodeIBeacons, {}},
+    {"advertisement/mixed", decodeMixed, {}},
+};
+
+int compareFiles(const char *baselinePath, const char *currentPath, double threshold, bool allowMissing, FILE *output)
+{
+    std::vector<BenchmarkResult> baseline;
+    std::vector<BenchmarkResult> current;
+    if (!readBenchmarkJSON(baselinePath, baseline)) {
+        std::fprintf(stderr, "error: cannot read benchmark results from %s\n", baselinePath);
+        return 2;
+    }
+    if (!readBenchmarkJSON(currentPath, current)) {
+        std::fprintf(stderr, "error: cannot read benchmark results from %s\n", currentPath);
+        return 2;
+    }
+    BenchmarkComparison comparison = compareBenchmarks(output, baseline, current, threshold, allowMissing);
+    return reportBenchmarkComparison(output, comparison, threshold, allowMissing) ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    const char *filter = nullptr;
+    const char *JSONPath = nullptr;
+    const char *baselinePath = nullptr;
+    const char *comparedPaths[2] = {nullptr, nullptr};
+    double threshold = 0.1;
+    bool allowMissing = false;
+    bool list = false;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+        if (std::strcmp(argv[i], "--filter") == 0 && hasValue) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && hasValue) {
+            options.minimumTime = std::max(std::strtod(argv[++i], nullptr), 0.001);
+        } else if (std::strcmp(argv[i], "--repetitions") == 0 && hasValue) {
+            options.repetitions = uint32_t(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--json") == 0 && hasValue) {
+            JSONPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            baselinePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--threshold") == 0 && hasValue) {
+            threshold = std::max(std::strtod(argv[++i], nullptr), 0.0) / 100.0;
+        } else if (std::strcmp(argv[i], "--allow-missing") == 0) {
+            allowMissing = true;
+        } else if (std::strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            comparedPaths[0] = argv[++i];
+            comparedPaths[1] = argv[++i];
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+    if (comparedPaths[0] != nullptr) {
+        return compareFiles(comparedPaths[0], comparedPaths[1], threshold, allowMissing, stdout);
+    }
+
+    std::regex pattern;
+    try {
+        pattern = std::regex(filter != nullptr ? filter : "");
+    } catch (const std::regex_error &) {
+        std::fprintf(stderr, "error: invalid filter %s\n", filter);
+        return 2;
+    }
+
+    // The table goes to stderr if the JSON goes to stdout.
+    bool JSONToStdout = JSONPath != nullptr && std::strcmp(JSONPath, "-") == 0;
+    FILE *output = JSONToStdout ? stderr : stdout;
+    if (!list) {
+        std::fprintf(output, "%-32s %14s %14s %12s %7s %16s\n", "benchmark", "time (ns)", "CPU (ns)", "iterations",
+                     "cv", "items/s");
+    }
+    std::vector<BenchmarkResult> results;
+    for (const Definition &definition : definitions) {
+        std::vector<int64_t> arguments = definition.arguments.empty() ? std::vector<int64_t>{0} : definition.arguments;
+        for (int64_t argument : arguments) {
+            std::string name = definition.name;
+            if (!definition.arguments.empty()) {
+                name += "/" + std::to_string(argument);
+            }
+            if (filter != nullptr && !std::regex_search(name, pattern)) {
+                continue;
+            }
+            if (list) {
+                std::printf("%s\n", name.c_str());
+                continue;
+            }
+            BenchmarkResult result = runBenchmark(name, definition.function, argument, options);
+            std::fprintf(output, "%-32s %14.1f %14.1f %12llu %6.1f%% %16.4g\n", result.name.c_str(), result.realTime,
+                         result.CPUTime, (unsigned long long)result.iterations, 100.0 * result.deviation,
+                         result.itemsPerSecond);
+            std::fflush(output);
+            results.push_back(result);
+        }
+    }
+    if (list) {
+        return 0;
+    }
+
+    if (JSONPath != nullptr) {
+        FILE *file = JSONToStdout ? stdout : std::fopen(JSONPath, "w");
+        if (file == nullptr) {
+            std::fprintf(stderr, "error: cannot write %s\n", JSONPath);
+            return 2;
+        }
+        writeBenchmarkJSON(file, results, argv[0], options);
+        if (!JSONToStdout) {
+            std::fclose(file);
+        }
+    }
+
+    if (baselinePath != nullptr) {
+        std::vector<BenchmarkResult> baseline;
+        if (!readBenchmarkJSON(baselinePath, baseline)) {
+            std::fprintf(stderr, "error: cannot read benchmark results from %s\n", baselinePath);
+            return 2;
+        }
+        if (filter != nullptr) {
+            baseline.erase(std::remove_if(baseline.begin(), baseline.end(),
+                                          [&pattern](const BenchmarkResult &result) {
+                                              return !std::regex_search(result.name, pattern);
+                                          }),
+                           baseline.end());
+        }
+        std::fprintf(output, "\n");
+        BenchmarkComparison comparison = compareBenchmarks(output, baseline, results, threshold, allowMissing);
+        return reportBenchmarkComparison(output, comparison, threshold, allowMissing) ? 1 : 0;
+    }
+    return 0;
+}
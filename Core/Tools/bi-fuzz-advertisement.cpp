@@ -0,0 +1,146 @@
+//
+//  bi-fuzz-advertisement.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Fuzz target for the advertisement decoders. Every input is decoded as a raw payload, as manufacturer data and as
+// Eddystone service data, and the results are checked for consistency: decoded URLs must lie within the input, and
+// re-encoding a decoded iBeacon must yield the same key.
+//
+// Built with BICORE_BUILD_FUZZERS (Clang), the target is linked with libFuzzer and the sanitizers. Otherwise this file
+// has a standalone driver: without arguments it mutates a corpus of valid packets for a fixed number of iterations,
+// with file arguments it runs those files (e.g. crashes found by libFuzzer).
+
+#include <BICore/BICore.h>
+
+#include "SyntheticAdvertisements.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace bi::tools;
+
+namespace {
+
+void check(bool condition, const char *message)
+{
+    if (!condition) {
+        std::fprintf(stderr, "check failed: %s\n", message);
+        std::abort();
+    }
+}
+
+void checkAdvertisement(const BIAdvertisement &advertisement, const uint8_t *data, size_t size)
+{
+    if (advertisement.type == BIAdvertisementTypeEddystoneURL) {
+        check(advertisement.URL >= data && advertisement.URL + advertisement.URLLength <= data + size,
+              "URL lies within the input");
+        char small[8];
+        char large[512];
+        size_t length = BIAdvertisementCopyURL(&advertisement, small, sizeof(small));
+        check(BIAdvertisementCopyURL(&advertisement, large, sizeof(large)) == length, "URL length does not depend on capacity");
+        check(length < sizeof(large) && std::strlen(large) == length, "expanded URL is complete");
+        check(std::strlen(small) == sizeof(small) - 1 && std::strncmp(small, large, sizeof(small) - 1) == 0,
+              "truncated URL is a prefix");
+    } else if (advertisement.type == BIAdvertisementTypeIBeacon) {
+        Packet packet = iBeaconPacket(advertisement.key, advertisement.measuredPower);
+        BIAdvertisement decoded;
+        check(BIAdvertisementDecodePayload(packet.data(), packet.size(), &decoded) &&
+                  BIBeaconKeyEqual(&decoded.key, &advertisement.key) &&
+                  decoded.measuredPower == advertisement.measuredPower,
+              "iBeacon round trip");
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    BIAdvertisement advertisement;
+    if (BIAdvertisementDecodePayload(data, size, &advertisement)) {
+        checkAdvertisement(advertisement, data, size);
+    }
+    if (BIAdvertisementDecodeManufacturerData(data, size, &advertisement)) {
+        check(advertisement.type == BIAdvertisementTypeIBeacon, "manufacturer data is iBeacon");
+        checkAdvertisement(advertisement, data, size);
+    }
+    if (BIAdvertisementDecodeServiceData(0xFEAA, data, size, &advertisement)) {
+        check(advertisement.type != BIAdvertisementTypeIBeacon, "service data is Eddystone");
+        checkAdvertisement(advertisement, data, size);
+    }
+    return 0;
+}
+
+#ifndef BI_LIBFUZZER
+
+namespace {
+
+// Flips bits, overwrites, inserts and removes bytes and truncates the packet.
+void mutate(Packet &packet, SplitMix64 &random)
+{
+    size_t mutations = 1 + random.next() % 4;
+    for (size_t i = 0; i < mutations; i++) {
+        size_t position = packet.empty() ? 0 : random.next() % packet.size();
+        switch (random.next() % 5) {
+        case 0:
+            if (!packet.empty()) {
+                packet[position] ^= uint8_t(1 << (random.next() % 8));
+            }
+            break;
+        case 1:
+            if (!packet.empty()) {
+                packet[position] = uint8_t(random.next());
+            }
+            break;
+        case 2:
+            packet.insert(packet.begin() + position, uint8_t(random.next()));
+            break;
+        case 3:
+            if (!packet.empty()) {
+                packet.erase(packet.begin() + position);
+            }
+            break;
+        default:
+            packet.resize(random.next() % (packet.size() + 1));
+            break;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            std::ifstream file(argv[i], std::ios::binary);
+            Packet packet((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            LLVMFuzzerTestOneInput(packet.data(), packet.size());
+        }
+        std::printf("%d inputs ok\n", argc - 1);
+        return 0;
+    }
+
+    const size_t iterations = 2000000;
+    std::vector<Packet> corpus = syntheticAdvertisements(64, 7);
+    SplitMix64 random(13);
+    size_t decoded = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        Packet packet = corpus[random.next() % corpus.size()];
+        mutate(packet, random);
+        // Exact-size heap copy, so that reads past the end are caught by AddressSanitizer.
+        std::vector<uint8_t> input(packet);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        BIAdvertisement advertisement;
+        decoded += BIAdvertisementDecodePayload(input.data(), input.size(), &advertisement) ? 1 : 0;
+    }
+    std::printf("%zu mutated inputs ok, %zu still decoded\n", iterations, decoded);
+    return 0;
+}
+
+#endif
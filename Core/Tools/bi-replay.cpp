@@ -0,0 +1,189 @@
+//
+//  bi-replay.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Replays a recorded ranging trace through the smoothing engine, measures the smoothing cost per beacon per tick and
+// compares the result with the smoothed values recorded on the device (if the trace contains them).
+
+#include <BICore/BICore.h>
+
+#include "TraceCSV.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "usage: bi-replay [options] <trace.csv>\n"
+                 "\n"
+                 "options:\n"
+                 "  --window-size N        raw signals per smoothed signal (default: SDK default)\n"
+                 "  --window-duration S    smoothing window in seconds (default: SDK default)\n"
+                 "  --iterations N         replay the trace N times for timing (default: 1)\n"
+                 "  --tolerance T          allowed accuracy difference in meters (default: 1e-9)\n"
+                 "  --emit PATH            write the smoothed output as a trace with expected values ('-' for stdout)\n");
+}
+
+struct Mismatch {
+    double timestamp;
+    BIBeaconKey key;
+    BISignal expected;
+    BISignal actual;
+    bool missing;
+};
+
+bool signalsMatch(const BISignal &expected, const BISignal &actual, double tolerance)
+{
+    if (expected.inRange != actual.inRange || expected.RSSI != actual.RSSI || expected.proximity != actual.proximity) {
+        return false;
+    }
+    return std::fabs(expected.accuracy - actual.accuracy) <= tolerance;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BISmoothingConfiguration configuration = BISmoothingConfigurationMakeDefault();
+    long iterations = 1;
+    double tolerance = 1e-9;
+    const char *emitPath = nullptr;
+    const char *tracePath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+        if (std::strcmp(argv[i], "--window-size") == 0 && hasValue) {
+            configuration.windowSize = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--window-duration") == 0 && hasValue) {
+            configuration.windowDuration = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--iterations") == 0 && hasValue) {
+            iterations = std::max(1L, std::strtol(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--tolerance") == 0 && hasValue) {
+            tolerance = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--emit") == 0 && hasValue) {
+            emitPath = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            printUsage();
+            return 2;
+        } else {
+            tracePath = argv[i];
+        }
+    }
+    if (tracePath == nullptr) {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<CSVTick> ticks;
+    std::string error;
+    if (!readCSVTrace(tracePath, ticks, error)) {
+        std::fprintf(stderr, "bi-replay: %s\n", error.c_str());
+        return 1;
+    }
+
+    FILE *emitFile = nullptr;
+    if (emitPath != nullptr) {
+        emitFile = std::strcmp(emitPath, "-") == 0 ? stdout : std::fopen(emitPath, "w");
+        if (emitFile == nullptr) {
+            std::fprintf(stderr, "bi-replay: cannot open %s\n", emitPath);
+            return 1;
+        }
+        writeCSVHeader(emitFile);
+    }
+
+    double totalNanoseconds = 0.0;
+    uint64_t beaconTicks = 0;
+    uint64_t checked = 0;
+    std::vector<Mismatch> mismatches;
+    size_t beaconCount = 0;
+
+    for (long iteration = 0; iteration < iterations; iteration++) {
+        bool isFirstIteration = (iteration == 0);
+        BISmoothingEngineRef engine = BISmoothingEngineCreate(&configuration);
+
+        for (const CSVTick &tick : ticks) {
+            auto start = std::chrono::steady_clock::now();
+            BISmoothingEngineProcessTick(engine, tick.timestamp, tick.samples.data(), tick.samples.size());
+            auto end = std::chrono::steady_clock::now();
+            totalNanoseconds += std::chrono::duration<double, std::nano>(end - start).count();
+            beaconTicks += BISmoothingEngineGetBeaconCount(engine);
+
+            if (!isFirstIteration) {
+                continue;
+            }
+
+            for (const ExpectedSignal &expected : tick.expected) {
+                BISignal actual;
+                bool found = BISmoothingEngineGetSmoothedSignal(engine, &expected.key, &actual);
+                checked++;
+                if (!found || !signalsMatch(expected.signal, actual, tolerance)) {
+                    mismatches.push_back({tick.timestamp, expected.key, expected.signal, actual, !found});
+                }
+            }
+
+            if (emitFile != nullptr) {
+                size_t count = BISmoothingEngineGetBeaconCount(engine);
+                for (size_t i = 0; i < count; i++) {
+                    BIBeaconKey key;
+                    BISignal smoothed;
+                    BISmoothingEngineGetBeaconKeyAtIndex(engine, i, &key);
+                    BISmoothingEngineGetSmoothedSignal(engine, &key, &smoothed);
+                    const BIBeaconSample *raw = nullptr;
+                    for (const BIBeaconSample &sample : tick.samples) {
+                        if (BIBeaconKeyEqual(&sample.key, &key)) {
+                            raw = &sample;
+                        }
+                    }
+                    writeCSVRow(emitFile, tick.timestamp, key, raw, smoothed);
+                }
+            }
+        }
+
+        beaconCount = BISmoothingEngineGetBeaconCount(engine);
+        BISmoothingEngineDestroy(engine);
+    }
+
+    if (emitFile != nullptr && emitFile != stdout) {
+        std::fclose(emitFile);
+    }
+
+    FILE *report = (emitFile == stdout) ? stderr : stdout;
+    std::fprintf(report, "ticks:                 %zu\n", ticks.size());
+    std::fprintf(report, "beacons:               %zu\n", beaconCount);
+    std::fprintf(report, "iterations:            %ld\n", iterations);
+    std::fprintf(report, "smoothing cost:        %.1f ns per beacon per tick\n",
+                 beaconTicks > 0 ? totalNanoseconds / double(beaconTicks) : 0.0);
+    std::fprintf(report, "expected values:       %llu checked, %zu mismatches\n", (unsigned long long)checked, mismatches.size());
+
+    const size_t maxReported = 20;
+    for (size_t i = 0; i < mismatches.size() && i < maxReported; i++) {
+        const Mismatch &mismatch = mismatches[i];
+        char uuid[37];
+        BIBeaconKeyGetUUIDString(&mismatch.key, uuid);
+        if (mismatch.missing) {
+            std::fprintf(report, "  %.3f %s:%u:%u missing from engine\n", mismatch.timestamp, uuid,
+                         unsigned(mismatch.key.major), unsigned(mismatch.key.minor));
+            continue;
+        }
+        std::fprintf(report, "  %.3f %s:%u:%u expected %d dB prox %d %.6fm, got %d dB prox %d %.6fm\n",
+                     mismatch.timestamp, uuid, unsigned(mismatch.key.major), unsigned(mismatch.key.minor),
+                     int(mismatch.expected.RSSI), int(mismatch.expected.proximity), mismatch.expected.accuracy,
+                     int(mismatch.actual.RSSI), int(mismatch.actual.proximity), mismatch.actual.accuracy);
+    }
+
+    return mismatches.empty() ? 0 : 1;
+}
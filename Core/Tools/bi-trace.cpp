@@ -0,0 +1,288 @@
+//
+//  bi-trace.cpp
+//  BEACONinsideSDK
+//
+//  Copyright (c) 2014 BEACONinside. All rights reserved.
+//
+
+// Works with binary traces recorded by BITraceRecorder: converts CSV traces, prints records and replays traces through
+// the ranging pipeline and the region monitor, reporting nearest-beacon changes, raw region enter/exit storms and the
+// transitions that remain after debouncing per region.
+
+#include <BICore/BICore.h>
+
+#include "TraceCSV.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace bi::tools;
+
+namespace {
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "usage: bi-trace convert <trace.csv> <trace.bitrace>\n"
+                 "       bi-trace dump <trace.bitrace>\n"
+                 "       bi-trace replay [--storm-window S] <trace.bitrace>\n"
+                 "\n"
+                 "replay counts an exit followed by an enter of the same region within S seconds (default: 30) as a flap.\n");
+}
+
+const char *regionEventName(BIRegionEvent event)
+{
+    switch (event) {
+    case BIRegionEventEnter:
+        return "enter";
+    case BIRegionEventExit:
+        return "exit";
+    case BIRegionEventStateUnknown:
+        return "state unknown";
+    case BIRegionEventStateInside:
+        return "state inside";
+    case BIRegionEventStateOutside:
+        return "state outside";
+    }
+    return "?";
+}
+
+const char *bluetoothStateName(BIBluetoothState state)
+{
+    switch (state) {
+    case BIBluetoothStateUnknown:
+        return "unknown";
+    case BIBluetoothStateResetting:
+        return "resetting";
+    case BIBluetoothStateUnsupported:
+        return "unsupported";
+    case BIBluetoothStateUnauthorized:
+        return "unauthorized";
+    case BIBluetoothStatePoweredOff:
+        return "powered off";
+    case BIBluetoothStatePoweredOn:
+        return "powered on";
+    }
+    return "?";
+}
+
+int convert(const char *CSVPath, const char *tracePath)
+{
+    std::vector<CSVTick> ticks;
+    std::string error;
+    if (!readCSVTrace(CSVPath, ticks, error)) {
+        std::fprintf(stderr, "bi-trace: %s\n", error.c_str());
+        return 1;
+    }
+    BITraceRecorderRef recorder = BITraceRecorderCreate(tracePath, nullptr);
+    if (recorder == nullptr) {
+        std::fprintf(stderr, "bi-trace: cannot create %s\n", tracePath);
+        return 1;
+    }
+    if (!ticks.empty()) {
+        BITraceRecorderRecordRegionDefinition(recorder, 1, ticks.front().timestamp, CSVPath);
+    }
+    for (const CSVTick &tick : ticks) {
+        BITraceRecorderRecordRanging(recorder, 1, tick.timestamp, tick.samples.data(), tick.samples.size());
+    }
+    BITraceRecorderFlush(recorder);
+    BITraceRecorderStatistics statistics = BITraceRecorderGetStatistics(recorder);
+    BITraceRecorderDestroy(recorder);
+    std::printf("%zu ticks, %llu records, %llu bytes\n", ticks.size(), (unsigned long long)statistics.recordsWritten,
+                (unsigned long long)statistics.bytesWritten);
+    return 0;
+}
+
+int dump(const char *tracePath)
+{
+    BITraceReaderRef reader = BITraceReaderCreate(tracePath);
+    if (reader == nullptr) {
+        std::fprintf(stderr, "bi-trace: %s is not a trace\n", tracePath);
+        return 1;
+    }
+    BITraceRecord record;
+    while (BITraceReaderNext(reader, &record)) {
+        char uuid[37];
+        std::printf("%.6f ", record.timestamp);
+        switch (record.type) {
+        case BITraceRecordBeaconDefinition:
+            BIBeaconKeyGetUUIDString(&record.beaconKey, uuid);
+            std::printf("beacon %s:%u:%u\n", uuid, unsigned(record.beaconKey.major), unsigned(record.beaconKey.minor));
+            break;
+        case BITraceRecordRegionDefinition:
+            std::printf("region %u \"%s\"\n", unsigned(record.regionID), record.regionIdentifier);
+            break;
+        case BITraceRecordRanging:
+            std::printf("ranging region %u, %zu beacons\n", unsigned(record.regionID), record.sampleCount);
+            for (size_t i = 0; i < record.sampleCount; i++) {
+                const BIBeaconSample &sample = record.samples[i];
+                BIBeaconKeyGetUUIDString(&sample.key, uuid);
+                std::printf("    %s:%u:%u %d dB prox %d %.3fm\n", uuid, unsigned(sample.key.major), unsigned(sample.key.minor),
+                            int(sample.RSSI), int(sample.proximity), sample.accuracy);
+            }
+            break;
+        case BITraceRecordRegionEvent:
+            std::printf("region %u %s\n", unsigned(record.regionID), regionEventName(record.regionEvent));
+            break;
+        case BITraceRecordBluetoothState:
+            std::printf("bluetooth %s\n", bluetoothStateName(record.bluetoothState));
+            break;
+        case BITraceRecordGap:
+            std::printf("gap, %llu records dropped\n", (unsigned long long)record.droppedRecords);
+            break;
+        case BITraceRecordBeaconReset:
+            std::printf("beacon numbers reset\n");
+            break;
+        }
+    }
+    const char *error = BITraceReaderGetError(reader);
+    if (error != nullptr) {
+        std::fprintf(stderr, "bi-trace: %s\n", error);
+    }
+    BITraceReaderDestroy(reader);
+    return error == nullptr ? 0 : 1;
+}
+
+struct RegionSummary {
+    std::string identifier;
+    uint64_t batches = 0;
+    uint64_t nearestBeaconChanges = 0;
+    uint64_t enters = 0;
+    uint64_t exits = 0;
+    uint64_t flaps = 0;
+    double lastExit = -1.0;
+    uint64_t reportedEnters = 0;
+    uint64_t reportedExits = 0;
+};
+
+struct ReplaySummary {
+    double stormWindow = 30.0;
+    std::map<uint32_t, RegionSummary> regions;
+};
+
+void summarizeBatch(const BIRangingBatch *batch, void *context)
+{
+    ReplaySummary &summary = *static_cast<ReplaySummary *>(context);
+    for (size_t i = 0; i < batch->regionCount; i++) {
+        RegionSummary &region = summary.regions[batch->regions[i].regionID];
+        region.batches++;
+        region.nearestBeaconChanges += batch->regions[i].nearestBeaconChanged ? 1 : 0;
+    }
+}
+
+void summarizeTransition(uint32_t regionID, BIRegionTransition transition, double timestamp, void *context)
+{
+    (void)timestamp;
+    ReplaySummary &summary = *static_cast<ReplaySummary *>(context);
+    RegionSummary &region = summary.regions[regionID];
+    if (transition == BIRegionTransitionEnter) {
+        region.reportedEnters++;
+    } else {
+        region.reportedExits++;
+    }
+}
+
+void summarizeRecord(const BITraceRecord *record, void *context)
+{
+    ReplaySummary &summary = *static_cast<ReplaySummary *>(context);
+    if (record->type == BITraceRecordRegionDefinition) {
+        summary.regions[record->regionID].identifier = record->regionIdentifier;
+    } else if (record->type == BITraceRecordRegionEvent) {
+        RegionSummary &region = summary.regions[record->regionID];
+        if (record->regionEvent == BIRegionEventEnter) {
+            region.enters++;
+            if (region.lastExit >= 0.0 && record->timestamp - region.lastExit <= summary.stormWindow) {
+                region.flaps++;
+            }
+        } else if (record->regionEvent == BIRegionEventExit) {
+            region.exits++;
+            region.lastExit = record->timestamp;
+        }
+    }
+}
+
+int replay(const char *tracePath, double stormWindow)
+{
+    ReplaySummary summary;
+    summary.stormWindow = stormWindow;
+    BITraceReplayHandlers handlers = {summarizeBatch, summarizeTransition, summarizeRecord};
+    BITraceReplayerRef replayer = BITraceReplayerCreate(tracePath, nullptr, handlers, &summary);
+    if (replayer == nullptr) {
+        std::fprintf(stderr, "bi-trace: %s is not a trace\n", tracePath);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = BITraceReplayerRun(replayer);
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    BITraceReplayStatistics statistics = BITraceReplayerGetStatistics(replayer);
+    if (!ok) {
+        std::fprintf(stderr, "bi-trace: %s (replayed up to %.3f)\n", BITraceReplayerGetError(replayer), statistics.lastTimestamp);
+    }
+    BITraceReplayerDestroy(replayer);
+
+    double span = statistics.lastTimestamp - statistics.firstTimestamp;
+    std::printf("records:               %llu (%llu ranging, %llu beacons)\n", (unsigned long long)statistics.records,
+                (unsigned long long)statistics.rangingRecords, (unsigned long long)statistics.samples);
+    std::printf("region events:         %llu\n", (unsigned long long)statistics.regionEvents);
+    std::printf("bluetooth changes:     %llu\n", (unsigned long long)statistics.bluetoothStateChanges);
+    std::printf("dropped records:       %llu\n", (unsigned long long)statistics.droppedRecords);
+    std::printf("batches:               %llu\n", (unsigned long long)statistics.batchesDelivered);
+    const BIRegionMonitorStatistics &transitions = statistics.regionTransitions;
+    std::printf("transitions:           %llu enters, %llu exits (suppressed %llu enters, %llu exits; duplicates %llu enters, "
+                "%llu exits)\n",
+                (unsigned long long)transitions.enters, (unsigned long long)transitions.exits,
+                (unsigned long long)transitions.suppressedEnters, (unsigned long long)transitions.suppressedExits,
+                (unsigned long long)transitions.duplicateEnters, (unsigned long long)transitions.duplicateExits);
+    std::printf("trace duration:        %.1f s\n", span);
+    std::printf("replay time:           %.3f s (%.0fx real time)\n", seconds, seconds > 0.0 ? span / seconds : 0.0);
+    std::printf("\n%-8s %-24s %10s %10s %8s %8s %8s %10s %10s\n", "region", "identifier", "batches", "nearest", "enters",
+                "exits", "flaps", "debounced", "");
+    std::printf("%-8s %-24s %10s %10s %8s %8s %8s %10s %10s\n", "", "", "", "", "", "", "", "enters", "exits");
+    for (const auto &entry : summary.regions) {
+        const RegionSummary &region = entry.second;
+        std::printf("%-8u %-24.24s %10llu %10llu %8llu %8llu %8llu %10llu %10llu\n", unsigned(entry.first),
+                    region.identifier.c_str(), (unsigned long long)region.batches,
+                    (unsigned long long)region.nearestBeaconChanges, (unsigned long long)region.enters,
+                    (unsigned long long)region.exits, (unsigned long long)region.flaps,
+                    (unsigned long long)region.reportedEnters, (unsigned long long)region.reportedExits);
+    }
+    return ok ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && std::strcmp(argv[1], "convert") == 0) {
+        return convert(argv[2], argv[3]);
+    }
+    if (argc == 3 && std::strcmp(argv[1], "dump") == 0) {
+        return dump(argv[2]);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "replay") == 0) {
+        double stormWindow = 30.0;
+        const char *tracePath = nullptr;
+        for (int i = 2; i < argc; i++) {
+            if (std::strcmp(argv[i], "--storm-window") == 0 && i + 1 < argc) {
+                stormWindow = std::strtod(argv[++i], nullptr);
+            } else if (argv[i][0] == '-') {
+                printUsage();
+                return 2;
+            } else {
+                tracePath = argv[i];
+            }
+        }
+        if (tracePath != nullptr) {
+            return replay(tracePath, stormWindow);
+        }
+    }
+    printUsage();
+    return 2;
+}